@@ -0,0 +1,156 @@
+//
+// Copyright (c) 2018 Rokas Kupstys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Tasks.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/Input/Input.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/UI/Font.h>
+#include <Urho3D/UI/Text.h>
+#include <Urho3D/UI/UI.h>
+
+#include "TasksStress.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of tasks created at startup.
+static const unsigned NUM_TASKS = 100000;
+/// Stack size of a single task. Agent logic is simple, so a small stack keeps memory use of many tasks low.
+static const unsigned TASK_STACK_SIZE = 16 * 1024;
+/// Number of values processed by a job submitted from a task.
+static const unsigned JOB_SIZE = 256;
+
+URHO3D_DEFINE_APPLICATION_MAIN(TasksStress);
+
+/// Data of a job submitted by an agent task.
+struct AgentJob
+{
+    /// Input value.
+    float input_;
+    /// Result written by the job.
+    float result_;
+};
+
+/// Job function summing a series derived from the agent value.
+static void AgentJobWork(void* data, unsigned threadIndex)
+{
+    auto* job = static_cast<AgentJob*>(data);
+    float sum = 0.0f;
+    for (unsigned i = 0; i < JOB_SIZE; ++i)
+        sum += Sin(job->input_ + i);
+    job->result_ = sum;
+}
+
+TasksStress::TasksStress(Context* context) :
+    Sample(context)
+{
+}
+
+void TasksStress::Start()
+{
+    // Execute base class startup
+    Sample::Start();
+
+    // Create the UI content
+    CreateUI();
+
+    // Tasks executed in E_UPDATE event are resumed on all worker threads. Agent tasks only touch their own data.
+    scheduler_ = GetTasks()->GetScheduler(E_UPDATE);
+    scheduler_->SetThreaded(true);
+    CreateTasks(NUM_TASKS);
+
+    SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(TasksStress, HandleUpdate));
+
+    // Set the mouse mode to use in the sample
+    Sample::InitMouseMode(MM_FREE);
+}
+
+void TasksStress::CreateUI()
+{
+    auto* cache = GetSubsystem<ResourceCache>();
+    auto* ui = GetSubsystem<UI>();
+
+    statsText_ = ui->GetRoot()->CreateChild<Text>();
+    statsText_->SetFont(cache->GetResource<Font>("Fonts/Anonymous Pro.ttf"), 15);
+    statsText_->SetTextAlignment(HA_CENTER);
+    statsText_->SetHorizontalAlignment(HA_CENTER);
+    statsText_->SetVerticalAlignment(VA_CENTER);
+}
+
+void TasksStress::CreateTasks(unsigned count)
+{
+    // Tasks access their value by index each time they run, so the vector may be reallocated here while they are
+    // suspended
+    unsigned first = agentValues_.Size();
+    agentValues_.Resize(first + count);
+    for (unsigned i = first; i < agentValues_.Size(); ++i)
+    {
+        agentValues_[i] = 0.0f;
+        scheduler_->Create(std::bind(&TasksStress::AgentAI, this, i), TASK_STACK_SIZE);
+    }
+}
+
+void TasksStress::AgentAI(unsigned index)
+{
+    // Random numbers are generated by the task itself, as Random() is not thread-safe
+    unsigned seed = index * 2654435761U + 1;
+    auto random = [&seed]() { seed = seed * 1103515245U + 12345U; return (seed >> 16) / 65536.0f; };
+
+    for (;;)
+    {
+        // Think for a random period of time. Sleeping tasks are not visited by the scheduler until they are due.
+        agentValues_[index] += 1.0f;
+        SuspendTask(random() * 2.0f);
+
+        // Occasionally offload heavier work to the work queue and wait for it without blocking a thread
+        if (random() < 0.1f)
+        {
+            AgentJob job{agentValues_[index], 0.0f};
+            JobCounter counter;
+            GetWorkQueue()->AddJob(AgentJobWork, &job, &counter);
+            WaitForJobs(counter);
+            agentValues_[index] = job.result_;
+        }
+    }
+}
+
+void TasksStress::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+    // Toggle threaded execution with T and add more tasks with space
+    auto* input = GetSubsystem<Input>();
+    if (input->GetKeyPress(KEY_T))
+        scheduler_->SetThreaded(!scheduler_->IsThreaded());
+    if (input->GetKeyPress(KEY_SPACE))
+        CreateTasks(NUM_TASKS);
+
+    statsText_->SetText(ToString(
+        "T to toggle threaded execution (%s)\n"
+        "Space to add %u tasks\n\n"
+        "Tasks: %u\n"
+        "Resumed last frame: %u\n"
+        "Worker threads: %u",
+        scheduler_->IsThreaded() ? "on" : "off", NUM_TASKS, scheduler_->GetActiveTaskCount(),
+        scheduler_->GetExecutedTaskCount(), GetWorkQueue()->GetNumThreads()));
+}
@@ -0,0 +1,67 @@
+//
+// Copyright (c) 2018 Rokas Kupstys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "Sample.h"
+
+namespace Urho3D
+{
+
+class TaskScheduler;
+class Text;
+
+}
+
+/// Tasks stress test example.
+/// This sample demonstrates:
+///     - Running a large number of tasks with small stacks
+///     - Resuming tasks on all worker threads using a threaded task scheduler
+///     - Suspending tasks until jobs submitted to the work queue are finished
+class TasksStress : public Sample
+{
+    URHO3D_OBJECT(TasksStress, Sample);
+
+public:
+    /// Construct.
+    explicit TasksStress(Context* context);
+
+    /// Setup after engine initialization and before running the main loop.
+    void Start() override;
+
+private:
+    /// Construct the instruction and statistics text.
+    void CreateUI();
+    /// Create the specified number of agent tasks.
+    void CreateTasks(unsigned count);
+    /// Implement agent logic.
+    void AgentAI(unsigned index);
+    /// Handle the logic update event.
+    void HandleUpdate(StringHash eventType, VariantMap& eventData);
+
+    /// Scheduler executing agent tasks.
+    TaskScheduler* scheduler_{};
+    /// Per-agent simulation state written by the tasks.
+    PODVector<float> agentValues_;
+    /// Statistics text.
+    SharedPtr<Text> statsText_;
+};
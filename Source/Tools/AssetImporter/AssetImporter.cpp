@@ -32,6 +32,7 @@
 #include <Urho3D/Graphics/IndexBuffer.h>
 #include <Urho3D/Graphics/Light.h>
 #include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/MeshOptimizer.h>
 #include <Urho3D/Graphics/Octree.h>
 #include <Urho3D/Graphics/VertexBuffer.h>
 #include <Urho3D/Graphics/Zone.h>
@@ -135,6 +136,8 @@ const char *transformSuffix[TransformationComp_MAXIMUM] =
 };
 
 static const unsigned MAX_CHANNELS = 4;
+/// Generated LOD levels must have at most this fraction of the previous level's triangles to be kept.
+static const float MAX_LOD_TRIANGLE_FRACTION = 0.9f;
 
 SharedPtr<Context> context_(new Context());
 const aiScene* scene_ = nullptr;
@@ -164,6 +167,11 @@ bool noOverwriteNewerTexture_ = false;
 bool checkUniqueModel_ = true;
 bool moveToBindPose_ = false;
 unsigned maxBones_ = 64;
+unsigned numGeneratedLods_ = 0;
+float lodTriangleRatio_ = 0.5f;
+float lodDistanceStep_ = 20.0f;
+float lodMaxError_ = 0.05f;
+bool optimizeIndices_ = false;
 Vector<String> nonSkinningBoneIncludes_;
 Vector<String> nonSkinningBoneExcludes_;
 
@@ -215,9 +223,11 @@ String GetMaterialTextureName(const String& nameIn);
 String GenerateMaterialName(aiMaterial* material);
 String GenerateTextureName(unsigned texIndex);
 unsigned GetNumValidFaces(aiMesh* mesh);
+void BuildGeometryLods(Vector<PODVector<unsigned> >& lodIndices, PODVector<unsigned>& vertexOrder, aiMesh* mesh,
+    unsigned geomIndex, bool optimize);
 
-void WriteShortIndices(unsigned short*& dest, aiMesh* mesh, unsigned index, unsigned offset);
-void WriteLargeIndices(unsigned*& dest, aiMesh* mesh, unsigned index, unsigned offset);
+void WriteShortIndices(unsigned short*& dest, const PODVector<unsigned>& indices, unsigned offset);
+void WriteLargeIndices(unsigned*& dest, const PODVector<unsigned>& indices, unsigned offset);
 void WriteVertex(float*& dest, aiMesh* mesh, unsigned index, bool isSkinned, BoundingBox& box,
     const Matrix3x4& vertexTransform, const Matrix3& normalTransform, Vector<PODVector<unsigned char> >& blendIndices,
     Vector<PODVector<float> >& blendWeights);
@@ -306,6 +316,11 @@ void Run(const Vector<String>& arguments)
             "-split <start> <end> (animation model only)\n"
             "            Split animation, will only import from start frame to end frame\n"
             "-np         Do not suppress $fbx pivot nodes (FBX files only)\n"
+            "-lods <n>   Generate n simplified LOD levels for each model geometry\n"
+            "-lodr <x>   Triangle ratio between successive generated LOD levels. Default 0.5\n"
+            "-lodd <x>   Distance between successive generated LOD levels. Default 20\n"
+            "-lode <x>   Maximum simplification error relative to geometry size. Default 0.05\n"
+            "-oi         Optimize index buffers for vertex cache and overdraw. Implied by -lods\n"
         );
     }
 
@@ -412,6 +427,28 @@ void Run(const Vector<String>& arguments)
                     maxBones_ = 1;
                 ++i;
             }
+            else if (argument == "lods" && !value.Empty())
+            {
+                numGeneratedLods_ = ToUInt(value);
+                ++i;
+            }
+            else if (argument == "lodr" && !value.Empty())
+            {
+                lodTriangleRatio_ = Clamp(ToFloat(value), 0.01f, MAX_LOD_TRIANGLE_FRACTION);
+                ++i;
+            }
+            else if (argument == "lodd" && !value.Empty())
+            {
+                lodDistanceStep_ = Max(ToFloat(value), 0.0f);
+                ++i;
+            }
+            else if (argument == "lode" && !value.Empty())
+            {
+                lodMaxError_ = Max(ToFloat(value), 0.0f);
+                ++i;
+            }
+            else if (argument == "oi")
+                optimizeIndices_ = true;
             else if (argument == "p" && !value.Empty())
             {
                 resourcePath_ = AddTrailingSlash(value);
@@ -1005,6 +1042,24 @@ void BuildAndSaveModel(OutModel& model)
 
     unsigned numValidGeometries = 0;
 
+    // Build the index lists of all LOD levels first, as simplification changes the index counts
+    bool optimizeIndices = optimizeIndices_ || numGeneratedLods_ > 0;
+    Vector<Vector<PODVector<unsigned> > > allLodIndices(model.meshes_.Size());
+    Vector<PODVector<unsigned> > allVertexOrders(model.meshes_.Size());
+    PODVector<unsigned> meshIndexCounts(model.meshes_.Size());
+    unsigned totalIndices = 0;
+    for (unsigned i = 0; i < model.meshes_.Size(); ++i)
+    {
+        meshIndexCounts[i] = 0;
+        if (GetNumValidFaces(model.meshes_[i]))
+        {
+            BuildGeometryLods(allLodIndices[i], allVertexOrders[i], model.meshes_[i], i, optimizeIndices);
+            for (unsigned j = 0; j < allLodIndices[i].Size(); ++j)
+                meshIndexCounts[i] += allLodIndices[i][j].Size();
+            totalIndices += meshIndexCounts[i];
+        }
+    }
+
     bool combineBuffers = true;
     // Check if buffers can be combined (same vertex elements, under 65535 vertices)
     PODVector<VertexElement> elements = GetVertexElements(model.meshes_[0], model.bones_.Size() > 0);
@@ -1053,9 +1108,12 @@ void BuildAndSaveModel(OutModel& model)
         if (!validFaces)
             continue;
 
+        const Vector<PODVector<unsigned> >& lodIndices = allLodIndices[i];
+        const PODVector<unsigned>& vertexOrder = allVertexOrders[i];
+
         bool largeIndices;
         if (combineBuffers)
-            largeIndices = model.totalIndices_ > 65535;
+            largeIndices = model.totalVertices_ > 65535;
         else
             largeIndices = mesh->mNumVertices > 65535;
 
@@ -1067,12 +1125,12 @@ void BuildAndSaveModel(OutModel& model)
 
             if (combineBuffers)
             {
-                ib->SetSize(model.totalIndices_, largeIndices);
+                ib->SetSize(totalIndices, largeIndices);
                 vb->SetSize(model.totalVertices_, elements);
             }
             else
             {
-                ib->SetSize(validFaces * 3, largeIndices);
+                ib->SetSize(meshIndexCounts[i], largeIndices);
                 vb->SetSize(mesh->mNumVertices, elements);
             }
 
@@ -1091,8 +1149,6 @@ void BuildAndSaveModel(OutModel& model)
         vertexTransform = Matrix3x4(pos, rot, scale);
         normalTransform = rot.RotationMatrix();
 
-        SharedPtr<Geometry> geom(new Geometry(context_));
-
         PrintLine("Writing geometry " + String(i) + " with " + String(mesh->mNumVertices) + " vertices " +
             String(validFaces * 3) + " indices");
 
@@ -1102,18 +1158,18 @@ void BuildAndSaveModel(OutModel& model)
         unsigned char* vertexData = vb->GetShadowData();
         unsigned char* indexData = ib->GetShadowData();
 
-        // Build the index data
+        // Build the index data, LOD levels one after another
         if (!largeIndices)
         {
             unsigned short* dest = (unsigned short*)indexData + startIndexOffset;
-            for (unsigned j = 0; j < mesh->mNumFaces; ++j)
-                WriteShortIndices(dest, mesh, j, startVertexOffset);
+            for (unsigned j = 0; j < lodIndices.Size(); ++j)
+                WriteShortIndices(dest, lodIndices[j], startVertexOffset);
         }
         else
         {
             unsigned* dest = (unsigned*)indexData + startIndexOffset;
-            for (unsigned j = 0; j < mesh->mNumFaces; ++j)
-                WriteLargeIndices(dest, mesh, j, startVertexOffset);
+            for (unsigned j = 0; j < lodIndices.Size(); ++j)
+                WriteLargeIndices(dest, lodIndices[j], startVertexOffset);
         }
 
         // Build the vertex data
@@ -1126,7 +1182,10 @@ void BuildAndSaveModel(OutModel& model)
 
         auto* dest = (float*)((unsigned char*)vertexData + startVertexOffset * vb->GetVertexSize());
         for (unsigned j = 0; j < mesh->mNumVertices; ++j)
-            WriteVertex(dest, mesh, j, isSkinned, box, vertexTransform, normalTransform, blendIndices, blendWeights);
+        {
+            WriteVertex(dest, mesh, vertexOrder.Empty() ? j : vertexOrder[j], isSkinned, box, vertexTransform, normalTransform,
+                blendIndices, blendWeights);
+        }
 
         // Calculate the geometry center
         Vector3 center = Vector3::ZERO;
@@ -1145,18 +1204,30 @@ void BuildAndSaveModel(OutModel& model)
             center /= (float)validFaces * 3;
         }
 
-        // Define the geometry
-        geom->SetIndexBuffer(ib);
-        geom->SetVertexBuffer(0, vb);
-        geom->SetDrawRange(TRIANGLE_LIST, startIndexOffset, validFaces * 3, true);
-        outModel->SetNumGeometryLodLevels(destGeomIndex, 1);
-        outModel->SetGeometry(destGeomIndex, 0, geom);
+        // Define the geometry LOD levels
+        outModel->SetNumGeometryLodLevels(destGeomIndex, lodIndices.Size());
+        unsigned lodIndexOffset = startIndexOffset;
+        for (unsigned j = 0; j < lodIndices.Size(); ++j)
+        {
+            SharedPtr<Geometry> geom(new Geometry(context_));
+            geom->SetIndexBuffer(ib);
+            geom->SetVertexBuffer(0, vb);
+            geom->SetDrawRange(TRIANGLE_LIST, lodIndexOffset, lodIndices[j].Size(), true);
+            geom->SetLodDistance(j * lodDistanceStep_);
+            outModel->SetGeometry(destGeomIndex, j, geom);
+            lodIndexOffset += lodIndices[j].Size();
+
+            VertexCacheStatistics stats = AnalyzeVertexCache(lodIndices[j], mesh->mNumVertices);
+            PrintLine("LOD level " + String(j) + " distance " + String(geom->GetLodDistance()) + " with " +
+                String(geom->GetVertexCount()) + " vertices " + String(geom->GetIndexCount()) + " indices, ACMR " +
+                String(stats.acmr_) + " ATVR " + String(stats.atvr_));
+        }
         outModel->SetGeometryCenter(destGeomIndex, center);
         if (model.bones_.Size() > maxBones_)
             allBoneMappings.Push(boneMappings);
 
         startVertexOffset += mesh->mNumVertices;
-        startIndexOffset += validFaces * 3;
+        startIndexOffset += meshIndexCounts[i];
         ++destGeomIndex;
     }
 
@@ -2410,26 +2481,93 @@ unsigned GetNumValidFaces(aiMesh* mesh)
     return ret;
 }
 
-void WriteShortIndices(unsigned short*& dest, aiMesh* mesh, unsigned index, unsigned offset)
+void BuildGeometryLods(Vector<PODVector<unsigned> >& lodIndices, PODVector<unsigned>& vertexOrder, aiMesh* mesh,
+    unsigned geomIndex, bool optimize)
 {
-    if (mesh->mFaces[index].mNumIndices == 3)
+    PODVector<unsigned> indices;
+    indices.Reserve(GetNumValidFaces(mesh) * 3);
+    for (unsigned i = 0; i < mesh->mNumFaces; ++i)
     {
-        *dest++ = mesh->mFaces[index].mIndices[0] + offset;
-        *dest++ = mesh->mFaces[index].mIndices[1] + offset;
-        *dest++ = mesh->mFaces[index].mIndices[2] + offset;
+        if (mesh->mFaces[i].mNumIndices == 3)
+        {
+            indices.Push(mesh->mFaces[i].mIndices[0]);
+            indices.Push(mesh->mFaces[i].mIndices[1]);
+            indices.Push(mesh->mFaces[i].mIndices[2]);
+        }
     }
-}
 
-void WriteLargeIndices(unsigned*& dest, aiMesh* mesh, unsigned index, unsigned offset)
-{
-    if (mesh->mFaces[index].mNumIndices == 3)
+    lodIndices.Clear();
+    lodIndices.Push(indices);
+    vertexOrder.Clear();
+    if (!optimize)
+        return;
+
+    unsigned numVertices = mesh->mNumVertices;
+    PODVector<Vector3> positions(numVertices);
+    for (unsigned i = 0; i < numVertices; ++i)
+        positions[i] = ToVector3(mesh->mVertices[i]);
+
+    VertexCacheStatistics stats = AnalyzeVertexCache(indices, numVertices);
+    PrintLine("Optimizing geometry " + String(geomIndex) + ", source ACMR " + String(stats.acmr_) + " ATVR " +
+        String(stats.atvr_));
+
+    // Simplify each level from the full detail mesh so that the error is measured against the original surface
+    float triangleRatio = 1.0f;
+    for (unsigned i = 0; i < numGeneratedLods_; ++i)
+    {
+        triangleRatio *= lodTriangleRatio_;
+        unsigned targetIndices = (unsigned)(indices.Size() / 3 * triangleRatio) * 3;
+        const PODVector<unsigned>& previous = lodIndices.Back();
+        PODVector<unsigned> simplified;
+        float error = SimplifyMesh(simplified, indices, positions, targetIndices, lodMaxError_);
+        if (simplified.Empty() || simplified.Size() > previous.Size() * MAX_LOD_TRIANGLE_FRACTION)
+        {
+            PrintLine("Geometry " + String(geomIndex) + " can not be simplified further within the error limit, generated " +
+                String(i) + " LOD levels");
+            break;
+        }
+
+        PrintLine("Generated LOD level " + String(i + 1) + " for geometry " + String(geomIndex) + " with " +
+            String(simplified.Size()) + " indices, error " + String(error));
+        lodIndices.Push(simplified);
+    }
+
+    for (unsigned i = 0; i < lodIndices.Size(); ++i)
+    {
+        OptimizeVertexCache(lodIndices[i], numVertices);
+        OptimizeOverdraw(lodIndices[i], positions);
+    }
+
+    // Order the vertices by first use, coarsest LOD level first: the vertices of each level are then a prefix of the
+    // vertex data, and lower detail levels draw a smaller vertex range
+    Vector<PODVector<unsigned> > fetchOrder(lodIndices.Size());
+    for (unsigned i = 0; i < lodIndices.Size(); ++i)
+        fetchOrder[i] = lodIndices[lodIndices.Size() - 1 - i];
+    GetVertexFetchOrder(vertexOrder, fetchOrder, numVertices);
+
+    PODVector<unsigned> vertexRemap(numVertices);
+    for (unsigned i = 0; i < numVertices; ++i)
+        vertexRemap[vertexOrder[i]] = i;
+    for (unsigned i = 0; i < lodIndices.Size(); ++i)
     {
-        *dest++ = mesh->mFaces[index].mIndices[0] + offset;
-        *dest++ = mesh->mFaces[index].mIndices[1] + offset;
-        *dest++ = mesh->mFaces[index].mIndices[2] + offset;
+        PODVector<unsigned>& levelIndices = lodIndices[i];
+        for (unsigned j = 0; j < levelIndices.Size(); ++j)
+            levelIndices[j] = vertexRemap[levelIndices[j]];
     }
 }
 
+void WriteShortIndices(unsigned short*& dest, const PODVector<unsigned>& indices, unsigned offset)
+{
+    for (unsigned i = 0; i < indices.Size(); ++i)
+        *dest++ = (unsigned short)(indices[i] + offset);
+}
+
+void WriteLargeIndices(unsigned*& dest, const PODVector<unsigned>& indices, unsigned offset)
+{
+    for (unsigned i = 0; i < indices.Size(); ++i)
+        *dest++ = indices[i] + offset;
+}
+
 void WriteVertex(float*& dest, aiMesh* mesh, unsigned index, bool isSkinned, BoundingBox& box,
     const Matrix3x4& vertexTransform, const Matrix3& normalTransform, Vector<PODVector<unsigned char> >& blendIndices,
     Vector<PODVector<float> >& blendWeights)
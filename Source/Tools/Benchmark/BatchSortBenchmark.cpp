@@ -0,0 +1,155 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Batch.h>
+#include <Urho3D/Math/Random.h>
+
+#include "Benchmark.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of draw calls in the sorted queue.
+static const unsigned NUM_SORT_BATCHES = 100000;
+/// Number of distinct shaders, materials and geometries of the draw calls.
+static const unsigned NUM_SORT_STATES = 64;
+/// Number of repetitions of each measurement.
+static const unsigned NUM_SORT_REPEATS = 10;
+
+/// Reference state order of the front to back sort.
+static bool CompareBatchesState(Batch* lhs, Batch* rhs)
+{
+    if (lhs->renderOrder_ != rhs->renderOrder_)
+        return lhs->renderOrder_ < rhs->renderOrder_;
+    if (lhs->sortKey_ != rhs->sortKey_)
+        return lhs->sortKey_ < rhs->sortKey_;
+    return lhs->distance_ < rhs->distance_;
+}
+
+/// Reference distance order of the front to back sort.
+static bool CompareBatchesFrontToBack(Batch* lhs, Batch* rhs)
+{
+    if (lhs->renderOrder_ != rhs->renderOrder_)
+        return lhs->renderOrder_ < rhs->renderOrder_;
+    if (lhs->distance_ != rhs->distance_)
+        return lhs->distance_ < rhs->distance_;
+    return lhs->sortKey_ < rhs->sortKey_;
+}
+
+/// Reference order of the back to front sort.
+static bool CompareBatchesBackToFront(Batch* lhs, Batch* rhs)
+{
+    if (lhs->renderOrder_ != rhs->renderOrder_)
+        return lhs->renderOrder_ < rhs->renderOrder_;
+    if (lhs->distance_ != rhs->distance_)
+        return lhs->distance_ > rhs->distance_;
+    return lhs->sortKey_ < rhs->sortKey_;
+}
+
+/// Return number of adjacent sorted draw calls that are out of order.
+template <class T> static unsigned CountOrderErrors(const PODVector<Batch*>& batches, const T& compare)
+{
+    unsigned errors = 0;
+    for (unsigned i = 1; i < batches.Size(); ++i)
+    {
+        if (compare(batches[i], batches[i - 1]))
+            ++errors;
+    }
+    return errors;
+}
+
+/// Return milliseconds per repetition of sorting a queue, restoring the unsorted draw calls before each repetition.
+template <class T> static double MeasureSort(BatchQueue& queue, const PODVector<Batch>& source, const T& function)
+{
+    long long usec = 0;
+    for (unsigned i = 0; i < NUM_SORT_REPEATS; ++i)
+    {
+        queue.batches_ = source;
+        HiresTimer timer;
+        function();
+        usec += timer.GetUSec(false);
+    }
+    return usec / 1000.0 / NUM_SORT_REPEATS;
+}
+
+void RunBatchSortBenchmark(Context* context, BenchmarkReport& report)
+{
+    // Draw calls of a few render orders at random distances with random state. The distances are whole numbers, so that
+    // draw calls at equal distance test the order by state
+    SetRandomSeed(1);
+    PODVector<Batch> source(NUM_SORT_BATCHES);
+    for (unsigned i = 0; i < NUM_SORT_BATCHES; ++i)
+    {
+        Batch& batch = source[i];
+        batch.distance_ = (float)(Rand() % 1000);
+        batch.renderOrder_ = (unsigned char)(Rand() % 4 == 0 ? 0 : 128);
+        batch.sortKey_ = (((unsigned long long)(Rand() % NUM_SORT_STATES)) << 32u) |
+            (((unsigned long long)(Rand() % NUM_SORT_STATES)) << 16u) | (unsigned long long)(Rand() % NUM_SORT_STATES);
+    }
+
+    // The previous comparison sorts: front to back by distance and then by state, and back to front by distance
+    PODVector<Batch*> sorted(NUM_SORT_BATCHES);
+    BatchQueue queue;
+    double comparisonFrontToBackMs = MeasureSort(queue, source, [&]()
+    {
+        for (unsigned i = 0; i < NUM_SORT_BATCHES; ++i)
+            sorted[i] = &queue.batches_[i];
+        Sort(sorted.Begin(), sorted.End(), CompareBatchesFrontToBack);
+        Sort(sorted.Begin(), sorted.End(), CompareBatchesState);
+    });
+    double comparisonBackToFrontMs = MeasureSort(queue, source, [&]()
+    {
+        for (unsigned i = 0; i < NUM_SORT_BATCHES; ++i)
+            sorted[i] = &queue.batches_[i];
+        Sort(sorted.Begin(), sorted.End(), CompareBatchesBackToFront);
+    });
+    report.Add("BatchSort", "Comparison sort front to back", comparisonFrontToBackMs, "ms");
+    report.Add("BatchSort", "Comparison sort back to front", comparisonBackToFrontMs, "ms");
+
+    // Radix sorts in the calling thread, and split to worker threads
+    SharedPtr<WorkQueue> workQueue(new WorkQueue(context));
+    if (GetNumLogicalCPUs() > 1)
+        workQueue->CreateThreads(GetNumLogicalCPUs() - 1);
+
+    static const char* modeNames[] = { "serial", "parallel" };
+    unsigned orderErrors = 0;
+
+    for (unsigned mode = 0; mode < 2; ++mode)
+    {
+        WorkQueue* sortQueue = mode ? workQueue.Get() : nullptr;
+        String name(modeNames[mode]);
+
+        queue.Clear(-1);
+        double frontToBackMs = MeasureSort(queue, source, [&]() { queue.SortFrontToBack(sortQueue); });
+        orderErrors += CountOrderErrors(queue.sortedBatches_, CompareBatchesState);
+        double backToFrontMs = MeasureSort(queue, source, [&]() { queue.SortBackToFront(sortQueue); });
+        orderErrors += CountOrderErrors(queue.sortedBatches_, CompareBatchesBackToFront);
+
+        report.Add("BatchSort", "Radix sort front to back " + name, frontToBackMs, "ms");
+        report.Add("BatchSort", "Radix sort back to front " + name, backToFrontMs, "ms");
+    }
+
+    report.Check("BatchSort", "Order errors", orderErrors, "batches");
+}
@@ -0,0 +1,227 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Resource/JSONFile.h>
+
+#include "Benchmark.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+/// Registered benchmark.
+struct BenchmarkDesc
+{
+    /// Name used to select the benchmark from the command line.
+    const char* name_;
+    /// Benchmark function.
+    BenchmarkFunction function_;
+};
+
+static const BenchmarkDesc benchmarks[] = {
+    { "WorkQueue", RunWorkQueueBenchmark },
+    { "HashMap", RunHashMapBenchmark },
+    { "SceneLoad", RunSceneLoadBenchmark },
+    { "Events", RunEventBenchmark },
+    { "OctreeQuery", RunOctreeQueryBenchmark },
+    { "SpatialIndex", RunSpatialIndexBenchmark },
+    { "QueryCache", RunQueryCacheBenchmark },
+    { "BatchSort", RunBatchSortBenchmark },
+    { "Occlusion", RunOcclusionBenchmark },
+    { "Instancing", RunInstancingBenchmark },
+    { "HLOD", RunHLODBenchmark },
+    { "Skinning", RunSkinningBenchmark },
+    { "Transform", RunTransformBenchmark },
+    { "LogicUpdate", RunLogicUpdateBenchmark },
+    { "DeferredSpawn", RunDeferredSpawnBenchmark },
+    { "ColumnarSceneLoad", RunColumnarSceneLoadBenchmark },
+    { "PrefabSpawn", RunPrefabSpawnBenchmark },
+    { "HugeObjectCount", RunHugeObjectCountBenchmark },
+    { "MovingObjects", RunMovingObjectsBenchmark },
+    { "SkinnedCrowd", RunSkinnedCrowdBenchmark },
+#ifdef URHO3D_PHYSICS
+    { "PhysicsPile", RunPhysicsPileBenchmark },
+#endif
+#ifdef URHO3D_NAVIGATION
+    { "NavigationCrowd", RunNavigationCrowdBenchmark },
+#endif
+    { "SceneSaveLoad", RunSceneSaveLoadBenchmark },
+#ifdef URHO3D_NETWORK
+    { "Replication", RunReplicationBenchmark },
+#endif
+};
+
+/// Number of heap allocations made by the process.
+static std::atomic<unsigned long long> numAllocations(0);
+
+int main(int argc, char** argv);
+bool Run(const Vector<String>& arguments);
+
+// Replace the global allocation functions to count heap allocations
+void* operator new(size_t size)
+{
+    ++numAllocations;
+    if (void* ptr = malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+unsigned long long GetNumAllocations()
+{
+    return numAllocations.load();
+}
+
+void BenchmarkReport::Add(const String& benchmark, const String& name, double value, const String& unit)
+{
+    entries_.Push(Entry{benchmark, name, value, unit, false});
+}
+
+void BenchmarkReport::Check(const String& benchmark, const String& name, double errors, const String& unit)
+{
+    entries_.Push(Entry{benchmark, name, errors, unit, true});
+}
+
+void BenchmarkReport::Print() const
+{
+    // String formatting does not support field widths, so format the columns with the C library
+    char line[256];
+    for (const Entry& entry : entries_)
+    {
+        snprintf(line, sizeof(line), "%-16s %-40s %12.3f %s%s", entry.benchmark_.CString(), entry.name_.CString(),
+            entry.value_, entry.unit_.CString(), entry.check_ && entry.value_ != 0.0 ? "  FAILED" : "");
+        PrintLine(line);
+    }
+}
+
+unsigned BenchmarkReport::GetNumFailures() const
+{
+    unsigned failures = 0;
+    for (const Entry& entry : entries_)
+    {
+        if (entry.check_ && entry.value_ != 0.0)
+            ++failures;
+    }
+
+    return failures;
+}
+
+bool BenchmarkReport::SaveJSON(Context* context, const String& fileName) const
+{
+    JSONFile file(context);
+    JSONValue& root = file.GetRoot();
+    root = JSONValue(JSON_ARRAY);
+    for (const Entry& entry : entries_)
+    {
+        JSONValue value(JSON_OBJECT);
+        value.Set("benchmark", entry.benchmark_);
+        value.Set("name", entry.name_);
+        value.Set("value", entry.value_);
+        value.Set("unit", entry.unit_);
+        if (entry.check_)
+            value.Set("passed", entry.value_ == 0.0);
+        root.Push(value);
+    }
+
+    return file.SaveFile(fileName);
+}
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+
+    // Fail the process if any correctness check failed, so that automation can detect it
+    return Run(arguments) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+bool Run(const Vector<String>& arguments)
+{
+    SharedPtr<Context> context(new Context());
+    // Time subsystem initializes the high-resolution timer frequency
+    context->RegisterSubsystem(new Time(context));
+    BenchmarkReport report;
+
+    // Benchmarks are selected by name; "-json <file>" additionally saves the report for automation
+    Vector<String> selected;
+    String jsonFileName;
+    for (unsigned i = 0; i < arguments.Size(); ++i)
+    {
+        if (arguments[i] == "-json" && i + 1 < arguments.Size())
+            jsonFileName = arguments[++i];
+        else
+            selected.Push(arguments[i]);
+    }
+
+    // Run all benchmarks unless some are selected
+    for (const BenchmarkDesc& desc : benchmarks)
+    {
+        if (selected.Empty() || selected.Contains(desc.name_))
+        {
+            PrintLine(ToString("Running %s", desc.name_));
+            desc.function_(context, report);
+        }
+    }
+
+    report.Print();
+    if (!jsonFileName.Empty() && !report.SaveJSON(context, jsonFileName))
+        ErrorExit("Could not save report to " + jsonFileName);
+
+    unsigned failures = report.GetNumFailures();
+    if (failures)
+        PrintLine(ToString("%u correctness checks failed", failures), true);
+    return failures == 0;
+}
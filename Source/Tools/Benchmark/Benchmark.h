@@ -0,0 +1,125 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+
+namespace Urho3D
+{
+
+class Context;
+
+}
+
+using namespace Urho3D;
+
+/// Collects measurements of benchmark cases.
+class BenchmarkReport
+{
+public:
+    /// Record a measured value.
+    void Add(const String& benchmark, const String& name, double value, const String& unit);
+    /// Record the number of errors found by a correctness check. A non-zero count fails the run.
+    void Check(const String& benchmark, const String& name, double errors, const String& unit);
+    /// Print all measurements to standard output. Failed checks are marked.
+    void Print() const;
+    /// Return number of failed correctness checks.
+    unsigned GetNumFailures() const;
+    /// Save all measurements to a JSON file. Return true if successful.
+    bool SaveJSON(Context* context, const String& fileName) const;
+
+private:
+    /// Single measurement.
+    struct Entry
+    {
+        /// Benchmark name.
+        String benchmark_;
+        /// Case name.
+        String name_;
+        /// Measured value.
+        double value_;
+        /// Unit of the value.
+        String unit_;
+        /// Whether the value is an error count of a correctness check.
+        bool check_;
+    };
+
+    /// Measurements in the order they were recorded.
+    Vector<Entry> entries_;
+};
+
+/// Return number of heap allocations made by the process so far.
+unsigned long long GetNumAllocations();
+
+/// Benchmark function.
+using BenchmarkFunction = void(*)(Context* context, BenchmarkReport& report);
+
+/// Measure WorkQueue throughput and scaling with the number of worker threads.
+void RunWorkQueueBenchmark(Context* context, BenchmarkReport& report);
+/// Compare the chained HashMap with the open addressing FlatHashMap.
+void RunHashMapBenchmark(Context* context, BenchmarkReport& report);
+/// Measure heap allocations and time of loading a scene with many nodes.
+void RunSceneLoadBenchmark(Context* context, BenchmarkReport& report);
+/// Compare sending events with VariantMap and typed parameters.
+void RunEventBenchmark(Context* context, BenchmarkReport& report);
+/// Compare octree queries testing the octant culling data in packets against testing drawable by drawable.
+void RunOctreeQueryBenchmark(Context* context, BenchmarkReport& report);
+/// Compare the spatial index types of the octree in static-heavy and dynamic-heavy open world scenes.
+void RunSpatialIndexBenchmark(Context* context, BenchmarkReport& report);
+/// Compare full octree queries against cached query results updated incrementally, and verify that they match.
+void RunQueryCacheBenchmark(Context* context, BenchmarkReport& report);
+/// Compare the radix sorts of batch queues, serial and split to worker threads, against comparison sorts.
+void RunBatchSortBenchmark(Context* context, BenchmarkReport& report);
+/// Compare the tiled occlusion rasterizer against the previous scanline rasterizer in speed and visibility results.
+void RunOcclusionBenchmark(Context* context, BenchmarkReport& report);
+/// Compare uploading all instance data per frame against the persistent instance data pool, and verify the pool ranges.
+void RunInstancingBenchmark(Context* context, BenchmarkReport& report);
+/// Compare culling a large static scene with and without hierarchical LOD clusters, and verify that the clusters cover the culled objects.
+void RunHLODBenchmark(Context* context, BenchmarkReport& report);
+/// Measure the skin matrix, bone bounding box and vertex morph updates of skinned models, serially and in work items.
+void RunSkinningBenchmark(Context* context, BenchmarkReport& report);
+/// Measure world transform updates of deep node hierarchies with recursive dirty marking and with the batched transform store.
+void RunTransformBenchmark(Context* context, BenchmarkReport& report);
+/// Compare updating many logic components with scene update events against the parallel logic update stage, and verify the results and deferred events.
+void RunLogicUpdateBenchmark(Context* context, BenchmarkReport& report);
+/// Compare spawning and despawning entities in the main thread against recording them from worker threads into the scene command buffer and playing back in bulk.
+void RunDeferredSpawnBenchmark(Context* context, BenchmarkReport& report);
+/// Compare loading a large scene and instantiating a prefab from the binary format against the columnar format, and verify that the results match.
+void RunColumnarSceneLoadBenchmark(Context* context, BenchmarkReport& report);
+/// Compare spawning and despawning 10000 bullets per second by instantiating XML and binary prefabs against the prefab resource and prefab pool, and verify that the live bullets match.
+void RunPrefabSpawnBenchmark(Context* context, BenchmarkReport& report);
+/// Measure frame phases of a headless engine updating many moving static objects.
+void RunHugeObjectCountBenchmark(Context* context, BenchmarkReport& report);
+/// Measure frame phases of a headless engine moving many static objects across octants.
+void RunMovingObjectsBenchmark(Context* context, BenchmarkReport& report);
+/// Measure frame phases of a headless engine animating skinned characters.
+void RunSkinnedCrowdBenchmark(Context* context, BenchmarkReport& report);
+/// Measure frame phases of a headless engine simulating a pile of rigid bodies.
+void RunPhysicsPileBenchmark(Context* context, BenchmarkReport& report);
+/// Measure frame phases of a headless engine moving a crowd of navigation agents.
+void RunNavigationCrowdBenchmark(Context* context, BenchmarkReport& report);
+/// Measure saving and loading a scene with many objects in a headless engine.
+void RunSceneSaveLoadBenchmark(Context* context, BenchmarkReport& report);
+/// Measure frame phases of a headless engine replicating a scene to a loopback client.
+void RunReplicationBenchmark(Context* context, BenchmarkReport& report);
@@ -0,0 +1,289 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/Light.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/ColumnarSceneFile.h>
+#include <Urho3D/Scene/Component.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Benchmark.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of nodes in the loaded scene.
+static const unsigned NUM_COLUMNAR_NODES = 20000;
+/// Number of times the scene is loaded per measurement.
+static const unsigned NUM_COLUMNAR_LOADS = 5;
+/// Number of prefab instantiations per measurement.
+static const unsigned NUM_COLUMNAR_INSTANCES = 2000;
+/// Number of child nodes in the prefab.
+static const unsigned NUM_PREFAB_CHILDREN = 4;
+
+/// Gameplay component with attributes of typical types.
+class ColumnarProp : public Component
+{
+    URHO3D_OBJECT(ColumnarProp, Component);
+
+public:
+    /// Construct.
+    explicit ColumnarProp(Context* context) :
+        Component(context),
+        health_(100.0f),
+        team_(0),
+        active_(true),
+        tint_(Color::WHITE),
+        target_(0)
+    {
+    }
+
+    /// Register object factory and attributes.
+    static void RegisterObject(Context* context)
+    {
+        context->RegisterFactory<ColumnarProp>();
+        URHO3D_ATTRIBUTE("Health", float, health_, 100.0f, AM_DEFAULT);
+        URHO3D_ATTRIBUTE("Team", int, team_, 0, AM_DEFAULT);
+        URHO3D_ATTRIBUTE("Active", bool, active_, true, AM_DEFAULT);
+        URHO3D_ATTRIBUTE("Offset", Vector3, offset_, Vector3::ZERO, AM_DEFAULT);
+        URHO3D_ATTRIBUTE("Label", String, label_, String::EMPTY, AM_DEFAULT);
+        URHO3D_ATTRIBUTE("Tint", Color, tint_, Color::WHITE, AM_DEFAULT);
+        URHO3D_ATTRIBUTE("Target", unsigned, target_, 0, AM_DEFAULT | AM_NODEID);
+    }
+
+    /// Health.
+    float health_;
+    /// Team index.
+    int team_;
+    /// Active flag.
+    bool active_;
+    /// Offset.
+    Vector3 offset_;
+    /// Label.
+    String label_;
+    /// Tint color.
+    Color tint_;
+    /// Target node ID.
+    unsigned target_;
+};
+
+/// Fill a node with the measured content.
+static void CreateColumnarContent(Node* node, unsigned index, Node* target)
+{
+    static const char* labels[] = { "Crate", "Barrel", "Enemy", "Pickup_Health", "Pickup_Ammo" };
+
+    node->SetPosition(Vector3((float)(index % 100), 0.0f, (float)(index / 100)));
+    node->SetRotation(Quaternion((float)(index % 360), Vector3::UP));
+    if (index % 4 == 0)
+        node->AddTag("Dynamic");
+
+    auto* prop = node->CreateComponent<ColumnarProp>();
+    prop->health_ = (float)(index % 100);
+    prop->team_ = (int)(index % 3);
+    prop->active_ = index % 2 == 0;
+    prop->offset_ = Vector3(0.0f, (float)(index % 5), 0.0f);
+    prop->label_ = labels[index % 5];
+    prop->tint_ = Color((index % 10) * 0.1f, 0.5f, 1.0f);
+    prop->target_ = target ? target->GetID() : 0;
+
+    if (index % 4 == 0)
+    {
+        auto* light = node->CreateComponent<Light>();
+        light->SetRange(5.0f + index % 10);
+        light->SetColor(Color(1.0f, 0.8f, 0.6f));
+    }
+}
+
+/// Return number of objects whose attributes, IDs or structure differ between two hierarchies.
+static unsigned CountMismatches(Node* a, Node* b)
+{
+    unsigned mismatches = 0;
+    const Vector<AttributeInfo>* attributes = a->GetAttributes();
+    for (unsigned i = 0; i < attributes->Size(); ++i)
+    {
+        if ((attributes->At(i).mode_ & AM_FILE) && a->GetAttribute(i) != b->GetAttribute(i))
+        {
+            ++mismatches;
+            break;
+        }
+    }
+
+    const Vector<SharedPtr<Component> >& componentsA = a->GetComponents();
+    const Vector<SharedPtr<Component> >& componentsB = b->GetComponents();
+    if (a->GetID() != b->GetID() || componentsA.Size() != componentsB.Size() || a->GetNumChildren() != b->GetNumChildren())
+        return mismatches + 1;
+
+    for (unsigned i = 0; i < componentsA.Size(); ++i)
+    {
+        Component* componentA = componentsA[i];
+        Component* componentB = componentsB[i];
+        if (componentA->GetType() != componentB->GetType() || componentA->GetID() != componentB->GetID())
+        {
+            ++mismatches;
+            continue;
+        }
+
+        attributes = componentA->GetAttributes();
+        for (unsigned j = 0; j < attributes->Size(); ++j)
+        {
+            if ((attributes->At(j).mode_ & AM_FILE) && componentA->GetAttribute(j) != componentB->GetAttribute(j))
+            {
+                ++mismatches;
+                break;
+            }
+        }
+    }
+
+    const Vector<SharedPtr<Node> >& childrenA = a->GetChildren();
+    const Vector<SharedPtr<Node> >& childrenB = b->GetChildren();
+    for (unsigned i = 0; i < childrenA.Size(); ++i)
+        mismatches += CountMismatches(childrenA[i], childrenB[i]);
+
+    return mismatches;
+}
+
+void RunColumnarSceneLoadBenchmark(Context* context, BenchmarkReport& report)
+{
+    RegisterSceneLibrary(context);
+    RegisterGraphicsLibrary(context);
+    ColumnarProp::RegisterObject(context);
+    // Light texture attributes are resolved through the resource cache
+    if (!context->GetSubsystem<FileSystem>())
+        context->RegisterSubsystem(new FileSystem(context));
+    if (!context->GetSubsystem<ResourceCache>())
+        context->RegisterSubsystem(new ResourceCache(context));
+
+    // Create the scene in groups of 100 nodes, where each node targets the first node of its group
+    SharedPtr<Scene> source(new Scene(context));
+    Node* group = nullptr;
+    Node* target = nullptr;
+    for (unsigned i = 0; i < NUM_COLUMNAR_NODES; ++i)
+    {
+        if (i % 100 == 0)
+        {
+            group = source->CreateChild("Group");
+            target = nullptr;
+        }
+
+        Node* node = group->CreateChild("Prop");
+        CreateColumnarContent(node, i, target);
+        if (!target)
+            target = node;
+    }
+
+    VectorBuffer binaryData;
+    source->Save(binaryData);
+    VectorBuffer columnarData;
+    source->SaveColumnar(columnarData);
+    report.Add("ColumnarSceneLoad", "Binary size", binaryData.GetSize() / 1024.0, "KB");
+    report.Add("ColumnarSceneLoad", "Columnar size", columnarData.GetSize() / 1024.0, "KB");
+
+    // Load the whole scene from each format. The opened columnar file is used in place, as it would be from a
+    // memory-mapped file
+    SharedPtr<Scene> binaryScene(new Scene(context));
+    SharedPtr<Scene> columnarScene(new Scene(context));
+    ColumnarSceneFile columnarFile(context);
+    long long binaryUsec = 0;
+    long long columnarUsec = 0;
+    long long inPlaceUsec = 0;
+    for (unsigned i = 0; i < NUM_COLUMNAR_LOADS; ++i)
+    {
+        HiresTimer timer;
+        MemoryBuffer binarySource(binaryData.GetData(), binaryData.GetSize());
+        binaryScene->Load(binarySource);
+        binaryUsec += timer.GetUSec(true);
+
+        MemoryBuffer columnarSource(columnarData.GetData(), columnarData.GetSize());
+        columnarScene->LoadColumnar(columnarSource);
+        columnarUsec += timer.GetUSec(true);
+
+        columnarFile.Open(columnarData.GetData(), columnarData.GetSize());
+        columnarScene->LoadColumnar(columnarFile);
+        inPlaceUsec += timer.GetUSec(false);
+    }
+
+    report.Add("ColumnarSceneLoad", "Binary load", binaryUsec / 1000.0 / NUM_COLUMNAR_LOADS, "ms");
+    report.Add("ColumnarSceneLoad", "Columnar load", columnarUsec / 1000.0 / NUM_COLUMNAR_LOADS, "ms");
+    report.Add("ColumnarSceneLoad", "Columnar load in place", inPlaceUsec / 1000.0 / NUM_COLUMNAR_LOADS, "ms");
+    report.Add("ColumnarSceneLoad", "Attribute blocks", columnarFile.GetNumBlocks(), "blocks");
+
+    // Instantiate a prefab repeatedly. The columnar prefab is opened once and reused
+    SharedPtr<Scene> prefabScene(new Scene(context));
+    Node* prefab = prefabScene->CreateChild("Prefab");
+    CreateColumnarContent(prefab, 0, nullptr);
+    for (unsigned i = 0; i < NUM_PREFAB_CHILDREN; ++i)
+        CreateColumnarContent(prefab->CreateChild("Part"), i + 1, prefab);
+
+    VectorBuffer binaryPrefab;
+    prefab->Save(binaryPrefab);
+    VectorBuffer columnarPrefab;
+    prefab->SaveColumnar(columnarPrefab);
+    ColumnarSceneFile prefabFile(context);
+    prefabFile.Open(columnarPrefab.GetData(), columnarPrefab.GetSize());
+
+    SharedPtr<Scene> binaryInstances(new Scene(context));
+    SharedPtr<Scene> columnarInstances(new Scene(context));
+    HiresTimer timer;
+    for (unsigned i = 0; i < NUM_COLUMNAR_INSTANCES; ++i)
+    {
+        MemoryBuffer prefabSource(binaryPrefab.GetData(), binaryPrefab.GetSize());
+        binaryInstances->Instantiate(prefabSource, Vector3((float)i, 0.0f, 0.0f), Quaternion::IDENTITY, LOCAL);
+    }
+    long long binaryInstantiateUsec = timer.GetUSec(true);
+    for (unsigned i = 0; i < NUM_COLUMNAR_INSTANCES; ++i)
+        columnarInstances->InstantiateColumnar(prefabFile, Vector3((float)i, 0.0f, 0.0f), Quaternion::IDENTITY, LOCAL);
+    long long columnarInstantiateUsec = timer.GetUSec(false);
+
+    report.Add("ColumnarSceneLoad", "Binary instantiate", binaryInstantiateUsec / (double)NUM_COLUMNAR_INSTANCES, "us");
+    report.Add("ColumnarSceneLoad", "Columnar instantiate", columnarInstantiateUsec / (double)NUM_COLUMNAR_INSTANCES, "us");
+
+    // Both formats must produce the same content, including the resolved node ID attributes of the instances
+    unsigned mismatches = CountMismatches(binaryScene, columnarScene) +
+        CountMismatches(binaryInstances, columnarInstances);
+    report.Check("ColumnarSceneLoad", "Mismatches", mismatches, "objects");
+
+    // Corrupt counts in the prefab file must be rejected instead of wrapping around in the size checks: a string length
+    // whose terminator wraps, a row count whose column size wraps, and one row more than there are objects
+    const auto* header = reinterpret_cast<const unsigned*>(columnarPrefab.GetData());
+    const unsigned stringTableOffset = header[4];
+    const unsigned blockTableOffset = header[12];
+    const unsigned numRows = reinterpret_cast<const unsigned*>(columnarPrefab.GetData() + blockTableOffset)[2];
+    const unsigned corruptions[][2] = {
+        { stringTableOffset + 4, 0xffffffff },
+        { blockTableOffset + 8, 0x40000000 },
+        { blockTableOffset + 8, numRows + 1 }
+    };
+    unsigned acceptedCorruptions = 0;
+    for (const auto& corruption : corruptions)
+    {
+        PODVector<unsigned char> corruptData(columnarPrefab.GetData(), columnarPrefab.GetSize());
+        memcpy(&corruptData[corruption[0]], &corruption[1], sizeof(unsigned));
+        ColumnarSceneFile corruptFile(context);
+        if (corruptFile.Open(corruptData.Buffer(), corruptData.Size()))
+            ++acceptedCorruptions;
+    }
+    report.Check("ColumnarSceneLoad", "Corrupt files accepted", acceptedCorruptions, "files");
+}
@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Container/FlatHashMap.h>
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Math/StringHash.h>
+
+#include "Benchmark.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of keys in the measured maps.
+static const unsigned NUM_KEYS = 100000;
+/// Number of lookups per measurement.
+static const unsigned NUM_LOOKUPS = 1000000;
+
+/// Sink preventing the lookups from being optimized away.
+static volatile unsigned containerSink = 0;
+
+/// Measure insertion, lookup, iteration and erasure of a map type and add the results to the report.
+template <class MapType> static void MeasureMap(const String& name, const PODVector<StringHash>& keys,
+    const PODVector<StringHash>& missingKeys, BenchmarkReport& report)
+{
+    MapType map;
+    HiresTimer timer;
+    for (unsigned i = 0; i < keys.Size(); ++i)
+        map[keys[i]] = i;
+    double insertNs = timer.GetUSec(true) * 1000.0 / keys.Size();
+
+    unsigned sum = 0;
+    for (unsigned i = 0; i < NUM_LOOKUPS; ++i)
+    {
+        typename MapType::ConstIterator it = map.Find(keys[i % keys.Size()]);
+        if (it != map.End())
+            sum += it->second_;
+    }
+    double hitNs = timer.GetUSec(true) * 1000.0 / NUM_LOOKUPS;
+
+    for (unsigned i = 0; i < NUM_LOOKUPS; ++i)
+        sum += map.Contains(missingKeys[i % missingKeys.Size()]) ? 1 : 0;
+    double missNs = timer.GetUSec(true) * 1000.0 / NUM_LOOKUPS;
+
+    for (typename MapType::ConstIterator i = map.Begin(); i != map.End(); ++i)
+        sum += i->second_;
+    double iterateNs = timer.GetUSec(true) * 1000.0 / keys.Size();
+
+    for (unsigned i = 0; i < keys.Size(); ++i)
+        map.Erase(keys[i]);
+    double eraseNs = timer.GetUSec(true) * 1000.0 / keys.Size();
+
+    containerSink = sum;
+    report.Add("HashMap", name + " insert", insertNs, "ns/op");
+    report.Add("HashMap", name + " find hit", hitNs, "ns/op");
+    report.Add("HashMap", name + " find miss", missNs, "ns/op");
+    report.Add("HashMap", name + " iterate", iterateNs, "ns/op");
+    report.Add("HashMap", name + " erase", eraseNs, "ns/op");
+}
+
+void RunHashMapBenchmark(Context* context, BenchmarkReport& report)
+{
+    SetRandomSeed(1);
+    PODVector<StringHash> keys;
+    PODVector<StringHash> missingKeys;
+    for (unsigned i = 0; i < NUM_KEYS; ++i)
+    {
+        keys.Push(StringHash(ToString("Key%u", i)));
+        missingKeys.Push(StringHash(ToString("Missing%u", i)));
+    }
+
+    // Shuffle so that lookups do not follow insertion order
+    for (unsigned i = keys.Size() - 1; i > 0; --i)
+        Swap(keys[i], keys[Rand() % (i + 1)]);
+
+    MeasureMap<HashMap<StringHash, unsigned> >("HashMap", keys, missingKeys, report);
+    MeasureMap<FlatHashMap<StringHash, unsigned> >("FlatHashMap", keys, missingKeys, report);
+
+    // All nodes of the measured map have been freed on this thread, so trimming must release every block of its pool
+    PoolAllocator* pool = GetPoolAllocator<HashMap<StringHash, unsigned>::Node>();
+    PoolAllocatorStats stats = pool->GetStats();
+    double releasedKB = pool->Trim() / 1024.0;
+    report.Add("HashMap", "HashMap node pool peak", stats.peakNodes_, "nodes");
+    report.Add("HashMap", "HashMap node pool trimmed", releasedKB, "KB");
+    report.Check("HashMap", "HashMap node pool bytes left after trim", (double)pool->GetStats().reservedBytes_, "bytes");
+}
@@ -0,0 +1,233 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Scene/Component.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneCommandBuffer.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#include "Benchmark.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of entities spawned per frame.
+static const unsigned NUM_SPAWNS_PER_FRAME = 2000;
+/// Number of frames an entity lives.
+static const unsigned SPAWN_LIFETIME_FRAMES = 5;
+/// Number of measured frames.
+static const unsigned NUM_SPAWN_FRAMES = 20;
+
+/// Component with one attribute that the spawning code sets.
+class SpawnMarker : public Component
+{
+    URHO3D_OBJECT(SpawnMarker, Component);
+
+public:
+    /// Construct.
+    explicit SpawnMarker(Context* context) :
+        Component(context),
+        value_(0)
+    {
+    }
+
+    /// Register object factory and attributes.
+    static void RegisterObject(Context* context)
+    {
+        context->RegisterFactory<SpawnMarker>();
+        URHO3D_ATTRIBUTE("Value", int, value_, 0, AM_DEFAULT);
+    }
+
+    /// Value.
+    int value_;
+};
+
+/// Counter of the scene's node and component added events.
+class SpawnEventCounter : public Object
+{
+    URHO3D_OBJECT(SpawnEventCounter, Object);
+
+public:
+    /// Construct.
+    SpawnEventCounter(Context* context, Scene* scene) :
+        Object(context),
+        numNodeEvents_(0),
+        numComponentEvents_(0)
+    {
+        SubscribeToEvent(scene, E_NODEADDED, URHO3D_HANDLER(SpawnEventCounter, HandleNodeAdded));
+        SubscribeToEvent(scene, E_COMPONENTADDED, URHO3D_HANDLER(SpawnEventCounter, HandleComponentAdded));
+    }
+
+    /// Handle node added.
+    void HandleNodeAdded(StringHash eventType, VariantMap& eventData) { ++numNodeEvents_; }
+    /// Handle component added.
+    void HandleComponentAdded(StringHash eventType, VariantMap& eventData) { ++numComponentEvents_; }
+
+    /// Number of node added events.
+    unsigned numNodeEvents_;
+    /// Number of component added events.
+    unsigned numComponentEvents_;
+};
+
+/// Return the spawn position of an entity.
+static Vector3 GetSpawnPosition(unsigned frame, unsigned index)
+{
+    return Vector3((float)(index % 100), (float)frame, (float)(index / 100));
+}
+
+/// Return a checksum of the entities in a scene.
+static Vector3 GetSpawnChecksum(Scene* scene, int& valueSum)
+{
+    Vector3 sum;
+    valueSum = 0;
+    const Vector<SharedPtr<Node> >& children = scene->GetChildren();
+    for (unsigned i = 0; i < children.Size(); ++i)
+    {
+        sum += children[i]->GetWorldPosition();
+        const Vector<SharedPtr<Node> >& trails = children[i]->GetChildren();
+        for (unsigned j = 0; j < trails.Size(); ++j)
+            sum += trails[j]->GetWorldPosition();
+        auto* marker = children[i]->GetComponent<SpawnMarker>();
+        if (marker)
+            valueSum += marker->value_;
+    }
+    return sum;
+}
+
+void RunDeferredSpawnBenchmark(Context* context, BenchmarkReport& report)
+{
+    RegisterSceneLibrary(context);
+    SpawnMarker::RegisterObject(context);
+    if (!context->GetSubsystem<WorkQueue>())
+        context->RegisterSubsystem(new WorkQueue(context));
+    // Use at least one worker thread so that the threaded path is exercised also on a single core
+    auto* workQueue = context->GetSubsystem<WorkQueue>();
+    if (!workQueue->GetNumThreads())
+        workQueue->CreateThreads(Max(GetNumLogicalCPUs(), 2U) - 1);
+
+    // Two scenes: the first spawns and despawns entities directly in the main thread, the second records the same changes
+    // from worker threads into the command buffer
+    SharedPtr<Scene> scenes[2];
+    SharedPtr<SpawnEventCounter> counters[2];
+    for (unsigned s = 0; s < 2; ++s)
+    {
+        scenes[s] = new Scene(context);
+        counters[s] = new SpawnEventCounter(context, scenes[s]);
+    }
+
+    SceneCommandBuffer* commands = scenes[1]->GetCommandBuffer();
+    const unsigned sceneID = scenes[1]->GetID();
+    Vector<PODVector<Node*> > directSpawns(NUM_SPAWN_FRAMES);
+    Vector<PODVector<unsigned> > deferredSpawns(NUM_SPAWN_FRAMES);
+    long long directUSec = 0;
+    long long recordUSec = 0;
+    long long playbackUSec = 0;
+    unsigned unreferenced = 0;
+
+    for (unsigned frame = 0; frame < NUM_SPAWN_FRAMES; ++frame)
+    {
+        HiresTimer timer;
+        for (unsigned i = 0; i < NUM_SPAWNS_PER_FRAME; ++i)
+        {
+            Node* node = scenes[0]->CreateChild("Bullet");
+            node->SetPosition(GetSpawnPosition(frame, i));
+            node->CreateComponent<SpawnMarker>()->value_ = (int)i;
+            node->CreateChild("Trail")->SetPosition(Vector3::BACK);
+            directSpawns[frame].Push(node);
+        }
+        if (frame >= SPAWN_LIFETIME_FRAMES)
+        {
+            const PODVector<Node*>& expired = directSpawns[frame - SPAWN_LIFETIME_FRAMES];
+            for (unsigned i = 0; i < expired.Size(); ++i)
+                expired[i]->Remove();
+        }
+        directUSec += timer.GetUSec(true);
+
+        // Reserve the IDs in the main thread, so that the workers can refer to the nodes they create
+        commands->ReserveIDs(NUM_SPAWNS_PER_FRAME * 2, NUM_SPAWNS_PER_FRAME);
+        deferredSpawns[frame].Resize(NUM_SPAWNS_PER_FRAME);
+        timer.Reset();
+        workQueue->ParallelFor(NUM_SPAWNS_PER_FRAME, 64, [&](unsigned begin, unsigned end, unsigned threadIndex)
+        {
+            for (unsigned i = begin; i < end; ++i)
+            {
+                unsigned nodeID = commands->CreateNode(sceneID, "Bullet");
+                commands->SetTransform(nodeID, GetSpawnPosition(frame, i));
+                unsigned markerID = commands->CreateComponent(nodeID, SpawnMarker::GetTypeStatic());
+                commands->SetAttribute(markerID, "Value", (int)i);
+                unsigned trailID = commands->CreateNode(nodeID, "Trail");
+                commands->SetTransform(trailID, Vector3::BACK);
+                deferredSpawns[frame][i] = nodeID;
+            }
+        });
+        if (frame >= SPAWN_LIFETIME_FRAMES)
+        {
+            const PODVector<unsigned>& expired = deferredSpawns[frame - SPAWN_LIFETIME_FRAMES];
+            workQueue->ParallelFor(expired.Size(), 64, [&](unsigned begin, unsigned end, unsigned threadIndex)
+            {
+                for (unsigned i = begin; i < end; ++i)
+                    commands->RemoveNode(expired[i]);
+            });
+        }
+        recordUSec += timer.GetUSec(true);
+
+        commands->Playback();
+        playbackUSec += timer.GetUSec(false);
+
+        for (unsigned i = 0; i < NUM_SPAWNS_PER_FRAME; ++i)
+        {
+            if (!scenes[1]->GetNode(deferredSpawns[frame][i]))
+                ++unreferenced;
+        }
+    }
+
+    int valueSums[2];
+    Vector3 positionSums[2];
+    for (unsigned s = 0; s < 2; ++s)
+        positionSums[s] = GetSpawnChecksum(scenes[s], valueSums[s]);
+    unsigned mismatches = unreferenced;
+    if (scenes[0]->GetNumChildren() != scenes[1]->GetNumChildren() || valueSums[0] != valueSums[1] ||
+        positionSums[0] != positionSums[1])
+        ++mismatches;
+
+    const double numSpawns = (double)NUM_SPAWNS_PER_FRAME;
+    report.Add("DeferredSpawn", "Worker threads", (double)workQueue->GetNumThreads(), "threads");
+    report.Add("DeferredSpawn", "Spawns per frame", numSpawns, "entities");
+    report.Add("DeferredSpawn", "Direct spawn and despawn", directUSec / 1000.0 / NUM_SPAWN_FRAMES, "ms");
+    report.Add("DeferredSpawn", "Deferred recording", recordUSec / 1000.0 / NUM_SPAWN_FRAMES, "ms");
+    report.Add("DeferredSpawn", "Deferred playback", playbackUSec / 1000.0 / NUM_SPAWN_FRAMES, "ms");
+    report.Add("DeferredSpawn", "Direct node added events", counters[0]->numNodeEvents_ / numSpawns / NUM_SPAWN_FRAMES,
+        "per entity");
+    report.Add("DeferredSpawn", "Deferred node added events", counters[1]->numNodeEvents_ / numSpawns / NUM_SPAWN_FRAMES,
+        "per entity");
+    report.Add("DeferredSpawn", "Direct component added events",
+        counters[0]->numComponentEvents_ / numSpawns / NUM_SPAWN_FRAMES, "per entity");
+    report.Add("DeferredSpawn", "Deferred component added events",
+        counters[1]->numComponentEvents_ / numSpawns / NUM_SPAWN_FRAMES, "per entity");
+    report.Check("DeferredSpawn", "Mismatches", (double)mismatches, "entities");
+    report.Check("DeferredSpawn", "Missing added events",
+        (double)(counters[0]->numNodeEvents_ + counters[0]->numComponentEvents_) -
+        (counters[1]->numNodeEvents_ + counters[1]->numComponentEvents_), "events");
+}
@@ -0,0 +1,629 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/PerformanceCounters.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/Engine/EngineDefs.h>
+#include <Urho3D/Graphics/AnimatedModel.h>
+#include <Urho3D/Graphics/AnimationController.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/Octree.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+#ifdef URHO3D_NAVIGATION
+#include <Urho3D/Navigation/CrowdAgent.h>
+#include <Urho3D/Navigation/CrowdManager.h>
+#include <Urho3D/Navigation/Navigable.h>
+#include <Urho3D/Navigation/NavigationMesh.h>
+#endif
+#ifdef URHO3D_NETWORK
+#include <Urho3D/Network/Connection.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Network/NetworkEvents.h>
+#endif
+#ifdef URHO3D_PHYSICS
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/PhysicsEvents.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+#endif
+
+#include "Benchmark.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Fixed timestep of the benchmark frames.
+static const float BENCHMARK_TIME_STEP = 1.0f / 60.0f;
+/// Number of frames run before measuring.
+static const unsigned NUM_WARMUP_FRAMES = 30;
+/// Number of measured frames.
+static const unsigned NUM_MEASURED_FRAMES = 300;
+/// Frame phase histogram bucket size in milliseconds.
+static const float PHASE_BUCKET_SIZE = 0.01f;
+/// Number of frame phase histogram buckets.
+static const unsigned PHASE_NUM_BUCKETS = 10000;
+
+/// Number of boxes in the huge object count scene.
+static const unsigned NUM_HUGE_OBJECTS = 20000;
+/// Number of boxes in the moving objects scene.
+static const unsigned NUM_MOVING_OBJECTS = 50000;
+/// Number of animated characters in the skinned crowd scene.
+static const unsigned NUM_SKINNED_CHARACTERS = 400;
+/// Number of rigid bodies in the physics pile scene.
+static const unsigned NUM_PHYSICS_BODIES = 1000;
+/// Number of agents in the navigation crowd scene.
+static const unsigned NUM_CROWD_AGENTS = 200;
+/// Number of replicated nodes in the network replication scene.
+static const unsigned NUM_REPLICATED_NODES = 1000;
+/// Number of scene saves and loads in the scene save and load benchmark.
+static const unsigned NUM_SCENE_SAVE_LOADS = 3;
+/// Port of the loopback server.
+static const unsigned short REPLICATION_PORT = 2345;
+/// Maximum time to wait for the loopback client to receive the scene.
+static const unsigned REPLICATION_CONNECT_TIMEOUT_MS = 10000;
+
+/// Frame phase. The phase starts when its event is sent and ends when the next phase starts.
+struct FramePhase
+{
+    /// Name.
+    const char* name_;
+    /// Event starting the phase. Zero for the phase starting the frame.
+    StringHash eventType_;
+    /// Whether the event is sent by a scene.
+    bool sceneEvent_;
+};
+
+/// Frame phases in the order of their start events.
+static const FramePhase framePhases[] = {
+    { "BeginFrame", StringHash::ZERO, false },
+    { "Update", E_UPDATE, false },
+    { "SceneUpdate", E_SCENEUPDATE, true },
+    { "SceneSubsystemUpdate", E_SCENESUBSYSTEMUPDATE, true },
+    { "ScenePostUpdate", E_SCENEPOSTUPDATE, true },
+    { "PostUpdate", E_POSTUPDATE, false },
+    { "RenderUpdate", E_RENDERUPDATE, false },
+    { "PostRenderUpdate", E_POSTRENDERUPDATE, false },
+};
+
+/// Number of frame phases.
+static const unsigned NUM_FRAME_PHASES = sizeof(framePhases) / sizeof(framePhases[0]);
+
+/// Measures the duration of the frame phases by timestamping the events that start them. Phases are only measured
+/// correctly when the profiler subscribes to the events before the subsystems and components that handle them, so
+/// it must be created before the scenes and its scenes tracked right after creating them.
+class FrameProfiler : public Object
+{
+    URHO3D_OBJECT(FrameProfiler, Object);
+
+public:
+    /// Construct.
+    explicit FrameProfiler(Context* context) :
+        Object(context),
+        currentPhase_(0),
+        lastPhaseTime_(0)
+    {
+        auto* counters = GetSubsystem<PerformanceCounters>();
+        for (const FramePhase& phase : framePhases)
+            phaseHistograms_.Push(counters->GetHistogram(ToString("Benchmark.%s", phase.name_), PHASE_BUCKET_SIZE, PHASE_NUM_BUCKETS));
+        frameHistogram_ = counters->GetHistogram("Benchmark.Frame", PHASE_BUCKET_SIZE, PHASE_NUM_BUCKETS);
+        phaseTimes_.Resize(NUM_FRAME_PHASES);
+
+        for (unsigned i = 0; i < NUM_FRAME_PHASES; ++i)
+        {
+            if (framePhases[i].eventType_ != StringHash::ZERO && !framePhases[i].sceneEvent_)
+                SubscribeToEvent(framePhases[i].eventType_, [this, i](StringHash, VariantMap&) { BeginPhase(i); });
+        }
+
+#ifdef URHO3D_PHYSICS
+        // Physics steps are nested in the scene subsystem update
+        physicsHistogram_ = counters->GetHistogram("Benchmark.Physics", PHASE_BUCKET_SIZE, PHASE_NUM_BUCKETS);
+        SubscribeToEvent(E_PHYSICSPRESTEP, [this](StringHash, VariantMap&) { nestedStartTime_ = timer_.GetUSec(false); });
+        SubscribeToEvent(E_PHYSICSPOSTSTEP, [this](StringHash, VariantMap&) { physicsTime_ += timer_.GetUSec(false) - nestedStartTime_; });
+#endif
+#ifdef URHO3D_NETWORK
+        // Network update is nested in the render update
+        networkHistogram_ = counters->GetHistogram("Benchmark.Network", PHASE_BUCKET_SIZE, PHASE_NUM_BUCKETS);
+        SubscribeToEvent(E_NETWORKUPDATE, [this](StringHash, VariantMap&) { nestedStartTime_ = timer_.GetUSec(false); });
+        SubscribeToEvent(E_NETWORKUPDATESENT, [this](StringHash, VariantMap&) { networkTime_ += timer_.GetUSec(false) - nestedStartTime_; });
+#endif
+    }
+
+    /// Measure the scene update phases of a scene. Must be called before creating the scene content.
+    void TrackScene(Scene* scene)
+    {
+        for (unsigned i = 0; i < NUM_FRAME_PHASES; ++i)
+        {
+            if (framePhases[i].sceneEvent_)
+                SubscribeToEvent(scene, framePhases[i].eventType_, [this, i](StringHash, VariantMap&) { BeginPhase(i); });
+        }
+    }
+
+    /// Start measuring a frame.
+    void BeginFrame()
+    {
+        for (unsigned i = 0; i < NUM_FRAME_PHASES; ++i)
+            phaseTimes_[i] = 0;
+        physicsTime_ = 0;
+        networkTime_ = 0;
+        currentPhase_ = 0;
+        lastPhaseTime_ = 0;
+        timer_.Reset();
+    }
+
+    /// Finish measuring a frame and record the phase durations.
+    void EndFrame()
+    {
+        long long frameTime = timer_.GetUSec(false);
+        phaseTimes_[currentPhase_] += frameTime - lastPhaseTime_;
+
+        for (unsigned i = 0; i < NUM_FRAME_PHASES; ++i)
+            phaseHistograms_[i]->Record(phaseTimes_[i] / 1000.0);
+        frameHistogram_->Record(frameTime / 1000.0);
+        if (physicsHistogram_)
+            physicsHistogram_->Record(physicsTime_ / 1000.0);
+        if (networkHistogram_)
+            networkHistogram_->Record(networkTime_ / 1000.0);
+    }
+
+    /// Add mean and 95th percentile of the measured phases to the report.
+    void Report(const String& benchmark, BenchmarkReport& report) const
+    {
+        ReportHistogram(benchmark, frameHistogram_, report);
+        for (const PerformanceCounter* histogram : phaseHistograms_)
+            ReportHistogram(benchmark, histogram, report);
+        if (physicsHistogram_)
+            ReportHistogram(benchmark, physicsHistogram_, report);
+        if (networkHistogram_)
+            ReportHistogram(benchmark, networkHistogram_, report);
+
+        auto* counters = GetSubsystem<PerformanceCounters>();
+        report.Add(benchmark, "Events", counters->FindCounter("Events")->GetMean(), "events/frame");
+        if (PerformanceCounter* moved = counters->FindCounter("MovedDrawables"))
+            report.Add(benchmark, "MovedDrawables", moved->GetMean(), "drawables/frame");
+    }
+
+private:
+    /// Finish the current phase and start a new one.
+    void BeginPhase(unsigned index)
+    {
+        long long time = timer_.GetUSec(false);
+        phaseTimes_[currentPhase_] += time - lastPhaseTime_;
+        currentPhase_ = index;
+        lastPhaseTime_ = time;
+    }
+
+    /// Add mean and 95th percentile of a histogram to the report.
+    static void ReportHistogram(const String& benchmark, const PerformanceCounter* histogram, BenchmarkReport& report)
+    {
+        // Strip the common prefix from the phase name
+        String name = histogram->GetName().Substring(histogram->GetName().Find('.') + 1);
+        report.Add(benchmark, name + " mean", histogram->GetMean(), "ms");
+        report.Add(benchmark, name + " p95", histogram->GetPercentile(95.0f), "ms");
+    }
+
+    /// Frame timer.
+    HiresTimer timer_;
+    /// Durations of the phases in the current frame in microseconds.
+    PODVector<long long> phaseTimes_;
+    /// Histograms of the phase durations.
+    PODVector<PerformanceCounter*> phaseHistograms_;
+    /// Histogram of the frame durations.
+    PerformanceCounter* frameHistogram_;
+    /// Histogram of the physics step durations. Null if physics is not compiled in.
+    PerformanceCounter* physicsHistogram_{};
+    /// Histogram of the network update durations. Null if networking is not compiled in.
+    PerformanceCounter* networkHistogram_{};
+    /// Current phase.
+    unsigned currentPhase_;
+    /// Start time of the current phase.
+    long long lastPhaseTime_;
+    /// Start time of the current nested measurement.
+    long long nestedStartTime_{};
+    /// Duration of the physics steps in the current frame.
+    long long physicsTime_{};
+    /// Duration of the network updates in the current frame.
+    long long networkTime_{};
+};
+
+/// Object owning an event handler of a benchmark scene. Each object can have only one handler per event and sender, so
+/// the handlers are not added to the frame profiler.
+class BenchmarkHandler : public Object
+{
+    URHO3D_OBJECT(BenchmarkHandler, Object);
+
+public:
+    /// Construct and subscribe to an event. Subscribe to the event from any sender if sender is null.
+    BenchmarkHandler(Context* context, Object* sender, StringHash eventType,
+        const std::function<void(StringHash, VariantMap&)>& function) :
+        Object(context)
+    {
+        if (sender)
+            SubscribeToEvent(sender, eventType, function);
+        else
+            SubscribeToEvent(eventType, function);
+    }
+};
+
+/// Headless engine running benchmark scenes with a fixed timestep.
+class HeadlessEngine
+{
+public:
+    /// Construct and initialize the engine.
+    HeadlessEngine() :
+        context_(new Context()),
+        engine_(new Engine(context_))
+    {
+        VariantMap parameters;
+        parameters[EP_HEADLESS] = true;
+        parameters[EP_LOG_LEVEL] = LOG_WARNING;
+        parameters[EP_LOG_QUIET] = true;
+        parameters[EP_RESOURCE_PATHS] = "Data;CoreData";
+        parameters[EP_SOUND] = false;
+        initialized_ = engine_->Initialize(parameters);
+
+        // Do not sleep for frame limiting, the timestep is fixed
+        engine_->SetMaxFps(0);
+        profiler_ = new FrameProfiler(context_);
+    }
+
+    /// Return whether the engine was initialized.
+    bool IsInitialized() const { return initialized_; }
+    /// Return the engine context.
+    Context* GetContext() const { return context_; }
+    /// Return the frame profiler.
+    FrameProfiler* GetProfiler() const { return profiler_; }
+
+    /// Create a scene with an octree whose update phases are measured.
+    SharedPtr<Scene> CreateScene()
+    {
+        SharedPtr<Scene> scene(new Scene(context_));
+        profiler_->TrackScene(scene);
+        scene->CreateComponent<Octree>();
+        return scene;
+    }
+
+    /// Run frames without measuring them.
+    void Warmup(unsigned numFrames = NUM_WARMUP_FRAMES)
+    {
+        for (unsigned i = 0; i < numFrames; ++i)
+            RunFrame();
+    }
+
+    /// Run measured frames and add the frame phase timings to the report.
+    void Measure(const String& benchmark, BenchmarkReport& report, unsigned numFrames = NUM_MEASURED_FRAMES)
+    {
+        context_->GetSubsystem<PerformanceCounters>()->Reset();
+        for (unsigned i = 0; i < numFrames; ++i)
+        {
+            profiler_->BeginFrame();
+            RunFrame();
+            profiler_->EndFrame();
+        }
+        profiler_->Report(benchmark, report);
+    }
+
+    /// Run one frame with the fixed timestep.
+    void RunFrame()
+    {
+        engine_->SetNextTimeStep(BENCHMARK_TIME_STEP);
+        engine_->RunFrame();
+    }
+
+private:
+    /// Engine context.
+    SharedPtr<Context> context_;
+    /// Engine.
+    SharedPtr<Engine> engine_;
+    /// Frame profiler.
+    SharedPtr<FrameProfiler> profiler_;
+    /// Whether the engine was initialized.
+    bool initialized_;
+};
+
+/// Create a grid of static boxes.
+static void CreateBoxGrid(Scene* scene, unsigned numBoxes, PODVector<Node*>& boxNodes)
+{
+    auto* cache = scene->GetSubsystem<ResourceCache>();
+    auto* boxModel = cache->GetResource<Model>("Models/Box.mdl");
+
+    const unsigned gridSize = 200;
+    for (unsigned i = 0; i < numBoxes; ++i)
+    {
+        Node* boxNode = scene->CreateChild("Box");
+        boxNode->SetPosition(Vector3((float)(i % gridSize) - gridSize * 0.5f, 0.0f, (float)(i / gridSize)));
+        boxNode->SetScale(0.25f);
+        auto* boxObject = boxNode->CreateComponent<StaticModel>();
+        boxObject->SetModel(boxModel);
+        boxNodes.Push(boxNode);
+    }
+}
+
+void RunHugeObjectCountBenchmark(Context* context, BenchmarkReport& report)
+{
+    HeadlessEngine engine;
+    if (!engine.IsInitialized())
+        return;
+
+    SharedPtr<Scene> scene = engine.CreateScene();
+    PODVector<Node*> boxNodes;
+    CreateBoxGrid(scene, NUM_HUGE_OBJECTS, boxNodes);
+
+    // Rotate all boxes each frame, which moves them in the octree
+    Quaternion rotation(10.0f * BENCHMARK_TIME_STEP, 20.0f * BENCHMARK_TIME_STEP, 30.0f * BENCHMARK_TIME_STEP);
+    BenchmarkHandler rotator(engine.GetContext(), scene, E_SCENEUPDATE, [&](StringHash, VariantMap&)
+    {
+        for (Node* boxNode : boxNodes)
+            boxNode->Rotate(rotation);
+    });
+
+    engine.Warmup();
+    engine.Measure("HugeObjectCount", report);
+}
+
+void RunMovingObjectsBenchmark(Context* context, BenchmarkReport& report)
+{
+    HeadlessEngine engine;
+    if (!engine.IsInitialized())
+        return;
+
+    SharedPtr<Scene> scene = engine.CreateScene();
+    PODVector<Node*> boxNodes;
+    CreateBoxGrid(scene, NUM_MOVING_OBJECTS, boxNodes);
+
+    PODVector<Vector3> basePositions;
+    for (Node* boxNode : boxNodes)
+        basePositions.Push(boxNode->GetPosition());
+
+    // Move the boxes on circles of varying size, so that they keep crossing octant boundaries
+    float time = 0.0f;
+    BenchmarkHandler mover(engine.GetContext(), scene, E_SCENEUPDATE, [&](StringHash, VariantMap&)
+    {
+        time += BENCHMARK_TIME_STEP;
+        for (unsigned i = 0; i < boxNodes.Size(); ++i)
+        {
+            float radius = (float)(i % 16 + 1);
+            float angle = time * 90.0f + (float)(i % 360);
+            boxNodes[i]->SetPosition(basePositions[i] + Vector3(Cos(angle) * radius, 0.0f, Sin(angle) * radius));
+        }
+    });
+
+    engine.Warmup();
+    engine.Measure("MovingObjects", report);
+}
+
+void RunSkinnedCrowdBenchmark(Context* context, BenchmarkReport& report)
+{
+    HeadlessEngine engine;
+    if (!engine.IsInitialized())
+        return;
+
+    SharedPtr<Scene> scene = engine.CreateScene();
+    auto* cache = scene->GetSubsystem<ResourceCache>();
+    auto* jackModel = cache->GetResource<Model>("Models/Jack.mdl");
+
+    const unsigned gridSize = 20;
+    for (unsigned i = 0; i < NUM_SKINNED_CHARACTERS; ++i)
+    {
+        Node* jackNode = scene->CreateChild("Jack");
+        jackNode->SetPosition(Vector3((float)(i % gridSize) * 2.0f, 0.0f, (float)(i / gridSize) * 2.0f));
+        auto* jackObject = jackNode->CreateComponent<AnimatedModel>();
+        jackObject->SetModel(jackModel);
+        // There are no views in headless mode, so animate regardless of visibility
+        jackObject->SetUpdateInvisible(true);
+        auto* controller = jackNode->CreateComponent<AnimationController>();
+        controller->PlayExclusive("Models/Jack_Walk.ani", 0, true);
+        // Desynchronize the characters deterministically
+        controller->SetTime("Models/Jack_Walk.ani", (float)i * 0.1f);
+    }
+
+    engine.Warmup();
+    engine.Measure("SkinnedCrowd", report);
+}
+
+#ifdef URHO3D_PHYSICS
+void RunPhysicsPileBenchmark(Context* context, BenchmarkReport& report)
+{
+    HeadlessEngine engine;
+    if (!engine.IsInitialized())
+        return;
+
+    SharedPtr<Scene> scene = engine.CreateScene();
+    scene->CreateComponent<PhysicsWorld>();
+
+    Node* floorNode = scene->CreateChild("Floor");
+    floorNode->CreateComponent<RigidBody>();
+    floorNode->CreateComponent<CollisionShape>()->SetStaticPlane();
+
+    // Drop a column of boxes that collapses into a pile; positions are offset slightly so that the boxes topple
+    const unsigned layerSize = 10;
+    for (unsigned i = 0; i < NUM_PHYSICS_BODIES; ++i)
+    {
+        unsigned layer = i / (layerSize * layerSize);
+        unsigned index = i % (layerSize * layerSize);
+        Node* boxNode = scene->CreateChild("Box");
+        boxNode->SetPosition(Vector3((float)(index % layerSize) * 1.1f + layer * 0.05f, 1.0f + layer * 1.1f,
+            (float)(index / layerSize) * 1.1f));
+        auto* body = boxNode->CreateComponent<RigidBody>();
+        body->SetMass(1.0f);
+        body->SetFriction(0.75f);
+        boxNode->CreateComponent<CollisionShape>()->SetBox(Vector3::ONE);
+    }
+
+    engine.Warmup();
+    engine.Measure("PhysicsPile", report);
+}
+#endif
+
+#ifdef URHO3D_NAVIGATION
+void RunNavigationCrowdBenchmark(Context* context, BenchmarkReport& report)
+{
+    HeadlessEngine engine;
+    if (!engine.IsInitialized())
+        return;
+
+    SharedPtr<Scene> scene = engine.CreateScene();
+    auto* cache = scene->GetSubsystem<ResourceCache>();
+
+    Node* floorNode = scene->CreateChild("Floor");
+    floorNode->SetScale(Vector3(100.0f, 1.0f, 100.0f));
+    floorNode->CreateComponent<StaticModel>()->SetModel(cache->GetResource<Model>("Models/Plane.mdl"));
+
+    // Scatter obstacles on a grid with holes for the agents to path around
+    auto* boxModel = cache->GetResource<Model>("Models/Box.mdl");
+    for (int x = -4; x <= 4; ++x)
+    {
+        for (int z = -4; z <= 4; ++z)
+        {
+            if ((x + z) % 3 == 0)
+                continue;
+            Node* boxNode = scene->CreateChild("Obstacle");
+            boxNode->SetPosition(Vector3(x * 10.0f, 1.0f, z * 10.0f));
+            boxNode->SetScale(Vector3(4.0f, 2.0f, 4.0f));
+            boxNode->CreateComponent<StaticModel>()->SetModel(boxModel);
+        }
+    }
+
+    scene->CreateComponent<Navigable>();
+    auto* navMesh = scene->CreateComponent<NavigationMesh>();
+    navMesh->SetPadding(Vector3(0.0f, 10.0f, 0.0f));
+    HiresTimer buildTimer;
+    if (!navMesh->Build())
+        return;
+    report.Add("NavigationCrowd", "Navigation mesh build", buildTimer.GetUSec(false) / 1000.0, "ms");
+
+    auto* crowdManager = scene->CreateComponent<CrowdManager>();
+    crowdManager->SetMaxAgents(NUM_CROWD_AGENTS);
+
+    // Agents start on one side of the area and walk to the mirrored position on the other side
+    const unsigned rowSize = 20;
+    for (unsigned i = 0; i < NUM_CROWD_AGENTS; ++i)
+    {
+        Vector3 position((float)(i % rowSize) * 2.0f - rowSize, 0.0f, -45.0f + (float)(i / rowSize) * 2.0f);
+        Node* agentNode = scene->CreateChild("Agent");
+        agentNode->SetPosition(position);
+        auto* agent = agentNode->CreateComponent<CrowdAgent>();
+        agent->SetRadius(0.5f);
+        agent->SetMaxSpeed(5.0f);
+        agent->SetTargetPosition(Vector3(-position.x_, 0.0f, -position.z_));
+    }
+
+    engine.Warmup();
+    engine.Measure("NavigationCrowd", report);
+}
+#endif
+
+void RunSceneSaveLoadBenchmark(Context* context, BenchmarkReport& report)
+{
+    HeadlessEngine engine;
+    if (!engine.IsInitialized())
+        return;
+
+    SharedPtr<Scene> scene = engine.CreateScene();
+    PODVector<Node*> boxNodes;
+    CreateBoxGrid(scene, NUM_HUGE_OBJECTS, boxNodes);
+
+    VectorBuffer data;
+    long long saveTime = 0;
+    long long loadTime = 0;
+    for (unsigned i = 0; i < NUM_SCENE_SAVE_LOADS; ++i)
+    {
+        data.Clear();
+        HiresTimer timer;
+        scene->Save(data);
+        saveTime += timer.GetUSec(true);
+        data.Seek(0);
+        scene->Load(data);
+        loadTime += timer.GetUSec(false);
+    }
+
+    report.Add("SceneSaveLoad", "Save", saveTime / 1000.0 / NUM_SCENE_SAVE_LOADS, "ms");
+    report.Add("SceneSaveLoad", "Load", loadTime / 1000.0 / NUM_SCENE_SAVE_LOADS, "ms");
+    report.Add("SceneSaveLoad", "Size", data.GetSize() / 1024.0, "KB");
+
+    // The scene was replaced by loading, so measure the frames of the loaded scene
+    engine.Warmup();
+    engine.Measure("SceneSaveLoad", report);
+}
+
+#ifdef URHO3D_NETWORK
+void RunReplicationBenchmark(Context* context, BenchmarkReport& report)
+{
+    HeadlessEngine engine;
+    if (!engine.IsInitialized())
+        return;
+
+    SharedPtr<Scene> serverScene = engine.CreateScene();
+    SharedPtr<Scene> clientScene = engine.CreateScene();
+    PODVector<Node*> boxNodes;
+    CreateBoxGrid(serverScene, NUM_REPLICATED_NODES, boxNodes);
+
+    // Move the replicated nodes each frame so that they are sent to the client
+    Quaternion rotation(0.0f, 90.0f * BENCHMARK_TIME_STEP, 0.0f);
+    BenchmarkHandler rotator(engine.GetContext(), serverScene, E_SCENEUPDATE, [&](StringHash, VariantMap&)
+    {
+        for (Node* boxNode : boxNodes)
+            boxNode->Rotate(rotation);
+    });
+
+    auto* network = engine.GetContext()->GetSubsystem<Network>();
+    BenchmarkHandler connectHandler(engine.GetContext(), nullptr, E_CLIENTCONNECTED, [&](StringHash, VariantMap& eventData)
+    {
+        auto* connection = static_cast<Connection*>(eventData[ClientConnected::P_CONNECTION].GetPtr());
+        connection->SetScene(serverScene);
+    });
+
+    if (!network->StartServer(REPLICATION_PORT) || !network->Connect("127.0.0.1", REPLICATION_PORT, clientScene))
+        return;
+
+    // Run frames until the client has received the scene. Networking is asynchronous, so this takes a wall clock time
+    Timer connectTimer;
+    while (!network->GetServerConnection() || !network->GetServerConnection()->IsSceneLoaded() ||
+        clientScene->GetNumChildren() < NUM_REPLICATED_NODES)
+    {
+        if (connectTimer.GetMSec(false) > REPLICATION_CONNECT_TIMEOUT_MS)
+        {
+            URHO3D_LOGERROR("Loopback client did not receive the scene");
+            return;
+        }
+        engine.RunFrame();
+        Time::Sleep(1);
+    }
+    report.Add("Replication", "Connect and load scene", connectTimer.GetMSec(false), "ms");
+
+    engine.Warmup();
+    engine.Measure("Replication", report);
+    Connection* clientConnection = network->GetClientConnections()[0];
+    report.Add("Replication", "Server bytes out", clientConnection->GetBytesOutPerSec() / 1024.0f, "KB/s");
+
+    network->Disconnect();
+    network->StopServer();
+}
+#endif
@@ -0,0 +1,151 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Timer.h>
+
+#include "Benchmark.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of objects receiving the measured event.
+static const unsigned NUM_EVENT_RECEIVERS = 1000;
+/// Number of measured event sends.
+static const unsigned NUM_EVENT_SENDS = 1000;
+
+/// Event receiver accumulating the timestep.
+class BenchmarkEventReceiver : public Object
+{
+    URHO3D_OBJECT(BenchmarkEventReceiver, Object);
+
+public:
+    /// Construct.
+    explicit BenchmarkEventReceiver(Context* context) :
+        Object(context)
+    {
+    }
+
+    /// Handle update event with VariantMap parameters.
+    void HandleUpdate(StringHash eventType, VariantMap& eventData)
+    {
+        using namespace Update;
+        elapsedTime_ += eventData[P_TIMESTEP].GetFloat();
+    }
+
+    /// Handle update event with typed parameters.
+    void HandleTypedUpdate(UpdateEventData& eventData)
+    {
+        elapsedTime_ += eventData.timeStep_;
+    }
+
+    /// Accumulated timestep.
+    float elapsedTime_{};
+};
+
+/// Event sender.
+class BenchmarkEventSender : public Object
+{
+    URHO3D_OBJECT(BenchmarkEventSender, Object);
+
+public:
+    /// Construct.
+    explicit BenchmarkEventSender(Context* context) :
+        Object(context)
+    {
+    }
+};
+
+/// Send the update event repeatedly and add the duration and allocation count per send to the report. Return allocations
+/// per send.
+static double MeasureEventSend(BenchmarkEventSender* sender, const String& name, bool typed, BenchmarkReport& report)
+{
+    unsigned long long startAllocations = GetNumAllocations();
+    HiresTimer timer;
+
+    for (unsigned i = 0; i < NUM_EVENT_SENDS; ++i)
+    {
+        if (typed)
+        {
+            UpdateEventData eventData;
+            eventData.timeStep_ = 0.01f;
+            sender->SendEvent(eventData);
+        }
+        else
+        {
+            using namespace Update;
+
+            VariantMap& eventData = sender->GetEventDataMap();
+            eventData[P_TIMESTEP] = 0.01f;
+            sender->SendEvent(E_UPDATE, eventData);
+        }
+    }
+
+    double usec = timer.GetUSec(false);
+    unsigned long long allocations = GetNumAllocations() - startAllocations;
+    report.Add("Events", name + " send", usec / NUM_EVENT_SENDS, "us/send");
+    report.Add("Events", name + " allocations", (double)allocations / NUM_EVENT_SENDS, "allocs/send");
+    return (double)allocations / NUM_EVENT_SENDS;
+}
+
+void RunEventBenchmark(Context* context, BenchmarkReport& report)
+{
+    SharedPtr<BenchmarkEventSender> sender(new BenchmarkEventSender(context));
+    Vector<SharedPtr<BenchmarkEventReceiver> > receivers;
+    for (unsigned i = 0; i < NUM_EVENT_RECEIVERS; ++i)
+        receivers.Push(SharedPtr<BenchmarkEventReceiver>(new BenchmarkEventReceiver(context)));
+
+    // VariantMap handlers, the only kind available before typed events
+    for (BenchmarkEventReceiver* receiver : receivers)
+        receiver->SubscribeToEvent(sender, E_UPDATE, new EventHandlerImpl<BenchmarkEventReceiver>(receiver,
+            &BenchmarkEventReceiver::HandleUpdate));
+    MeasureEventSend(sender, "VariantMap to VariantMap", false, report);
+    MeasureEventSend(sender, "Typed to VariantMap", true, report);
+
+    // Typed handlers
+    for (BenchmarkEventReceiver* receiver : receivers)
+        receiver->SubscribeToEvent(sender, &BenchmarkEventReceiver::HandleTypedUpdate);
+    MeasureEventSend(sender, "VariantMap to typed", false, report);
+    double typedAllocations = MeasureEventSend(sender, "Typed to typed", true, report);
+    report.Check("Events", "Typed to typed sends allocating", typedAllocations, "allocs/send");
+
+    // Also non-specific receivers, which the specific receivers must not receive twice from
+    SharedPtr<BenchmarkEventReceiver> nonSpecificReceiver(new BenchmarkEventReceiver(context));
+    nonSpecificReceiver->SubscribeToEvent(&BenchmarkEventReceiver::HandleTypedUpdate);
+    receivers[0]->SubscribeToEvent(&BenchmarkEventReceiver::HandleTypedUpdate);
+    for (BenchmarkEventReceiver* receiver : receivers)
+        receiver->elapsedTime_ = 0.0f;
+    double mixedAllocations = MeasureEventSend(sender, "Typed to specific and non-specific", true, report);
+    report.Check("Events", "Typed to specific and non-specific sends allocating", mixedAllocations, "allocs/send");
+
+    unsigned wrongReceives = 0;
+    const float expectedTime = 0.01f * NUM_EVENT_SENDS;
+    for (BenchmarkEventReceiver* receiver : receivers)
+    {
+        if (Abs(receiver->elapsedTime_ - expectedTime) > 0.01f)
+            ++wrongReceives;
+    }
+    if (Abs(nonSpecificReceiver->elapsedTime_ - expectedTime) > 0.01f)
+        ++wrongReceives;
+    report.Check("Events", "Receivers not reached exactly once", wrongReceives, "receivers");
+}
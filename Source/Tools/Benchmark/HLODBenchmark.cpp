@@ -0,0 +1,331 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/HLODBuilder.h>
+#include <Urho3D/Graphics/HLODCluster.h>
+#include <Urho3D/Graphics/IndexBuffer.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/Octree.h>
+#include <Urho3D/Graphics/OctreeQuery.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/Graphics/VertexBuffer.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Benchmark.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of static objects in the scene.
+static const unsigned NUM_HLOD_OBJECTS = 10000;
+/// Half size of the area the objects are spread over.
+static const float HLOD_AREA_SIZE = 1000.0f;
+/// Size of the cluster grid cells.
+static const float HLOD_CLUSTER_SIZE = 100.0f;
+/// Distance beyond which the clusters draw their proxies.
+static const float HLOD_SWITCH_DISTANCE = 200.0f;
+/// Number of measured camera positions.
+static const unsigned NUM_HLOD_VIEWS = 100;
+/// Rings and segments of the object sphere model.
+static const unsigned HLOD_SPHERE_DETAIL = 8;
+
+/// Create a UV sphere model with shadowed buffers, so that it can be baked into proxies.
+static SharedPtr<Model> CreateSphereModel(Context* context, unsigned detail)
+{
+    PODVector<float> vertexData;
+    PODVector<unsigned short> indexData;
+    for (unsigned ring = 0; ring <= detail; ++ring)
+    {
+        float latitude = 180.0f * ring / detail - 90.0f;
+        for (unsigned segment = 0; segment <= detail; ++segment)
+        {
+            float longitude = 360.0f * segment / detail;
+            Vector3 normal(Cos(latitude) * Cos(longitude), Sin(latitude), Cos(latitude) * Sin(longitude));
+            Vector3 position = normal * 0.5f;
+            vertexData.Insert(vertexData.End(), position.Data(), position.Data() + 3);
+            vertexData.Insert(vertexData.End(), normal.Data(), normal.Data() + 3);
+            vertexData.Push((float)segment / detail);
+            vertexData.Push((float)ring / detail);
+
+            if (ring < detail && segment < detail)
+            {
+                auto v0 = (unsigned short)(ring * (detail + 1) + segment);
+                auto v1 = (unsigned short)(v0 + detail + 1);
+                indexData.Push(v0);
+                indexData.Push(v1);
+                indexData.Push(v0 + 1);
+                indexData.Push(v0 + 1);
+                indexData.Push(v1);
+                indexData.Push(v1 + 1);
+            }
+        }
+    }
+
+    unsigned numVertices = (detail + 1) * (detail + 1);
+    SharedPtr<VertexBuffer> vb(new VertexBuffer(context));
+    vb->SetShadowed(true);
+    vb->SetSize(numVertices, MASK_POSITION | MASK_NORMAL | MASK_TEXCOORD1);
+    vb->SetData(vertexData.Buffer());
+    SharedPtr<IndexBuffer> ib(new IndexBuffer(context));
+    ib->SetShadowed(true);
+    ib->SetSize(indexData.Size(), false);
+    ib->SetData(indexData.Buffer());
+
+    SharedPtr<Geometry> geometry(new Geometry(context));
+    geometry->SetVertexBuffer(0, vb);
+    geometry->SetIndexBuffer(ib);
+    geometry->SetDrawRange(TRIANGLE_LIST, 0, indexData.Size());
+
+    SharedPtr<Model> model(new Model(context));
+    Vector<SharedPtr<VertexBuffer> > vertexBuffers;
+    Vector<SharedPtr<IndexBuffer> > indexBuffers;
+    PODVector<unsigned> emptyMorphRange;
+    vertexBuffers.Push(vb);
+    indexBuffers.Push(ib);
+    model->SetVertexBuffers(vertexBuffers, emptyMorphRange, emptyMorphRange);
+    model->SetIndexBuffers(indexBuffers);
+    model->SetNumGeometries(1);
+    model->SetGeometry(0, 0, geometry);
+    model->SetBoundingBox(BoundingBox(-0.5f, 0.5f));
+    return model;
+}
+
+/// Return the number of triangles drawn by a drawable.
+static unsigned GetNumTriangles(Drawable* drawable)
+{
+    unsigned numTriangles = 0;
+    const Vector<SourceBatch>& batches = drawable->GetBatches();
+    for (unsigned i = 0; i < batches.Size(); ++i)
+    {
+        if (batches[i].geometry_)
+            numTriangles += batches[i].geometry_->GetIndexCount() / 3;
+    }
+    return numTriangles;
+}
+
+void RunHLODBenchmark(Context* context, BenchmarkReport& report)
+{
+    RegisterSceneLibrary(context);
+    RegisterGraphicsLibrary(context);
+    if (!context->GetSubsystem<WorkQueue>())
+        context->RegisterSubsystem(new WorkQueue(context));
+    // Materials fall back to the default technique from the resource cache
+    if (!context->GetSubsystem<FileSystem>())
+        context->RegisterSubsystem(new FileSystem(context));
+    if (!context->GetSubsystem<ResourceCache>())
+        context->RegisterSubsystem(new ResourceCache(context));
+
+    SharedPtr<Scene> scene(new Scene(context));
+    auto* octree = scene->CreateComponent<Octree>();
+    octree->SetSize(BoundingBox(-HLOD_AREA_SIZE, HLOD_AREA_SIZE), 8);
+
+    SharedPtr<Model> sphereModel = CreateSphereModel(context, HLOD_SPHERE_DETAIL);
+    SharedPtr<Material> materials[2] = { SharedPtr<Material>(new Material(context)), SharedPtr<Material>(new Material(context)) };
+
+    SetRandomSeed(1);
+    Node* objectRoot = scene->CreateChild("Objects");
+    for (unsigned i = 0; i < NUM_HLOD_OBJECTS; ++i)
+    {
+        Node* node = objectRoot->CreateChild("Object");
+        node->SetPosition(Vector3(Random(-HLOD_AREA_SIZE, HLOD_AREA_SIZE) * 0.95f, Random(0.0f, 10.0f),
+            Random(-HLOD_AREA_SIZE, HLOD_AREA_SIZE) * 0.95f));
+        node->SetRotation(Quaternion(Random(0.0f, 360.0f), Vector3::UP));
+        node->SetScale(Vector3(Random(1.0f, 6.0f), Random(1.0f, 6.0f), Random(1.0f, 6.0f)));
+        auto* staticModel = node->CreateComponent<StaticModel>();
+        staticModel->SetModel(sphereModel);
+        staticModel->SetMaterial(materials[i % 2]);
+    }
+
+    Node* cameraNode = scene->CreateChild("Camera");
+    auto* camera = cameraNode->CreateComponent<Camera>();
+    camera->SetFarClip(2000.0f);
+    camera->SetAspectRatio(16.0f / 9.0f);
+    FrameInfo frame;
+    frame.camera_ = camera;
+    octree->Update(frame);
+
+    Vector<Vector3> cameraPositions;
+    Vector<Quaternion> cameraRotations;
+    Vector<Ray> pickRays;
+    for (unsigned i = 0; i < NUM_HLOD_VIEWS; ++i)
+    {
+        cameraPositions.Push(Vector3(Random(-HLOD_AREA_SIZE, HLOD_AREA_SIZE) * 0.8f, 20.0f,
+            Random(-HLOD_AREA_SIZE, HLOD_AREA_SIZE) * 0.8f));
+        cameraRotations.Push(Quaternion(Random(0.0f, 20.0f), Random(0.0f, 360.0f), 0.0f));
+        // Pick towards a random object, which may be far enough to be replaced by its cluster
+        Node* target = objectRoot->GetChild((unsigned)Rand() % NUM_HLOD_OBJECTS);
+        pickRays.Push(Ray(cameraPositions[i], (target->GetWorldPosition() - cameraPositions[i]).Normalized()));
+    }
+
+    // Culled drawables, batches and triangles of the views without HLOD, kept for verifying the HLOD views
+    Vector<PODVector<Drawable*> > referenceResults(NUM_HLOD_VIEWS);
+    PODVector<Drawable*> referencePicks(NUM_HLOD_VIEWS);
+    PODVector<RayQueryResult> rayResult;
+    unsigned long long referenceBatches = 0;
+    unsigned long long referenceTriangles = 0;
+    long long referenceUSec = 0;
+    for (unsigned i = 0; i < NUM_HLOD_VIEWS; ++i)
+    {
+        cameraNode->SetTransform(cameraPositions[i], cameraRotations[i]);
+        FrustumOctreeQuery query(referenceResults[i], camera->GetFrustum(), DRAWABLE_GEOMETRY);
+        HiresTimer timer;
+        octree->GetDrawables(query);
+        referenceUSec += timer.GetUSec(false);
+        for (unsigned j = 0; j < referenceResults[i].Size(); ++j)
+        {
+            referenceBatches += referenceResults[i][j]->GetBatches().Size();
+            referenceTriangles += GetNumTriangles(referenceResults[i][j]);
+        }
+
+        RayOctreeQuery rayQuery(rayResult, pickRays[i], RAY_TRIANGLE, 2000.0f, DRAWABLE_GEOMETRY);
+        octree->RaycastSingle(rayQuery);
+        referencePicks[i] = rayResult.Size() ? rayResult[0].drawable_ : nullptr;
+    }
+
+    SharedPtr<HLODBuilder> builder(new HLODBuilder(context));
+    builder->SetClusterSize(HLOD_CLUSTER_SIZE);
+    builder->SetSwitchDistance(HLOD_SWITCH_DISTANCE);
+    HiresTimer buildTimer;
+    unsigned numClusters = builder->Build(objectRoot, scene->CreateChild("HLOD"));
+    report.Add("HLOD", "Build", buildTimer.GetUSec(false) / 1000.0, "ms");
+    report.Add("HLOD", "Clusters", numClusters, "clusters");
+
+    PODVector<HLODCluster*> clusters;
+    scene->GetComponents<HLODCluster>(clusters, true);
+    HashMap<Node*, HLODCluster*> memberClusters;
+    unsigned long long memberTriangles = 0;
+    unsigned long long proxyTriangles = 0;
+    for (unsigned i = 0; i < clusters.Size(); ++i)
+    {
+        for (unsigned j = 0; j < clusters[i]->GetNumMemberNodes(); ++j)
+        {
+            memberClusters[clusters[i]->GetMemberNode(j)] = clusters[i];
+            memberTriangles += sphereModel->GetGeometry(0, 0)->GetIndexCount() / 3;
+        }
+        Model* proxyModel = clusters[i]->GetModel();
+        for (unsigned j = 0; j < proxyModel->GetNumGeometries(); ++j)
+            proxyTriangles += proxyModel->GetGeometry(j, 0)->GetIndexCount() / 3;
+    }
+    report.Add("HLOD", "Proxy triangle ratio", memberTriangles ? (double)proxyTriangles / memberTriangles : 0.0, "");
+
+    // Switch the clusters for each view, then cull. A source object culled without HLOD must either be culled as itself
+    // or be represented by its culled, active cluster
+    PODVector<Drawable*> result;
+    unsigned long long hlodBatches = 0;
+    unsigned long long hlodTriangles = 0;
+    unsigned long long referenceDrawables = 0;
+    unsigned long long hlodDrawables = 0;
+    long long hlodUSec = 0;
+    long long switchUSec = 0;
+    unsigned mismatches = 0;
+    unsigned pickMismatches = 0;
+    unsigned proxyPicks = 0;
+    for (unsigned i = 0; i < NUM_HLOD_VIEWS; ++i)
+    {
+        cameraNode->SetTransform(cameraPositions[i], cameraRotations[i]);
+        HiresTimer switchTimer;
+        octree->Update(frame);
+        switchUSec += switchTimer.GetUSec(false);
+
+        FrustumOctreeQuery query(result, camera->GetFrustum(), DRAWABLE_GEOMETRY);
+        HiresTimer timer;
+        octree->GetDrawables(query);
+        hlodUSec += timer.GetUSec(false);
+
+        HashSet<Drawable*> culled;
+        for (unsigned j = 0; j < result.Size(); ++j)
+        {
+            culled.Insert(result[j]);
+            hlodBatches += result[j]->GetBatches().Size();
+            hlodTriangles += GetNumTriangles(result[j]);
+        }
+        for (unsigned j = 0; j < referenceResults[i].Size(); ++j)
+        {
+            Drawable* drawable = referenceResults[i][j];
+            if (culled.Contains(drawable))
+                continue;
+            HLODCluster* cluster = memberClusters[drawable->GetNode()];
+            if (!cluster || !cluster->IsProxyActive() || !culled.Contains(cluster))
+                ++mismatches;
+        }
+        referenceDrawables += referenceResults[i].Size();
+        hlodDrawables += result.Size();
+
+        // Picking must return the same source object, also when its cluster draws the proxy
+        RayOctreeQuery rayQuery(rayResult, pickRays[i], RAY_TRIANGLE, 2000.0f, DRAWABLE_GEOMETRY);
+        octree->RaycastSingle(rayQuery);
+        Drawable* pick = rayResult.Size() ? rayResult[0].drawable_ : nullptr;
+        if (pick != referencePicks[i])
+            ++pickMismatches;
+        if (pick && pick->IsHLODHidden())
+            ++proxyPicks;
+    }
+
+    // With a second camera viewing the scene, for example a minimap, a proxy may be active only where the cluster is beyond
+    // the switch distance from both cameras
+    Node* secondCameraNode = scene->CreateChild("SecondCamera");
+    auto* secondCamera = secondCameraNode->CreateComponent<Camera>();
+    secondCamera->SetFarClip(2000.0f);
+    unsigned secondCameraMismatches = 0;
+    for (unsigned i = 0; i < NUM_HLOD_VIEWS; ++i)
+    {
+        cameraNode->SetTransform(cameraPositions[i], cameraRotations[i]);
+        secondCameraNode->SetTransform(cameraPositions[(i + 1) % NUM_HLOD_VIEWS], cameraRotations[(i + 1) % NUM_HLOD_VIEWS]);
+        octree->AddViewCamera(secondCamera);
+        octree->Update(frame);
+
+        for (unsigned j = 0; j < clusters.Size(); ++j)
+        {
+            HLODCluster* cluster = clusters[j];
+            if (!cluster->IsProxyActive())
+                continue;
+            Vector3 center = cluster->GetWorldBoundingBox().Center();
+            float minDistance = cluster->GetSwitchDistance() * (1.0f - HLOD_SWITCH_HYSTERESIS);
+            if (camera->GetLodDistance(camera->GetDistance(center), 1.0f, cluster->GetLodBias()) <= minDistance ||
+                secondCamera->GetLodDistance(secondCamera->GetDistance(center), 1.0f, cluster->GetLodBias()) <= minDistance)
+                ++secondCameraMismatches;
+        }
+    }
+
+    report.Add("HLOD", "Culled drawables without HLOD", (double)referenceDrawables / NUM_HLOD_VIEWS, "drawables/view");
+    report.Add("HLOD", "Culled drawables with HLOD", (double)hlodDrawables / NUM_HLOD_VIEWS, "drawables/view");
+    report.Add("HLOD", "Batches without HLOD", (double)referenceBatches / NUM_HLOD_VIEWS, "batches/view");
+    report.Add("HLOD", "Batches with HLOD", (double)hlodBatches / NUM_HLOD_VIEWS, "batches/view");
+    report.Add("HLOD", "Triangles without HLOD", (double)referenceTriangles / NUM_HLOD_VIEWS, "triangles/view");
+    report.Add("HLOD", "Triangles with HLOD", (double)hlodTriangles / NUM_HLOD_VIEWS, "triangles/view");
+    report.Add("HLOD", "Query without HLOD", referenceUSec / 1000.0 / NUM_HLOD_VIEWS, "ms");
+    report.Add("HLOD", "Query with HLOD", hlodUSec / 1000.0 / NUM_HLOD_VIEWS, "ms");
+    report.Add("HLOD", "Switch and update", switchUSec / 1000.0 / NUM_HLOD_VIEWS, "ms");
+    report.Check("HLOD", "Mismatches", mismatches, "drawables");
+    report.Add("HLOD", "Picks behind an active proxy", proxyPicks, "rays");
+    report.Check("HLOD", "Pick mismatches", pickMismatches, "rays");
+    report.Check("HLOD", "Proxies within reach of a second camera", secondCameraMismatches, "clusters");
+}
@@ -0,0 +1,213 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/InstanceDataPool.h>
+#include <Urho3D/Math/Random.h>
+
+#include "Benchmark.h"
+
+#include <cstring>
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of instanced geometries.
+static const unsigned NUM_INSTANCING_GROUPS = 50;
+/// Number of instances of each geometry.
+static const unsigned NUM_GROUP_INSTANCES = 400;
+/// Percentage of instances moving every frame.
+static const unsigned MOVING_INSTANCE_PERCENT = 5;
+/// Number of simulated frames.
+static const unsigned NUM_INSTANCING_FRAMES = 300;
+/// Width of the instance area along the camera path.
+static const float INSTANCE_AREA_SIZE = 1000.0f;
+/// Width of the visible window.
+static const float VISIBLE_WINDOW_SIZE = 500.0f;
+/// Camera movement per frame in the moving camera scenario.
+static const float CAMERA_STEP = 1.0f;
+
+/// Simulated instance.
+struct SimulatedInstance
+{
+    /// Position along the camera path.
+    float position_;
+    /// Moving flag.
+    bool moving_;
+};
+
+/// Collect the instances of a group inside a window, sorted front to back like BatchQueue does. The moving instances are marked changed like View does for the drawables the octree reports changed.
+static void CollectInstances(PODVector<InstanceData>& instances, const PODVector<SimulatedInstance>& simulated,
+    const PODVector<Matrix3x4>& transforms, unsigned group, float windowStart, float windowSize)
+{
+    instances.Clear();
+    for (unsigned i = group * NUM_GROUP_INSTANCES; i < (group + 1) * NUM_GROUP_INSTANCES; ++i)
+    {
+        float distance = simulated[i].position_ - windowStart;
+        if (distance >= 0.0f && distance < windowSize)
+        {
+            instances.Push(InstanceData(&transforms[i], nullptr, distance));
+            instances.Back().changed_ = simulated[i].moving_;
+        }
+    }
+    Sort(instances.Begin(), instances.End(), [](const InstanceData& lhs, const InstanceData& rhs) { return lhs.distance_ < rhs.distance_; });
+}
+
+/// Return whether the instance data of a batch group drawn from the pool holds the group's instances in order.
+static bool CheckPlacedInstances(const InstanceDataPool& pool, unsigned start, const PODVector<InstanceData>& instances)
+{
+    const unsigned stride = pool.GetStride();
+    for (unsigned i = 0; i < instances.Size(); ++i)
+    {
+        if (memcmp(pool.GetData() + (start + i) * stride, instances[i].worldTransform_, stride))
+            return false;
+    }
+    return true;
+}
+
+/// Simulate frames of instanced drawing with a camera moving at the given speed and report the upload amounts.
+static void RunInstancingScenario(BenchmarkReport& report, const String& name, float cameraStep)
+{
+    const unsigned numInstances = NUM_INSTANCING_GROUPS * NUM_GROUP_INSTANCES;
+    const unsigned stride = sizeof(Matrix3x4);
+
+    SetRandomSeed(1);
+    PODVector<SimulatedInstance> simulated(numInstances);
+    PODVector<Matrix3x4> transforms(numInstances);
+    for (unsigned i = 0; i < numInstances; ++i)
+    {
+        simulated[i].position_ = Random(0.0f, INSTANCE_AREA_SIZE);
+        simulated[i].moving_ = (unsigned)Rand() % 100 < MOVING_INSTANCE_PERCENT;
+        transforms[i] = Matrix3x4(Vector3(simulated[i].position_, 0.0f, Random(-50.0f, 50.0f)), Quaternion::IDENTITY, 1.0f);
+    }
+
+    // Each frame draws a scene pass and a shadow pass with an overlapping but different set of instances. The camera
+    // slides along the instance area, so that instances enter and leave the view
+    InstanceDataPool pool;
+    pool.SetStride(stride);
+    PODVector<unsigned char> frameBuffer(numInstances * 2 * stride);
+    PODVector<unsigned char> persistentBuffer;
+    PODVector<InstanceData> instances;
+    PODVector<InstanceRange> dirtyRanges;
+
+    unsigned long long previousBytes = 0;
+    unsigned long long persistentBytes = 0;
+    unsigned long long previousDrawCalls = 0;
+    unsigned long long persistentDrawCalls = 0;
+    long long previousUSec = 0;
+    long long persistentUSec = 0;
+    unsigned mismatches = 0;
+
+    for (unsigned frame = 0; frame < NUM_INSTANCING_FRAMES; ++frame)
+    {
+        float cameraPosition = frame * cameraStep;
+        pool.BeginFrame(frame);
+
+        for (unsigned i = 0; i < numInstances; ++i)
+        {
+            if (simulated[i].moving_)
+                transforms[i].SetTranslation(transforms[i].Translation() + Vector3(0.0f, 0.01f, 0.0f));
+        }
+
+        for (unsigned pass = 0; pass < 2; ++pass)
+        {
+            float windowStart = pass ? cameraPosition + VISIBLE_WINDOW_SIZE * 0.2f : cameraPosition;
+            for (unsigned group = 0; group < NUM_INSTANCING_GROUPS; ++group)
+            {
+                CollectInstances(instances, simulated, transforms, group, windowStart, VISIBLE_WINDOW_SIZE);
+                if (instances.Empty())
+                    continue;
+
+                // The previous path copies every instance to the per-frame buffer
+                {
+                    HiresTimer timer;
+                    unsigned char* dest = frameBuffer.Buffer();
+                    for (unsigned i = 0; i < instances.Size(); ++i)
+                        memcpy(dest + i * stride, instances[i].worldTransform_, stride);
+                    previousUSec += timer.GetUSec(false);
+                    previousBytes += instances.Size() * stride;
+                    ++previousDrawCalls;
+                }
+
+                // The persistent path copies the group to the per-frame buffer only if the pool does not take it
+                {
+                    HiresTimer timer;
+                    unsigned start = pool.PlaceInstances(group * 2 + pass, instances.Buffer(), instances.Size());
+                    if (start == M_MAX_UNSIGNED)
+                    {
+                        unsigned char* dest = frameBuffer.Buffer();
+                        for (unsigned i = 0; i < instances.Size(); ++i)
+                            memcpy(dest + i * stride, instances[i].worldTransform_, stride);
+                        persistentBytes += instances.Size() * stride;
+                    }
+                    persistentUSec += timer.GetUSec(false);
+                    ++persistentDrawCalls;
+
+                    // Check the slots of the group against its instances here, and the pool data against the uploaded
+                    // copy below
+                    if (start != M_MAX_UNSIGNED && !CheckPlacedInstances(pool, start, instances))
+                        ++mismatches;
+                }
+            }
+        }
+
+        // Upload the dirty slots to the simulated vertex buffer, which must then equal the pool
+        {
+            HiresTimer timer;
+            if (pool.GetNumSlots() > persistentBuffer.Size() / stride)
+            {
+                persistentBuffer.Resize(NextPowerOfTwo(pool.GetNumSlots()) * stride);
+                pool.MarkAllDirty();
+            }
+            pool.GetDirtyRanges(dirtyRanges);
+            for (unsigned i = 0; i < dirtyRanges.Size(); ++i)
+            {
+                memcpy(persistentBuffer.Buffer() + dirtyRanges[i].start_ * stride, pool.GetData() + dirtyRanges[i].start_ * stride,
+                    dirtyRanges[i].count_ * stride);
+                persistentBytes += dirtyRanges[i].count_ * stride;
+            }
+            persistentUSec += timer.GetUSec(false);
+        }
+
+        if (memcmp(persistentBuffer.Buffer(), pool.GetData(), pool.GetNumSlots() * stride))
+            ++mismatches;
+    }
+
+    report.Add("Instancing", name + " per-frame upload", previousBytes / 1024.0 / NUM_INSTANCING_FRAMES, "KB/frame");
+    report.Add("Instancing", name + " persistent upload", persistentBytes / 1024.0 / NUM_INSTANCING_FRAMES, "KB/frame");
+    report.Add("Instancing", name + " per-frame draw calls", (double)previousDrawCalls / NUM_INSTANCING_FRAMES, "calls/frame");
+    report.Add("Instancing", name + " persistent draw calls", (double)persistentDrawCalls / NUM_INSTANCING_FRAMES, "calls/frame");
+    report.Add("Instancing", name + " per-frame CPU time", previousUSec / 1000.0 / NUM_INSTANCING_FRAMES, "ms/frame");
+    report.Add("Instancing", name + " persistent CPU time", persistentUSec / 1000.0 / NUM_INSTANCING_FRAMES, "ms/frame");
+    report.Add("Instancing", name + " pool slots", pool.GetNumSlots(), "slots");
+    report.Check("Instancing", name + " mismatches", mismatches, "errors");
+    report.Check("Instancing", name + " extra persistent draw calls",
+        persistentDrawCalls > previousDrawCalls ? (double)(persistentDrawCalls - previousDrawCalls) / NUM_INSTANCING_FRAMES : 0.0,
+        "calls/frame");
+}
+
+void RunInstancingBenchmark(Context* context, BenchmarkReport& report)
+{
+    report.Add("Instancing", "Instances", NUM_INSTANCING_GROUPS * NUM_GROUP_INSTANCES, "instances");
+    RunInstancingScenario(report, "Still camera", 0.0f);
+    RunInstancingScenario(report, "Moving camera", CAMERA_STEP);
+}
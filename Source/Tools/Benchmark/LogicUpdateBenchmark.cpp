@@ -0,0 +1,245 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Scene/LogicComponent.h>
+#include <Urho3D/Scene/LogicScheduler.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneCommandBuffer.h>
+
+#include "Benchmark.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of AI agents.
+static const unsigned NUM_LOGIC_AGENTS = 20000;
+/// Number of agents per squad leader.
+static const unsigned LOGIC_SQUAD_SIZE = 100;
+/// Number of steering iterations per agent update.
+static const unsigned LOGIC_STEERING_ITERATIONS = 16;
+/// Number of measured frames.
+static const unsigned NUM_LOGIC_FRAMES = 30;
+
+/// Agent reached a waypoint.
+URHO3D_EVENT(E_AGENTWAYPOINT, AgentWaypoint)
+{
+    URHO3D_PARAM(P_INDEX, Index);                  // unsigned
+}
+
+/// AI agent that wanders on the XZ plane and reports reached waypoints with deferred events.
+class LogicAgent : public LogicComponent
+{
+    URHO3D_OBJECT(LogicAgent, LogicComponent);
+
+public:
+    /// Construct.
+    explicit LogicAgent(Context* context) :
+        LogicComponent(context),
+        index_(0),
+        heading_(0.0f),
+        distance_(0.0f)
+    {
+        SetUpdateEventMask(USE_UPDATE);
+    }
+
+    /// Steer and move.
+    void Update(float timeStep) override
+    {
+        float phase = (float)index_ * 0.37f;
+        for (unsigned i = 0; i < LOGIC_STEERING_ITERATIONS; ++i)
+            heading_ += Sin(phase + heading_ * 13.0f + (float)i) * 0.05f;
+
+        Vector3 direction(Cos(heading_), 0.0f, Sin(heading_));
+        node_->Translate(direction * timeStep, TS_WORLD);
+
+        // Events can not be sent from worker threads, so defer them to the sync point
+        distance_ += timeStep;
+        if (distance_ >= 1.0f)
+        {
+            distance_ -= 1.0f;
+            // The preallocated event data map is shared by the threads, so use a local map
+            VariantMap eventData;
+            eventData[AgentWaypoint::P_INDEX] = index_;
+            GetScene()->GetCommandBuffer()->SendEvent(this, E_AGENTWAYPOINT, eventData);
+        }
+    }
+
+    /// Agent index.
+    unsigned index_;
+    /// Heading angle.
+    float heading_;
+    /// Distance since the last waypoint.
+    float distance_;
+};
+
+/// Squad leader that reads the positions of its agents' nodes.
+class LogicSquadLeader : public LogicComponent
+{
+    URHO3D_OBJECT(LogicSquadLeader, LogicComponent);
+
+public:
+    /// Construct.
+    explicit LogicSquadLeader(Context* context) :
+        LogicComponent(context)
+    {
+        SetUpdateEventMask(USE_UPDATE);
+    }
+
+    /// Follow the center of the squad.
+    void Update(float timeStep) override
+    {
+        Vector3 center;
+        for (unsigned i = 0; i < members_.Size(); ++i)
+            center += members_[i]->GetPosition();
+        node_->SetPosition(center / (float)members_.Size());
+    }
+
+    /// Squad member nodes.
+    PODVector<Node*> members_;
+};
+
+/// Receiver of the agent waypoint events.
+class LogicWaypointCounter : public Object
+{
+    URHO3D_OBJECT(LogicWaypointCounter, Object);
+
+public:
+    /// Construct.
+    LogicWaypointCounter(Context* context, Scene* scene) :
+        Object(context),
+        scene_(scene)
+    {
+        SubscribeToEvent(E_AGENTWAYPOINT, URHO3D_HANDLER(LogicWaypointCounter, HandleWaypoint));
+    }
+
+    /// Handle a waypoint event.
+    void HandleWaypoint(StringHash eventType, VariantMap& eventData)
+    {
+        // Count only the agents of own scene
+        if (static_cast<Component*>(GetEventSender())->GetScene() == scene_)
+            indices_.Push(eventData[AgentWaypoint::P_INDEX].GetUInt());
+    }
+
+    /// Scene.
+    Scene* scene_;
+    /// Reported agent indices in receive order.
+    PODVector<unsigned> indices_;
+};
+
+void RunLogicUpdateBenchmark(Context* context, BenchmarkReport& report)
+{
+    RegisterSceneLibrary(context);
+    context->RegisterFactory<LogicAgent>();
+    context->RegisterFactory<LogicSquadLeader>();
+    if (!context->GetSubsystem<WorkQueue>())
+        context->RegisterSubsystem(new WorkQueue(context));
+    // Use at least one worker thread so that the threaded path is exercised also on a single core
+    auto* workQueue = context->GetSubsystem<WorkQueue>();
+    if (!workQueue->GetNumThreads())
+        workQueue->CreateThreads(Max(GetNumLogicalCPUs(), 2U) - 1);
+
+    // Two identical scenes: the first updates the components with scene update events, the second in parallel
+    SharedPtr<Scene> scenes[2];
+    PODVector<Node*> agents[2];
+    PODVector<Node*> leaders[2];
+    PODVector<Node*> squads[2];
+    SharedPtr<LogicWaypointCounter> counters[2];
+    for (unsigned s = 0; s < 2; ++s)
+    {
+        scenes[s] = new Scene(context);
+        counters[s] = new LogicWaypointCounter(context, scenes[s]);
+
+        // The agents move in the space of squad nodes, which the main thread turns between the updates. The agents'
+        // world space moves then read the world transforms of shared parents
+        for (unsigned i = 0; i < NUM_LOGIC_AGENTS / LOGIC_SQUAD_SIZE; ++i)
+            squads[s].Push(scenes[s]->CreateChild("Squad", LOCAL));
+
+        for (unsigned i = 0; i < NUM_LOGIC_AGENTS; ++i)
+        {
+            Node* node = squads[s][i / LOGIC_SQUAD_SIZE]->CreateChild("Agent", LOCAL);
+            node->SetPosition(Vector3((float)(i % 200), 0.0f, (float)(i / 200)));
+            auto* agent = node->CreateComponent<LogicAgent>();
+            agent->index_ = i;
+            agent->distance_ = (float)(i % 64) / 64.0f;
+            agent->SetParallelUpdate(s == 1);
+            agents[s].Push(node);
+        }
+
+        for (unsigned i = 0; i < NUM_LOGIC_AGENTS / LOGIC_SQUAD_SIZE; ++i)
+        {
+            Node* node = scenes[s]->CreateChild("Leader", LOCAL);
+            auto* leader = node->CreateComponent<LogicSquadLeader>();
+            for (unsigned j = 0; j < LOGIC_SQUAD_SIZE; ++j)
+                leader->members_.Push(agents[s][i * LOGIC_SQUAD_SIZE + j]);
+            // Reading the agent nodes orders the leaders after the agents
+            leader->DeclareComponentAccess(Node::GetTypeStatic(), false);
+            leader->SetParallelUpdate(s == 1);
+            leaders[s].Push(node);
+        }
+    }
+
+    // The first update runs the delayed starts
+    for (unsigned s = 0; s < 2; ++s)
+        scenes[s]->Update(0.0f);
+
+    long long updateUSec[2] = { 0, 0 };
+    for (unsigned frame = 0; frame < NUM_LOGIC_FRAMES; ++frame)
+    {
+        for (unsigned s = 0; s < 2; ++s)
+        {
+            for (unsigned i = 0; i < squads[s].Size(); ++i)
+                squads[s][i]->Yaw(1.0f);
+
+            HiresTimer timer;
+            scenes[s]->Update(1.0f / 30.0f);
+            updateUSec[s] += timer.GetUSec(false);
+        }
+    }
+
+    unsigned mismatches = 0;
+    for (unsigned i = 0; i < agents[0].Size(); ++i)
+    {
+        if (agents[0][i]->GetPosition() != agents[1][i]->GetPosition())
+            ++mismatches;
+    }
+    for (unsigned i = 0; i < leaders[0].Size(); ++i)
+    {
+        if (leaders[0][i]->GetPosition() != leaders[1][i]->GetPosition())
+            ++mismatches;
+    }
+    // The deferred events are played back in component order regardless of the threads that recorded them
+    if (counters[0]->indices_ != counters[1]->indices_)
+        ++mismatches;
+
+    LogicScheduler* scheduler = scenes[1]->GetLogicScheduler();
+    report.Add("LogicUpdate", "Worker threads", (double)workQueue->GetNumThreads(), "threads");
+    report.Add("LogicUpdate", "Parallel components", (double)scheduler->GetNumComponents(), "components");
+    report.Add("LogicUpdate", "Groups", (double)scheduler->GetNumGroups(), "groups");
+    report.Add("LogicUpdate", "Stages", (double)scheduler->GetNumStages(), "stages");
+    report.Add("LogicUpdate", "Event update", updateUSec[0] / 1000.0 / NUM_LOGIC_FRAMES, "ms");
+    report.Add("LogicUpdate", "Parallel update", updateUSec[1] / 1000.0 / NUM_LOGIC_FRAMES, "ms");
+    report.Add("LogicUpdate", "Deferred events", (double)counters[1]->indices_.Size() / NUM_LOGIC_FRAMES, "events");
+    report.Check("LogicUpdate", "Mismatches", (double)mismatches, "objects");
+}
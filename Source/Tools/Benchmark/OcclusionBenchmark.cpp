@@ -0,0 +1,443 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/OcclusionBuffer.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Benchmark.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Occlusion buffer width. Height follows the camera aspect ratio.
+static const int OCCLUSION_BENCHMARK_WIDTH = 256;
+/// Number of boxes tested for visibility in each scene.
+static const unsigned NUM_OCCLUSION_TEST_BOXES = 5000;
+/// Number of repetitions of each measurement.
+static const unsigned NUM_OCCLUSION_REPEATS = 20;
+
+/// Unit box vertices.
+static const Vector3 boxVertices[] = {
+    Vector3(-0.5f, -0.5f, -0.5f), Vector3(0.5f, -0.5f, -0.5f), Vector3(0.5f, 0.5f, -0.5f), Vector3(-0.5f, 0.5f, -0.5f),
+    Vector3(-0.5f, -0.5f, 0.5f), Vector3(0.5f, -0.5f, 0.5f), Vector3(0.5f, 0.5f, 0.5f), Vector3(-0.5f, 0.5f, 0.5f)
+};
+
+/// Unit box triangles.
+static const unsigned short boxIndices[] = {
+    0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 4, 7, 0, 7, 3, 1, 2, 6, 1, 6, 5, 3, 7, 6, 3, 6, 2, 0, 1, 5, 0, 5, 4
+};
+
+/// Scanline occlusion rasterizer, which draws into a single buffer and tests visibility at pixel level only. Measures the
+/// benefit of the depth hierarchy. Does not clip, so the occluders must be inside the view frustum.
+class ReferenceOcclusionBuffer
+{
+public:
+    /// Construct with size and camera.
+    ReferenceOcclusionBuffer(int width, int height, Camera* camera) :
+        width_(width),
+        height_(height),
+        viewProj_(camera->GetProjection() * camera->GetView()),
+        scaleX_(0.5f * width),
+        scaleY_(-0.5f * height),
+        offsetX_(0.5f * width + 0.5f),
+        offsetY_(0.5f * height + 0.5f)
+    {
+        // Reserve extra rows in case the edges step outside the buffer
+        dataWithSafety_.Resize((unsigned)(width * (height + 2) + 2));
+        data_ = &dataWithSafety_[width + 1];
+    }
+
+    /// Clear the buffer.
+    void Clear()
+    {
+        for (unsigned i = 0; i < dataWithSafety_.Size(); ++i)
+            dataWithSafety_[i] = (int)OCCLUSION_Z_SCALE;
+    }
+
+    /// Draw indexed triangles, culling counterclockwise triangles.
+    void DrawTriangles(const Matrix3x4& model, const Vector3* vertices, const unsigned short* indices, unsigned indexCount)
+    {
+        Matrix4 modelViewProj = viewProj_ * model;
+
+        for (unsigned i = 0; i + 2 < indexCount; i += 3)
+        {
+            Vector3 projected[3];
+            for (unsigned j = 0; j < 3; ++j)
+                projected[j] = ViewportTransform(modelViewProj * Vector4(vertices[indices[i + j]], 1.0f));
+
+            float area = (projected[0].x_ - projected[1].x_) * (projected[2].y_ - projected[1].y_) -
+                (projected[0].y_ - projected[1].y_) * (projected[2].x_ - projected[1].x_);
+            if (area < 0.0f)
+                DrawTriangle2D(projected);
+        }
+    }
+
+    /// Test a bounding box for visibility at pixel level.
+    bool IsVisible(const BoundingBox& box) const
+    {
+        float minX = M_INFINITY, maxX = -M_INFINITY, minY = M_INFINITY, maxY = -M_INFINITY, minZ = M_INFINITY;
+        for (unsigned i = 0; i < 8; ++i)
+        {
+            Vector3 corner((i & 1u) ? box.max_.x_ : box.min_.x_, (i & 2u) ? box.max_.y_ : box.min_.y_,
+                (i & 4u) ? box.max_.z_ : box.min_.z_);
+            Vector4 vertex = viewProj_ * Vector4(corner, 1.0f);
+            vertex.z_ -= OCCLUSION_RELATIVE_BIAS;
+            if (vertex.z_ <= 0.0f)
+                return true;
+
+            Vector3 projected = ViewportTransform(vertex);
+            minX = Min(minX, projected.x_);
+            maxX = Max(maxX, projected.x_);
+            minY = Min(minY, projected.y_);
+            maxY = Max(maxY, projected.y_);
+            minZ = Min(minZ, projected.z_);
+        }
+
+        IntRect rect((int)(minX - 1.5f), (int)(minY - 1.5f), RoundToInt(maxX), RoundToInt(maxY));
+        if (rect.right_ < 0 || rect.bottom_ < 0 || rect.left_ >= width_ || rect.top_ >= height_)
+            return true;
+        rect.left_ = Max(rect.left_, 0);
+        rect.top_ = Max(rect.top_, 0);
+        rect.right_ = Min(rect.right_, width_ - 1);
+        rect.bottom_ = Min(rect.bottom_, height_ - 1);
+
+        int z = RoundToInt(minZ) - OCCLUSION_FIXED_BIAS;
+        for (int y = rect.top_; y <= rect.bottom_; ++y)
+        {
+            for (int x = rect.left_; x <= rect.right_; ++x)
+            {
+                if (z <= data_[y * width_ + x])
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    /// Scanline edge in 16.16 fixed point.
+    struct Edge
+    {
+        /// Construct from depth gradients and top & bottom vertices.
+        Edge(float dZdX, float dZdY, const Vector3& top, const Vector3& bottom, int topY)
+        {
+            float height = bottom.y_ - top.y_;
+            float slope = (height != 0.0f) ? (bottom.x_ - top.x_) / height : 0.0f;
+            float yPreStep = (float)(topY + 1) - top.y_;
+            float xPreStep = slope * yPreStep;
+
+            x_ = RoundToInt((xPreStep + top.x_) * OCCLUSION_X_SCALE);
+            xStep_ = RoundToInt(slope * OCCLUSION_X_SCALE);
+            z_ = RoundToInt(top.z_ + xPreStep * dZdX + yPreStep * dZdY);
+            zStep_ = RoundToInt(slope * dZdX + dZdY);
+        }
+
+        /// X coordinate.
+        int x_;
+        /// X coordinate step.
+        int xStep_;
+        /// Depth.
+        int z_;
+        /// Depth step.
+        int zStep_;
+    };
+
+    /// Apply projection and viewport transform.
+    Vector3 ViewportTransform(const Vector4& vertex) const
+    {
+        float invW = 1.0f / vertex.w_;
+        return Vector3(invW * vertex.x_ * scaleX_ + offsetX_, invW * vertex.y_ * scaleY_ + offsetY_,
+            invW * vertex.z_ * OCCLUSION_Z_SCALE);
+    }
+
+    /// Draw spans between two edges from startY to endY. Depth is interpolated along the left edge.
+    void DrawSpans(Edge& left, Edge& right, int startY, int endY, int dZdX)
+    {
+        for (int y = startY; y < endY; ++y)
+        {
+            int z = left.z_;
+            int* dest = data_ + y * width_ + (left.x_ >> 16);
+            int* end = data_ + y * width_ + (right.x_ >> 16);
+            while (dest < end)
+            {
+                if (z < *dest)
+                    *dest = z;
+                z += dZdX;
+                ++dest;
+            }
+
+            left.x_ += left.xStep_;
+            left.z_ += left.zStep_;
+            right.x_ += right.xStep_;
+        }
+    }
+
+    /// Draw a projected triangle.
+    void DrawTriangle2D(const Vector3* vertices)
+    {
+        unsigned top = 0, middle = 1, bottom = 2;
+        if (vertices[middle].y_ < vertices[top].y_)
+            Swap(top, middle);
+        if (vertices[bottom].y_ < vertices[middle].y_)
+            Swap(middle, bottom);
+        if (vertices[middle].y_ < vertices[top].y_)
+            Swap(top, middle);
+
+        auto topY = (int)vertices[top].y_;
+        auto middleY = (int)vertices[middle].y_;
+        auto bottomY = (int)vertices[bottom].y_;
+        if (topY == bottomY)
+            return;
+
+        const Vector3& v0 = vertices[0];
+        const Vector3& v1 = vertices[1];
+        const Vector3& v2 = vertices[2];
+        float invdX = 1.0f / ((v1.x_ - v2.x_) * (v0.y_ - v2.y_) - (v0.x_ - v2.x_) * (v1.y_ - v2.y_));
+        float dZdX = invdX * ((v1.z_ - v2.z_) * (v0.y_ - v2.y_) - (v0.z_ - v2.z_) * (v1.y_ - v2.y_));
+        float dZdY = -invdX * ((v1.z_ - v2.z_) * (v0.x_ - v2.x_) - (v0.z_ - v2.z_) * (v1.x_ - v2.x_));
+
+        // The middle vertex is right of the long edge if it is to the right at its height
+        const Vector3& t = vertices[top];
+        const Vector3& m = vertices[middle];
+        const Vector3& b = vertices[bottom];
+        bool middleIsRight = (m.x_ - t.x_) * (b.y_ - t.y_) > (b.x_ - t.x_) * (m.y_ - t.y_);
+
+        Edge topToBottom(dZdX, dZdY, t, b, topY);
+        if (topY != middleY)
+        {
+            Edge topToMiddle(dZdX, dZdY, t, m, topY);
+            if (middleIsRight)
+                DrawSpans(topToBottom, topToMiddle, topY, middleY, (int)dZdX);
+            else
+                DrawSpans(topToMiddle, topToBottom, topY, middleY, (int)dZdX);
+        }
+        if (middleY != bottomY)
+        {
+            Edge middleToBottom(dZdX, dZdY, m, b, middleY);
+            if (middleIsRight)
+                DrawSpans(topToBottom, middleToBottom, middleY, bottomY, (int)dZdX);
+            else
+                DrawSpans(middleToBottom, topToBottom, middleY, bottomY, (int)dZdX);
+        }
+    }
+
+    /// Buffer width.
+    int width_;
+    /// Buffer height.
+    int height_;
+    /// Buffer data with safety rows.
+    PODVector<int> dataWithSafety_;
+    /// Buffer data.
+    int* data_;
+    /// Combined view and projection matrix.
+    Matrix4 viewProj_;
+    /// X scaling for viewport transform.
+    float scaleX_;
+    /// Y scaling for viewport transform.
+    float scaleY_;
+    /// X offset for viewport transform.
+    float offsetX_;
+    /// Y offset for viewport transform.
+    float offsetY_;
+};
+
+/// Occlusion benchmark scene: occluder box transforms and boxes to test for visibility.
+struct OcclusionScene
+{
+    /// Scene name.
+    String name_;
+    /// Occluder box transforms.
+    PODVector<Matrix3x4> occluders_;
+    /// Boxes to test.
+    PODVector<BoundingBox> testBoxes_;
+};
+
+/// Add an occluder box if it is fully inside the view frustum.
+static void AddOccluder(OcclusionScene& scene, Camera* camera, const Vector3& position, const Vector3& size)
+{
+    if (camera->GetFrustum().IsInside(BoundingBox(position - size * 0.5f, position + size * 0.5f)) == INSIDE)
+        scene.occluders_.Push(Matrix3x4(position, Quaternion::IDENTITY, size));
+}
+
+/// Draw the occluders of a scene to an occlusion buffer.
+static void DrawOccluders(OcclusionBuffer* buffer, const OcclusionScene& scene)
+{
+    buffer->Clear();
+    for (unsigned i = 0; i < scene.occluders_.Size(); ++i)
+    {
+        buffer->AddTriangles(scene.occluders_[i], boxVertices, sizeof(Vector3), boxIndices, sizeof(unsigned short), 0,
+            sizeof boxIndices / sizeof boxIndices[0]);
+    }
+    buffer->DrawTriangles();
+    buffer->BuildDepthHierarchy();
+}
+
+/// Draw the occluders of a scene to the reference buffer.
+static void DrawOccluders(ReferenceOcclusionBuffer& buffer, const OcclusionScene& scene)
+{
+    buffer.Clear();
+    for (unsigned i = 0; i < scene.occluders_.Size(); ++i)
+        buffer.DrawTriangles(scene.occluders_[i], boxVertices, boxIndices, sizeof boxIndices / sizeof boxIndices[0]);
+}
+
+/// Return milliseconds per repetition of a measured function.
+template <class T> static double MeasureOcclusion(const T& function)
+{
+    HiresTimer timer;
+    for (unsigned i = 0; i < NUM_OCCLUSION_REPEATS; ++i)
+        function();
+    return timer.GetUSec(false) / 1000.0 / NUM_OCCLUSION_REPEATS;
+}
+
+void RunOcclusionBenchmark(Context* context, BenchmarkReport& report)
+{
+    RegisterSceneLibrary(context);
+    RegisterGraphicsLibrary(context);
+    if (!context->GetSubsystem<WorkQueue>())
+        context->RegisterSubsystem(new WorkQueue(context));
+    // Use at least one worker thread so that the threaded path is exercised also on a single core
+    auto* workQueue = context->GetSubsystem<WorkQueue>();
+    if (!workQueue->GetNumThreads())
+        workQueue->CreateThreads(Max(GetNumLogicalCPUs(), 2U) - 1);
+
+    SharedPtr<Scene> scene(new Scene(context));
+    auto* camera = scene->CreateChild("Camera")->CreateComponent<Camera>();
+    camera->SetAspectRatio(16.0f / 9.0f);
+    camera->SetFarClip(500.0f);
+    const int width = OCCLUSION_BENCHMARK_WIDTH;
+    const int height = RoundToInt(width / camera->GetAspectRatio());
+
+    Vector<OcclusionScene> scenes(2);
+    SetRandomSeed(1);
+
+    // Walls at varying distances in front of the camera, with boxes spread in front of and behind them
+    {
+        OcclusionScene& walls = scenes[0];
+        walls.name_ = "Walls";
+        for (unsigned i = 0; i < 40; ++i)
+        {
+            Vector3 position(Random(-40.0f, 40.0f), Random(-15.0f, 15.0f), Random(30.0f, 80.0f));
+            AddOccluder(walls, camera, position, Vector3(Random(5.0f, 20.0f), Random(3.0f, 15.0f), Random(0.5f, 2.0f)));
+        }
+        for (unsigned i = 0; i < NUM_OCCLUSION_TEST_BOXES; ++i)
+        {
+            Vector3 center(Random(-100.0f, 100.0f), Random(-40.0f, 40.0f), Random(10.0f, 200.0f));
+            walls.testBoxes_.Push(BoundingBox(center - Vector3::ONE * Random(0.2f, 3.0f), center + Vector3::ONE * Random(0.2f, 3.0f)));
+        }
+    }
+
+    // A city block grid seen from above the street level, with small objects among the buildings
+    {
+        OcclusionScene& city = scenes[1];
+        city.name_ = "City";
+        camera->GetNode()->SetPosition(Vector3(0.0f, 8.0f, 0.0f));
+        camera->GetNode()->SetDirection(Vector3(0.0f, -0.15f, 1.0f));
+        for (int z = 0; z < 12; ++z)
+        {
+            for (int x = -6; x <= 6; ++x)
+            {
+                Vector3 size(Random(8.0f, 14.0f), Random(6.0f, 40.0f), Random(8.0f, 14.0f));
+                AddOccluder(city, camera, Vector3(x * 20.0f, size.y_ * 0.5f - 4.0f, 30.0f + z * 20.0f), size);
+            }
+        }
+        for (unsigned i = 0; i < NUM_OCCLUSION_TEST_BOXES; ++i)
+        {
+            Vector3 center(Random(-130.0f, 130.0f), Random(-4.0f, 10.0f), Random(5.0f, 280.0f));
+            city.testBoxes_.Push(BoundingBox(center - Vector3::ONE * Random(0.2f, 2.0f), center + Vector3::ONE * Random(0.2f, 2.0f)));
+        }
+    }
+
+    for (unsigned s = 0; s < scenes.Size(); ++s)
+    {
+        const OcclusionScene& occlusionScene = scenes[s];
+        const String& name = occlusionScene.name_;
+        if (s == 0)
+            camera->GetNode()->SetTransform(Vector3::ZERO, Quaternion::IDENTITY);
+        else
+        {
+            camera->GetNode()->SetPosition(Vector3(0.0f, 8.0f, 0.0f));
+            camera->GetNode()->SetDirection(Vector3(0.0f, -0.15f, 1.0f));
+        }
+
+        ReferenceOcclusionBuffer reference(width, height, camera);
+        SharedPtr<OcclusionBuffer> serial(new OcclusionBuffer(context));
+        serial->SetSize(width, height, false);
+        serial->SetView(camera);
+        serial->SetMaxTriangles(M_MAX_UNSIGNED);
+        SharedPtr<OcclusionBuffer> threaded(new OcclusionBuffer(context));
+        threaded->SetSize(width, height, true);
+        threaded->SetView(camera);
+        threaded->SetMaxTriangles(M_MAX_UNSIGNED);
+
+        DrawOccluders(reference, occlusionScene);
+        double serialMs = MeasureOcclusion([&]() { DrawOccluders(serial, occlusionScene); });
+        double threadedMs = MeasureOcclusion([&]() { DrawOccluders(threaded, occlusionScene); });
+
+        // The merged per-thread buffers must give the same results as a single buffer
+        unsigned serialVisible = 0;
+        unsigned referenceVisible = 0;
+        unsigned threadedMismatches = 0;
+        for (unsigned i = 0; i < occlusionScene.testBoxes_.Size(); ++i)
+        {
+            const BoundingBox& box = occlusionScene.testBoxes_[i];
+            bool result = serial->IsVisible(box);
+            if (result)
+                ++serialVisible;
+            if (reference.IsVisible(box))
+                ++referenceVisible;
+            if (threaded->IsVisible(box) != result)
+                ++threadedMismatches;
+        }
+
+        // Accumulate into a volatile so that the optimizer can not drop the tests
+        volatile unsigned visibleSink = 0;
+        double referenceTestMs = MeasureOcclusion([&]()
+        {
+            unsigned visible = 0;
+            for (unsigned i = 0; i < occlusionScene.testBoxes_.Size(); ++i)
+                visible += reference.IsVisible(occlusionScene.testBoxes_[i]) ? 1 : 0;
+            visibleSink = visibleSink + visible;
+        });
+        double testMs = MeasureOcclusion([&]()
+        {
+            unsigned visible = 0;
+            for (unsigned i = 0; i < occlusionScene.testBoxes_.Size(); ++i)
+                visible += serial->IsVisible(occlusionScene.testBoxes_[i]) ? 1 : 0;
+            visibleSink = visibleSink + visible;
+        });
+
+        report.Add("Occlusion", name + " occluders", occlusionScene.occluders_.Size(), "boxes");
+        report.Add("Occlusion", name + " draw serial", serialMs, "ms");
+        report.Add("Occlusion", name + " draw threaded", threadedMs, "ms");
+        report.Add("Occlusion", name + " pixel level tests", referenceTestMs, "ms");
+        report.Add("Occlusion", name + " hierarchical tests", testMs, "ms");
+        report.Add("Occlusion", name + " visible at pixel level", referenceVisible, "boxes");
+        report.Add("Occlusion", name + " visible", serialVisible, "boxes");
+        report.Check("Occlusion", name + " threaded mismatches", threadedMismatches, "boxes");
+    }
+}
@@ -0,0 +1,383 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/Octree.h>
+#include <Urho3D/Graphics/OctreeQuery.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Benchmark.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of drawables in the measured octree.
+static const unsigned NUM_OCTREE_DRAWABLES = 100000;
+/// Half size of the area the drawables are spread over.
+static const float OCTREE_AREA_SIZE = 1000.0f;
+/// Number of queries per measurement.
+static const unsigned NUM_OCTREE_QUERIES = 200;
+/// Number of static drawables in the spatial index comparison.
+static const unsigned NUM_STATIC_INDEX_DRAWABLES = 50000;
+/// Number of moving drawables in the spatial index comparison.
+static const unsigned NUM_DYNAMIC_INDEX_DRAWABLES = 10000;
+/// Half size of the open world area, which extends beyond the default octree bounds.
+static const float OPEN_WORLD_AREA_SIZE = 4000.0f;
+/// Number of updated frames in the dynamic spatial index comparison.
+static const unsigned NUM_DYNAMIC_INDEX_FRAMES = 30;
+
+/// Frustum query that ignores the octant culling data and tests drawable by drawable.
+class DrawableFrustumOctreeQuery : public FrustumOctreeQuery
+{
+public:
+    using FrustumOctreeQuery::FrustumOctreeQuery;
+
+    /// Return that the culling data is not used.
+    bool UsesCullingData() const override { return false; }
+};
+
+/// Sphere query that ignores the octant culling data and tests drawable by drawable.
+class DrawableSphereOctreeQuery : public SphereOctreeQuery
+{
+public:
+    using SphereOctreeQuery::SphereOctreeQuery;
+
+    /// Return that the culling data is not used.
+    bool UsesCullingData() const override { return false; }
+};
+
+/// Run queries created by a factory and add the time per query to the report. Return the total number of results.
+template <class T> static unsigned MeasureQueries(Octree* octree, const String& name, BenchmarkReport& report, T createQuery)
+{
+    PODVector<Drawable*> result;
+    unsigned numResults = 0;
+    HiresTimer timer;
+    for (unsigned i = 0; i < NUM_OCTREE_QUERIES; ++i)
+    {
+        auto query = createQuery(result, i);
+        octree->GetDrawables(*query);
+        numResults += result.Size();
+    }
+    report.Add("OctreeQuery", name, timer.GetUSec(false) / 1000.0 / NUM_OCTREE_QUERIES, "ms");
+    return numResults;
+}
+
+void RunOctreeQueryBenchmark(Context* context, BenchmarkReport& report)
+{
+    RegisterSceneLibrary(context);
+    RegisterGraphicsLibrary(context);
+    if (!context->GetSubsystem<WorkQueue>())
+        context->RegisterSubsystem(new WorkQueue(context));
+
+    SharedPtr<Scene> scene(new Scene(context));
+    auto* octree = scene->CreateComponent<Octree>();
+    octree->SetSize(BoundingBox(-OCTREE_AREA_SIZE, OCTREE_AREA_SIZE), 8);
+
+    SharedPtr<Model> model(new Model(context));
+    model->SetBoundingBox(BoundingBox(-0.5f, 0.5f));
+
+    SetRandomSeed(1);
+    for (unsigned i = 0; i < NUM_OCTREE_DRAWABLES; ++i)
+    {
+        Node* node = scene->CreateChild("Box");
+        node->SetPosition(Vector3(Random(-OCTREE_AREA_SIZE, OCTREE_AREA_SIZE) * 0.9f, Random(0.0f, 20.0f),
+            Random(-OCTREE_AREA_SIZE, OCTREE_AREA_SIZE) * 0.9f));
+        node->SetScale(Random(0.5f, 8.0f));
+        // Every fourth object is on a layer the queries do not see
+        auto* staticModel = node->CreateComponent<StaticModel>();
+        staticModel->SetModel(model);
+        staticModel->SetViewMask(i % 4 ? 0x1 : 0x2);
+    }
+
+    FrameInfo frame;
+    octree->Update(frame);
+
+    // Cameras looking at random directions from random points, similar to the main view and shadow map views
+    Vector<Frustum> frustums;
+    Node* cameraNode = scene->CreateChild("Camera");
+    auto* camera = cameraNode->CreateComponent<Camera>();
+    camera->SetFarClip(300.0f);
+    camera->SetAspectRatio(16.0f / 9.0f);
+    for (unsigned i = 0; i < NUM_OCTREE_QUERIES; ++i)
+    {
+        cameraNode->SetPosition(Vector3(Random(-OCTREE_AREA_SIZE, OCTREE_AREA_SIZE) * 0.5f, 10.0f,
+            Random(-OCTREE_AREA_SIZE, OCTREE_AREA_SIZE) * 0.5f));
+        cameraNode->SetRotation(Quaternion(Random(-10.0f, 10.0f), Random(0.0f, 360.0f), 0.0f));
+        frustums.Push(camera->GetFrustum());
+    }
+
+    Vector<Sphere> spheres;
+    for (unsigned i = 0; i < NUM_OCTREE_QUERIES; ++i)
+    {
+        spheres.Push(Sphere(Vector3(Random(-OCTREE_AREA_SIZE, OCTREE_AREA_SIZE) * 0.5f, 10.0f,
+            Random(-OCTREE_AREA_SIZE, OCTREE_AREA_SIZE) * 0.5f), 50.0f));
+    }
+
+    unsigned frustumResults = MeasureQueries(octree, "Frustum packets", report, [&](PODVector<Drawable*>& result, unsigned i)
+    {
+        return MakeUnique<FrustumOctreeQuery>(result, frustums[i], DRAWABLE_GEOMETRY, 0x1);
+    });
+    unsigned frustumDrawableResults = MeasureQueries(octree, "Frustum drawables", report, [&](PODVector<Drawable*>& result, unsigned i)
+    {
+        return MakeUnique<DrawableFrustumOctreeQuery>(result, frustums[i], DRAWABLE_GEOMETRY, 0x1);
+    });
+    unsigned sphereResults = MeasureQueries(octree, "Sphere packets", report, [&](PODVector<Drawable*>& result, unsigned i)
+    {
+        return MakeUnique<SphereOctreeQuery>(result, spheres[i], DRAWABLE_GEOMETRY, 0x1);
+    });
+    unsigned sphereDrawableResults = MeasureQueries(octree, "Sphere drawables", report, [&](PODVector<Drawable*>& result, unsigned i)
+    {
+        return MakeUnique<DrawableSphereOctreeQuery>(result, spheres[i], DRAWABLE_GEOMETRY, 0x1);
+    });
+
+    // Both paths must find the same drawables
+    report.Add("OctreeQuery", "Frustum results", (double)frustumResults / NUM_OCTREE_QUERIES, "drawables");
+    report.Check("OctreeQuery", "Frustum mismatches", (double)frustumResults - frustumDrawableResults, "drawables");
+    report.Add("OctreeQuery", "Sphere results", (double)sphereResults / NUM_OCTREE_QUERIES, "drawables");
+    report.Check("OctreeQuery", "Sphere mismatches", (double)sphereResults - sphereDrawableResults, "drawables");
+}
+
+/// Create drawables spread over the open world area. Return their scene nodes.
+static PODVector<Node*> CreateOpenWorldDrawables(Scene* scene, Model* model, unsigned count)
+{
+    PODVector<Node*> nodes;
+    SetRandomSeed(1);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        Node* node = scene->CreateChild("Box");
+        node->SetPosition(Vector3(Random(-OPEN_WORLD_AREA_SIZE, OPEN_WORLD_AREA_SIZE), Random(0.0f, 20.0f),
+            Random(-OPEN_WORLD_AREA_SIZE, OPEN_WORLD_AREA_SIZE)));
+        node->SetScale(Random(0.5f, 8.0f));
+        node->CreateComponent<StaticModel>()->SetModel(model);
+        nodes.Push(node);
+    }
+    return nodes;
+}
+
+/// Run frustum queries and raycasts from random points of the open world area and add the time per query to the report.
+static void MeasureOpenWorldQueries(Octree* octree, const String& name, BenchmarkReport& report)
+{
+    SetRandomSeed(2);
+    PODVector<Drawable*> result;
+    unsigned numResults = 0;
+    HiresTimer timer;
+    for (unsigned i = 0; i < NUM_OCTREE_QUERIES; ++i)
+    {
+        Vector3 position(Random(-OPEN_WORLD_AREA_SIZE, OPEN_WORLD_AREA_SIZE), 10.0f, Random(-OPEN_WORLD_AREA_SIZE, OPEN_WORLD_AREA_SIZE));
+        Frustum frustum;
+        frustum.Define(45.0f, 16.0f / 9.0f, 1.0f, 0.1f, 300.0f, Matrix3x4(position, Quaternion(Random(0.0f, 360.0f),
+            Vector3::UP), 1.0f));
+        FrustumOctreeQuery query(result, frustum, DRAWABLE_GEOMETRY);
+        octree->GetDrawables(query);
+        numResults += result.Size();
+    }
+    report.Add("SpatialIndex", name + " frustum", timer.GetUSec(true) / 1000.0 / NUM_OCTREE_QUERIES, "ms");
+
+    PODVector<RayQueryResult> rayResult;
+    for (unsigned i = 0; i < NUM_OCTREE_QUERIES; ++i)
+    {
+        Ray ray(Vector3(Random(-OPEN_WORLD_AREA_SIZE, OPEN_WORLD_AREA_SIZE), 10.0f, Random(-OPEN_WORLD_AREA_SIZE, OPEN_WORLD_AREA_SIZE)),
+            Quaternion(Random(0.0f, 360.0f), Vector3::UP) * Vector3::FORWARD);
+        RayOctreeQuery query(rayResult, ray, RAY_AABB, 500.0f, DRAWABLE_GEOMETRY);
+        octree->RaycastSingle(query);
+    }
+    report.Add("SpatialIndex", name + " raycast", timer.GetUSec(false) / 1000.0 / NUM_OCTREE_QUERIES, "ms");
+    report.Add("SpatialIndex", name + " frustum results", (double)numResults / NUM_OCTREE_QUERIES, "drawables");
+}
+
+void RunSpatialIndexBenchmark(Context* context, BenchmarkReport& report)
+{
+    RegisterSceneLibrary(context);
+    RegisterGraphicsLibrary(context);
+    if (!context->GetSubsystem<WorkQueue>())
+        context->RegisterSubsystem(new WorkQueue(context));
+
+    SharedPtr<Model> model(new Model(context));
+    model->SetBoundingBox(BoundingBox(-0.5f, 0.5f));
+
+    // The octrees start from the default bounds, which cover only a part of the open world area
+    static const SpatialIndexType types[] = { SPATIAL_INDEX_OCTREE, SPATIAL_INDEX_GROWING_OCTREE, SPATIAL_INDEX_AABB_TREE };
+    static const char* typeNames[] = { "Octree", "Growing octree", "AABB tree" };
+    FrameInfo frame;
+
+    for (unsigned t = 0; t < 3; ++t)
+    {
+        String name = String(typeNames[t]) + " static";
+        SharedPtr<Scene> scene(new Scene(context));
+        auto* octree = scene->CreateComponent<Octree>();
+        octree->SetSpatialIndex(types[t]);
+
+        HiresTimer timer;
+        CreateOpenWorldDrawables(scene, model, NUM_STATIC_INDEX_DRAWABLES);
+        octree->Update(frame);
+        report.Add("SpatialIndex", name + " build", timer.GetUSec(false) / 1000.0, "ms");
+
+        MeasureOpenWorldQueries(octree, name, report);
+    }
+
+    for (unsigned t = 0; t < 3; ++t)
+    {
+        String name = String(typeNames[t]) + " dynamic";
+        SharedPtr<Scene> scene(new Scene(context));
+        auto* octree = scene->CreateComponent<Octree>();
+        octree->SetSpatialIndex(types[t]);
+        PODVector<Node*> nodes = CreateOpenWorldDrawables(scene, model, NUM_DYNAMIC_INDEX_DRAWABLES);
+        octree->Update(frame);
+
+        // Every drawable moves each frame at a speed of up to 20 units per second at 60 FPS
+        PODVector<Vector3> velocities;
+        for (unsigned i = 0; i < nodes.Size(); ++i)
+            velocities.Push(Vector3(Random(-20.0f, 20.0f), 0.0f, Random(-20.0f, 20.0f)) / 60.0f);
+
+        long long usec = 0;
+        long long updateUSec = 0;
+        unsigned long long startAllocations = GetNumAllocations();
+        for (unsigned f = 0; f < NUM_DYNAMIC_INDEX_FRAMES; ++f)
+        {
+            HiresTimer timer;
+            for (unsigned i = 0; i < nodes.Size(); ++i)
+                nodes[i]->Translate(velocities[i], TS_WORLD);
+            HiresTimer updateTimer;
+            octree->Update(frame);
+            updateUSec += updateTimer.GetUSec(false);
+            usec += timer.GetUSec(false);
+        }
+        report.Add("SpatialIndex", name + " update", usec / 1000.0 / NUM_DYNAMIC_INDEX_FRAMES, "ms");
+        report.Add("SpatialIndex", name + " octree update", updateUSec / 1000.0 / NUM_DYNAMIC_INDEX_FRAMES, "ms");
+        report.Add("SpatialIndex", name + " allocations", (double)(GetNumAllocations() - startAllocations) /
+            NUM_DYNAMIC_INDEX_FRAMES, "allocs/frame");
+
+        MeasureOpenWorldQueries(octree, name, report);
+    }
+}
+
+/// Compare a cached query result to a full query result regardless of order. Return true if they contain the same drawables.
+static bool CompareQueryResults(PODVector<Drawable*> cached, PODVector<Drawable*> full)
+{
+    Sort(cached.Begin(), cached.End());
+    Sort(full.Begin(), full.End());
+    return cached == full;
+}
+
+void RunQueryCacheBenchmark(Context* context, BenchmarkReport& report)
+{
+    RegisterSceneLibrary(context);
+    RegisterGraphicsLibrary(context);
+    if (!context->GetSubsystem<WorkQueue>())
+        context->RegisterSubsystem(new WorkQueue(context));
+
+    SharedPtr<Model> model(new Model(context));
+    model->SetBoundingBox(BoundingBox(-0.5f, 0.5f));
+
+    static const SpatialIndexType types[] = { SPATIAL_INDEX_OCTREE, SPATIAL_INDEX_AABB_TREE };
+    static const char* typeNames[] = { "Octree", "AABB tree" };
+    FrameInfo frame;
+
+    for (unsigned t = 0; t < 2; ++t)
+    {
+        String name(typeNames[t]);
+        SharedPtr<Scene> scene(new Scene(context));
+        auto* octree = scene->CreateComponent<Octree>();
+        octree->SetSize(BoundingBox(-OCTREE_AREA_SIZE, OCTREE_AREA_SIZE), 8);
+        octree->SetSpatialIndex(types[t]);
+
+        SetRandomSeed(1);
+        PODVector<Node*> nodes;
+        for (unsigned i = 0; i < NUM_STATIC_INDEX_DRAWABLES; ++i)
+        {
+            Node* node = scene->CreateChild("Box");
+            node->SetPosition(Vector3(Random(-OCTREE_AREA_SIZE, OCTREE_AREA_SIZE) * 0.2f, Random(0.0f, 20.0f),
+                Random(-OCTREE_AREA_SIZE, OCTREE_AREA_SIZE) * 0.2f));
+            node->SetScale(Random(0.5f, 8.0f));
+            node->CreateComponent<StaticModel>()->SetModel(model);
+            nodes.Push(node);
+        }
+        octree->Update(frame);
+
+        // A fixed main view and a point light volume, like the queries of a view with temporal coherence
+        Frustum frustum;
+        frustum.Define(45.0f, 16.0f / 9.0f, 1.0f, 0.1f, 300.0f, Matrix3x4(Vector3(0.0f, 10.0f, -150.0f), Quaternion::IDENTITY,
+            1.0f));
+        Sphere sphere(Vector3(0.0f, 10.0f, 0.0f), 50.0f);
+        OctreeQueryCache frustumCache;
+        OctreeQueryCache sphereCache;
+        PODVector<Drawable*> result;
+        double fullTime = 0.0;
+        double cachedTime = 0.0;
+        unsigned numIncremental = 0;
+        unsigned numMismatches = 0;
+
+        for (unsigned f = 0; f < NUM_DYNAMIC_INDEX_FRAMES; ++f)
+        {
+            // A small part of the scene moves each frame. Occasionally drawables are also added and removed
+            for (unsigned i = 0; i < NUM_STATIC_INDEX_DRAWABLES / 50; ++i)
+                nodes[Rand() % nodes.Size()]->Translate(Vector3(Random(-2.0f, 2.0f), 0.0f, Random(-2.0f, 2.0f)), TS_WORLD);
+            if (f % 10 == 5)
+            {
+                nodes.Back()->Remove();
+                nodes.Pop();
+            }
+            else if (f % 10 == 0)
+            {
+                Node* node = scene->CreateChild("Box");
+                node->SetPosition(Vector3(Random(-20.0f, 20.0f), 10.0f, Random(-20.0f, 20.0f)));
+                node->CreateComponent<StaticModel>()->SetModel(model);
+                nodes.Push(node);
+            }
+            octree->Update(frame);
+
+            HiresTimer timer;
+            FrustumOctreeQuery fullFrustumQuery(result, frustum, DRAWABLE_GEOMETRY);
+            octree->GetDrawables(fullFrustumQuery);
+            SphereOctreeQuery fullSphereQuery(result, sphere, DRAWABLE_GEOMETRY);
+            octree->GetDrawables(fullSphereQuery);
+            fullTime += timer.GetUSec(true) / 1000.0;
+
+            FrustumOctreeQuery frustumQuery(frustumCache.drawables_, frustum, DRAWABLE_GEOMETRY);
+            if (octree->GetDrawables(frustumQuery, frustumCache))
+                ++numIncremental;
+            SphereOctreeQuery sphereQuery(sphereCache.drawables_, sphere, DRAWABLE_GEOMETRY);
+            if (octree->GetDrawables(sphereQuery, sphereCache))
+                ++numIncremental;
+            cachedTime += timer.GetUSec(false) / 1000.0;
+
+            octree->GetDrawables(fullSphereQuery);
+            if (!CompareQueryResults(sphereCache.drawables_, result))
+                ++numMismatches;
+            octree->GetDrawables(fullFrustumQuery);
+            if (!CompareQueryResults(frustumCache.drawables_, result))
+                ++numMismatches;
+        }
+
+        report.Add("QueryCache", name + " full", fullTime / NUM_DYNAMIC_INDEX_FRAMES, "ms");
+        report.Add("QueryCache", name + " cached", cachedTime / NUM_DYNAMIC_INDEX_FRAMES, "ms");
+        report.Add("QueryCache", name + " incremental updates", (double)numIncremental, "queries");
+        report.Check("QueryCache", name + " mismatches", (double)numMismatches, "queries");
+    }
+}
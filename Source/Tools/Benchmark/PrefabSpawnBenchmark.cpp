@@ -0,0 +1,284 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/Light.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/XMLFile.h>
+#include <Urho3D/Scene/Component.h>
+#include <Urho3D/Scene/Prefab.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Benchmark.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of bullets spawned per frame, 10000 per second at 60 frames per second.
+static const unsigned NUM_BULLET_SPAWNS = 167;
+/// Bullet lifetime in frames.
+static const int BULLET_LIFETIME = 60;
+/// Number of simulated frames.
+static const unsigned NUM_BULLET_FRAMES = 180;
+
+/// Bullet gameplay component.
+class PrefabBullet : public Component
+{
+    URHO3D_OBJECT(PrefabBullet, Component);
+
+public:
+    /// Construct.
+    explicit PrefabBullet(Context* context) :
+        Component(context),
+        damage_(10.0f),
+        lifetime_(BULLET_LIFETIME),
+        trail_(0)
+    {
+    }
+
+    /// Register object factory and attributes.
+    static void RegisterObject(Context* context)
+    {
+        context->RegisterFactory<PrefabBullet>();
+        URHO3D_ATTRIBUTE("Velocity", Vector3, velocity_, Vector3::ZERO, AM_DEFAULT);
+        URHO3D_ATTRIBUTE("Damage", float, damage_, 10.0f, AM_DEFAULT);
+        URHO3D_ATTRIBUTE("Lifetime", int, lifetime_, BULLET_LIFETIME, AM_DEFAULT);
+        URHO3D_ATTRIBUTE("Trail", unsigned, trail_, 0, AM_DEFAULT | AM_NODEID);
+    }
+
+    /// Velocity.
+    Vector3 velocity_;
+    /// Damage.
+    float damage_;
+    /// Remaining lifetime in frames.
+    int lifetime_;
+    /// Trail child node ID.
+    unsigned trail_;
+};
+
+/// Bullet spawning method.
+struct BulletSpawner
+{
+    /// Destruct.
+    virtual ~BulletSpawner() = default;
+    /// Spawn a bullet.
+    virtual Node* Spawn(const Vector3& position) = 0;
+    /// Despawn a bullet.
+    virtual void Despawn(Node* bullet) { bullet->Remove(); }
+};
+
+/// Spawn bullets by instantiating the XML prefab.
+struct XMLBulletSpawner : public BulletSpawner
+{
+    XMLBulletSpawner(Scene* scene, XMLFile* file) : scene_(scene), file_(file) { }
+    Node* Spawn(const Vector3& position) override { return scene_->InstantiateXML(file_->GetRoot(), position, Quaternion::IDENTITY, LOCAL); }
+
+    Scene* scene_;
+    XMLFile* file_;
+};
+
+/// Spawn bullets by instantiating the binary prefab.
+struct BinaryBulletSpawner : public BulletSpawner
+{
+    BinaryBulletSpawner(Scene* scene, const VectorBuffer& data) : scene_(scene), data_(data) { }
+    Node* Spawn(const Vector3& position) override
+    {
+        MemoryBuffer source(data_.GetData(), data_.GetSize());
+        return scene_->Instantiate(source, position, Quaternion::IDENTITY, LOCAL);
+    }
+
+    Scene* scene_;
+    const VectorBuffer& data_;
+};
+
+/// Spawn bullets by instantiating the prefab resource.
+struct PrefabBulletSpawner : public BulletSpawner
+{
+    PrefabBulletSpawner(Scene* scene, Prefab* prefab) : scene_(scene), prefab_(prefab) { }
+    Node* Spawn(const Vector3& position) override { return prefab_->Instantiate(scene_, position, Quaternion::IDENTITY, LOCAL); }
+
+    Scene* scene_;
+    Prefab* prefab_;
+};
+
+/// Spawn bullets from a prefab pool.
+struct PoolBulletSpawner : public BulletSpawner
+{
+    PoolBulletSpawner(Scene* scene, Prefab* prefab) : pool_(new PrefabPool(prefab, scene, LOCAL)) { }
+    Node* Spawn(const Vector3& position) override { return pool_->Spawn(position, Quaternion::IDENTITY); }
+    void Despawn(Node* bullet) override { pool_->Release(bullet); }
+
+    SharedPtr<PrefabPool> pool_;
+};
+
+/// Run the bullet simulation with a spawning method and report the spawn and despawn times. The live bullets are left in spawn order.
+static void SimulateBullets(BulletSpawner& spawner, const String& name, PODVector<Node*>& bullets, BenchmarkReport& report)
+{
+    long long spawnUsec = 0;
+    long long despawnUsec = 0;
+    PODVector<Node*> expired;
+    for (unsigned frame = 0; frame < NUM_BULLET_FRAMES; ++frame)
+    {
+        // Move the bullets and count down their lifetime
+        expired.Clear();
+        for (unsigned i = 0; i < bullets.Size(); ++i)
+        {
+            Node* bullet = bullets[i];
+            auto* component = bullet->GetComponent<PrefabBullet>();
+            bullet->Translate(component->velocity_ * (1.0f / 60.0f));
+            if (--component->lifetime_ <= 0)
+                expired.Push(bullet);
+        }
+
+        HiresTimer timer;
+        // Bullets expire in spawn order, so they are always at the front
+        for (unsigned i = 0; i < expired.Size(); ++i)
+            spawner.Despawn(expired[i]);
+        bullets.Erase(0, expired.Size());
+        despawnUsec += timer.GetUSec(true);
+
+        for (unsigned i = 0; i < NUM_BULLET_SPAWNS; ++i)
+        {
+            Node* bullet = spawner.Spawn(Vector3((float)i, 1.0f, (float)frame));
+            bullet->GetComponent<PrefabBullet>()->velocity_ = Vector3(0.0f, 0.0f, 100.0f + i);
+            bullets.Push(bullet);
+        }
+        spawnUsec += timer.GetUSec(false);
+    }
+
+    const double scale = 10000.0 / 1000.0 / (NUM_BULLET_SPAWNS * NUM_BULLET_FRAMES);
+    report.Add("PrefabSpawn", name + " spawn", spawnUsec * scale, "ms/10k");
+    report.Add("PrefabSpawn", name + " despawn", despawnUsec * scale, "ms/10k");
+}
+
+/// Return whether the file attributes of two serializables match, excluding ID attributes.
+static bool AttributesMatch(Serializable* a, Serializable* b)
+{
+    const Vector<AttributeInfo>* attributes = a->GetAttributes();
+    for (unsigned i = 0; i < attributes->Size(); ++i)
+    {
+        const AttributeInfo& attr = attributes->At(i);
+        if ((attr.mode_ & AM_FILE) && !(attr.mode_ & (AM_NODEID | AM_COMPONENTID)) && a->GetAttribute(i) != b->GetAttribute(i))
+            return false;
+    }
+
+    return true;
+}
+
+/// Return whether two bullet hierarchies match and the trail ID refers to the bullet's own child.
+static bool BulletsMatch(Node* a, Node* b)
+{
+    if (!a->IsEnabled() || !AttributesMatch(a, b) || a->GetNumComponents() != b->GetNumComponents() ||
+        a->GetNumChildren() != b->GetNumChildren())
+        return false;
+
+    for (unsigned i = 0; i < a->GetNumComponents(); ++i)
+    {
+        Component* componentA = a->GetComponents()[i];
+        Component* componentB = b->GetComponents()[i];
+        if (componentA->GetType() != componentB->GetType() || componentA->IsEnabled() != componentB->IsEnabled() ||
+            !AttributesMatch(componentA, componentB))
+            return false;
+    }
+
+    for (unsigned i = 0; i < a->GetNumChildren(); ++i)
+    {
+        if (!BulletsMatch(a->GetChildren()[i], b->GetChildren()[i]))
+            return false;
+    }
+
+    auto* bullet = a->GetComponent<PrefabBullet>();
+    return !bullet || (a->GetNumChildren() && bullet->trail_ == a->GetChildren()[0]->GetID());
+}
+
+void RunPrefabSpawnBenchmark(Context* context, BenchmarkReport& report)
+{
+    RegisterSceneLibrary(context);
+    RegisterGraphicsLibrary(context);
+    PrefabBullet::RegisterObject(context);
+    // Drawable resource attributes are resolved through the resource cache
+    if (!context->GetSubsystem<FileSystem>())
+        context->RegisterSubsystem(new FileSystem(context));
+    if (!context->GetSubsystem<ResourceCache>())
+        context->RegisterSubsystem(new ResourceCache(context));
+
+    // Create the bullet: a model and gameplay component, and a child trail with a light
+    SharedPtr<Scene> source(new Scene(context));
+    Node* bulletNode = source->CreateChild("Bullet");
+    bulletNode->AddTag("Projectile");
+    bulletNode->SetScale(0.1f);
+    bulletNode->CreateComponent<StaticModel>()->SetCastShadows(true);
+    auto* bullet = bulletNode->CreateComponent<PrefabBullet>();
+    Node* trailNode = bulletNode->CreateChild("Trail");
+    trailNode->SetPosition(Vector3(0.0f, 0.0f, -0.5f));
+    auto* light = trailNode->CreateComponent<Light>();
+    light->SetRange(2.0f);
+    light->SetColor(Color(1.0f, 0.6f, 0.2f));
+    bullet->trail_ = trailNode->GetID();
+
+    SharedPtr<XMLFile> xmlPrefab(new XMLFile(context));
+    XMLElement xmlRoot = xmlPrefab->CreateRoot("node");
+    bulletNode->SaveXML(xmlRoot);
+    VectorBuffer binaryPrefab;
+    bulletNode->Save(binaryPrefab);
+
+    // Load the prefab resource from the binary data, as it would be loaded from a file
+    SharedPtr<Prefab> prefab(new Prefab(context));
+    MemoryBuffer prefabSource(binaryPrefab.GetData(), binaryPrefab.GetSize());
+    HiresTimer timer;
+    prefab->Load(prefabSource);
+    report.Add("PrefabSpawn", "Prefab load", timer.GetUSec(false), "us");
+    report.Add("PrefabSpawn", "Template size", prefab->GetTemplate().GetSize(), "bytes");
+
+    SharedPtr<Scene> xmlScene(new Scene(context));
+    SharedPtr<Scene> binaryScene(new Scene(context));
+    SharedPtr<Scene> prefabScene(new Scene(context));
+    SharedPtr<Scene> poolScene(new Scene(context));
+    XMLBulletSpawner xmlSpawner(xmlScene, xmlPrefab);
+    BinaryBulletSpawner binarySpawner(binaryScene, binaryPrefab);
+    PrefabBulletSpawner prefabSpawner(prefabScene, prefab);
+    PoolBulletSpawner poolSpawner(poolScene, prefab);
+
+    PODVector<Node*> xmlBullets;
+    PODVector<Node*> binaryBullets;
+    PODVector<Node*> prefabBullets;
+    PODVector<Node*> poolBullets;
+    SimulateBullets(xmlSpawner, "XML", xmlBullets, report);
+    SimulateBullets(binarySpawner, "Binary", binaryBullets, report);
+    SimulateBullets(prefabSpawner, "Prefab", prefabBullets, report);
+    SimulateBullets(poolSpawner, "Pool", poolBullets, report);
+    report.Add("PrefabSpawn", "Pooled instances", poolScene->GetNumChildren(), "nodes");
+
+    // Every method must produce the same live bullets
+    unsigned mismatches = 0;
+    for (unsigned i = 0; i < binaryBullets.Size(); ++i)
+    {
+        if (!BulletsMatch(binaryBullets[i], xmlBullets[i]) || !BulletsMatch(prefabBullets[i], binaryBullets[i]) ||
+            !BulletsMatch(poolBullets[i], binaryBullets[i]))
+            ++mismatches;
+    }
+    report.Check("PrefabSpawn", "Mismatches", mismatches, "bullets");
+}
@@ -0,0 +1,129 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Container/ConstString.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Benchmark.h"
+
+/// Number of nodes in the measured scene.
+static const unsigned NUM_SCENE_NODES = 10000;
+/// Number of times the scene is loaded per measurement.
+static const unsigned NUM_SCENE_LOADS = 10;
+
+/// Names of the scene nodes. Typical scenes repeat a small set of names, both short and long ones.
+static const char* nodeNames[] = {
+    "Box",
+    "Light",
+    "Mushroom",
+    "StaticCollider",
+    "SpawnPoint_EnemyWave",
+    "Environment_Prop_Crate",
+    "Vegetation_GrassPatch",
+};
+
+/// Create the measured scene content.
+static void CreateBenchmarkScene(Scene* scene)
+{
+    const unsigned numNames = sizeof(nodeNames) / sizeof(nodeNames[0]);
+    Node* group = nullptr;
+    for (unsigned i = 0; i < NUM_SCENE_NODES; ++i)
+    {
+        // Put the nodes to groups of 100 under the root
+        if (i % 100 == 0)
+            group = scene->CreateChild("Group");
+
+        Node* node = group->CreateChild(nodeNames[i % numNames]);
+        node->SetPosition(Vector3((float)(i % 100), 0.0f, (float)(i / 100)));
+        if (i % 4 == 0)
+            node->AddTag("Dynamic");
+    }
+}
+
+/// Load a scene repeatedly from a buffer and add the allocation count and duration per load to the report. Return
+/// allocations per node.
+static double MeasureSceneLoad(Context* context, const String& name, const PODVector<unsigned char>& data, bool xml,
+    BenchmarkReport& report)
+{
+    SharedPtr<Scene> scene(new Scene(context));
+    unsigned long long allocations = 0;
+    long long usec = 0;
+
+    for (unsigned i = 0; i < NUM_SCENE_LOADS; ++i)
+    {
+        MemoryBuffer source(data);
+        unsigned long long startAllocations = GetNumAllocations();
+        HiresTimer timer;
+        if (xml)
+            scene->LoadXML(source);
+        else
+            scene->Load(source);
+        usec += timer.GetUSec(false);
+        allocations += GetNumAllocations() - startAllocations;
+    }
+
+    report.Add("SceneLoad", name + " load", usec / 1000.0 / NUM_SCENE_LOADS, "ms");
+    report.Add("SceneLoad", name + " allocations", (double)allocations / NUM_SCENE_LOADS, "allocs/load");
+    double allocationsPerNode = (double)allocations / NUM_SCENE_LOADS / NUM_SCENE_NODES;
+    report.Add("SceneLoad", name + " allocations per node", allocationsPerNode, "allocs/node");
+    report.Add("SceneLoad", name + " interned strings", ConstString::GetNumStrings(), "strings");
+    return allocationsPerNode;
+}
+
+void RunSceneLoadBenchmark(Context* context, BenchmarkReport& report)
+{
+    RegisterSceneLibrary(context);
+    unsigned numStrings = ConstString::GetNumStrings();
+
+    SharedPtr<Scene> scene(new Scene(context));
+    CreateBenchmarkScene(scene);
+
+    VectorBuffer binaryData;
+    scene->Save(binaryData);
+    VectorBuffer xmlData;
+    scene->SaveXML(xmlData);
+    scene.Reset();
+
+    // Baseline: every non-empty string allocates from the heap
+    String::SetInlineStorage(false);
+    double binaryHeap = MeasureSceneLoad(context, "Binary heap strings", binaryData.GetBuffer(), false, report);
+    double xmlHeap = MeasureSceneLoad(context, "XML heap strings", xmlData.GetBuffer(), true, report);
+    String::SetInlineStorage(true);
+
+    double binaryInline = MeasureSceneLoad(context, "Binary", binaryData.GetBuffer(), false, report);
+    double xmlInline = MeasureSceneLoad(context, "XML", xmlData.GetBuffer(), true, report);
+    report.Add("SceneLoad", "Binary allocations saved by inline strings", binaryHeap - binaryInline, "allocs/node");
+    report.Add("SceneLoad", "XML allocations saved by inline strings", xmlHeap - xmlInline, "allocs/node");
+    report.Check("SceneLoad", "Binary loads allocating more than with heap strings", binaryInline > binaryHeap ? 1.0 : 0.0,
+        "errors");
+    report.Check("SceneLoad", "XML loads allocating more than with heap strings", xmlInline > xmlHeap ? 1.0 : 0.0, "errors");
+    // The node names are released along with the scenes
+    report.Check("SceneLoad", "Interned strings left after unload", (double)ConstString::GetNumStrings() - numStrings,
+        "strings");
+}
@@ -0,0 +1,343 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/AnimatedModel.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/IndexBuffer.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/Octree.h>
+#include <Urho3D/Graphics/VertexBuffer.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Benchmark.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of skinned models.
+static const unsigned NUM_SKINNED_MODELS = 400;
+/// Number of bones in each skeleton.
+static const unsigned NUM_SKIN_BONES = 64;
+/// Number of vertices in each model, all of which are in the morph range.
+static const unsigned NUM_SKIN_VERTICES = 2048;
+/// Number of morphs in each model.
+static const unsigned NUM_SKIN_MORPHS = 4;
+/// Number of measured frames.
+static const unsigned NUM_SKIN_FRAMES = 50;
+/// Largest accepted difference of a morphed vertex component from the reference.
+static const float MORPH_TOLERANCE = 1e-4f;
+
+/// Vertex layout of the benchmark model: position, normal, texture coordinate and tangent.
+struct SkinVertex
+{
+    Vector3 position_;
+    Vector3 normal_;
+    Vector2 texCoord_;
+    Vector4 tangent_;
+};
+
+/// Create a model with a binary tree skeleton of boxes and spheres, and morphs that each move half of the vertices.
+static SharedPtr<Model> CreateSkinnedModel(Context* context)
+{
+    PODVector<SkinVertex> vertices(NUM_SKIN_VERTICES);
+    for (unsigned i = 0; i < NUM_SKIN_VERTICES; ++i)
+    {
+        SkinVertex& vertex = vertices[i];
+        vertex.position_ = Vector3(Random(-0.5f, 0.5f), Random(0.0f, 2.0f), Random(-0.5f, 0.5f));
+        vertex.normal_ = Vector3(vertex.position_.x_, 0.0f, vertex.position_.z_).Normalized();
+        vertex.texCoord_ = Vector2(Random(), Random());
+        vertex.tangent_ = Vector4(vertex.normal_.CrossProduct(Vector3::UP), 1.0f);
+    }
+    PODVector<unsigned short> indices;
+    for (unsigned i = 0; i + 2 < NUM_SKIN_VERTICES; ++i)
+    {
+        indices.Push((unsigned short)i);
+        indices.Push((unsigned short)(i + 1));
+        indices.Push((unsigned short)(i + 2));
+    }
+
+    SharedPtr<VertexBuffer> vb(new VertexBuffer(context));
+    vb->SetShadowed(true);
+    vb->SetSize(NUM_SKIN_VERTICES, MASK_POSITION | MASK_NORMAL | MASK_TEXCOORD1 | MASK_TANGENT);
+    vb->SetData(vertices.Buffer());
+    SharedPtr<IndexBuffer> ib(new IndexBuffer(context));
+    ib->SetShadowed(true);
+    ib->SetSize(indices.Size(), false);
+    ib->SetData(indices.Buffer());
+
+    SharedPtr<Geometry> geometry(new Geometry(context));
+    geometry->SetVertexBuffer(0, vb);
+    geometry->SetIndexBuffer(ib);
+    geometry->SetDrawRange(TRIANGLE_LIST, 0, indices.Size());
+
+    SharedPtr<Model> model(new Model(context));
+    Vector<SharedPtr<VertexBuffer> > vertexBuffers;
+    Vector<SharedPtr<IndexBuffer> > indexBuffers;
+    PODVector<unsigned> morphRangeStarts;
+    PODVector<unsigned> morphRangeCounts;
+    vertexBuffers.Push(vb);
+    indexBuffers.Push(ib);
+    morphRangeStarts.Push(0);
+    morphRangeCounts.Push(NUM_SKIN_VERTICES);
+    model->SetVertexBuffers(vertexBuffers, morphRangeStarts, morphRangeCounts);
+    model->SetIndexBuffers(indexBuffers);
+    model->SetNumGeometries(1);
+    model->SetGeometry(0, 0, geometry);
+    model->SetBoundingBox(BoundingBox(Vector3(-0.5f, 0.0f, -0.5f), Vector3(0.5f, 2.0f, 0.5f)));
+
+    Skeleton skeleton;
+    Vector<Bone>& bones = skeleton.GetModifiableBones();
+    for (unsigned i = 0; i < NUM_SKIN_BONES; ++i)
+    {
+        Bone bone;
+        bone.name_ = "Bone" + String(i);
+        bone.nameHash_ = bone.name_;
+        bone.parentIndex_ = i ? (i - 1) / 2 : 0;
+        bone.initialPosition_ = i ? Vector3(Random(-0.1f, 0.1f), 0.2f, Random(-0.1f, 0.1f)) : Vector3::ZERO;
+        bone.offsetMatrix_ = Matrix3x4(Vector3(0.0f, -0.2f * i / NUM_SKIN_BONES, 0.0f), Quaternion::IDENTITY, 1.0f);
+        bone.collisionMask_ = i % 2 ? BONECOLLISION_BOX : BONECOLLISION_SPHERE;
+        bone.radius_ = 0.1f;
+        bone.boundingBox_ = BoundingBox(-0.1f, 0.1f);
+        bones.Push(bone);
+    }
+    skeleton.SetRootBoneIndex(0);
+    model->SetSkeleton(skeleton);
+
+    Vector<ModelMorph> morphs(NUM_SKIN_MORPHS);
+    const unsigned morphVertexSize = sizeof(unsigned) + 3 * sizeof(Vector3);
+    for (unsigned i = 0; i < NUM_SKIN_MORPHS; ++i)
+    {
+        ModelMorph& morph = morphs[i];
+        morph.name_ = "Morph" + String(i);
+        morph.nameHash_ = morph.name_;
+        morph.weight_ = 0.0f;
+
+        VertexBufferMorph& bufferMorph = morph.buffers_[0];
+        bufferMorph.elementMask_ = MASK_POSITION | MASK_NORMAL | MASK_TANGENT;
+        bufferMorph.vertexCount_ = 0;
+        bufferMorph.morphData_ = new unsigned char[NUM_SKIN_VERTICES * morphVertexSize];
+        unsigned char* data = bufferMorph.morphData_.Get();
+        // Every other vertex, including the last so that the unaligned tail is exercised
+        for (unsigned j = (i + 1) % 2; j < NUM_SKIN_VERTICES; j += 2)
+        {
+            *reinterpret_cast<unsigned*>(data) = j;
+            auto* deltas = reinterpret_cast<Vector3*>(data + sizeof(unsigned));
+            deltas[0] = Vector3(Random(-0.1f, 0.1f), Random(-0.1f, 0.1f), Random(-0.1f, 0.1f));
+            deltas[1] = Vector3(Random(-0.1f, 0.1f), Random(-0.1f, 0.1f), Random(-0.1f, 0.1f));
+            deltas[2] = Vector3(Random(-0.1f, 0.1f), Random(-0.1f, 0.1f), Random(-0.1f, 0.1f));
+            data += morphVertexSize;
+            ++bufferMorph.vertexCount_;
+        }
+        bufferMorph.dataSize_ = bufferMorph.vertexCount_ * morphVertexSize;
+    }
+    model->SetMorphs(morphs);
+    return model;
+}
+
+/// Morph the position, normal and tangent of the vertices one component at a time, as the previous implementation did.
+static void ApplyReferenceMorphs(PODVector<float>& dest, const PODVector<SkinVertex>& source, const Vector<ModelMorph>& morphs,
+    const float* weights)
+{
+    // Reset from the source vertices into the position, normal and tangent layout of the morph buffer
+    float* out = dest.Buffer();
+    for (unsigned i = 0; i < source.Size(); ++i)
+    {
+        const SkinVertex& vertex = source[i];
+        out[0] = vertex.position_.x_;
+        out[1] = vertex.position_.y_;
+        out[2] = vertex.position_.z_;
+        out[3] = vertex.normal_.x_;
+        out[4] = vertex.normal_.y_;
+        out[5] = vertex.normal_.z_;
+        out[6] = vertex.tangent_.x_;
+        out[7] = vertex.tangent_.y_;
+        out[8] = vertex.tangent_.z_;
+        out[9] = vertex.tangent_.w_;
+        out += 10;
+    }
+
+    for (unsigned i = 0; i < morphs.Size(); ++i)
+    {
+        const VertexBufferMorph& morph = *morphs[i].buffers_[0];
+        const unsigned char* src = morph.morphData_.Get();
+        for (unsigned j = 0; j < morph.vertexCount_; ++j)
+        {
+            float* vertex = dest.Buffer() + *reinterpret_cast<const unsigned*>(src) * 10;
+            const auto* deltas = reinterpret_cast<const float*>(src + sizeof(unsigned));
+            for (unsigned k = 0; k < 3; ++k)
+            {
+                vertex[k] += deltas[k] * weights[i];
+                vertex[3 + k] += deltas[3 + k] * weights[i];
+                vertex[6 + k] += deltas[6 + k] * weights[i];
+            }
+            src += sizeof(unsigned) + 9 * sizeof(float);
+        }
+    }
+}
+
+/// Update the geometry of a range of skinned models.
+static void UpdateSkinnedGeometriesWork(const WorkItem* item, unsigned threadIndex)
+{
+    const FrameInfo& frame = *reinterpret_cast<FrameInfo*>(item->aux_);
+    auto** start = reinterpret_cast<AnimatedModel**>(item->start_);
+    auto** end = reinterpret_cast<AnimatedModel**>(item->end_);
+    while (start != end)
+        (*start++)->UpdateGeometry(frame);
+}
+
+void RunSkinningBenchmark(Context* context, BenchmarkReport& report)
+{
+    RegisterSceneLibrary(context);
+    RegisterGraphicsLibrary(context);
+    SharedPtr<WorkQueue> workQueue(new WorkQueue(context));
+    if (GetNumLogicalCPUs() > 1)
+        workQueue->CreateThreads(GetNumLogicalCPUs() - 1);
+
+    SetRandomSeed(1);
+    SharedPtr<Model> model = CreateSkinnedModel(context);
+    SharedPtr<Scene> scene(new Scene(context));
+    scene->CreateComponent<Octree>();
+
+    PODVector<AnimatedModel*> models;
+    for (unsigned i = 0; i < NUM_SKINNED_MODELS; ++i)
+    {
+        Node* node = scene->CreateChild("Model");
+        node->SetPosition(Vector3((float)(i % 20), 0.0f, (float)(i / 20)));
+        auto* animatedModel = node->CreateComponent<AnimatedModel>();
+        animatedModel->SetModel(model);
+        models.Push(animatedModel);
+    }
+
+    PODVector<SkinVertex> sourceVertices(NUM_SKIN_VERTICES);
+    memcpy(sourceVertices.Buffer(), model->GetVertexBuffers()[0]->GetShadowData(), NUM_SKIN_VERTICES * sizeof(SkinVertex));
+    PODVector<float> referenceVertices(NUM_SKIN_VERTICES * 10);
+    const Vector<ModelMorph>& modelMorphs = model->GetMorphs();
+
+    // Without a camera the models update as in headless mode, regardless of visibility
+    FrameInfo frame;
+    frame.timeStep_ = 1.0f / 60.0f;
+    frame.camera_ = nullptr;
+    long long animateUSec = 0;
+    long long boundsUSec = 0;
+    long long serialUSec = 0;
+    long long parallelUSec = 0;
+    long long uploadUSec = 0;
+    long long referenceUSec = 0;
+    unsigned skinMismatches = 0;
+    unsigned morphMismatches = 0;
+
+    for (unsigned frameNumber = 0; frameNumber < NUM_SKIN_FRAMES * 2; ++frameNumber)
+    {
+        // Odd frames are updated in parallel work items, even frames serially
+        bool parallel = (frameNumber & 1u) != 0;
+        frame.frameNumber_ = frameNumber + 1;
+
+        // Pose the bones and change the morph weights of every model
+        HiresTimer animateTimer;
+        for (unsigned i = 0; i < models.Size(); ++i)
+        {
+            AnimatedModel* animatedModel = models[i];
+            const Vector<Bone>& bones = animatedModel->GetSkeleton().GetBones();
+            float phase = (float)(frameNumber + i) * 3.0f;
+            for (unsigned j = 1; j < bones.Size(); ++j)
+                bones[j].node_->SetRotation(Quaternion(Sin(phase + j * 10.0f) * 20.0f, Vector3::FORWARD));
+            for (unsigned j = 0; j < NUM_SKIN_MORPHS; ++j)
+                animatedModel->SetMorphWeight(j, 0.5f + 0.5f * Sin(phase + j * 45.0f));
+        }
+        animateUSec += animateTimer.GetUSec(false);
+
+        // The drawable update recalculates the bone bounding boxes
+        HiresTimer boundsTimer;
+        for (unsigned i = 0; i < models.Size(); ++i)
+            models[i]->Update(frame);
+        boundsUSec += boundsTimer.GetUSec(false);
+
+        HiresTimer updateTimer;
+        if (parallel)
+        {
+            unsigned numWorkItems = workQueue->GetNumThreads() + 1;
+            unsigned modelsPerItem = (models.Size() + numWorkItems - 1) / numWorkItems;
+            for (unsigned i = 0; i < models.Size(); i += modelsPerItem)
+            {
+                SharedPtr<WorkItem> item = workQueue->GetFreeItem();
+                item->priority_ = M_MAX_UNSIGNED;
+                item->workFunction_ = UpdateSkinnedGeometriesWork;
+                item->aux_ = &frame;
+                item->start_ = models.Buffer() + i;
+                item->end_ = models.Buffer() + Min(i + modelsPerItem, models.Size());
+                workQueue->AddWorkItem(item);
+            }
+            workQueue->Complete(M_MAX_UNSIGNED);
+            parallelUSec += updateTimer.GetUSec(false);
+        }
+        else
+        {
+            for (unsigned i = 0; i < models.Size(); ++i)
+                models[i]->UpdateGeometry(frame);
+            serialUSec += updateTimer.GetUSec(false);
+        }
+
+        HiresTimer uploadTimer;
+        for (unsigned i = 0; i < models.Size(); ++i)
+            models[i]->FinishUpdateGeometry(frame);
+        uploadUSec += uploadTimer.GetUSec(false);
+
+        // Verify the skin matrices and the morphed vertices of one model per frame against the previous scalar calculation
+        AnimatedModel* checked = models[frameNumber % models.Size()];
+        const SourceBatch& batch = checked->GetBatches()[0];
+        const Vector<Bone>& bones = checked->GetSkeleton().GetBones();
+        for (unsigned i = 0; i < bones.Size(); ++i)
+        {
+            if (!batch.worldTransform_[i].Equals(bones[i].node_->GetWorldTransform() * bones[i].offsetMatrix_))
+                ++skinMismatches;
+        }
+
+        float weights[NUM_SKIN_MORPHS];
+        for (unsigned i = 0; i < NUM_SKIN_MORPHS; ++i)
+            weights[i] = checked->GetMorphWeight(i);
+        HiresTimer referenceTimer;
+        ApplyReferenceMorphs(referenceVertices, sourceVertices, modelMorphs, weights);
+        referenceUSec += referenceTimer.GetUSec(false);
+
+        // The morphed vertices are in the second vertex stream of the cloned geometry
+        const auto* morphed = reinterpret_cast<const float*>(batch.geometry_->GetVertexBuffer(1)->GetShadowData());
+        for (unsigned i = 0; i < referenceVertices.Size(); ++i)
+        {
+            if (Abs(morphed[i] - referenceVertices[i]) > MORPH_TOLERANCE)
+                ++morphMismatches;
+        }
+    }
+
+    report.Add("Skinning", "Pose bones and morph weights", animateUSec / 1000.0 / (NUM_SKIN_FRAMES * 2), "ms");
+    report.Add("Skinning", "Bone bounding boxes", boundsUSec / 1000.0 / (NUM_SKIN_FRAMES * 2), "ms");
+    report.Add("Skinning", "Skin matrices and morphs serial", serialUSec / 1000.0 / NUM_SKIN_FRAMES, "ms");
+    report.Add("Skinning", "Skin matrices and morphs parallel", parallelUSec / 1000.0 / NUM_SKIN_FRAMES, "ms");
+    report.Add("Skinning", "Morph upload", uploadUSec / 1000.0 / (NUM_SKIN_FRAMES * 2), "ms");
+    report.Add("Skinning", "Scalar reference morphs", referenceUSec / 1000.0 / (NUM_SKIN_FRAMES * 2) * NUM_SKINNED_MODELS, "ms");
+    report.Check("Skinning", "Skin matrix mismatches", skinMismatches, "matrices");
+    report.Check("Skinning", "Morph mismatches", morphMismatches, "floats");
+}
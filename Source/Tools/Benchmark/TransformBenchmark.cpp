@@ -0,0 +1,226 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Scene/Component.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Benchmark.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of characters.
+static const unsigned NUM_TRANSFORM_CHARACTERS = 500;
+/// Depth of the binary tree skeleton of each character below its root node.
+static const unsigned TRANSFORM_SKELETON_DEPTH = 6;
+/// Every this many bones are rotated each frame.
+static const unsigned TRANSFORM_ROTATED_BONE_INTERVAL = 4;
+/// Number of measured frames.
+static const unsigned NUM_TRANSFORM_FRAMES = 50;
+/// Number of single node moves, each followed by a world transform read.
+static const unsigned NUM_INTERLEAVED_MOVES = 2000;
+/// Every this many single moves, a bone is also moved to another character.
+static const unsigned INTERLEAVED_REPARENT_INTERVAL = 20;
+
+/// Component that listens to its node's transform changes like a drawable does, counting the notifications.
+class TransformListener : public Component
+{
+    URHO3D_OBJECT(TransformListener, Component);
+
+public:
+    /// Construct.
+    explicit TransformListener(Context* context) :
+        Component(context),
+        counter_(nullptr),
+        dirty_(false)
+    {
+    }
+
+    /// Notification counter.
+    unsigned* counter_;
+    /// Transform changed flag.
+    bool dirty_;
+
+protected:
+    /// Handle node being assigned.
+    void OnNodeSet(Node* node) override
+    {
+        if (node)
+            node->AddListener(this);
+    }
+
+    /// Handle node transform being dirtied.
+    void OnMarkedDirty(Node* node) override
+    {
+        // Adding the listener to a dirty node notifies before the counter is assigned
+        dirty_ = true;
+        if (counter_)
+            ++(*counter_);
+    }
+};
+
+/// Create a binary tree of bone nodes with listeners.
+static void CreateBones(Node* parent, unsigned depth, unsigned* counter, PODVector<Node*>& nodes)
+{
+    for (unsigned i = 0; i < 2; ++i)
+    {
+        Node* bone = parent->CreateChild("Bone");
+        bone->SetPosition(Vector3(i ? 0.2f : -0.2f, 0.3f, 0.0f));
+        bone->CreateComponent<TransformListener>()->counter_ = counter;
+        nodes.Push(bone);
+        if (depth > 1)
+            CreateBones(bone, depth - 1, counter, nodes);
+    }
+}
+
+void RunTransformBenchmark(Context* context, BenchmarkReport& report)
+{
+    RegisterSceneLibrary(context);
+    context->RegisterFactory<TransformListener>();
+    SharedPtr<WorkQueue> workQueue(new WorkQueue(context));
+    if (GetNumLogicalCPUs() > 1)
+        workQueue->CreateThreads(GetNumLogicalCPUs() - 1);
+
+    // Two identical scenes: the first marks child nodes dirty recursively, the second uses the transform store
+    SharedPtr<Scene> scenes[2];
+    PODVector<Node*> nodes[2];
+    PODVector<Node*> roots[2];
+    unsigned notifications[2] = { 0, 0 };
+    for (unsigned s = 0; s < 2; ++s)
+    {
+        scenes[s] = new Scene(context);
+        for (unsigned i = 0; i < NUM_TRANSFORM_CHARACTERS; ++i)
+        {
+            Node* root = scenes[s]->CreateChild("Character");
+            root->SetPosition(Vector3((float)(i % 25), 0.0f, (float)(i / 25)));
+            root->CreateComponent<TransformListener>()->counter_ = &notifications[s];
+            roots[s].Push(root);
+            nodes[s].Push(root);
+            CreateBones(root, TRANSFORM_SKELETON_DEPTH, &notifications[s], nodes[s]);
+        }
+    }
+    scenes[1]->SetTransformStoreEnabled(true);
+    for (unsigned s = 0; s < 2; ++s)
+    {
+        for (unsigned i = 0; i < nodes[s].Size(); ++i)
+            nodes[s][i]->GetWorldTransform();
+    }
+
+    long long markUSec[2] = { 0, 0 };
+    long long updateUSec = 0;
+    long long readUSec[2] = { 0, 0 };
+    unsigned mismatches = 0;
+    notifications[0] = notifications[1] = 0;
+    unsigned nodesPerCharacter = nodes[0].Size() / NUM_TRANSFORM_CHARACTERS;
+
+    for (unsigned frame = 0; frame < NUM_TRANSFORM_FRAMES; ++frame)
+    {
+        Vector3 sums[2];
+        for (unsigned s = 0; s < 2; ++s)
+        {
+            // Move one bone to another character, keeping its world transform. This is not timed, but checks that the
+            // transform store follows hierarchy changes
+            nodes[s][frame * nodesPerCharacter + 5]->SetParent(roots[s][(frame + 1) % NUM_TRANSFORM_CHARACTERS]);
+
+            // Move the characters and rotate some of their bones, as animation or physics would
+            HiresTimer timer;
+            for (unsigned i = 0; i < roots[s].Size(); ++i)
+                roots[s][i]->SetPosition(Vector3((float)(i % 25), 0.01f * frame, (float)(i / 25)));
+            for (unsigned i = 0; i < nodes[s].Size(); i += TRANSFORM_ROTATED_BONE_INTERVAL)
+                nodes[s][i]->SetRotation(Quaternion((float)(frame + i % 90), Vector3::UP));
+            markUSec[s] += timer.GetUSec(true);
+
+            if (s == 1)
+            {
+                scenes[s]->UpdateTransforms();
+                updateUSec += timer.GetUSec(true);
+            }
+
+            // Read every world transform, as rendering does
+            for (unsigned i = 0; i < nodes[s].Size(); ++i)
+                sums[s] += nodes[s][i]->GetWorldTransform().Translation();
+            readUSec[s] += timer.GetUSec(false);
+        }
+
+        if (sums[0] != sums[1])
+            ++mismatches;
+
+        for (unsigned i = 0; i < nodes[0].Size(); ++i)
+        {
+            if (!nodes[0][i]->GetWorldTransform().Equals(nodes[1][i]->GetWorldTransform()) ||
+                !nodes[0][i]->GetWorldRotation().Equals(nodes[1][i]->GetWorldRotation()))
+                ++mismatches;
+        }
+    }
+
+    // Move single characters and read a world transform after each move, as gameplay code does, then read every world
+    // transform, as rendering does. With the store the reads in between calculate through the moved nodes, and the changes
+    // are applied once before rendering. The recursive path notifies the listeners at each move instead
+    long long interleavedUSec[2] = { 0, 0 };
+    Vector3 interleavedSums[2];
+    for (unsigned s = 0; s < 2; ++s)
+    {
+        Vector3& sum = interleavedSums[s];
+        HiresTimer timer;
+        for (unsigned i = 0; i < NUM_INTERLEAVED_MOVES; ++i)
+        {
+            if (i % INTERLEAVED_REPARENT_INTERVAL == 0)
+            {
+                unsigned bone = (i / INTERLEAVED_REPARENT_INTERVAL) * nodesPerCharacter + 9;
+                nodes[s][bone]->SetParent(roots[s][(bone / nodesPerCharacter + 3) % NUM_TRANSFORM_CHARACTERS]);
+            }
+            roots[s][(i * 7) % NUM_TRANSFORM_CHARACTERS]->Translate(Vector3(0.0f, 0.001f, 0.0f));
+            sum += nodes[s][(i * 13) % nodes[s].Size()]->GetWorldTransform().Translation();
+        }
+        if (s == 1)
+            scenes[s]->UpdateTransforms();
+        for (unsigned i = 0; i < nodes[s].Size(); ++i)
+            sum += nodes[s][i]->GetWorldTransform().Translation();
+        interleavedUSec[s] = timer.GetUSec(false);
+    }
+    if (interleavedSums[0] != interleavedSums[1])
+        ++mismatches;
+    for (unsigned i = 0; i < nodes[0].Size(); ++i)
+    {
+        if (!nodes[0][i]->GetWorldTransform().Equals(nodes[1][i]->GetWorldTransform()))
+            ++mismatches;
+    }
+
+    TransformStore* store = scenes[1]->GetTransformStore();
+    report.Add("Transform", "Nodes", (double)store->GetNumNodes(), "nodes");
+    report.Add("Transform", "Independent subtrees", (double)store->GetNumSubtrees(), "subtrees");
+    report.Add("Transform", "Recursive mark dirty", markUSec[0] / 1000.0 / NUM_TRANSFORM_FRAMES, "ms");
+    report.Add("Transform", "Recursive lazy world transforms", readUSec[0] / 1000.0 / NUM_TRANSFORM_FRAMES, "ms");
+    report.Add("Transform", "Recursive total", (markUSec[0] + readUSec[0]) / 1000.0 / NUM_TRANSFORM_FRAMES, "ms");
+    report.Add("Transform", "Recursive notifications", (double)notifications[0] / NUM_TRANSFORM_FRAMES, "calls");
+    report.Add("Transform", "Store mark dirty", markUSec[1] / 1000.0 / NUM_TRANSFORM_FRAMES, "ms");
+    report.Add("Transform", "Store batched update", updateUSec / 1000.0 / NUM_TRANSFORM_FRAMES, "ms");
+    report.Add("Transform", "Store world transforms", readUSec[1] / 1000.0 / NUM_TRANSFORM_FRAMES, "ms");
+    report.Add("Transform", "Store total", (markUSec[1] + updateUSec + readUSec[1]) / 1000.0 / NUM_TRANSFORM_FRAMES, "ms");
+    report.Add("Transform", "Store notifications", (double)notifications[1] / NUM_TRANSFORM_FRAMES, "calls");
+    report.Add("Transform", "Recursive interleaved moves and reads", interleavedUSec[0] / 1000.0, "ms");
+    report.Add("Transform", "Store interleaved moves and reads", interleavedUSec[1] / 1000.0, "ms");
+    report.Check("Transform", "Mismatches", (double)mismatches, "nodes");
+}
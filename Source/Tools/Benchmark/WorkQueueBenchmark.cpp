@@ -0,0 +1,137 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+
+#include "Benchmark.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of work units submitted per measurement.
+static const unsigned NUM_WORK_UNITS = 16384;
+/// Number of arithmetic iterations per work unit.
+static const unsigned WORK_UNIT_COST = 2000;
+/// Number of repetitions of each measurement.
+static const unsigned NUM_REPEATS = 10;
+
+/// Sink preventing the work from being optimized away.
+static volatile float workSink = 0.0f;
+
+/// Perform one unit of synthetic work.
+static void DoWorkUnit(unsigned seed)
+{
+    float value = (float)seed;
+    for (unsigned i = 0; i < WORK_UNIT_COST; ++i)
+        value = value * 0.999f + 1.0f / (1.0f + value);
+    workSink = value;
+}
+
+/// Work item function for the legacy queue path.
+static void WorkItemFunction(const WorkItem* item, unsigned threadIndex)
+{
+    DoWorkUnit((unsigned)(size_t)item->start_);
+}
+
+/// Job function for the work-stealing path.
+static void WorkJobFunction(void* data, unsigned threadIndex)
+{
+    DoWorkUnit((unsigned)(size_t)data);
+}
+
+/// Return milliseconds per repetition of a measured function.
+template <class T> static double Measure(const T& function)
+{
+    HiresTimer timer;
+    for (unsigned i = 0; i < NUM_REPEATS; ++i)
+        function();
+    return timer.GetUSec(false) / 1000.0 / NUM_REPEATS;
+}
+
+void RunWorkQueueBenchmark(Context* context, BenchmarkReport& report)
+{
+    PODVector<unsigned> threadCounts;
+    for (unsigned numThreads = 0; numThreads < GetNumLogicalCPUs(); numThreads = numThreads ? numThreads * 2 : 1)
+        threadCounts.Push(numThreads);
+
+    for (unsigned numThreads : threadCounts)
+    {
+        // Worker threads can only be created once per queue
+        SharedPtr<WorkQueue> queue(new WorkQueue(context));
+        if (numThreads)
+            queue->CreateThreads(numThreads);
+
+        // Low priority items go through the single prioritized list shared by all threads
+        double sharedQueueMs = Measure([&]()
+        {
+            for (unsigned i = 0; i < NUM_WORK_UNITS; ++i)
+            {
+                SharedPtr<WorkItem> item = queue->GetFreeItem();
+                item->priority_ = 0;
+                item->workFunction_ = WorkItemFunction;
+                item->start_ = (void*)(size_t)i;
+                queue->AddWorkItem(item);
+            }
+            queue->Complete(0);
+        });
+
+        // Highest priority items are compatibility wrappers around jobs
+        double workItemMs = Measure([&]()
+        {
+            for (unsigned i = 0; i < NUM_WORK_UNITS; ++i)
+            {
+                SharedPtr<WorkItem> item = queue->GetFreeItem();
+                item->priority_ = M_MAX_UNSIGNED;
+                item->workFunction_ = WorkItemFunction;
+                item->start_ = (void*)(size_t)i;
+                queue->AddWorkItem(item);
+            }
+            queue->Complete(M_MAX_UNSIGNED);
+        });
+
+        double jobMs = Measure([&]()
+        {
+            JobCounter counter;
+            for (unsigned i = 0; i < NUM_WORK_UNITS; ++i)
+                queue->AddJob(WorkJobFunction, (void*)(size_t)i, &counter);
+            queue->Wait(counter);
+        });
+
+        double parallelForMs = Measure([&]()
+        {
+            queue->ParallelFor(NUM_WORK_UNITS, 16, [](unsigned begin, unsigned end, unsigned threadIndex)
+            {
+                for (unsigned i = begin; i < end; ++i)
+                    DoWorkUnit(i);
+            });
+        });
+
+        const String suffix = ToString(" (%u workers)", numThreads);
+        report.Add("WorkQueue", "SharedQueue" + suffix, sharedQueueMs, "ms");
+        report.Add("WorkQueue", "WorkItem" + suffix, workItemMs, "ms");
+        report.Add("WorkQueue", "AddJob" + suffix, jobMs, "ms");
+        report.Add("WorkQueue", "ParallelFor" + suffix, parallelForMs, "ms");
+    }
+}
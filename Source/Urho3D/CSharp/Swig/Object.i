@@ -30,6 +30,9 @@ IGNORE_SUBSYSTEM(Tasks)
 %ignore Urho3D::EventHandler;
 %ignore Urho3D::EventHandlerImpl;
 %ignore Urho3D::EventHandler11Impl;
+%ignore Urho3D::TypedEventHandlerImpl;
+%ignore Urho3D::TypedEventHandler11Impl;
+%ignore Urho3D::EventPayload;
 %ignore Urho3D::ObjectFactory;
 %ignore Urho3D::Object::GetEventHandler;
 %ignore Urho3D::Object::SubscribeToEvent;
@@ -265,6 +265,9 @@ namespace SDL
 %include "Urho3D/IO/AbstractFile.h"
 %include "Urho3D/IO/Compression.h"
 %include "Urho3D/IO/File.h"
+%ignore Urho3D::LogRecord;
+%ignore Urho3D::LogArgument;
+%ignore Urho3D::Log::WriteFormat;
 %include "Urho3D/IO/Log.h"
 %include "Urho3D/IO/MemoryBuffer.h"
 %include "Urho3D/IO/PackageFile.h"
@@ -22,6 +22,17 @@
 
 #include "../Precompiled.h"
 
+#include "../Container/Allocator.h"
+#include "../Container/Swap.h"
+#include "../Math/MathDefs.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+
 #include "../DebugNew.h"
 
 namespace Urho3D
@@ -119,4 +130,497 @@ void AllocatorFree(AllocatorBlock* allocator, void* ptr)
     allocator->free_ = node;
 }
 
+/// %Pool allocator magazine.
+struct PoolMagazine
+{
+    /// Next magazine index + 1 in a depot stack.
+    std::atomic<unsigned> next_;
+    /// Magazine index.
+    unsigned index_;
+    /// Number of free nodes.
+    unsigned count_;
+    /// Free nodes.
+    void* nodes_[POOL_MAGAZINE_SIZE];
+};
+
+/// Magazines of a thread for one pool allocator.
+struct PoolThreadCache
+{
+    /// Magazine used for reserving and freeing.
+    PoolMagazine* loaded_;
+    /// Magazine swapped with the loaded one before going to the depot.
+    PoolMagazine* previous_;
+    /// Live node count change not yet applied to the allocator.
+    int liveNodes_;
+};
+
+/// Returns magazines of a thread to the depots when the thread exits.
+struct PoolThreadGuard
+{
+    /// Construct.
+    PoolThreadGuard();
+    /// Destruct.
+    ~PoolThreadGuard();
+};
+
+/// Pool allocators by index.
+static std::atomic<PoolAllocator*> poolAllocators[POOL_MAX_ALLOCATORS];
+/// Number of pool allocators created.
+static std::atomic<unsigned> numPoolAllocators(0);
+/// Magazines of the current thread.
+static thread_local PoolThreadCache threadCaches[POOL_MAX_ALLOCATORS];
+/// Whether the current thread has registered its guard.
+static thread_local bool threadGuardRegistered = false;
+/// Whether the current thread has already released its magazines. Set during thread exit.
+static thread_local bool threadCachesReleased = false;
+/// Guard of the current thread.
+static thread_local PoolThreadGuard threadGuard;
+
+PoolThreadGuard::PoolThreadGuard()
+{
+    threadGuardRegistered = true;
+}
+
+PoolThreadGuard::~PoolThreadGuard()
+{
+    unsigned numAllocators = Min(numPoolAllocators.load(std::memory_order_acquire), POOL_MAX_ALLOCATORS);
+    for (unsigned i = 0; i < numAllocators; ++i)
+    {
+        PoolAllocator* allocator = poolAllocators[i].load(std::memory_order_acquire);
+        if (allocator)
+            allocator->ReleaseThreadCache(threadCaches[i]);
+    }
+    threadCachesReleased = true;
+}
+
+PoolAllocator::PoolAllocator(unsigned nodeSize, const char* name) :
+    index_(M_MAX_UNSIGNED),
+    nodeSize_(Max(GetSizeClass(nodeSize), (unsigned)POOL_SIZE_CLASS_GRANULARITY)),
+    fullMagazines_(0),
+    emptyMagazines_(0),
+    numMagazines_(0),
+    blocks_(nullptr),
+    numBlocks_(0),
+    liveNodes_(0),
+    peakNodes_(0),
+    reservedBytes_(0)
+{
+    strncpy(name_, name ? name : "", sizeof(name_) - 1);
+    name_[sizeof(name_) - 1] = 0;
+    for (auto& chunk : magazineChunks_)
+        chunk.store(nullptr, std::memory_order_relaxed);
+}
+
+PoolAllocator* PoolAllocator::Create(unsigned nodeSize, const char* name)
+{
+    // Pool allocators are never destroyed, as nodes may be freed until the very end of the process
+    auto* allocator = new PoolAllocator(nodeSize, name);
+    allocator->index_ = numPoolAllocators.fetch_add(1, std::memory_order_acq_rel);
+    if (allocator->index_ < POOL_MAX_ALLOCATORS)
+        poolAllocators[allocator->index_].store(allocator, std::memory_order_release);
+    return allocator;
+}
+
+unsigned long long PoolAllocator::TrimAll()
+{
+    unsigned long long releasedBytes = 0;
+    unsigned numAllocators = GetNumAllocators();
+    for (unsigned i = 0; i < numAllocators; ++i)
+    {
+        if (PoolAllocator* allocator = poolAllocators[i].load(std::memory_order_acquire))
+            releasedBytes += allocator->Trim();
+    }
+    return releasedBytes;
+}
+
+unsigned PoolAllocator::GetNumAllocators()
+{
+    return Min(numPoolAllocators.load(std::memory_order_acquire), POOL_MAX_ALLOCATORS);
+}
+
+PoolAllocator* PoolAllocator::GetAllocator(unsigned index)
+{
+    return index < GetNumAllocators() ? poolAllocators[index].load(std::memory_order_acquire) : nullptr;
+}
+
+PoolAllocatorStats PoolAllocator::GetStats() const
+{
+    PoolAllocatorStats stats;
+    stats.name_ = name_;
+    stats.nodeSize_ = nodeSize_;
+    stats.liveNodes_ = (unsigned)Max(liveNodes_.load(std::memory_order_relaxed), 0);
+    stats.peakNodes_ = (unsigned)Max(peakNodes_.load(std::memory_order_relaxed), 0);
+    stats.reservedBytes_ = reservedBytes_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+unsigned long long PoolAllocator::Trim()
+{
+    // Other threads may keep reserving and freeing nodes meanwhile. They can not add blocks while the lock is held and
+    // only see fewer magazines in the depot
+    std::lock_guard<std::mutex> lock(blocksMutex_);
+
+    if (index_ < POOL_MAX_ALLOCATORS && !threadCachesReleased)
+        ReleaseThreadCache(threadCaches[index_]);
+
+    // Take the magazines with free nodes out of the depot and chain them privately
+    unsigned firstMagazine = 0;
+    unsigned numFreeNodes = 0;
+    while (PoolMagazine* magazine = PopMagazine(fullMagazines_))
+    {
+        magazine->next_.store(firstMagazine, std::memory_order_relaxed);
+        firstMagazine = magazine->index_ + 1;
+        numFreeNodes += magazine->count_;
+    }
+
+    unsigned blockSize = POOL_SIZE_CLASS_GRANULARITY + nodeSize_ * POOL_MAGAZINE_SIZE;
+    unsigned numReleased = 0;
+    if (numFreeNodes >= POOL_MAGAZINE_SIZE)
+    {
+        // Count the free nodes of each block. A block whose nodes are all in the depot can not be in use anywhere
+        auto** blocks = new unsigned char*[numBlocks_];
+        auto* freeCounts = new unsigned[numBlocks_];
+        unsigned numBlocks = 0;
+        for (void* block = blocks_; block; block = *reinterpret_cast<void**>(block))
+        {
+            blocks[numBlocks] = static_cast<unsigned char*>(block);
+            freeCounts[numBlocks] = 0;
+            ++numBlocks;
+        }
+        std::sort(blocks, blocks + numBlocks, std::less<unsigned char*>());
+
+        auto findBlock = [&](void* node)
+        {
+            return (unsigned)(std::upper_bound(blocks, blocks + numBlocks, static_cast<unsigned char*>(node),
+                std::less<unsigned char*>()) - blocks) - 1;
+        };
+
+        for (unsigned index = firstMagazine; index; index = GetMagazine(index - 1)->next_.load(std::memory_order_relaxed))
+        {
+            PoolMagazine* magazine = GetMagazine(index - 1);
+            for (unsigned i = 0; i < magazine->count_; ++i)
+                ++freeCounts[findBlock(magazine->nodes_[i])];
+        }
+
+        for (unsigned i = 0; i < numBlocks; ++i)
+        {
+            if (freeCounts[i] == POOL_MAGAZINE_SIZE)
+                ++numReleased;
+        }
+
+        if (numReleased)
+        {
+            // Pack the nodes of the remaining blocks into the front magazines, then free the released blocks
+            unsigned writeIndex = firstMagazine;
+            unsigned writeCount = 0;
+            for (unsigned index = firstMagazine; index; index = GetMagazine(index - 1)->next_.load(std::memory_order_relaxed))
+            {
+                PoolMagazine* magazine = GetMagazine(index - 1);
+                unsigned count = magazine->count_;
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    void* node = magazine->nodes_[i];
+                    if (freeCounts[findBlock(node)] == POOL_MAGAZINE_SIZE)
+                        continue;
+
+                    PoolMagazine* target = GetMagazine(writeIndex - 1);
+                    if (writeCount == POOL_MAGAZINE_SIZE)
+                    {
+                        target->count_ = writeCount;
+                        writeIndex = target->next_.load(std::memory_order_relaxed);
+                        target = GetMagazine(writeIndex - 1);
+                        writeCount = 0;
+                    }
+                    target->nodes_[writeCount++] = node;
+                }
+                // The write position never passes the read position, so a magazine ahead of it has been emptied
+                if (index != writeIndex)
+                    magazine->count_ = 0;
+            }
+            GetMagazine(writeIndex - 1)->count_ = writeCount;
+
+            blocks_ = nullptr;
+            numBlocks_ = 0;
+            for (unsigned i = 0; i < numBlocks; ++i)
+            {
+                if (freeCounts[i] == POOL_MAGAZINE_SIZE)
+                    delete[] blocks[i];
+                else
+                {
+                    *reinterpret_cast<void**>(blocks[i]) = blocks_;
+                    blocks_ = blocks[i];
+                    ++numBlocks_;
+                }
+            }
+            reservedBytes_.fetch_sub((unsigned long long)numReleased * blockSize, std::memory_order_relaxed);
+        }
+
+        delete[] freeCounts;
+        delete[] blocks;
+    }
+
+    // Return the magazines to the depot
+    while (firstMagazine)
+    {
+        PoolMagazine* magazine = GetMagazine(firstMagazine - 1);
+        firstMagazine = magazine->next_.load(std::memory_order_relaxed);
+        PushMagazine(magazine->count_ ? fullMagazines_ : emptyMagazines_, magazine);
+    }
+
+    return (unsigned long long)numReleased * blockSize;
+}
+
+void* PoolAllocator::Reserve()
+{
+    if (index_ < POOL_MAX_ALLOCATORS)
+    {
+        PoolThreadCache& cache = threadCaches[index_];
+        PoolMagazine* magazine = cache.loaded_;
+        if (magazine && magazine->count_)
+        {
+            ++cache.liveNodes_;
+            return magazine->nodes_[--magazine->count_];
+        }
+        if (!threadCachesReleased)
+            return ReserveSlow(cache);
+    }
+
+    return ReserveDirect();
+}
+
+void PoolAllocator::Free(void* ptr)
+{
+    if (!ptr)
+        return;
+
+    if (index_ < POOL_MAX_ALLOCATORS)
+    {
+        PoolThreadCache& cache = threadCaches[index_];
+        PoolMagazine* magazine = cache.loaded_;
+        if (magazine && magazine->count_ < POOL_MAGAZINE_SIZE)
+        {
+            --cache.liveNodes_;
+            magazine->nodes_[magazine->count_++] = ptr;
+            return;
+        }
+        if (!threadCachesReleased)
+        {
+            FreeSlow(cache, ptr);
+            return;
+        }
+    }
+
+    FreeDirect(ptr);
+}
+
+void* PoolAllocator::ReserveSlow(PoolThreadCache& cache)
+{
+    // Touching the guard constructs it, which makes sure the magazines are returned when the thread exits
+    if (!threadGuardRegistered)
+        (void)&threadGuard;
+
+    if (!cache.loaded_)
+        cache.loaded_ = AcquireFullMagazine();
+    else if (cache.previous_ && cache.previous_->count_)
+        Swap(cache.loaded_, cache.previous_);
+    else
+    {
+        if (cache.previous_)
+            PushMagazine(emptyMagazines_, cache.previous_);
+        cache.previous_ = cache.loaded_;
+        cache.loaded_ = AcquireFullMagazine();
+    }
+
+    ++cache.liveNodes_;
+    FlushLiveNodes(cache);
+    PoolMagazine* magazine = cache.loaded_;
+    return magazine->nodes_[--magazine->count_];
+}
+
+void PoolAllocator::FreeSlow(PoolThreadCache& cache, void* ptr)
+{
+    if (!threadGuardRegistered)
+        (void)&threadGuard;
+
+    if (!cache.loaded_)
+        cache.loaded_ = AcquireEmptyMagazine();
+    else if (cache.previous_ && cache.previous_->count_ < POOL_MAGAZINE_SIZE)
+        Swap(cache.loaded_, cache.previous_);
+    else
+    {
+        if (cache.previous_)
+            PushMagazine(fullMagazines_, cache.previous_);
+        cache.previous_ = cache.loaded_;
+        cache.loaded_ = AcquireEmptyMagazine();
+    }
+
+    --cache.liveNodes_;
+    FlushLiveNodes(cache);
+    PoolMagazine* magazine = cache.loaded_;
+    magazine->nodes_[magazine->count_++] = ptr;
+}
+
+void* PoolAllocator::ReserveDirect()
+{
+    PoolMagazine* magazine = AcquireFullMagazine();
+    void* ptr = magazine->nodes_[--magazine->count_];
+    PushMagazine(magazine->count_ ? fullMagazines_ : emptyMagazines_, magazine);
+    UpdateLiveNodes(1);
+    return ptr;
+}
+
+void PoolAllocator::FreeDirect(void* ptr)
+{
+    PoolMagazine* magazine = AcquireEmptyMagazine();
+    magazine->nodes_[magazine->count_++] = ptr;
+    PushMagazine(fullMagazines_, magazine);
+    UpdateLiveNodes(-1);
+}
+
+void PoolAllocator::ReleaseThreadCache(PoolThreadCache& cache)
+{
+    PoolMagazine* magazines[] = { cache.loaded_, cache.previous_ };
+    for (PoolMagazine* magazine : magazines)
+    {
+        if (magazine)
+            PushMagazine(magazine->count_ ? fullMagazines_ : emptyMagazines_, magazine);
+    }
+    cache.loaded_ = nullptr;
+    cache.previous_ = nullptr;
+    FlushLiveNodes(cache);
+}
+
+void PoolAllocator::FlushLiveNodes(PoolThreadCache& cache)
+{
+    if (cache.liveNodes_)
+    {
+        UpdateLiveNodes(cache.liveNodes_);
+        cache.liveNodes_ = 0;
+    }
+}
+
+void PoolAllocator::UpdateLiveNodes(int delta)
+{
+    int liveNodes = liveNodes_.fetch_add(delta, std::memory_order_relaxed) + delta;
+    int peakNodes = peakNodes_.load(std::memory_order_relaxed);
+    while (liveNodes > peakNodes && !peakNodes_.compare_exchange_weak(peakNodes, liveNodes, std::memory_order_relaxed))
+    {
+    }
+}
+
+/// Return index of the magazine chunk that holds a magazine.
+static unsigned GetMagazineChunkIndex(unsigned index)
+{
+    return LogBaseTwo(index / POOL_MAGAZINE_CHUNK_SIZE + 1);
+}
+
+/// Return index of the first magazine in a magazine chunk.
+static unsigned GetMagazineChunkStart(unsigned chunkIndex)
+{
+    return POOL_MAGAZINE_CHUNK_SIZE * ((1u << chunkIndex) - 1);
+}
+
+PoolMagazine* PoolAllocator::GetMagazine(unsigned index) const
+{
+    unsigned chunkIndex = GetMagazineChunkIndex(index);
+    return magazineChunks_[chunkIndex].load(std::memory_order_acquire) + (index - GetMagazineChunkStart(chunkIndex));
+}
+
+PoolMagazine* PoolAllocator::CreateMagazine()
+{
+    // The chunks double in size, so their slots cover all magazine indices and the pool can grow as long as memory lasts
+    unsigned index = numMagazines_.fetch_add(1, std::memory_order_relaxed);
+    unsigned chunkIndex = GetMagazineChunkIndex(index);
+    std::atomic<PoolMagazine*>& chunk = magazineChunks_[chunkIndex];
+    if (!chunk.load(std::memory_order_acquire))
+    {
+        // Several threads may race to create the same chunk, the losers discard theirs
+        unsigned chunkStart = GetMagazineChunkStart(chunkIndex);
+        auto chunkSize = (unsigned)Min((unsigned long long)POOL_MAGAZINE_CHUNK_SIZE << chunkIndex,
+            0x100000000ULL - chunkStart);
+        auto* newChunk = new PoolMagazine[chunkSize];
+        for (unsigned i = 0; i < chunkSize; ++i)
+        {
+            newChunk[i].next_.store(0, std::memory_order_relaxed);
+            newChunk[i].index_ = chunkStart + i;
+            newChunk[i].count_ = 0;
+        }
+        PoolMagazine* expected = nullptr;
+        if (!chunk.compare_exchange_strong(expected, newChunk, std::memory_order_acq_rel))
+            delete[] newChunk;
+    }
+
+    return GetMagazine(index);
+}
+
+void PoolAllocator::FillMagazine(PoolMagazine* magazine)
+{
+    // The block starts with a link to the previous block, padded to keep the nodes aligned
+    unsigned blockSize = POOL_SIZE_CLASS_GRANULARITY + nodeSize_ * POOL_MAGAZINE_SIZE;
+    auto* block = new unsigned char[blockSize];
+    {
+        std::lock_guard<std::mutex> lock(blocksMutex_);
+        *reinterpret_cast<void**>(block) = blocks_;
+        blocks_ = block;
+        ++numBlocks_;
+    }
+    reservedBytes_.fetch_add(blockSize, std::memory_order_relaxed);
+
+    unsigned char* nodePtr = block + POOL_SIZE_CLASS_GRANULARITY;
+    for (unsigned i = 0; i < POOL_MAGAZINE_SIZE; ++i)
+    {
+        magazine->nodes_[i] = nodePtr;
+        nodePtr += nodeSize_;
+    }
+    magazine->count_ = POOL_MAGAZINE_SIZE;
+}
+
+PoolMagazine* PoolAllocator::AcquireFullMagazine()
+{
+    PoolMagazine* magazine = PopMagazine(fullMagazines_);
+    if (!magazine)
+    {
+        magazine = PopMagazine(emptyMagazines_);
+        if (!magazine)
+            magazine = CreateMagazine();
+        FillMagazine(magazine);
+    }
+    return magazine;
+}
+
+PoolMagazine* PoolAllocator::AcquireEmptyMagazine()
+{
+    PoolMagazine* magazine = PopMagazine(emptyMagazines_);
+    return magazine ? magazine : CreateMagazine();
+}
+
+void PoolAllocator::PushMagazine(std::atomic<unsigned long long>& stack, PoolMagazine* magazine)
+{
+    unsigned long long head = stack.load(std::memory_order_relaxed);
+    unsigned long long newHead;
+    do
+    {
+        magazine->next_.store((unsigned)head, std::memory_order_relaxed);
+        newHead = (((head >> 32u) + 1) << 32u) | (magazine->index_ + 1);
+    } while (!stack.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed));
+}
+
+PoolMagazine* PoolAllocator::PopMagazine(std::atomic<unsigned long long>& stack)
+{
+    unsigned long long head = stack.load(std::memory_order_acquire);
+    for (;;)
+    {
+        auto top = (unsigned)head;
+        if (!top)
+            return nullptr;
+
+        // The tag in the upper bits changes on every push and pop, so a magazine that was popped and pushed back
+        // meanwhile makes the exchange fail
+        PoolMagazine* magazine = GetMagazine(top - 1);
+        unsigned long long newHead = (((head >> 32u) + 1) << 32u) | magazine->next_.load(std::memory_order_relaxed);
+        if (stack.compare_exchange_weak(head, newHead, std::memory_order_acquire, std::memory_order_acquire))
+            return magazine;
+    }
+}
+
 }
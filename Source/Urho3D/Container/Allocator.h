@@ -28,7 +28,10 @@
 #include <Urho3D/Urho3D.h>
 #endif
 
+#include <atomic>
 #include <cstddef>
+#include <mutex>
+#include <typeinfo>
 #include <utility>
 
 
@@ -69,24 +72,162 @@ URHO3D_API void* AllocatorReserve(AllocatorBlock* allocator);
 /// Free a node. Does not free any blocks.
 URHO3D_API void AllocatorFree(AllocatorBlock* allocator, void* ptr);
 
-/// %Allocator template class. Allocates objects of a specific class.
-template <class T> class Allocator
+/// Number of nodes held by a pool allocator magazine.
+static const unsigned POOL_MAGAZINE_SIZE = 64;
+/// Number of magazines in the first magazine chunk of a pool allocator. Each following chunk is twice as large.
+static const unsigned POOL_MAGAZINE_CHUNK_SIZE = 64;
+/// Number of magazine chunk slots of a pool allocator. Enough to address every 32-bit magazine index, so the number of magazines is only limited by memory.
+static const unsigned POOL_MAX_MAGAZINE_CHUNKS = 27;
+/// Maximum number of pool allocators that use thread-local magazines and report statistics. Allocators created after that go through the depot directly.
+static const unsigned POOL_MAX_ALLOCATORS = 1024;
+/// Granularity of pool allocator node sizes.
+static const unsigned POOL_SIZE_CLASS_GRANULARITY = 16;
+
+struct PoolMagazine;
+struct PoolThreadCache;
+
+/// %Pool allocator statistics.
+struct PoolAllocatorStats
+{
+    /// Allocator name.
+    const char* name_;
+    /// Size of a node in bytes.
+    unsigned nodeSize_;
+    /// Number of nodes currently in use.
+    unsigned liveNodes_;
+    /// Highest number of nodes in use at once.
+    unsigned peakNodes_;
+    /// Number of bytes reserved for nodes.
+    unsigned long long reservedBytes_;
+};
+
+/// Thread-safe fixed-size node allocator. Each thread keeps two magazines of free nodes per allocator, so reserving and
+/// freeing a node normally touches thread-local data only. Full and empty magazines are exchanged through a lock-free
+/// depot. Nodes are reserved from the system in blocks of one magazine, which are returned by Trim() once all their
+/// nodes are free. Pools live until the process exits. Live and peak node counts are gathered from the threads lazily
+/// and are approximate while other threads are working.
+class URHO3D_API PoolAllocator
 {
 public:
-    /// Construct.
-    explicit Allocator(unsigned initialCapacity = 0) :
-        allocator_(nullptr)
+    /// Prevent copy construction.
+    PoolAllocator(const PoolAllocator& rhs) = delete;
+    /// Prevent assignment.
+    PoolAllocator& operator =(const PoolAllocator& rhs) = delete;
+
+    /// Reserve a node.
+    void* Reserve();
+    /// Free a node. The node may be freed on a different thread than it was reserved on.
+    void Free(void* ptr);
+
+    /// Return allocator name.
+    const char* GetName() const { return name_; }
+    /// Return size of a node in bytes.
+    unsigned GetNodeSize() const { return nodeSize_; }
+    /// Return statistics.
+    PoolAllocatorStats GetStats() const;
+    /// Return node blocks whose nodes are all free in the depot to the system. Magazines cached by other threads are not
+    /// considered, those of the calling thread are returned to the depot first. Return number of bytes released.
+    unsigned long long Trim();
+
+    /// Create a named pool allocator for nodes of the specified size. The name is copied.
+    static PoolAllocator* Create(unsigned nodeSize, const char* name);
+    /// Trim all registered pool allocators. Return number of bytes released.
+    static unsigned long long TrimAll();
+    /// Return node size rounded up to the allocation granularity.
+    static unsigned GetSizeClass(unsigned nodeSize)
     {
-        if (initialCapacity)
-            allocator_ = AllocatorInitialize((unsigned)sizeof(T), initialCapacity);
+        return (nodeSize + POOL_SIZE_CLASS_GRANULARITY - 1) & ~(POOL_SIZE_CLASS_GRANULARITY - 1);
     }
+    /// Return number of pool allocators created so far.
+    static unsigned GetNumAllocators();
+    /// Return pool allocator by index, or null if out of range.
+    static PoolAllocator* GetAllocator(unsigned index);
+
+private:
+    /// Construct. Use Create() or GetPoolAllocator() instead.
+    PoolAllocator(unsigned nodeSize, const char* name);
 
-    /// Destruct.
-    ~Allocator()
+    /// Reserve a node when the loaded magazine of the thread is empty.
+    void* ReserveSlow(PoolThreadCache& cache);
+    /// Free a node when the loaded magazine of the thread is full.
+    void FreeSlow(PoolThreadCache& cache, void* ptr);
+    /// Reserve a node without a thread cache.
+    void* ReserveDirect();
+    /// Free a node without a thread cache.
+    void FreeDirect(void* ptr);
+    /// Return magazines of a thread cache to the depot.
+    void ReleaseThreadCache(PoolThreadCache& cache);
+    /// Apply the live node count change gathered by a thread cache.
+    void FlushLiveNodes(PoolThreadCache& cache);
+    /// Apply a live node count change.
+    void UpdateLiveNodes(int delta);
+    /// Return magazine by index.
+    PoolMagazine* GetMagazine(unsigned index) const;
+    /// Create a new empty magazine.
+    PoolMagazine* CreateMagazine();
+    /// Fill a magazine with newly reserved nodes.
+    void FillMagazine(PoolMagazine* magazine);
+    /// Take a magazine with free nodes from the depot, creating one if necessary.
+    PoolMagazine* AcquireFullMagazine();
+    /// Take an empty magazine from the depot, creating one if necessary.
+    PoolMagazine* AcquireEmptyMagazine();
+    /// Push a magazine to a depot stack.
+    void PushMagazine(std::atomic<unsigned long long>& stack, PoolMagazine* magazine);
+    /// Pop a magazine from a depot stack. Return null if the stack is empty.
+    PoolMagazine* PopMagazine(std::atomic<unsigned long long>& stack);
+
+    /// Allocator index.
+    unsigned index_;
+    /// Size of a node in bytes.
+    unsigned nodeSize_;
+    /// Allocator name.
+    char name_[128];
+    /// Depot stack of magazines holding free nodes. Packed as an ABA tag and magazine index + 1.
+    std::atomic<unsigned long long> fullMagazines_;
+    /// Depot stack of empty magazines.
+    std::atomic<unsigned long long> emptyMagazines_;
+    /// Number of magazines created.
+    std::atomic<unsigned> numMagazines_;
+    /// Magazine chunks.
+    std::atomic<PoolMagazine*> magazineChunks_[POOL_MAX_MAGAZINE_CHUNKS];
+    /// Guards the chain of node blocks.
+    std::mutex blocksMutex_;
+    /// Chain of node blocks.
+    void* blocks_;
+    /// Number of node blocks.
+    unsigned numBlocks_;
+    /// Number of nodes in use.
+    std::atomic<int> liveNodes_;
+    /// Highest number of nodes in use at once.
+    std::atomic<int> peakNodes_;
+    /// Number of bytes reserved for nodes.
+    std::atomic<unsigned long long> reservedBytes_;
+
+    friend struct PoolThreadGuard;
+};
+
+/// Return the pool allocator for objects of a specific type, named after the type so that statistics are reported per
+/// type. Used by the containers for their nodes.
+template <class T> PoolAllocator* GetPoolAllocator()
+{
+    static PoolAllocator* pool = PoolAllocator::Create((unsigned)sizeof(T), typeid(T).name());
+    return pool;
+}
+
+/// %Allocator template class. Allocates objects of a specific class from a pool allocator that is shared by all
+/// allocators of the same class and is safe to use from multiple threads.
+template <class T> class Allocator
+{
+public:
+    /// Construct. The pool grows on demand, so the initial capacity is ignored.
+    explicit Allocator(unsigned /*initialCapacity*/ = 0) :
+        allocator_(GetPool())
     {
-        AllocatorUninitialize(allocator_);
     }
 
+    /// Destruct. Objects that were not freed stay reserved in the shared pool.
+    ~Allocator() = default;
+
     /// Prevent copy construction.
     Allocator(const Allocator<T>& rhs) = delete;
     /// Prevent assignment.
@@ -96,9 +237,7 @@ public:
     template<typename... Args>
     T* Reserve(Args&&... args)
     {
-        if (!allocator_)
-            allocator_ = AllocatorInitialize((unsigned)sizeof(T));
-        auto* newObject = static_cast<T*>(AllocatorReserve(allocator_));
+        auto* newObject = static_cast<T*>(allocator_->Reserve());
         new(newObject) T(std::forward<Args>(args)...);
 
         return newObject;
@@ -107,9 +246,7 @@ public:
     /// Reserve and copy-construct an object.
     T* Reserve(const T& object)
     {
-        if (!allocator_)
-            allocator_ = AllocatorInitialize((unsigned)sizeof(T));
-        auto* newObject = static_cast<T*>(AllocatorReserve(allocator_));
+        auto* newObject = static_cast<T*>(allocator_->Reserve());
         new(newObject) T(object);
 
         return newObject;
@@ -119,12 +256,15 @@ public:
     void Free(T* object)
     {
         (object)->~T();
-        AllocatorFree(allocator_, object);
+        allocator_->Free(object);
     }
 
+    /// Return the pool allocator shared by all allocators of this class.
+    static PoolAllocator* GetPool() { return GetPoolAllocator<T>(); }
+
 private:
-    /// Allocator block.
-    AllocatorBlock* allocator_;
+    /// Pool allocator.
+    PoolAllocator* allocator_;
 };
 
 }
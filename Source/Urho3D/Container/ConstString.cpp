@@ -0,0 +1,126 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Container/ConstString.h"
+#include "../Container/FlatHashMap.h"
+
+#include <mutex>
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+ConstStringEntry ConstString::emptyEntry(String(), StringHash(), nullptr);
+
+/// Number of interned string pool shards.
+static const unsigned NUM_CONST_STRING_SHARDS = 64;
+
+/// Interned string pool shard.
+struct ConstStringShard
+{
+    /// Guards the shard.
+    std::mutex mutex_;
+    /// Interned strings by hash.
+    FlatHashMap<StringHash, ConstStringEntry*> entries_;
+};
+
+/// Return the pool shard of a hash.
+static ConstStringShard& GetConstStringShard(StringHash hash)
+{
+    // Never destroyed, as interned strings may be referenced by static objects
+    static auto* shards = new ConstStringShard[NUM_CONST_STRING_SHARDS];
+    return shards[hash.Value() % NUM_CONST_STRING_SHARDS];
+}
+
+ConstStringEntry* ConstString::Intern(const char* str, unsigned length)
+{
+    if (!length)
+        return &emptyEntry;
+
+    // Hash exactly the characters that are compared, which is the same as StringHash unless the string contains zeros
+    StringHash hash(StringHash::Calculate((void*)str, length));
+    ConstStringShard& shard = GetConstStringShard(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+
+    ConstStringEntry*& head = shard.entries_[hash];
+    for (ConstStringEntry* entry = head; entry; entry = entry->next_)
+    {
+        if (entry->string_.Length() == length && !memcmp(entry->string_.CString(), str, length))
+        {
+            entry->refs_.fetch_add(1, std::memory_order_relaxed);
+            return entry;
+        }
+    }
+
+    auto* entry = new ConstStringEntry(String(str, length), hash, head);
+    head = entry;
+    return entry;
+}
+
+void ConstString::ReleaseSlow(ConstStringEntry* entry)
+{
+    // Drop references without the lock while others remain
+    int refs = entry->refs_.load(std::memory_order_relaxed);
+    while (refs > 1)
+    {
+        if (entry->refs_.compare_exchange_weak(refs, refs - 1, std::memory_order_release, std::memory_order_relaxed))
+            return;
+    }
+
+    // The last reference goes away under the lock, so Intern() can not hand out the entry meanwhile. It may have
+    // handed it out before the lock was taken, in which case the entry stays
+    ConstStringShard& shard = GetConstStringShard(entry->hash_);
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+    if (entry->refs_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    auto i = shard.entries_.Find(entry->hash_);
+    ConstStringEntry** link = &i->second_;
+    while (*link != entry)
+        link = &(*link)->next_;
+    *link = entry->next_;
+    if (!i->second_)
+        shard.entries_.Erase(i);
+    delete entry;
+}
+
+unsigned ConstString::GetNumStrings()
+{
+    unsigned numStrings = 0;
+    for (unsigned i = 0; i < NUM_CONST_STRING_SHARDS; ++i)
+    {
+        ConstStringShard& shard = GetConstStringShard(StringHash(i));
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        for (auto j = shard.entries_.Begin(); j != shard.entries_.End(); ++j)
+        {
+            for (ConstStringEntry* entry = j->second_; entry; entry = entry->next_)
+                ++numStrings;
+        }
+    }
+    return numStrings;
+}
+
+}
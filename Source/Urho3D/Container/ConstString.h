@@ -0,0 +1,152 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/Str.h"
+#include "../Math/StringHash.h"
+
+#include <atomic>
+
+namespace Urho3D
+{
+
+/// Interned string entry.
+struct ConstStringEntry
+{
+    /// Construct.
+    ConstStringEntry(const String& str, StringHash hash, ConstStringEntry* next) :
+        string_(str),
+        hash_(hash),
+        next_(next),
+        refs_(1)
+    {
+    }
+
+    /// String.
+    String string_;
+    /// Hash of the string.
+    StringHash hash_;
+    /// Next entry with the same hash.
+    ConstStringEntry* next_;
+    /// Number of ConstStrings referring to the entry.
+    std::atomic<int> refs_;
+};
+
+/// Immutable interned string. Equal strings share one entry of a global pool keyed by StringHash, so that a string
+/// repeated many times, such as a node name, is stored once and copying or comparing is a pointer operation. Entries
+/// are reference counted and removed from the pool when the last reference goes away. Interning is thread-safe; the
+/// pool is split into shards with a lock of their own, so threads interning different strings rarely wait for each other.
+class URHO3D_API ConstString
+{
+public:
+    /// Construct empty.
+    ConstString() noexcept :
+        entry_(&emptyEntry)
+    {
+    }
+
+    /// Copy-construct from another interned string.
+    ConstString(const ConstString& rhs) noexcept :
+        entry_(rhs.entry_)
+    {
+        AddRef(entry_);
+    }
+
+    /// Destruct.
+    ~ConstString() { Release(entry_); }
+
+    /// Assign another interned string.
+    ConstString& operator =(const ConstString& rhs) noexcept
+    {
+        AddRef(rhs.entry_);
+        Release(entry_);
+        entry_ = rhs.entry_;
+        return *this;
+    }
+
+    /// Construct from a string.
+    ConstString(const String& str) :        // NOLINT(google-explicit-constructor)
+        entry_(Intern(str.CString(), str.Length()))
+    {
+    }
+
+    /// Construct from a C string.
+    ConstString(const char* str) :          // NOLINT(google-explicit-constructor)
+        entry_(Intern(str, (unsigned)strlen(str)))
+    {
+    }
+
+    /// Test for equality with another interned string.
+    bool operator ==(const ConstString& rhs) const { return entry_ == rhs.entry_; }
+    /// Test for inequality with another interned string.
+    bool operator !=(const ConstString& rhs) const { return entry_ != rhs.entry_; }
+    /// Test for equality with a string.
+    bool operator ==(const String& rhs) const { return entry_->string_ == rhs; }
+    /// Test for inequality with a string.
+    bool operator !=(const String& rhs) const { return entry_->string_ != rhs; }
+
+    /// Return the string.
+    const String& GetString() const { return entry_->string_; }
+    /// Return the string.
+    operator const String&() const { return entry_->string_; }      // NOLINT(google-explicit-constructor)
+    /// Return the C string.
+    const char* CString() const { return entry_->string_.CString(); }
+    /// Return length.
+    unsigned Length() const { return entry_->string_.Length(); }
+    /// Return whether the string is empty.
+    bool Empty() const { return entry_->string_.Empty(); }
+    /// Return hash of the string.
+    StringHash GetHash() const { return entry_->hash_; }
+    /// Return hash value for HashSet & HashMap.
+    unsigned ToHash() const { return entry_->hash_.Value(); }
+
+    /// Return number of interned strings.
+    static unsigned GetNumStrings();
+
+private:
+    /// Find or create the entry of a string and add a reference to it.
+    static ConstStringEntry* Intern(const char* str, unsigned length);
+    /// Add a reference to an entry. The empty string entry is static and not counted.
+    static void AddRef(ConstStringEntry* entry)
+    {
+        if (entry != &emptyEntry)
+            entry->refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+    /// Remove a reference from an entry. Removes the entry from the pool when it was the last one.
+    static void Release(ConstStringEntry* entry)
+    {
+        if (entry != &emptyEntry)
+            ReleaseSlow(entry);
+    }
+    /// Remove a reference from a non-empty entry.
+    static void ReleaseSlow(ConstStringEntry* entry);
+
+    /// Interned entry.
+    ConstStringEntry* entry_;
+
+    /// Entry of the empty string.
+    static ConstStringEntry emptyEntry;
+};
+
+}
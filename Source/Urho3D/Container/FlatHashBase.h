@@ -0,0 +1,166 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#ifdef URHO3D_IS_BUILDING
+#include "Urho3D.h"
+#else
+#include <Urho3D/Urho3D.h>
+#endif
+
+#include "../Container/Hash.h"
+#include "../Container/Swap.h"
+
+namespace Urho3D
+{
+
+/// Open addressing hash set/map base class. Elements are stored inline in a single array using Robin Hood hashing with
+/// one byte of probe distance per slot, so lookups scan consecutive memory instead of following node pointers. The
+/// table does not wrap around; it has a few overflow slots past the last bucket and grows when an element would need a
+/// longer probe sequence. Inserting may move elements, so iterators and pointers to elements are invalidated by
+/// insertion and erasure.
+/** Note that to prevent extra memory use due to vtable pointer, %FlatHashBase intentionally does not declare a virtual
+    destructor and therefore %FlatHashBase pointers should never be used.
+  */
+class FlatHashBase
+{
+public:
+    /// Initial amount of buckets.
+    static const unsigned MIN_BUCKETS = 8;
+    /// Shortest allowed probe sequence.
+    static const unsigned MIN_PROBE_LENGTH = 4;
+    /// Probe distance of an empty slot.
+    static const unsigned char EMPTY_SLOT = 0;
+    /// Probe distance stored past the last slot to stop iteration.
+    static const unsigned char END_SLOT = 0xff;
+
+    /// Construct.
+    FlatHashBase() :
+        distances_(EmptyDistances()),
+        slots_(nullptr),
+        numBuckets_(0),
+        numSlots_(0),
+        maxProbe_(0),
+        shift_(0),
+        size_(0)
+    {
+    }
+
+    /// Swap with another hash set or map.
+    void Swap(FlatHashBase& rhs)
+    {
+        Urho3D::Swap(distances_, rhs.distances_);
+        Urho3D::Swap(slots_, rhs.slots_);
+        Urho3D::Swap(numBuckets_, rhs.numBuckets_);
+        Urho3D::Swap(numSlots_, rhs.numSlots_);
+        Urho3D::Swap(maxProbe_, rhs.maxProbe_);
+        Urho3D::Swap(shift_, rhs.shift_);
+        Urho3D::Swap(size_, rhs.size_);
+    }
+
+    /// Return number of elements.
+    unsigned Size() const { return size_; }
+
+    /// Return number of buckets.
+    unsigned NumBuckets() const { return numBuckets_; }
+
+    /// Return whether has no elements.
+    bool Empty() const { return size_ == 0; }
+
+protected:
+    /// Return the shared distance array of an unallocated table. It only holds the end marker.
+    static unsigned char* EmptyDistances()
+    {
+        static unsigned char endSlot = END_SLOT;
+        return &endSlot;
+    }
+
+    /// Return whether the table should grow before inserting one more element. Buckets are kept at most 7/8 full.
+    bool NeedsGrow() const { return (size_ + 1) * 8 > numBuckets_ * 7; }
+
+    /// Return bucket count to grow to.
+    unsigned GrowBuckets() const { return numBuckets_ ? numBuckets_ << 1u : MIN_BUCKETS; }
+
+    /// Return the home bucket of a hash. Multiplicative hashing spreads keys that differ only in their high bits.
+    unsigned BucketIndex(unsigned hash) const { return (unsigned)((hash * 2654435769u) >> shift_); }
+
+    /// Allocate empty storage for the specified bucket count, which must be a power of two. The previous storage is
+    /// not freed.
+    void AllocateStorage(unsigned numBuckets, unsigned elementSize)
+    {
+        unsigned log2 = 0;
+        while ((1u << log2) < numBuckets)
+            ++log2;
+
+        numBuckets_ = numBuckets;
+        maxProbe_ = log2 > MIN_PROBE_LENGTH ? log2 : MIN_PROBE_LENGTH;
+        numSlots_ = numBuckets + maxProbe_;
+        shift_ = 32 - log2;
+
+        // The distance array comes first, rounded up so that the slots are aligned
+        unsigned slotOffset = (numSlots_ + 1 + 15) & ~15u;
+        auto* storage = new unsigned char[slotOffset + numSlots_ * elementSize];
+        for (unsigned i = 0; i < numSlots_; ++i)
+            storage[i] = EMPTY_SLOT;
+        storage[numSlots_] = END_SLOT;
+        distances_ = storage;
+        slots_ = storage + slotOffset;
+    }
+
+    /// Free storage allocated with AllocateStorage().
+    static void FreeStorage(unsigned char* distances, unsigned numBuckets)
+    {
+        if (numBuckets)
+            delete[] distances;
+    }
+
+    /// Reset to unallocated state.
+    void ResetStorage()
+    {
+        distances_ = EmptyDistances();
+        slots_ = nullptr;
+        numBuckets_ = 0;
+        numSlots_ = 0;
+        maxProbe_ = 0;
+        shift_ = 0;
+        size_ = 0;
+    }
+
+    /// Probe distance + 1 of each slot, or EMPTY_SLOT. Followed by END_SLOT.
+    unsigned char* distances_;
+    /// Element storage.
+    void* slots_;
+    /// Number of buckets.
+    unsigned numBuckets_;
+    /// Number of slots including the overflow slots.
+    unsigned numSlots_;
+    /// Longest allowed probe sequence.
+    unsigned maxProbe_;
+    /// Shift from a multiplied hash to a bucket index.
+    unsigned shift_;
+    /// Number of elements.
+    unsigned size_;
+};
+
+}
@@ -0,0 +1,590 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/FlatHashBase.h"
+#include "../Container/Pair.h"
+#include "../Container/Vector.h"
+
+#include <initializer_list>
+#include <new>
+#include <utility>
+
+namespace Urho3D
+{
+
+/// Open addressing hash map template class. Offers the interface of HashMap for lookup, insertion and forward
+/// iteration, but the iteration order is unspecified and insertion invalidates iterators and pointers to values.
+template <class T, class U> class FlatHashMap : public FlatHashBase
+{
+public:
+    using KeyType = T;
+    using ValueType = U;
+
+    /// Hash map key-value pair with const key.
+    class KeyValue
+    {
+    public:
+        /// Construct with key and value.
+        KeyValue(const T& first, const U& second) :
+            first_(first),
+            second_(second)
+        {
+        }
+
+        /// Construct with key and moved value.
+        KeyValue(const T& first, U&& second) :
+            first_(first),
+            second_(std::move(second))
+        {
+        }
+
+        /// Copy-construct.
+        KeyValue(const KeyValue& value) :
+            first_(value.first_),
+            second_(value.second_)
+        {
+        }
+
+        /// Move-construct. The key is copied.
+        KeyValue(KeyValue&& value) noexcept :
+            first_(value.first_),
+            second_(std::move(value.second_))
+        {
+        }
+
+        /// Prevent assignment.
+        KeyValue& operator =(const KeyValue& rhs) = delete;
+
+        /// Test for equality with another pair.
+        bool operator ==(const KeyValue& rhs) const { return first_ == rhs.first_ && second_ == rhs.second_; }
+        /// Test for inequality with another pair.
+        bool operator !=(const KeyValue& rhs) const { return first_ != rhs.first_ || second_ != rhs.second_; }
+
+        /// Key.
+        const T first_;
+        /// Value.
+        U second_;
+    };
+
+    /// Hash map iterator.
+    struct Iterator
+    {
+        /// Construct.
+        Iterator() = default;
+
+        /// Construct with a slot pointer and its probe distance pointer.
+        Iterator(KeyValue* ptr, const unsigned char* distance) :
+            ptr_(ptr),
+            distance_(distance)
+        {
+        }
+
+        /// Test for equality with another iterator.
+        bool operator ==(const Iterator& rhs) const { return ptr_ == rhs.ptr_; }
+
+        /// Test for inequality with another iterator.
+        bool operator !=(const Iterator& rhs) const { return ptr_ != rhs.ptr_; }
+
+        /// Preincrement the pointer.
+        Iterator& operator ++()
+        {
+            GotoNext();
+            return *this;
+        }
+
+        /// Postincrement the pointer.
+        Iterator operator ++(int)
+        {
+            Iterator it = *this;
+            GotoNext();
+            return it;
+        }
+
+        /// Point to the pair.
+        KeyValue* operator ->() const { return ptr_; }
+
+        /// Dereference the pair.
+        KeyValue& operator *() const { return *ptr_; }
+
+        /// Go to the next occupied slot. The end marker stops the scan.
+        void GotoNext()
+        {
+            do
+            {
+                ++ptr_;
+                ++distance_;
+            } while (*distance_ == EMPTY_SLOT);
+        }
+
+        /// Slot pointer.
+        KeyValue* ptr_{};
+        /// Probe distance pointer of the slot.
+        const unsigned char* distance_{};
+    };
+
+    /// Hash map const iterator.
+    struct ConstIterator
+    {
+        /// Construct.
+        ConstIterator() = default;
+
+        /// Construct with a slot pointer and its probe distance pointer.
+        ConstIterator(const KeyValue* ptr, const unsigned char* distance) :
+            ptr_(ptr),
+            distance_(distance)
+        {
+        }
+
+        /// Construct from a non-const iterator.
+        ConstIterator(const Iterator& rhs) :        // NOLINT(google-explicit-constructor)
+            ptr_(rhs.ptr_),
+            distance_(rhs.distance_)
+        {
+        }
+
+        /// Test for equality with another iterator.
+        bool operator ==(const ConstIterator& rhs) const { return ptr_ == rhs.ptr_; }
+
+        /// Test for inequality with another iterator.
+        bool operator !=(const ConstIterator& rhs) const { return ptr_ != rhs.ptr_; }
+
+        /// Preincrement the pointer.
+        ConstIterator& operator ++()
+        {
+            GotoNext();
+            return *this;
+        }
+
+        /// Postincrement the pointer.
+        ConstIterator operator ++(int)
+        {
+            ConstIterator it = *this;
+            GotoNext();
+            return it;
+        }
+
+        /// Point to the pair.
+        const KeyValue* operator ->() const { return ptr_; }
+
+        /// Dereference the pair.
+        const KeyValue& operator *() const { return *ptr_; }
+
+        /// Go to the next occupied slot. The end marker stops the scan.
+        void GotoNext()
+        {
+            do
+            {
+                ++ptr_;
+                ++distance_;
+            } while (*distance_ == EMPTY_SLOT);
+        }
+
+        /// Slot pointer.
+        const KeyValue* ptr_{};
+        /// Probe distance pointer of the slot.
+        const unsigned char* distance_{};
+    };
+
+    /// Construct empty.
+    FlatHashMap() = default;
+
+    /// Construct from another hash map.
+    FlatHashMap(const FlatHashMap<T, U>& map)
+    {
+        Reserve(map.Size());
+        Insert(map);
+    }
+
+    /// Move-construct from another hash map.
+    FlatHashMap(FlatHashMap<T, U> && map) noexcept
+    {
+        Swap(map);
+    }
+
+    /// Aggregate initialization constructor.
+    FlatHashMap(const std::initializer_list<Pair<T, U>>& list)
+    {
+        Reserve((unsigned)list.size());
+        for (auto it = list.begin(); it != list.end(); it++)
+            Insert(*it);
+    }
+
+    /// Destruct.
+    ~FlatHashMap()
+    {
+        DestroyElements();
+        FreeStorage(distances_, numBuckets_);
+    }
+
+    /// Assign a hash map.
+    FlatHashMap& operator =(const FlatHashMap<T, U>& rhs)
+    {
+        // In case of self-assignment do nothing
+        if (&rhs != this)
+        {
+            Clear();
+            Reserve(rhs.Size());
+            Insert(rhs);
+        }
+        return *this;
+    }
+
+    /// Move-assign a hash map.
+    FlatHashMap& operator =(FlatHashMap<T, U> && rhs) noexcept
+    {
+        Swap(rhs);
+        return *this;
+    }
+
+    /// Add-assign a pair.
+    FlatHashMap& operator +=(const Pair<T, U>& rhs)
+    {
+        Insert(rhs);
+        return *this;
+    }
+
+    /// Add-assign a hash map.
+    FlatHashMap& operator +=(const FlatHashMap<T, U>& rhs)
+    {
+        Insert(rhs);
+        return *this;
+    }
+
+    /// Test for equality with another hash map.
+    bool operator ==(const FlatHashMap<T, U>& rhs) const
+    {
+        if (rhs.Size() != Size())
+            return false;
+
+        for (ConstIterator i = Begin(); i != End(); ++i)
+        {
+            const KeyValue* pair = rhs.FindSlot(i->first_);
+            if (!pair || pair->second_ != i->second_)
+                return false;
+        }
+
+        return true;
+    }
+
+    /// Test for inequality with another hash map.
+    bool operator !=(const FlatHashMap<T, U>& rhs) const { return !(*this == rhs); }
+
+    /// Index the map. Create a new pair if key not found.
+    U& operator [](const T& key)
+    {
+        KeyValue* pair = FindSlot(key);
+        return pair ? pair->second_ : InsertSlot(key, U())->second_;
+    }
+
+    /// Index the map. Return null if key is not found, does not create a new pair.
+    U* operator [](const T& key) const
+    {
+        KeyValue* pair = FindSlot(key);
+        return pair ? &pair->second_ : nullptr;
+    }
+
+    /// Insert a pair. Return an iterator to it. If the key already exists, its value is replaced.
+    Iterator Insert(const Pair<T, U>& pair)
+    {
+        bool exists;
+        return Insert(pair, exists);
+    }
+
+    /// Insert a pair. Return iterator and set exists flag according to whether the key already existed.
+    Iterator Insert(const Pair<T, U>& pair, bool& exists)
+    {
+        KeyValue* existing = FindSlot(pair.first_);
+        exists = existing != nullptr;
+        if (existing)
+        {
+            existing->second_ = pair.second_;
+            return MakeIterator(existing);
+        }
+
+        return MakeIterator(InsertSlot(pair.first_, pair.second_));
+    }
+
+    /// Insert a map.
+    void Insert(const FlatHashMap<T, U>& map)
+    {
+        for (ConstIterator i = map.Begin(); i != map.End(); ++i)
+            Insert(MakePair(i->first_, i->second_));
+    }
+
+    /// Insert a pair only if a corresponding key does not already exist. Return iterator to the new or existing pair.
+    Iterator InsertNew(const T& key, const U& value)
+    {
+        KeyValue* existing = FindSlot(key);
+        return MakeIterator(existing ? existing : InsertSlot(key, value));
+    }
+
+    /// Erase a pair by key. Return true if was found.
+    bool Erase(const T& key)
+    {
+        KeyValue* pair = FindSlot(key);
+        if (!pair)
+            return false;
+
+        EraseSlot((unsigned)(pair - Slots()));
+        return true;
+    }
+
+    /// Erase a pair by iterator. Return iterator to the next pair.
+    Iterator Erase(const Iterator& it)
+    {
+        if (!it.ptr_ || it.ptr_ >= Slots() + numSlots_)
+            return End();
+
+        // Following elements only ever shift down into the erased slot, so the iteration continues from it
+        auto index = (unsigned)(it.ptr_ - Slots());
+        EraseSlot(index);
+        Iterator next(Slots() + index, distances_ + index);
+        if (*next.distance_ == EMPTY_SLOT)
+            next.GotoNext();
+        return next;
+    }
+
+    /// Clear the map. Keeps the allocated storage.
+    void Clear()
+    {
+        DestroyElements();
+        for (unsigned i = 0; i < numSlots_; ++i)
+            distances_[i] = EMPTY_SLOT;
+        size_ = 0;
+    }
+
+    /// Reserve buckets for the specified number of pairs.
+    void Reserve(unsigned size)
+    {
+        unsigned numBuckets = MIN_BUCKETS;
+        while (numBuckets * 7 < size * 8)
+            numBuckets <<= 1u;
+        if (numBuckets > numBuckets_)
+            Rehash(numBuckets);
+    }
+
+    /// Return iterator to the pair with key, or end iterator if not found.
+    Iterator Find(const T& key)
+    {
+        KeyValue* pair = FindSlot(key);
+        return pair ? MakeIterator(pair) : End();
+    }
+
+    /// Return const iterator to the pair with key, or end iterator if not found.
+    ConstIterator Find(const T& key) const
+    {
+        KeyValue* pair = FindSlot(key);
+        return pair ? ConstIterator(MakeIterator(pair)) : End();
+    }
+
+    /// Return whether contains a pair with key.
+    bool Contains(const T& key) const { return FindSlot(key) != nullptr; }
+
+    /// Try to copy value to output. Return true if was found.
+    bool TryGetValue(const T& key, U& out) const
+    {
+        KeyValue* pair = FindSlot(key);
+        if (pair)
+        {
+            out = pair->second_;
+            return true;
+        }
+        else
+            return false;
+    }
+
+    /// Return all the keys.
+    Vector<T> Keys() const
+    {
+        Vector<T> result;
+        result.Reserve(Size());
+        for (ConstIterator i = Begin(); i != End(); ++i)
+            result.Push(i->first_);
+        return result;
+    }
+
+    /// Return all the values.
+    Vector<U> Values() const
+    {
+        Vector<U> result;
+        result.Reserve(Size());
+        for (ConstIterator i = Begin(); i != End(); ++i)
+            result.Push(i->second_);
+        return result;
+    }
+
+    /// Return iterator to the beginning.
+    Iterator Begin()
+    {
+        Iterator it(Slots(), distances_);
+        if (*distances_ == EMPTY_SLOT)
+            it.GotoNext();
+        return it;
+    }
+
+    /// Return iterator to the beginning.
+    ConstIterator Begin() const { return const_cast<FlatHashMap<T, U>*>(this)->Begin(); }
+
+    /// Return iterator to the end.
+    Iterator End() { return Iterator(Slots() + numSlots_, distances_ + numSlots_); }
+
+    /// Return iterator to the end.
+    ConstIterator End() const { return ConstIterator(Slots() + numSlots_, distances_ + numSlots_); }
+
+private:
+    /// Return element storage.
+    KeyValue* Slots() const { return static_cast<KeyValue*>(slots_); }
+
+    /// Return iterator to a slot.
+    Iterator MakeIterator(KeyValue* pair) const { return Iterator(pair, distances_ + (pair - Slots())); }
+
+    /// Find the slot of a key. Return null if not found.
+    KeyValue* FindSlot(const T& key) const
+    {
+        if (!size_)
+            return nullptr;
+
+        // Probing stops at the first slot whose element is closer to its home bucket than the key would be
+        KeyValue* slots = Slots();
+        unsigned index = BucketIndex(MakeHash(key));
+        for (unsigned distance = 1; distances_[index] >= distance; ++index, ++distance)
+        {
+            if (slots[index].first_ == key)
+                return slots + index;
+        }
+
+        return nullptr;
+    }
+
+    /// Insert a key which does not exist yet. Return its slot.
+    template <class V> KeyValue* InsertSlot(const T& key, V&& value)
+    {
+        if (NeedsGrow())
+            Rehash(GrowBuckets());
+
+        ++size_;
+        KeyValue* pair = PlaceElement(KeyValue(key, std::forward<V>(value)));
+        // The table grew while placing displaced elements, look the key up again
+        return pair ? pair : FindSlot(key);
+    }
+
+    /// Place an element into the table, displacing elements that are closer to their home bucket. Return its slot, or
+    /// null if the table had to grow meanwhile.
+    KeyValue* PlaceElement(KeyValue&& element)
+    {
+        KeyValue* slots = Slots();
+        KeyValue* result = nullptr;
+        KeyValue carried(std::move(element));
+        unsigned index = BucketIndex(MakeHash(carried.first_));
+        for (unsigned distance = 1; ; ++index, ++distance)
+        {
+            if (distance > maxProbe_)
+            {
+                Rehash(GrowBuckets());
+                PlaceElement(std::move(carried));
+                return nullptr;
+            }
+
+            if (distances_[index] == EMPTY_SLOT)
+            {
+                new(slots + index) KeyValue(std::move(carried));
+                distances_[index] = (unsigned char)distance;
+                return result ? result : slots + index;
+            }
+
+            if (distances_[index] < distance)
+            {
+                KeyValue displaced(std::move(slots[index]));
+                slots[index].~KeyValue();
+                new(slots + index) KeyValue(std::move(carried));
+                carried.~KeyValue();
+                new(&carried) KeyValue(std::move(displaced));
+
+                unsigned displacedDistance = distances_[index];
+                distances_[index] = (unsigned char)distance;
+                distance = displacedDistance;
+                if (!result)
+                    result = slots + index;
+            }
+        }
+    }
+
+    /// Erase the element in a slot and shift the following elements of the probe sequence down.
+    void EraseSlot(unsigned index)
+    {
+        KeyValue* slots = Slots();
+        slots[index].~KeyValue();
+        for (unsigned next = index + 1; next < numSlots_ && distances_[next] > 1; index = next++)
+        {
+            new(slots + index) KeyValue(std::move(slots[next]));
+            slots[next].~KeyValue();
+            distances_[index] = (unsigned char)(distances_[next] - 1);
+        }
+        distances_[index] = EMPTY_SLOT;
+        --size_;
+    }
+
+    /// Move the elements to new storage with the specified bucket count.
+    void Rehash(unsigned numBuckets)
+    {
+        unsigned char* oldDistances = distances_;
+        KeyValue* oldSlots = Slots();
+        unsigned oldNumSlots = numSlots_;
+        unsigned oldNumBuckets = numBuckets_;
+
+        AllocateStorage(numBuckets, (unsigned)sizeof(KeyValue));
+        for (unsigned i = 0; i < oldNumSlots; ++i)
+        {
+            if (oldDistances[i] != EMPTY_SLOT)
+            {
+                PlaceElement(std::move(oldSlots[i]));
+                oldSlots[i].~KeyValue();
+            }
+        }
+
+        FreeStorage(oldDistances, oldNumBuckets);
+    }
+
+    /// Destruct all elements without touching the probe distances.
+    void DestroyElements()
+    {
+        KeyValue* slots = Slots();
+        for (unsigned i = 0; i < numSlots_; ++i)
+        {
+            if (distances_[i] != EMPTY_SLOT)
+                slots[i].~KeyValue();
+        }
+    }
+};
+
+template <class T, class U> typename Urho3D::FlatHashMap<T, U>::ConstIterator begin(const Urho3D::FlatHashMap<T, U>& v) { return v.Begin(); }
+
+template <class T, class U> typename Urho3D::FlatHashMap<T, U>::ConstIterator end(const Urho3D::FlatHashMap<T, U>& v) { return v.End(); }
+
+template <class T, class U> typename Urho3D::FlatHashMap<T, U>::Iterator begin(Urho3D::FlatHashMap<T, U>& v) { return v.Begin(); }
+
+template <class T, class U> typename Urho3D::FlatHashMap<T, U>::Iterator end(Urho3D::FlatHashMap<T, U>& v) { return v.End(); }
+
+}
@@ -0,0 +1,408 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/FlatHashBase.h"
+#include "../Container/Vector.h"
+
+#include <initializer_list>
+#include <new>
+#include <utility>
+
+namespace Urho3D
+{
+
+/// Open addressing hash set template class. Offers the interface of HashSet for lookup, insertion and forward
+/// iteration, but the iteration order is unspecified and insertion invalidates iterators.
+template <class T> class FlatHashSet : public FlatHashBase
+{
+public:
+    /// Hash set iterator. Keys can not be modified through it.
+    struct Iterator
+    {
+        /// Construct.
+        Iterator() = default;
+
+        /// Construct with a slot pointer and its probe distance pointer.
+        Iterator(const T* ptr, const unsigned char* distance) :
+            ptr_(ptr),
+            distance_(distance)
+        {
+        }
+
+        /// Test for equality with another iterator.
+        bool operator ==(const Iterator& rhs) const { return ptr_ == rhs.ptr_; }
+
+        /// Test for inequality with another iterator.
+        bool operator !=(const Iterator& rhs) const { return ptr_ != rhs.ptr_; }
+
+        /// Preincrement the pointer.
+        Iterator& operator ++()
+        {
+            GotoNext();
+            return *this;
+        }
+
+        /// Postincrement the pointer.
+        Iterator operator ++(int)
+        {
+            Iterator it = *this;
+            GotoNext();
+            return it;
+        }
+
+        /// Point to the key.
+        const T* operator ->() const { return ptr_; }
+
+        /// Dereference the key.
+        const T& operator *() const { return *ptr_; }
+
+        /// Go to the next occupied slot. The end marker stops the scan.
+        void GotoNext()
+        {
+            do
+            {
+                ++ptr_;
+                ++distance_;
+            } while (*distance_ == EMPTY_SLOT);
+        }
+
+        /// Slot pointer.
+        const T* ptr_{};
+        /// Probe distance pointer of the slot.
+        const unsigned char* distance_{};
+    };
+
+    /// Hash set const iterator. Same as the iterator, as keys are never modifiable.
+    using ConstIterator = Iterator;
+
+    /// Construct empty.
+    FlatHashSet() = default;
+
+    /// Construct from another hash set.
+    FlatHashSet(const FlatHashSet<T>& set)
+    {
+        Reserve(set.Size());
+        Insert(set);
+    }
+
+    /// Move-construct from another hash set.
+    FlatHashSet(FlatHashSet<T> && set) noexcept
+    {
+        Swap(set);
+    }
+
+    /// Aggregate initialization constructor.
+    FlatHashSet(const std::initializer_list<T>& list)
+    {
+        Reserve((unsigned)list.size());
+        for (auto it = list.begin(); it != list.end(); it++)
+            Insert(*it);
+    }
+
+    /// Destruct.
+    ~FlatHashSet()
+    {
+        DestroyElements();
+        FreeStorage(distances_, numBuckets_);
+    }
+
+    /// Assign a hash set.
+    FlatHashSet& operator =(const FlatHashSet<T>& rhs)
+    {
+        // In case of self-assignment do nothing
+        if (&rhs != this)
+        {
+            Clear();
+            Reserve(rhs.Size());
+            Insert(rhs);
+        }
+        return *this;
+    }
+
+    /// Move-assign a hash set.
+    FlatHashSet& operator =(FlatHashSet<T> && rhs) noexcept
+    {
+        Swap(rhs);
+        return *this;
+    }
+
+    /// Add-assign a value.
+    FlatHashSet& operator +=(const T& rhs)
+    {
+        Insert(rhs);
+        return *this;
+    }
+
+    /// Add-assign a hash set.
+    FlatHashSet& operator +=(const FlatHashSet<T>& rhs)
+    {
+        Insert(rhs);
+        return *this;
+    }
+
+    /// Test for equality with another hash set.
+    bool operator ==(const FlatHashSet<T>& rhs) const
+    {
+        if (rhs.Size() != Size())
+            return false;
+
+        for (Iterator i = Begin(); i != End(); ++i)
+        {
+            if (!rhs.Contains(*i))
+                return false;
+        }
+
+        return true;
+    }
+
+    /// Test for inequality with another hash set.
+    bool operator !=(const FlatHashSet<T>& rhs) const { return !(*this == rhs); }
+
+    /// Insert a key. Return an iterator to it.
+    Iterator Insert(const T& key)
+    {
+        bool exists;
+        return Insert(key, exists);
+    }
+
+    /// Insert a key. Return an iterator and set exists flag according to whether the key already existed.
+    Iterator Insert(const T& key, bool& exists)
+    {
+        T* existing = FindSlot(key);
+        exists = existing != nullptr;
+        return MakeIterator(existing ? existing : InsertSlot(key));
+    }
+
+    /// Insert a set.
+    void Insert(const FlatHashSet<T>& set)
+    {
+        for (Iterator i = set.Begin(); i != set.End(); ++i)
+            Insert(*i);
+    }
+
+    /// Erase a key. Return true if was found.
+    bool Erase(const T& key)
+    {
+        T* slot = FindSlot(key);
+        if (!slot)
+            return false;
+
+        EraseSlot((unsigned)(slot - Slots()));
+        return true;
+    }
+
+    /// Erase a key by iterator. Return iterator to the next key.
+    Iterator Erase(const Iterator& it)
+    {
+        if (!it.ptr_ || it.ptr_ >= Slots() + numSlots_)
+            return End();
+
+        // Following elements only ever shift down into the erased slot, so the iteration continues from it
+        auto index = (unsigned)(it.ptr_ - Slots());
+        EraseSlot(index);
+        Iterator next(Slots() + index, distances_ + index);
+        if (*next.distance_ == EMPTY_SLOT)
+            next.GotoNext();
+        return next;
+    }
+
+    /// Clear the set. Keeps the allocated storage.
+    void Clear()
+    {
+        DestroyElements();
+        for (unsigned i = 0; i < numSlots_; ++i)
+            distances_[i] = EMPTY_SLOT;
+        size_ = 0;
+    }
+
+    /// Reserve buckets for the specified number of keys.
+    void Reserve(unsigned size)
+    {
+        unsigned numBuckets = MIN_BUCKETS;
+        while (numBuckets * 7 < size * 8)
+            numBuckets <<= 1u;
+        if (numBuckets > numBuckets_)
+            Rehash(numBuckets);
+    }
+
+    /// Return iterator to the key, or end iterator if not found.
+    Iterator Find(const T& key) const
+    {
+        T* slot = FindSlot(key);
+        return slot ? MakeIterator(slot) : End();
+    }
+
+    /// Return whether contains a key.
+    bool Contains(const T& key) const { return FindSlot(key) != nullptr; }
+
+    /// Return all the keys.
+    Vector<T> Keys() const
+    {
+        Vector<T> result;
+        result.Reserve(Size());
+        for (Iterator i = Begin(); i != End(); ++i)
+            result.Push(*i);
+        return result;
+    }
+
+    /// Return iterator to the beginning.
+    Iterator Begin() const
+    {
+        Iterator it(Slots(), distances_);
+        if (*distances_ == EMPTY_SLOT)
+            it.GotoNext();
+        return it;
+    }
+
+    /// Return iterator to the end.
+    Iterator End() const { return Iterator(Slots() + numSlots_, distances_ + numSlots_); }
+
+private:
+    /// Return element storage.
+    T* Slots() const { return static_cast<T*>(slots_); }
+
+    /// Return iterator to a slot.
+    Iterator MakeIterator(const T* slot) const { return Iterator(slot, distances_ + (slot - Slots())); }
+
+    /// Find the slot of a key. Return null if not found.
+    T* FindSlot(const T& key) const
+    {
+        if (!size_)
+            return nullptr;
+
+        // Probing stops at the first slot whose element is closer to its home bucket than the key would be
+        T* slots = Slots();
+        unsigned index = BucketIndex(MakeHash(key));
+        for (unsigned distance = 1; distances_[index] >= distance; ++index, ++distance)
+        {
+            if (slots[index] == key)
+                return slots + index;
+        }
+
+        return nullptr;
+    }
+
+    /// Insert a key which does not exist yet. Return its slot.
+    T* InsertSlot(const T& key)
+    {
+        if (NeedsGrow())
+            Rehash(GrowBuckets());
+
+        ++size_;
+        T* slot = PlaceElement(T(key));
+        // The table grew while placing displaced elements, look the key up again
+        return slot ? slot : FindSlot(key);
+    }
+
+    /// Place an element into the table, displacing elements that are closer to their home bucket. Return its slot, or
+    /// null if the table had to grow meanwhile.
+    T* PlaceElement(T&& element)
+    {
+        T* slots = Slots();
+        T* result = nullptr;
+        T carried(std::move(element));
+        unsigned index = BucketIndex(MakeHash(carried));
+        for (unsigned distance = 1; ; ++index, ++distance)
+        {
+            if (distance > maxProbe_)
+            {
+                Rehash(GrowBuckets());
+                PlaceElement(std::move(carried));
+                return nullptr;
+            }
+
+            if (distances_[index] == EMPTY_SLOT)
+            {
+                new(slots + index) T(std::move(carried));
+                distances_[index] = (unsigned char)distance;
+                return result ? result : slots + index;
+            }
+
+            if (distances_[index] < distance)
+            {
+                Urho3D::Swap(slots[index], carried);
+
+                unsigned displacedDistance = distances_[index];
+                distances_[index] = (unsigned char)distance;
+                distance = displacedDistance;
+                if (!result)
+                    result = slots + index;
+            }
+        }
+    }
+
+    /// Erase the element in a slot and shift the following elements of the probe sequence down.
+    void EraseSlot(unsigned index)
+    {
+        T* slots = Slots();
+        slots[index].~T();
+        for (unsigned next = index + 1; next < numSlots_ && distances_[next] > 1; index = next++)
+        {
+            new(slots + index) T(std::move(slots[next]));
+            slots[next].~T();
+            distances_[index] = (unsigned char)(distances_[next] - 1);
+        }
+        distances_[index] = EMPTY_SLOT;
+        --size_;
+    }
+
+    /// Move the elements to new storage with the specified bucket count.
+    void Rehash(unsigned numBuckets)
+    {
+        unsigned char* oldDistances = distances_;
+        T* oldSlots = Slots();
+        unsigned oldNumSlots = numSlots_;
+        unsigned oldNumBuckets = numBuckets_;
+
+        AllocateStorage(numBuckets, (unsigned)sizeof(T));
+        for (unsigned i = 0; i < oldNumSlots; ++i)
+        {
+            if (oldDistances[i] != EMPTY_SLOT)
+            {
+                PlaceElement(std::move(oldSlots[i]));
+                oldSlots[i].~T();
+            }
+        }
+
+        FreeStorage(oldDistances, oldNumBuckets);
+    }
+
+    /// Destruct all elements without touching the probe distances.
+    void DestroyElements()
+    {
+        T* slots = Slots();
+        for (unsigned i = 0; i < numSlots_; ++i)
+        {
+            if (distances_[i] != EMPTY_SLOT)
+                slots[i].~T();
+        }
+    }
+};
+
+template <class T> typename Urho3D::FlatHashSet<T>::ConstIterator begin(const Urho3D::FlatHashSet<T>& v) { return v.Begin(); }
+
+template <class T> typename Urho3D::FlatHashSet<T>::ConstIterator end(const Urho3D::FlatHashSet<T>& v) { return v.End(); }
+
+}
@@ -0,0 +1,167 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Container/FrameAllocator.h"
+#include "../Container/Vector.h"
+
+#include <mutex>
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+std::atomic<unsigned> FrameAllocator::frameNumber_{1};
+FrameAllocatorStats FrameAllocator::lastFrameStats_{};
+
+/// Return mutex protecting the list of thread allocators.
+static std::mutex& GetThreadAllocatorsMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+/// Return list of thread allocators.
+static PODVector<LinearAllocator*>& GetThreadAllocators()
+{
+    static PODVector<LinearAllocator*> allocators;
+    return allocators;
+}
+
+/// Frame allocator of a thread. Registered to the list of thread allocators for the lifetime of the thread.
+struct ThreadFrameAllocator
+{
+    /// Construct and register.
+    ThreadFrameAllocator()
+    {
+        std::lock_guard<std::mutex> lock(GetThreadAllocatorsMutex());
+        GetThreadAllocators().Push(&allocator_);
+    }
+
+    /// Unregister and destruct.
+    ~ThreadFrameAllocator()
+    {
+        std::lock_guard<std::mutex> lock(GetThreadAllocatorsMutex());
+        GetThreadAllocators().Remove(&allocator_);
+    }
+
+    /// Allocator.
+    LinearAllocator allocator_;
+};
+
+static thread_local ThreadFrameAllocator threadFrameAllocator;
+
+LinearAllocator::LinearAllocator(unsigned blockSize) :
+    blockSize_(blockSize)
+{
+}
+
+LinearAllocator::~LinearAllocator()
+{
+    FreeBlocks();
+}
+
+void* LinearAllocator::Allocate(unsigned size, unsigned alignment)
+{
+    const auto mask = (uintptr_t)(alignment - 1);
+    auto* ptr = reinterpret_cast<unsigned char*>(((uintptr_t)current_ + mask) & ~mask);
+    if (!block_ || ptr + size > end_)
+    {
+        AllocateBlock(size + alignment > blockSize_ ? size + alignment : blockSize_);
+        ptr = reinterpret_cast<unsigned char*>(((uintptr_t)current_ + mask) & ~mask);
+    }
+
+    current_ = ptr + size;
+    allocatedBytes_ += size;
+    ++numAllocations_;
+    return ptr;
+}
+
+void LinearAllocator::Reset()
+{
+    if (block_ && block_->prev_)
+    {
+        // Merge blocks so that the same amount of memory can be allocated without growing next time
+        unsigned capacity = capacity_;
+        FreeBlocks();
+        AllocateBlock(capacity);
+    }
+    else if (block_)
+        current_ = reinterpret_cast<unsigned char*>(block_ + 1);
+
+    allocatedBytes_ = 0;
+    numAllocations_ = 0;
+}
+
+void LinearAllocator::AllocateBlock(unsigned size)
+{
+    auto* block = reinterpret_cast<Block*>(new unsigned char[sizeof(Block) + size]);
+    block->prev_ = block_;
+    block->size_ = size;
+    block_ = block;
+    current_ = reinterpret_cast<unsigned char*>(block + 1);
+    end_ = current_ + size;
+    capacity_ += size;
+}
+
+void LinearAllocator::FreeBlocks()
+{
+    while (block_)
+    {
+        Block* prev = block_->prev_;
+        delete[] reinterpret_cast<unsigned char*>(block_);
+        block_ = prev;
+    }
+
+    current_ = nullptr;
+    end_ = nullptr;
+    capacity_ = 0;
+}
+
+void* FrameAllocator::Allocate(unsigned size, unsigned alignment)
+{
+    return threadFrameAllocator.allocator_.Allocate(size, alignment);
+}
+
+void FrameAllocator::Reset()
+{
+    std::lock_guard<std::mutex> lock(GetThreadAllocatorsMutex());
+
+    FrameAllocatorStats stats{};
+    for (LinearAllocator* allocator : GetThreadAllocators())
+    {
+        stats.allocatedBytes_ += allocator->GetAllocatedBytes();
+        stats.numAllocations_ += allocator->GetNumAllocations();
+        if (allocator->GetNumAllocations())
+            ++stats.numThreads_;
+
+        allocator->Reset();
+        stats.capacity_ += allocator->GetCapacity();
+    }
+
+    lastFrameStats_ = stats;
+    frameNumber_.fetch_add(1, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,134 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#ifdef URHO3D_IS_BUILDING
+#include "Urho3D.h"
+#else
+#include <Urho3D/Urho3D.h>
+#endif
+
+#include <atomic>
+
+namespace Urho3D
+{
+
+/// Default size of a linear allocator memory block.
+static const unsigned LINEAR_ALLOCATOR_BLOCK_SIZE = 64 * 1024;
+
+/// %Linear (bump pointer) allocator. Memory is released all at once by Reset(), individual allocations can not be freed.
+class URHO3D_API LinearAllocator
+{
+public:
+    /// Construct with initial block size. No memory is allocated until the first allocation.
+    explicit LinearAllocator(unsigned blockSize = LINEAR_ALLOCATOR_BLOCK_SIZE);
+    /// Destruct. Free all memory blocks.
+    ~LinearAllocator();
+    /// Prevent copy construction.
+    LinearAllocator(const LinearAllocator& rhs) = delete;
+    /// Prevent assignment.
+    LinearAllocator& operator =(const LinearAllocator& rhs) = delete;
+
+    /// Allocate memory with specified alignment, which must be a power of two.
+    void* Allocate(unsigned size, unsigned alignment = 16);
+    /// Release all allocations. If more than one memory block was used, they are merged to a single block large enough to hold all of them.
+    void Reset();
+
+    /// Return number of bytes allocated since last reset.
+    unsigned GetAllocatedBytes() const { return allocatedBytes_; }
+    /// Return number of allocations since last reset.
+    unsigned GetNumAllocations() const { return numAllocations_; }
+    /// Return total size of memory blocks.
+    unsigned GetCapacity() const { return capacity_; }
+
+private:
+    /// Memory block header. Data follows.
+    struct Block
+    {
+        /// Previous block.
+        Block* prev_;
+        /// Size of data.
+        unsigned size_;
+    };
+
+    /// Allocate a new block with at least specified size of data.
+    void AllocateBlock(unsigned size);
+    /// Free all blocks.
+    void FreeBlocks();
+
+    /// Current block.
+    Block* block_{};
+    /// Next free byte of the current block.
+    unsigned char* current_{};
+    /// End of the current block.
+    unsigned char* end_{};
+    /// Size of the next block.
+    unsigned blockSize_;
+    /// Total size of memory blocks.
+    unsigned capacity_{};
+    /// Number of bytes allocated since last reset.
+    unsigned allocatedBytes_{};
+    /// Number of allocations since last reset.
+    unsigned numAllocations_{};
+};
+
+/// Frame allocator statistics.
+struct FrameAllocatorStats
+{
+    /// Number of bytes allocated.
+    unsigned allocatedBytes_;
+    /// Number of allocations.
+    unsigned numAllocations_;
+    /// Total size of memory blocks of all threads.
+    unsigned capacity_;
+    /// Number of threads which used the allocator.
+    unsigned numThreads_;
+};
+
+/// Per-frame scratch memory allocator. Each thread allocates from its own linear allocator, so no locking is needed.
+/// All memory is released at the end of frame, after which memory allocated during the previous frame must not be
+/// accessed. Must only be used for data produced and consumed within one frame by the main thread and frame-synchronous
+/// WorkQueue jobs.
+class URHO3D_API FrameAllocator
+{
+public:
+    /// Allocate memory for the current frame from the allocator of the calling thread.
+    static void* Allocate(unsigned size, unsigned alignment = 16);
+    /// Allocate an uninitialized array for the current frame.
+    template <class T> static T* AllocateArray(unsigned count) { return static_cast<T*>(Allocate(count * sizeof(T), alignof(T))); }
+    /// Release memory of all threads and advance the frame number. Called by Time at the end of frame, when no other thread is allocating.
+    static void Reset();
+
+    /// Return frame number. Memory allocated with a different frame number is no longer valid.
+    static unsigned GetFrameNumber() { return frameNumber_.load(std::memory_order_relaxed); }
+    /// Return statistics of the last finished frame.
+    static const FrameAllocatorStats& GetLastFrameStats() { return lastFrameStats_; }
+
+private:
+    /// Current frame number.
+    static std::atomic<unsigned> frameNumber_;
+    /// Statistics of the last finished frame.
+    static FrameAllocatorStats lastFrameStats_;
+};
+
+}
@@ -0,0 +1,361 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/FrameAllocator.h"
+#include "../Container/HashBase.h"
+#include "../Container/Pair.h"
+
+#include <new>
+
+namespace Urho3D
+{
+
+/// Hash map template class which allocates its index and nodes from the frame allocator. Contents are valid until
+/// the end of the frame in which they were written; a map kept over several frames discards its stale contents the next
+/// time it is modified. Values must not own memory other than frame memory, as destructors of stale values are not run.
+/// Nodes never move, while the index is an open addressing table of hashes and node pointers, so that a lookup reads
+/// consecutive memory and only dereferences nodes whose full hash matches.
+template <class T, class U> class FrameHashMap
+{
+public:
+    using KeyType = T;
+    using ValueType = U;
+
+    /// Hash map key-value pair with const key.
+    class KeyValue
+    {
+    public:
+        /// Construct with key and value.
+        KeyValue(const T& first, const U& second) :
+            first_(first),
+            second_(second)
+        {
+        }
+
+        /// Prevent assignment.
+        KeyValue& operator =(const KeyValue& rhs) = delete;
+
+        /// Key.
+        const T first_;
+        /// Value.
+        U second_;
+    };
+
+    /// Hash map node.
+    struct Node : public HashNodeBase
+    {
+        /// Construct with key and value.
+        Node(const T& key, const U& value) :
+            pair_(key, value)
+        {
+        }
+
+        /// Key-value pair.
+        KeyValue pair_;
+
+        /// Return next node.
+        Node* Next() const { return static_cast<Node*>(next_); }
+    };
+
+    /// Hash map node iterator.
+    struct Iterator : public HashIteratorBase
+    {
+        /// Construct.
+        Iterator() = default;
+
+        /// Construct with a node pointer.
+        explicit Iterator(Node* ptr) :
+            HashIteratorBase(ptr)
+        {
+        }
+
+        /// Preincrement the pointer.
+        Iterator& operator ++()
+        {
+            GotoNext();
+            return *this;
+        }
+
+        /// Postincrement the pointer.
+        Iterator operator ++(int)
+        {
+            Iterator it = *this;
+            GotoNext();
+            return it;
+        }
+
+        /// Point to the pair.
+        KeyValue* operator ->() const { return &(static_cast<Node*>(ptr_))->pair_; }
+
+        /// Dereference the pair.
+        KeyValue& operator *() const { return (static_cast<Node*>(ptr_))->pair_; }
+    };
+
+    /// Hash map node const iterator.
+    struct ConstIterator : public HashIteratorBase
+    {
+        /// Construct.
+        ConstIterator() = default;
+
+        /// Construct with a node pointer.
+        explicit ConstIterator(Node* ptr) :
+            HashIteratorBase(ptr)
+        {
+        }
+
+        /// Construct from a non-const iterator.
+        ConstIterator(const Iterator& rhs) :        // NOLINT(google-explicit-constructor)
+            HashIteratorBase(rhs.ptr_)
+        {
+        }
+
+        /// Preincrement the pointer.
+        ConstIterator& operator ++()
+        {
+            GotoNext();
+            return *this;
+        }
+
+        /// Postincrement the pointer.
+        ConstIterator operator ++(int)
+        {
+            ConstIterator it = *this;
+            GotoNext();
+            return it;
+        }
+
+        /// Point to the pair.
+        const KeyValue* operator ->() const { return &(static_cast<Node*>(ptr_))->pair_; }
+
+        /// Dereference the pair.
+        const KeyValue& operator *() const { return (static_cast<Node*>(ptr_))->pair_; }
+    };
+
+    /// Construct empty.
+    FrameHashMap() = default;
+
+    /// Construct from another hash map.
+    FrameHashMap(const FrameHashMap<T, U>& map)
+    {
+        *this = map;
+    }
+
+    /// Destruct.
+    ~FrameHashMap()
+    {
+        Clear();
+    }
+
+    /// Assign from another hash map.
+    FrameHashMap& operator =(const FrameHashMap<T, U>& rhs)
+    {
+        // In case of self-assignment do nothing
+        if (&rhs != this)
+        {
+            Clear();
+            if (rhs.IsCurrent())
+            {
+                for (ConstIterator i = rhs.Begin(); i != rhs.End(); ++i)
+                    Insert(i->first_, i->second_);
+            }
+        }
+        return *this;
+    }
+
+    /// Index the map. Create a new pair if key not found.
+    U& operator [](const T& key)
+    {
+        Node* node = FindNode(key);
+        return node ? node->pair_.second_ : Insert(key, U())->second_;
+    }
+
+    /// Insert a pair. Return an iterator to it. If the key already exists, its value is replaced.
+    Iterator Insert(const Pair<T, U>& pair) { return Insert(pair.first_, pair.second_); }
+
+    /// Insert a pair. Return an iterator to it. If the key already exists, its value is replaced.
+    Iterator Insert(const T& key, const U& value)
+    {
+        DiscardStale();
+
+        if (Node* existing = FindNode(key))
+        {
+            existing->pair_.second_ = value;
+            return Iterator(existing);
+        }
+
+        // Keep the index at most half full
+        if ((size_ + 1) * 2 > numSlots_)
+            Rehash(numSlots_ ? numSlots_ << 1u : HashBase::MIN_BUCKETS);
+
+        auto* node = new(FrameAllocator::Allocate(sizeof(Node), alignof(Node))) Node(key, value);
+        PlaceNode(node, MakeHash(key));
+
+        // Link to the end of the iteration list
+        node->prev_ = tail_;
+        if (tail_)
+            tail_->next_ = node;
+        else
+            head_ = node;
+        tail_ = node;
+
+        ++size_;
+        return Iterator(node);
+    }
+
+    /// Clear the map. Destructors of values written during a previous frame are not run.
+    void Clear()
+    {
+        if (IsCurrent())
+        {
+            for (Node* node = head_; node; node = node->Next())
+                node->~Node();
+        }
+
+        head_ = nullptr;
+        tail_ = nullptr;
+        slots_ = nullptr;
+        numSlots_ = 0;
+        size_ = 0;
+        frame_ = FrameAllocator::GetFrameNumber();
+    }
+
+    /// Return iterator to the pair with key, or end iterator if not found.
+    Iterator Find(const T& key) { return Iterator(FindNode(key)); }
+
+    /// Return const iterator to the pair with key, or end iterator if not found.
+    ConstIterator Find(const T& key) const { return ConstIterator(FindNode(key)); }
+
+    /// Return whether contains a pair with key.
+    bool Contains(const T& key) const { return FindNode(key) != nullptr; }
+
+    /// Return iterator to the beginning.
+    Iterator Begin() { return Iterator(IsCurrent() ? head_ : nullptr); }
+
+    /// Return iterator to the beginning.
+    ConstIterator Begin() const { return ConstIterator(IsCurrent() ? head_ : nullptr); }
+
+    /// Return iterator to the end.
+    Iterator End() { return Iterator(nullptr); }
+
+    /// Return iterator to the end.
+    ConstIterator End() const { return ConstIterator(nullptr); }
+
+    /// Return number of key-value pairs.
+    unsigned Size() const { return IsCurrent() ? size_ : 0; }
+
+    /// Return whether map is empty.
+    bool Empty() const { return Size() == 0; }
+
+    /// Return whether the contents were written during the current frame.
+    bool IsCurrent() const { return !head_ || frame_ == FrameAllocator::GetFrameNumber(); }
+
+private:
+    /// Forget contents written during a previous frame. The memory they occupied has already been released.
+    void DiscardStale()
+    {
+        if (frame_ != FrameAllocator::GetFrameNumber())
+        {
+            head_ = nullptr;
+            Clear();
+        }
+    }
+
+    /// Index slot.
+    struct Slot
+    {
+        /// Full hash of the key.
+        unsigned hash_;
+        /// Node, or null if the slot is free.
+        Node* node_;
+    };
+
+    /// Find a node by key. Return null if not found.
+    Node* FindNode(const T& key) const
+    {
+        if (!numSlots_ || frame_ != FrameAllocator::GetFrameNumber())
+            return nullptr;
+
+        unsigned hash = MakeHash(key);
+        for (unsigned index = SlotIndex(hash); slots_[index].node_; index = (index + 1) & (numSlots_ - 1))
+        {
+            if (slots_[index].hash_ == hash && slots_[index].node_->pair_.first_ == key)
+                return slots_[index].node_;
+        }
+
+        return nullptr;
+    }
+
+    /// Put a node to the first free slot of its probe sequence.
+    void PlaceNode(Node* node, unsigned hash)
+    {
+        unsigned index = SlotIndex(hash);
+        while (slots_[index].node_)
+            index = (index + 1) & (numSlots_ - 1);
+        slots_[index].hash_ = hash;
+        slots_[index].node_ = node;
+    }
+
+    /// Allocate a new index and reinsert the nodes. The old index stays in frame memory until the frame ends.
+    void Rehash(unsigned numSlots)
+    {
+        slots_ = FrameAllocator::AllocateArray<Slot>(numSlots);
+        numSlots_ = numSlots;
+        shift_ = 32;
+        for (unsigned i = numSlots; i > 1; i >>= 1u)
+            --shift_;
+        for (unsigned i = 0; i < numSlots; ++i)
+            slots_[i].node_ = nullptr;
+
+        for (Node* node = head_; node; node = node->Next())
+            PlaceNode(node, MakeHash(node->pair_.first_));
+    }
+
+    /// Return the home slot of a hash. Multiplicative hashing spreads keys that differ only in their high bits.
+    unsigned SlotIndex(unsigned hash) const { return (hash * 2654435769u) >> shift_; }
+
+    /// Open addressing index of the nodes.
+    Slot* slots_{};
+    /// First node in iteration order.
+    Node* head_{};
+    /// Last node in iteration order.
+    Node* tail_{};
+    /// Number of index slots.
+    unsigned numSlots_{};
+    /// Shift from a multiplied hash to a slot index.
+    unsigned shift_{};
+    /// Number of key-value pairs.
+    unsigned size_{};
+    /// Frame number when the contents were written.
+    unsigned frame_{};
+};
+
+template <class T, class U> typename Urho3D::FrameHashMap<T, U>::ConstIterator begin(const Urho3D::FrameHashMap<T, U>& v) { return v.Begin(); }
+
+template <class T, class U> typename Urho3D::FrameHashMap<T, U>::ConstIterator end(const Urho3D::FrameHashMap<T, U>& v) { return v.End(); }
+
+template <class T, class U> typename Urho3D::FrameHashMap<T, U>::Iterator begin(Urho3D::FrameHashMap<T, U>& v) { return v.Begin(); }
+
+template <class T, class U> typename Urho3D::FrameHashMap<T, U>::Iterator end(Urho3D::FrameHashMap<T, U>& v) { return v.End(); }
+
+}
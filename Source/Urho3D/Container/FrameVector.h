@@ -0,0 +1,290 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/FrameAllocator.h"
+#include "../Container/VectorBase.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace Urho3D
+{
+
+/// %Vector template class for POD types which allocates from the frame allocator. Memory is never freed individually.
+/// Contents are valid until the end of the frame in which they were written; a vector kept over several frames
+/// discards its stale contents the next time it is modified.
+template <class T> class FramePODVector : public VectorBase
+{
+public:
+    using ValueType = T;
+    using Iterator = RandomAccessIterator<T>;
+    using ConstIterator = RandomAccessConstIterator<T>;
+
+    /// Construct empty.
+    FramePODVector() noexcept = default;
+
+    /// Construct with initial size.
+    explicit FramePODVector(unsigned size)
+    {
+        Resize(size);
+    }
+
+    /// Construct from another vector.
+    FramePODVector(const FramePODVector<T>& vector)
+    {
+        *this = vector;
+    }
+
+    /// Assign from another vector.
+    FramePODVector<T>& operator =(const FramePODVector<T>& rhs)
+    {
+        // In case of self-assignment do nothing
+        if (&rhs != this)
+        {
+            unsigned size = rhs.IsCurrent() ? rhs.size_ : 0;
+            Resize(size);
+            CopyElements(Buffer(), rhs.Buffer(), size);
+        }
+        return *this;
+    }
+
+    /// Return element at index.
+    T& operator [](unsigned index)
+    {
+        assert(index < size_);
+        return Buffer()[index];
+    }
+
+    /// Return const element at index.
+    const T& operator [](unsigned index) const
+    {
+        assert(index < size_);
+        return Buffer()[index];
+    }
+
+    /// Return element at index.
+    T& At(unsigned index)
+    {
+        assert(index < size_);
+        return Buffer()[index];
+    }
+
+    /// Return const element at index.
+    const T& At(unsigned index) const
+    {
+        assert(index < size_);
+        return Buffer()[index];
+    }
+
+    /// Add an element at the end.
+    void Push(const T& value)
+    {
+        DiscardStale();
+        if (size_ < capacity_)
+            ++size_;
+        else
+            Resize(size_ + 1);
+        Back() = value;
+    }
+
+    /// Add elements at the end.
+    void Push(const T* values, unsigned count)
+    {
+        DiscardStale();
+        unsigned oldSize = size_;
+        Resize(size_ + count);
+        CopyElements(Buffer() + oldSize, values, count);
+    }
+
+    /// Remove the last element.
+    void Pop()
+    {
+        DiscardStale();
+        if (size_)
+            --size_;
+    }
+
+    /// Erase a range of elements.
+    void Erase(unsigned pos, unsigned length = 1)
+    {
+        DiscardStale();
+
+        // Return if the range is illegal
+        if (!length || pos + length > size_)
+            return;
+
+        if (size_ - pos - length)
+            memmove(Buffer() + pos, Buffer() + pos + length, (size_ - pos - length) * sizeof(T));
+        size_ -= length;
+    }
+
+    /// Clear the vector.
+    void Clear() { Resize(0); }
+
+    /// Resize the vector.
+    void Resize(unsigned newSize)
+    {
+        DiscardStale();
+        if (newSize > capacity_)
+        {
+            unsigned newCapacity = capacity_;
+            if (!newCapacity)
+                newCapacity = newSize;
+            else
+            {
+                while (newCapacity < newSize)
+                    newCapacity += (newCapacity + 1) >> 1;
+            }
+            Reallocate(newCapacity);
+        }
+
+        size_ = newSize;
+    }
+
+    /// Set new capacity. Capacity is never reduced, as frame memory can not be freed.
+    void Reserve(unsigned newCapacity)
+    {
+        DiscardStale();
+        if (newCapacity > capacity_)
+            Reallocate(newCapacity);
+    }
+
+    /// Swap with another vector.
+    void Swap(FramePODVector<T>& rhs)
+    {
+        VectorBase::Swap(rhs);
+        Urho3D::Swap(frame_, rhs.frame_);
+    }
+
+    /// Return iterator to value, or to the end if not found.
+    Iterator Find(const T& value)
+    {
+        Iterator it = Begin();
+        while (it != End() && *it != value)
+            ++it;
+        return it;
+    }
+
+    /// Return const iterator to value, or to the end if not found.
+    ConstIterator Find(const T& value) const
+    {
+        ConstIterator it = Begin();
+        while (it != End() && *it != value)
+            ++it;
+        return it;
+    }
+
+    /// Return whether contains a specific value.
+    bool Contains(const T& value) const { return Find(value) != End(); }
+
+    /// Return iterator to the beginning.
+    Iterator Begin() { return Iterator(Buffer()); }
+
+    /// Return const iterator to the beginning.
+    ConstIterator Begin() const { return ConstIterator(Buffer()); }
+
+    /// Return iterator to the end.
+    Iterator End() { return Iterator(Buffer() + size_); }
+
+    /// Return const iterator to the end.
+    ConstIterator End() const { return ConstIterator(Buffer() + size_); }
+
+    /// Return first element.
+    T& Front() { return Buffer()[0]; }
+
+    /// Return const first element.
+    const T& Front() const { return Buffer()[0]; }
+
+    /// Return last element.
+    T& Back()
+    {
+        assert(size_);
+        return Buffer()[size_ - 1];
+    }
+
+    /// Return const last element.
+    const T& Back() const
+    {
+        assert(size_);
+        return Buffer()[size_ - 1];
+    }
+
+    /// Return number of elements.
+    unsigned Size() const { return size_; }
+
+    /// Return capacity of vector.
+    unsigned Capacity() const { return capacity_; }
+
+    /// Return whether vector is empty.
+    bool Empty() const { return size_ == 0; }
+
+    /// Return whether the contents were written during the current frame.
+    bool IsCurrent() const { return !buffer_ || frame_ == FrameAllocator::GetFrameNumber(); }
+
+    /// Return the buffer with right type.
+    T* Buffer() const { return reinterpret_cast<T*>(buffer_); }
+
+private:
+    /// Forget contents written during a previous frame. The memory they occupied has already been released.
+    void DiscardStale()
+    {
+        unsigned frame = FrameAllocator::GetFrameNumber();
+        if (frame_ != frame)
+        {
+            buffer_ = nullptr;
+            size_ = 0;
+            capacity_ = 0;
+            frame_ = frame;
+        }
+    }
+
+    /// Move the elements to a new buffer.
+    void Reallocate(unsigned newCapacity)
+    {
+        T* newBuffer = FrameAllocator::AllocateArray<T>(newCapacity);
+        CopyElements(newBuffer, Buffer(), size_);
+        buffer_ = reinterpret_cast<unsigned char*>(newBuffer);
+        capacity_ = newCapacity;
+    }
+
+    /// Copy elements from one buffer to another.
+    static void CopyElements(T* dest, const T* src, unsigned count)
+    {
+        if (count)
+            memcpy(dest, src, count * sizeof(T));
+    }
+
+    /// Frame number when the buffer was allocated.
+    unsigned frame_{};
+};
+
+template <class T> typename Urho3D::FramePODVector<T>::ConstIterator begin(const Urho3D::FramePODVector<T>& v) { return v.Begin(); }
+
+template <class T> typename Urho3D::FramePODVector<T>::ConstIterator end(const Urho3D::FramePODVector<T>& v) { return v.End(); }
+
+template <class T> typename Urho3D::FramePODVector<T>::Iterator begin(Urho3D::FramePODVector<T>& v) { return v.Begin(); }
+
+template <class T> typename Urho3D::FramePODVector<T>::Iterator end(Urho3D::FramePODVector<T>& v) { return v.End(); }
+
+}
@@ -152,7 +152,7 @@ protected:
     /// Bucket head pointers.
     HashNodeBase** ptrs_;
     /// Node allocator.
-    AllocatorBlock* allocator_;
+    PoolAllocator* allocator_;
 };
 
 }
@@ -218,15 +218,15 @@ public:
     HashMap()
     {
         // Reserve the tail node
-        allocator_ = AllocatorInitialize((unsigned)sizeof(Node));
+        allocator_ = GetPoolAllocator<Node>();
         head_ = tail_ = ReserveNode();
     }
 
     /// Construct from another hash map.
     HashMap(const HashMap<T, U>& map)
     {
-        // Reserve the tail node + initial capacity according to the map's size
-        allocator_ = AllocatorInitialize((unsigned)sizeof(Node), map.Size() + 1);
+        // Reserve the tail node
+        allocator_ = GetPoolAllocator<Node>();
         head_ = tail_ = ReserveNode();
         *this = map;
     }
@@ -253,7 +253,6 @@ public:
         {
             Clear();
             FreeNode(Tail());
-            AllocatorUninitialize(allocator_);
             delete[] ptrs_;
         }
     }
@@ -754,7 +753,7 @@ private:
     /// Reserve a node.
     Node* ReserveNode()
     {
-        auto* newNode = static_cast<Node*>(AllocatorReserve(allocator_));
+        auto* newNode = static_cast<Node*>(allocator_->Reserve());
         new(newNode) Node();
         return newNode;
     }
@@ -762,7 +761,7 @@ private:
     /// Reserve a node with specified key and value.
     Node* ReserveNode(const T& key, const U& value)
     {
-        auto* newNode = static_cast<Node*>(AllocatorReserve(allocator_));
+        auto* newNode = static_cast<Node*>(allocator_->Reserve());
         new(newNode) Node(key, value);
         return newNode;
     }
@@ -771,7 +770,7 @@ private:
     void FreeNode(Node* node)
     {
         (node)->~Node();
-        AllocatorFree(allocator_, node);
+        allocator_->Free(node);
     }
 
     /// Rehash the buckets.
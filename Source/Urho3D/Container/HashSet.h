@@ -175,15 +175,15 @@ public:
     HashSet()
     {
         // Reserve the tail node
-        allocator_ = AllocatorInitialize((unsigned)sizeof(Node));
+        allocator_ = GetPoolAllocator<Node>();
         head_ = tail_ = ReserveNode();
     }
 
     /// Construct from another hash set.
     HashSet(const HashSet<T>& set)
     {
-        // Reserve the tail node + initial capacity according to the set's size
-        allocator_ = AllocatorInitialize((unsigned)sizeof(Node), set.Size() + 1);
+        // Reserve the tail node
+        allocator_ = GetPoolAllocator<Node>();
         head_ = tail_ = ReserveNode();
         *this = set;
     }
@@ -210,7 +210,6 @@ public:
         {
             Clear();
             FreeNode(Tail());
-            AllocatorUninitialize(allocator_);
             delete[] ptrs_;
         }
     }
@@ -602,7 +601,7 @@ private:
     /// Reserve a node.
     Node* ReserveNode()
     {
-        auto* newNode = static_cast<Node*>(AllocatorReserve(allocator_));
+        auto* newNode = static_cast<Node*>(allocator_->Reserve());
         new(newNode) Node();
         return newNode;
     }
@@ -610,7 +609,7 @@ private:
     /// Reserve a node with specified key.
     Node* ReserveNode(const T& key)
     {
-        auto* newNode = static_cast<Node*>(AllocatorReserve(allocator_));
+        auto* newNode = static_cast<Node*>(allocator_->Reserve());
         new(newNode) Node(key);
         return newNode;
     }
@@ -619,7 +618,7 @@ private:
     void FreeNode(Node* node)
     {
         (node)->~Node();
-        AllocatorFree(allocator_, node);
+        allocator_->Free(node);
     }
 
     /// Rehash the buckets.
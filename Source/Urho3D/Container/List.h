@@ -168,15 +168,15 @@ public:
     /// Construct empty.
     List()
     {
-        allocator_ = AllocatorInitialize((unsigned)sizeof(Node));
+        allocator_ = GetPoolAllocator<Node>();
         head_ = tail_ = ReserveNode();
     }
 
     /// Construct from another list.
     List(const List<T>& list)
     {
-        // Reserve the tail node + initial capacity according to the list's size
-        allocator_ = AllocatorInitialize((unsigned)sizeof(Node), list.Size() + 1);
+        // Reserve the tail node
+        allocator_ = GetPoolAllocator<Node>();
         head_ = tail_ = ReserveNode();
         *this = list;
     }
@@ -201,7 +201,6 @@ public:
     {
         Clear();
         FreeNode(Tail());
-        AllocatorUninitialize(allocator_);
     }
 
     /// Assign from another list.
@@ -474,7 +473,7 @@ private:
     /// Reserve a node.
     Node* ReserveNode()
     {
-        auto* newNode = static_cast<Node*>(AllocatorReserve(allocator_));
+        auto* newNode = static_cast<Node*>(allocator_->Reserve());
         new(newNode) Node();
         return newNode;
     }
@@ -482,7 +481,7 @@ private:
     /// Reserve a node with initial value.
     Node* ReserveNode(const T& value)
     {
-        auto* newNode = static_cast<Node*>(AllocatorReserve(allocator_));
+        auto* newNode = static_cast<Node*>(allocator_->Reserve());
         new(newNode) Node(value);
         return newNode;
     }
@@ -491,7 +490,7 @@ private:
     void FreeNode(Node* node)
     {
         (node)->~Node();
-        AllocatorFree(allocator_, node);
+        allocator_->Free(node);
     }
 };
 
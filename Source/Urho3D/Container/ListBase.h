@@ -117,7 +117,7 @@ protected:
     /// Tail node pointer.
     ListNodeBase* tail_;
     /// Node allocator.
-    AllocatorBlock* allocator_;
+    PoolAllocator* allocator_;
     /// Number of nodes.
     unsigned size_;
 };
@@ -0,0 +1,75 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#ifdef URHO3D_IS_BUILDING
+#include "Urho3D.h"
+#else
+#include <Urho3D/Urho3D.h>
+#endif
+
+#include <atomic>
+
+namespace Urho3D
+{
+
+/// Lock-free intrusive multiple producer, single consumer queue. Elements are linked through the pointer member given as
+/// the template parameter, so pushing does not allocate. Any thread may push, while only one thread at a time may take
+/// the elements. An element must not be pushed again before it has been taken.
+template <class T, T* T::*Next> class MPSCQueue
+{
+public:
+    /// Construct empty.
+    MPSCQueue() = default;
+    /// Non-copyable.
+    MPSCQueue(const MPSCQueue& rhs) = delete;
+    /// Non-assignable.
+    MPSCQueue& operator =(const MPSCQueue& rhs) = delete;
+
+    /// Push an element. Safe to call from any thread.
+    void Push(T* element)
+    {
+        T* head = head_.load(std::memory_order_relaxed);
+        do
+        {
+            element->*Next = head;
+        } while (!head_.compare_exchange_weak(head, element, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    /// Take all elements and return the most recently pushed one, linked in reverse push order. Return null if empty.
+    T* TakeAll()
+    {
+        // Taking the whole list at once avoids the ABA problem of popping single elements
+        return head_.exchange(nullptr, std::memory_order_acquire);
+    }
+
+    /// Return whether is empty. The result may be stale if other threads are pushing.
+    bool Empty() const { return head_.load(std::memory_order_relaxed) == nullptr; }
+
+private:
+    /// Most recently pushed element.
+    std::atomic<T*> head_{};
+};
+
+}
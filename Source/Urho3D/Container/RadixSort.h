@@ -0,0 +1,174 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/Vector.h"
+#include "../Math/MathDefs.h"
+
+#include <cstring>
+
+namespace Urho3D
+{
+
+/// Number of key bits sorted by each radix sort pass.
+static const unsigned RADIX_SORT_DIGIT_BITS = 8;
+/// Number of buckets of each radix sort pass.
+static const unsigned RADIX_SORT_BUCKETS = 1u << RADIX_SORT_DIGIT_BITS;
+/// Maximum number of radix sort passes for 64-bit keys.
+static const unsigned RADIX_SORT_MAX_DIGITS = 64 / RADIX_SORT_DIGIT_BITS;
+
+/// Convert a float to a radix sort key that sorts in the same order as the float.
+inline unsigned FloatToRadixKey(float value)
+{
+    unsigned bits;
+    memcpy(&bits, &value, sizeof bits);
+    // Flip all bits of negative values and only the sign bit of positive values
+    return bits ^ ((unsigned)((int)bits >> 31) | 0x80000000u);
+}
+
+/// Sort items by 64-bit keys with a stable least significant digit radix sort, moving the keys along. Only the lowest keyBits
+/// of the keys are sorted, and digits that are equal in all keys are skipped. The temporary arrays must hold count elements.
+/// The work is split into numChunks ranges of items, which are processed by calling forEachChunk(numChunks, function), where
+/// function(chunkIndex) must be called once for each chunk index. The chunks of a call may be processed in parallel.
+template <class T, class U> void RadixSort(unsigned long long* keys, T* items, unsigned count, unsigned long long* tempKeys,
+    T* tempItems, unsigned keyBits, unsigned numChunks, const U& forEachChunk)
+{
+    if (count < 2)
+        return;
+
+    const unsigned numDigits = (Min(keyBits, 64U) + RADIX_SORT_DIGIT_BITS - 1) / RADIX_SORT_DIGIT_BITS;
+    const unsigned stride = RADIX_SORT_MAX_DIGITS * RADIX_SORT_BUCKETS;
+    numChunks = Clamp(numChunks, 1U, count);
+    const unsigned chunkSize = (count + numChunks - 1) / numChunks;
+
+    // Per chunk digit counts of all passes, and per chunk bucket offsets of the current pass. A single chunk uses the stack
+    unsigned localCounts[stride];
+    unsigned localOffsets[RADIX_SORT_BUCKETS];
+    PODVector<unsigned> chunkCounts;
+    PODVector<unsigned> chunkOffsets;
+    unsigned* counts = localCounts;
+    unsigned* offsets = localOffsets;
+    if (numChunks > 1)
+    {
+        chunkCounts.Resize(numChunks * stride);
+        chunkOffsets.Resize(numChunks * RADIX_SORT_BUCKETS);
+        counts = chunkCounts.Buffer();
+        offsets = chunkOffsets.Buffer();
+    }
+
+    // Count the digits of all passes at once
+    forEachChunk(numChunks, [&](unsigned chunk)
+    {
+        unsigned* chunkCount = counts + chunk * stride;
+        memset(chunkCount, 0, numDigits * RADIX_SORT_BUCKETS * sizeof(unsigned));
+        const unsigned end = Min((chunk + 1) * chunkSize, count);
+        for (unsigned i = chunk * chunkSize; i < end; ++i)
+        {
+            unsigned long long key = keys[i];
+            for (unsigned d = 0; d < numDigits; ++d)
+                ++chunkCount[d * RADIX_SORT_BUCKETS + ((key >> (d * RADIX_SORT_DIGIT_BITS)) & (RADIX_SORT_BUCKETS - 1))];
+        }
+    });
+
+    unsigned long long* srcKeys = keys;
+    unsigned long long* dstKeys = tempKeys;
+    T* srcItems = items;
+    T* dstItems = tempItems;
+    bool moved = false;
+
+    for (unsigned d = 0; d < numDigits; ++d)
+    {
+        const unsigned shift = d * RADIX_SORT_DIGIT_BITS;
+
+        // Skip the pass if all keys have the same digit. The total count does not depend on the order of the items
+        const unsigned firstDigit = (unsigned)((srcKeys[0] >> shift) & (RADIX_SORT_BUCKETS - 1));
+        unsigned firstDigitCount = 0;
+        for (unsigned c = 0; c < numChunks; ++c)
+            firstDigitCount += counts[c * stride + d * RADIX_SORT_BUCKETS + firstDigit];
+        if (firstDigitCount == count)
+            continue;
+
+        // The items have moved between the chunks since counting, so count the digit of this pass again
+        if (moved && numChunks > 1)
+        {
+            forEachChunk(numChunks, [&](unsigned chunk)
+            {
+                unsigned* chunkCount = counts + chunk * stride + d * RADIX_SORT_BUCKETS;
+                memset(chunkCount, 0, RADIX_SORT_BUCKETS * sizeof(unsigned));
+                const unsigned end = Min((chunk + 1) * chunkSize, count);
+                for (unsigned i = chunk * chunkSize; i < end; ++i)
+                    ++chunkCount[(srcKeys[i] >> shift) & (RADIX_SORT_BUCKETS - 1)];
+            });
+        }
+
+        // Each chunk writes its items of a bucket after the same bucket's items of the previous chunks, which keeps the sort stable
+        unsigned offset = 0;
+        for (unsigned b = 0; b < RADIX_SORT_BUCKETS; ++b)
+        {
+            for (unsigned c = 0; c < numChunks; ++c)
+            {
+                offsets[c * RADIX_SORT_BUCKETS + b] = offset;
+                offset += counts[c * stride + d * RADIX_SORT_BUCKETS + b];
+            }
+        }
+
+        forEachChunk(numChunks, [&](unsigned chunk)
+        {
+            unsigned* chunkOffset = offsets + chunk * RADIX_SORT_BUCKETS;
+            const unsigned end = Min((chunk + 1) * chunkSize, count);
+            for (unsigned i = chunk * chunkSize; i < end; ++i)
+            {
+                unsigned dest = chunkOffset[(srcKeys[i] >> shift) & (RADIX_SORT_BUCKETS - 1)]++;
+                dstKeys[dest] = srcKeys[i];
+                dstItems[dest] = srcItems[i];
+            }
+        });
+
+        Swap(srcKeys, dstKeys);
+        Swap(srcItems, dstItems);
+        moved = true;
+    }
+
+    // Copy back if the last pass wrote to the temporary arrays
+    if (srcKeys != keys)
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            keys[i] = srcKeys[i];
+            items[i] = srcItems[i];
+        }
+    }
+}
+
+/// Sort items by 64-bit keys with a stable least significant digit radix sort in the calling thread.
+template <class T> void RadixSort(unsigned long long* keys, T* items, unsigned count, unsigned long long* tempKeys,
+    T* tempItems, unsigned keyBits = 64)
+{
+    RadixSort(keys, items, count, tempKeys, tempItems, keyBits, 1, [](unsigned numChunks, const auto& function)
+    {
+        for (unsigned i = 0; i < numChunks; ++i)
+            function(i);
+    });
+}
+
+}
@@ -24,6 +24,7 @@
 
 #include "../IO/Log.h"
 
+#include <atomic>
 #include <cstdio>
 
 #include "../DebugNew.h"
@@ -35,122 +36,93 @@
 namespace Urho3D
 {
 
-char String::endZero = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#error "String stores its heap flag in the highest byte of the capacity, which must be the last byte of the storage"
+#endif
+
+static_assert(sizeof(String) == String::LOCAL_CAPACITY + 1, "The inline buffer must not make String larger");
+
+/// Whether short strings are stored inline.
+static std::atomic<bool> inlineStorage(true);
 
 const String String::EMPTY;
 
-String::String(const WString& str) :
-    length_(0),
-    capacity_(0),
-    buffer_(&endZero)
+String::String(const WString& str)
 {
     SetUTF8FromWChar(str.CString());
 }
 
-String::String(int value) :
-    length_(0),
-    capacity_(0),
-    buffer_(&endZero)
+String::String(int value)
 {
     char tempBuffer[CONVERSION_BUFFER_LENGTH];
     sprintf(tempBuffer, "%d", value);
     *this = tempBuffer;
 }
 
-String::String(short value) :
-    length_(0),
-    capacity_(0),
-    buffer_(&endZero)
+String::String(short value)
 {
     char tempBuffer[CONVERSION_BUFFER_LENGTH];
     sprintf(tempBuffer, "%d", value);
     *this = tempBuffer;
 }
 
-String::String(long value) :
-    length_(0),
-    capacity_(0),
-    buffer_(&endZero)
+String::String(long value)
 {
     char tempBuffer[CONVERSION_BUFFER_LENGTH];
     sprintf(tempBuffer, "%ld", value);
     *this = tempBuffer;
 }
 
-String::String(long long value) :
-    length_(0),
-    capacity_(0),
-    buffer_(&endZero)
+String::String(long long value)
 {
     char tempBuffer[CONVERSION_BUFFER_LENGTH];
     sprintf(tempBuffer, "%lld", value);
     *this = tempBuffer;
 }
 
-String::String(unsigned value) :
-    length_(0),
-    capacity_(0),
-    buffer_(&endZero)
+String::String(unsigned value)
 {
     char tempBuffer[CONVERSION_BUFFER_LENGTH];
     sprintf(tempBuffer, "%u", value);
     *this = tempBuffer;
 }
 
-String::String(unsigned short value) :
-    length_(0),
-    capacity_(0),
-    buffer_(&endZero)
+String::String(unsigned short value)
 {
     char tempBuffer[CONVERSION_BUFFER_LENGTH];
     sprintf(tempBuffer, "%u", value);
     *this = tempBuffer;
 }
 
-String::String(unsigned long value) :
-    length_(0),
-    capacity_(0),
-    buffer_(&endZero)
+String::String(unsigned long value)
 {
     char tempBuffer[CONVERSION_BUFFER_LENGTH];
     sprintf(tempBuffer, "%lu", value);
     *this = tempBuffer;
 }
 
-String::String(unsigned long long value) :
-    length_(0),
-    capacity_(0),
-    buffer_(&endZero)
+String::String(unsigned long long value)
 {
     char tempBuffer[CONVERSION_BUFFER_LENGTH];
     sprintf(tempBuffer, "%llu", value);
     *this = tempBuffer;
 }
 
-String::String(float value) :
-    length_(0),
-    capacity_(0),
-    buffer_(&endZero)
+String::String(float value)
 {
     char tempBuffer[CONVERSION_BUFFER_LENGTH];
     sprintf(tempBuffer, "%g", value);
     *this = tempBuffer;
 }
 
-String::String(double value) :
-    length_(0),
-    capacity_(0),
-    buffer_(&endZero)
+String::String(double value)
 {
     char tempBuffer[CONVERSION_BUFFER_LENGTH];
     sprintf(tempBuffer, "%.15g", value);
     *this = tempBuffer;
 }
 
-String::String(bool value) :
-    length_(0),
-    capacity_(0),
-    buffer_(&endZero)
+String::String(bool value)
 {
     if (value)
         *this = "true";
@@ -158,23 +130,17 @@ String::String(bool value) :
         *this = "false";
 }
 
-String::String(char value) :
-    length_(0),
-    capacity_(0),
-    buffer_(&endZero)
+String::String(char value)
 {
     Resize(1);
-    buffer_[0] = value;
+    Buffer()[0] = value;
 }
 
-String::String(char value, unsigned length) :
-    length_(0),
-    capacity_(0),
-    buffer_(&endZero)
+String::String(char value, unsigned length)
 {
     Resize(length);
     for (unsigned i = 0; i < length; ++i)
-        buffer_[i] = value;
+        Buffer()[i] = value;
 }
 
 String& String::operator +=(int rhs)
@@ -231,19 +197,19 @@ void String::Replace(char replaceThis, char replaceWith, bool caseSensitive)
 {
     if (caseSensitive)
     {
-        for (unsigned i = 0; i < length_; ++i)
+        for (unsigned i = 0; i < Length(); ++i)
         {
-            if (buffer_[i] == replaceThis)
-                buffer_[i] = replaceWith;
+            if (Buffer()[i] == replaceThis)
+                Buffer()[i] = replaceWith;
         }
     }
     else
     {
         replaceThis = (char)tolower(replaceThis);
-        for (unsigned i = 0; i < length_; ++i)
+        for (unsigned i = 0; i < Length(); ++i)
         {
-            if (tolower(buffer_[i]) == replaceThis)
-                buffer_[i] = replaceWith;
+            if (tolower(Buffer()[i]) == replaceThis)
+                Buffer()[i] = replaceWith;
         }
     }
 }
@@ -252,29 +218,29 @@ void String::Replace(const String& replaceThis, const String& replaceWith, bool
 {
     unsigned nextPos = 0;
 
-    while (nextPos < length_)
+    while (nextPos < Length())
     {
         unsigned pos = Find(replaceThis, nextPos, caseSensitive);
         if (pos == NPOS)
             break;
-        Replace(pos, replaceThis.length_, replaceWith);
-        nextPos = pos + replaceWith.length_;
+        Replace(pos, replaceThis.Length(), replaceWith);
+        nextPos = pos + replaceWith.Length();
     }
 }
 
 void String::Replace(unsigned pos, unsigned length, const String& replaceWith)
 {
     // If substring is illegal, do nothing
-    if (pos + length > length_)
+    if (pos + length > Length())
         return;
 
-    Replace(pos, length, replaceWith.buffer_, replaceWith.length_);
+    Replace(pos, length, replaceWith.Buffer(), replaceWith.Length());
 }
 
 void String::Replace(unsigned pos, unsigned length, const char* replaceWith)
 {
     // If substring is illegal, do nothing
-    if (pos + length > length_)
+    if (pos + length > Length())
         return;
 
     Replace(pos, length, replaceWith, CStringLength(replaceWith));
@@ -283,7 +249,7 @@ void String::Replace(unsigned pos, unsigned length, const char* replaceWith)
 String::Iterator String::Replace(const String::Iterator& start, const String::Iterator& end, const String& replaceWith)
 {
     unsigned pos = (unsigned)(start - Begin());
-    if (pos >= length_)
+    if (pos >= Length())
         return End();
     auto length = (unsigned)(end - start);
     Replace(pos, length, replaceWith);
@@ -324,19 +290,19 @@ String& String::Append(const char* str, unsigned length)
 {
     if (str)
     {
-        unsigned oldLength = length_;
+        unsigned oldLength = Length();
         Resize(oldLength + length);
-        CopyChars(&buffer_[oldLength], str, length);
+        CopyChars(&Buffer()[oldLength], str, length);
     }
     return *this;
 }
 
 void String::Insert(unsigned pos, const String& str)
 {
-    if (pos > length_)
-        pos = length_;
+    if (pos > Length())
+        pos = Length();
 
-    if (pos == length_)
+    if (pos == Length())
         (*this) += str;
     else
         Replace(pos, 0, str);
@@ -344,25 +310,25 @@ void String::Insert(unsigned pos, const String& str)
 
 void String::Insert(unsigned pos, char c)
 {
-    if (pos > length_)
-        pos = length_;
+    if (pos > Length())
+        pos = Length();
 
-    if (pos == length_)
+    if (pos == Length())
         (*this) += c;
     else
     {
-        unsigned oldLength = length_;
-        Resize(length_ + 1);
+        unsigned oldLength = Length();
+        Resize(Length() + 1);
         MoveRange(pos + 1, pos, oldLength - pos);
-        buffer_[pos] = c;
+        Buffer()[pos] = c;
     }
 }
 
 String::Iterator String::Insert(const String::Iterator& dest, const String& str)
 {
     unsigned pos = (unsigned)(dest - Begin());
-    if (pos > length_)
-        pos = length_;
+    if (pos > Length())
+        pos = Length();
     Insert(pos, str);
 
     return Begin() + pos;
@@ -371,8 +337,8 @@ String::Iterator String::Insert(const String::Iterator& dest, const String& str)
 String::Iterator String::Insert(const String::Iterator& dest, const String::Iterator& start, const String::Iterator& end)
 {
     unsigned pos = (unsigned)(dest - Begin());
-    if (pos > length_)
-        pos = length_;
+    if (pos > Length())
+        pos = Length();
     auto length = (unsigned)(end - start);
     Replace(pos, 0, &(*start), length);
 
@@ -382,8 +348,8 @@ String::Iterator String::Insert(const String::Iterator& dest, const String::Iter
 String::Iterator String::Insert(const String::Iterator& dest, char c)
 {
     unsigned pos = (unsigned)(dest - Begin());
-    if (pos > length_)
-        pos = length_;
+    if (pos > Length())
+        pos = Length();
     Insert(pos, c);
 
     return Begin() + pos;
@@ -397,7 +363,7 @@ void String::Erase(unsigned pos, unsigned length)
 String::Iterator String::Erase(const String::Iterator& it)
 {
     unsigned pos = (unsigned)(it - Begin());
-    if (pos >= length_)
+    if (pos >= Length())
         return End();
     Erase(pos);
 
@@ -407,7 +373,7 @@ String::Iterator String::Erase(const String::Iterator& it)
 String::Iterator String::Erase(const String::Iterator& start, const String::Iterator& end)
 {
     unsigned pos = (unsigned)(start - Begin());
-    if (pos >= length_)
+    if (pos >= Length())
         return End();
     auto length = (unsigned)(end - start);
     Erase(pos, length);
@@ -417,62 +383,92 @@ String::Iterator String::Erase(const String::Iterator& start, const String::Iter
 
 void String::Resize(unsigned newLength)
 {
-    if (!capacity_)
+    if (IsLocal())
     {
-        // If zero length requested, do not allocate buffer yet
-        if (!newLength)
+        // Short strings stay in the inline buffer. When inline storage is disabled, only the empty string does
+        if (newLength < LOCAL_CAPACITY && (!newLength || inlineStorage.load(std::memory_order_relaxed)))
+        {
+            local_[newLength] = 0;
+            SetLocalLength(newLength);
             return;
+        }
 
         // Calculate initial capacity
-        capacity_ = newLength + 1;
-        if (capacity_ < MIN_CAPACITY)
-            capacity_ = MIN_CAPACITY;
-
-        buffer_ = new char[capacity_];
+        unsigned capacity = newLength + 1;
+        if (capacity < MIN_CAPACITY)
+            capacity = MIN_CAPACITY;
+
+        auto* newBuffer = new char[capacity];
+        // Move the existing data from the inline buffer, which the heap data overlaps
+        CopyChars(newBuffer, local_, Length());
+        heap_.buffer_ = newBuffer;
+        heap_.capacity_ = capacity | HEAP_FLAG;
     }
-    else
+    else if (Capacity() < newLength + 1)
     {
-        if (newLength && capacity_ < newLength + 1)
-        {
-            // Increase the capacity with half each time it is exceeded
-            while (capacity_ < newLength + 1)
-                capacity_ += (capacity_ + 1) >> 1u;
-
-            auto* newBuffer = new char[capacity_];
-            // Move the existing data to the new buffer, then delete the old buffer
-            if (length_)
-                CopyChars(newBuffer, buffer_, length_);
-            delete[] buffer_;
-
-            buffer_ = newBuffer;
-        }
+        // Increase the capacity with half each time it is exceeded
+        unsigned capacity = Capacity();
+        while (capacity < newLength + 1)
+            capacity += (capacity + 1) >> 1u;
+
+        auto* newBuffer = new char[capacity];
+        // Move the existing data to the new buffer, then delete the old buffer
+        CopyChars(newBuffer, heap_.buffer_, heap_.length_);
+        delete[] heap_.buffer_;
+
+        heap_.buffer_ = newBuffer;
+        heap_.capacity_ = capacity | HEAP_FLAG;
     }
 
-    buffer_[newLength] = 0;
-    length_ = newLength;
+    heap_.buffer_[newLength] = 0;
+    heap_.length_ = newLength;
 }
 
 void String::Reserve(unsigned newCapacity)
 {
-    if (newCapacity < length_ + 1)
-        newCapacity = length_ + 1;
-    if (newCapacity == capacity_)
+    unsigned length = Length();
+    if (newCapacity < length + 1)
+        newCapacity = length + 1;
+    if (newCapacity == Capacity())
         return;
 
-    auto* newBuffer = new char[newCapacity];
-    // Move the existing data to the new buffer, then delete the old buffer
-    CopyChars(newBuffer, buffer_, length_ + 1);
-    if (capacity_)
-        delete[] buffer_;
+    if (IsLocal())
+    {
+        // The inline buffer can not shrink
+        if (newCapacity <= LOCAL_CAPACITY)
+            return;
 
-    capacity_ = newCapacity;
-    buffer_ = newBuffer;
+        auto* newBuffer = new char[newCapacity];
+        CopyChars(newBuffer, local_, length + 1);
+        heap_.buffer_ = newBuffer;
+        heap_.length_ = length;
+        heap_.capacity_ = newCapacity | HEAP_FLAG;
+        return;
+    }
+
+    // Keep the old buffer pointer, as the inline buffer overlaps it
+    char* oldBuffer = heap_.buffer_;
+    if (newCapacity <= LOCAL_CAPACITY && inlineStorage.load(std::memory_order_relaxed))
+    {
+        CopyChars(local_, oldBuffer, length + 1);
+        SetLocalLength(length);
+    }
+    else
+    {
+        auto* newBuffer = new char[newCapacity];
+        // Move the existing data to the new buffer, then delete the old buffer
+        CopyChars(newBuffer, oldBuffer, length + 1);
+        heap_.buffer_ = newBuffer;
+        heap_.capacity_ = newCapacity | HEAP_FLAG;
+    }
+
+    delete[] oldBuffer;
 }
 
 void String::Compact()
 {
-    if (capacity_)
-        Reserve(length_ + 1);
+    if (!IsLocal())
+        Reserve(heap_.length_ + 1);
 }
 
 void String::Clear()
@@ -482,18 +478,30 @@ void String::Clear()
 
 void String::Swap(String& str)
 {
-    Urho3D::Swap(length_, str.length_);
-    Urho3D::Swap(capacity_, str.capacity_);
-    Urho3D::Swap(buffer_, str.buffer_);
+    // The heap data and the inline buffer share memory, so swapping the bytes swaps either
+    char buffer[sizeof(local_)];
+    memcpy(buffer, local_, sizeof(local_));
+    memcpy(local_, str.local_, sizeof(local_));
+    memcpy(str.local_, buffer, sizeof(local_));
+}
+
+void String::SetInlineStorage(bool enable)
+{
+    inlineStorage.store(enable, std::memory_order_relaxed);
+}
+
+bool String::GetInlineStorage()
+{
+    return inlineStorage.load(std::memory_order_relaxed);
 }
 
 String String::Substring(unsigned pos) const
 {
-    if (pos < length_)
+    if (pos < Length())
     {
         String ret;
-        ret.Resize(length_ - pos);
-        CopyChars(ret.buffer_, buffer_ + pos, ret.length_);
+        ret.Resize(Length() - pos);
+        CopyChars(ret.Buffer(), Buffer() + pos, ret.Length());
 
         return ret;
     }
@@ -503,13 +511,13 @@ String String::Substring(unsigned pos) const
 
 String String::Substring(unsigned pos, unsigned length) const
 {
-    if (pos < length_)
+    if (pos < Length())
     {
         String ret;
-        if (pos + length > length_)
-            length = length_ - pos;
+        if (pos + length > Length())
+            length = Length() - pos;
         ret.Resize(length);
-        CopyChars(ret.buffer_, buffer_ + pos, ret.length_);
+        CopyChars(ret.Buffer(), Buffer() + pos, ret.Length());
 
         return ret;
     }
@@ -520,18 +528,18 @@ String String::Substring(unsigned pos, unsigned length) const
 String String::Trimmed(const String& chars) const
 {
     unsigned trimStart = 0;
-    unsigned trimEnd = length_;
+    unsigned trimEnd = Length();
 
     while (trimStart < trimEnd)
     {
-        char c = buffer_[trimStart];
+        char c = Buffer()[trimStart];
         if (!chars.Contains(c))
             break;
         ++trimStart;
     }
     while (trimEnd > trimStart)
     {
-        char c = buffer_[trimEnd - 1];
+        char c = Buffer()[trimEnd - 1];
         if (!chars.Contains(c))
             break;
         --trimEnd;
@@ -543,8 +551,8 @@ String String::Trimmed(const String& chars) const
 String String::ToLower() const
 {
     String ret(*this);
-    for (unsigned i = 0; i < ret.length_; ++i)
-        ret[i] = (char)tolower(buffer_[i]);
+    for (unsigned i = 0; i < ret.Length(); ++i)
+        ret[i] = (char)tolower(Buffer()[i]);
 
     return ret;
 }
@@ -552,8 +560,8 @@ String String::ToLower() const
 String String::ToUpper() const
 {
     String ret(*this);
-    for (unsigned i = 0; i < ret.length_; ++i)
-        ret[i] = (char)toupper(buffer_[i]);
+    for (unsigned i = 0; i < ret.Length(); ++i)
+        ret[i] = (char)toupper(Buffer()[i]);
 
     return ret;
 }
@@ -572,18 +580,18 @@ unsigned String::Find(char c, unsigned startPos, bool caseSensitive) const
 {
     if (caseSensitive)
     {
-        for (unsigned i = startPos; i < length_; ++i)
+        for (unsigned i = startPos; i < Length(); ++i)
         {
-            if (buffer_[i] == c)
+            if (Buffer()[i] == c)
                 return i;
         }
     }
     else
     {
         c = (char)tolower(c);
-        for (unsigned i = startPos; i < length_; ++i)
+        for (unsigned i = startPos; i < Length(); ++i)
         {
-            if (tolower(buffer_[i]) == c)
+            if (tolower(Buffer()[i]) == c)
                 return i;
         }
     }
@@ -593,16 +601,16 @@ unsigned String::Find(char c, unsigned startPos, bool caseSensitive) const
 
 unsigned String::Find(const String& str, unsigned startPos, bool caseSensitive) const
 {
-    if (!str.length_ || str.length_ > length_)
+    if (!str.Length() || str.Length() > Length())
         return NPOS;
 
-    char first = str.buffer_[0];
+    char first = str.Buffer()[0];
     if (!caseSensitive)
         first = (char)tolower(first);
 
-    for (unsigned i = startPos; i <= length_ - str.length_; ++i)
+    for (unsigned i = startPos; i <= Length() - str.Length(); ++i)
     {
-        char c = buffer_[i];
+        char c = Buffer()[i];
         if (!caseSensitive)
             c = (char)tolower(c);
 
@@ -610,10 +618,10 @@ unsigned String::Find(const String& str, unsigned startPos, bool caseSensitive)
         {
             unsigned skip = NPOS;
             bool found = true;
-            for (unsigned j = 1; j < str.length_; ++j)
+            for (unsigned j = 1; j < str.Length(); ++j)
             {
-                c = buffer_[i + j];
-                char d = str.buffer_[j];
+                c = Buffer()[i + j];
+                char d = str.Buffer()[j];
                 if (!caseSensitive)
                 {
                     c = (char)tolower(c);
@@ -641,23 +649,23 @@ unsigned String::Find(const String& str, unsigned startPos, bool caseSensitive)
 
 unsigned String::FindLast(char c, unsigned startPos, bool caseSensitive) const
 {
-    if (startPos >= length_)
-        startPos = length_ - 1;
+    if (startPos >= Length())
+        startPos = Length() - 1;
 
     if (caseSensitive)
     {
-        for (unsigned i = startPos; i < length_; --i)
+        for (unsigned i = startPos; i < Length(); --i)
         {
-            if (buffer_[i] == c)
+            if (Buffer()[i] == c)
                 return i;
         }
     }
     else
     {
         c = (char)tolower(c);
-        for (unsigned i = startPos; i < length_; --i)
+        for (unsigned i = startPos; i < Length(); --i)
         {
-            if (tolower(buffer_[i]) == c)
+            if (tolower(Buffer()[i]) == c)
                 return i;
         }
     }
@@ -667,28 +675,28 @@ unsigned String::FindLast(char c, unsigned startPos, bool caseSensitive) const
 
 unsigned String::FindLast(const String& str, unsigned startPos, bool caseSensitive) const
 {
-    if (!str.length_ || str.length_ > length_)
+    if (!str.Length() || str.Length() > Length())
         return NPOS;
-    if (startPos > length_ - str.length_)
-        startPos = length_ - str.length_;
+    if (startPos > Length() - str.Length())
+        startPos = Length() - str.Length();
 
-    char first = str.buffer_[0];
+    char first = str.Buffer()[0];
     if (!caseSensitive)
         first = (char)tolower(first);
 
-    for (unsigned i = startPos; i < length_; --i)
+    for (unsigned i = startPos; i < Length(); --i)
     {
-        char c = buffer_[i];
+        char c = Buffer()[i];
         if (!caseSensitive)
             c = (char)tolower(c);
 
         if (c == first)
         {
             bool found = true;
-            for (unsigned j = 1; j < str.length_; ++j)
+            for (unsigned j = 1; j < str.Length(); ++j)
             {
-                c = buffer_[i + j];
-                char d = str.buffer_[j];
+                c = Buffer()[i + j];
+                char d = str.Buffer()[j];
                 if (!caseSensitive)
                 {
                     c = (char)tolower(c);
@@ -781,10 +789,10 @@ unsigned String::LengthUTF8() const
 {
     unsigned ret = 0;
 
-    const char* src = buffer_;
+    const char* src = Buffer();
     if (!src)
         return ret;
-    const char* end = buffer_ + length_;
+    const char* end = Buffer() + Length();
 
     while (src < end)
     {
@@ -800,7 +808,7 @@ unsigned String::ByteOffsetUTF8(unsigned index) const
     unsigned byteOffset = 0;
     unsigned utfPos = 0;
 
-    while (utfPos < index && byteOffset < length_)
+    while (utfPos < index && byteOffset < Length())
     {
         NextUTF8Char(byteOffset);
         ++utfPos;
@@ -811,12 +819,12 @@ unsigned String::ByteOffsetUTF8(unsigned index) const
 
 unsigned String::NextUTF8Char(unsigned& byteOffset) const
 {
-    if (!buffer_)
+    if (!Buffer())
         return 0;
 
-    const char* src = buffer_ + byteOffset;
+    const char* src = Buffer() + byteOffset;
     unsigned ret = DecodeUTF8(src);
-    byteOffset = (unsigned)(src - buffer_);
+    byteOffset = (unsigned)(src - Buffer());
 
     return ret;
 }
@@ -832,7 +840,7 @@ void String::ReplaceUTF8(unsigned index, unsigned unicodeChar)
     unsigned utfPos = 0;
     unsigned byteOffset = 0;
 
-    while (utfPos < index && byteOffset < length_)
+    while (utfPos < index && byteOffset < Length())
     {
         NextUTF8Char(byteOffset);
         ++utfPos;
@@ -1215,23 +1223,23 @@ void String::Replace(unsigned pos, unsigned length, const char* srcStart, unsign
 {
     int delta = (int)srcLength - (int)length;
 
-    if (pos + length < length_)
+    if (pos + length < Length())
     {
         if (delta < 0)
         {
-            MoveRange(pos + srcLength, pos + length, length_ - pos - length);
-            Resize(length_ + delta);
+            MoveRange(pos + srcLength, pos + length, Length() - pos - length);
+            Resize(Length() + delta);
         }
         if (delta > 0)
         {
-            Resize(length_ + delta);
-            MoveRange(pos + srcLength, pos + length, length_ - pos - length - delta);
+            Resize(Length() + delta);
+            MoveRange(pos + srcLength, pos + length, Length() - pos - length - delta);
         }
     }
     else
-        Resize(length_ + delta);
+        Resize(Length() + delta);
 
-    CopyChars(buffer_ + pos, srcStart, srcLength);
+    CopyChars(Buffer() + pos, srcStart, srcLength);
 }
 
 WString::WString() :
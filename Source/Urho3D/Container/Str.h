@@ -43,7 +43,7 @@ template <class T, class U> class HashMap;
 /// Map of strings.
 using StringMap = HashMap<StringHash, String>;
 
-/// %String class.
+/// %String class. Strings shorter than LOCAL_CAPACITY characters are stored inline without a heap allocation.
 class URHO3D_API String
 {
 public:
@@ -51,91 +51,61 @@ public:
     using ConstIterator = RandomAccessConstIterator<char>;
 
     /// Construct empty.
-    String() noexcept :
-        length_(0),
-        capacity_(0),
-        buffer_(&endZero)
+    String() noexcept
     {
     }
 
     /// Construct from another string.
-    String(const String& str) :
-        length_(0),
-        capacity_(0),
-        buffer_(&endZero)
+    String(const String& str)
     {
         *this = str;
     }
 
     /// Move-construct from another string.
-    String(String && str) noexcept :
-        length_(0),
-        capacity_(0),
-        buffer_(&endZero)
+    String(String && str) noexcept
     {
         Swap(str);
     }
 
     /// Construct from a C string.
-    String(const char* str) :   // NOLINT(google-explicit-constructor)
-        length_(0),
-        capacity_(0),
-        buffer_(&endZero)
+    String(const char* str)   // NOLINT(google-explicit-constructor)
     {
         *this = str;
     }
 
     /// Construct from a C string.
-    String(char* str) :         // NOLINT(google-explicit-constructor)
-        length_(0),
-        capacity_(0),
-        buffer_(&endZero)
+    String(char* str)         // NOLINT(google-explicit-constructor)
     {
         *this = (const char*)str;
     }
 
     /// Construct from a char array and length.
-    String(const char* str, unsigned length) :
-        length_(0),
-        capacity_(0),
-        buffer_(&endZero)
+    String(const char* str, unsigned length)
     {
         Resize(length);
-        CopyChars(buffer_, str, length);
+        CopyChars(Buffer(), str, length);
     }
 
     /// Construct from std::string.
-    String(const std::string& str) :
-        length_(0),
-        capacity_(0),
-        buffer_(&endZero)
+    String(const std::string& str)
     {
         *this = str.c_str();
     }
 
     /// Construct from std::wstring.
-    String(const std::wstring& str) :
-        length_(0),
-        capacity_(0),
-        buffer_(&endZero)
+    String(const std::wstring& str)
     {
         SetUTF8FromWChar(str.c_str());
     }
 
     /// Construct from a null-terminated wide character array.
-    explicit String(const wchar_t* str) :
-        length_(0),
-        capacity_(0),
-        buffer_(&endZero)
+    explicit String(const wchar_t* str)
     {
         SetUTF8FromWChar(str);
     }
 
     /// Construct from a null-terminated wide character array.
-    explicit String(wchar_t* str) :
-        length_(0),
-        capacity_(0),
-        buffer_(&endZero)
+    explicit String(wchar_t* str)
     {
         SetUTF8FromWChar(str);
     }
@@ -171,10 +141,7 @@ public:
     explicit String(char value, unsigned length);
 
     /// Construct from a convertible value.
-    template <class T> explicit String(const T& value) :
-        length_(0),
-        capacity_(0),
-        buffer_(&endZero)
+    template <class T> explicit String(const T& value)
     {
         *this = value.ToString();
     }
@@ -182,8 +149,8 @@ public:
     /// Destruct.
     ~String()
     {
-        if (capacity_)
-            delete[] buffer_;
+        if (!IsLocal())
+            delete[] heap_.buffer_;
     }
 
     /// Assign a string.
@@ -191,8 +158,8 @@ public:
     {
         if (&rhs != this)
         {
-            Resize(rhs.length_);
-            CopyChars(buffer_, rhs.buffer_, rhs.length_);
+            Resize(rhs.Length());
+            CopyChars(Buffer(), rhs.Buffer(), rhs.Length());
         }
 
         return *this;
@@ -211,7 +178,7 @@ public:
     {
         unsigned rhsLength = CStringLength(rhs);
         Resize(rhsLength);
-        CopyChars(buffer_, rhs, rhsLength);
+        CopyChars(Buffer(), rhs, rhsLength);
 
         return *this;
     }
@@ -219,9 +186,9 @@ public:
     /// Add-assign a string.
     String& operator +=(const String& rhs)
     {
-        unsigned oldLength = length_;
-        Resize(length_ + rhs.length_);
-        CopyChars(buffer_ + oldLength, rhs.buffer_, rhs.length_);
+        unsigned oldLength = Length();
+        Resize(Length() + rhs.Length());
+        CopyChars(Buffer() + oldLength, rhs.Buffer(), rhs.Length());
 
         return *this;
     }
@@ -230,9 +197,9 @@ public:
     String& operator +=(const char* rhs)
     {
         unsigned rhsLength = CStringLength(rhs);
-        unsigned oldLength = length_;
-        Resize(length_ + rhsLength);
-        CopyChars(buffer_ + oldLength, rhs, rhsLength);
+        unsigned oldLength = Length();
+        Resize(Length() + rhsLength);
+        CopyChars(Buffer() + oldLength, rhs, rhsLength);
 
         return *this;
     }
@@ -240,9 +207,9 @@ public:
     /// Add-assign a character.
     String& operator +=(char rhs)
     {
-        unsigned oldLength = length_;
-        Resize(length_ + 1);
-        buffer_[oldLength] = rhs;
+        unsigned oldLength = Length();
+        Resize(Length() + 1);
+        Buffer()[oldLength] = rhs;
 
         return *this;
     }
@@ -275,9 +242,9 @@ public:
     String operator +(const String& rhs) const
     {
         String ret;
-        ret.Resize(length_ + rhs.length_);
-        CopyChars(ret.buffer_, buffer_, length_);
-        CopyChars(ret.buffer_ + length_, rhs.buffer_, rhs.length_);
+        ret.Resize(Length() + rhs.Length());
+        CopyChars(ret.Buffer(), Buffer(), Length());
+        CopyChars(ret.Buffer() + Length(), rhs.Buffer(), rhs.Length());
 
         return ret;
     }
@@ -287,9 +254,9 @@ public:
     {
         unsigned rhsLength = CStringLength(rhs);
         String ret;
-        ret.Resize(length_ + rhsLength);
-        CopyChars(ret.buffer_, buffer_, length_);
-        CopyChars(ret.buffer_ + length_, rhs, rhsLength);
+        ret.Resize(Length() + rhsLength);
+        CopyChars(ret.Buffer(), Buffer(), Length());
+        CopyChars(ret.Buffer() + Length(), rhs, rhsLength);
 
         return ret;
     }
@@ -321,29 +288,29 @@ public:
     /// Return char at index.
     char& operator [](unsigned index)
     {
-        assert(index < length_);
-        return buffer_[index];
+        assert(index < Length());
+        return Buffer()[index];
     }
 
     /// Return const char at index.
     const char& operator [](unsigned index) const
     {
-        assert(index < length_);
-        return buffer_[index];
+        assert(index < Length());
+        return Buffer()[index];
     }
 
     /// Return char at index.
     char& At(unsigned index)
     {
-        assert(index < length_);
-        return buffer_[index];
+        assert(index < Length());
+        return Buffer()[index];
     }
 
     /// Return const char at index.
     const char& At(unsigned index) const
     {
-        assert(index < length_);
-        return buffer_[index];
+        assert(index < Length());
+        return Buffer()[index];
     }
 
     /// Replace all occurrences of a character.
@@ -396,22 +363,22 @@ public:
     void Swap(String& str);
 
     /// Return iterator to the beginning.
-    Iterator Begin() { return Iterator(buffer_); }
+    Iterator Begin() { return Iterator(Buffer()); }
 
     /// Return const iterator to the beginning.
-    ConstIterator Begin() const { return ConstIterator(buffer_); }
+    ConstIterator Begin() const { return ConstIterator(Buffer()); }
 
     /// Return iterator to the end.
-    Iterator End() { return Iterator(buffer_ + length_); }
+    Iterator End() { return Iterator(Buffer() + Length()); }
 
     /// Return const iterator to the end.
-    ConstIterator End() const { return ConstIterator(buffer_ + length_); }
+    ConstIterator End() const { return ConstIterator(Buffer() + Length()); }
 
     /// Return first char, or 0 if empty.
-    char Front() const { return buffer_[0]; }
+    char Front() const { return Buffer()[0]; }
 
     /// Return last char, or 0 if empty.
-    char Back() const { return length_ ? buffer_[length_ - 1] : buffer_[0]; }
+    char Back() const { return Length() ? Buffer()[Length() - 1] : Buffer()[0]; }
 
     /// Return a substring from position to end.
     String Substring(unsigned pos) const;
@@ -441,16 +408,16 @@ public:
     bool EndsWith(const String& str, bool caseSensitive = true) const;
 
     /// Return the C string.
-    const char* CString() const { return buffer_; }
+    const char* CString() const { return Buffer(); }
 
     /// Return length.
-    unsigned Length() const { return length_; }
+    unsigned Length() const { return IsLocal() ? (unsigned)local_[LOCAL_CAPACITY] : heap_.length_; }
 
     /// Return buffer capacity.
-    unsigned Capacity() const { return capacity_; }
+    unsigned Capacity() const { return IsLocal() ? LOCAL_CAPACITY : heap_.capacity_ & ~HEAP_FLAG; }
 
     /// Return whether the string is empty.
-    bool Empty() const { return length_ == 0; }
+    bool Empty() const { return Length() == 0; }
 
     /// Return comparison result with a string.
     int Compare(const String& str, bool caseSensitive = true) const;
@@ -488,7 +455,7 @@ public:
     unsigned ToHash() const
     {
         unsigned hash = 0;
-        const char* ptr = buffer_;
+        const char* ptr = Buffer();
         while (*ptr)
         {
             hash = *ptr + (hash << 6u) + (hash << 16u) - hash;
@@ -528,15 +495,37 @@ public:
     static const unsigned NPOS = 0xffffffff;
     /// Initial dynamic allocation size.
     static const unsigned MIN_CAPACITY = 8;
+    /// Size of the inline buffer including the terminating zero. The inline buffer shares memory with the buffer pointer,
+    /// length and capacity of a heap allocated string, and the byte after it holds the inline length.
+    static const unsigned LOCAL_CAPACITY = sizeof(char*) + 2 * sizeof(unsigned) - 1;
     /// Empty string.
     static const String EMPTY;
 
+    /// Set whether short strings are stored inline. When disabled, every non-empty string allocates a heap buffer as it
+    /// did before the inline buffer existed. Only useful for measuring the difference. Strings keep their current storage.
+    static void SetInlineStorage(bool enable);
+    /// Return whether short strings are stored inline.
+    static bool GetInlineStorage();
+
 private:
+    /// Capacity flag marking a heap allocated string. It lies in the last byte of the storage, which holds the inline
+    /// length of an inline string, and is never set in a valid inline length.
+    static const unsigned HEAP_FLAG = 0x80000000;
+
+    /// Return whether the characters are stored in the inline buffer.
+    bool IsLocal() const { return !(local_[LOCAL_CAPACITY] & 0x80); }
+    /// Set length of an inline string.
+    void SetLocalLength(unsigned length) { local_[LOCAL_CAPACITY] = (char)length; }
+    /// Return the buffer holding the characters.
+    char* Buffer() { return IsLocal() ? local_ : heap_.buffer_; }
+    /// Return the buffer holding the characters.
+    const char* Buffer() const { return IsLocal() ? local_ : heap_.buffer_; }
+
     /// Move a range of characters within the string.
     void MoveRange(unsigned dest, unsigned src, unsigned count)
     {
         if (count)
-            memmove(buffer_ + dest, buffer_ + src, count);
+            memmove(Buffer() + dest, Buffer() + src, count);
     }
 
     /// Copy chars from one buffer to another.
@@ -559,15 +548,24 @@ private:
     /// Replace a substring with another substring.
     void Replace(unsigned pos, unsigned length, const char* srcStart, unsigned srcLength);
 
-    /// String length.
-    unsigned length_;
-    /// Capacity, zero if buffer not allocated.
-    unsigned capacity_;
-    /// String buffer, point to &endZero if buffer is not allocated.
-    char* buffer_;
-
-    /// End zero for empty strings.
-    static char endZero;
+    /// Heap allocated string data.
+    struct HeapData
+    {
+        /// String buffer.
+        char* buffer_;
+        /// String length.
+        unsigned length_;
+        /// Buffer capacity with HEAP_FLAG set. On little-endian platforms its highest byte is the last byte of the storage.
+        unsigned capacity_;
+    };
+
+    union
+    {
+        /// Heap allocated string data.
+        HeapData heap_;
+        /// Inline buffer followed by the inline length. Zero bytes form an empty inline string.
+        char local_[LOCAL_CAPACITY + 1]{};
+    };
 };
 
 /// Add a string to a C string.
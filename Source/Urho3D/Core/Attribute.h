@@ -66,6 +66,8 @@ public:
     virtual void Get(const Serializable* ptr, Variant& dest) const = 0;
     /// Set the attribute.
     virtual void Set(Serializable* ptr, const Variant& src) = 0;
+    /// Set the attribute from a value of the C++ type that corresponds to the attribute's variant type, without constructing a Variant. Return false if not supported by the accessor.
+    virtual bool SetDirect(Serializable* ptr, const void* src) { return false; }
 };
 
 /// Description of an automatically serializable variable.
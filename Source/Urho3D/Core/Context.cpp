@@ -139,7 +139,9 @@ void RemoveNamedAttribute(HashMap<StringHash, Vector<AttributeInfo> >& attribute
 }
 
 Context::Context() :
-    eventHandler_(nullptr)
+    eventHandler_(nullptr),
+    eventPayload_(nullptr),
+    numSentEvents_(0)
 {
 #ifdef __ANDROID__
     // Always reset the random seed on Android, as the Urho3D library might not be unloaded between runs
@@ -484,6 +486,7 @@ void Context::RemoveEventReceiver(Object* receiver, Object* sender, StringHash e
 void Context::BeginSendEvent(Object* sender, StringHash eventType)
 {
     eventSenders_.Push(sender);
+    ++numSentEvents_;
 }
 
 void Context::EndSendEvent()
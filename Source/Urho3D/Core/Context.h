@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include "../Container/FlatHashMap.h"
 #include "../Container/HashSet.h"
 #include "../Core/Attribute.h"
 #include "../Core/Object.h"
@@ -164,6 +165,8 @@ public:
 
     /// Return active event handler. Set by Object. Null outside event handling.
     EventHandler* GetEventHandler() const { return eventHandler_; }
+    /// Return number of events sent since the context was created.
+    unsigned long long GetNumSentEvents() const { return numSentEvents_; }
 
     /// Return object type name from hash, or empty if unknown.
     const String& GetTypeName(StringHash objectType) const;
@@ -207,7 +210,7 @@ public:
     /// Return event receivers for an event type, or null if they do not exist.
     EventReceiverGroup* GetEventReceivers(StringHash eventType)
     {
-        HashMap<StringHash, SharedPtr<EventReceiverGroup> >::Iterator i = eventReceivers_.Find(eventType);
+        FlatHashMap<StringHash, SharedPtr<EventReceiverGroup> >::Iterator i = eventReceivers_.Find(eventType);
         return i != eventReceivers_.End() ? i->second_ : nullptr;
     }
 
@@ -303,6 +306,10 @@ private:
 
     /// Set current event handler. Called by Object.
     void SetEventHandler(EventHandler* handler) { eventHandler_ = handler; }
+    /// Set parameters of the event being passed to Object::OnEvent(). Called by Object.
+    void SetEventPayload(EventPayload* payload) { eventPayload_ = payload; }
+    /// Return parameters of the event being passed to Object::OnEvent(), or null if already taken.
+    EventPayload* GetEventPayload() const { return eventPayload_; }
 
     /// Object factories.
     HashMap<StringHash, SharedPtr<ObjectFactory> > factories_;
@@ -313,15 +320,22 @@ private:
     /// Network replication attribute descriptions per object type.
     HashMap<StringHash, Vector<AttributeInfo> > networkAttributes_;
     /// Event receivers for non-specific events.
-    HashMap<StringHash, SharedPtr<EventReceiverGroup> > eventReceivers_;
+    FlatHashMap<StringHash, SharedPtr<EventReceiverGroup> > eventReceivers_;
     /// Event receivers for specific senders' events.
     HashMap<Object*, HashMap<StringHash, SharedPtr<EventReceiverGroup> > > specificEventReceivers_;
     /// Event sender stack.
     PODVector<Object*> eventSenders_;
     /// Event data stack.
     PODVector<VariantMap*> eventDataMaps_;
+    /// Specific event receivers already reached by the event sends in progress, each send above the previous ones. Kept
+    /// between sends to avoid allocating.
+    PODVector<Object*> processedEventReceivers_;
     /// Active event handler. Not stored in a stack for performance reasons; is needed only in esoteric cases.
     EventHandler* eventHandler_;
+    /// Parameters of the event being passed to Object::OnEvent().
+    EventPayload* eventPayload_;
+    /// Number of sent events.
+    unsigned long long numSentEvents_;
     /// Object categories.
     HashMap<String, PODVector<StringHash> > objectCategories_;
     /// Variant map for global variables that can persist throughout application execution.
@@ -63,4 +63,44 @@ URHO3D_EVENT(E_ENDFRAME, EndFrame)
 {
 }
 
+/// Typed parameters of the application-wide update events.
+struct TimeStepEventData
+{
+    /// Timestep in seconds.
+    float timeStep_{};
+
+    /// Convert to event parameters.
+    void ToVariantMap(VariantMap& eventData) const { eventData[Update::P_TIMESTEP] = timeStep_; }
+    /// Convert from event parameters.
+    void FromVariantMap(const VariantMap& eventData)
+    {
+        const Variant* timeStep = eventData[Update::P_TIMESTEP];
+        timeStep_ = timeStep ? timeStep->GetFloat() : 0.0f;
+    }
+};
+
+/// Typed parameters of E_UPDATE.
+struct UpdateEventData : public TimeStepEventData
+{
+    URHO3D_EVENT_DATA(E_UPDATE)
+};
+
+/// Typed parameters of E_POSTUPDATE.
+struct PostUpdateEventData : public TimeStepEventData
+{
+    URHO3D_EVENT_DATA(E_POSTUPDATE)
+};
+
+/// Typed parameters of E_RENDERUPDATE.
+struct RenderUpdateEventData : public TimeStepEventData
+{
+    URHO3D_EVENT_DATA(E_RENDERUPDATE)
+};
+
+/// Typed parameters of E_POSTRENDERUPDATE.
+struct PostRenderUpdateEventData : public TimeStepEventData
+{
+    URHO3D_EVENT_DATA(E_POSTRENDERUPDATE)
+};
+
 }
@@ -28,6 +28,8 @@
 #include "../Core/Profiler.h"
 #include "../IO/Log.h"
 
+#include <algorithm>
+
 #include "../DebugNew.h"
 
 
@@ -91,38 +93,21 @@ void Object::OnEvent(Object* sender, StringHash eventType, VariantMap& eventData
 
     // Make a copy of the context pointer in case the object is destroyed during event handler invocation
     Context* context = context_;
-    EventHandler* specific = nullptr;
-    EventHandler* nonSpecific = nullptr;
-
-    EventHandler* handler = eventHandlers_.First();
-    while (handler)
-    {
-        if (handler->GetEventType() == eventType)
-        {
-            if (!handler->GetSender())
-                nonSpecific = handler;
-            else if (handler->GetSender() == sender)
-            {
-                specific = handler;
-                break;
-            }
-        }
-        handler = eventHandlers_.Next(handler);
-    }
+    EventHandler* handler = SelectEventHandler(sender, eventType);
 
-    // Specific event handlers have priority, so if found, invoke first
-    if (specific)
-    {
-        context->SetEventHandler(specific);
-        specific->Invoke(eventData);
-        context->SetEventHandler(nullptr);
-        return;
-    }
+    // Go through the parameters of the send if they are available, so that typed handlers share one conversion
+    EventPayload* payload = context->GetEventPayload();
+    if (payload && payload->GetVariantMap() != &eventData)
+        payload = nullptr;
+    context->SetEventPayload(nullptr);
 
-    if (nonSpecific)
+    if (handler)
     {
-        context->SetEventHandler(nonSpecific);
-        nonSpecific->Invoke(eventData);
+        context->SetEventHandler(handler);
+        if (payload)
+            payload->Invoke(handler);
+        else
+            handler->Invoke(eventData);
         context->SetEventHandler(nullptr);
     }
 }
@@ -296,6 +281,13 @@ void Object::SendEvent(StringHash eventType)
 }
 
 void Object::SendEvent(StringHash eventType, VariantMap& eventData)
+{
+    EventPayload payload(eventData);
+    SendEvent(eventType, payload);
+    payload.SyncVariantMap();
+}
+
+void Object::SendEvent(StringHash eventType, EventPayload& payload)
 {
     if (!Thread::IsMainThread())
     {
@@ -315,7 +307,14 @@ void Object::SendEvent(StringHash eventType, VariantMap& eventData)
     // Make a weak pointer to self to check for destruction during event handling
     WeakPtr<Object> self(this);
     Context* context = context_;
-    HashSet<Object*> processed;
+    // Specific receivers reached by this send are recorded above those of the outer sends
+    PODVector<Object*>& processed = context->processedEventReceivers_;
+    const unsigned processedStart = processed.Size();
+
+    // Typed parameters are converted for VariantMap handlers using the map of the current nesting level, which is not
+    // in use as the sender did not fill it
+    if (payload.IsTyped())
+        payload.SetConversionMap(&context->GetEventDataMap());
 
     context->BeginSendEvent(this, eventType);
 
@@ -334,17 +333,18 @@ void Object::SendEvent(StringHash eventType, VariantMap& eventData)
             if (!receiver)
                 continue;
 
-            receiver->OnEvent(this, eventType, eventData);
+            receiver->ReceiveEvent(this, eventType, payload);
 
             // If self has been destroyed as a result of event handling, exit
             if (self.Expired())
             {
                 group->EndSendEvent();
+                processed.Resize(processedStart);
                 context->EndSendEvent();
                 return;
             }
 
-            processed.Insert(receiver);
+            processed.Push(receiver);
         }
 
         group->EndSendEvent();
@@ -356,7 +356,7 @@ void Object::SendEvent(StringHash eventType, VariantMap& eventData)
     {
         group->BeginSendEvent();
 
-        if (processed.Empty())
+        if (processed.Size() == processedStart)
         {
             const unsigned numReceivers = group->receivers_.Size();
             for (unsigned i = 0; i < numReceivers; ++i)
@@ -365,7 +365,7 @@ void Object::SendEvent(StringHash eventType, VariantMap& eventData)
                 if (!receiver)
                     continue;
 
-                receiver->OnEvent(this, eventType, eventData);
+                receiver->ReceiveEvent(this, eventType, payload);
 
                 if (self.Expired())
                 {
@@ -377,19 +377,25 @@ void Object::SendEvent(StringHash eventType, VariantMap& eventData)
         }
         else
         {
-            // If there were specific receivers, check that the event is not sent doubly to them
+            // If there were specific receivers, check that the event is not sent doubly to them. Nested sends during
+            // the loop only use the vector above this range, but may reallocate it
+            const unsigned numProcessed = processed.Size() - processedStart;
+            std::sort(processed.Buffer() + processedStart, processed.Buffer() + processed.Size());
+
             const unsigned numReceivers = group->receivers_.Size();
             for (unsigned i = 0; i < numReceivers; ++i)
             {
                 Object* receiver = group->receivers_[i];
-                if (!receiver || processed.Contains(receiver))
+                Object** processedBegin = processed.Buffer() + processedStart;
+                if (!receiver || std::binary_search(processedBegin, processedBegin + numProcessed, receiver))
                     continue;
 
-                receiver->OnEvent(this, eventType, eventData);
+                receiver->ReceiveEvent(this, eventType, payload);
 
                 if (self.Expired())
                 {
                     group->EndSendEvent();
+                    processed.Resize(processedStart);
                     context->EndSendEvent();
                     return;
                 }
@@ -399,9 +405,60 @@ void Object::SendEvent(StringHash eventType, VariantMap& eventData)
         group->EndSendEvent();
     }
 
+    processed.Resize(processedStart);
     context->EndSendEvent();
 }
 
+void Object::ReceiveEvent(Object* sender, StringHash eventType, EventPayload& payload)
+{
+    // Events sent with a VariantMap go through the overridable handler. The default handler takes the payload from the
+    // context. If an override does not, it may have changed the map
+    if (!payload.IsTyped())
+    {
+        Context* context = context_;
+        payload.SyncVariantMap();
+        EventPayload* outerPayload = context->GetEventPayload();
+        context->SetEventPayload(&payload);
+        OnEvent(sender, eventType, *payload.GetVariantMap());
+        if (context->GetEventPayload() == &payload)
+            payload.MarkVariantMapChanged();
+        context->SetEventPayload(outerPayload);
+        return;
+    }
+
+    if (blockEvents_)
+        return;
+
+    Context* context = context_;
+    EventHandler* handler = SelectEventHandler(sender, eventType);
+    if (handler)
+    {
+        context->SetEventHandler(handler);
+        payload.Invoke(handler);
+        context->SetEventHandler(nullptr);
+    }
+}
+
+EventHandler* Object::SelectEventHandler(Object* sender, StringHash eventType) const
+{
+    EventHandler* nonSpecific = nullptr;
+
+    EventHandler* handler = eventHandlers_.First();
+    while (handler)
+    {
+        if (handler->GetEventType() == eventType)
+        {
+            if (!handler->GetSender())
+                nonSpecific = handler;
+            else if (handler->GetSender() == sender)
+                return handler;
+        }
+        handler = eventHandlers_.Next(handler);
+    }
+
+    return nonSpecific;
+}
+
 VariantMap& Object::GetEventDataMap() const
 {
     return context_->GetEventDataMap();
@@ -537,6 +594,45 @@ void Object::RemoveEventSender(Object* sender)
     }
 }
 
+void EventPayload::Invoke(EventHandler* handler)
+{
+    // Convert only when the other kind of handler was invoked last, as it may have changed the parameters. A map is
+    // converted to typed parameters on the first typed handler
+    if (handler->IsTyped())
+    {
+        if (!typedData_)
+            handler->CreateTypedData(*this);
+        else
+            SyncTypedData();
+        handler->InvokeTyped(typedData_);
+        typedChanged_ = true;
+    }
+    else
+    {
+        SyncVariantMap();
+        handler->Invoke(*eventData_);
+        mapChanged_ = true;
+    }
+}
+
+void EventPayload::SyncTypedData()
+{
+    if (mapChanged_ && typedData_)
+    {
+        fromVariantMap_(typedData_, *eventData_);
+        mapChanged_ = false;
+    }
+}
+
+void EventPayload::SyncVariantMap()
+{
+    if (typedChanged_)
+    {
+        toVariantMap_(typedData_, *eventData_);
+        typedChanged_ = false;
+    }
+}
+
 StringHashRegister& GetEventNameRegister()
 {
     static StringHashRegister eventNameRegister(false /*non thread safe*/);
@@ -34,6 +34,7 @@ namespace Urho3D
 
 class Context;
 class EventHandler;
+class EventPayload;
 class Engine;
 class Time;
 class WorkQueue;
@@ -169,6 +170,17 @@ public:
     {
         SendEvent(eventType, GetEventDataMap().Populate(args...));
     }
+    /// Send typed event to all subscribers. The event type is defined by the event data struct. Typed handlers receive
+    /// the struct directly without a VariantMap, other handlers receive it converted to a VariantMap.
+    template <class Data> auto SendEvent(Data& eventData) -> decltype(Data::GetEventTypeStatic(), void());
+    /// Subscribe to a typed event that can be sent by any sender. The event type is defined by the event data struct.
+    template <class T, class Data> void SubscribeToEvent(void (T::*function)(Data&), void* userData = nullptr);
+    /// Subscribe to a specific sender's typed event.
+    template <class T, class Data> void SubscribeToEvent(Object* sender, void (T::*function)(Data&), void* userData = nullptr);
+    /// Subscribe to a typed event that can be sent by any sender. The event data struct must be specified explicitly.
+    template <class Data> void SubscribeToEvent(const std::function<void(Data&)>& function, void* userData = nullptr);
+    /// Subscribe to a specific sender's typed event. The event data struct must be specified explicitly.
+    template <class Data> void SubscribeToEvent(Object* sender, const std::function<void(Data&)>& function, void* userData = nullptr);
 
     /// Return execution context.
     Context* GetContext() const { return context_; }
@@ -248,6 +260,12 @@ protected:
     Context* context_;
 
 private:
+    /// Send event with either VariantMap or typed parameters to all subscribers.
+    void SendEvent(StringHash eventType, EventPayload& payload);
+    /// Invoke the event handler matching a sender and event type.
+    void ReceiveEvent(Object* sender, StringHash eventType, EventPayload& payload);
+    /// Return the event handler to invoke for a sender and event type. Specific event handlers have priority.
+    EventHandler* SelectEventHandler(Object* sender, StringHash eventType) const;
     /// Find the first event handler with no specific sender.
     EventHandler* FindEventHandler(StringHash eventType, EventHandler** previous = nullptr) const;
     /// Find the first event handler with specific sender.
@@ -362,6 +380,12 @@ public:
 
     /// Invoke event handler function.
     virtual void Invoke(VariantMap& eventData) = 0;
+    /// Invoke event handler function with typed event data. Called only if IsTyped() returns true.
+    virtual void InvokeTyped(void* eventData) { }
+    /// Create the typed event data of an event sent with a VariantMap. Called only if IsTyped() returns true.
+    virtual void CreateTypedData(EventPayload& payload) const { }
+    /// Return whether the handler accepts typed event data.
+    virtual bool IsTyped() const { return false; }
     /// Return a unique copy of the event handler.
     virtual EventHandler* Clone() const = 0;
 
@@ -450,6 +474,256 @@ private:
     std::function<void(StringHash, VariantMap&)> function_;
 };
 
+/// Template implementation of the typed event handler invoke helper (stores a function pointer of specific class.)
+template <class T, class Data> class TypedEventHandlerImpl : public EventHandler
+{
+public:
+    using HandlerFunctionPtr = void (T::*)(Data&);
+
+    /// Construct with receiver and function pointers and userdata.
+    TypedEventHandlerImpl(T* receiver, HandlerFunctionPtr function, void* userData = nullptr) :
+        EventHandler(receiver, userData),
+        function_(function)
+    {
+        assert(receiver_);
+        assert(function_);
+    }
+
+    /// Invoke event handler function. Converts the parameters of an event sent with a VariantMap.
+    void Invoke(VariantMap& eventData) override
+    {
+        Data data;
+        data.FromVariantMap(eventData);
+        InvokeTyped(&data);
+        data.ToVariantMap(eventData);
+    }
+
+    /// Invoke event handler function with typed event data.
+    void InvokeTyped(void* eventData) override
+    {
+        auto* receiver = static_cast<T*>(receiver_);
+        (receiver->*function_)(*static_cast<Data*>(eventData));
+    }
+
+    /// Create the typed event data of an event sent with a VariantMap.
+    void CreateTypedData(EventPayload& payload) const override;
+
+    /// Return whether the handler accepts typed event data.
+    bool IsTyped() const override { return true; }
+
+    /// Return a unique copy of the event handler.
+    EventHandler* Clone() const override
+    {
+        return new TypedEventHandlerImpl(static_cast<T*>(receiver_), function_, userData_);
+    }
+
+private:
+    /// Class-specific pointer to handler function.
+    HandlerFunctionPtr function_;
+};
+
+/// Template implementation of the typed event handler invoke helper (std::function instance).
+template <class Data> class TypedEventHandler11Impl : public EventHandler
+{
+public:
+    /// Construct with function and userdata.
+    explicit TypedEventHandler11Impl(std::function<void(Data&)> function, void* userData = nullptr) :
+        EventHandler(nullptr, userData),
+        function_(std::move(function))
+    {
+        assert(function_);
+    }
+
+    /// Invoke event handler function. Converts the parameters of an event sent with a VariantMap.
+    void Invoke(VariantMap& eventData) override
+    {
+        Data data;
+        data.FromVariantMap(eventData);
+        function_(data);
+        data.ToVariantMap(eventData);
+    }
+
+    /// Invoke event handler function with typed event data.
+    void InvokeTyped(void* eventData) override
+    {
+        function_(*static_cast<Data*>(eventData));
+    }
+
+    /// Create the typed event data of an event sent with a VariantMap.
+    void CreateTypedData(EventPayload& payload) const override;
+
+    /// Return whether the handler accepts typed event data.
+    bool IsTyped() const override { return true; }
+
+    /// Return a unique copy of the event handler.
+    EventHandler* Clone() const override
+    {
+        return new TypedEventHandler11Impl(function_, userData_);
+    }
+
+private:
+    /// Handler function.
+    std::function<void(Data&)> function_;
+};
+
+/// Size of the storage for typed parameters converted from the VariantMap of an event. Larger structs are allocated.
+static const unsigned EVENT_PAYLOAD_STORAGE_SIZE = 64;
+
+/// Parameters of a single event send. Refers either to a VariantMap or to a typed event data struct. Typed data is
+/// converted to a VariantMap only for handlers which do not accept it directly, such as script handlers, and only when
+/// a typed handler may have changed it since the last conversion. An event sent with a VariantMap is likewise converted
+/// to typed data once for all typed handlers.
+class URHO3D_API EventPayload
+{
+public:
+    /// Construct with VariantMap parameters.
+    explicit EventPayload(VariantMap& eventData) :
+        eventData_(&eventData),
+        typedData_(nullptr),
+        toVariantMap_(nullptr),
+        fromVariantMap_(nullptr),
+        destroyTypedData_(nullptr),
+        sentTyped_(false),
+        typedChanged_(false),
+        mapChanged_(false)
+    {
+    }
+
+    /// Construct with typed parameters.
+    template <class Data> explicit EventPayload(Data& typedData) :
+        eventData_(nullptr),
+        typedData_(&typedData),
+        toVariantMap_(&ToVariantMap<Data>),
+        fromVariantMap_(&FromVariantMap<Data>),
+        destroyTypedData_(nullptr),
+        sentTyped_(true),
+        typedChanged_(true),
+        mapChanged_(false)
+    {
+    }
+
+    /// Destruct. Destroy typed parameters converted from the VariantMap.
+    ~EventPayload()
+    {
+        if (destroyTypedData_)
+            destroyTypedData_(typedData_, typedData_ == typedStorage_);
+    }
+
+    /// Prevent copy construction.
+    EventPayload(const EventPayload& rhs) = delete;
+    /// Prevent assignment.
+    EventPayload& operator =(const EventPayload& rhs) = delete;
+
+    /// Set the map which typed parameters are converted to.
+    void SetConversionMap(VariantMap* eventData) { eventData_ = eventData; }
+    /// Create typed parameters converted from the VariantMap. Called by typed event handlers.
+    template <class Data> void CreateTypedData();
+    /// Invoke an event handler with the parameters.
+    void Invoke(EventHandler* handler);
+    /// Copy changes made by VariantMap handlers back to the typed parameters. Called after the send.
+    void SyncTypedData();
+    /// Copy changes made by typed handlers to the VariantMap. Called after the send and before handlers which are not
+    /// invoked through the payload.
+    void SyncVariantMap();
+    /// Mark the VariantMap changed by a handler which was not invoked through the payload.
+    void MarkVariantMapChanged() { mapChanged_ = true; }
+
+    /// Return whether was sent with typed parameters.
+    bool IsTyped() const { return sentTyped_; }
+    /// Return the VariantMap parameters. Null for typed parameters until the conversion map is set.
+    VariantMap* GetVariantMap() const { return eventData_; }
+
+private:
+    /// Destroy typed parameters converted from the VariantMap.
+    template <class Data> static void DestroyTypedData(void* typedData, bool inStorage)
+    {
+        if (inStorage)
+            static_cast<Data*>(typedData)->~Data();
+        else
+            delete static_cast<Data*>(typedData);
+    }
+
+    /// Convert typed parameters to a VariantMap.
+    template <class Data> static void ToVariantMap(const void* typedData, VariantMap& eventData)
+    {
+        static_cast<const Data*>(typedData)->ToVariantMap(eventData);
+    }
+
+    /// Convert typed parameters from a VariantMap.
+    template <class Data> static void FromVariantMap(void* typedData, const VariantMap& eventData)
+    {
+        static_cast<Data*>(typedData)->FromVariantMap(eventData);
+    }
+
+    /// VariantMap parameters, or the map typed parameters are converted to.
+    VariantMap* eventData_;
+    /// Typed parameters.
+    void* typedData_;
+    /// Typed parameter conversion to a VariantMap.
+    void (*toVariantMap_)(const void*, VariantMap&);
+    /// Typed parameter conversion from a VariantMap.
+    void (*fromVariantMap_)(void*, const VariantMap&);
+    /// Destruction of typed parameters converted from the VariantMap, null if the sender owns them.
+    void (*destroyTypedData_)(void*, bool);
+    /// Whether was sent with typed parameters.
+    bool sentTyped_;
+    /// Whether the typed parameters may have changed since the last conversion.
+    bool typedChanged_;
+    /// Whether the converted parameters may have changed since the last conversion.
+    bool mapChanged_;
+    /// Storage for typed parameters converted from the VariantMap.
+    alignas(16) unsigned char typedStorage_[EVENT_PAYLOAD_STORAGE_SIZE];
+};
+
+template <class Data> void EventPayload::CreateTypedData()
+{
+    Data* data = sizeof(Data) <= EVENT_PAYLOAD_STORAGE_SIZE && alignof(Data) <= 16 ? new(typedStorage_) Data() : new Data();
+    data->FromVariantMap(*eventData_);
+    typedData_ = data;
+    toVariantMap_ = &ToVariantMap<Data>;
+    fromVariantMap_ = &FromVariantMap<Data>;
+    destroyTypedData_ = &DestroyTypedData<Data>;
+    typedChanged_ = false;
+    mapChanged_ = false;
+}
+
+template <class T, class Data> void TypedEventHandlerImpl<T, Data>::CreateTypedData(EventPayload& payload) const
+{
+    payload.CreateTypedData<Data>();
+}
+
+template <class Data> void TypedEventHandler11Impl<Data>::CreateTypedData(EventPayload& payload) const
+{
+    payload.CreateTypedData<Data>();
+}
+
+template <class Data> auto Object::SendEvent(Data& eventData) -> decltype(Data::GetEventTypeStatic(), void())
+{
+    EventPayload payload(eventData);
+    SendEvent(Data::GetEventTypeStatic(), payload);
+    payload.SyncTypedData();
+}
+
+template <class T, class Data> void Object::SubscribeToEvent(void (T::*function)(Data&), void* userData)
+{
+    SubscribeToEvent(Data::GetEventTypeStatic(), new TypedEventHandlerImpl<T, Data>(static_cast<T*>(this), function, userData));
+}
+
+template <class T, class Data> void Object::SubscribeToEvent(Object* sender, void (T::*function)(Data&), void* userData)
+{
+    SubscribeToEvent(sender, Data::GetEventTypeStatic(), new TypedEventHandlerImpl<T, Data>(static_cast<T*>(this), function, userData));
+}
+
+template <class Data> void Object::SubscribeToEvent(const std::function<void(Data&)>& function, void* userData)
+{
+    SubscribeToEvent(Data::GetEventTypeStatic(), new TypedEventHandler11Impl<Data>(function, userData));
+}
+
+template <class Data> void Object::SubscribeToEvent(Object* sender, const std::function<void(Data&)>& function, void* userData)
+{
+    SubscribeToEvent(sender, Data::GetEventTypeStatic(), new TypedEventHandler11Impl<Data>(function, userData));
+}
+
 /// Get register of event names.
 URHO3D_API StringHashRegister& GetEventNameRegister();
 
@@ -461,6 +735,10 @@ URHO3D_API StringHashRegister& GetEventNameRegister();
 #define URHO3D_HANDLER(className, function) (new Urho3D::EventHandlerImpl<className>(this, &className::function))
 /// Convenience macro to construct an EventHandler that points to a receiver object and its member function, and also defines a userdata pointer.
 #define URHO3D_HANDLER_USERDATA(className, function, userData) (new Urho3D::EventHandlerImpl<className>(this, &className::function, userData))
+/// Declare the event type of a typed event data struct. Should be used inside the struct, which must also define
+/// ToVariantMap() and FromVariantMap() functions that convert it to and from the event's VariantMap parameters. Each
+/// event may have only one data struct.
+#define URHO3D_EVENT_DATA(eventID) static Urho3D::StringHash GetEventTypeStatic() { return eventID; }
 
 // Explicit template specializations for most commonly used engine subsystems. They sidestep HashMap lookup and return
 // subsystem pointer cached in Context object.
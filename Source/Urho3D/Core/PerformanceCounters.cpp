@@ -0,0 +1,370 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Core/Context.h"
+#include "../Core/CoreEvents.h"
+#include "../Core/PerformanceCounters.h"
+#include "../Core/StringUtils.h"
+#include "../Core/Timer.h"
+#include "../Graphics/Graphics.h"
+#include "../Graphics/Renderer.h"
+#include "../IO/File.h"
+#include "../IO/FileSystem.h"
+#include "../IO/Log.h"
+#include "../Resource/JSONFile.h"
+
+#include <cfloat>
+#include <cstdio>
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+static const char* counterTypeNames[] =
+{
+    "counter",
+    "gauge",
+    "histogram"
+};
+
+PerformanceCounter::PerformanceCounter(const String& name, PerformanceCounterType type, float bucketSize, unsigned numBuckets) :
+    name_(name),
+    type_(type),
+    frameCount_(0),
+    gaugeValue_(0.0),
+    bucketSize_(type == PCT_HISTOGRAM ? Max(bucketSize, M_EPSILON) : 0.0f),
+    last_(0.0),
+    sum_(0.0),
+    min_(DBL_MAX),
+    max_(-DBL_MAX),
+    numSamples_(0)
+{
+    if (type_ == PCT_HISTOGRAM)
+    {
+        buckets_.Resize(Max(numBuckets, 1U));
+        for (unsigned i = 0; i < buckets_.Size(); ++i)
+            buckets_[i] = 0;
+    }
+}
+
+void PerformanceCounter::Record(double value)
+{
+    MutexLock lock(mutex_);
+
+    AddSample(value);
+    if (!buckets_.Empty())
+    {
+        auto index = (unsigned)Clamp(value / bucketSize_, 0.0, (double)(buckets_.Size() - 1));
+        ++buckets_[index];
+    }
+}
+
+void PerformanceCounter::Reset()
+{
+    MutexLock lock(mutex_);
+
+    frameCount_.store(0, std::memory_order_relaxed);
+    last_ = 0.0;
+    sum_ = 0.0;
+    min_ = DBL_MAX;
+    max_ = -DBL_MAX;
+    numSamples_ = 0;
+    for (unsigned i = 0; i < buckets_.Size(); ++i)
+        buckets_[i] = 0;
+}
+
+double PerformanceCounter::GetLastValue() const
+{
+    MutexLock lock(mutex_);
+    return last_;
+}
+
+double PerformanceCounter::GetTotal() const
+{
+    MutexLock lock(mutex_);
+    return sum_;
+}
+
+unsigned long long PerformanceCounter::GetNumSamples() const
+{
+    MutexLock lock(mutex_);
+    return numSamples_;
+}
+
+double PerformanceCounter::GetMin() const
+{
+    MutexLock lock(mutex_);
+    return numSamples_ ? min_ : 0.0;
+}
+
+double PerformanceCounter::GetMax() const
+{
+    MutexLock lock(mutex_);
+    return numSamples_ ? max_ : 0.0;
+}
+
+double PerformanceCounter::GetMean() const
+{
+    MutexLock lock(mutex_);
+    return numSamples_ ? sum_ / numSamples_ : 0.0;
+}
+
+double PerformanceCounter::GetPercentile(float percentile) const
+{
+    MutexLock lock(mutex_);
+
+    if (buckets_.Empty() || !numSamples_)
+        return 0.0;
+
+    double target = Clamp(percentile, 0.0f, 100.0f) * 0.01 * numSamples_;
+    unsigned long long accumulated = 0;
+    for (unsigned i = 0; i < buckets_.Size(); ++i)
+    {
+        if (!buckets_[i] || accumulated + buckets_[i] < target)
+        {
+            accumulated += buckets_[i];
+            continue;
+        }
+
+        // Interpolate inside the bucket, assuming evenly distributed samples
+        double fraction = (target - accumulated) / buckets_[i];
+        double value = (i + fraction) * bucketSize_;
+        return Clamp(value, min_, max_);
+    }
+
+    return max_;
+}
+
+unsigned long long PerformanceCounter::GetBucketCount(unsigned index) const
+{
+    MutexLock lock(mutex_);
+    return index < buckets_.Size() ? buckets_[index] : 0;
+}
+
+void PerformanceCounter::AddSample(double value)
+{
+    last_ = value;
+    sum_ += value;
+    min_ = Min(min_, value);
+    max_ = Max(max_, value);
+    ++numSamples_;
+}
+
+void PerformanceCounter::EndFrame()
+{
+    if (type_ == PCT_HISTOGRAM)
+        return;
+
+    double value = type_ == PCT_COUNTER ? (double)frameCount_.exchange(0, std::memory_order_relaxed) :
+        gaugeValue_.load(std::memory_order_relaxed);
+
+    MutexLock lock(mutex_);
+    AddSample(value);
+}
+
+PerformanceCounters::PerformanceCounters(Context* context) :
+    Object(context),
+    lastNumSentEvents_(context->GetNumSentEvents())
+{
+    frameTime_ = GetHistogram("FrameTime", FRAME_TIME_BUCKET_SIZE, FRAME_TIME_NUM_BUCKETS);
+    events_ = GetCounter("Events");
+    batches_ = GetCounter("Batches", PCT_GAUGE);
+    drawCalls_ = GetCounter("DrawCalls", PCT_GAUGE);
+    primitives_ = GetCounter("Primitives", PCT_GAUGE);
+
+    SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(PerformanceCounters, HandleEndFrame));
+}
+
+PerformanceCounters::~PerformanceCounters()
+{
+    for (unsigned i = 0; i < counters_.Size(); ++i)
+        delete counters_[i];
+}
+
+PerformanceCounter* PerformanceCounters::GetCounter(const String& name, PerformanceCounterType type)
+{
+    return GetOrCreate(name, type, 0.0f, 0);
+}
+
+PerformanceCounter* PerformanceCounters::GetHistogram(const String& name, float bucketSize, unsigned numBuckets)
+{
+    return GetOrCreate(name, PCT_HISTOGRAM, bucketSize, numBuckets);
+}
+
+PerformanceCounter* PerformanceCounters::FindCounter(const String& name) const
+{
+    MutexLock lock(mutex_);
+
+    PerformanceCounter* counter = nullptr;
+    countersByName_.TryGetValue(StringHash(name), counter);
+    return counter;
+}
+
+unsigned PerformanceCounters::GetNumCounters() const
+{
+    MutexLock lock(mutex_);
+    return counters_.Size();
+}
+
+PerformanceCounter* PerformanceCounters::GetCounter(unsigned index) const
+{
+    MutexLock lock(mutex_);
+    return index < counters_.Size() ? counters_[index] : nullptr;
+}
+
+void PerformanceCounters::EndFrame()
+{
+    unsigned long long numSentEvents = context_->GetNumSentEvents();
+    events_->Increment(numSentEvents - lastNumSentEvents_);
+    lastNumSentEvents_ = numSentEvents;
+
+    if (auto* renderer = GetSubsystem<Renderer>())
+        batches_->Set(renderer->GetNumBatches());
+    if (auto* graphics = GetSubsystem<Graphics>())
+    {
+        drawCalls_->Set(graphics->GetNumBatches());
+        primitives_->Set(graphics->GetNumPrimitives());
+    }
+
+    MutexLock lock(mutex_);
+    for (unsigned i = 0; i < counters_.Size(); ++i)
+        counters_[i]->EndFrame();
+}
+
+void PerformanceCounters::Reset()
+{
+    MutexLock lock(mutex_);
+    for (unsigned i = 0; i < counters_.Size(); ++i)
+        counters_[i]->Reset();
+}
+
+String PerformanceCounters::ToCSV() const
+{
+    MutexLock lock(mutex_);
+
+    String ret = "Name,Type,Samples,Last,Total,Min,Max,Mean,P50,P95,P99\n";
+    for (unsigned i = 0; i < counters_.Size(); ++i)
+    {
+        const PerformanceCounter* counter = counters_[i];
+        char line[CONVERSION_BUFFER_LENGTH * 8];
+        snprintf(line, sizeof(line), "%s,%s,%llu,%g,%g,%g,%g,%g,%g,%g,%g\n", counter->GetName().CString(),
+            counterTypeNames[counter->GetType()], counter->GetNumSamples(), counter->GetLastValue(), counter->GetTotal(),
+            counter->GetMin(), counter->GetMax(), counter->GetMean(), counter->GetPercentile(50.0f),
+            counter->GetPercentile(95.0f), counter->GetPercentile(99.0f));
+        ret.Append(line);
+    }
+
+    return ret;
+}
+
+void PerformanceCounters::ToJSON(JSONValue& dest) const
+{
+    MutexLock lock(mutex_);
+
+    dest = JSONValue(JSON_ARRAY);
+    for (unsigned i = 0; i < counters_.Size(); ++i)
+    {
+        const PerformanceCounter* counter = counters_[i];
+
+        JSONValue counterValue(JSON_OBJECT);
+        counterValue.Set("name", counter->GetName());
+        counterValue.Set("type", counterTypeNames[counter->GetType()]);
+        counterValue.Set("samples", (double)counter->GetNumSamples());
+        counterValue.Set("last", counter->GetLastValue());
+        counterValue.Set("total", counter->GetTotal());
+        counterValue.Set("min", counter->GetMin());
+        counterValue.Set("max", counter->GetMax());
+        counterValue.Set("mean", counter->GetMean());
+
+        if (counter->GetType() == PCT_HISTOGRAM)
+        {
+            counterValue.Set("p50", counter->GetPercentile(50.0f));
+            counterValue.Set("p95", counter->GetPercentile(95.0f));
+            counterValue.Set("p99", counter->GetPercentile(99.0f));
+            counterValue.Set("bucketSize", counter->GetBucketSize());
+
+            JSONValue buckets(JSON_ARRAY);
+            for (unsigned j = 0; j < counter->GetNumBuckets(); ++j)
+                buckets.Push((double)counter->GetBucketCount(j));
+            counterValue.Set("buckets", buckets);
+        }
+
+        dest.Push(counterValue);
+    }
+}
+
+bool PerformanceCounters::Save(const String& fileName) const
+{
+    File file(context_);
+    if (!file.Open(fileName, FILE_WRITE))
+    {
+        URHO3D_LOGERROR("Could not open performance counter file " + fileName);
+        return false;
+    }
+
+    if (GetExtension(fileName) == ".json")
+    {
+        JSONFile json(context_);
+        ToJSON(json.GetRoot());
+        return json.Save(file);
+    }
+    else
+    {
+        String csv = ToCSV();
+        return file.Write(csv.CString(), csv.Length()) == csv.Length();
+    }
+}
+
+PerformanceCounter* PerformanceCounters::GetOrCreate(const String& name, PerformanceCounterType type, float bucketSize,
+    unsigned numBuckets)
+{
+    MutexLock lock(mutex_);
+
+    StringHash nameHash(name);
+    PerformanceCounter* counter = nullptr;
+    if (countersByName_.TryGetValue(nameHash, counter))
+    {
+        if (counter->GetType() != type)
+            URHO3D_LOGWARNING("Performance counter " + name + " already exists with a different type");
+        return counter;
+    }
+
+    counter = new PerformanceCounter(name, type, bucketSize, numBuckets);
+    counters_.Push(counter);
+    countersByName_.Insert(MakePair(nameHash, counter));
+    return counter;
+}
+
+void PerformanceCounters::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+    // Frame time is the timestep, which includes waiting for the frame limiter
+    if (auto* time = GetSubsystem<Time>())
+        frameTime_->Record(time->GetTimeStep() * 1000.0);
+
+    EndFrame();
+}
+
+}
@@ -0,0 +1,192 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/FlatHashMap.h"
+#include "../Core/Mutex.h"
+#include "../Core/Object.h"
+
+#include <atomic>
+
+namespace Urho3D
+{
+
+class JSONValue;
+
+/// Performance counter kind.
+enum PerformanceCounterType
+{
+    /// Number of occurrences per frame, such as sent events.
+    PCT_COUNTER = 0,
+    /// Value sampled once per frame, such as the number of batches.
+    PCT_GAUGE,
+    /// Distribution of recorded values, such as the frame time.
+    PCT_HISTOGRAM
+};
+
+/// Frame time histogram bucket size in milliseconds.
+static const float FRAME_TIME_BUCKET_SIZE = 1.0f;
+/// Number of frame time histogram buckets. The last bucket holds all longer frames.
+static const unsigned FRAME_TIME_NUM_BUCKETS = 100;
+
+/// Named performance counter. Counters and gauges are sampled once per frame, so their statistics describe the
+/// per-frame values. Histograms are sampled whenever a value is recorded. Updating is thread-safe; incrementing a
+/// counter and setting a gauge are lock-free.
+class URHO3D_API PerformanceCounter
+{
+public:
+    /// Construct. Bucket size and count are used only by histograms.
+    PerformanceCounter(const String& name, PerformanceCounterType type, float bucketSize = 0.0f, unsigned numBuckets = 0);
+
+    /// Add to the count of the current frame.
+    void Increment(unsigned long long amount = 1) { frameCount_.fetch_add(amount, std::memory_order_relaxed); }
+    /// Set the gauge value. It is sampled at the end of the frame.
+    void Set(double value) { gaugeValue_.store(value, std::memory_order_relaxed); }
+    /// Record a histogram value.
+    void Record(double value);
+    /// Clear statistics.
+    void Reset();
+
+    /// Return name.
+    const String& GetName() const { return name_; }
+    /// Return kind.
+    PerformanceCounterType GetType() const { return type_; }
+    /// Return the last sample: count of the last frame, gauge value of the last frame or last recorded value.
+    double GetLastValue() const;
+    /// Return sum of all samples. For a counter this is the total count.
+    double GetTotal() const;
+    /// Return number of samples.
+    unsigned long long GetNumSamples() const;
+    /// Return smallest sample.
+    double GetMin() const;
+    /// Return largest sample.
+    double GetMax() const;
+    /// Return mean of the samples.
+    double GetMean() const;
+    /// Return approximate percentile (0-100) of a histogram, interpolated within a bucket. Zero for other kinds.
+    double GetPercentile(float percentile) const;
+    /// Return histogram bucket size.
+    float GetBucketSize() const { return bucketSize_; }
+    /// Return number of histogram buckets.
+    unsigned GetNumBuckets() const { return buckets_.Size(); }
+    /// Return number of samples in a histogram bucket.
+    unsigned long long GetBucketCount(unsigned index) const;
+
+private:
+    /// Add a sample to the statistics. Mutex must be held.
+    void AddSample(double value);
+    /// Sample counter or gauge at the end of a frame.
+    void EndFrame();
+
+    /// Name.
+    String name_;
+    /// Kind.
+    PerformanceCounterType type_;
+    /// Count of the current frame.
+    std::atomic<unsigned long long> frameCount_;
+    /// Gauge value.
+    std::atomic<double> gaugeValue_;
+    /// Histogram bucket size.
+    float bucketSize_;
+    /// Histogram buckets.
+    PODVector<unsigned long long> buckets_;
+    /// Last sample.
+    double last_;
+    /// Sum of samples.
+    double sum_;
+    /// Smallest sample.
+    double min_;
+    /// Largest sample.
+    double max_;
+    /// Number of samples.
+    unsigned long long numSamples_;
+    /// Statistics mutex.
+    mutable Mutex mutex_;
+
+    friend class PerformanceCounters;
+};
+
+/// %Performance counter registry subsystem. Always available, independent of the profiler. Counters are sampled on
+/// the frame end event; the engine updates built-in counters for frame time, events, batches, draw calls,
+/// primitives and visible and culled drawables.
+class URHO3D_API PerformanceCounters : public Object
+{
+    URHO3D_OBJECT(PerformanceCounters, Object);
+
+public:
+    /// Construct.
+    explicit PerformanceCounters(Context* context);
+    /// Destruct.
+    ~PerformanceCounters() override;
+
+    /// Return a counter or gauge, creating it if it does not exist. The pointer stays valid as long as the subsystem.
+    PerformanceCounter* GetCounter(const String& name, PerformanceCounterType type = PCT_COUNTER);
+    /// Return a histogram, creating it if it does not exist. The pointer stays valid as long as the subsystem.
+    PerformanceCounter* GetHistogram(const String& name, float bucketSize, unsigned numBuckets);
+    /// Return a counter by name, or null if it does not exist.
+    PerformanceCounter* FindCounter(const String& name) const;
+    /// Return number of counters.
+    unsigned GetNumCounters() const;
+    /// Return counter by index in creation order.
+    PerformanceCounter* GetCounter(unsigned index) const;
+
+    /// Sample counters and gauges. Called automatically at the end of each frame.
+    void EndFrame();
+    /// Clear statistics of all counters.
+    void Reset();
+
+    /// Return statistics of all counters as CSV, one counter per line.
+    String ToCSV() const;
+    /// Write statistics of all counters to a JSON array.
+    void ToJSON(JSONValue& dest) const;
+    /// Save statistics of all counters to a file. Written as JSON if the extension is .json, otherwise as CSV.
+    bool Save(const String& fileName) const;
+
+private:
+    /// Return a counter, creating it if it does not exist.
+    PerformanceCounter* GetOrCreate(const String& name, PerformanceCounterType type, float bucketSize, unsigned numBuckets);
+    /// Handle frame end event.
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+
+    /// Counters in creation order.
+    PODVector<PerformanceCounter*> counters_;
+    /// Counters by name hash.
+    FlatHashMap<StringHash, PerformanceCounter*> countersByName_;
+    /// Registry mutex.
+    mutable Mutex mutex_;
+    /// Frame time histogram.
+    PerformanceCounter* frameTime_;
+    /// Sent events counter.
+    PerformanceCounter* events_;
+    /// Renderer batches gauge.
+    PerformanceCounter* batches_;
+    /// Graphics draw calls gauge.
+    PerformanceCounter* drawCalls_;
+    /// Graphics primitives gauge.
+    PerformanceCounter* primitives_;
+    /// Number of sent events at the end of the previous frame.
+    unsigned long long lastNumSentEvents_;
+};
+
+}
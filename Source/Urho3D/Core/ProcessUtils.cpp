@@ -207,6 +207,8 @@ void ErrorExit(const String& message, int exitCode)
     if (!message.Empty())
         PrintLine(message, true);
 
+    // Make sure the errors logged before exiting are written out
+    Log::FlushPending();
     exit(exitCode);
 }
 
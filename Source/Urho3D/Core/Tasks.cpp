@@ -24,7 +24,8 @@
 #include "../Core/Context.h"
 #include "../Core/CoreEvents.h"
 #include "../Core/Tasks.h"
-#include "Tasks.h"
+#include "../Core/WorkQueue.h"
+#include "../Resource/Resource.h"
 
 
 #if URHO3D_TASKS
@@ -104,7 +105,7 @@ void Task::ExecuteTask()
 
 void* Task::SwitchTo(void* data)
 {
-    if (threadID_ != Thread::GetCurrentThreadID())
+    if (!threaded_ && threadID_ != Thread::GetCurrentThreadID())
     {
         URHO3D_LOGERROR("Task must be scheduled on the same thread where it was created.");
         return nullptr;
@@ -120,7 +121,9 @@ void* Task::SwitchTo(void* data)
 }
 
 TaskScheduler::TaskScheduler(Context* context)
-    : Object(context)
+    : Object(context),
+    timerWheel_(TASK_TIMER_WHEEL_SIZE),
+    lastTime_(Time::GetSystemTime())
 {
 }
 
@@ -138,49 +141,129 @@ SharedPtr<Task> TaskScheduler::Create(const std::function<void()>& taskFunction,
 
 void TaskScheduler::Add(Task* task)
 {
-    tasks_.Push(SharedPtr<Task>(task));
+    SharedPtr<Task> taskPtr(task);
+    Schedule(taskPtr, lastTime_);
 }
 
-void TaskScheduler::ExecuteTasks()
+void TaskScheduler::Schedule(SharedPtr<Task>& task, unsigned now)
 {
-    // Tasks with smallest next runtime value end up at the beginning of the list. Null pointers end up at the end of
-    // the list.
-    Sort(tasks_.Begin(), tasks_.End(), [](SharedPtr<Task>& a, SharedPtr<Task>& b) {
-        if (a.Null())
-            return false;
-        if (b.Null())
-            return true;
-        return a->nextRunTime_ < b->nextRunTime_;
-    });
-    // Count null pointers at the end and discard them.
-    unsigned newSize = tasks_.Size();
-    for (auto it = tasks_.End(); it != tasks_.Begin();)
+    if (task->state_ == TSTATE_FINISHED)
+        return;
+
+    if (task->waitCondition_)
     {
-        if (!(*--it))
-            newSize--;
-        else
-            break;
+        // Reference the object of the wait condition here in the main thread, not in the suspending task
+        task->waitObjectRef_ = task->waitObject_;
+        waitingTasks_.Push(std::move(task));
+    }
+    else if (task->nextRunTime_ > now)
+    {
+        timerWheel_[task->nextRunTime_ & (TASK_TIMER_WHEEL_SIZE - 1)].Push(std::move(task));
+        ++numSleeping_;
+    }
+    else
+        readyTasks_.Push(std::move(task));
+}
+
+void TaskScheduler::AdvanceTimers(unsigned now)
+{
+    // Visit only the slots of the elapsed milliseconds. Tasks sleeping for longer than one wheel revolution stay in
+    // their slot until the wheel comes around again
+    if (numSleeping_ && now > lastTime_)
+    {
+        unsigned numSlots = Min(now - lastTime_, TASK_TIMER_WHEEL_SIZE);
+        for (unsigned i = 1; i <= numSlots; ++i)
+        {
+            Vector<SharedPtr<Task> >& slot = timerWheel_[(lastTime_ + i) & (TASK_TIMER_WHEEL_SIZE - 1)];
+            for (unsigned j = 0; j < slot.Size();)
+            {
+                if (slot[j]->nextRunTime_ <= now)
+                {
+                    readyTasks_.Push(std::move(slot[j]));
+                    Swap(slot[j], slot.Back());
+                    slot.Pop();
+                    --numSleeping_;
+                }
+                else
+                    ++j;
+            }
+        }
     }
-    tasks_.Resize(newSize);
-    // Schedule sorted tasks.
-    for (auto it = tasks_.Begin(); it != tasks_.End(); it++)
+
+    lastTime_ = Max(lastTime_, now);
+}
+
+void TaskScheduler::CheckWaitConditions()
+{
+    for (unsigned i = 0; i < waitingTasks_.Size();)
     {
-        Task* task = *it;
+        Task* task = waitingTasks_[i];
+        if (task->IsTerminating() || task->waitCondition_())
+        {
+            task->waitCondition_ = nullptr;
+            task->waitObject_ = nullptr;
+            task->waitObjectRef_.Reset();
+            readyTasks_.Push(std::move(waitingTasks_[i]));
+            Swap(waitingTasks_[i], waitingTasks_.Back());
+            waitingTasks_.Pop();
+        }
+        else
+            ++i;
+    }
+}
+
+void TaskScheduler::ExecuteTasks()
+{
+    unsigned now = Time::GetSystemTime();
+    AdvanceTimers(now);
+    CheckWaitConditions();
 
-        // Any further pointers will be to objects that are not ready therefore early exit is ok.
-        if (!task->IsReady())
-            break;
+    // Tasks added by Add() or woken up may still have a pending sleep
+    Swap(executingTasks_, readyTasks_);
+    for (unsigned i = 0; i < executingTasks_.Size();)
+    {
+        if (executingTasks_[i]->nextRunTime_ > now)
+        {
+            Schedule(executingTasks_[i], now);
+            Swap(executingTasks_[i], executingTasks_.Back());
+            executingTasks_.Pop();
+        }
+        else
+            ++i;
+    }
 
-        task->SwitchTo();
+    numExecuted_ = executingTasks_.Size();
 
-        if (task->state_ == TSTATE_FINISHED)
-            *it = nullptr;
+    auto* queue = GetSubsystem<WorkQueue>();
+    if (threaded_ && queue && queue->GetNumThreads())
+    {
+        for (unsigned i = 0; i < executingTasks_.Size(); ++i)
+            executingTasks_[i]->threaded_ = true;
+
+        // Resume tasks on all threads. Shared pointers are not touched here as their reference counts are not atomic
+        queue->ParallelFor(executingTasks_.Size(), 16, [this](unsigned begin, unsigned end, unsigned threadIndex)
+        {
+            for (unsigned i = begin; i < end; ++i)
+                executingTasks_[i]->SwitchTo();
+        });
+    }
+    else
+    {
+        for (unsigned i = 0; i < executingTasks_.Size(); ++i)
+        {
+            executingTasks_[i]->threaded_ = false;
+            executingTasks_[i]->SwitchTo();
+        }
     }
+
+    for (unsigned i = 0; i < executingTasks_.Size(); ++i)
+        Schedule(executingTasks_[i], now);
+    executingTasks_.Clear();
 }
 
 unsigned TaskScheduler::GetActiveTaskCount() const
 {
-    return tasks_.Size();
+    return readyTasks_.Size() + waitingTasks_.Size() + numSleeping_;
 }
 
 void TaskScheduler::ExecuteAllTasks()
@@ -209,7 +292,51 @@ void* SuspendTask(float time, void* data)
 #endif
 
     currentTask->SetSleep(time);
-    return sc_yield(data);
+    // Tasks of a threaded scheduler may be resumed by a different thread than the one they were created on, therefore
+    // they return to the main context of the current thread instead of the parent context
+    if (currentTask->IsThreaded())
+        return sc_switch(sc_main_context(), data);
+    else
+        return sc_yield(data);
+}
+
+/// Suspend execution of current task until the condition returns true. The object the condition depends on is passed
+/// as a raw pointer, so that the task does not modify its reference count on a worker thread.
+static void SuspendTaskUntil(const std::function<bool()>& condition, RefCounted* object)
+{
+    auto context = sc_current_context();
+    if (context == sc_main_context())
+    {
+        URHO3D_LOGERROR("Main task of current thread can not be suspended.");
+        return;
+    }
+    auto* currentTask = ((Task*)sc_get_data(context));
+
+    if (!condition())
+    {
+        currentTask->SetWaitCondition(condition, object);
+        SuspendTask();
+    }
+}
+
+void SuspendTaskUntil(const std::function<bool()>& condition)
+{
+    SuspendTaskUntil(condition, nullptr);
+}
+
+void WaitForWorkItem(WorkItem* item)
+{
+    SuspendTaskUntil([item]() { return item->completed_.load(); }, item);
+}
+
+void WaitForJobs(const JobCounter& counter)
+{
+    SuspendTaskUntil([&counter]() { return counter.IsDone(); });
+}
+
+void WaitForResource(Resource* resource)
+{
+    SuspendTaskUntil([resource]() { return resource->GetAsyncLoadState() == ASYNC_DONE; }, resource);
 }
 
 void* SuspendTask(Task* nextTask, float time, void* data)
@@ -267,16 +394,19 @@ void Tasks::Add(StringHash eventType, Task* task)
         return;
     }
 
+    GetScheduler(eventType)->Add(task);
+}
+
+TaskScheduler* Tasks::GetScheduler(StringHash eventType)
+{
     auto it = taskSchedulers_.Find(eventType);
-    TaskScheduler* scheduler = nullptr;
-    if (it == taskSchedulers_.End())
-    {
-        taskSchedulers_[eventType] = scheduler = new TaskScheduler(context_);
-        SubscribeToEvent(eventType, [&](StringHash eventType_, VariantMap&) { ExecuteTasks(eventType_); });
-    }
-    else
-        scheduler = it->second_;
-    scheduler->Add(task);
+    if (it != taskSchedulers_.End())
+        return it->second_;
+
+    auto* scheduler = new TaskScheduler(context_);
+    taskSchedulers_[eventType] = scheduler;
+    SubscribeToEvent(eventType, [&](StringHash eventType_, VariantMap&) { ExecuteTasks(eventType_); });
+    return scheduler;
 }
 
 void Tasks::ExecuteTasks(StringHash eventType)
@@ -34,8 +34,11 @@
 namespace Urho3D
 {
 
+class JobCounter;
+class Resource;
 class TaskScheduler;
 class Tasks;
+struct WorkItem;
 
 enum TaskState
 {
@@ -51,6 +54,8 @@ enum TaskState
 
 /// Default task size.
 static const unsigned DEFAULT_TASK_SIZE = 1024 * 64;
+/// Number of timer wheel slots of a task scheduler. Each slot covers one millisecond. Must be a power of two.
+static const unsigned TASK_TIMER_WHEEL_SIZE = 1024;
 
 /// Object representing a single cooperative t
 class URHO3D_API Task : public Object
@@ -77,16 +82,25 @@ public:
     inline bool IsAlive() const { return state_ != TSTATE_FINISHED; };
     /// Return true if task is supposed to terminate shortly.
     inline bool IsTerminating() const { return state_ == TSTATE_TERMINATE; };
-    /// Return true if task is ready, false if task is still sleeping.
-    inline bool IsReady() { return nextRunTime_ <= Time::GetSystemTime(); }
+    /// Return true if task is ready, false if task is still sleeping or waiting for a condition.
+    inline bool IsReady() { return nextRunTime_ <= Time::GetSystemTime() && !waitCondition_; }
+    /// Return true if task was resumed by a threaded scheduler and may continue on any thread.
+    inline bool IsThreaded() const { return threaded_; }
     /// Explicitly switch execution to specified task. Task must be created on the same thread where this function is
-    /// called. Task can be switched to at any time. `data` pointer will be returned by Suspend()/SwitchTo() of next executing task.
+    /// called, unless it belongs to a threaded scheduler. Task can be switched to at any time. `data` pointer will be
+    /// returned by Suspend()/SwitchTo() of next executing task.
     void* SwitchTo(void* data = nullptr);
     /// Request task termination. If exception support is disabled then user must return from the task manually when IsTerminating() returns true.
     /// If exception support is enabled then task will be terminated next time Suspend() method is called. Suspend() will throw an exception that will be caught out-most layer of the task.
     inline void Terminate() { state_ = TSTATE_TERMINATE; }
     /// Set how long task should sleep until next time it yields execution.
     inline void SetSleep(float time) { nextRunTime_ = Time::GetSystemTime() + static_cast<unsigned>(1000.f * time); }
+    /// Set condition which must become true before the task is scheduled again. The condition is evaluated by the scheduler. The scheduler keeps the optional object the condition depends on alive while waiting.
+    inline void SetWaitCondition(const std::function<bool()>& condition, RefCounted* object = nullptr)
+    {
+        waitCondition_ = condition;
+        waitObject_ = object;
+    }
 
 protected:
     /// Construct a task. It has to be manually scheduled by calling Task::SwitchTo(). Caller is responsible for freeing returned object after task finishes execution.
@@ -108,6 +122,14 @@ protected:
     unsigned nextRunTime_ = 0;
     /// Procedure that executes the task.
     std::function<void()> function_;
+    /// Condition that must be met before the task is scheduled again.
+    std::function<bool()> waitCondition_;
+    /// Object the wait condition depends on, set by the suspending task. May be a raw pointer written by a worker thread.
+    RefCounted* waitObject_ = nullptr;
+    /// Reference to the object the wait condition depends on. Taken and released by the scheduler on the main thread, as reference counts are not atomic.
+    SharedPtr<RefCounted> waitObjectRef_;
+    /// Whether task may be resumed on worker threads.
+    bool threaded_ = false;
     /// Current state of the task.
     TaskState state_ = TSTATE_CREATED;
     /// Thread id on which task was created.
@@ -119,7 +141,8 @@ protected:
     friend class Tasks;
 };
 
-/// Task scheduler used for scheduling concurrent tasks.
+/// Task scheduler used for scheduling concurrent tasks. Sleeping tasks are kept in a timer wheel and only tasks that
+/// are due are visited when executing. A threaded scheduler resumes its tasks on all WorkQueue threads.
 class URHO3D_API TaskScheduler : public Object
 {
     URHO3D_OBJECT(TaskScheduler, Object);
@@ -133,26 +156,64 @@ public:
     SharedPtr<Task> Create(const std::function<void()>& taskFunction, unsigned stackSize = DEFAULT_TASK_SIZE);
     /// Schedule task for execution.
     void Add(Task* task);
+    /// Set whether tasks are resumed on worker threads. Tasks of a threaded scheduler must not touch main thread only
+    /// state such as scene or UI content.
+    void SetThreaded(bool enable) { threaded_ = enable; }
+    /// Return whether tasks are resumed on worker threads.
+    bool IsThreaded() const { return threaded_; }
     /// Return number of active tasks.
     unsigned GetActiveTaskCount() const;
+    /// Return number of tasks resumed by the last ExecuteTasks() call.
+    unsigned GetExecutedTaskCount() const { return numExecuted_; }
     /// Schedule tasks created by Create() method. This has to be called periodically, otherwise tasks will not run.
     void ExecuteTasks();
     /// Schedule tasks continuously until all of them exit.
     void ExecuteAllTasks();
 
 private:
-    /// List of tasks for every event tasks are executed on.
-    Vector<SharedPtr<Task>> tasks_;
+    /// Put a task to the ready list, timer wheel or waiting list depending on its state. Finished tasks are dropped.
+    void Schedule(SharedPtr<Task>& task, unsigned now);
+    /// Move tasks whose sleep expired up to the specified time from the timer wheel to the ready list.
+    void AdvanceTimers(unsigned now);
+    /// Move tasks whose wait condition is met to the ready list.
+    void CheckWaitConditions();
+
+    /// Tasks to be resumed on the next ExecuteTasks() call.
+    Vector<SharedPtr<Task> > readyTasks_;
+    /// Tasks being resumed by the current ExecuteTasks() call.
+    Vector<SharedPtr<Task> > executingTasks_;
+    /// Sleeping tasks bucketed by wake up time modulo TASK_TIMER_WHEEL_SIZE.
+    Vector<Vector<SharedPtr<Task> > > timerWheel_;
+    /// Tasks waiting for a condition.
+    Vector<SharedPtr<Task> > waitingTasks_;
+    /// Number of tasks in the timer wheel.
+    unsigned numSleeping_ = 0;
+    /// Time of the last timer wheel advance.
+    unsigned lastTime_ = 0;
+    /// Number of tasks resumed by the last ExecuteTasks() call.
+    unsigned numExecuted_ = 0;
+    /// Whether tasks are resumed on worker threads.
+    bool threaded_ = false;
 
     friend class Task;
 };
 
 /// Suspend execution of current task. Must be called from within function invoked by callback passed to
-/// TaskScheduler::Create() or Tasks::Create().
+/// TaskScheduler::Create() or Tasks::Create(). Execution returns to the context that last switched to the task, or to
+/// the main context of the current thread if the task was resumed by a threaded scheduler.
 /// `data` pointer will be returned by Suspend()/SwitchTo() of next executing task.
 URHO3D_API void* SuspendTask(float time = 0.f, void* data = nullptr);
 /// Switch execution to another task. If task pointer is null then execution will be switched to main task of current thread.
 URHO3D_API void* SuspendTask(Task* nextTask, float time = 0.f, void* data = nullptr);
+/// Suspend execution of current task until the condition returns true. The condition is evaluated by the scheduler
+/// on the thread that executes the scheduler, usually the main thread.
+URHO3D_API void SuspendTaskUntil(const std::function<bool()>& condition);
+/// Suspend execution of current task until the work item is completed. The scheduler keeps the item alive while waiting.
+URHO3D_API void WaitForWorkItem(WorkItem* item);
+/// Suspend execution of current task until all jobs tracked by the counter are finished.
+URHO3D_API void WaitForJobs(const JobCounter& counter);
+/// Suspend execution of current task until background loading of the resource finishes. The scheduler keeps the resource alive while waiting.
+URHO3D_API void WaitForResource(Resource* resource);
 
 /// Tasks subsystem. Handles execution of tasks on the main thread.
 class URHO3D_API Tasks : public Object
@@ -167,6 +228,8 @@ public:
     SharedPtr<Task> Create(StringHash eventType, const std::function<void()>& taskFunction, unsigned stackSize = DEFAULT_TASK_SIZE);
     /// Scheduled task for execution in specified event.
     void Add(StringHash eventType, Task* task);
+    /// Return task scheduler executing tasks in specified event. Scheduler is created if it does not exist yet.
+    TaskScheduler* GetScheduler(StringHash eventType);
     /// Return number of active tasks.
     unsigned GetActiveTaskCount() const;
 
@@ -33,6 +33,113 @@
 namespace Urho3D
 {
 
+/// Index of the calling thread within the work queue. 0 for the main thread and foreign threads.
+static thread_local unsigned currentThreadIndex = 0;
+
+/// Number of failed attempts to find work before an idle worker thread, or a thread waiting for a job counter, goes to sleep.
+static const unsigned WORKER_SPIN_COUNT = 64;
+
+/// Work-stealing queue. The owner thread pushes and pops jobs at the back, other threads steal from the front.
+class WorkStealingQueue
+{
+public:
+    /// Construct.
+    WorkStealingQueue() :
+        jobs_(INITIAL_CAPACITY),
+        head_(0),
+        size_(0)
+    {
+    }
+
+    /// Push a job to the back.
+    void Push(const Job& job)
+    {
+        Lock();
+        if (size_ == jobs_.Size())
+            Grow();
+        jobs_[(head_ + size_) & (jobs_.Size() - 1)] = job;
+        ++size_;
+        approximateSize_.store(size_, std::memory_order_relaxed);
+        Unlock();
+    }
+
+    /// Pop a job from the back. Return true if successful.
+    bool Pop(Job& job)
+    {
+        if (!approximateSize_.load(std::memory_order_relaxed))
+            return false;
+
+        Lock();
+        bool success = size_ > 0;
+        if (success)
+        {
+            --size_;
+            job = jobs_[(head_ + size_) & (jobs_.Size() - 1)];
+            approximateSize_.store(size_, std::memory_order_relaxed);
+        }
+        Unlock();
+        return success;
+    }
+
+    /// Steal a job from the front. Return true if successful.
+    bool Steal(Job& job)
+    {
+        if (!approximateSize_.load(std::memory_order_relaxed))
+            return false;
+
+        // Do not wait for a busy queue, the thief will try the next one
+        if (lock_.test_and_set(std::memory_order_acquire))
+            return false;
+
+        bool success = size_ > 0;
+        if (success)
+        {
+            job = jobs_[head_];
+            head_ = (head_ + 1) & (jobs_.Size() - 1);
+            --size_;
+            approximateSize_.store(size_, std::memory_order_relaxed);
+        }
+        Unlock();
+        return success;
+    }
+
+private:
+    /// Initial capacity, must be a power of two.
+    static const unsigned INITIAL_CAPACITY = 256;
+
+    /// Acquire the spin lock.
+    void Lock()
+    {
+        while (lock_.test_and_set(std::memory_order_acquire))
+        {
+        }
+    }
+
+    /// Release the spin lock.
+    void Unlock() { lock_.clear(std::memory_order_release); }
+
+    /// Double the ring buffer capacity. Called with the lock held.
+    void Grow()
+    {
+        PODVector<Job> jobs(jobs_.Size() * 2);
+        for (unsigned i = 0; i < size_; ++i)
+            jobs[i] = jobs_[(head_ + i) & (jobs_.Size() - 1)];
+        jobs_.Swap(jobs);
+        head_ = 0;
+    }
+
+    /// Ring buffer of jobs.
+    PODVector<Job> jobs_;
+    /// Index of the front job.
+    unsigned head_;
+    /// Number of jobs.
+    unsigned size_;
+    /// Number of jobs readable without locking, used to skip empty queues.
+    std::atomic<unsigned> approximateSize_{0};
+    /// Spin lock.
+    std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+};
+
 /// Worker thread managed by the work queue.
 class WorkerThread : public Thread, public RefCounted
 {
@@ -50,6 +157,7 @@ public:
         URHO3D_PROFILE_THREAD("WorkerThread");
         // Init FPU state first
         InitFPU();
+        currentThreadIndex = index_;
         owner_->ProcessItems(index_);
     }
 
@@ -63,16 +171,66 @@ private:
     unsigned index_;
 };
 
+/// Execute a legacy work item with M_MAX_UNSIGNED priority stored in a job.
+static void ExecuteWorkItemJob(void* data, unsigned threadIndex)
+{
+    auto* item = static_cast<WorkItem*>(data);
+    item->workFunction_(item, threadIndex);
+    item->completed_ = true;
+}
+
+/// Execute a heap-allocated lambda stored in a job.
+static void ExecuteLambdaJob(void* data, unsigned threadIndex)
+{
+    auto* function = static_cast<std::function<void(unsigned)>*>(data);
+    (*function)(threadIndex);
+    delete function;
+}
+
+/// Shared state of a ParallelFor call. Lives on the stack of the calling thread.
+struct ParallelForState
+{
+    /// User function.
+    ParallelForFunction function_;
+    /// User data.
+    void* data_;
+    /// Number of indices.
+    unsigned count_;
+    /// Number of indices taken at once.
+    unsigned batchSize_;
+    /// Next index to take.
+    std::atomic<unsigned> next_;
+};
+
+/// Process ParallelFor batches until the range is exhausted.
+static void ExecuteParallelForJob(void* data, unsigned threadIndex)
+{
+    auto* state = static_cast<ParallelForState*>(data);
+    for (;;)
+    {
+        unsigned begin = state->next_.fetch_add(state->batchSize_, std::memory_order_relaxed);
+        if (begin >= state->count_)
+            break;
+        state->function_(state->data_, begin, Min(begin + state->batchSize_, state->count_), threadIndex);
+    }
+}
+
 WorkQueue::WorkQueue(Context* context) :
     Object(context),
+    numLowPriorityItems_(0),
+    numQueued_(0),
+    numSleeping_(0),
+    nextQueue_(0),
     shutDown_(false),
-    pausing_(false),
     paused_(false),
     completing_(false),
     tolerance_(10),
     lastSize_(0),
     maxNonThreadedWorkMs_(5)
 {
+    // Main thread queue
+    jobQueues_.Push(UniquePtr<WorkStealingQueue>(new WorkStealingQueue()));
+
     SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(WorkQueue, HandleBeginFrame));
 }
 
@@ -80,7 +238,7 @@ WorkQueue::~WorkQueue()
 {
     // Stop the worker threads. First make sure they are not waiting for work items
     shutDown_ = true;
-    Resume();
+    NotifyWorkers();
 
     for (unsigned i = 0; i < threads_.Size(); ++i)
         threads_[i]->Stop();
@@ -97,6 +255,10 @@ void WorkQueue::CreateThreads(unsigned numThreads)
     // Start threads in paused mode
     Pause();
 
+    // Create all queues before starting any thread, as threads steal from each other
+    for (unsigned i = 0; i < numThreads; ++i)
+        jobQueues_.Push(UniquePtr<WorkStealingQueue>(new WorkStealingQueue()));
+
     for (unsigned i = 0; i < numThreads; ++i)
     {
         SharedPtr<WorkerThread> thread(new WorkerThread(this, i + 1));
@@ -141,15 +303,20 @@ void WorkQueue::AddWorkItem(const SharedPtr<WorkItem>& item)
     workItems_.Push(item);
     item->completed_ = false;
 
-    // Make sure worker threads' list is safe to modify
-    if (threads_.Size() && !paused_)
-        queueMutex_.Acquire();
+    // Highest priority items are frame-critical work: schedule them as jobs so that worker threads do not contend
+    // for a single queue
+    if (item->priority_ == M_MAX_UNSIGNED)
+    {
+        maxPriorityItems_.value_.fetch_add(1, std::memory_order_relaxed);
+        Job job{ExecuteWorkItemJob, item.Get(), &maxPriorityItems_};
+        PushJob(threads_.Empty() ? 0 : (nextQueue_.fetch_add(1, std::memory_order_relaxed) % threads_.Size()) + 1, job);
+        return;
+    }
 
-    // Find position for new item
-    if (queue_.Empty())
-        queue_.Push(item);
-    else
     {
+        MutexLock lock(queueMutex_);
+
+        // Find position for new item
         bool inserted = false;
 
         for (List<WorkItem*>::Iterator i = queue_.Begin(); i != queue_.End(); ++i)
@@ -164,13 +331,13 @@ void WorkQueue::AddWorkItem(const SharedPtr<WorkItem>& item)
 
         if (!inserted)
             queue_.Push(item);
-    }
 
-    if (threads_.Size())
-    {
-        queueMutex_.Release();
-        paused_ = false;
+        numLowPriorityItems_.fetch_add(1);
+        numQueued_.fetch_add(1);
     }
+
+    paused_ = false;
+    NotifyWorkers();
 }
 
 WorkItem* WorkQueue::AddWorkItem(std::function<void()> workFunction, unsigned priority)
@@ -190,7 +357,8 @@ bool WorkQueue::RemoveWorkItem(SharedPtr<WorkItem> item)
 
     MutexLock lock(queueMutex_);
 
-    // Can only remove successfully if the item was not yet taken by threads for execution
+    // Can only remove successfully if the item was not yet taken by threads for execution. Items with the highest
+    // priority are scheduled as jobs immediately and can not be removed
     List<WorkItem*>::Iterator i = queue_.Find(item.Get());
     if (i != queue_.End())
     {
@@ -198,6 +366,8 @@ bool WorkQueue::RemoveWorkItem(SharedPtr<WorkItem> item)
         if (j != workItems_.End())
         {
             queue_.Erase(i);
+            numLowPriorityItems_.fetch_sub(1);
+            numQueued_.fetch_sub(1);
             ReturnToPool(item);
             workItems_.Erase(j);
             return true;
@@ -221,6 +391,8 @@ unsigned WorkQueue::RemoveWorkItems(const Vector<SharedPtr<WorkItem> >& items)
             if (k != workItems_.End())
             {
                 queue_.Erase(j);
+                numLowPriorityItems_.fetch_sub(1);
+                numQueued_.fetch_sub(1);
                 ReturnToPool(*k);
                 workItems_.Erase(k);
                 ++removed;
@@ -233,81 +405,123 @@ unsigned WorkQueue::RemoveWorkItems(const Vector<SharedPtr<WorkItem> >& items)
 
 void WorkQueue::Pause()
 {
-    if (!paused_)
-    {
-        pausing_ = true;
-
-        queueMutex_.Acquire();
-        paused_ = true;
-
-        pausing_ = false;
-    }
+    paused_ = true;
 }
 
 void WorkQueue::Resume()
 {
     if (paused_)
     {
-        queueMutex_.Release();
         paused_ = false;
+        NotifyWorkers();
     }
 }
 
-
 void WorkQueue::Complete(unsigned priority)
 {
     completing_ = true;
 
     if (threads_.Size())
-    {
         Resume();
 
-        // Take work items also in the main thread until queue empty or no high-priority items anymore
-        while (!queue_.Empty())
-        {
-            queueMutex_.Acquire();
-            if (!queue_.Empty() && queue_.Front()->priority_ >= priority)
-            {
-                WorkItem* item = queue_.Front();
-                queue_.PopFront();
-                queueMutex_.Release();
-                item->workFunction_(item, 0);
-                item->completed_ = true;
-            }
-            else
-            {
-                queueMutex_.Release();
-                break;
-            }
-        }
+    // Take jobs also in the main thread until all highest priority items have completed
+    Wait(maxPriorityItems_);
 
-        // Wait for threaded work to complete
-        while (!IsCompleted(priority))
+    if (priority < M_MAX_UNSIGNED)
+    {
+        // Execute lower priority items, then wait for the ones still executing in worker threads
+        while (ExecuteLowPriorityItem(0, priority))
         {
         }
 
-        // If no work at all remaining, pause worker threads by leaving the mutex locked
-        if (queue_.Empty())
-            Pause();
+        while (!IsCompleted(priority))
+            Time::Sleep(0);
     }
-    else
+
+    // If no work at all remaining, let the worker threads sleep
+    if (threads_.Size() && !numQueued_.load())
+        Pause();
+
+    PurgeCompleted(priority);
+    completing_ = false;
+}
+
+void WorkQueue::AddJob(JobFunction function, void* data, JobCounter* counter)
+{
+    if (counter)
+        counter->value_.fetch_add(1, std::memory_order_relaxed);
+
+    Job job{function, data, counter};
+    unsigned threadIndex = GetThreadIndex();
+    // Spread jobs submitted from the main thread over the workers, worker threads keep their jobs local
+    if (threadIndex == 0 && !threads_.Empty())
+        threadIndex = (nextQueue_.fetch_add(1, std::memory_order_relaxed) % threads_.Size()) + 1;
+
+    PushJob(threadIndex, job);
+}
+
+void WorkQueue::AddJob(std::function<void(unsigned)> function, JobCounter* counter)
+{
+    AddJob(ExecuteLambdaJob, new std::function<void(unsigned)>(std::move(function)), counter);
+}
+
+void WorkQueue::Wait(const JobCounter& counter)
+{
+    unsigned threadIndex = GetThreadIndex();
+    unsigned idleCount = 0;
+
+    // Help with other jobs while waiting. If there are none, yield for a while and then sleep until woken up by the
+    // counter reaching zero or new jobs being queued
+    while (!counter.IsDone())
     {
-        // No worker threads: ensure all high-priority items are completed in the main thread
-        while (!queue_.Empty() && queue_.Front()->priority_ >= priority)
+        if (ExecuteJob(threadIndex))
+            idleCount = 0;
+        else if (++idleCount < WORKER_SPIN_COUNT)
+            Time::Sleep(0);
+        else
         {
-            WorkItem* item = queue_.Front();
-            queue_.PopFront();
-            item->workFunction_(item, 0);
-            item->completed_ = true;
+            WaitForCounter(counter);
+            idleCount = 0;
         }
     }
+}
 
-    PurgeCompleted(priority);
-    completing_ = false;
+void WorkQueue::ParallelFor(unsigned count, unsigned minBatchSize, ParallelForFunction function, void* data)
+{
+    if (!count)
+        return;
+
+    const unsigned numThreads = threads_.Size() + 1;
+
+    // Make several batches per thread so that stealing can balance uneven work
+    ParallelForState state;
+    state.function_ = function;
+    state.data_ = data;
+    state.count_ = count;
+    state.batchSize_ = Max(Max(minBatchSize, 1U), count / (numThreads * 4));
+    state.next_ = 0;
+
+    const unsigned numBatches = (count + state.batchSize_ - 1) / state.batchSize_;
+    const unsigned numHelpers = Min(numBatches, numThreads) - 1;
+
+    JobCounter counter;
+    for (unsigned i = 0; i < numHelpers; ++i)
+        AddJob(ExecuteParallelForJob, &state, &counter);
+
+    ExecuteParallelForJob(&state, GetThreadIndex());
+    Wait(counter);
+}
+
+unsigned WorkQueue::GetThreadIndex()
+{
+    return currentThreadIndex;
 }
 
 bool WorkQueue::IsCompleted(unsigned priority) const
 {
+    if (!maxPriorityItems_.IsDone())
+        return false;
+
     for (List<SharedPtr<WorkItem> >::ConstIterator i = workItems_.Begin(); i != workItems_.End(); ++i)
     {
         if ((*i)->priority_ >= priority && !(*i)->completed_)
@@ -319,36 +533,105 @@ bool WorkQueue::IsCompleted(unsigned priority) const
 
 void WorkQueue::ProcessItems(unsigned threadIndex)
 {
-    bool wasActive = false;
+    unsigned idleCount = 0;
 
     for (;;)
     {
         if (shutDown_)
             return;
 
-        if (pausing_ && !wasActive)
+        if (!paused_ && (ExecuteJob(threadIndex) || ExecuteLowPriorityItem(threadIndex, 0)))
+            idleCount = 0;
+        else if (++idleCount < WORKER_SPIN_COUNT)
             Time::Sleep(0);
         else
         {
-            queueMutex_.Acquire();
-            if (!queue_.Empty())
-            {
-                wasActive = true;
+            WaitForWork();
+            idleCount = 0;
+        }
+    }
+}
 
-                WorkItem* item = queue_.Front();
-                queue_.PopFront();
-                queueMutex_.Release();
-                item->workFunction_(item, threadIndex);
-                item->completed_ = true;
-            }
-            else
-            {
-                wasActive = false;
+void WorkQueue::PushJob(unsigned queueIndex, const Job& job)
+{
+    jobQueues_[queueIndex]->Push(job);
+    numQueued_.fetch_add(1);
+    paused_ = false;
+    NotifyWorkers();
+}
 
-                queueMutex_.Release();
-                Time::Sleep(0);
-            }
-        }
+bool WorkQueue::ExecuteJob(unsigned threadIndex)
+{
+    Job job;
+    bool found = jobQueues_[threadIndex]->Pop(job);
+
+    // Own queue empty, try to steal from the other threads starting from the next one
+    for (unsigned i = 1; !found && i < jobQueues_.Size(); ++i)
+        found = jobQueues_[(threadIndex + i) % jobQueues_.Size()]->Steal(job);
+
+    if (!found)
+        return false;
+
+    numQueued_.fetch_sub(1);
+    job.function_(job.data_, threadIndex);
+    // Wake up the threads sleeping in Wait() when the last job of a counter finishes
+    if (job.counter_ && job.counter_->value_.fetch_sub(1) == 1 && numSleeping_.load())
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        wakeCondition_.notify_all();
+    }
+    return true;
+}
+
+bool WorkQueue::ExecuteLowPriorityItem(unsigned threadIndex, unsigned priority)
+{
+    if (!numLowPriorityItems_.load(std::memory_order_relaxed))
+        return false;
+
+    queueMutex_.Acquire();
+    if (!queue_.Empty() && queue_.Front()->priority_ >= priority)
+    {
+        WorkItem* item = queue_.Front();
+        queue_.PopFront();
+        numLowPriorityItems_.fetch_sub(1);
+        numQueued_.fetch_sub(1);
+        queueMutex_.Release();
+        item->workFunction_(item, threadIndex);
+        item->completed_ = true;
+        return true;
+    }
+
+    queueMutex_.Release();
+    return false;
+}
+
+void WorkQueue::WaitForWork()
+{
+    std::unique_lock<std::mutex> lock(wakeMutex_);
+    numSleeping_.fetch_add(1);
+    while (!shutDown_ && (paused_ || !numQueued_.load()))
+        wakeCondition_.wait(lock);
+    numSleeping_.fetch_sub(1);
+}
+
+void WorkQueue::WaitForCounter(const JobCounter& counter)
+{
+    // The counter is read with sequential consistency after registering as a sleeper, pairing with the decrement in
+    // ExecuteJob() which checks for sleepers afterward, so that the wakeup can not be missed. Queued low-priority items
+    // do not wake up, as Wait() only executes jobs
+    std::unique_lock<std::mutex> lock(wakeMutex_);
+    numSleeping_.fetch_add(1);
+    while (!shutDown_ && counter.value_.load() && numQueued_.load() <= numLowPriorityItems_.load())
+        wakeCondition_.wait(lock);
+    numSleeping_.fetch_sub(1);
+}
+
+void WorkQueue::NotifyWorkers()
+{
+    if (numSleeping_.load())
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        wakeCondition_.notify_all();
     }
 }
 
@@ -370,7 +653,11 @@ void WorkQueue::PurgeCompleted(unsigned priority)
                 SendEvent(E_WORKITEMCOMPLETED, eventData);
             }
 
-            ReturnToPool(*i);
+            // Items still referenced elsewhere, for example by a task scheduler waiting for them, must keep their
+            // completed flag and can not be recycled. Work item references are only taken and released in the main
+            // thread, so the count is reliable here
+            if ((*i)->Refs() == 1)
+                ReturnToPool(*i);
             i = workItems_.Erase(i);
         }
         else
@@ -414,18 +701,15 @@ void WorkQueue::ReturnToPool(SharedPtr<WorkItem>& item)
 void WorkQueue::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
 {
     // If no worker threads, complete low-priority work here
-    if (threads_.Empty() && !queue_.Empty())
+    if (threads_.Empty())
     {
         URHO3D_PROFILE("CompleteWorkNonthreaded");
 
         HiresTimer timer;
 
-        while (!queue_.Empty() && timer.GetUSec(false) < maxNonThreadedWorkMs_ * 1000LL)
+        // Jobs and highest priority items may have been left over if nobody waited for them
+        while (timer.GetUSec(false) < maxNonThreadedWorkMs_ * 1000LL && (ExecuteJob(0) || ExecuteLowPriorityItem(0, 0)))
         {
-            WorkItem* item = queue_.Front();
-            queue_.PopFront();
-            item->workFunction_(item, 0);
-            item->completed_ = true;
         }
     }
 
@@ -26,6 +26,10 @@
 #include "../Core/Mutex.h"
 #include "../Core/Object.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
 namespace Urho3D
 {
 
@@ -36,6 +40,46 @@ URHO3D_EVENT(E_WORKITEMCOMPLETED, WorkItemCompleted)
 }
 
 class WorkerThread;
+class WorkStealingQueue;
+
+/// Job function. Called with the job data pointer and thread index (0 = main thread) as parameters.
+using JobFunction = void(*)(void*, unsigned);
+/// Parallel for function. Called with user data pointer, index range [begin, end) and thread index as parameters.
+using ParallelForFunction = void(*)(void*, unsigned, unsigned, unsigned);
+
+/// Counter of unfinished jobs. Incremented when a job referencing it is added and decremented when that job finishes.
+class URHO3D_API JobCounter
+{
+    friend class WorkQueue;
+
+public:
+    /// Construct.
+    JobCounter() : value_(0) { }
+    /// Prevent copy construction.
+    JobCounter(const JobCounter& rhs) = delete;
+    /// Prevent assignment.
+    JobCounter& operator =(const JobCounter& rhs) = delete;
+
+    /// Return number of unfinished jobs.
+    unsigned GetValue() const { return value_.load(std::memory_order_acquire); }
+    /// Return whether all jobs have finished.
+    bool IsDone() const { return GetValue() == 0; }
+
+private:
+    /// Number of unfinished jobs.
+    std::atomic<unsigned> value_;
+};
+
+/// Lightweight job stored by value in the per-thread work-stealing queues.
+struct Job
+{
+    /// Work function.
+    JobFunction function_;
+    /// User data pointer.
+    void* data_;
+    /// Counter to decrement after completion. May be null.
+    JobCounter* counter_;
+};
 
 /// Work queue item.
 struct WorkItem : public RefCounted
@@ -55,8 +99,8 @@ public:
     unsigned priority_{};
     /// Whether to send event on completion.
     bool sendEvent_{};
-    /// Completed flag.
-    volatile bool completed_{};
+    /// Completed flag. Set by the executing thread and read by the main thread.
+    std::atomic<bool> completed_{};
 
 private:
     bool pooled_{};
@@ -96,6 +140,23 @@ public:
     /// Finish all queued work which has at least the specified priority. Main thread will also execute priority work. Pause worker threads if no more work remains.
     void Complete(unsigned priority);
 
+    /// Add a job to the queue of the calling thread, from where idle threads may steal it. Safe to call from any thread. Counter may be null.
+    void AddJob(JobFunction function, void* data, JobCounter* counter);
+    /// Add a job executing a lambda. The lambda is heap-allocated, prefer AddJob(JobFunction, ...) in hot paths.
+    void AddJob(std::function<void(unsigned)> function, JobCounter* counter);
+    /// Execute other jobs on the calling thread until the counter reaches zero.
+    void Wait(const JobCounter& counter);
+    /// Split the index range [0, count) into batches of at least minBatchSize and process them on all threads. The calling thread participates and the call returns once the whole range is processed.
+    void ParallelFor(unsigned count, unsigned minBatchSize, ParallelForFunction function, void* data);
+    /// Split the index range [0, count) into batches of at least minBatchSize and process them on all threads. The function is called with (begin, end, threadIndex).
+    template <class T> void ParallelFor(unsigned count, unsigned minBatchSize, const T& function)
+    {
+        ParallelFor(count, minBatchSize, [](void* data, unsigned begin, unsigned end, unsigned threadIndex)
+        {
+            (*static_cast<const T*>(data))(begin, end, threadIndex);
+        }, const_cast<T*>(&function));
+    }
+
     /// Set the pool telerance before it starts deleting pool items.
     void SetTolerance(int tolerance) { tolerance_ = tolerance; }
 
@@ -104,6 +165,8 @@ public:
 
     /// Return number of worker threads.
     unsigned GetNumThreads() const { return threads_.Size(); }
+    /// Return index of the calling thread. 0 is returned for the main thread and any thread not owned by the work queue.
+    static unsigned GetThreadIndex();
 
     /// Return whether all work with at least the specified priority is finished.
     bool IsCompleted(unsigned priority) const;
@@ -119,6 +182,18 @@ public:
 private:
     /// Process work items until shut down. Called by the worker threads.
     void ProcessItems(unsigned threadIndex);
+    /// Push a job to the specified thread's queue and wake up sleeping worker threads.
+    void PushJob(unsigned queueIndex, const Job& job);
+    /// Pop a job from the thread's own queue or steal one from other threads. Return true if a job was executed.
+    bool ExecuteJob(unsigned threadIndex);
+    /// Take the highest-priority legacy work item having at least the specified priority and execute it. Return true if an item was executed.
+    bool ExecuteLowPriorityItem(unsigned threadIndex, unsigned priority);
+    /// Put the calling worker thread to sleep until there is work or the queue is shutting down.
+    void WaitForWork();
+    /// Put the calling thread to sleep until the counter reaches zero or there is work to help with.
+    void WaitForCounter(const JobCounter& counter);
+    /// Wake up sleeping worker threads and threads waiting for a job counter.
+    void NotifyWorkers();
     /// Purge completed work items which have at least the specified priority, and send completion events as necessary.
     void PurgeCompleted(unsigned priority);
     /// Purge the pool to reduce allocation where its unneeded.
@@ -134,16 +209,30 @@ private:
     List<SharedPtr<WorkItem> > poolItems_;
     /// Work item collection. Accessed only by the main thread.
     List<SharedPtr<WorkItem> > workItems_;
-    /// Work item prioritized queue for worker threads. Pointers are guaranteed to be valid (point to workItems.)
+    /// Per-thread work-stealing queues. Index 0 is the main thread.
+    Vector<UniquePtr<WorkStealingQueue> > jobQueues_;
+    /// Prioritized queue of work items with priority lower than M_MAX_UNSIGNED. Pointers are guaranteed to be valid (point to workItems.)
     List<WorkItem*> queue_;
-    /// Worker queue mutex.
+    /// Low-priority queue mutex.
     Mutex queueMutex_;
+    /// Number of items in the low-priority queue, readable without locking.
+    std::atomic<unsigned> numLowPriorityItems_;
+    /// Number of work items with M_MAX_UNSIGNED priority not yet completed.
+    JobCounter maxPriorityItems_;
+    /// Number of jobs and work items queued but not yet started.
+    std::atomic<unsigned> numQueued_;
+    /// Number of threads sleeping on the wake condition, either idle workers or threads waiting for a job counter.
+    std::atomic<unsigned> numSleeping_;
+    /// Round-robin index of the next worker queue receiving jobs submitted from the main thread or foreign threads.
+    std::atomic<unsigned> nextQueue_;
+    /// Mutex protecting the wake condition.
+    std::mutex wakeMutex_;
+    /// Condition used by idle worker threads to sleep.
+    std::condition_variable wakeCondition_;
     /// Shutting down flag.
-    volatile bool shutDown_;
-    /// Pausing flag. Indicates the worker threads should not contend for the queue mutex.
-    volatile bool pausing_;
-    /// Paused flag. Indicates the queue mutex being locked to prevent worker threads using up CPU time.
-    bool paused_;
+    std::atomic<bool> shutDown_;
+    /// Paused flag. Worker threads sleep instead of taking work while set.
+    std::atomic<bool> paused_;
     /// Completing work in the main thread flag.
     bool completing_;
     /// Tolerance for the shared pool before it begins to deallocate.
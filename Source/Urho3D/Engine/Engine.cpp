@@ -25,6 +25,7 @@
 #include "../Audio/Audio.h"
 #include "../Core/Context.h"
 #include "../Core/CoreEvents.h"
+#include "../Core/PerformanceCounters.h"
 #include "../Core/Profiler.h"
 #include "../Core/ProcessUtils.h"
 #include "../Core/Thread.h"
@@ -127,6 +128,7 @@ Engine::Engine(Context* context) :
 
     // Create subsystems which do not depend on engine initialization or startup parameters
     context_->RegisterSubsystem(new Time(context_));
+    context_->RegisterSubsystem(new PerformanceCounters(context_));
     context_->RegisterSubsystem(new WorkQueue(context_));
     context_->RegisterSubsystem(new FileSystem(context_));
 #ifdef URHO3D_LOGGING
@@ -178,6 +180,7 @@ bool Engine::Initialize(const VariantMap& parameters)
 
     // Set headless mode
     headless_ = GetParameter(parameters, EP_HEADLESS, false).GetBool();
+    performanceCountersFile_ = GetParameter(parameters, EP_PERFORMANCE_COUNTERS_FILE, String::EMPTY).GetString();
 
     // Register the rest of the subsystems
     if (!headless_)
@@ -637,11 +640,11 @@ void Engine::DumpResources(bool dumpFileName)
         return;
 
     auto* cache = GetSubsystem<ResourceCache>();
-    const HashMap<StringHash, ResourceGroup>& resourceGroups = cache->GetAllResources();
+    const FlatHashMap<StringHash, ResourceGroup>& resourceGroups = cache->GetResourceGroups();
     if (dumpFileName)
     {
         URHO3D_LOGRAW("Used resources:\n");
-        for (HashMap<StringHash, ResourceGroup>::ConstIterator i = resourceGroups.Begin(); i != resourceGroups.End(); ++i)
+        for (FlatHashMap<StringHash, ResourceGroup>::ConstIterator i = resourceGroups.Begin(); i != resourceGroups.End(); ++i)
         {
             const HashMap<StringHash, SharedPtr<Resource> >& resources = i->second_.resources_;
             if (dumpFileName)
@@ -701,20 +704,24 @@ void Engine::Update()
     URHO3D_PROFILE("Update");
 
     // Logic update event
-    using namespace Update;
-
-    VariantMap& eventData = GetEventDataMap();
-    eventData[P_TIMESTEP] = timeStep_;
-    SendEvent(E_UPDATE, eventData);
+    UpdateEventData updateData;
+    updateData.timeStep_ = timeStep_;
+    SendEvent(updateData);
 
     // Logic post-update event
-    SendEvent(E_POSTUPDATE, eventData);
+    PostUpdateEventData postUpdateData;
+    postUpdateData.timeStep_ = timeStep_;
+    SendEvent(postUpdateData);
 
     // Rendering update event
-    SendEvent(E_RENDERUPDATE, eventData);
+    RenderUpdateEventData renderUpdateData;
+    renderUpdateData.timeStep_ = timeStep_;
+    SendEvent(renderUpdateData);
 
     // Post-render update event
-    SendEvent(E_POSTRENDERUPDATE, eventData);
+    PostRenderUpdateEventData postRenderUpdateData;
+    postRenderUpdateData.timeStep_ = timeStep_;
+    SendEvent(postRenderUpdateData);
 }
 
 void Engine::Render()
@@ -965,6 +972,7 @@ void Engine::DefineParameters(CLI::App& commandLine, VariantMap& engineParameter
         return false;
     })->set_custom_option("int");
     addFlag("--touch", EP_TOUCH_EMULATION, true, "Enable touch emulation");
+    addOptionString("--perf-counters", EP_PERFORMANCE_COUNTERS_FILE, "Save performance counters to a CSV or JSON file on exit");
 #ifdef URHO3D_TESTING
     addOptionInt("--timeout", EP_TIME_OUT, "Quit application after specified time");
 #endif
@@ -999,6 +1007,9 @@ void Engine::DoExit()
     if (graphics)
         graphics->Close();
 
+    if (!performanceCountersFile_.Empty())
+        GetSubsystem<PerformanceCounters>()->Save(performanceCountersFile_);
+
     exiting_ = true;
 #if defined(__EMSCRIPTEN__) && defined(URHO3D_TESTING)
     emscripten_force_exit(EXIT_SUCCESS);    // Some how this is required to signal emrun to stop
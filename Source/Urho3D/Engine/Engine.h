@@ -163,6 +163,8 @@ private:
     bool headless_;
     /// Audio paused flag.
     bool audioPaused_;
+    /// File to save performance counters to on exit.
+    String performanceCountersFile_;
 };
 
 }
@@ -0,0 +1,384 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Graphics/AABBTree.h"
+
+#include <type_traits>
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Multiplier of the displacement a moved leaf box is enlarged by in the direction of movement.
+static const float DISPLACEMENT_MULTIPLIER = 4.0f;
+
+static_assert(std::is_trivially_copyable<AABBTreeNode>::value, "AABB tree nodes are stored in a PODVector");
+
+/// Return the combined bounding box of two boxes.
+static inline BoundingBox Union(const BoundingBox& lhs, const BoundingBox& rhs)
+{
+    return BoundingBox(VectorMin(lhs.min_, rhs.min_), VectorMax(lhs.max_, rhs.max_));
+}
+
+/// Return half the surface area of a bounding box, which is the cost metric of the tree.
+static inline float HalfArea(const BoundingBox& box)
+{
+    Vector3 size = box.Size();
+    return size.x_ * size.y_ + size.y_ * size.z_ + size.z_ * size.x_;
+}
+
+AABBTree::AABBTree() :
+    root_(NULL_NODE),
+    freeList_(NULL_NODE),
+    numLeaves_(0),
+    margin_(DEFAULT_AABB_TREE_MARGIN)
+{
+}
+
+unsigned AABBTree::InsertLeaf(Drawable* drawable, const BoundingBox& box)
+{
+    unsigned leaf = AllocateNode();
+    AABBTreeNode& node = nodes_[leaf];
+    Vector3 margin(margin_, margin_, margin_);
+    node.SetBox(BoundingBox(box.min_ - margin, box.max_ + margin));
+    node.drawable_ = drawable;
+    node.height_ = 0;
+    LinkLeaf(leaf);
+    ++numLeaves_;
+    return leaf;
+}
+
+void AABBTree::RemoveLeaf(unsigned leaf)
+{
+    assert(leaf < nodes_.Size() && nodes_[leaf].IsLeaf());
+    UnlinkLeaf(leaf);
+    FreeNode(leaf);
+    --numLeaves_;
+}
+
+bool AABBTree::MoveLeaf(unsigned leaf, const BoundingBox& box)
+{
+    assert(leaf < nodes_.Size() && nodes_[leaf].IsLeaf());
+    if (CheckLeafFit(leaf, box))
+        return false;
+
+    // Predict further movement in the same direction, so that steadily moving objects are not reinserted every frame.
+    // The displacement is measured from the previous enlarged box, so limit the prediction to avoid it feeding itself
+    AABBTreeNode& node = nodes_[leaf];
+    Vector3 margin(margin_, margin_, margin_);
+    Vector3 limit = box.Size() + margin;
+    Vector3 displacement = VectorMax(VectorMin(DISPLACEMENT_MULTIPLIER * (box.Center() - node.GetBox().Center()), limit), -limit);
+    BoundingBox newBox(box.min_ - margin, box.max_ + margin);
+    newBox.min_ += VectorMin(displacement, Vector3::ZERO);
+    newBox.max_ += VectorMax(displacement, Vector3::ZERO);
+
+    // If the parent still encloses the new box, the ancestors need no refit. Keep the leaf in place, which saves the
+    // unlinking, descent and rebalancing, at the cost of the tree adapting more slowly to the movement
+    unsigned parent = node.parent_;
+    if (parent != NULL_NODE && nodes_[parent].GetBox().IsInside(newBox) == INSIDE)
+    {
+        node.SetBox(newBox);
+        return true;
+    }
+
+    UnlinkLeaf(leaf);
+    nodes_[leaf].SetBox(newBox);
+    LinkLeaf(leaf);
+    return true;
+}
+
+void AABBTree::Clear()
+{
+    nodes_.Clear();
+    root_ = NULL_NODE;
+    freeList_ = NULL_NODE;
+    numLeaves_ = 0;
+}
+
+unsigned AABBTree::AllocateNode()
+{
+    unsigned index;
+    if (freeList_ != NULL_NODE)
+    {
+        index = freeList_;
+        freeList_ = nodes_[index].parent_;
+    }
+    else
+    {
+        index = nodes_.Size();
+        nodes_.Resize(index + 1);
+    }
+
+    AABBTreeNode& node = nodes_[index];
+    node.drawable_ = nullptr;
+    node.parent_ = NULL_NODE;
+    node.child1_ = NULL_NODE;
+    node.child2_ = NULL_NODE;
+    node.height_ = 0;
+    return index;
+}
+
+void AABBTree::FreeNode(unsigned index)
+{
+    AABBTreeNode& node = nodes_[index];
+    node.drawable_ = nullptr;
+    node.parent_ = freeList_;
+    node.height_ = -1;
+    freeList_ = index;
+}
+
+void AABBTree::LinkLeaf(unsigned leaf)
+{
+    if (root_ == NULL_NODE)
+    {
+        root_ = leaf;
+        nodes_[leaf].parent_ = NULL_NODE;
+        return;
+    }
+
+    // Descend towards the sibling that minimizes the total surface area of the tree. Making a new parent for the leaf and
+    // the current node costs twice the combined area, while descending costs the area increase of the current node
+    BoundingBox leafBox = nodes_[leaf].GetBox();
+    unsigned index = root_;
+    while (!nodes_[index].IsLeaf())
+    {
+        const AABBTreeNode& node = nodes_[index];
+        float area = HalfArea(node.GetBox());
+        float combinedArea = HalfArea(Union(node.GetBox(), leafBox));
+        float cost = 2.0f * combinedArea;
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        const AABBTreeNode& child1 = nodes_[node.child1_];
+        float cost1 = HalfArea(Union(child1.GetBox(), leafBox)) + inheritanceCost;
+        if (!child1.IsLeaf())
+            cost1 -= HalfArea(child1.GetBox());
+
+        const AABBTreeNode& child2 = nodes_[node.child2_];
+        float cost2 = HalfArea(Union(child2.GetBox(), leafBox)) + inheritanceCost;
+        if (!child2.IsLeaf())
+            cost2 -= HalfArea(child2.GetBox());
+
+        if (cost < cost1 && cost < cost2)
+            break;
+
+        index = cost1 < cost2 ? node.child1_ : node.child2_;
+    }
+
+    // Create a new parent for the leaf and the sibling. Allocating may move the nodes, so do not hold references over it
+    unsigned sibling = index;
+    unsigned oldParent = nodes_[sibling].parent_;
+    unsigned newParent = AllocateNode();
+    AABBTreeNode& parentNode = nodes_[newParent];
+    parentNode.parent_ = oldParent;
+    parentNode.SetBox(Union(leafBox, nodes_[sibling].GetBox()));
+    parentNode.height_ = nodes_[sibling].height_ + 1;
+    parentNode.child1_ = sibling;
+    parentNode.child2_ = leaf;
+
+    if (oldParent != NULL_NODE)
+    {
+        AABBTreeNode& oldParentNode = nodes_[oldParent];
+        if (oldParentNode.child1_ == sibling)
+            oldParentNode.child1_ = newParent;
+        else
+            oldParentNode.child2_ = newParent;
+    }
+    else
+        root_ = newParent;
+
+    nodes_[sibling].parent_ = newParent;
+    nodes_[leaf].parent_ = newParent;
+
+    Refit(newParent);
+}
+
+void AABBTree::UnlinkLeaf(unsigned leaf)
+{
+    if (leaf == root_)
+    {
+        root_ = NULL_NODE;
+        return;
+    }
+
+    // Replace the parent with the sibling
+    unsigned parent = nodes_[leaf].parent_;
+    unsigned grandParent = nodes_[parent].parent_;
+    unsigned sibling = nodes_[parent].child1_ == leaf ? nodes_[parent].child2_ : nodes_[parent].child1_;
+
+    if (grandParent != NULL_NODE)
+    {
+        AABBTreeNode& grandParentNode = nodes_[grandParent];
+        if (grandParentNode.child1_ == parent)
+            grandParentNode.child1_ = sibling;
+        else
+            grandParentNode.child2_ = sibling;
+    }
+    else
+        root_ = sibling;
+
+    nodes_[sibling].parent_ = grandParent;
+    nodes_[leaf].parent_ = NULL_NODE;
+    FreeNode(parent);
+
+    Refit(grandParent);
+}
+
+void AABBTree::Refit(unsigned index)
+{
+    unsigned start = index;
+    while (index != NULL_NODE)
+    {
+        unsigned balanced = Balance(index);
+
+        AABBTreeNode& node = nodes_[balanced];
+        const AABBTreeNode& child1 = nodes_[node.child1_];
+        const AABBTreeNode& child2 = nodes_[node.child2_];
+        int height = 1 + Max(child1.height_, child2.height_);
+        BoundingBox box = Union(child1.GetBox(), child2.GetBox());
+
+        // If an ancestor was not rotated and neither its box nor height changed, the rest are up to date. The first node
+        // may have been set up by the caller already
+        if (index != start && balanced == index && height == node.height_ && box.min_ == node.min_ && box.max_ == node.max_)
+            return;
+
+        node.height_ = height;
+        node.SetBox(box);
+        index = node.parent_;
+    }
+}
+
+unsigned AABBTree::Balance(unsigned indexA)
+{
+    AABBTreeNode& a = nodes_[indexA];
+    if (a.IsLeaf() || a.height_ < 2)
+        return indexA;
+
+    unsigned indexB = a.child1_;
+    unsigned indexC = a.child2_;
+    AABBTreeNode& b = nodes_[indexB];
+    AABBTreeNode& c = nodes_[indexC];
+    int balance = c.height_ - b.height_;
+
+    // Rotate C up
+    if (balance > 1)
+    {
+        unsigned indexF = c.child1_;
+        unsigned indexG = c.child2_;
+        AABBTreeNode& f = nodes_[indexF];
+        AABBTreeNode& g = nodes_[indexG];
+
+        c.child1_ = indexA;
+        c.parent_ = a.parent_;
+        a.parent_ = indexC;
+
+        if (c.parent_ != NULL_NODE)
+        {
+            AABBTreeNode& parent = nodes_[c.parent_];
+            if (parent.child1_ == indexA)
+                parent.child1_ = indexC;
+            else
+                parent.child2_ = indexC;
+        }
+        else
+            root_ = indexC;
+
+        // Keep the taller grandchild under C
+        if (f.height_ > g.height_)
+        {
+            c.child2_ = indexF;
+            a.child2_ = indexG;
+            g.parent_ = indexA;
+            a.SetBox(Union(b.GetBox(), g.GetBox()));
+            c.SetBox(Union(a.GetBox(), f.GetBox()));
+            a.height_ = 1 + Max(b.height_, g.height_);
+            c.height_ = 1 + Max(a.height_, f.height_);
+        }
+        else
+        {
+            c.child2_ = indexG;
+            a.child2_ = indexF;
+            f.parent_ = indexA;
+            a.SetBox(Union(b.GetBox(), f.GetBox()));
+            c.SetBox(Union(a.GetBox(), g.GetBox()));
+            a.height_ = 1 + Max(b.height_, f.height_);
+            c.height_ = 1 + Max(a.height_, g.height_);
+        }
+
+        return indexC;
+    }
+
+    // Rotate B up
+    if (balance < -1)
+    {
+        unsigned indexD = b.child1_;
+        unsigned indexE = b.child2_;
+        AABBTreeNode& d = nodes_[indexD];
+        AABBTreeNode& e = nodes_[indexE];
+
+        b.child1_ = indexA;
+        b.parent_ = a.parent_;
+        a.parent_ = indexB;
+
+        if (b.parent_ != NULL_NODE)
+        {
+            AABBTreeNode& parent = nodes_[b.parent_];
+            if (parent.child1_ == indexA)
+                parent.child1_ = indexB;
+            else
+                parent.child2_ = indexB;
+        }
+        else
+            root_ = indexB;
+
+        // Keep the taller grandchild under B
+        if (d.height_ > e.height_)
+        {
+            b.child2_ = indexD;
+            a.child1_ = indexE;
+            e.parent_ = indexA;
+            a.SetBox(Union(c.GetBox(), e.GetBox()));
+            b.SetBox(Union(a.GetBox(), d.GetBox()));
+            a.height_ = 1 + Max(c.height_, e.height_);
+            b.height_ = 1 + Max(a.height_, d.height_);
+        }
+        else
+        {
+            b.child2_ = indexE;
+            a.child1_ = indexD;
+            d.parent_ = indexA;
+            a.SetBox(Union(c.GetBox(), d.GetBox()));
+            b.SetBox(Union(a.GetBox(), e.GetBox()));
+            a.height_ = 1 + Max(c.height_, d.height_);
+            b.height_ = 1 + Max(a.height_, e.height_);
+        }
+
+        return indexB;
+    }
+
+    return indexA;
+}
+
+}
@@ -0,0 +1,168 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/Vector.h"
+#include "../Math/BoundingBox.h"
+
+namespace Urho3D
+{
+
+class Drawable;
+
+/// Default enlargement of the leaf bounding boxes of an AABB tree.
+static const float DEFAULT_AABB_TREE_MARGIN = 0.25f;
+/// Maximum tree height that can be traversed without allocating.
+static const unsigned AABB_TREE_STACK_SIZE = 64;
+
+/// Node of an AABB tree. Trivially copyable, so that the node vector can move the nodes with memcpy.
+struct AABBTreeNode
+{
+    /// Return whether is a leaf node.
+    bool IsLeaf() const { return child1_ == M_MAX_UNSIGNED; }
+    /// Return bounding box.
+    BoundingBox GetBox() const { return BoundingBox(min_, max_); }
+    /// Set bounding box.
+    void SetBox(const BoundingBox& box)
+    {
+        min_ = box.min_;
+        max_ = box.max_;
+    }
+
+    /// Bounding box minimum. Leaf boxes are enlarged by the tree margin.
+    Vector3 min_;
+    /// Bounding box maximum.
+    Vector3 max_;
+    /// Drawable object of a leaf node.
+    Drawable* drawable_;
+    /// Parent node index, or next free node index for unused nodes.
+    unsigned parent_;
+    /// First child node index.
+    unsigned child1_;
+    /// Second child node index.
+    unsigned child2_;
+    /// Height of the subtree. Zero for leaf nodes and negative for unused nodes.
+    int height_;
+};
+
+/// Dynamic bounding volume hierarchy of drawable objects. Leaves store enlarged bounding boxes, so that objects moving
+/// within the margin do not modify the tree. Other moves enlarge the leaf also in the direction of movement by up to its
+/// size, and reinsert it unless its parent still encloses it. Reinsertion refits the ancestors, which are kept balanced
+/// by rotations, up to the first one that does not change.
+class URHO3D_API AABBTree
+{
+public:
+    /// Null node index.
+    static const unsigned NULL_NODE = M_MAX_UNSIGNED;
+
+    /// Construct empty.
+    AABBTree();
+
+    /// Insert a drawable object with bounding box. Return the leaf node index.
+    unsigned InsertLeaf(Drawable* drawable, const BoundingBox& box);
+    /// Remove a leaf node.
+    void RemoveLeaf(unsigned leaf);
+    /// Update the bounding box of a leaf node. Return true if the leaf was reinserted.
+    bool MoveLeaf(unsigned leaf, const BoundingBox& box);
+    /// Remove all nodes.
+    void Clear();
+    /// Set enlargement of the leaf bounding boxes. Affects leaves inserted afterwards.
+    void SetMargin(float margin) { margin_ = Max(margin, 0.0f); }
+
+    /// Return whether a bounding box still fits the enlarged bounding box of a leaf node.
+    bool CheckLeafFit(unsigned leaf, const BoundingBox& box) const { return nodes_[leaf].GetBox().IsInside(box) == INSIDE; }
+    /// Return enlargement of the leaf bounding boxes.
+    float GetMargin() const { return margin_; }
+    /// Return root node index, or NULL_NODE if empty.
+    unsigned GetRoot() const { return root_; }
+    /// Return node by index.
+    const AABBTreeNode& GetNode(unsigned index) const { return nodes_[index]; }
+    /// Return number of leaf nodes.
+    unsigned GetNumLeaves() const { return numLeaves_; }
+    /// Return height of the tree.
+    unsigned GetHeight() const { return root_ != NULL_NODE ? (unsigned)nodes_[root_].height_ : 0; }
+
+    /// Traverse the nodes depth first. The visitor is called with each node and the state returned for its parent, and
+    /// returns the state passed to the children, or a negative value to skip them.
+    template <class T> void Traverse(T visitor, int rootState = 0) const
+    {
+        if (root_ == NULL_NODE)
+            return;
+
+        // Depth first traversal needs at most one stack entry per level in addition to the root
+        unsigned stackBuffer[AABB_TREE_STACK_SIZE * 2];
+        PODVector<unsigned> stackVector;
+        unsigned* stack = stackBuffer;
+        unsigned height = GetHeight();
+        if (height >= AABB_TREE_STACK_SIZE)
+        {
+            stackVector.Resize((height + 1) * 2);
+            stack = &stackVector[0];
+        }
+
+        unsigned size = 0;
+        stack[size++] = root_;
+        stack[size++] = (unsigned)rootState;
+        while (size)
+        {
+            int state = (int)stack[--size];
+            const AABBTreeNode& node = nodes_[stack[--size]];
+            state = visitor(node, state);
+            if (state >= 0 && !node.IsLeaf())
+            {
+                stack[size++] = node.child2_;
+                stack[size++] = (unsigned)state;
+                stack[size++] = node.child1_;
+                stack[size++] = (unsigned)state;
+            }
+        }
+    }
+
+private:
+    /// Allocate a node from the free list.
+    unsigned AllocateNode();
+    /// Return a node to the free list.
+    void FreeNode(unsigned index);
+    /// Link a leaf node to the tree at the position of least surface area increase.
+    void LinkLeaf(unsigned leaf);
+    /// Unlink a leaf node from the tree.
+    void UnlinkLeaf(unsigned leaf);
+    /// Rebalance and refit the bounding boxes of a node and its ancestors, stopping at the first unchanged ancestor.
+    void Refit(unsigned index);
+    /// Rotate the subtree of a node if unbalanced. Return the index of the node now at its position.
+    unsigned Balance(unsigned index);
+
+    /// Nodes, including unused ones.
+    PODVector<AABBTreeNode> nodes_;
+    /// Root node index.
+    unsigned root_;
+    /// First unused node index.
+    unsigned freeList_;
+    /// Number of leaf nodes.
+    unsigned numLeaves_;
+    /// Enlargement of the leaf bounding boxes.
+    float margin_;
+};
+
+}
@@ -42,6 +42,10 @@
 #include "../Resource/ResourceEvents.h"
 #include "../Scene/Scene.h"
 
+#ifdef URHO3D_SSE
+#include <xmmintrin.h>
+#endif
+
 #include "../DebugNew.h"
 
 namespace Urho3D
@@ -67,6 +71,14 @@ static bool CompareAnimationOrder(const SharedPtr<AnimationState>& lhs, const Sh
 
 static const unsigned MAX_ANIMATION_STATES = 256;
 
+#ifdef URHO3D_SSE
+/// Return a weighted 3-component morph delta as a 4-component vector with zero in the last component.
+static inline __m128 LoadMorphDelta(const float* src, __m128 weight)
+{
+    return _mm_mul_ps(_mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)src), _mm_load_ss(src + 2)), weight);
+}
+#endif
+
 AnimatedModel::AnimatedModel(Context* context) :
     StaticModel(context),
     animationLodFrameNumber_(0),
@@ -78,6 +90,7 @@ AnimatedModel::AnimatedModel(Context* context) :
     animationDirty_(false),
     animationOrderDirty_(false),
     morphsDirty_(false),
+    morphsUploadPending_(false),
     skinningDirty_(true),
     boneBoundingBoxDirty_(true),
     isMaster_(true),
@@ -310,11 +323,32 @@ void AnimatedModel::UpdateGeometry(const FrameInfo& frame)
         UpdateSkinning();
 }
 
+void AnimatedModel::FinishUpdateGeometry(const FrameInfo& frame)
+{
+    if (!morphsUploadPending_)
+        return;
+
+    for (unsigned i = 0; i < morphVertexBuffers_.Size(); ++i)
+    {
+        VertexBuffer* buffer = morphVertexBuffers_[i];
+        if (buffer)
+        {
+            unsigned morphStart = model_->GetMorphRangeStart(i);
+            buffer->SetDataRange(buffer->GetShadowData() + morphStart * buffer->GetVertexSize(), morphStart,
+                model_->GetMorphRangeCount(i));
+        }
+    }
+
+    morphsUploadPending_ = false;
+}
+
 UpdateGeometryType AnimatedModel::GetUpdateGeometryType()
 {
-    if (morphsDirty_ || forceAnimationUpdate_)
+    // Animation touches the bone nodes, so it must be applied in the main thread. Morphs are applied to the shadow data
+    // in a worker thread and uploaded in FinishUpdateGeometry()
+    if (forceAnimationUpdate_)
         return UPDATE_MAIN_THREAD;
-    else if (skinningDirty_)
+    else if (morphsDirty_ || skinningDirty_)
         return UPDATE_WORKER_THREAD;
     else
         return UPDATE_NONE;
@@ -369,6 +403,8 @@ void AnimatedModel::SetModel(Model* model, bool createBones)
 
         // Copy morphs. Note: morph vertex buffers will be created later on-demand
         morphVertexBuffers_.Clear();
+        morphBaseData_.Clear();
+        morphsUploadPending_ = false;
         morphs_.Clear();
         const Vector<ModelMorph>& morphs = model->GetMorphs();
         morphs_.Reserve(morphs.Size());
@@ -431,6 +467,8 @@ void AnimatedModel::SetModel(Model* model, bool createBones)
         SetNumGeometries(0);
         geometryBoneMappings_.Clear();
         morphVertexBuffers_.Clear();
+        morphBaseData_.Clear();
+        morphsUploadPending_ = false;
         morphs_.Clear();
         morphElementMask_ = MASK_NONE;
         SetBoundingBox(BoundingBox());
@@ -1107,6 +1145,7 @@ void AnimatedModel::CloneGeometries()
     const Vector<SharedPtr<VertexBuffer> >& originalVertexBuffers = model_->GetVertexBuffers();
     HashMap<VertexBuffer*, SharedPtr<VertexBuffer> > clonedVertexBuffers;
     morphVertexBuffers_.Resize(originalVertexBuffers.Size());
+    morphBaseData_.Resize(originalVertexBuffers.Size());
 
     for (unsigned i = 0; i < originalVertexBuffers.Size(); ++i)
     {
@@ -1124,9 +1163,18 @@ void AnimatedModel::CloneGeometries()
             }
             clonedVertexBuffers[original] = clone;
             morphVertexBuffers_[i] = clone;
+
+            // Keep the unmorphed morph range, so that it can be restored with one copy before applying the morphs
+            const unsigned char* morphRange = clone->GetShadowData() + model_->GetMorphRangeStart(i) * clone->GetVertexSize();
+            morphBaseData_[i].Resize(model_->GetMorphRangeCount(i) * clone->GetVertexSize());
+            if (!morphBaseData_[i].Empty())
+                memcpy(morphBaseData_[i].Buffer(), morphRange, morphBaseData_[i].Size());
         }
         else
+        {
             morphVertexBuffers_[i].Reset();
+            morphBaseData_[i].Clear();
+        }
     }
 
     // Geometries will always be cloned fully. They contain only references to buffer, so they are relatively light
@@ -1341,43 +1389,34 @@ void AnimatedModel::UpdateSkinning()
 
 void AnimatedModel::UpdateMorphs()
 {
-    auto* graphics = GetSubsystem<Graphics>();
-    if (!graphics)
-        return;
-
     if (morphs_.Size())
     {
-        // Reset the morph data range from all morphable vertex buffers, then apply morphs
+        // Reset the morph data range from all morphable vertex buffers, then apply morphs. Only the shadow data is written
+        // here, as this may run in a worker thread
         for (unsigned i = 0; i < morphVertexBuffers_.Size(); ++i)
         {
             VertexBuffer* buffer = morphVertexBuffers_[i];
-            if (buffer)
+            if (buffer && buffer->GetShadowData())
             {
-                VertexBuffer* originalBuffer = model_->GetVertexBuffers()[i];
                 unsigned morphStart = model_->GetMorphRangeStart(i);
-                unsigned morphCount = model_->GetMorphRangeCount(i);
+                unsigned char* dest = buffer->GetShadowData() + morphStart * buffer->GetVertexSize();
+                const PODVector<unsigned char>& baseData = morphBaseData_[i];
+                if (!baseData.Empty())
+                    memcpy(dest, baseData.Buffer(), baseData.Size());
 
-                void* dest = buffer->Lock(morphStart, morphCount);
-                if (dest)
+                for (unsigned j = 0; j < morphs_.Size(); ++j)
                 {
-                    // Reset morph range by copying data from the original vertex buffer
-                    CopyMorphVertices(dest, originalBuffer->GetShadowData() + morphStart * originalBuffer->GetVertexSize(),
-                        morphCount, buffer, originalBuffer);
-
-                    for (unsigned j = 0; j < morphs_.Size(); ++j)
+                    if (morphs_[j].weight_ != 0.0f)
                     {
-                        if (morphs_[j].weight_ != 0.0f)
-                        {
-                            HashMap<unsigned, VertexBufferMorph>::Iterator k = morphs_[j].buffers_.Find(i);
-                            if (k != morphs_[j].buffers_.End())
-                                ApplyMorph(buffer, dest, morphStart, k->second_, morphs_[j].weight_);
-                        }
+                        HashMap<unsigned, VertexBufferMorph>::Iterator k = morphs_[j].buffers_.Find(i);
+                        if (k != morphs_[j].buffers_.End())
+                            ApplyMorph(buffer, dest, morphStart, k->second_, morphs_[j].weight_);
                     }
-
-                    buffer->Unlock();
                 }
             }
         }
+
+        morphsUploadPending_ = true;
     }
 
     morphsDirty_ = false;
@@ -1395,11 +1434,56 @@ void AnimatedModel::ApplyMorph(VertexBuffer* buffer, void* destVertexData, unsig
     unsigned char* srcData = morph.morphData_;
     auto* destData = (unsigned char*)destVertexData;
 
+#ifdef URHO3D_SSE
+    // All but the last vertex of the buffer are followed by another vertex, so their elements can be written 4 floats at a time
+    const __m128 weights = _mm_set1_ps(weight);
+    unsigned lastVertexIndex = buffer->GetVertexCount() - 1 - morphRangeStart;
+#endif
+
     while (vertexCount--)
     {
         unsigned vertexIndex = *((unsigned*)srcData) - morphRangeStart;
         srcData += sizeof(unsigned);
 
+#ifdef URHO3D_SSE
+        if (vertexIndex < lastVertexIndex)
+        {
+            // Load all elements before storing any: the stores overlap the following element by one float, and storing in
+            // ascending offset order writes that float correctly last. Loading after an overlapping store would also stall
+            unsigned char* vertex = destData + vertexIndex * vertexSize;
+            auto* dest = (float*)vertex;
+            float* normalDest = nullptr;
+            float* tangentDest = nullptr;
+            const auto* src = (const float*)srcData;
+            __m128 position, normal, tangent;
+            if (elementMask & MASK_POSITION)
+            {
+                position = _mm_add_ps(_mm_loadu_ps(dest), LoadMorphDelta(src, weights));
+                src += 3;
+            }
+            if (elementMask & MASK_NORMAL)
+            {
+                normalDest = (float*)(vertex + normalOffset);
+                normal = _mm_add_ps(_mm_loadu_ps(normalDest), LoadMorphDelta(src, weights));
+                src += 3;
+            }
+            if (elementMask & MASK_TANGENT)
+            {
+                tangentDest = (float*)(vertex + tangentOffset);
+                tangent = _mm_add_ps(_mm_loadu_ps(tangentDest), LoadMorphDelta(src, weights));
+                src += 3;
+            }
+            if (elementMask & MASK_POSITION)
+                _mm_storeu_ps(dest, position);
+            if (elementMask & MASK_NORMAL)
+                _mm_storeu_ps(normalDest, normal);
+            if (elementMask & MASK_TANGENT)
+                _mm_storeu_ps(tangentDest, tangent);
+            srcData = (unsigned char*)src;
+            continue;
+        }
+#endif
+
         if (elementMask & MASK_POSITION)
         {
             auto* dest = (float*)(destData + vertexIndex * vertexSize);
@@ -63,6 +63,8 @@ public:
     void UpdateBatches(const FrameInfo& frame) override;
     /// Prepare geometry for rendering. Called from a worker thread if possible (no GPU update.)
     void UpdateGeometry(const FrameInfo& frame) override;
+    /// Upload the morphed vertices to the GPU. Called from the main thread.
+    void FinishUpdateGeometry(const FrameInfo& frame) override;
     /// Return whether a geometry update is necessary, and if it can happen in a worker thread.
     UpdateGeometryType GetUpdateGeometryType() override;
     /// Visualize the component as debug geometry.
@@ -201,7 +203,7 @@ private:
     void UpdateAnimation(const FrameInfo& frame);
     /// Recalculate skinning.
     void UpdateSkinning();
-    /// Reapply all vertex morphs.
+    /// Reapply all vertex morphs to the shadow data of the morph vertex buffers. May be called from a worker thread.
     void UpdateMorphs();
     /// Apply a vertex morph.
     void ApplyMorph
@@ -213,6 +215,8 @@ private:
     Skeleton skeleton_;
     /// Morph vertex buffers.
     Vector<SharedPtr<VertexBuffer> > morphVertexBuffers_;
+    /// Unmorphed vertex data of the morph ranges, in the layout of the morph vertex buffers.
+    Vector<PODVector<unsigned char> > morphBaseData_;
     /// Vertex morphs.
     Vector<ModelMorph> morphs_;
     /// Animation states.
@@ -247,6 +251,8 @@ private:
     bool animationOrderDirty_;
     /// Vertex morphs dirty flag.
     bool morphsDirty_;
+    /// Morphed vertices waiting for GPU upload flag.
+    bool morphsUploadPending_;
     /// Skinning dirty flag.
     bool skinningDirty_;
     /// Bone bounding box dirty flag.
@@ -22,10 +22,13 @@
 
 #include "../Precompiled.h"
 
+#include "../Container/RadixSort.h"
+#include "../Core/WorkQueue.h"
 #include "../Graphics/Camera.h"
 #include "../Graphics/Geometry.h"
 #include "../Graphics/Graphics.h"
 #include "../Graphics/GraphicsImpl.h"
+#include "../Graphics/InstanceDataPool.h"
 #include "../Graphics/Material.h"
 #include "../Graphics/Renderer.h"
 #include "../Graphics/ShaderVariation.h"
@@ -40,6 +43,13 @@
 namespace Urho3D
 {
 
+/// Minimum number of draw calls or instances to sort with radix sort instead of comparison sort.
+static const unsigned RADIX_SORT_THRESHOLD = 256;
+/// Minimum number of draw calls per thread to radix sort in parallel.
+static const unsigned PARALLEL_SORT_CHUNK_SIZE = 4096;
+/// Maximum number of draw calls to radix sort by state, limited by the bits of the remapped shader ID.
+static const unsigned MAX_RADIX_SORT_STATE_BATCHES = 1u << 23u;
+
 inline bool CompareBatchesState(Batch* lhs, Batch* rhs)
 {
     if (lhs->renderOrder_ != rhs->renderOrder_)
@@ -80,6 +90,38 @@ inline bool CompareBatchGroupOrder(BatchGroup* lhs, BatchGroup* rhs)
     return lhs->renderOrder_ < rhs->renderOrder_;
 }
 
+/// Return radix sort key for sorting by render order and then front to back.
+inline unsigned long long GetFrontToBackKey(const Batch* batch)
+{
+    return (((unsigned long long)batch->renderOrder_) << 32u) | FloatToRadixKey(batch->distance_);
+}
+
+/// Return radix sort key for sorting by render order and then back to front.
+inline unsigned long long GetBackToFrontKey(const Batch* batch)
+{
+    return (((unsigned long long)batch->renderOrder_) << 32u) | ~FloatToRadixKey(batch->distance_);
+}
+
+/// Radix sort items, splitting the work to the worker threads if there are enough items.
+template <class T> static void RadixSortItems(unsigned long long* keys, T* items, unsigned count, unsigned long long* tempKeys,
+    T* tempItems, unsigned keyBits, WorkQueue* workQueue)
+{
+    unsigned numChunks = workQueue ? Min(workQueue->GetNumThreads() + 1, count / PARALLEL_SORT_CHUNK_SIZE) : 1;
+    if (numChunks > 1)
+    {
+        RadixSort(keys, items, count, tempKeys, tempItems, keyBits, numChunks, [workQueue](unsigned n, const auto& function)
+        {
+            workQueue->ParallelFor(n, 1, [&function](unsigned begin, unsigned end, unsigned threadIndex)
+            {
+                for (unsigned i = begin; i < end; ++i)
+                    function(i);
+            });
+        });
+    }
+    else
+        RadixSort(keys, items, count, tempKeys, tempItems, keyBits);
+}
+
 void CalculateShadowMatrix(Matrix4& dest, LightBatchQueue* queue, unsigned split, Renderer* renderer)
 {
     Camera* shadowCamera = queue->shadowSplits_[split].shadowCamera_;
@@ -642,10 +684,18 @@ void Batch::Draw(View* view, Camera* camera, bool allowDepthWrite) const
     }
 }
 
+void BatchGroup::PlaceInstances(InstanceDataPool& pool, unsigned groupKey)
+{
+    if (geometryType_ != GEOM_INSTANCED || instances_.Empty())
+        return;
+
+    persistentStart_ = pool.PlaceInstances(groupKey, instances_.Buffer(), instances_.Size());
+}
+
 void BatchGroup::SetInstancingData(void* lockedData, unsigned stride, unsigned& freeIndex)
 {
-    // Do not use up buffer space if not going to draw as instanced
-    if (geometryType_ != GEOM_INSTANCED)
+    // Do not use up buffer space if not going to draw as instanced, or drawn from the persistent buffer
+    if (geometryType_ != GEOM_INSTANCED || persistentStart_ != M_MAX_UNSIGNED)
         return;
 
     startIndex_ = freeIndex;
@@ -672,9 +722,12 @@ void BatchGroup::Draw(View* view, Camera* camera, bool allowDepthWrite) const
 
     if (instances_.Size() && !geometry_->IsEmpty())
     {
-        // Draw as individual objects if instancing not supported or could not fill the instancing buffer
+        // Draw as individual objects if instancing not supported or could not fill the instancing buffers
         VertexBuffer* instanceBuffer = renderer->GetInstancingBuffer();
-        if (!instanceBuffer || geometryType_ != GEOM_INSTANCED || startIndex_ == M_MAX_UNSIGNED)
+        VertexBuffer* persistentBuffer = renderer->GetPersistentInstancingBuffer();
+        const unsigned numFrameInstances = GetNumFrameInstances();
+        if (!instanceBuffer || geometryType_ != GEOM_INSTANCED || (numFrameInstances && startIndex_ == M_MAX_UNSIGNED) ||
+            (persistentStart_ != M_MAX_UNSIGNED && !persistentBuffer))
         {
             Batch::Prepare(view, camera, false, allowDepthWrite);
 
@@ -694,14 +747,16 @@ void BatchGroup::Draw(View* view, Camera* camera, bool allowDepthWrite) const
         {
             Batch::Prepare(view, camera, false, allowDepthWrite);
 
-            // Get the geometry vertex buffers, then add the instancing stream buffer
+            // Get the geometry vertex buffers, then add the instancing stream buffer, which is the persistent buffer if the
+            // instances were placed there
             // Hack: use a const_cast to avoid dynamic allocation of new temp vectors
             auto& vertexBuffers = const_cast<Vector<SharedPtr<VertexBuffer> >&>(
                 geometry_->GetVertexBuffers());
-            vertexBuffers.Push(SharedPtr<VertexBuffer>(instanceBuffer));
+            const bool persistent = persistentStart_ != M_MAX_UNSIGNED;
+            vertexBuffers.Push(SharedPtr<VertexBuffer>(persistent ? persistentBuffer : instanceBuffer));
 
             graphics->SetIndexBuffer(geometry_->GetIndexBuffer());
-            graphics->SetVertexBuffers(vertexBuffers, startIndex_);
+            graphics->SetVertexBuffers(vertexBuffers, persistent ? persistentStart_ : startIndex_);
             graphics->DrawInstanced(geometry_->GetPrimitiveType(), geometry_->GetIndexStart(), geometry_->GetIndexCount(),
                 geometry_->GetVertexStart(), geometry_->GetVertexCount(), instances_.Size());
 
@@ -725,46 +780,59 @@ void BatchQueue::Clear(int maxSortedInstances)
     maxSortedInstances_ = (unsigned)maxSortedInstances;
 }
 
-void BatchQueue::SortBackToFront()
+void BatchQueue::SortBackToFront(WorkQueue* workQueue)
 {
     sortedBatches_.Resize(batches_.Size());
 
     for (unsigned i = 0; i < batches_.Size(); ++i)
         sortedBatches_[i] = &batches_[i];
 
-    Sort(sortedBatches_.Begin(), sortedBatches_.End(), CompareBatchesBackToFront);
+    // Large queues are radix sorted. The sort is stable, so sort by state first, so that the draw calls at equal distance
+    // are ordered by state like with the comparison sort
+    if (sortedBatches_.Size() >= RADIX_SORT_THRESHOLD)
+    {
+        sortKeys_.Resize(sortedBatches_.Size());
+        for (unsigned i = 0; i < sortedBatches_.Size(); ++i)
+            sortKeys_[i] = sortedBatches_[i]->sortKey_;
+        RadixSortBatches(sortedBatches_, 64, workQueue);
+        for (unsigned i = 0; i < sortedBatches_.Size(); ++i)
+            sortKeys_[i] = GetBackToFrontKey(sortedBatches_[i]);
+        RadixSortBatches(sortedBatches_, 40, workQueue);
+    }
+    else
+        Sort(sortedBatches_.Begin(), sortedBatches_.End(), CompareBatchesBackToFront);
 
     sortedBatchGroups_.Resize(batchGroups_.Size());
 
     unsigned index = 0;
-    for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
+    for (FrameHashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
         sortedBatchGroups_[index++] = &i->second_;
 
     Sort(sortedBatchGroups_.Begin(), sortedBatchGroups_.End(), CompareBatchGroupOrder);
 }
 
-void BatchQueue::SortFrontToBack()
+void BatchQueue::SortFrontToBack(WorkQueue* workQueue)
 {
     sortedBatches_.Clear();
 
     for (unsigned i = 0; i < batches_.Size(); ++i)
         sortedBatches_.Push(&batches_[i]);
 
-    SortFrontToBack2Pass(sortedBatches_);
+    SortFrontToBack2Pass(sortedBatches_, workQueue);
 
     // Sort each group front to back
-    for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
+    for (FrameHashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
     {
         if (i->second_.instances_.Size() <= maxSortedInstances_)
         {
-            Sort(i->second_.instances_.Begin(), i->second_.instances_.End(), CompareInstancesFrontToBack);
+            SortInstances(i->second_);
             if (i->second_.instances_.Size())
                 i->second_.distance_ = i->second_.instances_[0].distance_;
         }
         else
         {
             float minDistance = M_INFINITY;
-            for (PODVector<InstanceData>::ConstIterator j = i->second_.instances_.Begin(); j != i->second_.instances_.End(); ++j)
+            for (FramePODVector<InstanceData>::ConstIterator j = i->second_.instances_.Begin(); j != i->second_.instances_.End(); ++j)
                 minDistance = Min(minDistance, j->distance_);
             i->second_.distance_ = minDistance;
         }
@@ -773,29 +841,40 @@ void BatchQueue::SortFrontToBack()
     sortedBatchGroups_.Resize(batchGroups_.Size());
 
     unsigned index = 0;
-    for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
+    for (FrameHashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
         sortedBatchGroups_[index++] = &i->second_;
 
-    SortFrontToBack2Pass(reinterpret_cast<PODVector<Batch*>& >(sortedBatchGroups_));
+    SortFrontToBack2Pass(reinterpret_cast<PODVector<Batch*>& >(sortedBatchGroups_), workQueue);
 }
 
-void BatchQueue::SortFrontToBack2Pass(PODVector<Batch*>& batches)
+void BatchQueue::SortFrontToBack2Pass(PODVector<Batch*>& batches, WorkQueue* workQueue)
 {
     // Mobile devices likely use a tiled deferred approach, with which front-to-back sorting is irrelevant. The 2-pass
     // method is also time consuming, so just sort with state having priority
 #ifdef GL_ES_VERSION_2_0
     Sort(batches.Begin(), batches.End(), CompareBatchesState);
 #else
-    // For desktop, first sort by distance and remap shader/material/geometry IDs in the sort key
-    Sort(batches.Begin(), batches.End(), CompareBatchesFrontToBack);
+    // For desktop, first sort by distance and remap shader/material/geometry IDs in the sort key. Large queues are radix
+    // sorted, in which case the second sort uses a key packed from the remapped IDs and relies on the first sort order to
+    // keep the draw calls with the same state front to back
+    bool radixSort = batches.Size() >= RADIX_SORT_THRESHOLD && batches.Size() < MAX_RADIX_SORT_STATE_BATCHES;
+    if (radixSort)
+    {
+        sortKeys_.Resize(batches.Size());
+        for (unsigned i = 0; i < batches.Size(); ++i)
+            sortKeys_[i] = GetFrontToBackKey(batches[i]);
+        RadixSortBatches(batches, 40, workQueue);
+    }
+    else
+        Sort(batches.Begin(), batches.End(), CompareBatchesFrontToBack);
 
     unsigned freeShaderID = 0;
     unsigned short freeMaterialID = 0;
     unsigned short freeGeometryID = 0;
 
-    for (PODVector<Batch*>::Iterator i = batches.Begin(); i != batches.End(); ++i)
+    for (unsigned i = 0; i < batches.Size(); ++i)
     {
-        Batch* batch = *i;
+        Batch* batch = batches[i];
 
         auto shaderID = (unsigned)(batch->sortKey_ >> 32u);
         HashMap<unsigned, unsigned>::ConstIterator j = shaderRemapping_.Find(shaderID);
@@ -807,7 +886,7 @@ void BatchQueue::SortFrontToBack2Pass(PODVector<Batch*>& batches)
             ++freeShaderID;
         }
 
-        auto materialID = (unsigned short)(batch->sortKey_ & 0xffff0000);
+        auto materialID = (unsigned short)((batch->sortKey_ >> 16u) & 0xffffu);
         HashMap<unsigned short, unsigned short>::ConstIterator k = materialRemapping_.Find(materialID);
         if (k != materialRemapping_.End())
             materialID = k->second_;
@@ -828,6 +907,11 @@ void BatchQueue::SortFrontToBack2Pass(PODVector<Batch*>& batches)
         }
 
         batch->sortKey_ = (((unsigned long long)shaderID) << 32u) | (((unsigned long long)materialID) << 16u) | geometryID;
+        if (radixSort)
+        {
+            sortKeys_[i] = (((unsigned long long)batch->renderOrder_) << 56u) | (((unsigned long long)(shaderID >> 31u)) << 55u) |
+                (((unsigned long long)(shaderID & 0x7fffffu)) << 32u) | (((unsigned long long)materialID) << 16u) | geometryID;
+        }
     }
 
     shaderRemapping_.Clear();
@@ -835,13 +919,48 @@ void BatchQueue::SortFrontToBack2Pass(PODVector<Batch*>& batches)
     geometryRemapping_.Clear();
 
     // Finally sort again with the rewritten ID's
-    Sort(batches.Begin(), batches.End(), CompareBatchesState);
+    if (radixSort)
+        RadixSortBatches(batches, 64, workQueue);
+    else
+        Sort(batches.Begin(), batches.End(), CompareBatchesState);
 #endif
 }
 
+void BatchQueue::RadixSortBatches(PODVector<Batch*>& batches, unsigned keyBits, WorkQueue* workQueue)
+{
+    unsigned count = batches.Size();
+    tempSortKeys_.Resize(count);
+    tempSortedBatches_.Resize(count);
+    RadixSortItems(sortKeys_.Buffer(), batches.Buffer(), count, tempSortKeys_.Buffer(), tempSortedBatches_.Buffer(), keyBits,
+        workQueue);
+}
+
+void BatchQueue::SortInstances(BatchGroup& group)
+{
+    FramePODVector<InstanceData>& instances = group.instances_;
+    unsigned count = instances.Size();
+    if (count >= RADIX_SORT_THRESHOLD)
+    {
+        sortKeys_.Resize(count);
+        tempSortKeys_.Resize(count);
+        tempInstances_.Resize(count);
+        for (unsigned i = 0; i < count; ++i)
+            sortKeys_[i] = FloatToRadixKey(instances[i].distance_);
+        RadixSort(sortKeys_.Buffer(), instances.Buffer(), count, tempSortKeys_.Buffer(), tempInstances_.Buffer(), 32);
+    }
+    else
+        Sort(instances.Begin(), instances.End(), CompareInstancesFrontToBack);
+}
+
+void BatchQueue::PlaceInstances(InstanceDataPool& pool, unsigned queueKey)
+{
+    for (FrameHashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
+        i->second_.PlaceInstances(pool, queueKey * 31 + i->first_.ToHash());
+}
+
 void BatchQueue::SetInstancingData(void* lockedData, unsigned stride, unsigned& freeIndex)
 {
-    for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
+    for (FrameHashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
         i->second_.SetInstancingData(lockedData, stride, freeIndex);
 }
 
@@ -892,10 +1011,10 @@ unsigned BatchQueue::GetNumInstances() const
 {
     unsigned total = 0;
 
-    for (HashMap<BatchGroupKey, BatchGroup>::ConstIterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
+    for (FrameHashMap<BatchGroupKey, BatchGroup>::ConstIterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
     {
         if (i->second_.geometryType_ == GEOM_INSTANCED)
-            total += i->second_.instances_.Size();
+            total += i->second_.GetNumFrameInstances();
     }
 
     return total;
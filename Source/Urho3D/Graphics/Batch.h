@@ -22,6 +22,8 @@
 
 #pragma once
 
+#include "../Container/FrameHashMap.h"
+#include "../Container/FrameVector.h"
 #include "../Container/Ptr.h"
 #include "../Graphics/Drawable.h"
 #include "../Graphics/Material.h"
@@ -35,6 +37,7 @@ namespace Urho3D
 class Camera;
 class Drawable;
 class Geometry;
+class InstanceDataPool;
 class Light;
 class Material;
 class Matrix3x4;
@@ -43,6 +46,7 @@ class ShaderVariation;
 class Texture2D;
 class VertexBuffer;
 class View;
+class WorkQueue;
 class Zone;
 struct LightBatchQueue;
 
@@ -84,6 +88,8 @@ struct Batch
     unsigned char lightMask_{};
     /// Base batch flag. This tells to draw the object fully without light optimizations.
     bool isBase_{};
+    /// Whether the drawable was moved, resized or added in the latest octree update.
+    bool changed_{};
     /// Geometry.
     Geometry* geometry_{};
     /// Material.
@@ -128,6 +134,17 @@ struct InstanceData
     const void* instancingData_{};
     /// Distance from camera.
     float distance_{};
+    /// Whether the drawable was moved, resized or added in the latest octree update.
+    bool changed_{};
+};
+
+/// Range of instances in an instancing buffer.
+struct InstanceRange
+{
+    /// First instance.
+    unsigned start_;
+    /// Number of instances.
+    unsigned count_;
 };
 
 /// Instanced 3D geometry draw call.
@@ -155,6 +172,7 @@ struct BatchGroup : public Batch
         InstanceData newInstance;
         newInstance.distance_ = batch.distance_;
         newInstance.instancingData_ = batch.instancingData_;
+        newInstance.changed_ = batch.changed_;
 
         for (unsigned i = 0; i < batch.numWorldTransforms_; ++i)
         {
@@ -163,15 +181,29 @@ struct BatchGroup : public Batch
         }
     }
 
-    /// Pre-set the instance data. Buffer must be big enough to hold all data.
+    /// Add instances from another group.
+    void AddInstances(const BatchGroup& group)
+    {
+        if (!group.instances_.Empty())
+            instances_.Push(group.instances_.Buffer(), group.instances_.Size());
+    }
+
+    /// Place the instances to the persistent instance data pool with a key identifying the group between frames. If the pool cannot take them, they are left for SetInstancingData().
+    void PlaceInstances(InstanceDataPool& pool, unsigned groupKey);
+    /// Pre-set the instance data if not placed to the persistent pool. Buffer must be big enough to hold all data.
     void SetInstancingData(void* lockedData, unsigned stride, unsigned& freeIndex);
     /// Prepare and draw.
     void Draw(View* view, Camera* camera, bool allowDepthWrite) const;
 
-    /// Instance data.
-    PODVector<InstanceData> instances_;
+    /// Return number of instances whose data is set each frame.
+    unsigned GetNumFrameInstances() const { return persistentStart_ == M_MAX_UNSIGNED ? instances_.Size() : 0; }
+
+    /// Instance data. Allocated from the frame allocator.
+    FramePODVector<InstanceData> instances_;
     /// Instance stream start index, or M_MAX_UNSIGNED if transforms not pre-set.
     unsigned startIndex_;
+    /// First slot of the instances in the persistent instancing buffer, or M_MAX_UNSIGNED if set each frame.
+    unsigned persistentStart_{M_MAX_UNSIGNED};
 };
 
 /// Instanced draw call grouping key.
@@ -228,24 +260,30 @@ struct BatchQueue
 public:
     /// Clear for new frame by clearing all groups and batches.
     void Clear(int maxSortedInstances);
-    /// Sort non-instanced draw calls back to front.
-    void SortBackToFront();
-    /// Sort instanced and non-instanced draw calls front to back.
-    void SortFrontToBack();
+    /// Sort non-instanced draw calls back to front. Large queues are sorted in parallel if a work queue is given.
+    void SortBackToFront(WorkQueue* workQueue = nullptr);
+    /// Sort instanced and non-instanced draw calls front to back. Large queues are sorted in parallel if a work queue is given.
+    void SortFrontToBack(WorkQueue* workQueue = nullptr);
     /// Sort batches front to back while also maintaining state sorting.
-    void SortFrontToBack2Pass(PODVector<Batch*>& batches);
+    void SortFrontToBack2Pass(PODVector<Batch*>& batches, WorkQueue* workQueue = nullptr);
+    /// Sort draw calls by the radix sort keys, which must have been filled for them.
+    void RadixSortBatches(PODVector<Batch*>& batches, unsigned keyBits, WorkQueue* workQueue);
+    /// Sort the instances of a group front to back.
+    void SortInstances(BatchGroup& group);
+    /// Place instances of all groups to the persistent instance data pool. The queue key tells apart the groups of different queues.
+    void PlaceInstances(InstanceDataPool& pool, unsigned queueKey);
     /// Pre-set instance data of all groups. The vertex buffer must be big enough to hold all data.
     void SetInstancingData(void* lockedData, unsigned stride, unsigned& freeIndex);
     /// Draw.
     void Draw(View* view, Camera* camera, bool markToStencil, bool usingLightOptimization, bool allowDepthWrite) const;
-    /// Return the combined amount of instances.
+    /// Return the combined amount of instances whose data is set each frame.
     unsigned GetNumInstances() const;
 
     /// Return whether the batch group is empty.
     bool IsEmpty() const { return batches_.Empty() && batchGroups_.Empty(); }
 
-    /// Instanced draw calls.
-    HashMap<BatchGroupKey, BatchGroup> batchGroups_;
+    /// Instanced draw calls. Allocated from the frame allocator.
+    FrameHashMap<BatchGroupKey, BatchGroup> batchGroups_;
     /// Shader remapping table for 2-pass state and distance sort.
     HashMap<unsigned, unsigned> shaderRemapping_;
     /// Material remapping table for 2-pass state and distance sort.
@@ -259,6 +297,14 @@ public:
     PODVector<Batch*> sortedBatches_;
     /// Sorted instanced draw calls.
     PODVector<BatchGroup*> sortedBatchGroups_;
+    /// Radix sort keys.
+    PODVector<unsigned long long> sortKeys_;
+    /// Radix sort temporary keys.
+    PODVector<unsigned long long> tempSortKeys_;
+    /// Radix sort temporary draw calls.
+    PODVector<Batch*> tempSortedBatches_;
+    /// Radix sort temporary instances.
+    PODVector<InstanceData> tempInstances_;
     /// Maximum sorted instances.
     unsigned maxSortedInstances_;
     /// Whether the pass command contains extra shader defines.
@@ -64,9 +64,15 @@ Drawable::Drawable(Context* context, DrawableFlags drawableFlags) :
     castShadows_(false),
     occluder_(false),
     occludee_(true),
+    hlodHidden_(false),
     updateQueued_(false),
+    nextQueuedUpdate_(nullptr),
     zoneDirty_(false),
     octant_(nullptr),
+    octantIndex_(0),
+    treeLeaf_(M_MAX_UNSIGNED),
+    changeRevision_(0),
+    changeIndex_(0),
     zone_(nullptr),
     viewMask_(DEFAULT_VIEWMASK),
     lightMask_(DEFAULT_LIGHTMASK),
@@ -95,7 +101,7 @@ Drawable::~Drawable()
 void Drawable::RegisterObject(Context* context)
 {
     URHO3D_ATTRIBUTE("Max Lights", int, maxLights_, 0, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("View Mask", int, viewMask_, DEFAULT_VIEWMASK, AM_DEFAULT);
+    URHO3D_ACCESSOR_ATTRIBUTE("View Mask", GetViewMask, SetViewMask, unsigned, DEFAULT_VIEWMASK, AM_DEFAULT);
     URHO3D_ATTRIBUTE("Light Mask", int, lightMask_, DEFAULT_LIGHTMASK, AM_DEFAULT);
     URHO3D_ATTRIBUTE("Shadow Mask", int, shadowMask_, DEFAULT_SHADOWMASK, AM_DEFAULT);
     URHO3D_ACCESSOR_ATTRIBUTE("Zone Mask", GetZoneMask, SetZoneMask, unsigned, DEFAULT_ZONEMASK, AM_DEFAULT);
@@ -187,6 +193,12 @@ void Drawable::SetLodBias(float bias)
 void Drawable::SetViewMask(unsigned mask)
 {
     viewMask_ = mask;
+    // The octant keeps a copy of the view mask for culling. Queue also an update, so that cached query results are refreshed
+    if (octant_)
+    {
+        octant_->UpdateCullingData(this);
+        MarkForUpdate();
+    }
     MarkNetworkUpdate();
 }
 
@@ -225,6 +237,7 @@ void Drawable::SetCastShadows(bool enable)
 void Drawable::SetOccluder(bool enable)
 {
     occluder_ = enable;
+    MarkForUpdate();
     MarkNetworkUpdate();
 }
 
@@ -246,6 +259,18 @@ void Drawable::MarkForUpdate()
         octant_->GetRoot()->QueueUpdate(this);
 }
 
+void Drawable::SetHLODHidden(bool hidden)
+{
+    if (hidden == hlodHidden_)
+        return;
+
+    hlodHidden_ = hidden;
+    if (hidden)
+        RemoveFromOctree();
+    else
+        AddToOctree();
+}
+
 const BoundingBox& Drawable::GetWorldBoundingBox()
 {
     if (worldBoundingBoxDirty_)
@@ -378,10 +403,17 @@ void Drawable::OnMarkedDirty(Node* node)
         zoneDirty_ = true;
 }
 
+void Drawable::MarkWorldBoundingBoxDirty()
+{
+    worldBoundingBoxDirty_ = true;
+    if (!updateQueued_ && octant_)
+        octant_->GetRoot()->QueueUpdate(this);
+}
+
 void Drawable::AddToOctree()
 {
-    // Do not add to octree when disabled
-    if (!IsEnabledEffective())
+    // Do not add to octree when disabled or replaced by a hierarchical LOD proxy
+    if (!IsEnabledEffective() || hlodHidden_)
         return;
 
     Scene* scene = GetScene();
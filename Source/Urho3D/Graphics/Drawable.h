@@ -26,6 +26,8 @@
 #include "../Math/BoundingBox.h"
 #include "../Scene/Component.h"
 
+#include <atomic>
+
 namespace Urho3D
 {
 
@@ -103,7 +105,7 @@ struct URHO3D_API SourceBatch
     const Matrix3x4* worldTransform_{&Matrix3x4::IDENTITY};
     /// Number of world transforms.
     unsigned numWorldTransforms_{1};
-    /// Per-instance data. If not null, must contain enough data to fill instancing buffer.
+    /// Per-instance data. If not null, must contain enough data to fill instancing buffer. With persistent instancing, call Drawable::MarkForUpdate() after changing it.
     void* instancingData_{};
     /// %Geometry type.
     GeometryType geometryType_{GEOM_STATIC};
@@ -153,6 +155,9 @@ public:
     /// Prepare geometry for rendering.
     virtual void UpdateGeometry(const FrameInfo& frame) { }
 
+    /// Finish a geometry update in the main thread, for example by uploading data prepared in a worker thread to the GPU. Called after all geometry updates of the view have completed.
+    virtual void FinishUpdateGeometry(const FrameInfo& frame) { }
+
     /// Return whether a geometry update is necessary, and if it can happen in a worker thread.
     virtual UpdateGeometryType GetUpdateGeometryType() { return UPDATE_NONE; }
 
@@ -191,6 +196,8 @@ public:
     void SetOccludee(bool enable);
     /// Mark for update and octree reinsertion. Update is automatically queued when the drawable's scene node moves or changes scale.
     void MarkForUpdate();
+    /// Set whether is hidden by a hierarchical LOD cluster. A hidden drawable is kept out of the octree, so it costs nothing to cull.
+    void SetHLODHidden(bool hidden);
 
     /// Return local space bounding box. May not be applicable or properly updated on all drawables.
     const BoundingBox& GetBoundingBox() const { return boundingBox_; }
@@ -234,6 +241,9 @@ public:
     /// Return occludee flag.
     bool IsOccludee() const { return occludee_; }
 
+    /// Return whether is hidden by a hierarchical LOD cluster.
+    bool IsHLODHidden() const { return hlodHidden_; }
+
     /// Return whether is in view this frame from any viewport camera. Excludes shadow map cameras.
     bool IsInView() const;
     /// Return whether is in view of a specific camera this frame. Pass in a null camera to allow any camera, including shadow map cameras.
@@ -330,6 +340,8 @@ protected:
     void OnSceneSet(Scene* scene) override;
     /// Handle node transform being dirtied.
     void OnMarkedDirty(Node* node) override;
+    /// Mark world-space bounding box dirty and queue octree reinsertion. Safe to call from worker threads.
+    void MarkWorldBoundingBoxDirty();
     /// Recalculate the world-space bounding box.
     virtual void OnWorldBoundingBoxUpdate() = 0;
 
@@ -360,12 +372,24 @@ protected:
     bool occluder_;
     /// Occludee flag.
     bool occludee_;
+    /// Hidden by a hierarchical LOD cluster flag.
+    bool hlodHidden_;
     /// Octree update queued flag.
-    bool updateQueued_;
+    std::atomic<bool> updateQueued_;
+    /// Next drawable in the octree update queue.
+    Drawable* nextQueuedUpdate_;
     /// Zone inconclusive or dirtied flag.
     bool zoneDirty_;
     /// Octree octant.
     Octant* octant_;
+    /// Index in the octant's drawables.
+    unsigned octantIndex_;
+    /// Leaf node index in the octree's AABB tree, or M_MAX_UNSIGNED if not in the tree.
+    unsigned treeLeaf_;
+    /// Octree update revision in which the drawable was last changed.
+    unsigned changeRevision_;
+    /// Index in the octree's changed drawables of the pending revision.
+    unsigned changeIndex_;
     /// Current zone.
     Zone* zone_;
     /// View mask.
@@ -0,0 +1,169 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Core/Context.h"
+#include "../Graphics/HLODBuilder.h"
+#include "../Graphics/HLODCluster.h"
+#include "../Graphics/Model.h"
+#include "../IO/FileSystem.h"
+#include "../IO/Log.h"
+#include "../Resource/ResourceCache.h"
+#include "../Scene/Node.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+HLODBuilder::HLODBuilder(Context* context) :
+    Object(context),
+    clusterSize_(DEFAULT_HLOD_CLUSTER_SIZE),
+    switchDistance_(DEFAULT_HLOD_SWITCH_DISTANCE),
+    triangleRatio_(DEFAULT_HLOD_TRIANGLE_RATIO),
+    maxError_(DEFAULT_HLOD_MAX_ERROR),
+    minMembers_(DEFAULT_HLOD_MIN_MEMBERS)
+{
+}
+
+HLODBuilder::~HLODBuilder() = default;
+
+void HLODBuilder::SetClusterSize(float size)
+{
+    clusterSize_ = Max(size, M_EPSILON);
+}
+
+void HLODBuilder::SetSwitchDistance(float distance)
+{
+    switchDistance_ = Max(distance, 0.0f);
+}
+
+void HLODBuilder::SetTriangleRatio(float ratio)
+{
+    triangleRatio_ = Clamp(ratio, 0.0f, 1.0f);
+}
+
+void HLODBuilder::SetMaxError(float error)
+{
+    maxError_ = Max(error, 0.0f);
+}
+
+void HLODBuilder::SetMinMembers(unsigned count)
+{
+    minMembers_ = Max(count, 1U);
+}
+
+void HLODBuilder::SetProxyPath(const String& fileSystemPath, const String& resourcePath)
+{
+    fileSystemPath_ = fileSystemPath.Empty() ? String::EMPTY : AddTrailingSlash(fileSystemPath);
+    resourcePath_ = resourcePath.Empty() ? String::EMPTY : AddTrailingSlash(resourcePath);
+}
+
+unsigned HLODBuilder::Build(Node* sourceRoot, Node* clusterRoot)
+{
+    if (!sourceRoot || !clusterRoot)
+    {
+        URHO3D_LOGERROR("Null source or cluster root node for building HLOD clusters");
+        return 0;
+    }
+
+    // Remove the previous clusters, which also restores their member drawables
+    PODVector<Node*> oldClusterNodes;
+    clusterRoot->GetChildrenWithComponent<HLODCluster>(oldClusterNodes);
+    for (unsigned i = 0; i < oldClusterNodes.Size(); ++i)
+        oldClusterNodes[i]->Remove();
+
+    // Assign the nodes of the static models to grid cells by their bounding box centers
+    PODVector<StaticModel*> staticModels;
+    sourceRoot->GetComponents<StaticModel>(staticModels, true);
+    HashMap<IntVector3, PODVector<Node*> > cells;
+    HashSet<Node*> assignedNodes;
+    for (unsigned i = 0; i < staticModels.Size(); ++i)
+    {
+        StaticModel* staticModel = staticModels[i];
+        Node* node = staticModel->GetNode();
+        if (!staticModel->GetModel() || !staticModel->IsEnabledEffective() || assignedNodes.Contains(node))
+            continue;
+
+        Vector3 center = staticModel->GetWorldBoundingBox().Center();
+        IntVector3 cell(FloorToInt(center.x_ / clusterSize_), FloorToInt(center.y_ / clusterSize_),
+            FloorToInt(center.z_ / clusterSize_));
+        cells[cell].Push(node);
+        assignedNodes.Insert(node);
+    }
+
+    unsigned numClusters = 0;
+    for (HashMap<IntVector3, PODVector<Node*> >::ConstIterator i = cells.Begin(); i != cells.End(); ++i)
+    {
+        const PODVector<Node*>& members = i->second_;
+        if (members.Size() < minMembers_)
+            continue;
+
+        BoundingBox box;
+        for (unsigned j = 0; j < members.Size(); ++j)
+            box.Merge(members[j]->GetWorldPosition());
+
+        Node* clusterNode = clusterRoot->CreateChild("HLODCluster");
+        clusterNode->SetWorldPosition(box.Center());
+        auto* cluster = clusterNode->CreateComponent<HLODCluster>();
+        cluster->SetSwitchDistance(switchDistance_);
+        for (unsigned j = 0; j < members.Size(); ++j)
+            cluster->AddMemberNode(members[j]);
+
+        if (!cluster->BakeProxy(triangleRatio_, maxError_))
+        {
+            clusterNode->Remove();
+            continue;
+        }
+
+        if (!fileSystemPath_.Empty())
+            SaveProxy(cluster, numClusters);
+        ++numClusters;
+    }
+
+    return numClusters;
+}
+
+bool HLODBuilder::SaveProxy(HLODCluster* cluster, unsigned index)
+{
+    Model* model = cluster->GetModel();
+    String fileName = "Proxy" + String(index) + ".mdl";
+
+    auto* fileSystem = GetSubsystem<FileSystem>();
+    if (fileSystem && !fileSystem->DirExists(fileSystemPath_))
+        fileSystem->CreateDir(fileSystemPath_);
+    if (!model->SaveFile(fileSystemPath_ + fileName))
+    {
+        URHO3D_LOGERROR("Failed to save HLOD proxy model " + fileSystemPath_ + fileName);
+        return false;
+    }
+
+    // Register under the resource name so that the cluster's model attribute refers to the saved file
+    model->SetName(resourcePath_ + fileName);
+    auto* cache = GetSubsystem<ResourceCache>();
+    if (cache)
+        cache->AddManualResource(model);
+    return true;
+}
+
+}
@@ -0,0 +1,100 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Core/Object.h"
+
+namespace Urho3D
+{
+
+class HLODCluster;
+class Node;
+
+/// Default size of the grid cells static models are clustered by.
+static const float DEFAULT_HLOD_CLUSTER_SIZE = 50.0f;
+/// Default triangle ratio of the baked proxy models.
+static const float DEFAULT_HLOD_TRIANGLE_RATIO = 0.25f;
+/// Default maximum simplification error of the baked proxy models, relative to the cluster size.
+static const float DEFAULT_HLOD_MAX_ERROR = 0.02f;
+/// Default minimum number of member nodes for creating a cluster.
+static const unsigned DEFAULT_HLOD_MIN_MEMBERS = 2;
+
+/// Offline builder of hierarchical LOD clusters. Clusters the static models under a scene node by a uniform grid and bakes a merged, simplified proxy model for each cluster.
+class URHO3D_API HLODBuilder : public Object
+{
+    URHO3D_OBJECT(HLODBuilder, Object);
+
+public:
+    /// Construct.
+    explicit HLODBuilder(Context* context);
+    /// Destruct.
+    ~HLODBuilder() override;
+
+    /// Set size of the grid cells static models are clustered by.
+    void SetClusterSize(float size);
+    /// Set camera distance beyond which the clusters draw their proxy models.
+    void SetSwitchDistance(float distance);
+    /// Set triangle ratio of the proxy models to the merged member geometry.
+    void SetTriangleRatio(float ratio);
+    /// Set maximum simplification error relative to the size of the merged geometry.
+    void SetMaxError(float error);
+    /// Set minimum number of member nodes for creating a cluster.
+    void SetMinMembers(unsigned count);
+    /// Set file system directory to save the proxy models to and the matching resource name prefix. When not set, the proxy models are only held in memory and are not saved with the scene.
+    void SetProxyPath(const String& fileSystemPath, const String& resourcePath);
+
+    /// Create a child node with an HLODCluster under clusterRoot for each grid cell of static models under sourceRoot, and bake the proxy models. Existing clusters under clusterRoot are removed first. Return the number of clusters created.
+    unsigned Build(Node* sourceRoot, Node* clusterRoot);
+
+    /// Return size of the grid cells.
+    float GetClusterSize() const { return clusterSize_; }
+    /// Return switch distance.
+    float GetSwitchDistance() const { return switchDistance_; }
+    /// Return triangle ratio.
+    float GetTriangleRatio() const { return triangleRatio_; }
+    /// Return maximum simplification error.
+    float GetMaxError() const { return maxError_; }
+    /// Return minimum number of member nodes.
+    unsigned GetMinMembers() const { return minMembers_; }
+
+private:
+    /// Save a baked proxy model and assign its resource name. Return true if successful.
+    bool SaveProxy(HLODCluster* cluster, unsigned index);
+
+    /// Grid cell size.
+    float clusterSize_;
+    /// Switch distance.
+    float switchDistance_;
+    /// Triangle ratio.
+    float triangleRatio_;
+    /// Maximum simplification error.
+    float maxError_;
+    /// Minimum number of member nodes.
+    unsigned minMembers_;
+    /// File system directory to save the proxy models to.
+    String fileSystemPath_;
+    /// Resource name prefix of the saved proxy models.
+    String resourcePath_;
+};
+
+}
@@ -0,0 +1,600 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Core/Context.h"
+#include "../Graphics/Camera.h"
+#include "../Graphics/Geometry.h"
+#include "../Graphics/HLODCluster.h"
+#include "../Graphics/IndexBuffer.h"
+#include "../Graphics/Material.h"
+#include "../Graphics/MeshOptimizer.h"
+#include "../Graphics/Model.h"
+#include "../Graphics/Octree.h"
+#include "../Graphics/VertexBuffer.h"
+#include "../Scene/Scene.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+extern const char* GEOMETRY_CATEGORY;
+
+static const StringVector memberNodesStructureElementNames =
+{
+    "Member Count",
+    "   NodeID"
+};
+
+/// Vertex of a proxy model being baked.
+struct HLODProxyVertex
+{
+    /// Position in cluster space.
+    Vector3 position_;
+    /// Normal in cluster space.
+    Vector3 normal_;
+    /// Texture coordinate.
+    Vector2 texCoord_;
+    /// Tangent in cluster space, with the binormal direction in W.
+    Vector4 tangent_;
+};
+
+/// Geometry of a proxy model being baked, merged from the source geometries sharing a material.
+struct HLODProxyGeometry
+{
+    /// Material.
+    SharedPtr<Material> material_;
+    /// Vertices.
+    PODVector<HLODProxyVertex> vertices_;
+    /// Triangle list indices.
+    PODVector<unsigned> indices_;
+};
+
+HLODCluster::HLODCluster(Context* context) :
+    StaticModel(context),
+    switchDistance_(DEFAULT_HLOD_SWITCH_DISTANCE),
+    proxyActive_(false),
+    membersDirty_(false),
+    memberIDsDirty_(false)
+{
+    // The member drawables are shown until the first switch
+    hlodHidden_ = true;
+    UpdateMemberIDs();
+}
+
+HLODCluster::~HLODCluster()
+{
+    if (octree_)
+    {
+        octree_->RemoveHLODCluster(this);
+        if (proxyActive_)
+        {
+            for (unsigned i = 0; i < memberNodes_.Size(); ++i)
+                SetMemberHidden(memberNodes_[i], false);
+        }
+    }
+}
+
+void HLODCluster::RegisterObject(Context* context)
+{
+    context->RegisterFactory<HLODCluster>(GEOMETRY_CATEGORY);
+
+    URHO3D_COPY_BASE_ATTRIBUTES(StaticModel);
+    URHO3D_ACCESSOR_ATTRIBUTE("Switch Distance", GetSwitchDistance, SetSwitchDistance, float, DEFAULT_HLOD_SWITCH_DISTANCE,
+        AM_DEFAULT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Member Nodes", GetMemberIDsAttr, SetMemberIDsAttr, VariantVector, Variant::emptyVariantVector,
+        AM_DEFAULT | AM_NODEIDVECTOR)
+        .SetMetadata(AttributeMetadata::P_VECTOR_STRUCT_ELEMENTS, memberNodesStructureElementNames);
+}
+
+void HLODCluster::ApplyAttributes()
+{
+    if (!membersDirty_)
+        return;
+
+    // Restore the old members before searching for new
+    if (proxyActive_)
+        SetProxyActive(false);
+    memberNodes_.Clear();
+
+    Scene* scene = GetScene();
+    if (scene)
+    {
+        // The first index stores the number of IDs redundantly. This is for editing
+        for (unsigned i = 1; i < memberIDsAttr_.Size(); ++i)
+        {
+            Node* node = scene->GetNode(memberIDsAttr_[i].GetUInt());
+            if (node)
+                memberNodes_.Push(WeakPtr<Node>(node));
+        }
+    }
+
+    membersDirty_ = false;
+}
+
+void HLODCluster::OnSetEnabled()
+{
+    if (proxyActive_ && !IsEnabledEffective())
+        SetProxyActive(false);
+
+    StaticModel::OnSetEnabled();
+}
+
+void HLODCluster::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQueryResult>& results)
+{
+    if (!proxyActive_)
+    {
+        StaticModel::ProcessRayQuery(query, results);
+        return;
+    }
+
+    // The members are out of the octree while hidden, so test the same static models that the proxy replaces. The proxy's
+    // bounding box contains them, so the octree has already culled the ray against it
+    for (unsigned i = 0; i < memberNodes_.Size(); ++i)
+    {
+        Node* node = memberNodes_[i];
+        if (!node)
+            continue;
+
+        const Vector<SharedPtr<Component> >& components = node->GetComponents();
+        for (unsigned j = 0; j < components.Size(); ++j)
+        {
+            Component* component = components[j];
+            if (component->GetType() != StaticModel::GetTypeStatic())
+                continue;
+
+            auto* member = static_cast<StaticModel*>(component);
+            if (member->IsHLODHidden() && member->IsEnabledEffective() && (member->GetDrawableFlags() & query.drawableFlags_) &&
+                (member->GetViewMask() & query.viewMask_))
+                member->ProcessRayQuery(query, results);
+        }
+    }
+}
+
+void HLODCluster::SetSwitchDistance(float distance)
+{
+    switchDistance_ = Max(distance, 0.0f);
+    MarkNetworkUpdate();
+}
+
+void HLODCluster::AddMemberNode(Node* node)
+{
+    if (!node || node == node_)
+        return;
+
+    WeakPtr<Node> memberWeak(node);
+    if (memberNodes_.Contains(memberWeak))
+        return;
+
+    memberNodes_.Push(memberWeak);
+    if (proxyActive_)
+        SetMemberHidden(node, true);
+    memberIDsDirty_ = true;
+    MarkNetworkUpdate();
+}
+
+void HLODCluster::RemoveMemberNode(Node* node)
+{
+    if (!node)
+        return;
+
+    WeakPtr<Node> memberWeak(node);
+    Vector<WeakPtr<Node> >::Iterator i = memberNodes_.Find(memberWeak);
+    if (i == memberNodes_.End())
+        return;
+
+    if (proxyActive_)
+        SetMemberHidden(node, false);
+    memberNodes_.Erase(i);
+    memberIDsDirty_ = true;
+    MarkNetworkUpdate();
+}
+
+void HLODCluster::RemoveAllMemberNodes()
+{
+    if (proxyActive_)
+        SetProxyActive(false);
+
+    memberNodes_.Clear();
+    memberIDsDirty_ = true;
+    MarkNetworkUpdate();
+}
+
+bool HLODCluster::BakeProxy(float triangleRatio, float maxError)
+{
+    if (!node_)
+        return false;
+
+    // Gather the full detail geometry of the member static models into cluster space, grouped by material
+    Matrix3x4 clusterInverse = node_->GetWorldTransform().Inverse();
+    Vector<HLODProxyGeometry> proxyGeometries;
+    HashMap<Material*, unsigned> proxyGeometryIndices;
+    PODVector<StaticModel*> staticModels;
+    PODVector<unsigned> vertexRemap;
+    // Bound the proxy by the member bounds rather than the simplified vertices, so that it is never culled while a
+    // member would be visible
+    BoundingBox box;
+    bool hasTangents = false;
+    bool castShadows = false;
+
+    for (unsigned i = 0; i < memberNodes_.Size(); ++i)
+    {
+        Node* node = memberNodes_[i];
+        if (!node)
+            continue;
+
+        Matrix3x4 transform = clusterInverse * node->GetWorldTransform();
+        Matrix3 normalTransform = transform.ToMatrix3().Inverse().Transpose();
+        node->GetComponents<StaticModel>(staticModels);
+
+        for (unsigned j = 0; j < staticModels.Size(); ++j)
+        {
+            StaticModel* staticModel = staticModels[j];
+            Model* model = staticModel->GetModel();
+            if (!model || !staticModel->IsEnabledEffective())
+                continue;
+            castShadows |= staticModel->GetCastShadows();
+            box.Merge(model->GetBoundingBox().Transformed(transform));
+
+            for (unsigned k = 0; k < model->GetNumGeometries(); ++k)
+            {
+                Geometry* geometry = model->GetGeometry(k, 0);
+                if (!geometry || geometry->GetPrimitiveType() != TRIANGLE_LIST)
+                    continue;
+
+                const unsigned char* vertexData;
+                const unsigned char* indexData;
+                unsigned vertexSize;
+                unsigned indexSize;
+                const PODVector<VertexElement>* elements;
+                geometry->GetRawData(vertexData, vertexSize, indexData, indexSize, elements);
+                if (!vertexData || !indexData || !elements)
+                    continue;
+
+                unsigned positionOffset = VertexBuffer::GetElementOffset(*elements, TYPE_VECTOR3, SEM_POSITION);
+                unsigned normalOffset = VertexBuffer::GetElementOffset(*elements, TYPE_VECTOR3, SEM_NORMAL);
+                unsigned texCoordOffset = VertexBuffer::GetElementOffset(*elements, TYPE_VECTOR2, SEM_TEXCOORD);
+                unsigned tangentOffset = VertexBuffer::GetElementOffset(*elements, TYPE_VECTOR4, SEM_TANGENT);
+                if (positionOffset == M_MAX_UNSIGNED)
+                    continue;
+                if (tangentOffset != M_MAX_UNSIGNED)
+                    hasTangents = true;
+
+                Material* material = staticModel->GetMaterial(k);
+                HashMap<Material*, unsigned>::Iterator group = proxyGeometryIndices.Find(material);
+                if (group == proxyGeometryIndices.End())
+                {
+                    group = proxyGeometryIndices.Insert(MakePair(material, proxyGeometries.Size()));
+                    proxyGeometries.Resize(proxyGeometries.Size() + 1);
+                    proxyGeometries.Back().material_ = material;
+                }
+                HLODProxyGeometry& dest = proxyGeometries[group->second_];
+
+                unsigned vertexStart = geometry->GetVertexStart();
+                unsigned vertexCount = geometry->GetVertexCount();
+                unsigned indexStart = geometry->GetIndexStart();
+                unsigned indexEnd = indexStart + geometry->GetIndexCount() / 3 * 3;
+                vertexRemap.Resize(vertexCount);
+                for (unsigned l = 0; l < vertexCount; ++l)
+                    vertexRemap[l] = M_MAX_UNSIGNED;
+
+                for (unsigned l = indexStart; l < indexEnd; l += 3)
+                {
+                    unsigned triangle[3];
+                    bool valid = true;
+                    for (unsigned m = 0; m < 3; ++m)
+                    {
+                        triangle[m] = (indexSize == sizeof(unsigned) ? ((const unsigned*)indexData)[l + m] :
+                            ((const unsigned short*)indexData)[l + m]) - vertexStart;
+                        if (triangle[m] >= vertexCount)
+                            valid = false;
+                    }
+                    if (!valid)
+                        continue;
+
+                    for (unsigned m = 0; m < 3; ++m)
+                    {
+                        unsigned& remapped = vertexRemap[triangle[m]];
+                        if (remapped == M_MAX_UNSIGNED)
+                        {
+                            const unsigned char* vertex = vertexData + (vertexStart + triangle[m]) * vertexSize;
+                            HLODProxyVertex proxyVertex;
+                            proxyVertex.position_ = transform * *reinterpret_cast<const Vector3*>(vertex + positionOffset);
+                            proxyVertex.normal_ = normalOffset != M_MAX_UNSIGNED ?
+                                (normalTransform * *reinterpret_cast<const Vector3*>(vertex + normalOffset)).Normalized() :
+                                Vector3::UP;
+                            proxyVertex.texCoord_ = texCoordOffset != M_MAX_UNSIGNED ?
+                                *reinterpret_cast<const Vector2*>(vertex + texCoordOffset) : Vector2::ZERO;
+                            if (tangentOffset != M_MAX_UNSIGNED)
+                            {
+                                const Vector4& tangent = *reinterpret_cast<const Vector4*>(vertex + tangentOffset);
+                                Vector3 tangentDirection = (transform.ToMatrix3() * Vector3(tangent.x_, tangent.y_, tangent.z_)).Normalized();
+                                proxyVertex.tangent_ = Vector4(tangentDirection, tangent.w_);
+                            }
+                            else
+                                proxyVertex.tangent_ = Vector4(1.0f, 0.0f, 0.0f, 1.0f);
+
+                            remapped = dest.vertices_.Size();
+                            dest.vertices_.Push(proxyVertex);
+                        }
+                        dest.indices_.Push(remapped);
+                    }
+                }
+            }
+        }
+    }
+
+    // Simplify each material group, then keep only the referenced vertices in cache friendly order
+    unsigned totalVertices = 0;
+    unsigned totalIndices = 0;
+    PODVector<Vector3> positions;
+    PODVector<unsigned> simplified;
+    PODVector<HLODProxyVertex> compacted;
+    for (unsigned i = 0; i < proxyGeometries.Size(); ++i)
+    {
+        HLODProxyGeometry& proxyGeometry = proxyGeometries[i];
+        unsigned numVertices = proxyGeometry.vertices_.Size();
+        positions.Resize(numVertices);
+        for (unsigned j = 0; j < numVertices; ++j)
+            positions[j] = proxyGeometry.vertices_[j].position_;
+
+        if (triangleRatio < 1.0f)
+        {
+            unsigned targetIndices = (unsigned)(proxyGeometry.indices_.Size() / 3 * Max(triangleRatio, 0.0f)) * 3;
+            SimplifyMesh(simplified, proxyGeometry.indices_, positions, targetIndices, maxError);
+            if (!simplified.Empty())
+                proxyGeometry.indices_.Swap(simplified);
+        }
+        OptimizeVertexCache(proxyGeometry.indices_, numVertices);
+
+        vertexRemap.Resize(numVertices);
+        for (unsigned j = 0; j < numVertices; ++j)
+            vertexRemap[j] = M_MAX_UNSIGNED;
+        compacted.Clear();
+        for (unsigned j = 0; j < proxyGeometry.indices_.Size(); ++j)
+        {
+            unsigned& remapped = vertexRemap[proxyGeometry.indices_[j]];
+            if (remapped == M_MAX_UNSIGNED)
+            {
+                remapped = compacted.Size();
+                compacted.Push(proxyGeometry.vertices_[proxyGeometry.indices_[j]]);
+            }
+            proxyGeometry.indices_[j] = remapped;
+        }
+        proxyGeometry.vertices_.Swap(compacted);
+
+        totalVertices += proxyGeometry.vertices_.Size();
+        totalIndices += proxyGeometry.indices_.Size();
+    }
+
+    if (!totalIndices)
+        return false;
+
+    // Build the proxy model with one vertex and index buffer shared by the material geometries
+    PODVector<VertexElement> elements;
+    elements.Push(VertexElement(TYPE_VECTOR3, SEM_POSITION));
+    elements.Push(VertexElement(TYPE_VECTOR3, SEM_NORMAL));
+    elements.Push(VertexElement(TYPE_VECTOR2, SEM_TEXCOORD));
+    if (hasTangents)
+        elements.Push(VertexElement(TYPE_VECTOR4, SEM_TANGENT));
+
+    bool largeIndices = totalVertices > 65535;
+    SharedPtr<VertexBuffer> vb(new VertexBuffer(context_));
+    SharedPtr<IndexBuffer> ib(new IndexBuffer(context_));
+    vb->SetShadowed(true);
+    vb->SetSize(totalVertices, elements);
+    ib->SetShadowed(true);
+    ib->SetSize(totalIndices, largeIndices);
+
+    SharedPtr<Model> proxyModel(new Model(context_));
+    PODVector<float> vertexData;
+    PODVector<unsigned char> indexData(totalIndices * ib->GetIndexSize());
+    vertexData.Reserve(totalVertices * vb->GetVertexSize() / sizeof(float));
+    unsigned vertexStart = 0;
+    unsigned indexStart = 0;
+
+    proxyModel->SetNumGeometries(proxyGeometries.Size());
+    for (unsigned i = 0; i < proxyGeometries.Size(); ++i)
+    {
+        const HLODProxyGeometry& proxyGeometry = proxyGeometries[i];
+        Vector3 center = Vector3::ZERO;
+        for (unsigned j = 0; j < proxyGeometry.vertices_.Size(); ++j)
+        {
+            const HLODProxyVertex& vertex = proxyGeometry.vertices_[j];
+            vertexData.Insert(vertexData.End(), vertex.position_.Data(), vertex.position_.Data() + 3);
+            vertexData.Insert(vertexData.End(), vertex.normal_.Data(), vertex.normal_.Data() + 3);
+            vertexData.Insert(vertexData.End(), vertex.texCoord_.Data(), vertex.texCoord_.Data() + 2);
+            if (hasTangents)
+                vertexData.Insert(vertexData.End(), vertex.tangent_.Data(), vertex.tangent_.Data() + 4);
+            box.Merge(vertex.position_);
+            center += vertex.position_;
+        }
+        if (!proxyGeometry.vertices_.Empty())
+            center /= (float)proxyGeometry.vertices_.Size();
+
+        for (unsigned j = 0; j < proxyGeometry.indices_.Size(); ++j)
+        {
+            unsigned index = proxyGeometry.indices_[j] + vertexStart;
+            if (largeIndices)
+                reinterpret_cast<unsigned*>(indexData.Buffer())[indexStart + j] = index;
+            else
+                reinterpret_cast<unsigned short*>(indexData.Buffer())[indexStart + j] = (unsigned short)index;
+        }
+
+        SharedPtr<Geometry> geometry(new Geometry(context_));
+        geometry->SetVertexBuffer(0, vb);
+        geometry->SetIndexBuffer(ib);
+        geometry->SetDrawRange(TRIANGLE_LIST, indexStart, proxyGeometry.indices_.Size(), vertexStart,
+            proxyGeometry.vertices_.Size());
+        proxyModel->SetNumGeometryLodLevels(i, 1);
+        proxyModel->SetGeometry(i, 0, geometry);
+        proxyModel->SetGeometryCenter(i, center);
+
+        vertexStart += proxyGeometry.vertices_.Size();
+        indexStart += proxyGeometry.indices_.Size();
+    }
+
+    vb->SetData(vertexData.Buffer());
+    ib->SetData(indexData.Buffer());
+
+    Vector<SharedPtr<VertexBuffer> > vertexBuffers;
+    Vector<SharedPtr<IndexBuffer> > indexBuffers;
+    PODVector<unsigned> emptyMorphRange;
+    vertexBuffers.Push(vb);
+    indexBuffers.Push(ib);
+    proxyModel->SetVertexBuffers(vertexBuffers, emptyMorphRange, emptyMorphRange);
+    proxyModel->SetIndexBuffers(indexBuffers);
+    proxyModel->SetBoundingBox(box);
+
+    SetModel(proxyModel);
+    for (unsigned i = 0; i < proxyGeometries.Size(); ++i)
+        SetMaterial(i, proxyGeometries[i].material_);
+    SetCastShadows(castShadows);
+    return true;
+}
+
+void HLODCluster::UpdateSwitch(const PODVector<Camera*>& cameras)
+{
+    bool active = false;
+
+    // Without a proxy model the member drawables are always shown. Otherwise the closest camera decides
+    if (model_ && IsEnabledEffective() && !cameras.Empty())
+    {
+        const Vector3 center = GetWorldBoundingBox().Center();
+        const float threshold = proxyActive_ ? switchDistance_ * (1.0f - HLOD_SWITCH_HYSTERESIS) : switchDistance_;
+        active = true;
+        for (PODVector<Camera*>::ConstIterator i = cameras.Begin(); i != cameras.End() && active; ++i)
+        {
+            float distance = (*i)->GetDistance(center);
+            active = (*i)->GetLodDistance(distance, 1.0f, lodBias_) > threshold;
+        }
+    }
+
+    if (active != proxyActive_)
+        SetProxyActive(active);
+}
+
+Node* HLODCluster::GetMemberNode(unsigned index) const
+{
+    return index < memberNodes_.Size() ? memberNodes_[index] : nullptr;
+}
+
+void HLODCluster::SetMemberIDsAttr(const VariantVector& value)
+{
+    // Just remember the node IDs. They need to go through the SceneResolver, and we actually find the nodes during
+    // ApplyAttributes()
+    memberIDsAttr_.Clear();
+    if (value.Size())
+    {
+        unsigned index = 0;
+        unsigned numMembers = value[index++].GetUInt();
+        // Prevent crash on entering negative value in the editor
+        if (numMembers > M_MAX_INT)
+            numMembers = 0;
+
+        memberIDsAttr_.Push(numMembers);
+        while (numMembers--)
+        {
+            // If vector contains less IDs than should, fill the rest with zeroes
+            if (index < value.Size())
+                memberIDsAttr_.Push(value[index++].GetUInt());
+            else
+                memberIDsAttr_.Push(0);
+        }
+    }
+    else
+        memberIDsAttr_.Push(0);
+
+    membersDirty_ = true;
+    memberIDsDirty_ = false;
+}
+
+const VariantVector& HLODCluster::GetMemberIDsAttr() const
+{
+    if (memberIDsDirty_)
+        UpdateMemberIDs();
+
+    return memberIDsAttr_;
+}
+
+void HLODCluster::OnSceneSet(Scene* scene)
+{
+    if (octree_)
+    {
+        octree_->RemoveHLODCluster(this);
+        octree_.Reset();
+    }
+
+    if (scene)
+    {
+        octree_ = scene->GetComponent<Octree>();
+        if (octree_)
+            octree_->AddHLODCluster(this);
+    }
+    else if (proxyActive_)
+        SetProxyActive(false);
+
+    StaticModel::OnSceneSet(scene);
+}
+
+void HLODCluster::SetProxyActive(bool enable)
+{
+    proxyActive_ = enable;
+    for (unsigned i = 0; i < memberNodes_.Size(); ++i)
+        SetMemberHidden(memberNodes_[i], enable);
+    SetHLODHidden(!enable);
+}
+
+void HLODCluster::SetMemberHidden(Node* node, bool hidden)
+{
+    if (!node)
+        return;
+
+    // Hide the same static models that are baked into the proxy
+    const Vector<SharedPtr<Component> >& components = node->GetComponents();
+    for (unsigned i = 0; i < components.Size(); ++i)
+    {
+        Component* component = components[i];
+        if (component->GetType() == StaticModel::GetTypeStatic())
+            static_cast<StaticModel*>(component)->SetHLODHidden(hidden);
+    }
+}
+
+void HLODCluster::UpdateMemberIDs() const
+{
+    unsigned numMembers = memberNodes_.Size();
+
+    memberIDsAttr_.Clear();
+    memberIDsAttr_.Push(numMembers);
+
+    for (unsigned i = 0; i < numMembers; ++i)
+    {
+        Node* node = memberNodes_[i];
+        memberIDsAttr_.Push(node ? node->GetID() : 0);
+    }
+
+    memberIDsDirty_ = false;
+}
+
+}
@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Graphics/StaticModel.h"
+
+namespace Urho3D
+{
+
+class Octree;
+
+/// Default camera distance beyond which a hierarchical LOD cluster draws its proxy model.
+static const float DEFAULT_HLOD_SWITCH_DISTANCE = 100.0f;
+/// Fraction of the switch distance the camera must come closer than it before the member drawables are restored.
+static const float HLOD_SWITCH_HYSTERESIS = 0.05f;
+
+/// Static model proxy for a cluster of static drawables. Beyond the switch distance the proxy model is drawn and the member drawables are removed from the octree, so a far away cluster costs one drawable to cull and draw. The switch is decided once per frame for the whole scene and is conservative: the proxy is drawn only while the cluster is beyond the switch distance from every camera viewing the scene. Raycasts hit the hidden member drawables instead of the proxy, but other octree queries return the proxy.
+class URHO3D_API HLODCluster : public StaticModel
+{
+    URHO3D_OBJECT(HLODCluster, StaticModel);
+
+public:
+    /// Construct.
+    explicit HLODCluster(Context* context);
+    /// Destruct. Restore the member drawables.
+    ~HLODCluster() override;
+    /// Register object factory. StaticModel must be registered first.
+    static void RegisterObject(Context* context);
+
+    /// Apply attribute changes that can not be applied immediately. Called after scene load or a network update.
+    void ApplyAttributes() override;
+    /// Handle enabled/disabled state change.
+    void OnSetEnabled() override;
+    /// Process octree raycast. While the proxy is drawn, raycast the hidden member drawables instead, so that picking returns them. May be called from a worker thread.
+    void ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQueryResult>& results) override;
+
+    /// Set camera distance beyond which the proxy model replaces the member drawables.
+    void SetSwitchDistance(float distance);
+    /// Add a member scene node. Its geometry drawables are hidden while the proxy is drawn.
+    void AddMemberNode(Node* node);
+    /// Remove a member scene node.
+    void RemoveMemberNode(Node* node);
+    /// Remove all member scene nodes.
+    void RemoveAllMemberNodes();
+    /// Merge the static models of the member nodes into a new proxy model in this node's space and set it. The geometry is grouped by material and simplified towards the triangle ratio without exceeding the error relative to the cluster size. Return true if successful.
+    bool BakeProxy(float triangleRatio, float maxError);
+    /// Choose between the proxy and the member drawables by the distance to the cameras viewing the scene. The proxy is drawn only if the cluster is beyond the switch distance from all of them. Called by the octree from the main thread once per frame.
+    void UpdateSwitch(const PODVector<Camera*>& cameras);
+
+    /// Return switch distance.
+    float GetSwitchDistance() const { return switchDistance_; }
+    /// Return number of member nodes.
+    unsigned GetNumMemberNodes() const { return memberNodes_.Size(); }
+    /// Return member node by index.
+    Node* GetMemberNode(unsigned index) const;
+    /// Return whether the proxy model is currently drawn instead of the member drawables.
+    bool IsProxyActive() const { return proxyActive_; }
+
+    /// Set member node IDs attribute.
+    void SetMemberIDsAttr(const VariantVector& value);
+    /// Return member node IDs attribute.
+    const VariantVector& GetMemberIDsAttr() const;
+
+protected:
+    /// Handle scene being assigned.
+    void OnSceneSet(Scene* scene) override;
+
+private:
+    /// Show the proxy and hide the member drawables, or the other way around.
+    void SetProxyActive(bool enable);
+    /// Show or hide the geometry drawables of a member node.
+    void SetMemberHidden(Node* node, bool hidden);
+    /// Update member node IDs attribute from the actual nodes.
+    void UpdateMemberIDs() const;
+
+    /// Member nodes.
+    Vector<WeakPtr<Node> > memberNodes_;
+    /// Octree the cluster is registered to.
+    WeakPtr<Octree> octree_;
+    /// IDs of member nodes for serialization.
+    mutable VariantVector memberIDsAttr_;
+    /// Switch distance.
+    float switchDistance_;
+    /// Whether the proxy is drawn instead of the member drawables.
+    bool proxyActive_;
+    /// Whether member IDs have been set and nodes should be searched for during ApplyAttributes.
+    bool membersDirty_;
+    /// Whether members have been manipulated by the API and the member ID attribute should be refreshed.
+    mutable bool memberIDsDirty_;
+};
+
+}
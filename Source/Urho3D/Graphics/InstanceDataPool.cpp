@@ -0,0 +1,288 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Container/Sort.h"
+#include "../Graphics/InstanceDataPool.h"
+
+#include <cstring>
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+InstanceDataPool::InstanceDataPool() :
+    stride_(sizeof(Matrix3x4)),
+    numSlots_(0),
+    numReleasedSlots_(0),
+    frameNumber_(M_MAX_UNSIGNED),
+    allDirty_(false)
+{
+}
+
+void InstanceDataPool::SetStride(unsigned stride)
+{
+    if (stride != stride_)
+    {
+        stride_ = stride;
+        Clear();
+    }
+}
+
+void InstanceDataPool::Clear()
+{
+    blocks_.Clear();
+    data_.Clear();
+    owners_.Clear();
+    dirtyRanges_.Clear();
+    numSlots_ = 0;
+    numReleasedSlots_ = 0;
+    allDirty_ = false;
+}
+
+void InstanceDataPool::BeginFrame(unsigned frameNumber)
+{
+    if (frameNumber == frameNumber_)
+        return;
+
+    frameNumber_ = frameNumber;
+
+    // Forget the batch groups that have not been drawn for a while
+    for (HashMap<unsigned, Block>::Iterator i = blocks_.Begin(); i != blocks_.End();)
+    {
+        if (frameNumber_ - i->second_.frameNumber_ > INSTANCE_SLOT_EXPIRE_FRAMES)
+        {
+            ReleaseBlock(i->second_);
+            i = blocks_.Erase(i);
+        }
+        else
+            ++i;
+    }
+
+    // Reclaim the released slots once they make up half of the pool. The blocks move down in order along with their
+    // data, so they stay valid, but the whole buffer must be uploaded again
+    if (numSlots_ >= INSTANCE_POOL_MIN_COMPACT_SLOTS && numReleasedSlots_ * 2 >= numSlots_)
+    {
+        sortedBlocks_.Clear();
+        for (HashMap<unsigned, Block>::Iterator i = blocks_.Begin(); i != blocks_.End(); ++i)
+            sortedBlocks_.Push(&i->second_);
+        Sort(sortedBlocks_.Begin(), sortedBlocks_.End(), [](const Block* lhs, const Block* rhs) { return lhs->start_ < rhs->start_; });
+
+        unsigned slot = 0;
+        for (PODVector<Block*>::Iterator i = sortedBlocks_.Begin(); i != sortedBlocks_.End(); ++i)
+        {
+            Block& block = **i;
+            if (block.start_ != slot)
+            {
+                memmove(&data_[slot * stride_], &data_[block.start_ * stride_], block.capacity_ * stride_);
+                memmove(&owners_[slot], &owners_[block.start_], block.capacity_ * sizeof(SlotOwner));
+                block.start_ = slot;
+            }
+            slot += block.capacity_;
+        }
+
+        numSlots_ = slot;
+        numReleasedSlots_ = 0;
+        MarkAllDirty();
+    }
+}
+
+unsigned InstanceDataPool::PlaceInstances(unsigned groupKey, const InstanceData* instances, unsigned count)
+{
+    Block& block = blocks_[groupKey];
+
+    // Another group with the same key, or the same group in another view, was already placed during this frame. Its slots
+    // are needed until the frame is drawn, so leave this group to the per-frame buffer
+    if (block.frameNumber_ == frameNumber_ && block.capacity_)
+        return M_MAX_UNSIGNED;
+
+    // The slots are up to date if the group was placed during the previous frame, as the octree has reported every changed
+    // drawable since. Otherwise write all of them
+    bool placedLastFrame = block.capacity_ && frameNumber_ - block.frameNumber_ == 1;
+    block.frameNumber_ = frameNumber_;
+
+    if (count > block.capacity_)
+    {
+        // Leave room for the group to slide both ways
+        ReleaseBlock(block);
+        AllocateBlock(block, count * 2);
+        placedLastFrame = false;
+    }
+
+    const unsigned oldOffset = block.offset_;
+    const unsigned oldEnd = oldOffset + block.count_;
+    unsigned offset = M_MAX_UNSIGNED;
+    if (placedLastFrame)
+    {
+        offset = FindFirstSlot(block, instances, count);
+        if (offset == M_MAX_UNSIGNED)
+            offset = oldOffset;
+    }
+    if (offset == M_MAX_UNSIGNED || offset + count > block.capacity_)
+    {
+        // Start from the middle of the block, also when the group slid to its end
+        offset = (block.capacity_ - count) / 2;
+        placedLastFrame = false;
+    }
+
+    block.offset_ = offset;
+    block.count_ = count;
+    const unsigned start = block.start_ + offset;
+
+    // The instances whose slots held the group in the previous frame are compared against them. The rest entered the group
+    // at its ends and are written
+    unsigned begin = 0;
+    unsigned end = 0;
+    if (placedLastFrame && oldEnd > offset && offset + count > oldOffset)
+    {
+        begin = Max(oldOffset, offset) - offset;
+        end = Min(oldEnd, offset + count) - offset;
+    }
+
+    for (unsigned i = 0; i < begin; ++i)
+        WriteSlot(start + i, instances[i]);
+
+    const SlotOwner* owner = owners_.Buffer() + start + begin;
+    const InstanceData* instanceEnd = instances + end;
+    for (const InstanceData* instance = instances + begin; instance != instanceEnd; ++instance, ++owner)
+    {
+        if (instance->changed_ || owner->worldTransform_ != instance->worldTransform_ ||
+            owner->instancingData_ != instance->instancingData_)
+            WriteSlot(start + (unsigned)(instance - instances), *instance);
+    }
+
+    for (unsigned i = end; i < count; ++i)
+        WriteSlot(start + i, instances[i]);
+
+    return start;
+}
+
+void InstanceDataPool::MarkAllDirty()
+{
+    allDirty_ = true;
+    dirtyRanges_.Clear();
+}
+
+void InstanceDataPool::GetDirtyRanges(PODVector<InstanceRange>& ranges)
+{
+    ranges.Clear();
+
+    if (allDirty_)
+    {
+        if (numSlots_)
+            ranges.Push(InstanceRange{0, numSlots_});
+    }
+    else
+    {
+        // Each slot is written at most once per frame, so the ranges do not overlap
+        ranges.Swap(dirtyRanges_);
+    }
+
+    dirtyRanges_.Clear();
+    allDirty_ = false;
+}
+
+void InstanceDataPool::AllocateBlock(Block& block, unsigned capacity)
+{
+    block.start_ = numSlots_;
+    block.capacity_ = capacity;
+    block.count_ = 0;
+    numSlots_ += capacity;
+    if (data_.Size() < numSlots_ * stride_)
+        data_.Resize(numSlots_ * stride_);
+    if (owners_.Size() < numSlots_)
+        owners_.Resize(numSlots_);
+}
+
+void InstanceDataPool::ReleaseBlock(Block& block)
+{
+    numReleasedSlots_ += block.capacity_;
+    block.capacity_ = 0;
+    block.count_ = 0;
+}
+
+unsigned InstanceDataPool::FindFirstSlot(const Block& block, const InstanceData* instances, unsigned count) const
+{
+    if (!count || !block.count_)
+        return M_MAX_UNSIGNED;
+
+    const SlotOwner* owners = owners_.Buffer() + block.start_;
+
+    // Instances that left the front of the group leave their slots behind
+    const unsigned searchEnd = Min(block.offset_ + INSTANCE_MATCH_LOOKAHEAD, block.offset_ + block.count_);
+    for (unsigned slot = block.offset_; slot < searchEnd; ++slot)
+    {
+        if (owners[slot].worldTransform_ == instances[0].worldTransform_ &&
+            owners[slot].instancingData_ == instances[0].instancingData_)
+            return slot;
+    }
+
+    // Instances that entered the front of the group take the slots before the previous first instance
+    const SlotOwner& first = owners[block.offset_];
+    const unsigned searchCount = Min(INSTANCE_MATCH_LOOKAHEAD, count);
+    for (unsigned i = 1; i < searchCount; ++i)
+    {
+        if (first.worldTransform_ == instances[i].worldTransform_ && first.instancingData_ == instances[i].instancingData_)
+            return i <= block.offset_ ? block.offset_ - i : M_MAX_UNSIGNED;
+    }
+
+    return M_MAX_UNSIGNED;
+}
+
+void InstanceDataPool::WriteSlot(unsigned slot, const InstanceData& instance)
+{
+    unsigned char* dest = data_.Buffer() + slot * stride_;
+    memcpy(dest, instance.worldTransform_, sizeof(Matrix3x4));
+    if (instance.instancingData_)
+        memcpy(dest + sizeof(Matrix3x4), instance.instancingData_, stride_ - sizeof(Matrix3x4));
+
+    SlotOwner& owner = owners_.Buffer()[slot];
+    owner.worldTransform_ = instance.worldTransform_;
+    owner.instancingData_ = instance.instancingData_;
+    MarkDirty(slot);
+}
+
+void InstanceDataPool::MarkDirty(unsigned slot)
+{
+    if (allDirty_)
+        return;
+
+    // Slots are written in ascending order within a batch group, so extend the latest range when possible
+    if (!dirtyRanges_.Empty())
+    {
+        InstanceRange& last = dirtyRanges_.Back();
+        unsigned end = last.start_ + last.count_;
+        if (slot >= last.start_ && slot <= end + INSTANCE_DIRTY_MERGE_GAP)
+        {
+            if (slot >= end)
+                last.count_ = slot - last.start_ + 1;
+            return;
+        }
+    }
+
+    dirtyRanges_.Push(InstanceRange{slot, 1});
+}
+
+}
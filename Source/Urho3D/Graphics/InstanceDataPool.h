@@ -0,0 +1,134 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Graphics/Batch.h"
+
+namespace Urho3D
+{
+
+/// Number of frames a batch group may stay unused before its slots are released.
+static const unsigned INSTANCE_SLOT_EXPIRE_FRAMES = 60;
+/// Slot count below which the pool is never compacted.
+static const unsigned INSTANCE_POOL_MIN_COMPACT_SLOTS = 1024;
+/// Largest gap between dirty slots that is uploaded together with them to save upload calls.
+static const unsigned INSTANCE_DIRTY_MERGE_GAP = 8;
+/// Number of instances searched at the front of a batch group for those that entered or left it since the previous frame.
+static const unsigned INSTANCE_MATCH_LOOKAHEAD = 4;
+
+/// Persistent instance data pool. Each batch group owns a block of slots twice its instance count and keeps its
+/// instances in contiguous slots in the order they are drawn, so that it is drawn with one draw call. When instances
+/// leave or enter the group at its front or back, the group slides within the block and only the entering instances are
+/// written. Every other instance is compared against the slot at its index, which is rewritten only if it held another
+/// instance or the octree reports the instance's drawable changed. An instance entering or leaving the middle of the
+/// group, or a change of order, rewrites the slots after it, which costs upload but not draw calls. The pool does not
+/// touch the GPU.
+class URHO3D_API InstanceDataPool
+{
+public:
+    /// Construct.
+    InstanceDataPool();
+
+    /// Set size of one instance in bytes. Clears the pool if changed.
+    void SetStride(unsigned stride);
+    /// Release all slots.
+    void Clear();
+    /// Begin a new frame. Release the slots of batch groups not used recently and compact if much of the pool is unused. Calling again with the same frame number does nothing.
+    void BeginFrame(unsigned frameNumber);
+    /// Place the instances of a batch group identified by a key that stays the same between frames. Return the first slot of the group's instances, which occupy as many contiguous slots as there are instances in the given order.
+    unsigned PlaceInstances(unsigned groupKey, const InstanceData* instances, unsigned count);
+    /// Mark all slots dirty, for example after the vertex buffer was recreated or lost its contents.
+    void MarkAllDirty();
+    /// Return the dirty slot ranges merged for upload and clear the dirty state.
+    void GetDirtyRanges(PODVector<InstanceRange>& ranges);
+
+    /// Return size of one instance in bytes.
+    unsigned GetStride() const { return stride_; }
+    /// Return instance data of all slots.
+    const unsigned char* GetData() const { return data_.Buffer(); }
+    /// Return number of slots, including released slots not yet reclaimed.
+    unsigned GetNumSlots() const { return numSlots_; }
+    /// Return number of released slots not yet reclaimed.
+    unsigned GetNumReleasedSlots() const { return numReleasedSlots_; }
+
+private:
+    /// Instance a slot was last written for.
+    struct SlotOwner
+    {
+        /// World transform.
+        const Matrix3x4* worldTransform_;
+        /// Instance data.
+        const void* instancingData_;
+    };
+
+    /// Slots of a batch group.
+    struct Block
+    {
+        /// First slot.
+        unsigned start_{};
+        /// Number of slots.
+        unsigned capacity_{};
+        /// Slot of the first instance relative to the first slot.
+        unsigned offset_{};
+        /// Number of instances.
+        unsigned count_{};
+        /// Frame number of last use.
+        unsigned frameNumber_{};
+    };
+
+    /// Allocate the slots of a block from the end of the pool.
+    void AllocateBlock(Block& block, unsigned capacity);
+    /// Release the slots of a block.
+    void ReleaseBlock(Block& block);
+    /// Return the slot within a block where the first instance of its batch group goes, or M_MAX_UNSIGNED if it was not found among the slots of the previous frame.
+    unsigned FindFirstSlot(const Block& block, const InstanceData* instances, unsigned count) const;
+    /// Copy instance data to a slot and mark it dirty.
+    void WriteSlot(unsigned slot, const InstanceData& instance);
+    /// Mark a slot dirty.
+    void MarkDirty(unsigned slot);
+
+    /// Blocks by batch group key.
+    HashMap<unsigned, Block> blocks_;
+    /// Instance data of slots.
+    PODVector<unsigned char> data_;
+    /// Owners of slots.
+    PODVector<SlotOwner> owners_;
+    /// Dirty slot ranges in the order they were written.
+    PODVector<InstanceRange> dirtyRanges_;
+    /// Blocks ordered by first slot for compaction.
+    PODVector<Block*> sortedBlocks_;
+    /// Size of one instance in bytes.
+    unsigned stride_;
+    /// Number of slots.
+    unsigned numSlots_;
+    /// Number of released slots.
+    unsigned numReleasedSlots_;
+    /// Current frame number.
+    unsigned frameNumber_;
+    /// All slots dirty flag.
+    bool allDirty_;
+};
+
+}
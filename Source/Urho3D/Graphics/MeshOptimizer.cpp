@@ -0,0 +1,642 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Container/HashMap.h"
+#include "../Container/HashSet.h"
+#include "../Container/Sort.h"
+#include "../Graphics/MeshOptimizer.h"
+#include "../Math/BoundingBox.h"
+
+#include <cmath>
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+static const unsigned FORSYTH_CACHE_SIZE = 32;
+static const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+static const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+static const unsigned OVERDRAW_CACHE_SIZE = 16;
+static const float OVERDRAW_MAX_ACMR_INCREASE = 1.05f;
+static const double SIMPLIFY_BORDER_WEIGHT = 10.0;
+static const float SIMPLIFY_MIN_NORMAL_DOT = 0.25f;
+
+enum SimplifyVertexKind
+{
+    VERTEX_MANIFOLD = 0,
+    VERTEX_BORDER,
+    VERTEX_LOCKED
+};
+
+/// Symmetric quadric error matrix accumulated from weighted planes.
+struct Quadric
+{
+    /// Accumulate a plane with unit normal.
+    void AddPlane(const Vector3& normal, float distance, double weight)
+    {
+        double x = normal.x_, y = normal.y_, z = normal.z_, d = distance;
+        a00_ += weight * x * x;
+        a11_ += weight * y * y;
+        a22_ += weight * z * z;
+        a10_ += weight * x * y;
+        a20_ += weight * x * z;
+        a21_ += weight * y * z;
+        b0_ += weight * x * d;
+        b1_ += weight * y * d;
+        b2_ += weight * z * d;
+        c_ += weight * d * d;
+        weight_ += weight;
+    }
+
+    /// Add another quadric.
+    Quadric& operator +=(const Quadric& rhs)
+    {
+        a00_ += rhs.a00_;
+        a11_ += rhs.a11_;
+        a22_ += rhs.a22_;
+        a10_ += rhs.a10_;
+        a20_ += rhs.a20_;
+        a21_ += rhs.a21_;
+        b0_ += rhs.b0_;
+        b1_ += rhs.b1_;
+        b2_ += rhs.b2_;
+        c_ += rhs.c_;
+        weight_ += rhs.weight_;
+        return *this;
+    }
+
+    /// Return the weighted root mean square distance of a point to the accumulated planes.
+    float GetError(const Vector3& point) const
+    {
+        if (weight_ <= 0.0)
+            return 0.0f;
+
+        double x = point.x_, y = point.y_, z = point.z_;
+        double error = a00_ * x * x + a11_ * y * y + a22_ * z * z + 2.0 * (a10_ * x * y + a20_ * x * z + a21_ * y * z) +
+            2.0 * (b0_ * x + b1_ * y + b2_ * z) + c_;
+        return error > 0.0 ? (float)sqrt(error / weight_) : 0.0f;
+    }
+
+    double a00_{}, a11_{}, a22_{}, a10_{}, a20_{}, a21_{};
+    double b0_{}, b1_{}, b2_{};
+    double c_{};
+    double weight_{};
+};
+
+/// Candidate edge collapse during simplification.
+struct EdgeCollapse
+{
+    /// Removed vertex.
+    unsigned from_;
+    /// Kept vertex.
+    unsigned to_;
+    /// Error after the collapse.
+    float error_;
+};
+
+static void BuildVertexTriangles(PODVector<unsigned>& offsets, PODVector<unsigned>& triangles, const PODVector<unsigned>& indices,
+    unsigned numVertices)
+{
+    offsets.Resize(numVertices + 1);
+    for (unsigned i = 0; i <= numVertices; ++i)
+        offsets[i] = 0;
+    for (unsigned i = 0; i < indices.Size(); ++i)
+        ++offsets[indices[i] + 1];
+    for (unsigned i = 0; i < numVertices; ++i)
+        offsets[i + 1] += offsets[i];
+
+    PODVector<unsigned> fill(offsets.Buffer(), numVertices);
+    triangles.Resize(indices.Size());
+    for (unsigned i = 0; i < indices.Size(); ++i)
+        triangles[fill[indices[i]]++] = i / 3;
+}
+
+static float GetForsythVertexScore(int cachePosition, unsigned remainingValence)
+{
+    if (!remainingValence)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        if (cachePosition < 3)
+            score = FORSYTH_LAST_TRIANGLE_SCORE;
+        else
+        {
+            const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            score = powf(1.0f - (cachePosition - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+        }
+    }
+
+    return score + FORSYTH_VALENCE_BOOST_SCALE * powf((float)remainingValence, -FORSYTH_VALENCE_BOOST_POWER);
+}
+
+static unsigned long long GetEdgeKey(unsigned from, unsigned to)
+{
+    return ((unsigned long long)from << 32u) | to;
+}
+
+VertexCacheStatistics AnalyzeVertexCache(const PODVector<unsigned>& indices, unsigned numVertices, unsigned cacheSize)
+{
+    VertexCacheStatistics ret;
+    if (indices.Size() < 3)
+        return ret;
+
+    // FIFO cache simulation: a vertex is cached if fewer than cacheSize misses have happened since it was loaded
+    PODVector<unsigned> timestamps(numVertices);
+    for (unsigned i = 0; i < numVertices; ++i)
+        timestamps[i] = 0;
+    unsigned time = cacheSize + 1;
+    unsigned misses = 0;
+    unsigned referenced = 0;
+
+    for (unsigned i = 0; i < indices.Size(); ++i)
+    {
+        unsigned index = indices[i];
+        if (!timestamps[index])
+            ++referenced;
+        if (time - timestamps[index] > cacheSize)
+        {
+            timestamps[index] = time++;
+            ++misses;
+        }
+    }
+
+    ret.acmr_ = (float)misses / (float)(indices.Size() / 3);
+    ret.atvr_ = (float)misses / (float)referenced;
+    return ret;
+}
+
+void OptimizeVertexCache(PODVector<unsigned>& indices, unsigned numVertices)
+{
+    unsigned numTriangles = indices.Size() / 3;
+    if (numTriangles < 2)
+        return;
+
+    PODVector<unsigned> offsets;
+    PODVector<unsigned> vertexTriangles;
+    BuildVertexTriangles(offsets, vertexTriangles, indices, numVertices);
+
+    PODVector<unsigned> valences(numVertices);
+    PODVector<int> cachePositions(numVertices);
+    PODVector<float> vertexScores(numVertices);
+    for (unsigned i = 0; i < numVertices; ++i)
+    {
+        valences[i] = offsets[i + 1] - offsets[i];
+        cachePositions[i] = -1;
+        vertexScores[i] = GetForsythVertexScore(-1, valences[i]);
+    }
+
+    PODVector<float> triangleScores(numTriangles);
+    PODVector<unsigned char> emitted(numTriangles);
+    unsigned bestTriangle = 0;
+    for (unsigned i = 0; i < numTriangles; ++i)
+    {
+        triangleScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+        emitted[i] = 0;
+        if (triangleScores[i] > triangleScores[bestTriangle])
+            bestTriangle = i;
+    }
+
+    PODVector<unsigned> result(indices.Size());
+    PODVector<unsigned> cache;
+    PODVector<unsigned> newCache;
+    unsigned cursor = 0;
+
+    for (unsigned i = 0; i < numTriangles; ++i)
+    {
+        // If no cached vertex has triangles left, continue from the next unemitted triangle in input order
+        if (bestTriangle == M_MAX_UNSIGNED)
+        {
+            while (emitted[cursor])
+                ++cursor;
+            bestTriangle = cursor;
+        }
+
+        const unsigned* triangle = &indices[bestTriangle * 3];
+        result[i * 3] = triangle[0];
+        result[i * 3 + 1] = triangle[1];
+        result[i * 3 + 2] = triangle[2];
+        emitted[bestTriangle] = 1;
+
+        // Remove the triangle from its vertices' live triangle lists
+        newCache.Clear();
+        for (unsigned j = 0; j < 3; ++j)
+        {
+            unsigned vertex = triangle[j];
+            unsigned* live = &vertexTriangles[offsets[vertex]];
+            for (unsigned k = 0; k < valences[vertex]; ++k)
+            {
+                if (live[k] == bestTriangle)
+                {
+                    live[k] = live[valences[vertex] - 1];
+                    --valences[vertex];
+                    break;
+                }
+            }
+            if (!newCache.Contains(vertex))
+                newCache.Push(vertex);
+        }
+
+        // Move the triangle's vertices to the front of the LRU cache
+        for (unsigned j = 0; j < cache.Size(); ++j)
+        {
+            if (!newCache.Contains(cache[j]))
+                newCache.Push(cache[j]);
+        }
+
+        // Rescore cached and evicted vertices, propagating the change to their live triangles
+        for (unsigned j = 0; j < newCache.Size(); ++j)
+        {
+            unsigned vertex = newCache[j];
+            int position = j < FORSYTH_CACHE_SIZE ? (int)j : -1;
+            cachePositions[vertex] = position;
+            float score = GetForsythVertexScore(position, valences[vertex]);
+            float delta = score - vertexScores[vertex];
+            vertexScores[vertex] = score;
+            for (unsigned k = 0; k < valences[vertex]; ++k)
+                triangleScores[vertexTriangles[offsets[vertex] + k]] += delta;
+        }
+
+        if (newCache.Size() > FORSYTH_CACHE_SIZE)
+            newCache.Resize(FORSYTH_CACHE_SIZE);
+        cache.Swap(newCache);
+
+        bestTriangle = M_MAX_UNSIGNED;
+        float bestScore = -M_INFINITY;
+        for (unsigned j = 0; j < cache.Size(); ++j)
+        {
+            unsigned vertex = cache[j];
+            for (unsigned k = 0; k < valences[vertex]; ++k)
+            {
+                unsigned candidate = vertexTriangles[offsets[vertex] + k];
+                if (triangleScores[candidate] > bestScore)
+                {
+                    bestScore = triangleScores[candidate];
+                    bestTriangle = candidate;
+                }
+            }
+        }
+    }
+
+    indices.Swap(result);
+}
+
+void OptimizeOverdraw(PODVector<unsigned>& indices, const PODVector<Vector3>& positions)
+{
+    unsigned numTriangles = indices.Size() / 3;
+    if (numTriangles < 2)
+        return;
+
+    unsigned numVertices = positions.Size();
+    float oldAcmr = AnalyzeVertexCache(indices, numVertices, OVERDRAW_CACHE_SIZE).acmr_;
+
+    // Split into clusters at triangles that miss the cache on every vertex: reordering at these points does not hurt the
+    // cache, as the next cluster starts cold in any case
+    PODVector<unsigned> clusterStarts;
+    PODVector<unsigned> timestamps(numVertices);
+    for (unsigned i = 0; i < numVertices; ++i)
+        timestamps[i] = 0;
+    unsigned time = OVERDRAW_CACHE_SIZE + 1;
+    for (unsigned i = 0; i < numTriangles; ++i)
+    {
+        unsigned misses = 0;
+        for (unsigned j = 0; j < 3; ++j)
+        {
+            unsigned index = indices[i * 3 + j];
+            if (time - timestamps[index] > OVERDRAW_CACHE_SIZE)
+            {
+                timestamps[index] = time++;
+                ++misses;
+            }
+        }
+        if (!i || misses == 3)
+            clusterStarts.Push(i);
+    }
+
+    unsigned numClusters = clusterStarts.Size();
+    if (numClusters < 2)
+        return;
+    clusterStarts.Push(numTriangles);
+
+    // Sort clusters so that those far out from the mesh center along their facing direction are drawn first
+    PODVector<Vector3> clusterCenters(numClusters);
+    PODVector<Vector3> clusterNormals(numClusters);
+    Vector3 meshCenter = Vector3::ZERO;
+    float meshArea = 0.0f;
+    for (unsigned i = 0; i < numClusters; ++i)
+    {
+        Vector3 center = Vector3::ZERO;
+        Vector3 normal = Vector3::ZERO;
+        float area = 0.0f;
+        for (unsigned j = clusterStarts[i]; j < clusterStarts[i + 1]; ++j)
+        {
+            const Vector3& v0 = positions[indices[j * 3]];
+            const Vector3& v1 = positions[indices[j * 3 + 1]];
+            const Vector3& v2 = positions[indices[j * 3 + 2]];
+            Vector3 triangleNormal = (v1 - v0).CrossProduct(v2 - v0);
+            float triangleArea = triangleNormal.Length();
+            center += (v0 + v1 + v2) * (triangleArea / 3.0f);
+            normal += triangleNormal;
+            area += triangleArea;
+        }
+        meshCenter += center;
+        meshArea += area;
+        clusterCenters[i] = area > 0.0f ? center / area : positions[indices[clusterStarts[i] * 3]];
+        clusterNormals[i] = normal.Normalized();
+    }
+    if (meshArea > 0.0f)
+        meshCenter /= meshArea;
+
+    PODVector<float> sortKeys(numClusters);
+    PODVector<unsigned> order(numClusters);
+    for (unsigned i = 0; i < numClusters; ++i)
+    {
+        sortKeys[i] = (clusterCenters[i] - meshCenter).DotProduct(clusterNormals[i]);
+        order[i] = i;
+    }
+    Sort(order.Begin(), order.End(), [&sortKeys](unsigned lhs, unsigned rhs)
+    {
+        return sortKeys[lhs] != sortKeys[rhs] ? sortKeys[lhs] > sortKeys[rhs] : lhs < rhs;
+    });
+
+    PODVector<unsigned> result;
+    result.Reserve(indices.Size());
+    for (unsigned i = 0; i < numClusters; ++i)
+    {
+        unsigned cluster = order[i];
+        result.Insert(result.End(), indices.Buffer() + clusterStarts[cluster] * 3, indices.Buffer() + clusterStarts[cluster + 1] * 3);
+    }
+
+    if (AnalyzeVertexCache(result, numVertices, OVERDRAW_CACHE_SIZE).acmr_ <= oldAcmr * OVERDRAW_MAX_ACMR_INCREASE)
+        indices.Swap(result);
+}
+
+float SimplifyMesh(PODVector<unsigned>& dest, const PODVector<unsigned>& indices, const PODVector<Vector3>& positions,
+    unsigned targetIndexCount, float maxError)
+{
+    dest = indices;
+    unsigned numVertices = positions.Size();
+    if (dest.Size() <= targetIndexCount || !numVertices)
+        return 0.0f;
+
+    // Normalize positions so that the error is relative to the mesh extent
+    BoundingBox box(positions.Buffer(), numVertices);
+    Vector3 size = box.Size();
+    float extent = Max(Max(size.x_, size.y_), size.z_);
+    if (extent <= 0.0f)
+        return 0.0f;
+    PODVector<Vector3> points(numVertices);
+    for (unsigned i = 0; i < numVertices; ++i)
+        points[i] = (positions[i] - box.min_) / extent;
+
+    // Find vertices sharing a position. These are split along normal or texture coordinate seams and are kept in place,
+    // as moving one copy would tear the seam
+    PODVector<unsigned> positionIds(numVertices);
+    PODVector<unsigned> positionUses(numVertices);
+    HashMap<Vector3, unsigned> positionMap;
+    for (unsigned i = 0; i < numVertices; ++i)
+    {
+        HashMap<Vector3, unsigned>::Iterator j = positionMap.Find(positions[i]);
+        if (j == positionMap.End())
+            j = positionMap.Insert(MakePair(positions[i], i));
+        positionIds[i] = j->second_;
+        positionUses[i] = 0;
+        ++positionUses[j->second_];
+    }
+
+    PODVector<unsigned char> kinds(numVertices);
+    for (unsigned i = 0; i < numVertices; ++i)
+        kinds[i] = positionUses[positionIds[i]] > 1 ? VERTEX_LOCKED : VERTEX_MANIFOLD;
+
+    // Classify open border and non-manifold vertices from the directed edges in position space
+    HashMap<unsigned long long, unsigned> edgeCounts;
+    for (unsigned i = 0; i < dest.Size(); ++i)
+    {
+        unsigned next = i % 3 == 2 ? i - 2 : i + 1;
+        ++edgeCounts[GetEdgeKey(positionIds[dest[i]], positionIds[dest[next]])];
+    }
+
+    PODVector<Quadric> quadrics(numVertices);
+    for (unsigned i = 0; i < dest.Size(); i += 3)
+    {
+        const unsigned* triangle = &dest[i];
+        const Vector3& p0 = points[triangle[0]];
+        Vector3 normal = (points[triangle[1]] - p0).CrossProduct(points[triangle[2]] - p0);
+        float doubleArea = normal.Length();
+        if (doubleArea <= 0.0f)
+            continue;
+        normal /= doubleArea;
+
+        Quadric faceQuadric;
+        faceQuadric.AddPlane(normal, -normal.DotProduct(p0), 0.5 * doubleArea);
+        for (unsigned j = 0; j < 3; ++j)
+        {
+            unsigned from = triangle[j];
+            unsigned to = triangle[(j + 1) % 3];
+            quadrics[from] += faceQuadric;
+
+            HashMap<unsigned long long, unsigned>::ConstIterator edge = edgeCounts.Find(GetEdgeKey(positionIds[from],
+                positionIds[to]));
+            if (edge->second_ > 1)
+            {
+                kinds[from] = VERTEX_LOCKED;
+                kinds[to] = VERTEX_LOCKED;
+            }
+            else if (!edgeCounts.Contains(GetEdgeKey(positionIds[to], positionIds[from])))
+            {
+                // Constrain open borders with a plane perpendicular to the triangle through the edge
+                Vector3 edgeVector = points[to] - points[from];
+                Vector3 borderNormal = edgeVector.CrossProduct(normal).Normalized();
+                Quadric borderQuadric;
+                borderQuadric.AddPlane(borderNormal, -borderNormal.DotProduct(points[from]),
+                    SIMPLIFY_BORDER_WEIGHT * edgeVector.LengthSquared());
+                quadrics[from] += borderQuadric;
+                quadrics[to] += borderQuadric;
+                if (kinds[from] == VERTEX_MANIFOLD)
+                    kinds[from] = VERTEX_BORDER;
+                if (kinds[to] == VERTEX_MANIFOLD)
+                    kinds[to] = VERTEX_BORDER;
+            }
+        }
+    }
+
+    float resultError = 0.0f;
+    PODVector<unsigned> offsets;
+    PODVector<unsigned> vertexTriangles;
+    HashSet<unsigned long long> edges;
+    PODVector<EdgeCollapse> collapses;
+    PODVector<unsigned> remap(numVertices);
+    PODVector<unsigned char> touched(numVertices);
+
+    // Collapse a batch of the cheapest independent edges per pass until the target is reached
+    while (dest.Size() > targetIndexCount)
+    {
+        BuildVertexTriangles(offsets, vertexTriangles, dest, numVertices);
+        edges.Clear();
+        for (unsigned i = 0; i < dest.Size(); ++i)
+        {
+            unsigned next = i % 3 == 2 ? i - 2 : i + 1;
+            edges.Insert(GetEdgeKey(positionIds[dest[i]], positionIds[dest[next]]));
+        }
+
+        collapses.Clear();
+        for (unsigned i = 0; i < dest.Size(); ++i)
+        {
+            unsigned a = dest[i];
+            unsigned b = dest[i % 3 == 2 ? i - 2 : i + 1];
+            bool border = !edges.Contains(GetEdgeKey(positionIds[b], positionIds[a]));
+            // Interior edges are seen from both of their triangles, evaluate them once
+            if (!border && a > b)
+                continue;
+
+            EdgeCollapse collapse{M_MAX_UNSIGNED, M_MAX_UNSIGNED, M_INFINITY};
+            for (unsigned j = 0; j < 2; ++j)
+            {
+                unsigned from = j ? b : a;
+                unsigned to = j ? a : b;
+                if (kinds[from] == VERTEX_LOCKED || (kinds[from] == VERTEX_BORDER && !border))
+                    continue;
+                Quadric quadric = quadrics[from];
+                quadric += quadrics[to];
+                float error = quadric.GetError(points[to]);
+                if (error < collapse.error_)
+                    collapse = EdgeCollapse{from, to, error};
+            }
+            if (collapse.from_ != M_MAX_UNSIGNED)
+                collapses.Push(collapse);
+        }
+        if (collapses.Empty())
+            break;
+
+        Sort(collapses.Begin(), collapses.End(), [](const EdgeCollapse& lhs, const EdgeCollapse& rhs)
+        {
+            return lhs.error_ < rhs.error_;
+        });
+
+        // Each collapse removes about two triangles
+        unsigned numTriangles = dest.Size() / 3;
+        unsigned goal = (numTriangles - targetIndexCount / 3) / 2 + 1;
+        unsigned performed = 0;
+        for (unsigned i = 0; i < numVertices; ++i)
+        {
+            remap[i] = i;
+            touched[i] = 0;
+        }
+
+        for (unsigned i = 0; i < collapses.Size() && performed < goal; ++i)
+        {
+            const EdgeCollapse& collapse = collapses[i];
+            if (collapse.error_ > maxError)
+                break;
+            unsigned from = collapse.from_;
+            unsigned to = collapse.to_;
+            if (touched[from] || touched[to])
+                continue;
+
+            // Reject collapses that would flip or fold the surrounding triangles
+            bool flips = false;
+            for (unsigned j = offsets[from]; j < offsets[from + 1] && !flips; ++j)
+            {
+                const unsigned* triangle = &dest[vertexTriangles[j] * 3];
+                if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                    continue;
+                Vector3 moved[3];
+                for (unsigned k = 0; k < 3; ++k)
+                    moved[k] = triangle[k] == from ? points[to] : points[triangle[k]];
+                const Vector3& p0 = points[triangle[0]];
+                Vector3 oldNormal = (points[triangle[1]] - p0).CrossProduct(points[triangle[2]] - p0);
+                Vector3 newNormal = (moved[1] - moved[0]).CrossProduct(moved[2] - moved[0]);
+                if (oldNormal.DotProduct(newNormal) < SIMPLIFY_MIN_NORMAL_DOT * oldNormal.Length() * newNormal.Length())
+                    flips = true;
+            }
+            if (flips)
+                continue;
+
+            // Lock the one-ring so that later flip tests in this pass see up to date geometry
+            for (unsigned j = offsets[from]; j < offsets[from + 1]; ++j)
+            {
+                const unsigned* triangle = &dest[vertexTriangles[j] * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+            }
+            touched[to] = 1;
+            remap[from] = to;
+            quadrics[to] += quadrics[from];
+            resultError = Max(resultError, collapse.error_);
+            ++performed;
+        }
+        if (!performed)
+            break;
+
+        // Apply the collapses and remove triangles that became degenerate
+        unsigned numIndices = 0;
+        for (unsigned i = 0; i < dest.Size(); i += 3)
+        {
+            unsigned v0 = remap[dest[i]];
+            unsigned v1 = remap[dest[i + 1]];
+            unsigned v2 = remap[dest[i + 2]];
+            if (positionIds[v0] == positionIds[v1] || positionIds[v1] == positionIds[v2] || positionIds[v2] == positionIds[v0])
+                continue;
+            dest[numIndices++] = v0;
+            dest[numIndices++] = v1;
+            dest[numIndices++] = v2;
+        }
+        dest.Resize(numIndices);
+    }
+
+    return resultError;
+}
+
+void GetVertexFetchOrder(PODVector<unsigned>& order, const Vector<PODVector<unsigned> >& indexLists, unsigned numVertices)
+{
+    order.Clear();
+    order.Reserve(numVertices);
+    PODVector<unsigned char> used(numVertices);
+    for (unsigned i = 0; i < numVertices; ++i)
+        used[i] = 0;
+
+    for (unsigned i = 0; i < indexLists.Size(); ++i)
+    {
+        const PODVector<unsigned>& indices = indexLists[i];
+        for (unsigned j = 0; j < indices.Size(); ++j)
+        {
+            if (!used[indices[j]])
+            {
+                used[indices[j]] = 1;
+                order.Push(indices[j]);
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < numVertices; ++i)
+    {
+        if (!used[i])
+            order.Push(i);
+    }
+}
+
+}
@@ -0,0 +1,52 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/Vector.h"
+#include "../Math/Vector3.h"
+
+namespace Urho3D
+{
+
+/// Vertex cache statistics of an index buffer.
+struct URHO3D_API VertexCacheStatistics
+{
+    /// Average cache miss ratio: transformed vertices per triangle. 0.5 is the theoretical optimum, 3 the worst case.
+    float acmr_{};
+    /// Average transformed vertex ratio: transformed vertices per referenced vertex. 1 is the optimum.
+    float atvr_{};
+};
+
+/// Simulate a FIFO post-transform vertex cache over a triangle list and return its statistics.
+URHO3D_API VertexCacheStatistics AnalyzeVertexCache(const PODVector<unsigned>& indices, unsigned numVertices, unsigned cacheSize = 16);
+/// Reorder triangles for post-transform vertex cache efficiency using Tom Forsyth's linear-speed algorithm.
+URHO3D_API void OptimizeVertexCache(PODVector<unsigned>& indices, unsigned numVertices);
+/// Reorder vertex cache optimized triangle clusters so that outward facing clusters are drawn first, to reduce overdraw. The clusters are split at cache-cold triangles so the cache efficiency is kept.
+URHO3D_API void OptimizeOverdraw(PODVector<unsigned>& indices, const PODVector<Vector3>& positions);
+/// Simplify a triangle list towards a target index count with quadric error metric edge collapses. Vertices are only collapsed onto other existing vertices, so the vertex buffer can be shared between LOD levels. Vertices on attribute seams are kept, and open borders only collapse along themselves. Stop when the error relative to the mesh extent would exceed maxError. Return the error reached.
+URHO3D_API float SimplifyMesh(PODVector<unsigned>& dest, const PODVector<unsigned>& indices, const PODVector<Vector3>& positions,
+    unsigned targetIndexCount, float maxError);
+/// Return a vertex order for vertex fetch locality: vertices in order of first use, walking the index lists in the given order. Unreferenced vertices are placed last.
+URHO3D_API void GetVertexFetchOrder(PODVector<unsigned>& order, const Vector<PODVector<unsigned> >& indexLists, unsigned numVertices);
+
+}
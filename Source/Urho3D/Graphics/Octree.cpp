@@ -24,11 +24,14 @@
 
 #include "../Core/Context.h"
 #include "../Core/CoreEvents.h"
+#include "../Core/PerformanceCounters.h"
 #include "../Core/Profiler.h"
 #include "../Core/Thread.h"
 #include "../Core/WorkQueue.h"
+#include "../Graphics/Camera.h"
 #include "../Graphics/DebugRenderer.h"
 #include "../Graphics/Graphics.h"
+#include "../Graphics/HLODCluster.h"
 #include "../Graphics/Octree.h"
 #include "../IO/Log.h"
 #include "../Scene/Scene.h"
@@ -45,24 +48,22 @@ namespace Urho3D
 
 static const float DEFAULT_OCTREE_SIZE = 1000.0f;
 static const int DEFAULT_OCTREE_LEVELS = 8;
-
-extern const char* SUBSYSTEM_CATEGORY;
-
-void UpdateDrawablesWork(const WorkItem* item, unsigned threadIndex)
+/// Minimum number of drawables updated by a single parallel batch.
+static const unsigned DRAWABLE_UPDATE_BATCH_SIZE = 16;
+/// Maximum subdivision levels reached by automatic octree growth.
+static const unsigned MAX_GROWN_OCTREE_LEVELS = 16;
+/// Number of AABB tree leaves passed to a query at once.
+static const unsigned TREE_QUERY_BATCH_SIZE = 32;
+
+static const char* spatialIndexNames[] =
 {
-    URHO3D_PROFILE("UpdateDrawablesWork");
-    const FrameInfo& frame = *(reinterpret_cast<FrameInfo*>(item->aux_));
-    auto** start = reinterpret_cast<Drawable**>(item->start_);
-    auto** end = reinterpret_cast<Drawable**>(item->end_);
+    "Octree",
+    "Growing Octree",
+    "AABB Tree",
+    nullptr
+};
 
-    while (start != end)
-    {
-        Drawable* drawable = *start;
-        if (drawable)
-            drawable->Update(frame);
-        ++start;
-    }
-}
+extern const char* SUBSYSTEM_CATEGORY;
 
 inline bool CompareRayQueryResults(const RayQueryResult& lhs, const RayQueryResult& rhs)
 {
@@ -86,10 +87,11 @@ Octant::~Octant()
         for (PODVector<Drawable*>::Iterator i = drawables_.Begin(); i != drawables_.End(); ++i)
         {
             (*i)->SetOctant(root_);
-            root_->drawables_.Push(*i);
+            root_->PushDrawable(*i);
             root_->QueueUpdate(*i);
         }
         drawables_.Clear();
+        cullingData_.Clear();
         numDrawables_ = 0;
     }
 
@@ -121,7 +123,19 @@ Octant* Octant::GetOrCreateChild(unsigned index)
     else
         newMax.z_ = oldCenter.z_;
 
-    children_[index] = new Octant(BoundingBox(newMin, newMax), level_ + 1, this, root_, index);
+    // Reuse an octant released earlier, including the capacity of its vectors
+    if (root_ && !root_->freeOctants_.Empty())
+    {
+        Octant* child = root_->freeOctants_.Back();
+        root_->freeOctants_.Pop();
+        child->Initialize(BoundingBox(newMin, newMax));
+        child->level_ = level_ + 1;
+        child->parent_ = this;
+        child->index_ = index;
+        children_[index] = child;
+    }
+    else
+        children_[index] = new Octant(BoundingBox(newMin, newMax), level_ + 1, this, root_, index);
     return children_[index];
 }
 
@@ -132,6 +146,43 @@ void Octant::DeleteChild(unsigned index)
     children_[index] = nullptr;
 }
 
+void Octant::ReleaseChild(unsigned index)
+{
+    assert(index < NUM_OCTANTS);
+    Octant* child = children_[index];
+    if (!root_)
+    {
+        DeleteChild(index);
+        return;
+    }
+
+    // An octant becomes empty only after its drawables and child octants are gone
+    assert(child->drawables_.Empty() && child->cullingData_.Empty() && !child->numDrawables_);
+    children_[index] = nullptr;
+    child->parent_ = nullptr;
+    root_->freeOctants_.Push(child);
+}
+
+void Octant::AdoptChildren(Octant** children, unsigned levelOffset)
+{
+    unsigned numDrawables = 0;
+    for (unsigned i = 0; i < NUM_OCTANTS; ++i)
+    {
+        Octant* child = children[i];
+        if (!child)
+            continue;
+
+        assert(!children_[i]);
+        children_[i] = child;
+        child->parent_ = this;
+        child->AddLevels(levelOffset);
+        numDrawables += child->numDrawables_;
+    }
+
+    for (Octant* octant = this; octant; octant = octant->parent_)
+        octant->numDrawables_ += numDrawables;
+}
+
 void Octant::InsertDrawable(Drawable* drawable)
 {
     const BoundingBox& box = drawable->GetWorldBoundingBox();
@@ -149,10 +200,12 @@ void Octant::InsertDrawable(Drawable* drawable)
         Octant* oldOctant = drawable->octant_;
         if (oldOctant != this)
         {
-            // Add first, then remove, because drawable count going to zero deletes the octree branch in question
+            // Add first, then remove, because drawable count going to zero deletes the octree branch in question.
+            // Adding overwrites the drawable's index, so remember the old one for fast removal
+            unsigned oldIndex = drawable->octantIndex_;
             AddDrawable(drawable);
-            if (oldOctant)
-                oldOctant->RemoveDrawable(drawable, false);
+            if (oldOctant && oldOctant->EraseDrawable(drawable, oldIndex))
+                oldOctant->DecDrawableCount();
         }
     }
     else
@@ -166,6 +219,22 @@ void Octant::InsertDrawable(Drawable* drawable)
     }
 }
 
+void Octant::RemoveDrawable(Drawable* drawable, bool resetOctant)
+{
+    if (EraseDrawable(drawable, drawable->octantIndex_))
+    {
+        if (drawable->treeLeaf_ != AABBTree::NULL_NODE && root_)
+            root_->RemoveTreeDrawable(drawable);
+        if (resetOctant)
+        {
+            if (root_)
+                root_->MarkDrawableRemoved(drawable);
+            drawable->SetOctant(nullptr);
+        }
+        DecDrawableCount();
+    }
+}
+
 bool Octant::CheckDrawableFit(const BoundingBox& box) const
 {
     Vector3 boxSize = box.Size();
@@ -190,6 +259,62 @@ bool Octant::CheckDrawableFit(const BoundingBox& box) const
     return false;
 }
 
+void Octant::AddLevels(unsigned levelOffset)
+{
+    level_ += levelOffset;
+    for (auto child : children_)
+    {
+        if (child)
+            child->AddLevels(levelOffset);
+    }
+}
+
+void Octant::PushDrawable(Drawable* drawable)
+{
+    unsigned index = drawables_.Size();
+    unsigned slot = index % BoundingBoxPacket::SIZE;
+    if (!slot)
+    {
+        cullingData_.Resize(cullingData_.Size() + 1);
+        DrawableCullingPacket& packet = cullingData_.Back();
+        for (unsigned i = 0; i < BoundingBoxPacket::SIZE; ++i)
+            packet.Clear(i);
+    }
+
+    drawable->octantIndex_ = index;
+    drawables_.Push(drawable);
+    cullingData_.Back().Define(slot, drawable);
+}
+
+bool Octant::EraseDrawable(Drawable* drawable, unsigned index)
+{
+    if (index >= drawables_.Size() || drawables_[index] != drawable)
+    {
+        index = drawables_.IndexOf(drawable);
+        if (index >= drawables_.Size())
+            return false;
+    }
+
+    // Keep the drawables packed by moving the last one into the vacated slot
+    unsigned last = drawables_.Size() - 1;
+    if (index != last)
+    {
+        Drawable* moved = drawables_[last];
+        drawables_[index] = moved;
+        moved->octantIndex_ = index;
+        cullingData_[index / BoundingBoxPacket::SIZE].Define(index % BoundingBoxPacket::SIZE,
+            cullingData_[last / BoundingBoxPacket::SIZE], last % BoundingBoxPacket::SIZE);
+    }
+
+    drawables_.Pop();
+    if (last % BoundingBoxPacket::SIZE == 0)
+        cullingData_.Pop();
+    else
+        cullingData_.Back().Clear(last % BoundingBoxPacket::SIZE);
+
+    return true;
+}
+
 void Octant::ResetRoot()
 {
     root_ = nullptr;
@@ -227,7 +352,7 @@ void Octant::Initialize(const BoundingBox& box)
     cullingBox_ = BoundingBox(worldBoundingBox_.min_ - halfSize_, worldBoundingBox_.max_ + halfSize_);
 }
 
-void Octant::GetDrawablesInternal(OctreeQuery& query, bool inside) const
+void Octant::GetDrawablesInternal(OctreeQuery& query, bool inside, bool useCullingData) const
 {
     if (this != root_)
     {
@@ -245,20 +370,23 @@ void Octant::GetDrawablesInternal(OctreeQuery& query, bool inside) const
     {
         auto** start = const_cast<Drawable**>(&drawables_[0]);
         Drawable** end = start + drawables_.Size();
-        query.TestDrawables(start, end, inside);
+        if (useCullingData)
+            query.TestDrawables(start, end, &cullingData_[0], inside);
+        else
+            query.TestDrawables(start, end, inside);
     }
 
     for (auto child : children_)
     {
         if (child)
-            child->GetDrawablesInternal(query, inside);
+            child->GetDrawablesInternal(query, inside, useCullingData);
     }
 }
 
 void Octant::GetDrawablesInternal(RayOctreeQuery& query) const
 {
-    float octantDist = query.ray_.HitDistance(cullingBox_);
-    if (octantDist >= query.maxDistance_)
+    // The root octant also holds the drawables outside the octree bounds, so it can not be culled
+    if (this != root_ && query.ray_.HitDistance(cullingBox_) >= query.maxDistance_)
         return;
 
     if (drawables_.Size())
@@ -284,8 +412,8 @@ void Octant::GetDrawablesInternal(RayOctreeQuery& query) const
 
 void Octant::GetDrawablesOnlyInternal(RayOctreeQuery& query, PODVector<Drawable*>& drawables) const
 {
-    float octantDist = query.ray_.HitDistance(cullingBox_);
-    if (octantDist >= query.maxDistance_)
+    // The root octant also holds the drawables outside the octree bounds, so it can not be culled
+    if (this != root_ && query.ray_.HitDistance(cullingBox_) >= query.maxDistance_)
         return;
 
     if (drawables_.Size())
@@ -312,19 +440,31 @@ void Octant::GetDrawablesOnlyInternal(RayOctreeQuery& query, PODVector<Drawable*
 Octree::Octree(Context* context) :
     Component(context),
     Octant(BoundingBox(-DEFAULT_OCTREE_SIZE, DEFAULT_OCTREE_SIZE), 0, nullptr, this),
-    numLevels_(DEFAULT_OCTREE_LEVELS)
+    numLevels_(DEFAULT_OCTREE_LEVELS),
+    spatialIndex_(SPATIAL_INDEX_OCTREE)
 {
     // If the engine is running headless, subscribe to RenderUpdate events for manually updating the octree
     // to allow raycasts and animation update
     if (!GetSubsystem<Graphics>())
-        SubscribeToEvent(E_RENDERUPDATE, URHO3D_HANDLER(Octree, HandleRenderUpdate));
+        SubscribeToEvent(&Octree::HandleRenderUpdate);
+
+    if (auto* counters = GetSubsystem<PerformanceCounters>())
+        movedDrawablesCounter_ = counters->GetCounter("MovedDrawables");
 }
 
 Octree::~Octree()
 {
     // Reset root pointer from all child octants now so that they do not move their drawables to root
+    TakeQueuedUpdates(drawableUpdates_);
+    for (PODVector<Drawable*>::Iterator i = drawableUpdates_.Begin(); i != drawableUpdates_.End(); ++i)
+        (*i)->updateQueued_ = false;
     drawableUpdates_.Clear();
+    for (PODVector<Drawable*>::Iterator i = drawables_.Begin(); i != drawables_.End(); ++i)
+        (*i)->treeLeaf_ = AABBTree::NULL_NODE;
     ResetRoot();
+
+    for (PODVector<Octant*>::Iterator i = freeOctants_.Begin(); i != freeOctants_.End(); ++i)
+        delete *i;
 }
 
 void Octree::RegisterObject(Context* context)
@@ -337,6 +477,9 @@ void Octree::RegisterObject(Context* context)
     URHO3D_ATTRIBUTE_EX("Bounding Box Min", Vector3, worldBoundingBox_.min_, UpdateOctreeSize, defaultBoundsMin, AM_DEFAULT);
     URHO3D_ATTRIBUTE_EX("Bounding Box Max", Vector3, worldBoundingBox_.max_, UpdateOctreeSize, defaultBoundsMax, AM_DEFAULT);
     URHO3D_ATTRIBUTE_EX("Number of Levels", int, numLevels_, UpdateOctreeSize, DEFAULT_OCTREE_LEVELS, AM_DEFAULT);
+    URHO3D_ENUM_ACCESSOR_ATTRIBUTE("Spatial Index", GetSpatialIndex, SetSpatialIndex, SpatialIndexType, spatialIndexNames,
+        SPATIAL_INDEX_OCTREE, AM_DEFAULT);
+    URHO3D_ACCESSOR_ATTRIBUTE("AABB Tree Margin", GetTreeMargin, SetTreeMargin, float, DEFAULT_AABB_TREE_MARGIN, AM_DEFAULT);
 }
 
 void Octree::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
@@ -345,7 +488,18 @@ void Octree::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
     {
         URHO3D_PROFILE("OctreeDrawDebug");
 
-        Octant::DrawDebugGeometry(debug, depthTest);
+        if (spatialIndex_ == SPATIAL_INDEX_AABB_TREE)
+        {
+            tree_.Traverse([debug, depthTest](const AABBTreeNode& node, int state) -> int
+            {
+                if (node.IsLeaf() || !debug->IsInside(node.GetBox()))
+                    return -1;
+                debug->AddBoundingBox(node.GetBox(), Color(0.25f, 0.25f, 0.25f), depthTest);
+                return state;
+            });
+        }
+        else
+            Octant::DrawDebugGeometry(debug, depthTest);
     }
 }
 
@@ -362,6 +516,72 @@ void Octree::SetSize(const BoundingBox& box, unsigned numLevels)
     numLevels_ = Max(numLevels, 1U);
 }
 
+void Octree::SetSpatialIndex(SpatialIndexType type)
+{
+    if (type == spatialIndex_)
+        return;
+
+    URHO3D_PROFILE("ChangeSpatialIndex");
+
+    SpatialIndexType oldType = spatialIndex_;
+    spatialIndex_ = type;
+
+    // The AABB tree keeps all drawables in the root octant, so only those need to be inserted to the new index
+    if (oldType == SPATIAL_INDEX_AABB_TREE)
+    {
+        for (PODVector<Drawable*>::Iterator i = drawables_.Begin(); i != drawables_.End(); ++i)
+            (*i)->treeLeaf_ = AABBTree::NULL_NODE;
+        tree_.Clear();
+    }
+    else if (type == SPATIAL_INDEX_AABB_TREE)
+        SetSize(worldBoundingBox_, numLevels_);
+
+    PODVector<Drawable*> drawables(drawables_);
+    for (PODVector<Drawable*>::Iterator i = drawables.Begin(); i != drawables.End(); ++i)
+        InsertDrawable(*i);
+}
+
+void Octree::SetTreeMargin(float margin)
+{
+    tree_.SetMargin(margin);
+}
+
+void Octree::InsertDrawable(Drawable* drawable)
+{
+    if (spatialIndex_ != SPATIAL_INDEX_AABB_TREE)
+    {
+        if (spatialIndex_ == SPATIAL_INDEX_GROWING_OCTREE && CheckGrowth(drawable))
+            Grow(drawable->GetWorldBoundingBox());
+        Octant::InsertDrawable(drawable);
+        MarkDrawableChanged(drawable);
+        return;
+    }
+
+    // The drawables are kept in the root octant for bookkeeping, while the tree is used for queries
+    Octant* oldOctant = drawable->GetOctant();
+    if (oldOctant != this)
+    {
+        if (oldOctant)
+            oldOctant->RemoveDrawable(drawable);
+        AddDrawable(drawable);
+    }
+
+    // Undefined bounds would spread to the ancestor nodes, so insert such drawables as points
+    BoundingBox box = drawable->GetWorldBoundingBox();
+    if (!box.Defined() || box.min_.IsNaN() || box.max_.IsNaN())
+    {
+        Node* node = drawable->GetNode();
+        Vector3 position = node ? node->GetWorldPosition() : Vector3::ZERO;
+        box = BoundingBox(position, position);
+    }
+
+    if (drawable->treeLeaf_ == AABBTree::NULL_NODE)
+        drawable->treeLeaf_ = tree_.InsertLeaf(drawable, box);
+    else
+        tree_.MoveLeaf(drawable->treeLeaf_, box);
+    MarkDrawableChanged(drawable);
+}
+
 void Octree::Update(const FrameInfo& frame)
 {
     if (!Thread::IsMainThread())
@@ -370,6 +590,32 @@ void Octree::Update(const FrameInfo& frame)
         return;
     }
 
+    // Apply transform changes made after the scene update, for example camera movement
+    Scene* scene = GetScene();
+    if (scene)
+        scene->UpdateTransforms();
+
+    // Switch hierarchical LOD clusters first, as the switch adds and removes drawables. Switch by all cameras viewing the
+    // scene, so that no view sees a proxy closer than its switch distance
+    switchCameras_.Clear();
+    if (frame.camera_)
+        switchCameras_.Push(frame.camera_);
+    for (Vector<WeakPtr<Camera> >::ConstIterator i = viewCameras_.Begin(); i != viewCameras_.End(); ++i)
+    {
+        if (*i && !switchCameras_.Contains(*i))
+            switchCameras_.Push(*i);
+    }
+    viewCameras_.Clear();
+
+    if (!switchCameras_.Empty() && !hlodClusters_.Empty())
+    {
+        URHO3D_PROFILE("UpdateHLODClusters");
+        for (PODVector<HLODCluster*>::ConstIterator i = hlodClusters_.Begin(); i != hlodClusters_.End(); ++i)
+            (*i)->UpdateSwitch(switchCameras_);
+    }
+
+    TakeQueuedUpdates(drawableUpdates_);
+
     // Let drawables update themselves before reinsertion. This can be used for animation
     if (!drawableUpdates_.Empty())
     {
@@ -377,57 +623,38 @@ void Octree::Update(const FrameInfo& frame)
 
         // Perform updates in worker threads. Notify the scene that a threaded update is going on and components
         // (for example physics objects) should not perform non-threadsafe work when marked dirty
-        Scene* scene = GetScene();
         auto* queue = GetSubsystem<WorkQueue>();
         scene->BeginThreadedUpdate();
 
-        int numWorkItems = queue->GetNumThreads() + 1; // Worker threads + main thread
-        int drawablesPerItem = Max((int)(drawableUpdates_.Size() / numWorkItems), 1);
-
-        PODVector<Drawable*>::Iterator start = drawableUpdates_.Begin();
-        // Create a work item for each thread
-        for (int i = 0; i < numWorkItems; ++i)
+        queue->ParallelFor(drawableUpdates_.Size(), DRAWABLE_UPDATE_BATCH_SIZE, [&](unsigned begin, unsigned end, unsigned threadIndex)
         {
-            SharedPtr<WorkItem> item = queue->GetFreeItem();
-            item->priority_ = M_MAX_UNSIGNED;
-            item->workFunction_ = UpdateDrawablesWork;
-            item->aux_ = const_cast<FrameInfo*>(&frame);
-
-            PODVector<Drawable*>::Iterator end = drawableUpdates_.End();
-            if (i < numWorkItems - 1 && end - start > drawablesPerItem)
-                end = start + drawablesPerItem;
-
-            item->start_ = &(*start);
-            item->end_ = &(*end);
-            queue->AddWorkItem(item);
-
-            start = end;
-        }
+            URHO3D_PROFILE("UpdateDrawablesWork");
+            for (unsigned i = begin; i < end; ++i)
+            {
+                Drawable* drawable = drawableUpdates_[i];
+                if (drawable)
+                    drawable->Update(frame);
+            }
+        });
 
-        queue->Complete(M_MAX_UNSIGNED);
         scene->EndThreadedUpdate();
     }
 
-    // If any drawables were inserted during threaded update, update them now from the main thread
-    if (!threadedDrawableUpdates_.Empty())
+    // If any drawables were queued during threaded update, update them now from the main thread. Apply the transform changes
+    // made by the updates first, as that queues the drawables which have moved along
+    if (scene)
+        scene->UpdateTransforms();
+    unsigned numUpdated = drawableUpdates_.Size();
+    TakeQueuedUpdates(drawableUpdates_);
+    if (drawableUpdates_.Size() > numUpdated)
     {
         URHO3D_PROFILE("UpdateDrawablesQueuedDuringUpdate");
 
-        for (PODVector<Drawable*>::ConstIterator i = threadedDrawableUpdates_.Begin(); i != threadedDrawableUpdates_.End(); ++i)
-        {
-            Drawable* drawable = *i;
-            if (drawable)
-            {
-                drawable->Update(frame);
-                drawableUpdates_.Push(drawable);
-            }
-        }
-
-        threadedDrawableUpdates_.Clear();
+        for (unsigned i = numUpdated; i < drawableUpdates_.Size(); ++i)
+            drawableUpdates_[i]->Update(frame);
     }
 
     // Notify drawable update being finished. Custom animation (eg. IK) can be done at this point
-    Scene* scene = GetScene();
     if (scene)
     {
         using namespace SceneDrawableUpdateFinished;
@@ -436,33 +663,85 @@ void Octree::Update(const FrameInfo& frame)
         eventData[P_SCENE] = scene;
         eventData[P_TIMESTEP] = frame.timeStep_;
         scene->SendEvent(E_SCENEDRAWABLEUPDATEFINISHED, eventData);
+        scene->UpdateTransforms();
     }
 
+    // Drawables moved by the event handlers are reinserted without an update, as they have already been updated
+    TakeQueuedUpdates(drawableUpdates_);
+
     // Reinsert drawables that have been moved or resized, or that have been newly added to the octree and do not sit inside
     // the proper octant yet
     if (!drawableUpdates_.Empty())
     {
         URHO3D_PROFILE("ReinsertToOctree");
 
-        for (PODVector<Drawable*>::Iterator i = drawableUpdates_.Begin(); i != drawableUpdates_.End(); ++i)
+        // Resolve the world transforms in the main thread first, as drawables may share dirty parent nodes, which would
+        // otherwise be updated from several worker threads at once
+        for (PODVector<Drawable*>::ConstIterator i = drawableUpdates_.Begin(); i != drawableUpdates_.End(); ++i)
         {
-            Drawable* drawable = *i;
-            drawable->updateQueued_ = false;
-            Octant* octant = drawable->GetOctant();
-            const BoundingBox& box = drawable->GetWorldBoundingBox();
+            if (Node* node = (*i)->GetNode())
+                node->GetWorldTransform();
+        }
 
-            // Skip if no octant or does not belong to this octree anymore
-            if (!octant || octant->GetRoot() != this)
-                continue;
-            // Skip if still fits the current octant
-            if (drawable->IsOccludee() && octant->GetCullingBox().IsInside(box) == INSIDE && octant->CheckDrawableFit(box))
+        // Then check in worker threads which drawables still fit their current octant. This calculates the world
+        // bounding boxes, which is the most expensive part. Only the octant culling data is modified, one slot per drawable
+        reinsertFlags_.Resize(drawableUpdates_.Size());
+        auto* queue = GetSubsystem<WorkQueue>();
+        if (scene)
+            scene->BeginThreadedUpdate();
+        queue->ParallelFor(drawableUpdates_.Size(), DRAWABLE_UPDATE_BATCH_SIZE, [&](unsigned begin, unsigned end, unsigned threadIndex)
+        {
+            URHO3D_PROFILE("CheckDrawableFitWork");
+            for (unsigned i = begin; i < end; ++i)
+            {
+                Drawable* drawable = drawableUpdates_[i];
+                drawable->updateQueued_ = false;
+                Octant* octant = drawable->GetOctant();
+                const BoundingBox& box = drawable->GetWorldBoundingBox();
+                reinsertFlags_[i] = 0;
+
+                // Skip if no octant or does not belong to this octree anymore
+                if (!octant || octant->GetRoot() != this)
+                    continue;
+                // Skip if still fits the current octant or tree leaf, but refresh the culling data as the bounds have changed
+                bool fits;
+                if (spatialIndex_ == SPATIAL_INDEX_AABB_TREE)
+                    fits = drawable->treeLeaf_ != AABBTree::NULL_NODE && tree_.CheckLeafFit(drawable->treeLeaf_, box);
+                else
+                {
+                    fits = drawable->IsOccludee() && octant->GetCullingBox().IsInside(box) == INSIDE &&
+                        octant->CheckDrawableFit(box);
+                }
+                if (fits)
+                {
+                    octant->UpdateCullingData(drawable);
+                    continue;
+                }
+
+                reinsertFlags_[i] = 1;
+            }
+        });
+        if (scene)
+            scene->EndThreadedUpdate();
+
+        // Finally move the drawables that do not fit in the main thread, as moving modifies the octant hierarchy
+        unsigned numMoved = 0;
+        for (unsigned i = 0; i < drawableUpdates_.Size(); ++i)
+        {
+            if (!reinsertFlags_[i])
                 continue;
 
+            Drawable* drawable = drawableUpdates_[i];
+            Octant* oldOctant = drawable->GetOctant();
             InsertDrawable(drawable);
+            Octant* octant = drawable->GetOctant();
+            octant->UpdateCullingData(drawable);
+            if (octant != oldOctant || spatialIndex_ == SPATIAL_INDEX_AABB_TREE)
+                ++numMoved;
 
 #ifdef _DEBUG
             // Verify that the drawable will be culled correctly
-            octant = drawable->GetOctant();
+            const BoundingBox& box = drawable->GetWorldBoundingBox();
             if (octant != this && octant->GetCullingBox().IsInside(box) != INSIDE)
             {
                 URHO3D_LOGERROR("Drawable is not fully inside its octant's culling bounds: drawable box " + box.ToString() +
@@ -470,7 +749,21 @@ void Octree::Update(const FrameInfo& frame)
             }
 #endif
         }
+
+        if (movedDrawablesCounter_)
+            movedDrawablesCounter_->Increment(numMoved);
+    }
+
+    // Publish the drawables changed since the previous update, so that cached query results can be updated incrementally
+    for (PODVector<Drawable*>::Iterator i = drawableUpdates_.Begin(); i != drawableUpdates_.End(); ++i)
+    {
+        Octant* octant = (*i)->GetOctant();
+        if (octant && octant->GetRoot() == this)
+            MarkDrawableChanged(*i);
     }
+    changedDrawables_.Clear();
+    changedDrawables_.Swap(pendingChangedDrawables_);
+    ++revision_;
 
     drawableUpdates_.Clear();
 }
@@ -480,7 +773,13 @@ void Octree::AddManualDrawable(Drawable* drawable)
     if (!drawable || drawable->GetOctant())
         return;
 
-    AddDrawable(drawable);
+    if (spatialIndex_ == SPATIAL_INDEX_AABB_TREE)
+        InsertDrawable(drawable);
+    else
+    {
+        AddDrawable(drawable);
+        MarkDrawableChanged(drawable);
+    }
 }
 
 void Octree::RemoveManualDrawable(Drawable* drawable)
@@ -493,10 +792,69 @@ void Octree::RemoveManualDrawable(Drawable* drawable)
         octant->RemoveDrawable(drawable);
 }
 
+void Octree::AddHLODCluster(HLODCluster* cluster)
+{
+    if (cluster)
+        hlodClusters_.Push(cluster);
+}
+
+void Octree::RemoveHLODCluster(HLODCluster* cluster)
+{
+    hlodClusters_.Remove(cluster);
+}
+
+void Octree::AddViewCamera(Camera* camera)
+{
+    if (camera && !viewCameras_.Contains(WeakPtr<Camera>(camera)))
+        viewCameras_.Push(WeakPtr<Camera>(camera));
+}
+
 void Octree::GetDrawables(OctreeQuery& query) const
 {
     query.result_.Clear();
-    GetDrawablesInternal(query, false);
+    // Culling data of drawables moved from the main thread is stale until they are reinserted, so test those drawables
+    // one by one. Drawables queued from worker threads during rendering lag at most one frame and are not waited for
+    if (spatialIndex_ == SPATIAL_INDEX_AABB_TREE)
+        GetTreeDrawables(query);
+    else
+        GetDrawablesInternal(query, false, query.UsesCullingData() && drawableUpdates_.Empty() && mainThreadUpdates_.Empty());
+}
+
+bool Octree::GetDrawables(OctreeQuery& query, OctreeQueryCache& cache) const
+{
+    assert(&query.result_ == &cache.drawables_);
+
+    // Drawables moved from the main thread since the update are not tracked yet, and removed drawables may still be
+    // referred to by the cached result. Query in full in those cases, or if the cache is older than the previous update
+    bool pendingUpdates = !drawableUpdates_.Empty() || !mainThreadUpdates_.Empty();
+    if (cache.octree_ != this || cache.structureRevision_ != structureRevision_ || pendingUpdates ||
+        (cache.revision_ != revision_ && cache.revision_ + 1 != revision_))
+    {
+        GetDrawables(query);
+        cache.octree_ = this;
+        cache.revision_ = revision_;
+        cache.structureRevision_ = structureRevision_;
+        return false;
+    }
+
+    if (cache.revision_ != revision_ && !changedDrawables_.Empty())
+    {
+        // Remove the changed drawables from the result, then test them again
+        PODVector<Drawable*>& result = cache.drawables_;
+        unsigned numKept = 0;
+        for (unsigned i = 0; i < result.Size(); ++i)
+        {
+            if (result[i]->changeRevision_ != revision_)
+                result[numKept++] = result[i];
+        }
+        result.Resize(numKept);
+
+        auto** start = const_cast<Drawable**>(changedDrawables_.Buffer());
+        query.TestDrawables(start, start + changedDrawables_.Size(), false);
+    }
+
+    cache.revision_ = revision_;
+    return true;
 }
 
 void Octree::Raycast(RayOctreeQuery& query) const
@@ -504,7 +862,10 @@ void Octree::Raycast(RayOctreeQuery& query) const
     URHO3D_PROFILE("Raycast");
 
     query.result_.Clear();
-    GetDrawablesInternal(query);
+    if (spatialIndex_ == SPATIAL_INDEX_AABB_TREE)
+        GetTreeDrawables(query);
+    else
+        GetDrawablesInternal(query);
     Sort(query.result_.Begin(), query.result_.End(), CompareRayQueryResults);
 }
 
@@ -514,7 +875,10 @@ void Octree::RaycastSingle(RayOctreeQuery& query) const
 
     query.result_.Clear();
     rayQueryDrawables_.Clear();
-    GetDrawablesOnlyInternal(query, rayQueryDrawables_);
+    if (spatialIndex_ == SPATIAL_INDEX_AABB_TREE)
+        GetTreeDrawablesOnly(query, rayQueryDrawables_);
+    else
+        GetDrawablesOnlyInternal(query, rayQueryDrawables_);
 
     // Sort by increasing hit distance to AABB
     for (PODVector<Drawable*>::Iterator i = rayQueryDrawables_.Begin(); i != rayQueryDrawables_.End(); ++i)
@@ -534,8 +898,9 @@ void Octree::RaycastSingle(RayOctreeQuery& query) const
         {
             unsigned oldSize = query.result_.Size();
             drawable->ProcessRayQuery(query, query.result_);
-            if (query.result_.Size() > oldSize)
-                closestHit = Min(closestHit, query.result_.Back().distance_);
+            // A drawable may add several results, for example a hierarchical LOD cluster raycasting its members
+            for (unsigned j = oldSize; j < query.result_.Size(); ++j)
+                closestHit = Min(closestHit, query.result_[j].distance_);
         }
         else
             break;
@@ -550,44 +915,245 @@ void Octree::RaycastSingle(RayOctreeQuery& query) const
 
 void Octree::QueueUpdate(Drawable* drawable)
 {
-    Scene* scene = GetScene();
-    if (scene && scene->IsThreadedUpdate())
-    {
-        MutexLock lock(octreeMutex_);
-        threadedDrawableUpdates_.Push(drawable);
-    }
-    else
-        drawableUpdates_.Push(drawable);
+    // The flag keeps the drawable in one queue at most
+    if (drawable->updateQueued_.exchange(true))
+        return;
 
-    drawable->updateQueued_ = true;
+    // Drawables queued from the main thread are kept apart, as only they make the octant culling data stale for queries
+    if (Thread::IsMainThread())
+        mainThreadUpdates_.Push(drawable);
+    else
+        threadedUpdates_.Push(drawable);
 }
 
 void Octree::CancelUpdate(Drawable* drawable)
 {
-    // This doesn't have to take into account scene being in threaded update, because it is called only
-    // when removing a drawable from octree, which should only ever happen from the main thread.
-    drawableUpdates_.Remove(drawable);
+    // This is called only when removing a drawable from octree, which should only ever happen from the main thread.
+    // The queues can not remove elements, so take them to be searched
+    TakeQueuedUpdates(drawableUpdates_, mainThreadUpdates_);
+    TakeQueuedUpdates(threadedDrawableUpdates_, threadedUpdates_);
+    if (!drawableUpdates_.Remove(drawable))
+        threadedDrawableUpdates_.Remove(drawable);
     drawable->updateQueued_ = false;
 }
 
+void Octree::MarkDrawableChanged(Drawable* drawable)
+{
+    // The revision stamp keeps the drawable in the list only once
+    if (drawable->changeRevision_ != revision_ + 1)
+    {
+        drawable->changeRevision_ = revision_ + 1;
+        drawable->changeIndex_ = pendingChangedDrawables_.Size();
+        pendingChangedDrawables_.Push(drawable);
+    }
+}
+
+void Octree::MarkDrawableRemoved(Drawable* drawable)
+{
+    // The drawable may be destroyed, so it must not remain in the list to be published. The order of the list does not
+    // matter, so move the last drawable into its place
+    unsigned index = drawable->changeIndex_;
+    if (drawable->changeRevision_ == revision_ + 1 && index < pendingChangedDrawables_.Size() &&
+        pendingChangedDrawables_[index] == drawable)
+    {
+        Drawable* last = pendingChangedDrawables_.Back();
+        pendingChangedDrawables_[index] = last;
+        last->changeIndex_ = index;
+        pendingChangedDrawables_.Pop();
+    }
+    drawable->changeRevision_ = 0;
+    ++structureRevision_;
+}
+
+void Octree::TakeQueuedUpdates(PODVector<Drawable*>& dest)
+{
+    TakeQueuedUpdates(dest, mainThreadUpdates_);
+    TakeQueuedUpdates(dest, threadedUpdates_);
+    if (!threadedDrawableUpdates_.Empty())
+    {
+        dest.Push(threadedDrawableUpdates_);
+        threadedDrawableUpdates_.Clear();
+    }
+}
+
+void Octree::TakeQueuedUpdates(PODVector<Drawable*>& dest, DrawableUpdateQueue& queue)
+{
+    // Walk the list only once and restore the push order in the vector instead, as the drawables are likely not cached
+    unsigned start = dest.Size();
+    for (Drawable* drawable = queue.TakeAll(); drawable; drawable = drawable->nextQueuedUpdate_)
+        dest.Push(drawable);
+    for (unsigned i = start, j = dest.Size(); i + 1 < j; ++i, --j)
+        Swap(dest[i], dest[j - 1]);
+}
+
+void Octree::Grow(const BoundingBox& box)
+{
+    URHO3D_PROFILE("GrowOctree");
+
+    // Double the size towards the bounding box, so that the current octree becomes a child octant and leaf octants keep
+    // their size
+    BoundingBox newBox = worldBoundingBox_;
+    unsigned newLevels = numLevels_;
+    while (newLevels < MAX_GROWN_OCTREE_LEVELS && newBox.IsInside(box) != INSIDE)
+    {
+        Vector3 size = newBox.Size();
+        if (box.min_.x_ < newBox.min_.x_)
+            newBox.min_.x_ -= size.x_;
+        else
+            newBox.max_.x_ += size.x_;
+        if (box.min_.y_ < newBox.min_.y_)
+            newBox.min_.y_ -= size.y_;
+        else
+            newBox.max_.y_ += size.y_;
+        if (box.min_.z_ < newBox.min_.z_)
+            newBox.min_.z_ -= size.z_;
+        else
+            newBox.max_.z_ += size.z_;
+        ++newLevels;
+    }
+
+    if (newLevels == numLevels_)
+        return;
+
+    // Detach the child octants and resize the root. The drawables of the child octants need no update, as the octants
+    // are moved as a whole below the new octant that has the old root bounds
+    BoundingBox oldBox = worldBoundingBox_;
+    unsigned levelOffset = newLevels - numLevels_;
+    Octant* children[NUM_OCTANTS];
+    bool hasChildren = false;
+    for (unsigned i = 0; i < NUM_OCTANTS; ++i)
+    {
+        children[i] = children_[i];
+        children_[i] = nullptr;
+        hasChildren |= children[i] != nullptr;
+    }
+
+    Initialize(newBox);
+    numDrawables_ = drawables_.Size();
+    numLevels_ = newLevels;
+
+    if (hasChildren)
+    {
+        Vector3 oldCenter = oldBox.Center();
+        Octant* octant = this;
+        for (unsigned i = 0; i < levelOffset; ++i)
+        {
+            Vector3 center = octant->GetWorldBoundingBox().Center();
+            unsigned x = oldCenter.x_ < center.x_ ? 0 : 1;
+            unsigned y = oldCenter.y_ < center.y_ ? 0 : 2;
+            unsigned z = oldCenter.z_ < center.z_ ? 0 : 4;
+            octant = octant->GetOrCreateChild(x + y + z);
+        }
+        octant->AdoptChildren(children, levelOffset);
+    }
+
+    // Reinsert the drawables of the root octant, as the ones which were outside the old bounds may fit now
+    PODVector<Drawable*> drawables(drawables_);
+    for (PODVector<Drawable*>::Iterator i = drawables.Begin(); i != drawables.End(); ++i)
+        Octant::InsertDrawable(*i);
+}
+
+bool Octree::CheckGrowth(Drawable* drawable) const
+{
+    // Non-occludees stay in the root octant anyway. Drawables larger than the octree, such as skyboxes, would not fit
+    // the child octants after growing either
+    const BoundingBox& box = drawable->GetWorldBoundingBox();
+    if (!drawable->IsOccludee() || !box.Defined() || numLevels_ >= MAX_GROWN_OCTREE_LEVELS ||
+        worldBoundingBox_.IsInside(box) == INSIDE)
+        return false;
+
+    Vector3 boxSize = box.Size();
+    Vector3 size = worldBoundingBox_.Size();
+    return boxSize.x_ <= size.x_ && boxSize.y_ <= size.y_ && boxSize.z_ <= size.z_;
+}
+
+void Octree::RemoveTreeDrawable(Drawable* drawable)
+{
+    tree_.RemoveLeaf(drawable->treeLeaf_);
+    drawable->treeLeaf_ = AABBTree::NULL_NODE;
+}
+
+void Octree::GetTreeDrawables(OctreeQuery& query) const
+{
+    // Collect the leaves to batches, so that the query can test several drawables at once. The leaf boxes are not tested,
+    // as the drawables' own bounding boxes are tighter
+    Drawable* batch[TREE_QUERY_BATCH_SIZE];
+    unsigned batchSize = 0;
+    bool batchInside = false;
+
+    tree_.Traverse([&](const AABBTreeNode& node, int state) -> int
+    {
+        bool inside = state != 0;
+        if (node.IsLeaf())
+        {
+            if (batchSize == TREE_QUERY_BATCH_SIZE || (batchSize && inside != batchInside))
+            {
+                query.TestDrawables(batch, batch + batchSize, batchInside);
+                batchSize = 0;
+            }
+            batch[batchSize++] = node.drawable_;
+            batchInside = inside;
+            return -1;
+        }
+
+        Intersection res = query.TestOctant(node.GetBox(), inside);
+        if (res == OUTSIDE)
+            return -1;
+        return res == INSIDE ? 1 : 0;
+    });
+
+    if (batchSize)
+        query.TestDrawables(batch, batch + batchSize, batchInside);
+}
+
+void Octree::GetTreeDrawables(RayOctreeQuery& query) const
+{
+    tree_.Traverse([&query](const AABBTreeNode& node, int state) -> int
+    {
+        if (node.IsLeaf())
+        {
+            Drawable* drawable = node.drawable_;
+            if ((drawable->GetDrawableFlags() & query.drawableFlags_) && (drawable->GetViewMask() & query.viewMask_))
+                drawable->ProcessRayQuery(query, query.result_);
+            return -1;
+        }
+
+        return query.ray_.HitDistance(node.GetBox()) < query.maxDistance_ ? state : -1;
+    });
+}
+
+void Octree::GetTreeDrawablesOnly(RayOctreeQuery& query, PODVector<Drawable*>& drawables) const
+{
+    tree_.Traverse([&query, &drawables](const AABBTreeNode& node, int state) -> int
+    {
+        if (node.IsLeaf())
+        {
+            Drawable* drawable = node.drawable_;
+            if ((drawable->GetDrawableFlags() & query.drawableFlags_) && (drawable->GetViewMask() & query.viewMask_))
+                drawables.Push(drawable);
+            return -1;
+        }
+
+        return query.ray_.HitDistance(node.GetBox()) < query.maxDistance_ ? state : -1;
+    });
+}
+
 void Octree::DrawDebugGeometry(bool depthTest)
 {
     auto* debug = GetComponent<DebugRenderer>();
     DrawDebugGeometry(debug, depthTest);
 }
 
-void Octree::HandleRenderUpdate(StringHash eventType, VariantMap& eventData)
+void Octree::HandleRenderUpdate(RenderUpdateEventData& eventData)
 {
     // When running in headless mode, update the Octree manually during the RenderUpdate event
     Scene* scene = GetScene();
     if (!scene || !scene->IsUpdateEnabled())
         return;
 
-    using namespace RenderUpdate;
-
     FrameInfo frame;
     frame.frameNumber_ = GetSubsystem<Time>()->GetFrameNumber();
-    frame.timeStep_ = eventData[P_TIMESTEP].GetFloat();
+    frame.timeStep_ = eventData.timeStep_;
     frame.camera_ = nullptr;
 
     Update(frame);
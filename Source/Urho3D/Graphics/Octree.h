@@ -23,18 +23,52 @@
 #pragma once
 
 #include "../Container/List.h"
-#include "../Core/Mutex.h"
+#include "../Container/MPSCQueue.h"
+#include "../Graphics/AABBTree.h"
 #include "../Graphics/Drawable.h"
 #include "../Graphics/OctreeQuery.h"
 
 namespace Urho3D
 {
 
+class HLODCluster;
 class Octree;
+class PerformanceCounter;
+struct RenderUpdateEventData;
 
 static const int NUM_OCTANTS = 8;
 static const unsigned ROOT_INDEX = M_MAX_UNSIGNED;
 
+/// Spatial index used by the octree component. The octants of both octree types are loose, as their culling bounds
+/// extend half an octant beyond the octant itself.
+enum SpatialIndexType
+{
+    /// Octree of fixed size. Drawable objects outside the bounds are kept in the root octant.
+    SPATIAL_INDEX_OCTREE = 0,
+    /// Octree that doubles its size automatically to contain drawable objects outside the bounds. Meant for mostly static
+    /// worlds: its octants are sparse, so moving drawable objects change octant more often than in a fixed size octree.
+    SPATIAL_INDEX_GROWING_OCTREE,
+    /// Dynamic AABB tree, which does not use the octree bounds or subdivision levels. Meant for mostly static worlds: each
+    /// drawable object moving out of its leaf bounding box costs more to update than an octree reinsertion.
+    SPATIAL_INDEX_AABB_TREE
+};
+
+/// %Octree query result kept between frames, so that it can be updated incrementally.
+struct URHO3D_API OctreeQueryCache
+{
+    /// Invalidate, so that the next query is performed in full.
+    void Invalidate() { octree_ = nullptr; }
+
+    /// Drawable objects returned by the query.
+    PODVector<Drawable*> drawables_;
+    /// Octree the result was queried from.
+    const Octree* octree_{};
+    /// Octree update revision of the result.
+    unsigned revision_{};
+    /// Octree structure revision of the result.
+    unsigned structureRevision_{};
+};
+
 /// %Octree octant
 class URHO3D_API Octant
 {
@@ -48,6 +82,10 @@ public:
     Octant* GetOrCreateChild(unsigned index);
     /// Delete child octant.
     void DeleteChild(unsigned index);
+    /// Detach an empty child octant and keep it in the octree for reuse.
+    void ReleaseChild(unsigned index);
+    /// Take child octants with their drawables from an octant of the same size. Called when the octree grows.
+    void AdoptChildren(Octant** children, unsigned levelOffset);
     /// Insert a drawable object by checking for fit recursively.
     void InsertDrawable(Drawable* drawable);
     /// Check if a drawable object fits.
@@ -57,19 +95,19 @@ public:
     void AddDrawable(Drawable* drawable)
     {
         drawable->SetOctant(this);
-        drawables_.Push(drawable);
+        PushDrawable(drawable);
         IncDrawableCount();
     }
 
     /// Remove a drawable object from this octant.
-    void RemoveDrawable(Drawable* drawable, bool resetOctant = true)
+    void RemoveDrawable(Drawable* drawable, bool resetOctant = true);
+
+    /// Refresh culling data of a drawable object in this octant after its bounds or view mask have changed.
+    void UpdateCullingData(Drawable* drawable)
     {
-        if (drawables_.Remove(drawable))
-        {
-            if (resetOctant)
-                drawable->SetOctant(nullptr);
-            DecDrawableCount();
-        }
+        unsigned index = drawable->octantIndex_;
+        if (index < drawables_.Size() && drawables_[index] == drawable)
+            cullingData_[index / BoundingBoxPacket::SIZE].Define(index % BoundingBoxPacket::SIZE, drawable);
     }
 
     /// Return world-space bounding box.
@@ -90,6 +128,9 @@ public:
     /// Return number of drawables.
     unsigned GetNumDrawables() const { return numDrawables_; }
 
+    /// Return culling data of the drawable objects in this octant, four drawables per packet.
+    const PODVector<DrawableCullingPacket>& GetCullingData() const { return cullingData_; }
+
     /// Return true if there are no drawable objects in this octant and child octants.
     bool IsEmpty() { return numDrawables_ == 0; }
 
@@ -102,12 +143,19 @@ protected:
     /// Initialize bounding box.
     void Initialize(const BoundingBox& box);
     /// Return drawable objects by a query, called internally.
-    void GetDrawablesInternal(OctreeQuery& query, bool inside) const;
+    void GetDrawablesInternal(OctreeQuery& query, bool inside, bool useCullingData) const;
     /// Return drawable objects by a ray query, called internally.
     void GetDrawablesInternal(RayOctreeQuery& query) const;
     /// Return drawable objects only for a threaded ray query, called internally.
     void GetDrawablesOnlyInternal(RayOctreeQuery& query, PODVector<Drawable*>& drawables) const;
 
+    /// Increase subdivision level recursively.
+    void AddLevels(unsigned levelOffset);
+    /// Append a drawable object and its culling data.
+    void PushDrawable(Drawable* drawable);
+    /// Remove a drawable object and its culling data by moving the last drawable object in its place. Index is used as a lookup hint. Return true if found.
+    bool EraseDrawable(Drawable* drawable, unsigned index);
+
     /// Increase drawable object count recursively.
     void IncDrawableCount()
     {
@@ -125,7 +173,7 @@ protected:
         if (!numDrawables_)
         {
             if (parent)
-                parent->DeleteChild(index_);
+                parent->ReleaseChild(index_);
         }
 
         if (parent)
@@ -138,6 +186,8 @@ protected:
     BoundingBox cullingBox_;
     /// Drawable objects.
     PODVector<Drawable*> drawables_;
+    /// Culling data of the drawable objects, four drawables per packet. Unused slots of the last packet are cleared.
+    PODVector<DrawableCullingPacket> cullingData_;
     /// Child octants.
     Octant* children_[NUM_OCTANTS]{};
     /// World bounding box center.
@@ -174,15 +224,32 @@ public:
 
     /// Set size and maximum subdivision levels. If octree is not empty, drawable objects will be temporarily moved to the root.
     void SetSize(const BoundingBox& box, unsigned numLevels);
+    /// Set spatial index type. Drawable objects are moved to the new index immediately. The growing octree and the AABB tree
+    /// speed up queries in large worlds, but update moving drawable objects slower than the default octree.
+    void SetSpatialIndex(SpatialIndexType type);
+    /// Set enlargement of the AABB tree leaf bounding boxes. Drawable objects moving within it are not reinserted.
+    void SetTreeMargin(float margin);
+    /// Insert a drawable object to the spatial index, or update its position in the index.
+    void InsertDrawable(Drawable* drawable);
     /// Update and reinsert drawable objects.
     void Update(const FrameInfo& frame);
     /// Add a drawable manually.
     void AddManualDrawable(Drawable* drawable);
     /// Remove a manually added drawable.
     void RemoveManualDrawable(Drawable* drawable);
+    /// Add a hierarchical LOD cluster to be switched by the camera distance at the start of each update. Called by the cluster itself.
+    void AddHLODCluster(HLODCluster* cluster);
+    /// Remove a hierarchical LOD cluster.
+    void RemoveHLODCluster(HLODCluster* cluster);
+    /// Add a camera viewing the scene to switch the hierarchical LOD clusters by in the next update, along with the frame's camera. Called by Renderer for each view.
+    void AddViewCamera(Camera* camera);
 
     /// Return drawable objects by a query.
     void GetDrawables(OctreeQuery& query) const;
+    /// Return drawable objects by a query that writes to the cached result. When the cache is from the previous update,
+    /// only the drawable objects changed in the latest update are tested again. Return true if the cache was updated
+    /// incrementally. The caller must invalidate the cache if the query parameters change.
+    bool GetDrawables(OctreeQuery& query, OctreeQueryCache& cache) const;
     /// Return drawable objects by a ray query.
     void Raycast(RayOctreeQuery& query) const;
     /// Return the closest drawable object by a ray query.
@@ -190,8 +257,20 @@ public:
 
     /// Return subdivision levels.
     unsigned GetNumLevels() const { return numLevels_; }
-
-    /// Mark drawable object as requiring an update and a reinsertion.
+    /// Return spatial index type.
+    SpatialIndexType GetSpatialIndex() const { return spatialIndex_; }
+    /// Return number of hierarchical LOD clusters.
+    unsigned GetNumHLODClusters() const { return hlodClusters_.Size(); }
+    /// Return enlargement of the AABB tree leaf bounding boxes.
+    float GetTreeMargin() const { return tree_.GetMargin(); }
+    /// Return the AABB tree. Empty unless used as the spatial index.
+    const AABBTree& GetTree() const { return tree_; }
+    /// Return number of updates performed.
+    unsigned GetRevision() const { return revision_; }
+    /// Return whether a drawable object was moved, resized or added in the latest update.
+    bool IsDrawableChanged(Drawable* drawable) const { return drawable->changeRevision_ == revision_; }
+
+    /// Mark drawable object as requiring an update and a reinsertion. Safe to call from any thread.
     void QueueUpdate(Drawable* drawable);
     /// Cancel drawable object's update.
     void CancelUpdate(Drawable* drawable);
@@ -200,20 +279,72 @@ public:
 
 private:
     /// Handle render update in case of headless execution.
-    void HandleRenderUpdate(StringHash eventType, VariantMap& eventData);
+    void HandleRenderUpdate(RenderUpdateEventData& eventData);
     /// Update octree size.
     void UpdateOctreeSize() { SetSize(worldBoundingBox_, numLevels_); }
-
-    /// Drawable objects that require update.
+    /// Double the octree size until it contains a bounding box, as long as subdivision levels can be added.
+    void Grow(const BoundingBox& box);
+    /// Return whether the octree should grow to contain a drawable object.
+    bool CheckGrowth(Drawable* drawable) const;
+    /// Remove a drawable object from the AABB tree.
+    void RemoveTreeDrawable(Drawable* drawable);
+    /// Record a drawable object as changed in the next update.
+    void MarkDrawableChanged(Drawable* drawable);
+    /// Record a drawable object removal, which invalidates the cached query results.
+    void MarkDrawableRemoved(Drawable* drawable);
+    /// Return drawable objects by a query from the AABB tree.
+    void GetTreeDrawables(OctreeQuery& query) const;
+    /// Return drawable objects by a ray query from the AABB tree.
+    void GetTreeDrawables(RayOctreeQuery& query) const;
+    /// Return drawable objects only for a ray query from the AABB tree.
+    void GetTreeDrawablesOnly(RayOctreeQuery& query, PODVector<Drawable*>& drawables) const;
+
+    /// Queue of drawable objects linked through the drawables themselves.
+    using DrawableUpdateQueue = MPSCQueue<Drawable, &Drawable::nextQueuedUpdate_>;
+
+    /// Take all queued drawable objects to a vector.
+    void TakeQueuedUpdates(PODVector<Drawable*>& dest);
+    /// Take drawable objects from a queue to a vector.
+    static void TakeQueuedUpdates(PODVector<Drawable*>& dest, DrawableUpdateQueue& queue);
+
+    /// Drawable objects that require update. Between updates holds the drawables taken from the main thread queue.
     PODVector<Drawable*> drawableUpdates_;
-    /// Drawable objects that were inserted during threaded update phase.
+    /// Hierarchical LOD clusters.
+    PODVector<HLODCluster*> hlodClusters_;
+    /// Cameras viewing the scene added since the latest update.
+    Vector<WeakPtr<Camera> > viewCameras_;
+    /// Cameras the hierarchical LOD clusters are switched by during the update.
+    PODVector<Camera*> switchCameras_;
+    /// Drawable objects taken from the worker thread queue between updates.
     PODVector<Drawable*> threadedDrawableUpdates_;
-    /// Mutex for octree reinsertions.
-    Mutex octreeMutex_;
+    /// Drawable objects queued for update from the main thread.
+    DrawableUpdateQueue mainThreadUpdates_;
+    /// Drawable objects queued for update from worker threads, either during threaded update phase or during rendering.
+    DrawableUpdateQueue threadedUpdates_;
+    /// Per drawable flags whether reinsertion is needed, filled by the worker threads.
+    PODVector<unsigned char> reinsertFlags_;
+    /// Counter of drawable objects moved to another octant.
+    PerformanceCounter* movedDrawablesCounter_{};
+    /// Drawable objects added or reinserted since the latest update.
+    PODVector<Drawable*> pendingChangedDrawables_;
+    /// Drawable objects moved, resized or added in the latest update.
+    PODVector<Drawable*> changedDrawables_;
+    /// Number of updates performed.
+    unsigned revision_{};
+    /// Number of drawable object removals.
+    unsigned structureRevision_{};
     /// Ray query temporary list of drawables.
     mutable PODVector<Drawable*> rayQueryDrawables_;
+    /// Empty octants kept for reuse, so that drawables moving through sparsely populated space do not allocate octants.
+    PODVector<Octant*> freeOctants_;
+    /// AABB tree of the drawable objects when used as the spatial index.
+    AABBTree tree_;
     /// Subdivision level.
     unsigned numLevels_;
+    /// Spatial index type.
+    SpatialIndexType spatialIndex_;
+
+    friend class Octant;
 };
 
 }
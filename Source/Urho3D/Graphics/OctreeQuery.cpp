@@ -29,6 +29,26 @@
 namespace Urho3D
 {
 
+/// Test drawables packet by packet and push the ones whose drawable flags, view mask and bounds match to the query result.
+template <class T> static void TestDrawablePackets(OctreeQuery& query, Drawable** start, Drawable** end,
+    const DrawableCullingPacket* packets, bool inside, T intersectionTest)
+{
+    const auto count = (unsigned)(end - start);
+    for (unsigned i = 0; i < count; i += BoundingBoxPacket::SIZE, ++packets)
+    {
+        unsigned mask = packets->GetMatchMask(query.drawableFlags_, query.viewMask_);
+        if (mask && !inside)
+            mask &= intersectionTest(packets->boxes_);
+
+        // Unused slots of the last packet are cleared and never match
+        for (unsigned j = 0; mask; ++j, mask >>= 1)
+        {
+            if (mask & 1u)
+                query.result_.Push(start[i + j]);
+        }
+    }
+}
+
 Intersection PointOctreeQuery::TestOctant(const BoundingBox& box, bool inside)
 {
     if (inside)
@@ -51,6 +71,12 @@ void PointOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool insi
     }
 }
 
+void PointOctreeQuery::TestDrawables(Drawable** start, Drawable** end, const DrawableCullingPacket* packets, bool inside)
+{
+    TestDrawablePackets(*this, start, end, packets, inside,
+        [this](const BoundingBoxPacket& boxes) { return boxes.IsInside(point_); });
+}
+
 Intersection SphereOctreeQuery::TestOctant(const BoundingBox& box, bool inside)
 {
     if (inside)
@@ -73,6 +99,12 @@ void SphereOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool ins
     }
 }
 
+void SphereOctreeQuery::TestDrawables(Drawable** start, Drawable** end, const DrawableCullingPacket* packets, bool inside)
+{
+    TestDrawablePackets(*this, start, end, packets, inside,
+        [this](const BoundingBoxPacket& boxes) { return boxes.IsInsideFast(sphere_); });
+}
+
 Intersection BoxOctreeQuery::TestOctant(const BoundingBox& box, bool inside)
 {
     if (inside)
@@ -95,6 +127,12 @@ void BoxOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool inside
     }
 }
 
+void BoxOctreeQuery::TestDrawables(Drawable** start, Drawable** end, const DrawableCullingPacket* packets, bool inside)
+{
+    TestDrawablePackets(*this, start, end, packets, inside,
+        [this](const BoundingBoxPacket& boxes) { return boxes.IsInsideFast(box_); });
+}
+
 Intersection FrustumOctreeQuery::TestOctant(const BoundingBox& box, bool inside)
 {
     if (inside)
@@ -117,6 +155,12 @@ void FrustumOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool in
     }
 }
 
+void FrustumOctreeQuery::TestDrawables(Drawable** start, Drawable** end, const DrawableCullingPacket* packets, bool inside)
+{
+    TestDrawablePackets(*this, start, end, packets, inside,
+        [this](const BoundingBoxPacket& boxes) { return boxes.IsInsideFast(frustum_); });
+}
+
 
 Intersection AllContentOctreeQuery::TestOctant(const BoundingBox& box, bool inside)
 {
@@ -134,4 +178,9 @@ void AllContentOctreeQuery::TestDrawables(Drawable** start, Drawable** end, bool
     }
 }
 
+void AllContentOctreeQuery::TestDrawables(Drawable** start, Drawable** end, const DrawableCullingPacket* packets, bool inside)
+{
+    TestDrawablePackets(*this, start, end, packets, true, [](const BoundingBoxPacket&) { return BoundingBoxPacket::ALL_MASK; });
+}
+
 }
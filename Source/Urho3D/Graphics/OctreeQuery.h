@@ -24,6 +24,7 @@
 
 #include "../Graphics/Drawable.h"
 #include "../Math/BoundingBox.h"
+#include "../Math/BoundingBoxPacket.h"
 #include "../Math/Frustum.h"
 #include "../Math/Ray.h"
 #include "../Math/Sphere.h"
@@ -34,6 +35,54 @@ namespace Urho3D
 class Drawable;
 class Node;
 
+/// Culling data of four drawables of an octant. Kept in sync with the drawables by the octant.
+struct URHO3D_API DrawableCullingPacket
+{
+    /// Set culling data of a drawable at index.
+    void Define(unsigned index, Drawable* drawable)
+    {
+        boxes_.Define(index, drawable->GetWorldBoundingBox());
+        flags_[index] = drawable->GetDrawableFlags().AsInteger();
+        viewMasks_[index] = drawable->GetViewMask();
+    }
+
+    /// Copy culling data at index from another packet.
+    void Define(unsigned index, const DrawableCullingPacket& packet, unsigned packetIndex)
+    {
+        boxes_.Define(index, packet.boxes_, packetIndex);
+        flags_[index] = packet.flags_[packetIndex];
+        viewMasks_[index] = packet.viewMasks_[packetIndex];
+    }
+
+    /// Clear culling data at index. A cleared drawable never matches a query.
+    void Clear(unsigned index)
+    {
+        boxes_.Clear(index);
+        flags_[index] = 0;
+        viewMasks_[index] = 0;
+    }
+
+    /// Return mask of the drawables matching drawable flags and view mask.
+    unsigned GetMatchMask(DrawableFlags drawableFlags, unsigned viewMask) const
+    {
+        unsigned flags = drawableFlags.AsInteger();
+        unsigned mask = 0;
+        for (unsigned i = 0; i < BoundingBoxPacket::SIZE; ++i)
+        {
+            if ((flags_[i] & flags) && (viewMasks_[i] & viewMask))
+                mask |= 1u << i;
+        }
+        return mask;
+    }
+
+    /// World-space bounding boxes.
+    BoundingBoxPacket boxes_;
+    /// Drawable flags.
+    unsigned flags_[BoundingBoxPacket::SIZE]{};
+    /// View masks.
+    unsigned viewMasks_[BoundingBoxPacket::SIZE]{};
+};
+
 /// Base class for octree queries.
 class URHO3D_API OctreeQuery
 {
@@ -58,6 +107,17 @@ public:
     virtual Intersection TestOctant(const BoundingBox& box, bool inside) = 0;
     /// Intersection test for drawables.
     virtual void TestDrawables(Drawable** start, Drawable** end, bool inside) = 0;
+    /// Intersection test for drawables using the culling data of their octant, four drawables per packet. Called instead
+    /// of TestDrawables() only if UsesCullingData() returns true. By default tests the drawables one by one.
+    virtual void TestDrawables(Drawable** start, Drawable** end, const DrawableCullingPacket* packets, bool inside)
+    {
+        TestDrawables(start, end, inside);
+    }
+
+    /// Return whether the octree may test drawables with the culling data overload of TestDrawables(). False by default,
+    /// so that queries customizing only the drawable test keep working. The built-in queries return true; their
+    /// subclasses that customize TestDrawables() must customize the culling data overload as well or return false.
+    virtual bool UsesCullingData() const { return false; }
 
     /// Result vector reference.
     PODVector<Drawable*>& result_;
@@ -83,6 +143,10 @@ public:
     Intersection TestOctant(const BoundingBox& box, bool inside) override;
     /// Intersection test for drawables.
     void TestDrawables(Drawable** start, Drawable** end, bool inside) override;
+    /// Intersection test for drawables using octant culling data.
+    void TestDrawables(Drawable** start, Drawable** end, const DrawableCullingPacket* packets, bool inside) override;
+    /// Return whether the culling data overload of TestDrawables() may be used.
+    bool UsesCullingData() const override { return true; }
 
     /// Point.
     Vector3 point_;
@@ -104,6 +168,10 @@ public:
     Intersection TestOctant(const BoundingBox& box, bool inside) override;
     /// Intersection test for drawables.
     void TestDrawables(Drawable** start, Drawable** end, bool inside) override;
+    /// Intersection test for drawables using octant culling data.
+    void TestDrawables(Drawable** start, Drawable** end, const DrawableCullingPacket* packets, bool inside) override;
+    /// Return whether the culling data overload of TestDrawables() may be used.
+    bool UsesCullingData() const override { return true; }
 
     /// Sphere.
     Sphere sphere_;
@@ -125,6 +193,10 @@ public:
     Intersection TestOctant(const BoundingBox& box, bool inside) override;
     /// Intersection test for drawables.
     void TestDrawables(Drawable** start, Drawable** end, bool inside) override;
+    /// Intersection test for drawables using octant culling data.
+    void TestDrawables(Drawable** start, Drawable** end, const DrawableCullingPacket* packets, bool inside) override;
+    /// Return whether the culling data overload of TestDrawables() may be used.
+    bool UsesCullingData() const override { return true; }
 
     /// Bounding box.
     BoundingBox box_;
@@ -146,6 +218,10 @@ public:
     Intersection TestOctant(const BoundingBox& box, bool inside) override;
     /// Intersection test for drawables.
     void TestDrawables(Drawable** start, Drawable** end, bool inside) override;
+    /// Intersection test for drawables using octant culling data.
+    void TestDrawables(Drawable** start, Drawable** end, const DrawableCullingPacket* packets, bool inside) override;
+    /// Return whether the culling data overload of TestDrawables() may be used.
+    bool UsesCullingData() const override { return true; }
 
     /// Frustum.
     Frustum frustum_;
@@ -279,6 +355,10 @@ public:
     Intersection TestOctant(const BoundingBox& box, bool inside) override;
     /// Intersection test for drawables.
     void TestDrawables(Drawable** start, Drawable** end, bool inside) override;
+    /// Intersection test for drawables using octant culling data.
+    void TestDrawables(Drawable** start, Drawable** end, const DrawableCullingPacket* packets, bool inside) override;
+    /// Return whether the culling data overload of TestDrawables() may be used.
+    bool UsesCullingData() const override { return true; }
 };
 
 }
@@ -92,7 +92,7 @@ void ParticleEmitter::OnSetEnabled()
     if (scene)
     {
         if (IsEnabledEffective())
-            SubscribeToEvent(scene, E_SCENEPOSTUPDATE, URHO3D_HANDLER(ParticleEmitter, HandleScenePostUpdate));
+            SubscribeToEvent(scene, &ParticleEmitter::HandleScenePostUpdate);
         else
             UnsubscribeFromEvent(scene, E_SCENEPOSTUPDATE);
     }
@@ -440,7 +440,7 @@ void ParticleEmitter::OnSceneSet(Scene* scene)
     BillboardSet::OnSceneSet(scene);
 
     if (scene && IsEnabledEffective())
-        SubscribeToEvent(scene, E_SCENEPOSTUPDATE, URHO3D_HANDLER(ParticleEmitter, HandleScenePostUpdate));
+        SubscribeToEvent(scene, &ParticleEmitter::HandleScenePostUpdate);
     else if (!scene)
          UnsubscribeFromEvent(E_SCENEPOSTUPDATE);
 }
@@ -545,12 +545,10 @@ bool ParticleEmitter::CheckActiveParticles() const
     return false;
 }
 
-void ParticleEmitter::HandleScenePostUpdate(StringHash eventType, VariantMap& eventData)
+void ParticleEmitter::HandleScenePostUpdate(ScenePostUpdateEventData& eventData)
 {
     // Store scene's timestep and use it instead of global timestep, as time scale may be other than 1
-    using namespace ScenePostUpdate;
-
-    lastTimeStep_ = eventData[P_TIMESTEP].GetFloat();
+    lastTimeStep_ = eventData.timeStep_;
 
     // If no invisible update, check that the billboardset is in view (framenumber has changed)
     if ((effect_ && effect_->GetUpdateInvisible()) || viewFrameNumber_ != lastUpdateFrameNumber_)
@@ -570,11 +568,11 @@ void ParticleEmitter::HandleScenePostUpdate(StringHash eventType, VariantMap& ev
 
         using namespace ParticleEffectFinished;
 
-        VariantMap& eventData = GetEventDataMap();
-        eventData[P_NODE] = node_;
-        eventData[P_EFFECT] = effect_;
+        VariantMap& finishedData = GetEventDataMap();
+        finishedData[P_NODE] = node_;
+        finishedData[P_EFFECT] = effect_;
 
-        node_->SendEvent(E_PARTICLEEFFECTFINISHED, eventData);
+        node_->SendEvent(E_PARTICLEEFFECTFINISHED, finishedData);
 
         if (self.Expired())
             return;
@@ -31,6 +31,7 @@
 #include "../Graphics/GraphicsEvents.h"
 #include "../Graphics/GraphicsImpl.h"
 #include "../Graphics/IndexBuffer.h"
+#include "../Graphics/InstanceDataPool.h"
 #include "../Graphics/Material.h"
 #include "../Graphics/OcclusionBuffer.h"
 #include "../Graphics/Octree.h"
@@ -473,6 +474,15 @@ void Renderer::SetNumExtraInstancingBufferElements(int elements)
     }
 }
 
+void Renderer::SetPersistentInstancing(bool enable)
+{
+    if (enable != persistentInstancing_)
+    {
+        persistentInstancing_ = enable;
+        CreatePersistentInstancingBuffer();
+    }
+}
+
 void Renderer::SetMinInstances(int instances)
 {
     minInstances_ = Max(instances, 1);
@@ -523,6 +533,16 @@ void Renderer::SetThreadedOcclusion(bool enable)
     }
 }
 
+void Renderer::SetTemporalCoherence(bool enable)
+{
+    temporalCoherence_ = enable;
+}
+
+void Renderer::SetTemporalCoherenceValidation(bool enable)
+{
+    temporalCoherenceValidation_ = enable;
+}
+
 void Renderer::ReloadShaders()
 {
     shadersDirty_ = true;
@@ -1372,6 +1392,52 @@ bool Renderer::ResizeInstancingBuffer(unsigned numInstances)
     return true;
 }
 
+unsigned Renderer::UpdatePersistentInstancingBuffer()
+{
+    if (!persistentInstancingBuffer_ || !instanceDataPool_)
+        return 0;
+
+    const unsigned numSlots = instanceDataPool_->GetNumSlots();
+    if (persistentInstancingBuffer_->IsDataLost())
+    {
+        instanceDataPool_->MarkAllDirty();
+        persistentInstancingBuffer_->ClearDataLost();
+    }
+
+    if (numSlots > persistentInstancingBuffer_->GetVertexCount())
+    {
+        unsigned newSize = INSTANCING_BUFFER_DEFAULT_SIZE;
+        while (newSize < numSlots)
+            newSize <<= 1;
+
+        const PODVector<VertexElement> instancingBufferElements = CreateInstancingBufferElements(numExtraInstancingBufferElements_);
+        if (!persistentInstancingBuffer_->SetSize(newSize, instancingBufferElements, false))
+        {
+            // The batch groups fall back to drawing without instancing this frame when the buffer is missing
+            URHO3D_LOGERROR("Failed to resize persistent instancing buffer to " + String(newSize));
+            persistentInstancingBuffer_.Reset();
+            instanceDataPool_->Clear();
+            return 0;
+        }
+
+        URHO3D_LOGDEBUG("Resized persistent instancing buffer to " + String(newSize));
+        instanceDataPool_->MarkAllDirty();
+    }
+
+    instanceDataPool_->GetDirtyRanges(dirtyInstanceRanges_);
+
+    const unsigned stride = instanceDataPool_->GetStride();
+    const unsigned char* data = instanceDataPool_->GetData();
+    unsigned uploadBytes = 0;
+    for (PODVector<InstanceRange>::ConstIterator i = dirtyInstanceRanges_.Begin(); i != dirtyInstanceRanges_.End(); ++i)
+    {
+        persistentInstancingBuffer_->SetDataRange(data + i->start_ * stride, i->start_, i->count_);
+        uploadBytes += i->count_ * stride;
+    }
+
+    return uploadBytes;
+}
+
 void Renderer::OptimizeLightByScissor(Light* light, Camera* camera)
 {
     if (light && light->GetLightType() != LIGHT_DIRECTIONAL)
@@ -1503,10 +1569,21 @@ void Renderer::UpdateQueuedViewport(unsigned index)
 
     auto* octree = scene->GetComponent<Octree>();
 
+    // Hierarchical LOD clusters are switched by all cameras viewing the scene. A view updated after the octree affects
+    // the switch from the next update on
+    octree->AddViewCamera(viewport->GetCamera());
+
     // Update octree (perform early update for drawables which need that, and reinsert moved drawables.)
     // However, if the same scene is viewed from multiple cameras, update the octree only once
     if (!updatedOctrees_.Contains(octree))
     {
+        for (unsigned i = index + 1; i < queuedViewports_.Size(); ++i)
+        {
+            Viewport* other = queuedViewports_[i].second_;
+            if (other && other->GetScene() == scene)
+                octree->AddViewCamera(other->GetCamera());
+        }
+
         frame_.camera_ = viewport->GetCamera();
         frame_.viewSize_ = viewRect.Size();
         if (frame_.viewSize_ == IntVector2::ZERO)
@@ -1611,7 +1688,7 @@ void Renderer::Initialize()
 
     initialized_ = true;
 
-    SubscribeToEvent(E_RENDERUPDATE, URHO3D_HANDLER(Renderer, HandleRenderUpdate));
+    SubscribeToEvent(&Renderer::HandleRenderUpdate);
 
     URHO3D_LOGINFO("Initialized renderer");
 }
@@ -1896,6 +1973,28 @@ void Renderer::CreateInstancingBuffer()
         instancingBuffer_.Reset();
         dynamicInstancing_ = false;
     }
+
+    CreatePersistentInstancingBuffer();
+}
+
+void Renderer::CreatePersistentInstancingBuffer()
+{
+    persistentInstancingBuffer_.Reset();
+    instanceDataPool_.Reset();
+    if (!persistentInstancing_ || !instancingBuffer_)
+        return;
+
+    // The buffer is not dynamic, so that the changed ranges can be updated without discarding the rest on every API
+    persistentInstancingBuffer_ = new VertexBuffer(context_);
+    const PODVector<VertexElement> instancingBufferElements = CreateInstancingBufferElements(numExtraInstancingBufferElements_);
+    if (!persistentInstancingBuffer_->SetSize(INSTANCING_BUFFER_DEFAULT_SIZE, instancingBufferElements, false))
+    {
+        persistentInstancingBuffer_.Reset();
+        return;
+    }
+
+    instanceDataPool_ = new InstanceDataPool();
+    instanceDataPool_->SetStride(persistentInstancingBuffer_->GetVertexSize());
 }
 
 void Renderer::ResetShadowMaps()
@@ -1954,11 +2053,9 @@ void Renderer::HandleScreenMode(StringHash eventType, VariantMap& eventData)
         resetViews_ = true;
 }
 
-void Renderer::HandleRenderUpdate(StringHash eventType, VariantMap& eventData)
+void Renderer::HandleRenderUpdate(RenderUpdateEventData& eventData)
 {
-    using namespace RenderUpdate;
-
-    Update(eventData[P_TIMESTEP].GetFloat());
+    Update(eventData.timeStep_);
 }
 
 
@@ -34,6 +34,7 @@ namespace Urho3D
 
 class Geometry;
 class Drawable;
+class InstanceDataPool;
 class Light;
 class Material;
 class Pass;
@@ -53,6 +54,7 @@ class TextureCube;
 class View;
 class Zone;
 struct BatchQueue;
+struct RenderUpdateEventData;
 
 static const int SHADOW_MIN_PIXELS = 64;
 static const int INSTANCING_BUFFER_DEFAULT_SIZE = 1024;
@@ -226,6 +228,8 @@ public:
     void SetDynamicInstancing(bool enable);
     /// Set number of extra instancing buffer elements. Default is 0. Extra 4-vectors are available through TEXCOORD7 and further.
     void SetNumExtraInstancingBufferElements(int elements);
+    /// Set whether instances that do not change keep their data in a persistent instancing buffer, which is updated only where instances changed, instead of uploading all instance data each frame. Default false.
+    void SetPersistentInstancing(bool enable);
     /// Set minimum number of instances required in a batch group to render as instanced.
     void SetMinInstances(int instances);
     /// Set maximum number of sorted instances per batch group. If exceeded, instances are rendered unsorted.
@@ -238,6 +242,10 @@ public:
     void SetOccluderSizeThreshold(float screenSize);
     /// Set whether to thread occluder rendering. Default false.
     void SetThreadedOcclusion(bool enable);
+    /// Set whether views reuse their visibility and light query results from the previous frame, reprocessing only the drawables that changed. Default false.
+    void SetTemporalCoherence(bool enable);
+    /// Set whether views also perform the full queries when reusing results and log any difference. For verification only, as it removes the benefit. Default false.
+    void SetTemporalCoherenceValidation(bool enable);
     /// Set shadow depth bias multiplier for mobile platforms to counteract possible worse shadow map precision. Default 1.0 (no effect.)
     void SetMobileShadowBiasMul(float mul);
     /// Set shadow depth bias addition for mobile platforms to counteract possible worse shadow map precision. Default 0.0 (no effect.)
@@ -310,6 +318,9 @@ public:
     /// Return number of extra instancing buffer elements.
     int GetNumExtraInstancingBufferElements() const { return numExtraInstancingBufferElements_; };
 
+    /// Return whether persistent instancing is in use.
+    bool GetPersistentInstancing() const { return persistentInstancing_; }
+
     /// Return minimum number of instances required in a batch group to render as instanced.
     int GetMinInstances() const { return minInstances_; }
 
@@ -328,6 +339,12 @@ public:
     /// Return whether occlusion rendering is threaded.
     bool GetThreadedOcclusion() const { return threadedOcclusion_; }
 
+    /// Return whether views reuse query results from the previous frame.
+    bool GetTemporalCoherence() const { return temporalCoherence_; }
+
+    /// Return whether views validate the reused query results.
+    bool GetTemporalCoherenceValidation() const { return temporalCoherenceValidation_; }
+
     /// Return shadow depth bias multiplier for mobile platforms.
     float GetMobileShadowBiasMul() const { return mobileShadowBiasMul_; }
 
@@ -376,6 +393,12 @@ public:
     /// Return the instancing vertex buffer
     VertexBuffer* GetInstancingBuffer() const { return dynamicInstancing_ ? instancingBuffer_.Get() : nullptr; }
 
+    /// Return the persistent instancing vertex buffer.
+    VertexBuffer* GetPersistentInstancingBuffer() const { return dynamicInstancing_ ? persistentInstancingBuffer_.Get() : nullptr; }
+
+    /// Return the instance data pool mirrored by the persistent instancing buffer, or null if persistent instancing is not in use.
+    InstanceDataPool* GetInstanceDataPool() const { return GetPersistentInstancingBuffer() ? instanceDataPool_.Get() : nullptr; }
+
     /// Return the frame update parameters.
     const FrameInfo& GetFrameInfo() const { return frame_; }
 
@@ -418,6 +441,8 @@ public:
     void SetCullMode(CullMode mode, Camera* camera);
     /// Ensure sufficient size of the instancing vertex buffer. Return true if successful.
     bool ResizeInstancingBuffer(unsigned numInstances);
+    /// Upload the changed slots of the instance data pool to the persistent instancing buffer. Return the number of bytes uploaded.
+    unsigned UpdatePersistentInstancingBuffer();
     /// Optimize a light by scissor rectangle.
     void OptimizeLightByScissor(Light* light, Camera* camera);
     /// Optimize a light by marking it to the stencil buffer and setting a stencil test.
@@ -443,6 +468,8 @@ private:
     void CreateGeometries();
     /// Create instancing vertex buffer.
     void CreateInstancingBuffer();
+    /// Create or release the persistent instancing vertex buffer and instance data pool.
+    void CreatePersistentInstancingBuffer();
     /// Create point light shadow indirection texture data.
     void SetIndirectionTextureData();
     /// Update a queued viewport for rendering.
@@ -464,7 +491,7 @@ private:
     /// Handle screen mode event.
     void HandleScreenMode(StringHash eventType, VariantMap& eventData);
     /// Handle render update event.
-    void HandleRenderUpdate(StringHash eventType, VariantMap& eventData);
+    void HandleRenderUpdate(RenderUpdateEventData& eventData);
     /// Blur the shadow map.
     void BlurShadowMap(View* view, Texture2D* shadowMap, float blurScale);
 
@@ -484,6 +511,12 @@ private:
     SharedPtr<Geometry> pointLightGeometry_;
     /// Instance stream vertex buffer.
     SharedPtr<VertexBuffer> instancingBuffer_;
+    /// Persistent instance stream vertex buffer.
+    SharedPtr<VertexBuffer> persistentInstancingBuffer_;
+    /// Instance data pool mirrored by the persistent instance stream vertex buffer.
+    UniquePtr<InstanceDataPool> instanceDataPool_;
+    /// Dirty instance data pool ranges.
+    PODVector<InstanceRange> dirtyInstanceRanges_;
     /// Default material.
     SharedPtr<Material> defaultMaterial_;
     /// Default range attenuation texture.
@@ -592,8 +625,14 @@ private:
     bool dynamicInstancing_{true};
     /// Number of extra instancing data elements.
     int numExtraInstancingBufferElements_{};
+    /// Persistent instancing flag.
+    bool persistentInstancing_{};
     /// Threaded occlusion rendering flag.
     bool threadedOcclusion_{};
+    /// Temporal coherence flag.
+    bool temporalCoherence_{};
+    /// Temporal coherence validation flag.
+    bool temporalCoherenceValidation_{};
     /// Shaders need reloading flag.
     bool shadersDirty_{true};
     /// Initialized flag.
@@ -22,6 +22,7 @@
 
 #include "../Precompiled.h"
 
+#include "../Core/PerformanceCounters.h"
 #include "../Core/Profiler.h"
 #include "../Core/WorkQueue.h"
 #include "../Graphics/Camera.h"
@@ -30,6 +31,7 @@
 #include "../Graphics/Graphics.h"
 #include "../Graphics/GraphicsEvents.h"
 #include "../Graphics/GraphicsImpl.h"
+#include "../Graphics/InstanceDataPool.h"
 #include "../Graphics/Material.h"
 #include "../Graphics/OcclusionBuffer.h"
 #include "../Graphics/Octree.h"
@@ -55,6 +57,11 @@
 namespace Urho3D
 {
 
+/// Minimum number of drawables checked for visibility by a single parallel batch.
+static const unsigned VISIBILITY_BATCH_SIZE = 64;
+/// Minimum number of drawables whose base batches are collected by a single parallel batch.
+static const unsigned BASE_BATCH_SIZE = 64;
+
 /// %Frustum octree query for shadowcasters.
 class ShadowCasterOctreeQuery : public FrustumOctreeQuery
 {
@@ -81,6 +88,24 @@ public:
             }
         }
     }
+
+    /// Intersection test for drawables using octant culling data.
+    void TestDrawables(Drawable** start, Drawable** end, const DrawableCullingPacket* packets, bool inside) override
+    {
+        for (; start < end; start += BoundingBoxPacket::SIZE, ++packets)
+        {
+            unsigned mask = packets->GetMatchMask(drawableFlags_, viewMask_);
+            if (mask && !inside)
+                mask &= packets->boxes_.IsInsideFast(frustum_);
+
+            // Shadow casting is not part of the culling data, so check it only for the drawables that passed
+            for (unsigned i = 0; mask; ++i, mask >>= 1)
+            {
+                if ((mask & 1u) && start[i]->GetCastShadows())
+                    result_.Push(start[i]);
+            }
+        }
+    }
 };
 
 /// %Frustum octree query for zones and occluders.
@@ -110,6 +135,27 @@ public:
             }
         }
     }
+
+    /// Intersection test for drawables using octant culling data.
+    void TestDrawables(Drawable** start, Drawable** end, const DrawableCullingPacket* packets, bool inside) override
+    {
+        for (; start < end; start += BoundingBoxPacket::SIZE, ++packets)
+        {
+            unsigned mask = packets->GetMatchMask(DRAWABLE_ZONE | DRAWABLE_GEOMETRY, viewMask_);
+            if (mask && !inside)
+                mask &= packets->boxes_.IsInsideFast(frustum_);
+
+            for (unsigned i = 0; mask; ++i, mask >>= 1)
+            {
+                if (!(mask & 1u))
+                    continue;
+
+                unsigned flags = packets->flags_[i];
+                if (flags == DRAWABLE_ZONE || (flags == DRAWABLE_GEOMETRY && start[i]->IsOccluder()))
+                    result_.Push(start[i]);
+            }
+        }
+    }
 };
 
 /// %Frustum octree query with occlusion.
@@ -157,12 +203,19 @@ public:
     OcclusionBuffer* buffer_;
 };
 
-void CheckVisibilityWork(const WorkItem* item, unsigned threadIndex)
+static bool IsSameFrustum(const Frustum& lhs, const Frustum& rhs)
+{
+    for (unsigned i = 0; i < NUM_FRUSTUM_VERTICES; ++i)
+    {
+        if (lhs.vertices_[i] != rhs.vertices_[i])
+            return false;
+    }
+    return true;
+}
+
+void CheckVisibilityWork(View* view, Drawable** start, Drawable** end, unsigned threadIndex)
 {
     URHO3D_PROFILE("CheckVisibilityWork");
-    auto* view = reinterpret_cast<View*>(item->aux_);
-    auto** start = reinterpret_cast<Drawable**>(item->start_);
-    auto** end = reinterpret_cast<Drawable**>(item->end_);
     OcclusionBuffer* buffer = view->occlusionBuffer_;
     const Matrix3x4& viewMatrix = view->cullCamera_->GetView();
     Vector3 viewZ = Vector3(viewMatrix.m20_, viewMatrix.m21_, viewMatrix.m22_);
@@ -227,15 +280,6 @@ void CheckVisibilityWork(const WorkItem* item, unsigned threadIndex)
     }
 }
 
-void ProcessLightWork(const WorkItem* item, unsigned threadIndex)
-{
-    URHO3D_PROFILE("ProcessLightWork");
-    auto* view = reinterpret_cast<View*>(item->aux_);
-    auto* query = reinterpret_cast<LightQueryResult*>(item->start_);
-
-    view->ProcessLight(*query, threadIndex);
-}
-
 void UpdateDrawableGeometriesWork(const WorkItem* item, unsigned threadIndex)
 {
     URHO3D_PROFILE("UpdateDrawableGeometriesWork");
@@ -257,7 +301,7 @@ void SortBatchQueueFrontToBackWork(const WorkItem* item, unsigned threadIndex)
     URHO3D_PROFILE("SortBatchQueueFrontToBackWork");
     auto* queue = reinterpret_cast<BatchQueue*>(item->start_);
 
-    queue->SortFrontToBack();
+    queue->SortFrontToBack(reinterpret_cast<WorkQueue*>(item->aux_));
 }
 
 void SortBatchQueueBackToFrontWork(const WorkItem* item, unsigned threadIndex)
@@ -265,23 +309,7 @@ void SortBatchQueueBackToFrontWork(const WorkItem* item, unsigned threadIndex)
     URHO3D_PROFILE("SortBatchQueueBackToFrontWork");
     auto* queue = reinterpret_cast<BatchQueue*>(item->start_);
 
-    queue->SortBackToFront();
-}
-
-void SortLightQueueWork(const WorkItem* item, unsigned threadIndex)
-{
-    URHO3D_PROFILE("SortLightQueueWork");
-    auto* start = reinterpret_cast<LightBatchQueue*>(item->start_);
-    start->litBaseBatches_.SortFrontToBack();
-    start->litBatches_.SortFrontToBack();
-}
-
-void SortShadowQueueWork(const WorkItem* item, unsigned threadIndex)
-{
-    URHO3D_PROFILE("SortShadowQueueWork");
-    auto* start = reinterpret_cast<LightBatchQueue*>(item->start_);
-    for (unsigned i = 0; i < start->shadowSplits_.Size(); ++i)
-        start->shadowSplits_[i].shadowBatches_.SortFrontToBack();
+    queue->SortBackToFront(reinterpret_cast<WorkQueue*>(item->aux_));
 }
 
 StringHash ParseTextureTypeXml(ResourceCache* cache, const String& filename);
@@ -295,6 +323,15 @@ View::View(Context* context) :
     unsigned numThreads = GetSubsystem<WorkQueue>()->GetNumThreads() + 1; // Worker threads + main thread
     tempDrawables_.Resize(numThreads);
     sceneResults_.Resize(numThreads);
+    baseBatchResults_.Resize(numThreads);
+
+    if (auto* counters = GetSubsystem<PerformanceCounters>())
+    {
+        visibleDrawablesCounter_ = counters->GetCounter("VisibleDrawables");
+        culledDrawablesCounter_ = counters->GetCounter("CulledDrawables");
+        coherenceMismatchesCounter_ = counters->GetCounter("TemporalCoherenceMismatches");
+        instancingUploadCounter_ = counters->GetCounter("InstancingUploadBytes");
+    }
 }
 
 bool View::Define(RenderSurface* renderTarget, Viewport* viewport)
@@ -787,12 +824,36 @@ void View::GetDrawables()
 
     auto* queue = GetSubsystem<WorkQueue>();
     PODVector<Drawable*>& tempDrawables = tempDrawables_[0];
+    const Frustum& frustum = cullCamera_->GetFrustum();
+    unsigned viewMask = cullCamera_->GetViewMask();
+
+    // With temporal coherence the query results of the previous frame are updated with the changed drawables only, as long
+    // as the culling frustum stays the same
+    bool temporalCoherence = renderer_->GetTemporalCoherence();
+    bool validate = temporalCoherence && renderer_->GetTemporalCoherenceValidation();
+    if (!temporalCoherence || !IsSameFrustum(frustum, cachedFrustum_) || viewMask != cachedViewMask_)
+    {
+        zoneOccluderCache_.Invalidate();
+        sceneCache_.Invalidate();
+        cachedFrustum_ = frustum;
+        cachedViewMask_ = viewMask;
+    }
 
     // Get zones and occluders first
+    PODVector<Drawable*>& zonesAndOccluders = temporalCoherence ? zoneOccluderCache_.drawables_ : tempDrawables;
     {
-        ZoneOccluderOctreeQuery
-            query(tempDrawables, cullCamera_->GetFrustum(), DRAWABLE_GEOMETRY | DRAWABLE_ZONE, cullCamera_->GetViewMask());
-        octree_->GetDrawables(query);
+        ZoneOccluderOctreeQuery query(zonesAndOccluders, frustum, DRAWABLE_GEOMETRY | DRAWABLE_ZONE, viewMask);
+        if (temporalCoherence)
+        {
+            if (octree_->GetDrawables(query, zoneOccluderCache_) && validate)
+            {
+                ZoneOccluderOctreeQuery fullQuery(tempDrawables, frustum, DRAWABLE_GEOMETRY | DRAWABLE_ZONE, viewMask);
+                octree_->GetDrawables(fullQuery);
+                ValidateCachedDrawables(zonesAndOccluders, tempDrawables, "zone and occluder");
+            }
+        }
+        else
+            octree_->GetDrawables(query);
     }
 
     highestZonePriority_ = M_MIN_INT;
@@ -800,7 +861,7 @@ void View::GetDrawables()
     Node* cameraNode = cullCamera_->GetNode();
     Vector3 cameraPos = cameraNode->GetWorldPosition();
 
-    for (PODVector<Drawable*>::ConstIterator i = tempDrawables.Begin(); i != tempDrawables.End(); ++i)
+    for (PODVector<Drawable*>::ConstIterator i = zonesAndOccluders.Begin(); i != zonesAndOccluders.End(); ++i)
     {
         Drawable* drawable = *i;
         unsigned char flags = drawable->GetDrawableFlags();
@@ -858,17 +919,30 @@ void View::GetDrawables()
     else
         occluders_.Clear();
 
-    // Get lights and geometries. Coarse occlusion for octants is used at this point
+    // Get lights and geometries. Coarse occlusion for octants is used at this point. The occlusion buffer changes each frame,
+    // so the result can not be cached in that case
+    PODVector<Drawable*>& drawables = temporalCoherence && !occlusionBuffer_ ? sceneCache_.drawables_ : tempDrawables;
     if (occlusionBuffer_)
     {
+        sceneCache_.Invalidate();
         OccludedFrustumOctreeQuery query
-            (tempDrawables, cullCamera_->GetFrustum(), occlusionBuffer_, DRAWABLE_GEOMETRY | DRAWABLE_LIGHT, cullCamera_->GetViewMask());
+            (drawables, frustum, occlusionBuffer_, DRAWABLE_GEOMETRY | DRAWABLE_LIGHT, viewMask);
         octree_->GetDrawables(query);
     }
     else
     {
-        FrustumOctreeQuery query(tempDrawables, cullCamera_->GetFrustum(), DRAWABLE_GEOMETRY | DRAWABLE_LIGHT, cullCamera_->GetViewMask());
-        octree_->GetDrawables(query);
+        FrustumOctreeQuery query(drawables, frustum, DRAWABLE_GEOMETRY | DRAWABLE_LIGHT, viewMask);
+        if (temporalCoherence)
+        {
+            if (octree_->GetDrawables(query, sceneCache_) && validate)
+            {
+                FrustumOctreeQuery fullQuery(tempDrawables, frustum, DRAWABLE_GEOMETRY | DRAWABLE_LIGHT, viewMask);
+                octree_->GetDrawables(fullQuery);
+                ValidateCachedDrawables(drawables, tempDrawables, "geometry and light");
+            }
+        }
+        else
+            octree_->GetDrawables(query);
     }
 
     // Check drawable occlusion, find zones for moved drawables and collect geometries & lights in worker threads
@@ -883,30 +957,10 @@ void View::GetDrawables()
             result.maxZ_ = 0.0f;
         }
 
-        int numWorkItems = queue->GetNumThreads() + 1; // Worker threads + main thread
-        int drawablesPerItem = tempDrawables.Size() / numWorkItems;
-
-        PODVector<Drawable*>::Iterator start = tempDrawables.Begin();
-        // Create a work item for each thread
-        for (int i = 0; i < numWorkItems; ++i)
+        queue->ParallelFor(drawables.Size(), VISIBILITY_BATCH_SIZE, [&](unsigned begin, unsigned end, unsigned threadIndex)
         {
-            SharedPtr<WorkItem> item = queue->GetFreeItem();
-            item->priority_ = M_MAX_UNSIGNED;
-            item->workFunction_ = CheckVisibilityWork;
-            item->aux_ = this;
-
-            PODVector<Drawable*>::Iterator end = tempDrawables.End();
-            if (i < numWorkItems - 1 && end - start > drawablesPerItem)
-                end = start + drawablesPerItem;
-
-            item->start_ = &(*start);
-            item->end_ = &(*end);
-            queue->AddWorkItem(item);
-
-            start = end;
-        }
-
-        queue->Complete(M_MAX_UNSIGNED);
+            CheckVisibilityWork(this, drawables.Buffer() + begin, drawables.Buffer() + end, threadIndex);
+        });
     }
 
     // Combine lights, geometries & scene Z range from the threads
@@ -915,30 +969,25 @@ void View::GetDrawables()
     minZ_ = M_INFINITY;
     maxZ_ = 0.0f;
 
-    if (sceneResults_.Size() > 1)
+    for (unsigned i = 0; i < sceneResults_.Size(); ++i)
     {
-        for (unsigned i = 0; i < sceneResults_.Size(); ++i)
-        {
-            PerThreadSceneResult& result = sceneResults_[i];
-            geometries_.Push(result.geometries_);
-            lights_.Push(result.lights_);
-            minZ_ = Min(minZ_, result.minZ_);
-            maxZ_ = Max(maxZ_, result.maxZ_);
-        }
-    }
-    else
-    {
-        // If just 1 thread, copy the results directly
-        PerThreadSceneResult& result = sceneResults_[0];
-        minZ_ = result.minZ_;
-        maxZ_ = result.maxZ_;
-        Swap(geometries_, result.geometries_);
-        Swap(lights_, result.lights_);
+        PerThreadSceneResult& result = sceneResults_[i];
+        geometries_.Insert(geometries_.End(), result.geometries_.Buffer(), result.geometries_.Buffer() + result.geometries_.Size());
+        lights_.Insert(lights_.End(), result.lights_.Buffer(), result.lights_.Buffer() + result.lights_.Size());
+        minZ_ = Min(minZ_, result.minZ_);
+        maxZ_ = Max(maxZ_, result.maxZ_);
     }
 
     if (minZ_ == M_INFINITY)
         minZ_ = 0.0f;
 
+    if (visibleDrawablesCounter_)
+    {
+        unsigned numVisible = geometries_.Size() + lights_.Size();
+        visibleDrawablesCounter_->Increment(numVisible);
+        culledDrawablesCounter_->Increment(drawables.Size() - numVisible);
+    }
+
     // Sort the lights to brightest/closest first, and per-vertex lights first so that per-vertex base pass can be evaluated first
     for (unsigned i = 0; i < lights_.Size(); ++i)
     {
@@ -971,22 +1020,44 @@ void View::ProcessLights()
     auto* queue = GetSubsystem<WorkQueue>();
     lightQueryResults_.Resize(lights_.Size());
 
+    // With temporal coherence the spot and point light volume queries are kept between frames. They are valid while the
+    // light itself does not change
+    bool temporalCoherence = renderer_->GetTemporalCoherence();
+    unsigned viewMask = cullCamera_->GetViewMask();
     for (unsigned i = 0; i < lightQueryResults_.Size(); ++i)
     {
-        SharedPtr<WorkItem> item = queue->GetFreeItem();
-        item->priority_ = M_MAX_UNSIGNED;
-        item->workFunction_ = ProcessLightWork;
-        item->aux_ = this;
+        Light* light = lights_[i];
+        LightQueryResult& result = lightQueryResults_[i];
+        result.light_ = light;
+        result.volumeCache_ = nullptr;
 
-        LightQueryResult& query = lightQueryResults_[i];
-        query.light_ = lights_[i];
+        if (temporalCoherence && light->GetLightType() != LIGHT_DIRECTIONAL)
+        {
+            LightVolumeCache& cache = lightVolumeCaches_[light];
+            if (cache.viewMask_ != viewMask || octree_->IsDrawableChanged(light))
+                cache.query_.Invalidate();
+            cache.viewMask_ = viewMask;
+            cache.frameNumber_ = frame_.frameNumber_;
+            result.volumeCache_ = &cache.query_;
+        }
+    }
 
-        item->start_ = &query;
-        queue->AddWorkItem(item);
+    // Forget the lights that are not visible anymore, as they may also have been destroyed
+    for (HashMap<Light*, LightVolumeCache>::Iterator i = lightVolumeCaches_.Begin(); i != lightVolumeCaches_.End();)
+    {
+        if (i->second_.frameNumber_ != frame_.frameNumber_)
+            i = lightVolumeCaches_.Erase(i);
+        else
+            ++i;
     }
 
-    // Ensure all lights have been processed before proceeding
-    queue->Complete(M_MAX_UNSIGNED);
+    // Lights are processed one per batch, as the cost of a single light varies a lot
+    queue->ParallelFor(lightQueryResults_.Size(), 1, [this](unsigned begin, unsigned end, unsigned threadIndex)
+    {
+        URHO3D_PROFILE("ProcessLightWork");
+        for (unsigned i = begin; i < end; ++i)
+            ProcessLight(lightQueryResults_[i], threadIndex);
+    });
 }
 
 void View::GetLightBatches()
@@ -1070,7 +1141,7 @@ void View::GetLightBatches()
                     FinalizeShadowCamera(shadowCamera, light, shadowQueue.shadowViewport_, query.shadowCasterBox_[j]);
 
                     // Loop through shadow casters
-                    for (PODVector<Drawable*>::ConstIterator k = query.shadowCasters_.Begin() + query.shadowCasterBegin_[j];
+                    for (FramePODVector<Drawable*>::ConstIterator k = query.shadowCasters_.Begin() + query.shadowCasterBegin_[j];
                          k < query.shadowCasters_.Begin() + query.shadowCasterEnd_[j]; ++k)
                     {
                         Drawable* drawable = *k;
@@ -1103,6 +1174,7 @@ void View::GetLightBatches()
                             Batch destBatch(srcBatch);
                             destBatch.pass_ = pass;
                             destBatch.zone_ = nullptr;
+                            destBatch.changed_ = octree_->IsDrawableChanged(drawable);
 
                             AddBatchToQueue(shadowQueue.shadowBatches_, destBatch, tech);
                         }
@@ -1110,7 +1182,7 @@ void View::GetLightBatches()
                 }
 
                 // Process lit geometries
-                for (PODVector<Drawable*>::ConstIterator j = query.litGeometries_.Begin(); j != query.litGeometries_.End(); ++j)
+                for (FramePODVector<Drawable*>::ConstIterator j = query.litGeometries_.Begin(); j != query.litGeometries_.End(); ++j)
                 {
                     Drawable* drawable = *j;
                     drawable->AddLight(light);
@@ -1146,7 +1218,7 @@ void View::GetLightBatches()
             else
             {
                 // Add the vertex light to lit drawables. It will be processed later during base pass batch generation
-                for (PODVector<Drawable*>::ConstIterator j = query.litGeometries_.Begin(); j != query.litGeometries_.End(); ++j)
+                for (FramePODVector<Drawable*>::ConstIterator j = query.litGeometries_.Begin(); j != query.litGeometries_.End(); ++j)
                 {
                     Drawable* drawable = *j;
                     drawable->AddVertexLight(light);
@@ -1190,77 +1262,212 @@ void View::GetBaseBatches()
             nonThreadedGeometries_.Push(drawable);
         else if (type == UPDATE_WORKER_THREAD)
             threadedGeometries_.Push(drawable);
+    }
+
+    auto* queue = GetSubsystem<WorkQueue>();
+    if (!queue->GetNumThreads() || geometries_.Size() < BASE_BATCH_SIZE * 2)
+    {
+        for (PODVector<Drawable*>::ConstIterator i = geometries_.Begin(); i != geometries_.End(); ++i)
+            AddBaseBatches(*i);
+        return;
+    }
 
-        const Vector<SourceBatch>& batches = drawable->GetBatches();
-        bool vertexLightsProcessed = false;
+    // Collect batches and instanced batch groups in worker threads. Choosing the shaders may load them, so it is done
+    // when merging the results in the main thread
+    for (unsigned i = 0; i < baseBatchResults_.Size(); ++i)
+    {
+        PerThreadBaseBatches& result = baseBatchResults_[i];
 
-        for (unsigned j = 0; j < batches.Size(); ++j)
+        result.batchGroups_.Resize(scenePasses_.Size());
+        result.batches_.Resize(scenePasses_.Size());
+        for (unsigned j = 0; j < scenePasses_.Size(); ++j)
         {
-            const SourceBatch& srcBatch = batches[j];
+            result.batchGroups_[j].Clear();
+            result.batches_[j].Clear();
+        }
+        result.vertexLitDrawables_.Clear();
+        result.auxViewMaterials_.Clear();
+    }
+
+    queue->ParallelFor(geometries_.Size(), BASE_BATCH_SIZE, [this](unsigned begin, unsigned end, unsigned threadIndex)
+    {
+        URHO3D_PROFILE("CollectBaseBatchesWork");
+        PerThreadBaseBatches& result = baseBatchResults_[threadIndex];
+        for (unsigned i = begin; i < end; ++i)
+            CollectBaseBatches(geometries_[i], result);
+    });
+
+    for (unsigned i = 0; i < baseBatchResults_.Size(); ++i)
+    {
+        PerThreadBaseBatches& result = baseBatchResults_[i];
+
+        for (FramePODVector<Material*>::ConstIterator j = result.auxViewMaterials_.Begin(); j != result.auxViewMaterials_.End(); ++j)
+        {
+            if ((*j)->GetAuxViewFrameNumber() != frame_.frameNumber_)
+                CheckMaterialForAuxView(*j);
+        }
+
+        for (unsigned j = 0; j < scenePasses_.Size(); ++j)
+        {
+            BatchQueue& batchQueue = *scenePasses_[j].batchQueue_;
+
+            FrameHashMap<BatchGroupKey, PendingBatchGroup>& groups = result.batchGroups_[j];
+            for (FrameHashMap<BatchGroupKey, PendingBatchGroup>::Iterator k = groups.Begin(); k != groups.End(); ++k)
+                AddBatchGroupToQueue(batchQueue, k->second_.group_, k->second_.tech_);
+
+            FramePODVector<PendingBatch>& batches = result.batches_[j];
+            for (FramePODVector<PendingBatch>::Iterator k = batches.Begin(); k != batches.End(); ++k)
+                AddBatchToQueue(batchQueue, k->batch_, k->tech_, false);
+        }
+
+        for (FramePODVector<Drawable*>::ConstIterator j = result.vertexLitDrawables_.Begin(); j != result.vertexLitDrawables_.End(); ++j)
+            AddBaseBatches(*j);
+    }
+}
+
+void View::AddBaseBatches(Drawable* drawable)
+{
+    const Vector<SourceBatch>& batches = drawable->GetBatches();
+    bool vertexLightsProcessed = false;
+
+    for (unsigned j = 0; j < batches.Size(); ++j)
+    {
+        const SourceBatch& srcBatch = batches[j];
 
-            // Check here if the material refers to a rendertarget texture with camera(s) attached
-            // Only check this for backbuffer views (null rendertarget)
-            if (srcBatch.material_ && srcBatch.material_->GetAuxViewFrameNumber() != frame_.frameNumber_ && !renderTarget_)
-                CheckMaterialForAuxView(srcBatch.material_);
+        // Check here if the material refers to a rendertarget texture with camera(s) attached
+        // Only check this for backbuffer views (null rendertarget)
+        if (srcBatch.material_ && srcBatch.material_->GetAuxViewFrameNumber() != frame_.frameNumber_ && !renderTarget_)
+            CheckMaterialForAuxView(srcBatch.material_);
+
+        Technique* tech = GetTechnique(drawable, srcBatch.material_);
+        if (!srcBatch.geometry_ || !srcBatch.numWorldTransforms_ || !tech)
+            continue;
 
-            Technique* tech = GetTechnique(drawable, srcBatch.material_);
-            if (!srcBatch.geometry_ || !srcBatch.numWorldTransforms_ || !tech)
+        // Check each of the scene passes
+        for (unsigned k = 0; k < scenePasses_.Size(); ++k)
+        {
+            ScenePassInfo& info = scenePasses_[k];
+            // Skip forward base pass if the corresponding litbase pass already exists
+            if (info.passIndex_ == basePassIndex_ && j < 32 && drawable->HasBasePass(j))
                 continue;
 
-            // Check each of the scene passes
-            for (unsigned k = 0; k < scenePasses_.Size(); ++k)
-            {
-                ScenePassInfo& info = scenePasses_[k];
-                // Skip forward base pass if the corresponding litbase pass already exists
-                if (info.passIndex_ == basePassIndex_ && j < 32 && drawable->HasBasePass(j))
-                    continue;
+            Pass* pass = tech->GetSupportedPass(info.passIndex_);
+            if (!pass)
+                continue;
 
-                Pass* pass = tech->GetSupportedPass(info.passIndex_);
-                if (!pass)
-                    continue;
+            Batch destBatch(srcBatch);
+            destBatch.pass_ = pass;
+            destBatch.zone_ = GetZone(drawable);
+            destBatch.isBase_ = true;
+            destBatch.lightMask_ = (unsigned char)GetLightMask(drawable);
+            destBatch.changed_ = octree_->IsDrawableChanged(drawable);
 
-                Batch destBatch(srcBatch);
-                destBatch.pass_ = pass;
-                destBatch.zone_ = GetZone(drawable);
-                destBatch.isBase_ = true;
-                destBatch.lightMask_ = (unsigned char)GetLightMask(drawable);
+            if (info.vertexLights_)
+            {
+                const PODVector<Light*>& drawableVertexLights = drawable->GetVertexLights();
+                if (drawableVertexLights.Size() && !vertexLightsProcessed)
+                {
+                    // Limit vertex lights. If this is a deferred opaque batch, remove converted per-pixel lights,
+                    // as they will be rendered as light volumes in any case, and drawing them also as vertex lights
+                    // would result in double lighting
+                    drawable->LimitVertexLights(deferred_ && destBatch.pass_->GetBlendMode() == BLEND_REPLACE);
+                    vertexLightsProcessed = true;
+                }
 
-                if (info.vertexLights_)
+                if (drawableVertexLights.Size())
                 {
-                    const PODVector<Light*>& drawableVertexLights = drawable->GetVertexLights();
-                    if (drawableVertexLights.Size() && !vertexLightsProcessed)
+                    // Find a vertex light queue. If not found, create new
+                    unsigned long long hash = GetVertexLightQueueHash(drawableVertexLights);
+                    HashMap<unsigned long long, LightBatchQueue>::Iterator i = vertexLightQueues_.Find(hash);
+                    if (i == vertexLightQueues_.End())
                     {
-                        // Limit vertex lights. If this is a deferred opaque batch, remove converted per-pixel lights,
-                        // as they will be rendered as light volumes in any case, and drawing them also as vertex lights
-                        // would result in double lighting
-                        drawable->LimitVertexLights(deferred_ && destBatch.pass_->GetBlendMode() == BLEND_REPLACE);
-                        vertexLightsProcessed = true;
+                        i = vertexLightQueues_.Insert(MakePair(hash, LightBatchQueue()));
+                        i->second_.light_ = nullptr;
+                        i->second_.shadowMap_ = nullptr;
+                        i->second_.vertexLights_ = drawableVertexLights;
                     }
 
-                    if (drawableVertexLights.Size())
-                    {
-                        // Find a vertex light queue. If not found, create new
-                        unsigned long long hash = GetVertexLightQueueHash(drawableVertexLights);
-                        HashMap<unsigned long long, LightBatchQueue>::Iterator i = vertexLightQueues_.Find(hash);
-                        if (i == vertexLightQueues_.End())
-                        {
-                            i = vertexLightQueues_.Insert(MakePair(hash, LightBatchQueue()));
-                            i->second_.light_ = nullptr;
-                            i->second_.shadowMap_ = nullptr;
-                            i->second_.vertexLights_ = drawableVertexLights;
-                        }
-
-                        destBatch.lightQueue_ = &(i->second_);
-                    }
+                    destBatch.lightQueue_ = &(i->second_);
                 }
-                else
-                    destBatch.lightQueue_ = nullptr;
+            }
+            else
+                destBatch.lightQueue_ = nullptr;
 
-                bool allowInstancing = info.allowInstancing_;
-                if (allowInstancing && info.markToStencil_ && destBatch.lightMask_ != (destBatch.zone_->GetLightMask() & 0xffu))
-                    allowInstancing = false;
+            bool allowInstancing = info.allowInstancing_;
+            if (allowInstancing && info.markToStencil_ && destBatch.lightMask_ != (destBatch.zone_->GetLightMask() & 0xffu))
+                allowInstancing = false;
 
-                AddBatchToQueue(*info.batchQueue_, destBatch, tech, allowInstancing);
+            AddBatchToQueue(*info.batchQueue_, destBatch, tech, allowInstancing);
+        }
+    }
+}
+
+void View::CollectBaseBatches(Drawable* drawable, PerThreadBaseBatches& result)
+{
+    // Vertex light queues are shared, so drawables with vertex lights are left to the main thread
+    if (drawable->GetVertexLights().Size())
+    {
+        result.vertexLitDrawables_.Push(drawable);
+        return;
+    }
+
+    const Vector<SourceBatch>& batches = drawable->GetBatches();
+
+    for (unsigned j = 0; j < batches.Size(); ++j)
+    {
+        const SourceBatch& srcBatch = batches[j];
+
+        if (srcBatch.material_ && srcBatch.material_->GetAuxViewFrameNumber() != frame_.frameNumber_ && !renderTarget_)
+            result.auxViewMaterials_.Push(srcBatch.material_);
+
+        Technique* tech = GetTechnique(drawable, srcBatch.material_);
+        if (!srcBatch.geometry_ || !srcBatch.numWorldTransforms_ || !tech)
+            continue;
+
+        for (unsigned k = 0; k < scenePasses_.Size(); ++k)
+        {
+            ScenePassInfo& info = scenePasses_[k];
+            if (info.passIndex_ == basePassIndex_ && j < 32 && drawable->HasBasePass(j))
+                continue;
+
+            Pass* pass = tech->GetSupportedPass(info.passIndex_);
+            if (!pass)
+                continue;
+
+            Batch destBatch(srcBatch);
+            destBatch.pass_ = pass;
+            destBatch.zone_ = GetZone(drawable);
+            destBatch.isBase_ = true;
+            destBatch.lightMask_ = (unsigned char)GetLightMask(drawable);
+            destBatch.lightQueue_ = nullptr;
+            destBatch.changed_ = octree_->IsDrawableChanged(drawable);
+            if (!destBatch.material_)
+                destBatch.material_ = renderer_->GetDefaultMaterial();
+
+            bool allowInstancing = info.allowInstancing_;
+            if (allowInstancing && info.markToStencil_ && destBatch.lightMask_ != (destBatch.zone_->GetLightMask() & 0xffu))
+                allowInstancing = false;
+
+            // Group instanced batches already in the worker thread, same as in AddBatchToQueue()
+            if (allowInstancing && destBatch.geometryType_ == GEOM_STATIC && destBatch.geometry_->GetIndexBuffer())
+                destBatch.geometryType_ = GEOM_INSTANCED;
+
+            if (destBatch.geometryType_ == GEOM_INSTANCED)
+            {
+                FrameHashMap<BatchGroupKey, PendingBatchGroup>& groups = result.batchGroups_[k];
+                BatchGroupKey key(destBatch);
+
+                FrameHashMap<BatchGroupKey, PendingBatchGroup>::Iterator i = groups.Find(key);
+                if (i == groups.End())
+                    i = groups.Insert(MakePair(key, PendingBatchGroup(destBatch, tech)));
+                i->second_.group_.AddTransforms(destBatch);
+            }
+            else
+            {
+                PendingBatch pendingBatch;
+                pendingBatch.batch_ = destBatch;
+                pendingBatch.tech_ = tech;
+                result.batches_[k].Push(pendingBatch);
             }
         }
     }
@@ -1279,7 +1486,8 @@ void View::UpdateGeometries()
 
     auto* queue = GetSubsystem<WorkQueue>();
 
-    // Sort batches
+    // Sort batches. Each batch queue is sorted in its own work item, and large queues split their radix sort further to the
+    // worker threads
     {
         for (unsigned i = 0; i < renderPath_->commands_.Size(); ++i)
         {
@@ -1289,31 +1497,17 @@ void View::UpdateGeometries()
 
             if (command.type_ == CMD_SCENEPASS)
             {
-                SharedPtr<WorkItem> item = queue->GetFreeItem();
-                item->priority_ = M_MAX_UNSIGNED;
-                item->workFunction_ =
-                    command.sortMode_ == SORT_FRONTTOBACK ? SortBatchQueueFrontToBackWork : SortBatchQueueBackToFrontWork;
-                item->start_ = &batchQueues_[command.passIndex_];
-                queue->AddWorkItem(item);
+                AddSortWorkItem(&batchQueues_[command.passIndex_],
+                    command.sortMode_ == SORT_FRONTTOBACK ? SortBatchQueueFrontToBackWork : SortBatchQueueBackToFrontWork);
             }
         }
 
         for (Vector<LightBatchQueue>::Iterator i = lightQueues_.Begin(); i != lightQueues_.End(); ++i)
         {
-            SharedPtr<WorkItem> lightItem = queue->GetFreeItem();
-            lightItem->priority_ = M_MAX_UNSIGNED;
-            lightItem->workFunction_ = SortLightQueueWork;
-            lightItem->start_ = &(*i);
-            queue->AddWorkItem(lightItem);
-
-            if (i->shadowSplits_.Size())
-            {
-                SharedPtr<WorkItem> shadowItem = queue->GetFreeItem();
-                shadowItem->priority_ = M_MAX_UNSIGNED;
-                shadowItem->workFunction_ = SortShadowQueueWork;
-                shadowItem->start_ = &(*i);
-                queue->AddWorkItem(shadowItem);
-            }
+            AddSortWorkItem(&i->litBaseBatches_, SortBatchQueueFrontToBackWork);
+            AddSortWorkItem(&i->litBatches_, SortBatchQueueFrontToBackWork);
+            for (unsigned j = 0; j < i->shadowSplits_.Size(); ++j)
+                AddSortWorkItem(&i->shadowSplits_[j].shadowBatches_, SortBatchQueueFrontToBackWork);
         }
     }
 
@@ -1324,7 +1518,7 @@ void View::UpdateGeometries()
             // In special cases (context loss, multi-view) a drawable may theoretically first have reported a threaded update, but will actually
             // require a main thread update. Check these cases first and move as applicable. The threaded work routine will tolerate the null
             // pointer holes that we leave to the threaded update queue.
-            for (PODVector<Drawable*>::Iterator i = threadedGeometries_.Begin(); i != threadedGeometries_.End(); ++i)
+            for (FramePODVector<Drawable*>::Iterator i = threadedGeometries_.Begin(); i != threadedGeometries_.End(); ++i)
             {
                 if ((*i)->GetUpdateGeometryType() == UPDATE_MAIN_THREAD)
                 {
@@ -1336,10 +1530,10 @@ void View::UpdateGeometries()
             int numWorkItems = queue->GetNumThreads() + 1; // Worker threads + main thread
             int drawablesPerItem = threadedGeometries_.Size() / numWorkItems;
 
-            PODVector<Drawable*>::Iterator start = threadedGeometries_.Begin();
+            FramePODVector<Drawable*>::Iterator start = threadedGeometries_.Begin();
             for (int i = 0; i < numWorkItems; ++i)
             {
-                PODVector<Drawable*>::Iterator end = threadedGeometries_.End();
+                FramePODVector<Drawable*>::Iterator end = threadedGeometries_.End();
                 if (i < numWorkItems - 1 && end - start > drawablesPerItem)
                     end = start + drawablesPerItem;
 
@@ -1356,12 +1550,19 @@ void View::UpdateGeometries()
         }
 
         // While the work queue is processed, update non-threaded geometries
-        for (PODVector<Drawable*>::ConstIterator i = nonThreadedGeometries_.Begin(); i != nonThreadedGeometries_.End(); ++i)
+        for (FramePODVector<Drawable*>::ConstIterator i = nonThreadedGeometries_.Begin(); i != nonThreadedGeometries_.End(); ++i)
             (*i)->UpdateGeometry(frame_);
     }
 
-    // Finally ensure all threaded work has completed
+    // Finally ensure all threaded work has completed, then let the drawables upload what they prepared
     queue->Complete(M_MAX_UNSIGNED);
+    for (FramePODVector<Drawable*>::ConstIterator i = threadedGeometries_.Begin(); i != threadedGeometries_.End(); ++i)
+    {
+        if (*i)
+            (*i)->FinishUpdateGeometry(frame_);
+    }
+    for (FramePODVector<Drawable*>::ConstIterator i = nonThreadedGeometries_.Begin(); i != nonThreadedGeometries_.End(); ++i)
+        (*i)->FinishUpdateGeometry(frame_);
     geometriesUpdated_ = true;
 }
 
@@ -1388,6 +1589,7 @@ void View::GetLitBatches(Drawable* drawable, LightBatchQueue& lightQueue, BatchQ
             continue;
 
         Batch destBatch(srcBatch);
+        destBatch.changed_ = octree_->IsDrawableChanged(drawable);
         bool isLitAlpha = false;
 
         // Check for lit base pass. Because it uses the replace blend mode, it must be ensured to be the first light
@@ -2281,6 +2483,9 @@ void View::ProcessLight(LightQueryResult& query, unsigned threadIndex)
 #endif
     // Get lit geometries. They must match the light mask and be inside the main camera frustum to be considered
     PODVector<Drawable*>& tempDrawables = tempDrawables_[threadIndex];
+    OctreeQueryCache* volumeCache = query.volumeCache_;
+    PODVector<Drawable*>& volumeDrawables = volumeCache ? volumeCache->drawables_ : tempDrawables;
+    bool validate = volumeCache && renderer_->GetTemporalCoherenceValidation();
     query.litGeometries_.Clear();
 
     switch (type)
@@ -2295,26 +2500,40 @@ void View::ProcessLight(LightQueryResult& query, unsigned threadIndex)
 
     case LIGHT_SPOT:
         {
-            FrustumOctreeQuery octreeQuery(tempDrawables, light->GetFrustum(), DRAWABLE_GEOMETRY,
+            FrustumOctreeQuery octreeQuery(volumeDrawables, light->GetFrustum(), DRAWABLE_GEOMETRY,
                 cullCamera_->GetViewMask());
-            octree_->GetDrawables(octreeQuery);
-            for (unsigned i = 0; i < tempDrawables.Size(); ++i)
+            if (!volumeCache)
+                octree_->GetDrawables(octreeQuery);
+            else if (octree_->GetDrawables(octreeQuery, *volumeCache) && validate)
+            {
+                FrustumOctreeQuery fullQuery(tempDrawables, light->GetFrustum(), DRAWABLE_GEOMETRY, cullCamera_->GetViewMask());
+                octree_->GetDrawables(fullQuery);
+                ValidateCachedDrawables(volumeDrawables, tempDrawables, "spot light");
+            }
+            for (unsigned i = 0; i < volumeDrawables.Size(); ++i)
             {
-                if (tempDrawables[i]->IsInView(frame_) && (GetLightMask(tempDrawables[i]) & lightMask))
-                    query.litGeometries_.Push(tempDrawables[i]);
+                if (volumeDrawables[i]->IsInView(frame_) && (GetLightMask(volumeDrawables[i]) & lightMask))
+                    query.litGeometries_.Push(volumeDrawables[i]);
             }
         }
         break;
 
     case LIGHT_POINT:
         {
-            SphereOctreeQuery octreeQuery(tempDrawables, Sphere(light->GetNode()->GetWorldPosition(), light->GetRange()),
-                DRAWABLE_GEOMETRY, cullCamera_->GetViewMask());
-            octree_->GetDrawables(octreeQuery);
-            for (unsigned i = 0; i < tempDrawables.Size(); ++i)
+            Sphere sphere(light->GetNode()->GetWorldPosition(), light->GetRange());
+            SphereOctreeQuery octreeQuery(volumeDrawables, sphere, DRAWABLE_GEOMETRY, cullCamera_->GetViewMask());
+            if (!volumeCache)
+                octree_->GetDrawables(octreeQuery);
+            else if (octree_->GetDrawables(octreeQuery, *volumeCache) && validate)
+            {
+                SphereOctreeQuery fullQuery(tempDrawables, sphere, DRAWABLE_GEOMETRY, cullCamera_->GetViewMask());
+                octree_->GetDrawables(fullQuery);
+                ValidateCachedDrawables(volumeDrawables, tempDrawables, "point light");
+            }
+            for (unsigned i = 0; i < volumeDrawables.Size(); ++i)
             {
-                if (tempDrawables[i]->IsInView(frame_) && (GetLightMask(tempDrawables[i]) & lightMask))
-                    query.litGeometries_.Push(tempDrawables[i]);
+                if (volumeDrawables[i]->IsInView(frame_) && (GetLightMask(volumeDrawables[i]) & lightMask))
+                    query.litGeometries_.Push(volumeDrawables[i]);
             }
         }
         break;
@@ -2356,7 +2575,7 @@ void View::ProcessLight(LightQueryResult& query, unsigned threadIndex)
         }
 
         // Check which shadow casters actually contribute to the shadowing
-        ProcessShadowCasters(query, tempDrawables, i);
+        ProcessShadowCasters(query, type == LIGHT_DIRECTIONAL ? tempDrawables : volumeDrawables, i);
     }
 
     // If no shadow casters, the light can be rendered unshadowed. At this point we have not allocated a shadow map yet, so the
@@ -2365,6 +2584,19 @@ void View::ProcessLight(LightQueryResult& query, unsigned threadIndex)
         query.numSplits_ = 0;
 }
 
+void View::ValidateCachedDrawables(PODVector<Drawable*>& cached, PODVector<Drawable*>& full, const char* queryName)
+{
+    // The order of the incrementally updated result differs, so compare sorted
+    Sort(cached.Begin(), cached.End());
+    Sort(full.Begin(), full.End());
+    if (cached != full)
+    {
+        URHO3D_LOGWARNINGF("Cached %s query result differs from the full query (%u drawables, expected %u)", queryName, cached.Size(), full.Size());
+        if (coherenceMismatchesCounter_)
+            coherenceMismatchesCounter_->Increment();
+    }
+}
+
 void View::ProcessShadowCasters(LightQueryResult& query, const PODVector<Drawable*>& drawables, unsigned splitIndex)
 {
     Light* light = query.light_;
@@ -2896,7 +3128,7 @@ void View::AddBatchToQueue(BatchQueue& queue, Batch& batch, Technique* tech, boo
     {
         BatchGroupKey key(batch);
 
-        HashMap<BatchGroupKey, BatchGroup>::Iterator i = queue.batchGroups_.Find(key);
+        FrameHashMap<BatchGroupKey, BatchGroup>::Iterator i = queue.batchGroups_.Find(key);
         if (i == queue.batchGroups_.End())
         {
             // Create a new group based on the batch
@@ -2940,6 +3172,49 @@ void View::AddBatchToQueue(BatchQueue& queue, Batch& batch, Technique* tech, boo
     }
 }
 
+void View::AddBatchGroupToQueue(BatchQueue& queue, const BatchGroup& group, Technique* tech, bool allowShadows)
+{
+    BatchGroupKey key(group);
+
+    FrameHashMap<BatchGroupKey, BatchGroup>::Iterator i = queue.batchGroups_.Find(key);
+    if (i == queue.batchGroups_.End())
+    {
+        BatchGroup newGroup(static_cast<const Batch&>(group));
+        newGroup.geometryType_ = GEOM_STATIC;
+        renderer_->SetBatchShaders(newGroup, tech, allowShadows, queue);
+        newGroup.CalculateSortKey();
+        i = queue.batchGroups_.Insert(MakePair(key, newGroup));
+    }
+
+    int oldSize = i->second_.instances_.Size();
+    i->second_.AddInstances(group);
+    if (oldSize < minInstances_ && (int)i->second_.instances_.Size() >= minInstances_)
+    {
+        i->second_.geometryType_ = GEOM_INSTANCED;
+        renderer_->SetBatchShaders(i->second_, tech, allowShadows, queue);
+        i->second_.CalculateSortKey();
+    }
+}
+
+void View::AddSortWorkItem(BatchQueue* batchQueue, void (*workFunction)(const WorkItem*, unsigned))
+{
+    // Empty queues only need the sorted batch groups cleared
+    if (batchQueue->batches_.Empty() && batchQueue->batchGroups_.Empty())
+    {
+        batchQueue->sortedBatches_.Clear();
+        batchQueue->sortedBatchGroups_.Clear();
+        return;
+    }
+
+    auto* queue = GetSubsystem<WorkQueue>();
+    SharedPtr<WorkItem> item = queue->GetFreeItem();
+    item->priority_ = M_MAX_UNSIGNED;
+    item->workFunction_ = workFunction;
+    item->start_ = batchQueue;
+    item->aux_ = queue;
+    queue->AddWorkItem(item);
+}
+
 void View::PrepareInstancingBuffer()
 {
     // Prepare instancing buffer from the source view
@@ -2952,6 +3227,30 @@ void View::PrepareInstancingBuffer()
 
     URHO3D_PROFILE("PrepareInstancingBuffer");
 
+    unsigned uploadBytes = 0;
+
+    // Place the instances to the persistent pool first, and upload only the pool slots that changed. The groups the pool
+    // cannot take are written to the per-frame buffer
+    if (InstanceDataPool* pool = renderer_->GetInstanceDataPool())
+    {
+        pool->BeginFrame(frame_.frameNumber_);
+
+        for (HashMap<unsigned, BatchQueue>::Iterator i = batchQueues_.Begin(); i != batchQueues_.End(); ++i)
+            i->second_.PlaceInstances(*pool, i->first_);
+
+        // Key the light queues by the light, so that the placements of the same light are found again next frame
+        for (Vector<LightBatchQueue>::Iterator i = lightQueues_.Begin(); i != lightQueues_.End(); ++i)
+        {
+            unsigned lightKey = MakeHash(i->light_) * 31;
+            for (unsigned j = 0; j < i->shadowSplits_.Size(); ++j)
+                i->shadowSplits_[j].shadowBatches_.PlaceInstances(*pool, lightKey + j);
+            i->litBaseBatches_.PlaceInstances(*pool, lightKey + MAX_LIGHT_SPLITS);
+            i->litBatches_.PlaceInstances(*pool, lightKey + MAX_LIGHT_SPLITS + 1);
+        }
+
+        uploadBytes += renderer_->UpdatePersistentInstancingBuffer();
+    }
+
     unsigned totalInstances = 0;
 
     for (HashMap<unsigned, BatchQueue>::Iterator i = batchQueues_.Begin(); i != batchQueues_.End(); ++i)
@@ -2965,28 +3264,32 @@ void View::PrepareInstancingBuffer()
         totalInstances += i->litBatches_.GetNumInstances();
     }
 
-    if (!totalInstances || !renderer_->ResizeInstancingBuffer(totalInstances))
-        return;
-
-    VertexBuffer* instancingBuffer = renderer_->GetInstancingBuffer();
-    unsigned freeIndex = 0;
-    void* dest = instancingBuffer->Lock(0, totalInstances, true);
-    if (!dest)
-        return;
+    if (totalInstances && renderer_->ResizeInstancingBuffer(totalInstances))
+    {
+        VertexBuffer* instancingBuffer = renderer_->GetInstancingBuffer();
+        unsigned freeIndex = 0;
+        void* dest = instancingBuffer->Lock(0, totalInstances, true);
+        if (dest)
+        {
+            const unsigned stride = instancingBuffer->GetVertexSize();
+            for (HashMap<unsigned, BatchQueue>::Iterator i = batchQueues_.Begin(); i != batchQueues_.End(); ++i)
+                i->second_.SetInstancingData(dest, stride, freeIndex);
 
-    const unsigned stride = instancingBuffer->GetVertexSize();
-    for (HashMap<unsigned, BatchQueue>::Iterator i = batchQueues_.Begin(); i != batchQueues_.End(); ++i)
-        i->second_.SetInstancingData(dest, stride, freeIndex);
+            for (Vector<LightBatchQueue>::Iterator i = lightQueues_.Begin(); i != lightQueues_.End(); ++i)
+            {
+                for (unsigned j = 0; j < i->shadowSplits_.Size(); ++j)
+                    i->shadowSplits_[j].shadowBatches_.SetInstancingData(dest, stride, freeIndex);
+                i->litBaseBatches_.SetInstancingData(dest, stride, freeIndex);
+                i->litBatches_.SetInstancingData(dest, stride, freeIndex);
+            }
 
-    for (Vector<LightBatchQueue>::Iterator i = lightQueues_.Begin(); i != lightQueues_.End(); ++i)
-    {
-        for (unsigned j = 0; j < i->shadowSplits_.Size(); ++j)
-            i->shadowSplits_[j].shadowBatches_.SetInstancingData(dest, stride, freeIndex);
-        i->litBaseBatches_.SetInstancingData(dest, stride, freeIndex);
-        i->litBatches_.SetInstancingData(dest, stride, freeIndex);
+            instancingBuffer->Unlock();
+            uploadBytes += totalInstances * stride;
+        }
     }
 
-    instancingBuffer->Unlock();
+    if (instancingUploadCounter_)
+        instancingUploadCounter_->Increment(uploadBytes);
 }
 
 void View::SetupLightVolumeBatch(Batch& batch)
@@ -27,6 +27,7 @@
 #include "../Core/Object.h"
 #include "../Graphics/Batch.h"
 #include "../Graphics/Light.h"
+#include "../Graphics/Octree.h"
 #include "../Graphics/Zone.h"
 #include "../Math/Polyhedron.h"
 
@@ -40,6 +41,7 @@ class Drawable;
 class Graphics;
 class OcclusionBuffer;
 class Octree;
+class PerformanceCounter;
 class Renderer;
 class RenderPath;
 class RenderSurface;
@@ -56,10 +58,10 @@ struct LightQueryResult
 {
     /// Light.
     Light* light_;
-    /// Lit geometries.
-    PODVector<Drawable*> litGeometries_;
-    /// Shadow casters.
-    PODVector<Drawable*> shadowCasters_;
+    /// Lit geometries. Allocated from the frame allocator.
+    FramePODVector<Drawable*> litGeometries_;
+    /// Shadow casters. Allocated from the frame allocator.
+    FramePODVector<Drawable*> shadowCasters_;
     /// Shadow cameras.
     Camera* shadowCameras_[MAX_LIGHT_SPLITS];
     /// Shadow caster start indices.
@@ -74,6 +76,8 @@ struct LightQueryResult
     float shadowFarSplits_[MAX_LIGHT_SPLITS];
     /// Shadow map split count.
     unsigned numSplits_;
+    /// Cached light volume query when using temporal coherence, null otherwise.
+    OctreeQueryCache* volumeCache_;
 };
 
 /// Scene render pass info.
@@ -94,23 +98,74 @@ struct ScenePassInfo
 /// Per-thread geometry, light and scene range collection structure.
 struct PerThreadSceneResult
 {
-    /// Geometry objects.
-    PODVector<Drawable*> geometries_;
-    /// Lights.
-    PODVector<Light*> lights_;
+    /// Geometry objects. Allocated from the frame allocator.
+    FramePODVector<Drawable*> geometries_;
+    /// Lights. Allocated from the frame allocator.
+    FramePODVector<Light*> lights_;
     /// Scene minimum Z value.
     float minZ_;
     /// Scene maximum Z value.
     float maxZ_;
 };
 
+/// Non-instanced batch collected in a worker thread before shaders are assigned.
+struct PendingBatch
+{
+    /// Batch.
+    Batch batch_;
+    /// Technique of the batch.
+    Technique* tech_;
+};
+
+/// Instanced batch group collected in a worker thread before shaders are assigned.
+struct PendingBatchGroup
+{
+    /// Construct undefined.
+    PendingBatchGroup() = default;
+
+    /// Construct from a batch.
+    PendingBatchGroup(const Batch& batch, Technique* tech) :
+        group_(batch),
+        tech_(tech)
+    {
+    }
+
+    /// Batch group.
+    BatchGroup group_;
+    /// Technique of the batch group.
+    Technique* tech_{};
+};
+
+/// Per-thread base batch collection structure.
+struct PerThreadBaseBatches
+{
+    /// Instanced batch groups by scene pass. Allocated from the frame allocator.
+    Vector<FrameHashMap<BatchGroupKey, PendingBatchGroup> > batchGroups_;
+    /// Non-instanced batches by scene pass. Allocated from the frame allocator.
+    Vector<FramePODVector<PendingBatch> > batches_;
+    /// Drawables with vertex lights, which are processed in the main thread. Allocated from the frame allocator.
+    FramePODVector<Drawable*> vertexLitDrawables_;
+    /// Materials to check for auxiliary views. Allocated from the frame allocator.
+    FramePODVector<Material*> auxViewMaterials_;
+};
+
+/// Spot or point light volume query result kept between frames.
+struct LightVolumeCache
+{
+    /// Octree query result.
+    OctreeQueryCache query_;
+    /// View mask of the query.
+    unsigned viewMask_{};
+    /// Frame number when last used.
+    unsigned frameNumber_{};
+};
+
 static const unsigned MAX_VIEWPORT_TEXTURES = 2;
 
 /// Internal structure for 3D rendering work. Created for each backbuffer and texture viewport, but not for shadow cameras.
 class URHO3D_API View : public Object
 {
-    friend void CheckVisibilityWork(const WorkItem* item, unsigned threadIndex);
-    friend void ProcessLightWork(const WorkItem* item, unsigned threadIndex);
+    friend void CheckVisibilityWork(View* view, Drawable** start, Drawable** end, unsigned threadIndex);
 
     URHO3D_OBJECT(View, Object);
 
@@ -201,6 +256,10 @@ private:
     void GetLightBatches();
     /// Get unlit batches.
     void GetBaseBatches();
+    /// Get unlit batches for a drawable.
+    void AddBaseBatches(Drawable* drawable);
+    /// Collect unlit batches for a drawable in a worker thread.
+    void CollectBaseBatches(Drawable* drawable, PerThreadBaseBatches& result);
     /// Update geometries and sort batches.
     void UpdateGeometries();
     /// Get pixel lit batches for a certain light and drawable.
@@ -231,6 +290,8 @@ private:
     void DrawOccluders(OcclusionBuffer* buffer, const PODVector<Drawable*>& occluders);
     /// Query for lit geometries and shadow casters for a light.
     void ProcessLight(LightQueryResult& query, unsigned threadIndex);
+    /// Compare a cached query result to the full query result and log any difference. Both are sorted.
+    void ValidateCachedDrawables(PODVector<Drawable*>& cached, PODVector<Drawable*>& full, const char* queryName);
     /// Process shadow casters' visibilities and build their combined view- or projection-space bounding box.
     void ProcessShadowCasters(LightQueryResult& query, const PODVector<Drawable*>& drawables, unsigned splitIndex);
     /// Set up initial shadow camera view(s).
@@ -258,7 +319,11 @@ private:
     void SetQueueShaderDefines(BatchQueue& queue, const RenderPathCommand& command);
     /// Choose shaders for a batch and add it to queue.
     void AddBatchToQueue(BatchQueue& queue, Batch& batch, Technique* tech, bool allowInstancing = true, bool allowShadows = true);
-    /// Prepare instancing buffer by filling it with all instance transforms.
+    /// Choose shaders for a batch group collected in a worker thread and merge it to queue.
+    void AddBatchGroupToQueue(BatchQueue& queue, const BatchGroup& group, Technique* tech, bool allowShadows = true);
+    /// Queue a work item to sort a batch queue.
+    void AddSortWorkItem(BatchQueue* batchQueue, void (*workFunction)(const WorkItem*, unsigned));
+    /// Prepare instancing buffers by placing instances to the persistent pool and filling the per-frame buffer with the rest.
     void PrepareInstancingBuffer();
     /// Set up a light volume rendering batch.
     void SetupLightVolumeBatch(Batch& batch);
@@ -307,6 +372,14 @@ private:
     WeakPtr<Graphics> graphics_;
     /// Renderer subsystem.
     WeakPtr<Renderer> renderer_;
+    /// Visible drawables performance counter.
+    PerformanceCounter* visibleDrawablesCounter_{};
+    /// Culled drawables performance counter.
+    PerformanceCounter* culledDrawablesCounter_{};
+    /// Temporal coherence mismatch performance counter.
+    PerformanceCounter* coherenceMismatchesCounter_{};
+    /// Instancing buffer upload bytes performance counter.
+    PerformanceCounter* instancingUploadCounter_{};
     /// Scene to use.
     Scene* scene_{};
     /// Octree to use.
@@ -383,14 +456,26 @@ private:
     Vector<PODVector<Drawable*> > tempDrawables_;
     /// Per-thread geometries, lights and Z range collection results.
     Vector<PerThreadSceneResult> sceneResults_;
+    /// Per-thread base batch collection results.
+    Vector<PerThreadBaseBatches> baseBatchResults_;
+    /// Zone and occluder query result kept between frames for temporal coherence.
+    OctreeQueryCache zoneOccluderCache_;
+    /// Geometry and light query result kept between frames for temporal coherence.
+    OctreeQueryCache sceneCache_;
+    /// Light volume query results kept between frames for temporal coherence.
+    HashMap<Light*, LightVolumeCache> lightVolumeCaches_;
+    /// Culling frustum of the cached query results.
+    Frustum cachedFrustum_;
+    /// View mask of the cached query results.
+    unsigned cachedViewMask_{};
     /// Visible zones.
     PODVector<Zone*> zones_;
     /// Visible geometry objects.
     PODVector<Drawable*> geometries_;
     /// Geometry objects that will be updated in the main thread.
-    PODVector<Drawable*> nonThreadedGeometries_;
+    FramePODVector<Drawable*> nonThreadedGeometries_;
     /// Geometry objects that will be updated in worker threads.
-    PODVector<Drawable*> threadedGeometries_;
+    FramePODVector<Drawable*> threadedGeometries_;
     /// Occluder objects.
     PODVector<Drawable*> occluders_;
     /// Lights.
@@ -27,7 +27,7 @@
 namespace Urho3D
 {
 
-/// Log message event.
+/// Log message event. Sent in the main thread at the end of the frame in which the message was logged.
 URHO3D_EVENT(E_LOGMESSAGE, LogMessage)
 {
     URHO3D_PARAM(P_MESSAGE, Message);              // String
@@ -32,7 +32,9 @@
 #include "../IO/IOEvents.h"
 #include "../IO/Log.h"
 
+#include <condition_variable>
 #include <cstdio>
+#include <mutex>
 
 #ifdef __ANDROID__
 #include <android/log.h>
@@ -58,9 +60,145 @@ const char* logLevelPrefixes[] =
 
 static Log* logInstance = nullptr;
 static bool threadErrorDisplayed = false;
+static bool exitHandlerRegistered = false;
+
+/// Write out pending log records when the process exits.
+static void FlushLogAtExit()
+{
+    Log::FlushPending();
+}
+
+/// Thread formatting and writing out log records. Sleeps until records are published.
+class LogWriterThread : public Thread
+{
+public:
+    /// Construct.
+    explicit LogWriterThread(Log* log) :
+        log_(log),
+        pending_(false),
+        stop_(false)
+    {
+    }
+
+    /// Process log records until stopped.
+    void ThreadFunction() override
+    {
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                condition_.wait(lock, [this]() { return pending_.load() || stop_; });
+                if (stop_)
+                    break;
+            }
+
+            // Clear the flag before processing, so that records published meanwhile wake up the thread again
+            pending_.exchange(false);
+            log_->Flush();
+        }
+    }
+
+    /// Wake up the thread to process a published record. Called from any thread.
+    void NotifyRecord()
+    {
+        if (!pending_.exchange(true))
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            condition_.notify_one();
+        }
+    }
+
+    /// Wake up the thread and wait for it to exit.
+    void StopWriting()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        condition_.notify_one();
+        Stop();
+    }
+
+private:
+    /// Log subsystem.
+    Log* log_;
+    /// Mutex for the wake condition.
+    std::mutex mutex_;
+    /// Wake condition.
+    std::condition_variable condition_;
+    /// Records published flag.
+    std::atomic<bool> pending_;
+    /// Stop flag.
+    bool stop_;
+};
+
+void LogRecord::Clear()
+{
+    textLength_ = 0;
+    messageLength_ = 0;
+    numArguments_ = 0;
+    longText_.Clear();
+}
+
+unsigned LogRecord::AppendText(const char* text, unsigned length)
+{
+    unsigned offset = textLength_;
+    if (longText_.Empty() && textLength_ + length < LOG_RECORD_TEXT_SIZE)
+    {
+        memcpy(text_ + textLength_, text, length);
+        text_[textLength_ + length] = 0;
+    }
+    else
+    {
+        if (longText_.Empty())
+            longText_.Append(text_, textLength_);
+        longText_.Append(text, length);
+    }
+    textLength_ += length;
+    return offset;
+}
+
+void LogRecord::AddArgument(const char* value)
+{
+    if (!value)
+        value = "(null)";
+
+    auto length = (unsigned)strlen(value);
+    LogArgument& argument = arguments_[numArguments_++];
+    argument.type_ = LOGARG_STRING;
+    argument.offset_ = AppendText(value, length);
+    argument.length_ = length;
+}
+
+void LogRecord::AddArgument(const String& value)
+{
+    LogArgument& argument = arguments_[numArguments_++];
+    argument.type_ = LOGARG_STRING;
+    argument.offset_ = AppendText(value.CString(), value.Length());
+    argument.length_ = value.Length();
+}
+
+/// Return captured argument as an integer.
+static long long GetIntegerArgument(const LogArgument& argument)
+{
+    switch (argument.type_)
+    {
+    case LOGARG_INT:
+        return argument.int_;
+    case LOGARG_UNSIGNED:
+        return (long long)argument.unsigned_;
+    case LOGARG_DOUBLE:
+        return (long long)argument.double_;
+    case LOGARG_POINTER:
+        return (long long)(uintptr_t)argument.pointer_;
+    default:
+        return 0;
+    }
+}
 
 Log::Log(Context* context) :
     Object(context),
+    records_(new LogRecord[LOG_RING_BUFFER_SIZE]),
 #ifdef _DEBUG
     level_(LOG_DEBUG),
 #else
@@ -70,14 +208,37 @@ Log::Log(Context* context) :
     inWrite_(false),
     quiet_(false)
 {
+    for (unsigned i = 0; i < LOG_RING_BUFFER_SIZE; ++i)
+        records_[i].sequence_.store(i, std::memory_order_relaxed);
+
+    // If threading is not available, records are processed at the end of frame instead. The writer thread exists before
+    // the log is published to the logging threads, which wake it up
+    writerThread_ = new LogWriterThread(this);
+    if (!writerThread_->Run())
+        writerThread_.Reset();
+
     logInstance = this;
 
+    // Records still in the ring buffer would be lost if the process exits without destroying the log
+    if (!exitHandlerRegistered)
+    {
+        atexit(FlushLogAtExit);
+        exitHandlerRegistered = true;
+    }
+
     SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(Log, HandleEndFrame));
 }
 
 Log::~Log()
 {
     logInstance = nullptr;
+
+    if (writerThread_)
+    {
+        writerThread_->StopWriting();
+        writerThread_.Reset();
+    }
+    Flush();
 }
 
 void Log::Open(const String& fileName)
@@ -93,20 +254,26 @@ void Log::Open(const String& fileName)
             Close();
     }
 
-    logFile_ = new File(context_);
-    if (logFile_->Open(fileName, FILE_WRITE))
+    {
+        MutexLock lock(processMutex_);
+        logFile_ = new File(context_);
+        if (!logFile_->Open(fileName, FILE_WRITE))
+            logFile_.Reset();
+    }
+
+    if (logFile_)
         Write(LOG_INFO, "Opened log file " + fileName);
     else
-    {
-        logFile_.Reset();
         Write(LOG_ERROR, "Failed to create log file " + fileName);
-    }
 #endif
 }
 
 void Log::Close()
 {
 #if !defined(__ANDROID__) && !defined(IOS) && !defined(TVOS)
+    Flush();
+
+    MutexLock lock(processMutex_);
     if (logFile_ && logFile_->IsOpen())
     {
         logFile_->Close();
@@ -115,6 +282,11 @@ void Log::Close()
 #endif
 }
 
+void Log::Flush()
+{
+    ProcessRecords();
+}
+
 void Log::SetLevel(LogLevel level)
 {
     if (level < LOG_TRACE || level > LOG_NONE)
@@ -136,137 +308,356 @@ void Log::SetQuiet(bool quiet)
     quiet_ = quiet;
 }
 
-void Log::Write(LogLevel level, const String& message)
+void Log::SetRateLimit(LogLevel level, unsigned messagesPerSecond)
 {
-    // Special case for LOG_RAW level
-    if (level == LOG_RAW)
+    if (level < LOG_TRACE || level >= LOG_NONE)
     {
-        WriteRaw(message, false);
+        URHO3D_LOGERRORF("Attempted to set rate limit of erroneous log level %d", level);
         return;
     }
 
-    // No-op if illegal level
-    if (level < LOG_TRACE || level >= LOG_NONE)
+    rateLimits_[level].messagesPerSecond_ = messagesPerSecond;
+}
+
+unsigned Log::GetRateLimit(LogLevel level) const
+{
+    return level >= LOG_TRACE && level < LOG_NONE ? rateLimits_[level].messagesPerSecond_.load() : 0;
+}
+
+unsigned Log::GetNumRateLimited(LogLevel level) const
+{
+    return level >= LOG_TRACE && level < LOG_NONE ? rateLimits_[level].numDropped_.load() : 0;
+}
+
+void Log::FlushPending()
+{
+    if (logInstance)
+        logInstance->Flush();
+}
+
+void Log::Write(LogLevel level, const String& message)
+{
+    LogRecord* record = BeginRecord(level, false);
+    if (!record)
         return;
 
-    // If not in the main thread, store message for later processing
-    if (!Thread::IsMainThread())
+    record->AppendText(message.CString(), message.Length());
+    record->messageLength_ = record->textLength_;
+    EndRecord(record);
+}
+
+void Log::WriteRaw(const String& message, bool error)
+{
+    LogRecord* record = BeginRecord(LOG_RAW, error);
+    if (!record)
+        return;
+
+    record->AppendText(message.CString(), message.Length());
+    record->messageLength_ = record->textLength_;
+    EndRecord(record);
+}
+
+LogRecord* Log::BeginRecord(LogLevel level, bool error)
+{
+    Log* log = logInstance;
+    if (!log)
+        return nullptr;
+
+    // No-op if illegal level or message level excluded
+    if (level != LOG_RAW && (level < LOG_TRACE || level >= LOG_NONE || log->level_ > level))
+        return nullptr;
+
+    // Do not log if currently sending a log event
+    if (log->inWrite_ && Thread::IsMainThread())
+        return nullptr;
+
+    time_t now = time(nullptr);
+
+    if (level != LOG_RAW)
     {
-        if (logInstance)
+        RateLimit& rateLimit = log->rateLimits_[level];
+        unsigned messagesPerSecond = rateLimit.messagesPerSecond_.load(std::memory_order_relaxed);
+        if (messagesPerSecond)
         {
-            MutexLock lock(logInstance->logMutex_);
-            logInstance->threadMessages_.Push(StoredLogMessage(message, level, false));
+            auto window = (unsigned)now;
+            unsigned currentWindow = rateLimit.window_.load(std::memory_order_relaxed);
+            if (currentWindow != window && rateLimit.window_.compare_exchange_strong(currentWindow, window))
+                rateLimit.count_ = 0;
+            if (rateLimit.count_.fetch_add(1, std::memory_order_relaxed) >= messagesPerSecond)
+            {
+                rateLimit.numDropped_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
         }
+    }
 
-        return;
+    // Claim a record. Its sequence equals the position when it is free for writing
+    LogRecord* record;
+    unsigned pos = log->enqueuePos_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        record = &log->records_[pos & (LOG_RING_BUFFER_SIZE - 1)];
+        auto diff = (int)(record->sequence_.load(std::memory_order_acquire) - pos);
+        if (diff == 0)
+        {
+            if (log->enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            log->numOverflowed_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        else
+            pos = log->enqueuePos_.load(std::memory_order_relaxed);
     }
 
-    // Do not log if message level excluded or if currently sending a log event
-    if (!logInstance || logInstance->level_ > level || logInstance->inWrite_)
-        return;
+    record->level_ = level;
+    record->error_ = error;
+    record->format_ = false;
+    record->time_ = now;
+    return record;
+}
 
-    String formattedMessage = logLevelPrefixes[level];
-    formattedMessage += ": ";
-    formattedMessage += String(' ', 9 - formattedMessage.Length());
-    formattedMessage += message;
-    logInstance->lastMessage_ = message;
+void Log::EndRecord(LogRecord* record)
+{
+    // The record may be processed and reused as soon as it is published, so check its level first
+    bool flush = record->level_ == LOG_ERROR || record->error_;
+    record->sequence_.store(record->sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+    // Write out errors synchronously, as they often precede a crash or exit
+    if (flush)
+        FlushPending();
+    else if (Log* log = logInstance)
+    {
+        if (log->writerThread_)
+            log->writerThread_->NotifyRecord();
+    }
+}
 
-    if (logInstance->timeStamp_)
-        formattedMessage = "[" + Time::GetTimeStamp() + "] " + formattedMessage;
+void Log::ProcessRecords()
+{
+    MutexLock lock(processMutex_);
+
+    String message;
+    for (;;)
+    {
+        LogRecord& record = records_[dequeuePos_ & (LOG_RING_BUFFER_SIZE - 1)];
+        if (record.sequence_.load(std::memory_order_acquire) != dequeuePos_ + 1)
+            break;
 
-    URHO3D_PROFILE_MESSAGE(formattedMessage.CString(), formattedMessage.Length());
+        FormatRecord(record, message);
+        LogLevel level = record.level_;
+        bool error = record.error_;
+        time_t time = record.time_;
 
+        // Release the record to producers
+        record.Clear();
+        record.sequence_.store(dequeuePos_ + LOG_RING_BUFFER_SIZE, std::memory_order_release);
+        ++dequeuePos_;
+
+        if (level == LOG_RAW)
+        {
 #if defined(__ANDROID__)
-    int androidLevel = ANDROID_LOG_VERBOSE + level;
-    __android_log_print(androidLevel, "Urho3D", "%s", message.CString());
+            if (quiet_)
+            {
+                if (error)
+                    __android_log_print(ANDROID_LOG_ERROR, "Urho3D", "%s", message.CString());
+            }
+            else
+                __android_log_print(error ? ANDROID_LOG_ERROR : ANDROID_LOG_INFO, "Urho3D", "%s", message.CString());
 #elif defined(IOS) || defined(TVOS)
-    SDL_IOS_LogMessage(message.CString());
+            SDL_IOS_LogMessage(message.CString());
 #else
-    if (logInstance->quiet_)
-    {
-        // If in quiet mode, still print the error message to the standard error stream
-        if (level == LOG_ERROR)
-            PrintUnicodeLine(formattedMessage, true);
-    }
-    else
-        PrintUnicodeLine(formattedMessage, level == LOG_ERROR);
+            if (quiet_)
+            {
+                // If in quiet mode, still print the error message to the standard error stream
+                if (error)
+                    PrintUnicode(message, true);
+            }
+            else
+                PrintUnicode(message, error);
 #endif
 
-    if (logInstance->logFile_)
-    {
-        logInstance->logFile_->WriteLine(formattedMessage);
-        logInstance->logFile_->Flush();
-    }
+            if (logFile_)
+                fileBuffer_ += message;
 
-    logInstance->inWrite_ = true;
+            processedMessages_.Push(StoredLogMessage(message, level, error));
+            continue;
+        }
 
-    using namespace LogMessage;
+        String formattedMessage = logLevelPrefixes[level];
+        formattedMessage += ": ";
+        formattedMessage += String(' ', 9 - formattedMessage.Length());
+        formattedMessage += message;
 
-    VariantMap& eventData = logInstance->GetEventDataMap();
-    eventData[P_MESSAGE] = formattedMessage;
-    eventData[P_LEVEL] = level;
-    logInstance->SendEvent(E_LOGMESSAGE, eventData);
+        if (timeStamp_)
+            formattedMessage = "[" + GetTimeStamp(time) + "] " + formattedMessage;
 
-    logInstance->inWrite_ = false;
-}
+#if defined(__ANDROID__)
+        int androidLevel = ANDROID_LOG_VERBOSE + level;
+        __android_log_print(androidLevel, "Urho3D", "%s", message.CString());
+#elif defined(IOS) || defined(TVOS)
+        SDL_IOS_LogMessage(message.CString());
+#else
+        if (quiet_)
+        {
+            // If in quiet mode, still print the error message to the standard error stream
+            if (level == LOG_ERROR)
+                PrintUnicodeLine(formattedMessage, true);
+        }
+        else
+            PrintUnicodeLine(formattedMessage, level == LOG_ERROR);
+#endif
 
-void Log::WriteRaw(const String& message, bool error)
-{
-    // If not in the main thread, store message for later processing
-    if (!Thread::IsMainThread())
-    {
-        if (logInstance)
+        if (logFile_)
         {
-            MutexLock lock(logInstance->logMutex_);
-            logInstance->threadMessages_.Push(StoredLogMessage(message, LOG_RAW, error));
+            fileBuffer_ += formattedMessage;
+            fileBuffer_ += "\r\n";
         }
 
-        return;
+        processedMessages_.Push(StoredLogMessage(formattedMessage, level, false));
     }
 
-    // Prevent recursion during log event
-    if (!logInstance || logInstance->inWrite_)
-        return;
-
-    logInstance->lastMessage_ = message;
-
-#if defined(__ANDROID__)
-    if (logInstance->quiet_)
+    // Write the whole batch to the log file at once
+    if (!fileBuffer_.Empty())
     {
-        if (error)
-            __android_log_print(ANDROID_LOG_ERROR, "Urho3D", "%s", message.CString());
+        if (logFile_)
+        {
+            logFile_->Write(fileBuffer_.CString(), fileBuffer_.Length());
+            logFile_->Flush();
+        }
+        fileBuffer_.Clear();
     }
-    else
-        __android_log_print(error ? ANDROID_LOG_ERROR : ANDROID_LOG_INFO, "Urho3D", "%s", message.CString());
-#elif defined(IOS) || defined(TVOS)
-    SDL_IOS_LogMessage(message.CString());
-#else
-    if (logInstance->quiet_)
+
+    if (!processedMessages_.Empty())
     {
-        // If in quiet mode, still print the error message to the standard error stream
-        if (error)
-            PrintUnicode(message, true);
+        MutexLock eventLock(eventMutex_);
+        for (StoredLogMessage& stored : processedMessages_)
+        {
+            if (pendingEvents_.Size() >= LOG_MAX_PENDING_EVENTS)
+                break;
+            pendingEvents_.Push(stored);
+        }
+        processedMessages_.Clear();
     }
-    else
-        PrintUnicode(message, error);
-#endif
+}
+
+void Log::FormatRecord(const LogRecord& record, String& message)
+{
+    const char* text = record.GetText();
+    message.Clear();
 
-    if (logInstance->logFile_)
+    if (!record.format_)
     {
-        logInstance->logFile_->Write(message.CString(), message.Length());
-        logInstance->logFile_->Flush();
+        message.Append(text, record.messageLength_);
+        return;
     }
 
-    logInstance->inWrite_ = true;
+    unsigned pos = 0, lastPos = 0, argumentIndex = 0;
+    unsigned length = record.messageLength_;
 
-    using namespace LogMessage;
+    while (true)
+    {
+        // Scan the format string and find %a argument where a is one of d, f, s ...
+        while (pos < length && text[pos] != '%') pos++;
+        message.Append(text + lastPos, pos - lastPos);
+        if (pos >= length)
+            return;
+
+        char format = pos + 1 < length ? text[pos + 1] : '\0';
+        pos += 2;
+        lastPos = pos;
+
+        if (format == '%')
+        {
+            message.Append('%');
+            continue;
+        }
+
+        // Missing arguments are formatted as empty
+        if (argumentIndex >= record.numArguments_)
+            continue;
+
+        const LogArgument& argument = record.arguments_[argumentIndex++];
+        char buf[CONVERSION_BUFFER_LENGTH];
 
-    VariantMap& eventData = logInstance->GetEventDataMap();
-    eventData[P_MESSAGE] = message;
-    eventData[P_LEVEL] = error ? LOG_ERROR : LOG_INFO;
-    logInstance->SendEvent(E_LOGMESSAGE, eventData);
+        switch (format)
+        {
+        // Integer
+        case 'd':
+        case 'i':
+            message.Append(String((int)GetIntegerArgument(argument)));
+            break;
+
+        // Unsigned
+        case 'u':
+            message.Append(String((unsigned)GetIntegerArgument(argument)));
+            break;
+
+        // Unsigned long
+        case 'l':
+            message.Append(String((unsigned long)GetIntegerArgument(argument)));
+            break;
+
+        // Real
+        case 'f':
+            message.Append(String(argument.type_ == LOGARG_DOUBLE ? argument.double_ : (double)GetIntegerArgument(argument)));
+            break;
+
+        // Character
+        case 'c':
+            message.Append((char)GetIntegerArgument(argument));
+            break;
+
+        // C string
+        case 's':
+            if (argument.type_ == LOGARG_STRING)
+                message.Append(text + argument.offset_, argument.length_);
+            else
+                message.Append(String(GetIntegerArgument(argument)));
+            break;
+
+        // Hex
+        case 'x':
+            {
+                int arglen = ::sprintf(buf, "%x", (unsigned)GetIntegerArgument(argument));
+                message.Append(buf, (unsigned)arglen);
+                break;
+            }
+
+        // Pointer
+        case 'p':
+            {
+                int arglen = ::sprintf(buf, "%p", reinterpret_cast<void*>((uintptr_t)GetIntegerArgument(argument)));
+                message.Append(buf, (unsigned)arglen);
+                break;
+            }
+
+        default:
+            URHO3D_LOGWARNINGF("Unsupported format specifier: '%c'", format);
+            break;
+        }
+    }
+}
+
+const String& Log::GetTimeStamp(time_t time)
+{
+    if (time != timeStampTime_ || timeStampString_.Empty())
+    {
+        char dateTime[20];
+        tm timeInfo;
+#ifdef _WIN32
+        localtime_s(&timeInfo, &time);
+#else
+        localtime_r(&time, &timeInfo);
+#endif
+        strftime(dateTime, sizeof(dateTime), "%Y-%m-%d %H:%M:%S", &timeInfo);
+        timeStampString_ = dateTime;
+        timeStampTime_ = time;
+    }
 
-    logInstance->inWrite_ = false;
+    return timeStampString_;
 }
 
 void Log::HandleEndFrame(StringHash eventType, VariantMap& eventData)
@@ -282,20 +673,34 @@ void Log::HandleEndFrame(StringHash eventType, VariantMap& eventData)
         return;
     }
 
-    MutexLock lock(logMutex_);
+    // Without the writer thread the records are processed here
+    if (!writerThread_)
+        ProcessRecords();
 
-    // Process messages accumulated from other threads (if any)
-    while (!threadMessages_.Empty())
     {
-        const StoredLogMessage& stored = threadMessages_.Front();
+        MutexLock lock(eventMutex_);
+        sendingEvents_.Swap(pendingEvents_);
+    }
 
-        if (stored.level_ != LOG_RAW)
-            Write(stored.level_, stored.message_);
-        else
-            WriteRaw(stored.message_, stored.error_);
+    using namespace LogMessage;
+
+    inWrite_ = true;
 
-        threadMessages_.PopFront();
+    for (const StoredLogMessage& stored : sendingEvents_)
+    {
+        URHO3D_PROFILE_MESSAGE(stored.message_.CString(), stored.message_.Length());
+
+        lastMessage_ = stored.message_;
+
+        VariantMap& logEventData = GetEventDataMap();
+        logEventData[P_MESSAGE] = stored.message_;
+        logEventData[P_LEVEL] = stored.level_ != LOG_RAW ? stored.level_ : (stored.error_ ? LOG_ERROR : LOG_INFO);
+        SendEvent(E_LOGMESSAGE, logEventData);
     }
+
+    inWrite_ = false;
+
+    sendingEvents_.Clear();
 }
 
 }
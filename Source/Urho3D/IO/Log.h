@@ -22,11 +22,18 @@
 
 #pragma once
 
+#include "../Container/ArrayPtr.h"
 #include "../Container/List.h"
+#include "../Container/Ptr.h"
 #include "../Core/Mutex.h"
 #include "../Core/Object.h"
 #include "../Core/StringUtils.h"
 
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <type_traits>
+
 namespace Urho3D
 {
 
@@ -51,8 +58,18 @@ enum LogLevel
 };
 
 class File;
+class LogWriterThread;
+
+/// Number of records in the log ring buffer. Must be a power of two.
+static const unsigned LOG_RING_BUFFER_SIZE = 2048;
+/// Maximum number of arguments of a deferred formatted log message.
+static const unsigned LOG_MAX_ARGUMENTS = 16;
+/// Size of the inline text buffer of a log record. Longer messages are stored in a dynamically allocated string.
+static const unsigned LOG_RECORD_TEXT_SIZE = 256;
+/// Maximum number of log message events buffered between frames.
+static const unsigned LOG_MAX_PENDING_EVENTS = 4096;
 
-/// Stored log message from another thread.
+/// Formatted log message waiting to be sent as an event on the main thread.
 struct StoredLogMessage
 {
     /// Construct undefined.
@@ -74,7 +91,120 @@ struct StoredLogMessage
     bool error_{};
 };
 
-/// Logging subsystem.
+/// Type of a log message argument captured for deferred formatting.
+enum LogArgumentType
+{
+    LOGARG_INT = 0,
+    LOGARG_UNSIGNED,
+    LOGARG_DOUBLE,
+    LOGARG_POINTER,
+    LOGARG_STRING,
+};
+
+/// Log message argument captured for deferred formatting.
+struct LogArgument
+{
+    /// Argument type.
+    LogArgumentType type_;
+    /// Argument value.
+    union
+    {
+        /// Signed integer value.
+        long long int_;
+        /// Unsigned integer value.
+        unsigned long long unsigned_;
+        /// Floating point value.
+        double double_;
+        /// Pointer value.
+        const void* pointer_;
+        /// Offset of string value in the record text.
+        unsigned offset_;
+    };
+    /// Length of string value.
+    unsigned length_;
+};
+
+/// Log record stored in the log ring buffer. The message is formatted on the log writer thread.
+struct URHO3D_API LogRecord
+{
+    /// Clear text and arguments.
+    void Clear();
+    /// Append text and return its offset.
+    unsigned AppendText(const char* text, unsigned length);
+    /// Return record text.
+    const char* GetText() const { return longText_.Empty() ? text_ : longText_.CString(); }
+
+    /// Capture an integer or enum argument.
+    template <class T> typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type AddArgument(T value)
+    {
+        LogArgument& argument = arguments_[numArguments_++];
+        if (std::is_signed<typename std::conditional<std::is_enum<T>::value, int, T>::type>::value)
+        {
+            argument.type_ = LOGARG_INT;
+            argument.int_ = (long long)value;
+        }
+        else
+        {
+            argument.type_ = LOGARG_UNSIGNED;
+            argument.unsigned_ = (unsigned long long)value;
+        }
+    }
+    /// Capture a floating point argument.
+    template <class T> typename std::enable_if<std::is_floating_point<T>::value>::type AddArgument(T value)
+    {
+        LogArgument& argument = arguments_[numArguments_++];
+        argument.type_ = LOGARG_DOUBLE;
+        argument.double_ = value;
+    }
+    /// Capture a pointer argument.
+    template <class T> void AddArgument(const T* value)
+    {
+        LogArgument& argument = arguments_[numArguments_++];
+        argument.type_ = LOGARG_POINTER;
+        argument.pointer_ = value;
+    }
+    /// Capture a C string argument. The string is copied to the record.
+    void AddArgument(const char* value);
+    /// Capture a string argument. The string is copied to the record.
+    void AddArgument(const String& value);
+
+    /// Capture a variable number of arguments.
+    void AddArguments() { }
+    /// Capture a variable number of arguments.
+    template <class T, class... Args> void AddArguments(const T& value, const Args&... args)
+    {
+        AddArgument(value);
+        AddArguments(args...);
+    }
+
+    /// Sequence number used for synchronizing producers and the consumer.
+    std::atomic<unsigned> sequence_;
+    /// Message level.
+    LogLevel level_{};
+    /// Error flag for raw messages.
+    bool error_{};
+    /// Whether text is a format string of captured arguments.
+    bool format_{};
+    /// Length of message or format string at the beginning of the text.
+    unsigned messageLength_{};
+    /// Length of the used text.
+    unsigned textLength_{};
+    /// Number of captured arguments.
+    unsigned numArguments_{};
+    /// Time when the message was logged.
+    time_t time_{};
+    /// Captured arguments.
+    LogArgument arguments_[LOG_MAX_ARGUMENTS];
+    /// Inline text buffer.
+    char text_[LOG_RECORD_TEXT_SIZE];
+    /// Text storage when the inline buffer is too small.
+    String longText_;
+};
+
+/// Logging subsystem. Messages may be written from any thread. They are put to a lock-free ring buffer and formatted
+/// and written out by a dedicated writer thread, which sleeps until records are published. E_LOGMESSAGE events are sent
+/// on the main thread at the end of frame, also for messages written from the main thread, so subscribers no longer
+/// receive the event before the logging call returns.
 class URHO3D_API Log : public Object
 {
     URHO3D_OBJECT(Log, Object);
@@ -89,12 +219,16 @@ public:
     void Open(const String& fileName);
     /// Close the log file.
     void Close();
+    /// Write out all pending log records. Blocks until done.
+    void Flush();
     /// Set logging level.
     void SetLevel(LogLevel level);
     /// Set whether to timestamp log messages.
     void SetTimeStamp(bool enable);
     /// Set quiet mode ie. only print error entries to standard error stream (which is normally redirected to console also). Output to log file is not affected by this mode.
     void SetQuiet(bool quiet);
+    /// Set maximum number of messages of specified level written per second. Excess messages are dropped. Zero disables the limit.
+    void SetRateLimit(LogLevel level, unsigned messagesPerSecond);
 
     /// Return logging level.
     LogLevel GetLevel() const { return level_; }
@@ -102,39 +236,110 @@ public:
     /// Return whether log messages are timestamped.
     bool GetTimeStamp() const { return timeStamp_; }
 
-    /// Return last log message.
+    /// Return last log message sent as an event.
     String GetLastMessage() const { return lastMessage_; }
 
     /// Return whether log is in quiet mode (only errors printed to standard error stream).
     bool IsQuiet() const { return quiet_; }
 
+    /// Return maximum number of messages of specified level written per second, or zero if unlimited.
+    unsigned GetRateLimit(LogLevel level) const;
+    /// Return number of messages of specified level dropped because of the rate limit.
+    unsigned GetNumRateLimited(LogLevel level) const;
+    /// Return number of messages dropped because the ring buffer was full.
+    unsigned GetNumOverflowed() const { return numOverflowed_; }
+
+    /// Write out all pending log records of the log instance, if it exists. Blocks until done. Called when exiting the process.
+    static void FlushPending();
     /// Write to the log. If logging level is higher than the level of the message, the message is ignored.
     static void Write(LogLevel level, const String& message);
     /// Write raw output to the log.
     static void WriteRaw(const String& message, bool error = false);
+    /// Write formatted message to the log. Arguments are captured and formatted on the log writer thread, see String::AppendWithFormat() for supported format specifiers.
+    template <class... Args> static void WriteFormat(LogLevel level, const char* format, const Args&... args)
+    {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGUMENTS, "Too many log message arguments");
+
+        LogRecord* record = BeginRecord(level, false);
+        if (!record)
+            return;
+
+        record->format_ = true;
+        record->AppendText(format, (unsigned)strlen(format));
+        record->messageLength_ = record->textLength_;
+        record->AddArguments(args...);
+        EndRecord(record);
+    }
     /// Return instance of opened log file.
     const File* GetLogFile() const { return logFile_; }
 
 private:
-    /// Handle end of frame. Process the threaded log messages.
+    /// Rate limiting state of a log level.
+    struct RateLimit
+    {
+        /// Maximum number of messages per second.
+        std::atomic<unsigned> messagesPerSecond_{};
+        /// Second of the current counting window.
+        std::atomic<unsigned> window_{};
+        /// Number of messages in the current window.
+        std::atomic<unsigned> count_{};
+        /// Number of dropped messages.
+        std::atomic<unsigned> numDropped_{};
+    };
+
+    /// Claim a record in the ring buffer. Return null if the message is filtered out, rate limited or the buffer is full.
+    static LogRecord* BeginRecord(LogLevel level, bool error);
+    /// Publish a record claimed by BeginRecord() and wake up the writer thread. Error records are written out immediately, so that they are not lost if the process exits.
+    static void EndRecord(LogRecord* record);
+    /// Format and write out records published so far. Called on the log writer thread, or on the main thread when threading is not available.
+    void ProcessRecords();
+    /// Format message of a record.
+    static void FormatRecord(const LogRecord& record, String& message);
+    /// Return timestamp string of specified time.
+    const String& GetTimeStamp(time_t time);
+    /// Handle end of frame. Send log message events.
     void HandleEndFrame(StringHash eventType, VariantMap& eventData);
 
-    /// Mutex for threaded operation.
-    Mutex logMutex_;
-    /// Log messages from other threads.
-    List<StoredLogMessage> threadMessages_;
+    /// Ring buffer of log records.
+    SharedArrayPtr<LogRecord> records_;
+    /// Position of the next record to claim.
+    std::atomic<unsigned> enqueuePos_{};
+    /// Position of the next record to process.
+    unsigned dequeuePos_{};
+    /// Mutex serializing record processing and log file access.
+    Mutex processMutex_;
+    /// Formatted messages of the records being processed.
+    Vector<StoredLogMessage> processedMessages_;
+    /// Log file output buffer.
+    String fileBuffer_;
+    /// Time of the cached timestamp.
+    time_t timeStampTime_{};
+    /// Cached timestamp string.
+    String timeStampString_;
+    /// Mutex for pending log message events.
+    Mutex eventMutex_;
+    /// Formatted messages waiting to be sent as events.
+    Vector<StoredLogMessage> pendingEvents_;
+    /// Formatted messages being sent as events.
+    Vector<StoredLogMessage> sendingEvents_;
+    /// Log writer thread.
+    UniquePtr<LogWriterThread> writerThread_;
     /// Log file.
     SharedPtr<File> logFile_;
     /// Last log message.
     String lastMessage_;
+    /// Rate limiting state of each log level.
+    RateLimit rateLimits_[LOG_NONE];
+    /// Number of messages dropped because the ring buffer was full.
+    std::atomic<unsigned> numOverflowed_{};
     /// Logging level.
-    LogLevel level_;
+    std::atomic<LogLevel> level_;
     /// Timestamp log messages flag.
-    bool timeStamp_;
-    /// In write flag to prevent recursion.
-    bool inWrite_;
+    std::atomic<bool> timeStamp_;
+    /// In write flag to prevent recursion. Set by the main thread and read by all logging threads.
+    std::atomic<bool> inWrite_;
     /// Quiet mode flag.
-    bool quiet_;
+    std::atomic<bool> quiet_;
 };
 
 #ifdef URHO3D_LOGGING
@@ -144,12 +349,12 @@ private:
 #define URHO3D_LOGWARNING(message) Urho3D::Log::Write(Urho3D::LOG_WARNING, message)
 #define URHO3D_LOGERROR(message) Urho3D::Log::Write(Urho3D::LOG_ERROR, message)
 #define URHO3D_LOGRAW(message) Urho3D::Log::WriteRaw(message)
-#define URHO3D_LOGTRACEF(format, ...) Urho3D::Log::Write(Urho3D::LOG_TRACE, Urho3D::ToString(format, ##__VA_ARGS__))
-#define URHO3D_LOGDEBUGF(format, ...) Urho3D::Log::Write(Urho3D::LOG_DEBUG, Urho3D::ToString(format, ##__VA_ARGS__))
-#define URHO3D_LOGINFOF(format, ...) Urho3D::Log::Write(Urho3D::LOG_INFO, Urho3D::ToString(format, ##__VA_ARGS__))
-#define URHO3D_LOGWARNINGF(format, ...) Urho3D::Log::Write(Urho3D::LOG_WARNING, Urho3D::ToString(format, ##__VA_ARGS__))
-#define URHO3D_LOGERRORF(format, ...) Urho3D::Log::Write(Urho3D::LOG_ERROR, Urho3D::ToString(format, ##__VA_ARGS__))
-#define URHO3D_LOGRAWF(format, ...) Urho3D::Log::WriteRaw(Urho3D::ToString(format, ##__VA_ARGS__))
+#define URHO3D_LOGTRACEF(format, ...) Urho3D::Log::WriteFormat(Urho3D::LOG_TRACE, format, ##__VA_ARGS__)
+#define URHO3D_LOGDEBUGF(format, ...) Urho3D::Log::WriteFormat(Urho3D::LOG_DEBUG, format, ##__VA_ARGS__)
+#define URHO3D_LOGINFOF(format, ...) Urho3D::Log::WriteFormat(Urho3D::LOG_INFO, format, ##__VA_ARGS__)
+#define URHO3D_LOGWARNINGF(format, ...) Urho3D::Log::WriteFormat(Urho3D::LOG_WARNING, format, ##__VA_ARGS__)
+#define URHO3D_LOGERRORF(format, ...) Urho3D::Log::WriteFormat(Urho3D::LOG_ERROR, format, ##__VA_ARGS__)
+#define URHO3D_LOGRAWF(format, ...) Urho3D::Log::WriteFormat(Urho3D::LOG_RAW, format, ##__VA_ARGS__)
 #else
 #define URHO3D_LOGTRACE(message) ((void)0)
 #define URHO3D_LOGDEBUG(message) ((void)0)
@@ -0,0 +1,224 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Math/BoundingBox.h"
+#include "../Math/Frustum.h"
+#include "../Math/Sphere.h"
+
+#ifdef URHO3D_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace Urho3D
+{
+
+/// Four axis-aligned bounding boxes stored as structure of arrays, so that they can be tested against a volume at once.
+/// Intersection tests return a bit mask of the boxes that are (partially) inside, bit 0 standing for the first box.
+class BoundingBoxPacket
+{
+public:
+    /// Number of bounding boxes in a packet.
+    static const unsigned SIZE = 4;
+
+    /// Construct with all boxes cleared.
+    BoundingBoxPacket() noexcept
+    {
+        for (unsigned i = 0; i < SIZE; ++i)
+            Clear(i);
+    }
+
+    /// Set bounding box at index.
+    void Define(unsigned index, const BoundingBox& box)
+    {
+        minX_[index] = box.min_.x_;
+        minY_[index] = box.min_.y_;
+        minZ_[index] = box.min_.z_;
+        maxX_[index] = box.max_.x_;
+        maxY_[index] = box.max_.y_;
+        maxZ_[index] = box.max_.z_;
+    }
+
+    /// Copy bounding box at index from another packet.
+    void Define(unsigned index, const BoundingBoxPacket& packet, unsigned packetIndex)
+    {
+        minX_[index] = packet.minX_[packetIndex];
+        minY_[index] = packet.minY_[packetIndex];
+        minZ_[index] = packet.minZ_[packetIndex];
+        maxX_[index] = packet.maxX_[packetIndex];
+        maxY_[index] = packet.maxY_[packetIndex];
+        maxZ_[index] = packet.maxZ_[packetIndex];
+    }
+
+    /// Clear bounding box at index. A cleared box is outside of any volume.
+    void Clear(unsigned index)
+    {
+        // Use a large inverted box instead of an infinite one to avoid producing NaNs in the frustum test
+        minX_[index] = minY_[index] = minZ_[index] = M_LARGE_VALUE;
+        maxX_[index] = maxY_[index] = maxZ_[index] = -M_LARGE_VALUE;
+    }
+
+    /// Return bounding box at index.
+    BoundingBox Get(unsigned index) const
+    {
+        return BoundingBox(Vector3(minX_[index], minY_[index], minZ_[index]), Vector3(maxX_[index], maxY_[index], maxZ_[index]));
+    }
+
+    /// Test if a point is inside the boxes. Return mask of the boxes containing the point.
+    unsigned IsInside(const Vector3& point) const
+    {
+#ifdef URHO3D_SSE
+        __m128 x = _mm_set1_ps(point.x_);
+        __m128 y = _mm_set1_ps(point.y_);
+        __m128 z = _mm_set1_ps(point.z_);
+        __m128 outside = _mm_or_ps(_mm_cmplt_ps(x, _mm_loadu_ps(minX_)), _mm_cmpgt_ps(x, _mm_loadu_ps(maxX_)));
+        outside = _mm_or_ps(outside, _mm_or_ps(_mm_cmplt_ps(y, _mm_loadu_ps(minY_)), _mm_cmpgt_ps(y, _mm_loadu_ps(maxY_))));
+        outside = _mm_or_ps(outside, _mm_or_ps(_mm_cmplt_ps(z, _mm_loadu_ps(minZ_)), _mm_cmpgt_ps(z, _mm_loadu_ps(maxZ_))));
+        return ~(unsigned)_mm_movemask_ps(outside) & ALL_MASK;
+#else
+        unsigned mask = 0;
+        for (unsigned i = 0; i < SIZE; ++i)
+        {
+            if (Get(i).IsInside(point) != OUTSIDE)
+                mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    /// Test if another bounding box is (partially) inside the boxes. Return mask of the boxes intersecting it.
+    unsigned IsInsideFast(const BoundingBox& box) const
+    {
+#ifdef URHO3D_SSE
+        __m128 outside = _mm_or_ps(_mm_cmplt_ps(_mm_set1_ps(box.max_.x_), _mm_loadu_ps(minX_)),
+            _mm_cmpgt_ps(_mm_set1_ps(box.min_.x_), _mm_loadu_ps(maxX_)));
+        outside = _mm_or_ps(outside, _mm_or_ps(_mm_cmplt_ps(_mm_set1_ps(box.max_.y_), _mm_loadu_ps(minY_)),
+            _mm_cmpgt_ps(_mm_set1_ps(box.min_.y_), _mm_loadu_ps(maxY_))));
+        outside = _mm_or_ps(outside, _mm_or_ps(_mm_cmplt_ps(_mm_set1_ps(box.max_.z_), _mm_loadu_ps(minZ_)),
+            _mm_cmpgt_ps(_mm_set1_ps(box.min_.z_), _mm_loadu_ps(maxZ_))));
+        return ~(unsigned)_mm_movemask_ps(outside) & ALL_MASK;
+#else
+        unsigned mask = 0;
+        for (unsigned i = 0; i < SIZE; ++i)
+        {
+            if (Get(i).IsInsideFast(box) != OUTSIDE)
+                mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    /// Test if the boxes are (partially) inside a sphere. Return mask of the boxes intersecting the sphere.
+    unsigned IsInsideFast(const Sphere& sphere) const
+    {
+#ifdef URHO3D_SSE
+        __m128 distSquared = _mm_add_ps(_mm_add_ps(
+            DistanceSquaredToRange(sphere.center_.x_, _mm_loadu_ps(minX_), _mm_loadu_ps(maxX_)),
+            DistanceSquaredToRange(sphere.center_.y_, _mm_loadu_ps(minY_), _mm_loadu_ps(maxY_))),
+            DistanceSquaredToRange(sphere.center_.z_, _mm_loadu_ps(minZ_), _mm_loadu_ps(maxZ_)));
+        __m128 inside = _mm_cmplt_ps(distSquared, _mm_set1_ps(sphere.radius_ * sphere.radius_));
+        return (unsigned)_mm_movemask_ps(inside);
+#else
+        unsigned mask = 0;
+        for (unsigned i = 0; i < SIZE; ++i)
+        {
+            if (sphere.IsInsideFast(Get(i)) != OUTSIDE)
+                mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    /// Test if the boxes are (partially) inside a frustum. Return mask of the boxes intersecting the frustum.
+    unsigned IsInsideFast(const Frustum& frustum) const
+    {
+#ifdef URHO3D_SSE
+        const __m128 half = _mm_set1_ps(0.5f);
+        __m128 minX = _mm_loadu_ps(minX_);
+        __m128 minY = _mm_loadu_ps(minY_);
+        __m128 minZ = _mm_loadu_ps(minZ_);
+        __m128 centerX = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(maxX_), minX), half);
+        __m128 centerY = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(maxY_), minY), half);
+        __m128 centerZ = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(maxZ_), minZ), half);
+        __m128 edgeX = _mm_sub_ps(centerX, minX);
+        __m128 edgeY = _mm_sub_ps(centerY, minY);
+        __m128 edgeZ = _mm_sub_ps(centerZ, minZ);
+        __m128 outside = _mm_setzero_ps();
+
+        // Same operation order as in Frustum::IsInsideFast() to get identical results
+        for (const auto& plane : frustum.planes_)
+        {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.normal_.x_), centerX),
+                _mm_mul_ps(_mm_set1_ps(plane.normal_.y_), centerY)), _mm_mul_ps(_mm_set1_ps(plane.normal_.z_), centerZ)),
+                _mm_set1_ps(plane.d_));
+            __m128 absDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.absNormal_.x_), edgeX),
+                _mm_mul_ps(_mm_set1_ps(plane.absNormal_.y_), edgeY)), _mm_mul_ps(_mm_set1_ps(plane.absNormal_.z_), edgeZ));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, _mm_sub_ps(_mm_setzero_ps(), absDist)));
+        }
+
+        return ~(unsigned)_mm_movemask_ps(outside) & ALL_MASK;
+#else
+        unsigned mask = 0;
+        for (unsigned i = 0; i < SIZE; ++i)
+        {
+            if (frustum.IsInsideFast(Get(i)) != OUTSIDE)
+                mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    /// Minimum X coordinates.
+    float minX_[SIZE];
+    /// Minimum Y coordinates.
+    float minY_[SIZE];
+    /// Minimum Z coordinates.
+    float minZ_[SIZE];
+    /// Maximum X coordinates.
+    float maxX_[SIZE];
+    /// Maximum Y coordinates.
+    float maxY_[SIZE];
+    /// Maximum Z coordinates.
+    float maxZ_[SIZE];
+
+    /// Mask with a bit set for every box.
+    static const unsigned ALL_MASK = (1u << SIZE) - 1;
+
+private:
+#ifdef URHO3D_SSE
+    /// Return squared distance of a coordinate to min-max ranges along one axis, or 0 if inside.
+    static __m128 DistanceSquaredToRange(float value, __m128 min, __m128 max)
+    {
+        __m128 v = _mm_set1_ps(value);
+        __m128 below = _mm_cmplt_ps(v, min);
+        __m128 above = _mm_cmpgt_ps(v, max);
+        // When below the range, distance is measured to the minimum, otherwise to the maximum if above
+        __m128 temp = _mm_or_ps(_mm_and_ps(below, _mm_sub_ps(v, min)),
+            _mm_andnot_ps(below, _mm_and_ps(above, _mm_sub_ps(v, max))));
+        return _mm_mul_ps(temp, temp);
+    }
+#endif
+};
+
+}
@@ -55,6 +55,7 @@ class Serializer;
 class XMLElement;
 
 struct CollisionGeometryData;
+struct SceneSubsystemUpdateEventData;
 
 /// Physics raycast hit.
 struct URHO3D_API PhysicsRaycastResult
@@ -292,7 +293,7 @@ protected:
 
 private:
     /// Handle the scene subsystem update event, step simulation here.
-    void HandleSceneSubsystemUpdate(StringHash eventType, VariantMap& eventData);
+    void HandleSceneSubsystemUpdate(SceneSubsystemUpdateEventData& eventData);
     /// Trigger update before each physics simulation step.
     void PreStep(float timeStep);
     /// Trigger update after each physics simulation step.
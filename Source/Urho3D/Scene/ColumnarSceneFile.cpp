@@ -0,0 +1,1011 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Core/Context.h"
+#include "../Core/Profiler.h"
+#include "../IO/Deserializer.h"
+#include "../IO/Log.h"
+#include "../IO/MemoryBuffer.h"
+#include "../IO/Serializer.h"
+#include "../IO/VectorBuffer.h"
+#include "../Scene/ColumnarSceneFile.h"
+#include "../Scene/Component.h"
+#include "../Scene/Scene.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Columnar scene format version. Files of other versions are rejected.
+static const unsigned COLUMNAR_SCENE_VERSION = 1;
+/// Alignment of file sections, sufficient for in-place access of all fixed-size value types.
+static const unsigned COLUMNAR_SCENE_ALIGNMENT = 8;
+/// Block flag: the block holds nodes.
+static const unsigned BLOCK_NODES = 0x1;
+
+// Fixed-size values are stored in their in-memory representation, which the direct attribute setters access in place
+static_assert(sizeof(Vector3) == 12 && sizeof(Quaternion) == 16 && sizeof(Color) == 16 && sizeof(Matrix3x4) == 48,
+    "Unexpected math type size");
+
+/// File header.
+struct ColumnarSceneHeader
+{
+    /// File ID.
+    char id_[4];
+    /// Format version.
+    unsigned version_;
+    /// Total file size.
+    unsigned fileSize_;
+    /// Number of strings.
+    unsigned numStrings_;
+    /// Offset of the string records.
+    unsigned stringTableOffset_;
+    /// Offset of the null-terminated string characters.
+    unsigned stringDataOffset_;
+    /// Size of the string characters.
+    unsigned stringDataSize_;
+    /// Number of nodes.
+    unsigned numNodes_;
+    /// Offset of the node records.
+    unsigned nodeTableOffset_;
+    /// Number of components.
+    unsigned numComponents_;
+    /// Offset of the component records.
+    unsigned componentTableOffset_;
+    /// Number of attribute blocks.
+    unsigned numBlocks_;
+    /// Offset of the block records.
+    unsigned blockTableOffset_;
+    /// Reserved for future use.
+    unsigned reserved_[3];
+};
+
+/// String record in the file.
+struct ColumnarStringRecord
+{
+    /// Offset from the start of the string characters.
+    unsigned offset_;
+    /// Length without the null terminator.
+    unsigned length_;
+};
+
+/// Attribute block record in the file.
+struct ColumnarBlockRecord
+{
+    /// Node or component type.
+    unsigned type_;
+    /// Block flags.
+    unsigned flags_;
+    /// Number of rows.
+    unsigned numRows_;
+    /// Number of columns.
+    unsigned numColumns_;
+    /// Offset of the column records.
+    unsigned columnTableOffset_;
+    /// Reserved for future use.
+    unsigned reserved_;
+};
+
+/// Attribute column record in the file.
+struct ColumnarColumnRecord
+{
+    /// Attribute name hash.
+    unsigned name_;
+    /// Value type.
+    unsigned type_;
+    /// Offset of the values.
+    unsigned dataOffset_;
+    /// Size of the values.
+    unsigned dataSize_;
+};
+
+/// Attribute block being saved.
+struct ColumnarSaveBlock
+{
+    /// Node or component type.
+    StringHash type_;
+    /// Whether the block holds nodes.
+    bool nodes_;
+    /// Objects in row order.
+    PODVector<const Serializable*> objects_;
+};
+
+/// Return the stored size of a fixed-size value type, or 0 if the values are variable-size. Strings are stored as string table indices and resource references as a type and a string table index.
+static unsigned GetElementSize(VariantType type)
+{
+    switch (type)
+    {
+    case VAR_BOOL:
+        return 1;
+
+    case VAR_INT:
+    case VAR_FLOAT:
+    case VAR_STRING:
+        return 4;
+
+    case VAR_INT64:
+    case VAR_DOUBLE:
+    case VAR_VECTOR2:
+    case VAR_INTVECTOR2:
+    case VAR_RESOURCEREF:
+        return 8;
+
+    case VAR_VECTOR3:
+    case VAR_INTVECTOR3:
+        return 12;
+
+    case VAR_VECTOR4:
+    case VAR_QUATERNION:
+    case VAR_COLOR:
+    case VAR_RECT:
+    case VAR_INTRECT:
+        return 16;
+
+    case VAR_MATRIX3:
+        return 36;
+
+    case VAR_MATRIX3X4:
+        return 48;
+
+    case VAR_MATRIX4:
+        return 64;
+
+    default:
+        return 0;
+    }
+}
+
+/// Write zero bytes until the position is aligned.
+static void AlignBuffer(VectorBuffer& dest)
+{
+    while (dest.GetPosition() % COLUMNAR_SCENE_ALIGNMENT)
+        dest.WriteUByte(0);
+}
+
+/// Return whether a table of records lies within the file data. Calculated in 64 bits, so that corrupt counts can not wrap around.
+static bool IsInRange(unsigned long long offset, unsigned long long count, unsigned long long recordSize, unsigned long long size)
+{
+    return offset + count * recordSize <= size;
+}
+
+/// Return index of a file-serialized attribute by name hash and type, or M_MAX_UNSIGNED if not found.
+static unsigned FindAttribute(const Vector<AttributeInfo>* attributes, StringHash name, VariantType type)
+{
+    if (!attributes)
+        return M_MAX_UNSIGNED;
+
+    for (unsigned i = 0; i < attributes->Size(); ++i)
+    {
+        const AttributeInfo& attr = attributes->At(i);
+        if ((attr.mode_ & AM_FILE) && attr.type_ == type && StringHash(attr.name_) == name)
+            return i;
+    }
+
+    return M_MAX_UNSIGNED;
+}
+
+ColumnarSceneFile::ColumnarSceneFile(Context* context) :
+    context_(context),
+    data_(nullptr),
+    size_(0),
+    nodes_(nullptr),
+    numNodes_(0),
+    components_(nullptr),
+    numComponents_(0),
+    numObjects_(0)
+{
+}
+
+ColumnarSceneFile::~ColumnarSceneFile() = default;
+
+bool ColumnarSceneFile::Save(const Node* root, Serializer& dest)
+{
+    if (!root)
+        return false;
+
+    URHO3D_PROFILE("SaveColumnarScene");
+
+    // Collect the persistent nodes breadth-first, so that parents precede their children. The root gets a block of its
+    // own, as it may be loaded into a node of another type
+    PODVector<const Node*> nodes;
+    PODVector<NodeRecord> nodeRecords;
+    PODVector<ComponentRecord> componentRecords;
+    Vector<ColumnarSaveBlock> blocks;
+    HashMap<StringHash, unsigned> nodeBlocks;
+    HashMap<StringHash, unsigned> componentBlocks;
+
+    blocks.Resize(1);
+    blocks[0].type_ = root->GetType();
+    blocks[0].nodes_ = true;
+    nodes.Push(root);
+
+    for (unsigned i = 0; i < nodes.Size(); ++i)
+    {
+        const Node* node = nodes[i];
+        NodeRecord record;
+        record.id_ = node->GetID();
+        record.parent_ = M_MAX_UNSIGNED;
+        record.block_ = 0;
+        if (i)
+        {
+            HashMap<StringHash, unsigned>::Iterator j = nodeBlocks.Find(node->GetType());
+            if (j == nodeBlocks.End())
+            {
+                j = nodeBlocks.Insert(MakePair(node->GetType(), blocks.Size()));
+                blocks.Resize(blocks.Size() + 1);
+                blocks.Back().type_ = node->GetType();
+                blocks.Back().nodes_ = true;
+            }
+            record.block_ = j->second_;
+        }
+        record.row_ = blocks[record.block_].objects_.Size();
+        blocks[record.block_].objects_.Push(node);
+        record.firstComponent_ = componentRecords.Size();
+
+        const Vector<SharedPtr<Component> >& components = node->GetComponents();
+        for (unsigned j = 0; j < components.Size(); ++j)
+        {
+            const Component* component = components[j];
+            if (component->IsTemporary())
+                continue;
+
+            HashMap<StringHash, unsigned>::Iterator k = componentBlocks.Find(component->GetType());
+            if (k == componentBlocks.End())
+            {
+                k = componentBlocks.Insert(MakePair(component->GetType(), blocks.Size()));
+                blocks.Resize(blocks.Size() + 1);
+                blocks.Back().type_ = component->GetType();
+                blocks.Back().nodes_ = false;
+            }
+
+            ComponentRecord componentRecord;
+            componentRecord.id_ = component->GetID();
+            componentRecord.block_ = k->second_;
+            componentRecord.row_ = blocks[k->second_].objects_.Size();
+            blocks[k->second_].objects_.Push(component);
+            componentRecords.Push(componentRecord);
+        }
+
+        record.numComponents_ = componentRecords.Size() - record.firstComponent_;
+        nodeRecords.Push(record);
+
+        const Vector<SharedPtr<Node> >& children = node->GetChildren();
+        for (unsigned j = 0; j < children.Size(); ++j)
+        {
+            if (!children[j]->IsTemporary())
+                nodes.Push(children[j]);
+        }
+    }
+
+    // Parent indices are known once all nodes have been collected
+    HashMap<const Node*, unsigned> nodeIndices;
+    for (unsigned i = 0; i < nodes.Size(); ++i)
+        nodeIndices[nodes[i]] = i;
+    for (unsigned i = 1; i < nodes.Size(); ++i)
+        nodeRecords[i].parent_ = nodeIndices[nodes[i]->GetParent()];
+
+    // Encode the attribute columns. Strings are collected to the string table on the way
+    Vector<String> strings;
+    HashMap<String, unsigned> stringIndices;
+    Vector<PODVector<ColumnarColumnRecord> > columnRecords(blocks.Size());
+    Vector<VectorBuffer> columnData;
+    Variant value;
+
+    for (unsigned i = 0; i < blocks.Size(); ++i)
+    {
+        const ColumnarSaveBlock& block = blocks[i];
+        const Vector<AttributeInfo>* attributes = block.objects_[0]->GetAttributes();
+        if (!attributes)
+            continue;
+
+        for (unsigned j = 0; j < attributes->Size(); ++j)
+        {
+            const AttributeInfo& attr = attributes->At(j);
+            if (!(attr.mode_ & AM_FILE) || (attr.mode_ & AM_FILEREADONLY) == AM_FILEREADONLY)
+                continue;
+
+            ColumnarColumnRecord column;
+            column.name_ = StringHash(attr.name_).Value();
+            column.type_ = attr.type_;
+            columnRecords[i].Push(column);
+            columnData.Resize(columnData.Size() + 1);
+            VectorBuffer& data = columnData.Back();
+
+            for (unsigned k = 0; k < block.objects_.Size(); ++k)
+            {
+                block.objects_[k]->OnGetAttribute(attr, value);
+                // Keep the column layout intact if an accessor returns a value of an unexpected type
+                if (value.GetType() != attr.type_)
+                    value.FromString(attr.type_, String::EMPTY);
+
+                if (attr.type_ == VAR_STRING || attr.type_ == VAR_RESOURCEREF)
+                {
+                    const String& str = attr.type_ == VAR_STRING ? value.GetString() : value.GetResourceRef().name_;
+                    HashMap<String, unsigned>::Iterator l = stringIndices.Find(str);
+                    if (l == stringIndices.End())
+                    {
+                        l = stringIndices.Insert(MakePair(str, strings.Size()));
+                        strings.Push(str);
+                    }
+                    if (attr.type_ == VAR_RESOURCEREF)
+                        data.WriteStringHash(value.GetResourceRef().type_);
+                    data.WriteUInt(l->second_);
+                }
+                else
+                    data.WriteVariantData(value);
+            }
+        }
+    }
+
+    // Lay out the file: header, string table, node and component tables, column data, column tables and block table
+    VectorBuffer out;
+    ColumnarSceneHeader header;
+    memset(&header, 0, sizeof header);
+    memcpy(header.id_, "UCSN", 4);
+    header.version_ = COLUMNAR_SCENE_VERSION;
+    out.Write(&header, sizeof header);
+
+    AlignBuffer(out);
+    header.numStrings_ = strings.Size();
+    header.stringTableOffset_ = out.GetPosition();
+    unsigned stringOffset = 0;
+    for (unsigned i = 0; i < strings.Size(); ++i)
+    {
+        ColumnarStringRecord record;
+        record.offset_ = stringOffset;
+        record.length_ = strings[i].Length();
+        out.Write(&record, sizeof record);
+        stringOffset += strings[i].Length() + 1;
+    }
+    header.stringDataOffset_ = out.GetPosition();
+    header.stringDataSize_ = stringOffset;
+    for (unsigned i = 0; i < strings.Size(); ++i)
+        out.Write(strings[i].CString(), strings[i].Length() + 1);
+
+    AlignBuffer(out);
+    header.numNodes_ = nodeRecords.Size();
+    header.nodeTableOffset_ = out.GetPosition();
+    out.Write(nodeRecords.Buffer(), nodeRecords.Size() * sizeof(NodeRecord));
+
+    AlignBuffer(out);
+    header.numComponents_ = componentRecords.Size();
+    header.componentTableOffset_ = out.GetPosition();
+    out.Write(componentRecords.Buffer(), componentRecords.Size() * sizeof(ComponentRecord));
+
+    unsigned dataIndex = 0;
+    for (unsigned i = 0; i < blocks.Size(); ++i)
+    {
+        for (unsigned j = 0; j < columnRecords[i].Size(); ++j)
+        {
+            const VectorBuffer& data = columnData[dataIndex++];
+            AlignBuffer(out);
+            columnRecords[i][j].dataOffset_ = out.GetPosition();
+            columnRecords[i][j].dataSize_ = data.GetSize();
+            out.Write(data.GetData(), data.GetSize());
+        }
+    }
+
+    PODVector<ColumnarBlockRecord> blockRecords(blocks.Size());
+    for (unsigned i = 0; i < blocks.Size(); ++i)
+    {
+        AlignBuffer(out);
+        ColumnarBlockRecord& record = blockRecords[i];
+        record.type_ = blocks[i].type_.Value();
+        record.flags_ = blocks[i].nodes_ ? BLOCK_NODES : 0;
+        record.numRows_ = blocks[i].objects_.Size();
+        record.numColumns_ = columnRecords[i].Size();
+        record.columnTableOffset_ = out.GetPosition();
+        record.reserved_ = 0;
+        out.Write(columnRecords[i].Buffer(), columnRecords[i].Size() * sizeof(ColumnarColumnRecord));
+    }
+
+    AlignBuffer(out);
+    header.numBlocks_ = blockRecords.Size();
+    header.blockTableOffset_ = out.GetPosition();
+    out.Write(blockRecords.Buffer(), blockRecords.Size() * sizeof(ColumnarBlockRecord));
+
+    header.fileSize_ = out.GetSize();
+    out.Seek(0);
+    out.Write(&header, sizeof header);
+
+    return dest.Write(out.GetData(), out.GetSize()) == out.GetSize();
+}
+
+bool ColumnarSceneFile::Open(const void* data, unsigned size)
+{
+    Close();
+
+    if (!data)
+        return false;
+
+    // Fixed-size values are accessed in place, so copy the data if it is not sufficiently aligned
+    if (reinterpret_cast<size_t>(data) % COLUMNAR_SCENE_ALIGNMENT)
+    {
+        buffer_.Resize(size);
+        memcpy(buffer_.Buffer(), data, size);
+        data = buffer_.Buffer();
+    }
+
+    data_ = static_cast<const unsigned char*>(data);
+    size_ = size;
+    return Parse();
+}
+
+bool ColumnarSceneFile::Read(Deserializer& source)
+{
+    Close();
+
+    unsigned size = source.GetSize() - source.GetPosition();
+    buffer_.Resize(size);
+    if (source.Read(buffer_.Buffer(), size) != size)
+    {
+        URHO3D_LOGERROR("Could not read columnar scene data from " + source.GetName());
+        Close();
+        return false;
+    }
+
+    data_ = buffer_.Buffer();
+    size_ = size;
+    return Parse();
+}
+
+void ColumnarSceneFile::Close()
+{
+    buffer_.Clear();
+    data_ = nullptr;
+    size_ = 0;
+    nodes_ = nullptr;
+    numNodes_ = 0;
+    components_ = nullptr;
+    numComponents_ = 0;
+    blocks_.Clear();
+    strings_.Clear();
+    numObjects_ = 0;
+    nodeIndices_.Clear();
+    componentIndices_.Clear();
+}
+
+bool ColumnarSceneFile::Parse()
+{
+    ColumnarSceneHeader header;
+    if (size_ < sizeof header)
+    {
+        URHO3D_LOGERROR("Columnar scene data is truncated");
+        Close();
+        return false;
+    }
+
+    memcpy(&header, data_, sizeof header);
+    if (memcmp(header.id_, "UCSN", 4) != 0 || header.version_ != COLUMNAR_SCENE_VERSION)
+    {
+        URHO3D_LOGERROR("Not a columnar scene file or unsupported version");
+        Close();
+        return false;
+    }
+
+    if (header.fileSize_ > size_ || !header.numNodes_ ||
+        !IsInRange(header.stringTableOffset_, header.numStrings_, sizeof(ColumnarStringRecord), header.fileSize_) ||
+        !IsInRange(header.stringDataOffset_, header.stringDataSize_, 1, header.fileSize_) ||
+        !IsInRange(header.nodeTableOffset_, header.numNodes_, sizeof(NodeRecord), header.fileSize_) ||
+        !IsInRange(header.componentTableOffset_, header.numComponents_, sizeof(ComponentRecord), header.fileSize_) ||
+        !IsInRange(header.blockTableOffset_, header.numBlocks_, sizeof(ColumnarBlockRecord), header.fileSize_) ||
+        (header.nodeTableOffset_ | header.componentTableOffset_ | header.blockTableOffset_ |
+            header.stringTableOffset_) % sizeof(unsigned))
+    {
+        URHO3D_LOGERROR("Columnar scene data is corrupt");
+        Close();
+        return false;
+    }
+
+    // Build the string table once, so that instantiation can pass the strings to the attribute setters directly
+    const auto* stringRecords = reinterpret_cast<const ColumnarStringRecord*>(data_ + header.stringTableOffset_);
+    const auto* stringData = reinterpret_cast<const char*>(data_ + header.stringDataOffset_);
+    strings_.Resize(header.numStrings_);
+    for (unsigned i = 0; i < header.numStrings_; ++i)
+    {
+        const ColumnarStringRecord& record = stringRecords[i];
+        if (!IsInRange(record.offset_, (unsigned long long)record.length_ + 1, 1, header.stringDataSize_))
+        {
+            URHO3D_LOGERROR("Columnar scene string table is corrupt");
+            Close();
+            return false;
+        }
+        strings_[i] = String(stringData + record.offset_, record.length_);
+    }
+
+    const auto* blockRecords = reinterpret_cast<const ColumnarBlockRecord*>(data_ + header.blockTableOffset_);
+    blocks_.Resize(header.numBlocks_);
+    numObjects_ = 0;
+    bool hasIDColumns = false;
+    for (unsigned i = 0; i < header.numBlocks_; ++i)
+    {
+        const ColumnarBlockRecord& record = blockRecords[i];
+        Block& block = blocks_[i];
+        block.type_ = StringHash(record.type_);
+        block.nodes_ = (record.flags_ & BLOCK_NODES) != 0;
+        block.numRows_ = record.numRows_;
+        block.firstObject_ = numObjects_;
+
+        // Every row is one node or component, so the rows can not outnumber the records. This also bounds the objects
+        // allocated below, as the record tables have been checked to lie within the file
+        if ((unsigned long long)numObjects_ + record.numRows_ > (unsigned long long)header.numNodes_ + header.numComponents_ ||
+            !IsInRange(record.columnTableOffset_, record.numColumns_, sizeof(ColumnarColumnRecord), header.fileSize_) ||
+            record.columnTableOffset_ % sizeof(unsigned))
+        {
+            URHO3D_LOGERROR("Columnar scene block table is corrupt");
+            Close();
+            return false;
+        }
+        numObjects_ += record.numRows_;
+
+        // Columns are matched to the attributes by name and type, so that attributes added, removed or reordered after
+        // saving do not invalidate the file
+        const Vector<AttributeInfo>* attributes = context_->GetAttributes(block.type_);
+        const auto* columnRecords = reinterpret_cast<const ColumnarColumnRecord*>(data_ + record.columnTableOffset_);
+        block.columns_.Resize(record.numColumns_);
+        for (unsigned j = 0; j < record.numColumns_; ++j)
+        {
+            const ColumnarColumnRecord& columnRecord = columnRecords[j];
+            Column& column = block.columns_[j];
+            column.name_ = StringHash(columnRecord.name_);
+            column.type_ = (VariantType)columnRecord.type_;
+            column.data_ = data_ + columnRecord.dataOffset_;
+            column.size_ = columnRecord.dataSize_;
+            column.elementSize_ = GetElementSize(column.type_);
+            column.attributeIndex_ = FindAttribute(attributes, column.name_, column.type_);
+            if (column.attributeIndex_ != M_MAX_UNSIGNED &&
+                (attributes->At(column.attributeIndex_).mode_ & (AM_NODEID | AM_COMPONENTID | AM_NODEIDVECTOR)))
+                hasIDColumns = true;
+
+            bool valid = columnRecord.type_ < MAX_VAR_TYPES &&
+                IsInRange(columnRecord.dataOffset_, columnRecord.dataSize_, 1, header.fileSize_) &&
+                IsInRange(columnRecord.dataOffset_, block.numRows_, column.elementSize_,
+                    (unsigned long long)columnRecord.dataOffset_ + columnRecord.dataSize_) &&
+                columnRecord.dataOffset_ % COLUMNAR_SCENE_ALIGNMENT == 0;
+
+            // String table references are checked here, so that they need no checks during instantiation
+            if (valid && (column.type_ == VAR_STRING || column.type_ == VAR_RESOURCEREF))
+            {
+                const auto* indices = reinterpret_cast<const unsigned*>(column.data_);
+                unsigned stride = column.elementSize_ / sizeof(unsigned);
+                for (unsigned k = 0; k < block.numRows_ && valid; ++k)
+                    valid = indices[k * stride + stride - 1] < header.numStrings_;
+            }
+
+            if (!valid)
+            {
+                URHO3D_LOGERROR("Columnar scene column table is corrupt");
+                Close();
+                return false;
+            }
+        }
+    }
+
+    // Check the node and component tables, so that every object is created exactly once and parents precede children
+    nodes_ = reinterpret_cast<const NodeRecord*>(data_ + header.nodeTableOffset_);
+    numNodes_ = header.numNodes_;
+    components_ = reinterpret_cast<const ComponentRecord*>(data_ + header.componentTableOffset_);
+    numComponents_ = header.numComponents_;
+
+    PODVector<bool> used(numObjects_);
+    for (unsigned i = 0; i < numObjects_; ++i)
+        used[i] = false;
+
+    bool valid = nodes_[0].parent_ == M_MAX_UNSIGNED;
+    unsigned nextComponent = 0;
+    for (unsigned i = 0; i < numNodes_ && valid; ++i)
+    {
+        const NodeRecord& record = nodes_[i];
+        valid = (!i || record.parent_ < i) && record.block_ < blocks_.Size() && blocks_[record.block_].nodes_ &&
+            record.row_ < blocks_[record.block_].numRows_ && !used[blocks_[record.block_].firstObject_ + record.row_] &&
+            record.firstComponent_ == nextComponent && record.numComponents_ <= numComponents_ - nextComponent;
+        if (valid)
+        {
+            used[blocks_[record.block_].firstObject_ + record.row_] = true;
+            nextComponent += record.numComponents_;
+        }
+    }
+    valid = valid && nextComponent == numComponents_;
+    for (unsigned i = 0; i < numComponents_ && valid; ++i)
+    {
+        const ComponentRecord& record = components_[i];
+        valid = record.block_ < blocks_.Size() && !blocks_[record.block_].nodes_ &&
+            record.row_ < blocks_[record.block_].numRows_ && !used[blocks_[record.block_].firstObject_ + record.row_];
+        if (valid)
+            used[blocks_[record.block_].firstObject_ + record.row_] = true;
+    }
+
+    if (!valid)
+    {
+        URHO3D_LOGERROR("Columnar scene node table is corrupt");
+        Close();
+        return false;
+    }
+
+    // ID attributes are remapped through the stored IDs of the nodes and components
+    if (hasIDColumns)
+    {
+        for (unsigned i = 0; i < numNodes_; ++i)
+            nodeIndices_[nodes_[i].id_] = i;
+        for (unsigned i = 0; i < numComponents_; ++i)
+            componentIndices_[components_[i].id_] = i;
+    }
+
+    return true;
+}
+
+bool ColumnarSceneFile::LoadInto(Node* root, bool rewriteIDs, CreateMode mode) const
+{
+    if (!root || !data_)
+        return false;
+
+    URHO3D_PROFILE("LoadColumnarScene");
+
+    // Remove all children and components first in case this is not a fresh load
+    root->RemoveAllChildren();
+    root->RemoveAllComponents();
+
+    PODVector<Serializable*> objects(numObjects_);
+    for (unsigned i = 0; i < numObjects_; ++i)
+        objects[i] = nullptr;
+    PODVector<Node*> nodes(numNodes_);
+
+    // Size the scene's ID maps once instead of growing them while the objects are added
+    Scene* scene = root->GetScene();
+    if (scene)
+    {
+        unsigned numReplicatedNodes = 0;
+        unsigned numReplicatedComponents = 0;
+        if (mode == REPLICATED)
+        {
+            for (unsigned i = 1; i < numNodes_; ++i)
+                numReplicatedNodes += Scene::IsReplicatedID(nodes_[i].id_) ? 1 : 0;
+            for (unsigned i = 0; i < numComponents_; ++i)
+                numReplicatedComponents += Scene::IsReplicatedID(components_[i].id_) ? 1 : 0;
+        }
+        scene->ReserveIDMaps(numReplicatedNodes, numReplicatedComponents, REPLICATED);
+        scene->ReserveIDMaps(numNodes_ - 1 - numReplicatedNodes, numComponents_ - numReplicatedComponents, LOCAL);
+    }
+
+    // Create the node hierarchy. Parents precede their children in the node table
+    for (unsigned i = 0; i < numNodes_; ++i)
+    {
+        const NodeRecord& record = nodes_[i];
+        Node* node = root;
+        if (i)
+        {
+            node = nodes[record.parent_]->CreateChild(rewriteIDs ? 0 : record.id_,
+                (mode == REPLICATED && Scene::IsReplicatedID(record.id_)) ? REPLICATED : LOCAL);
+        }
+
+        nodes[i] = node;
+        objects[blocks_[record.block_].firstObject_ + record.row_] = node;
+    }
+
+    // Apply node attributes before components are added, as components may inspect their node when added
+    ApplyBlocks(true, objects.Buffer(), nodes.Buffer());
+
+    // Construct the components one type at a time
+    Vector<SharedPtr<Component> > created;
+    created.Reserve(numComponents_);
+    for (unsigned i = 0; i < blocks_.Size(); ++i)
+    {
+        const Block& block = blocks_[i];
+        if (block.nodes_)
+            continue;
+
+        for (unsigned j = 0; j < block.numRows_; ++j)
+        {
+            SharedPtr<Component> component = DynamicCast<Component>(context_->CreateObject(block.type_));
+            if (!component)
+            {
+                URHO3D_LOGWARNING("Component type " + block.type_.ToString() + " not known, skipping " +
+                    String(block.numRows_) + " components");
+                break;
+            }
+
+            objects[block.firstObject_ + j] = component;
+            created.Push(component);
+        }
+    }
+
+    // Add the components to their nodes in the stored order
+    for (unsigned i = 0; i < numNodes_; ++i)
+    {
+        const NodeRecord& nodeRecord = nodes_[i];
+        Node* node = nodes[i];
+        for (unsigned j = nodeRecord.firstComponent_; j < nodeRecord.firstComponent_ + nodeRecord.numComponents_; ++j)
+        {
+            const ComponentRecord& record = components_[j];
+            auto* component = static_cast<Component*>(objects[blocks_[record.block_].firstObject_ + record.row_]);
+            if (!component)
+                continue;
+
+            // Do not create replicated components to local nodes, as that may lead to component ID overwrite
+            CreateMode componentMode = (mode == REPLICATED && Scene::IsReplicatedID(record.id_) && node->IsReplicated()) ?
+                REPLICATED : LOCAL;
+            node->AddComponent(component, rewriteIDs ? 0 : record.id_, componentMode);
+        }
+    }
+
+    ApplyBlocks(false, objects.Buffer(), nodes.Buffer());
+    return true;
+}
+
+bool ColumnarSceneFile::Restore(Node* root) const
+{
+    if (!root || !data_)
+        return false;
+
+    URHO3D_PROFILE("RestoreColumnarScene");
+
+    PODVector<Serializable*> objects(numObjects_);
+    for (unsigned i = 0; i < numObjects_; ++i)
+        objects[i] = nullptr;
+    PODVector<Node*> nodes(numNodes_);
+
+    // Match the persistent nodes and components breadth-first against the node table, as they were saved
+    nodes[0] = root;
+    unsigned nextNode = 1;
+    for (unsigned i = 0; i < numNodes_; ++i)
+    {
+        const NodeRecord& record = nodes_[i];
+        Node* node = nodes[i];
+        objects[blocks_[record.block_].firstObject_ + record.row_] = node;
+
+        unsigned nextComponent = record.firstComponent_;
+        const unsigned endComponent = record.firstComponent_ + record.numComponents_;
+        const Vector<SharedPtr<Component> >& components = node->GetComponents();
+        for (unsigned j = 0; j < components.Size(); ++j)
+        {
+            Component* component = components[j];
+            if (component->IsTemporary())
+                continue;
+            if (nextComponent == endComponent || blocks_[components_[nextComponent].block_].type_ != component->GetType())
+                return false;
+
+            const ComponentRecord& componentRecord = components_[nextComponent++];
+            objects[blocks_[componentRecord.block_].firstObject_ + componentRecord.row_] = component;
+        }
+        if (nextComponent != endComponent)
+            return false;
+
+        const Vector<SharedPtr<Node> >& children = node->GetChildren();
+        for (unsigned j = 0; j < children.Size(); ++j)
+        {
+            if (children[j]->IsTemporary())
+                continue;
+            if (nextNode == numNodes_ || nodes_[nextNode].parent_ != i)
+                return false;
+            nodes[nextNode++] = children[j];
+        }
+        if (nextNode < numNodes_ && nodes_[nextNode].parent_ == i)
+            return false;
+    }
+
+    ApplyBlocks(true, objects.Buffer(), nodes.Buffer());
+    ApplyBlocks(false, objects.Buffer(), nodes.Buffer());
+    return true;
+}
+
+void ColumnarSceneFile::GetResourceRefs(Vector<ResourceRef>& dest) const
+{
+    dest.Clear();
+
+    for (unsigned i = 0; i < blocks_.Size(); ++i)
+    {
+        const Block& block = blocks_[i];
+        for (unsigned j = 0; j < block.columns_.Size(); ++j)
+        {
+            const Column& column = block.columns_[j];
+            if (column.type_ == VAR_RESOURCEREF)
+            {
+                const auto* records = reinterpret_cast<const unsigned*>(column.data_);
+                for (unsigned k = 0; k < block.numRows_; ++k)
+                {
+                    ResourceRef ref(StringHash(records[k * 2]), strings_[records[k * 2 + 1]]);
+                    if (!ref.name_.Empty() && !dest.Contains(ref))
+                        dest.Push(ref);
+                }
+            }
+            else if (column.type_ == VAR_RESOURCEREFLIST)
+            {
+                MemoryBuffer buffer(column.data_, column.size_);
+                for (unsigned k = 0; k < block.numRows_; ++k)
+                {
+                    ResourceRefList refs = buffer.ReadResourceRefList();
+                    for (unsigned l = 0; l < refs.names_.Size(); ++l)
+                    {
+                        ResourceRef ref(refs.type_, refs.names_[l]);
+                        if (!ref.name_.Empty() && !dest.Contains(ref))
+                            dest.Push(ref);
+                    }
+                }
+            }
+        }
+    }
+}
+
+unsigned ColumnarSceneFile::GetRootID() const
+{
+    return numNodes_ ? nodes_[0].id_ : 0;
+}
+
+void ColumnarSceneFile::ApplyBlocks(bool nodeBlocks, Serializable* const* objects, Node* const* nodes) const
+{
+    for (unsigned i = 0; i < blocks_.Size(); ++i)
+    {
+        const Block& block = blocks_[i];
+        if (block.nodes_ != nodeBlocks)
+            continue;
+
+        Serializable* const* rows = objects + block.firstObject_;
+        Serializable* first = nullptr;
+        for (unsigned j = 0; j < block.numRows_ && !first; ++j)
+            first = rows[j];
+        if (!first)
+            continue;
+
+        const Vector<AttributeInfo>* attributes = first->GetAttributes();
+        if (!attributes)
+            continue;
+
+        // The root may be loaded into a node of another type, for example a prefab into a scene. Match its columns again
+        bool matchAgain = first->GetType() != block.type_;
+
+        for (unsigned j = 0; j < block.columns_.Size(); ++j)
+        {
+            const Column& column = block.columns_[j];
+            unsigned index = matchAgain ? FindAttribute(attributes, column.name_, column.type_) : column.attributeIndex_;
+            if (index < attributes->Size())
+                ApplyColumn(column, attributes->At(index), rows, block.numRows_, objects, nodes);
+        }
+    }
+}
+
+void ColumnarSceneFile::ApplyColumn(const Column& column, const AttributeInfo& attr, Serializable* const* rows,
+    unsigned numRows, Serializable* const* objects, Node* const* nodes) const
+{
+    const unsigned char* src = column.data_;
+
+    // Node and component IDs refer to the stored objects, so translate them to the IDs of the created objects
+    if ((attr.mode_ & (AM_NODEID | AM_COMPONENTID)) && column.type_ == VAR_INT)
+    {
+        for (unsigned i = 0; i < numRows; ++i)
+        {
+            unsigned id = reinterpret_cast<const unsigned*>(src)[i];
+            int value = (int)((attr.mode_ & AM_NODEID) ? RemapNodeID(id, nodes) : RemapComponentID(id, objects));
+            if (rows[i] && !rows[i]->OnSetAttributeDirect(attr, &value))
+                rows[i]->OnSetAttribute(attr, value);
+        }
+        return;
+    }
+
+    if ((attr.mode_ & AM_NODEIDVECTOR) && column.type_ == VAR_VARIANTVECTOR)
+    {
+        MemoryBuffer buffer(column.data_, column.size_);
+        for (unsigned i = 0; i < numRows; ++i)
+        {
+            // The first element stores the number of IDs redundantly. This is for editing
+            VariantVector value = buffer.ReadVariantVector();
+            for (unsigned j = 1; j < value.Size(); ++j)
+                value[j] = RemapNodeID(value[j].GetUInt(), nodes);
+            if (rows[i] && !rows[i]->OnSetAttributeDirect(attr, &value))
+                rows[i]->OnSetAttribute(attr, value);
+        }
+        return;
+    }
+
+    switch (column.type_)
+    {
+    case VAR_BOOL:
+        for (unsigned i = 0; i < numRows; ++i)
+        {
+            bool value = src[i] != 0;
+            if (rows[i] && !rows[i]->OnSetAttributeDirect(attr, &value))
+                rows[i]->OnSetAttribute(attr, value);
+        }
+        break;
+
+    case VAR_STRING:
+        for (unsigned i = 0; i < numRows; ++i)
+        {
+            const String& value = strings_[reinterpret_cast<const unsigned*>(src)[i]];
+            if (rows[i] && !rows[i]->OnSetAttributeDirect(attr, &value))
+                rows[i]->OnSetAttribute(attr, value);
+        }
+        break;
+
+    case VAR_RESOURCEREF:
+        for (unsigned i = 0; i < numRows; ++i)
+        {
+            const unsigned* record = reinterpret_cast<const unsigned*>(src) + i * 2;
+            ResourceRef value(StringHash(record[0]), strings_[record[1]]);
+            if (rows[i] && !rows[i]->OnSetAttributeDirect(attr, &value))
+                rows[i]->OnSetAttribute(attr, value);
+        }
+        break;
+
+    default:
+        if (column.elementSize_)
+        {
+            // Fixed-size values are passed to the setters in place
+            for (unsigned i = 0; i < numRows; ++i, src += column.elementSize_)
+            {
+                if (rows[i] && !rows[i]->OnSetAttributeDirect(attr, src))
+                {
+                    MemoryBuffer buffer(src, column.elementSize_);
+                    rows[i]->OnSetAttribute(attr, buffer.ReadVariant(column.type_));
+                }
+            }
+        }
+        else
+        {
+            // Variable-size values are stored sequentially in the binary variant format
+            MemoryBuffer buffer(column.data_, column.size_);
+            for (unsigned i = 0; i < numRows; ++i)
+            {
+                Variant value = buffer.ReadVariant(column.type_);
+                if (rows[i])
+                    rows[i]->OnSetAttribute(attr, value);
+            }
+        }
+        break;
+    }
+}
+
+unsigned ColumnarSceneFile::RemapNodeID(unsigned id, Node* const* nodes) const
+{
+    if (!id)
+        return 0;
+
+    HashMap<unsigned, unsigned>::ConstIterator i = nodeIndices_.Find(id);
+    if (i == nodeIndices_.End())
+    {
+        URHO3D_LOGWARNING("Could not resolve node ID " + String(id));
+        return id;
+    }
+
+    return nodes[i->second_]->GetID();
+}
+
+unsigned ColumnarSceneFile::RemapComponentID(unsigned id, Serializable* const* objects) const
+{
+    if (!id)
+        return 0;
+
+    HashMap<unsigned, unsigned>::ConstIterator i = componentIndices_.Find(id);
+    const ComponentRecord* record = i != componentIndices_.End() ? &components_[i->second_] : nullptr;
+    auto* component = record ? static_cast<Component*>(objects[blocks_[record->block_].firstObject_ + record->row_]) : nullptr;
+    if (!component)
+    {
+        URHO3D_LOGWARNING("Could not resolve component ID " + String(id));
+        return id;
+    }
+
+    return component->GetID();
+}
+
+}
@@ -0,0 +1,185 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Container/Str.h"
+#include "../Container/Vector.h"
+#include "../Scene/Node.h"
+
+namespace Urho3D
+{
+
+class Context;
+class Deserializer;
+class Serializable;
+class Serializer;
+
+/// Columnar binary scene format. Attributes are stored in columns grouped by node and component type, strings in a shared table, and all sections are located by file offsets, so that the data can be used in place from memory, for example from a memory-mapped file. Once opened, the same data can be instantiated repeatedly without parsing it again.
+class URHO3D_API ColumnarSceneFile
+{
+public:
+    /// Construct.
+    explicit ColumnarSceneFile(Context* context);
+    /// Destruct.
+    ~ColumnarSceneFile();
+    /// Prevent copy construction.
+    ColumnarSceneFile(const ColumnarSceneFile& rhs) = delete;
+    /// Prevent assignment.
+    ColumnarSceneFile& operator =(const ColumnarSceneFile& rhs) = delete;
+
+    /// Save a node hierarchy, which can be a whole scene. Temporary nodes and components are skipped.
+    static bool Save(const Node* root, Serializer& dest);
+
+    /// Open from memory without copying. The memory must stay valid and unchanged while the file is open. Return true if successful.
+    bool Open(const void* data, unsigned size);
+    /// Read the whole stream into an internal buffer and open it. Return true if successful.
+    bool Read(Deserializer& source);
+    /// Close and release the parsed tables.
+    void Close();
+    /// Create the stored hierarchy under an existing root node, which receives the attributes of the stored root. Nodes are created first, then components are constructed one type at a time, then attributes are applied one column at a time. Node and component ID attributes are remapped to the created objects as they are applied, so no SceneResolver pass is needed. Return true if successful.
+    bool LoadInto(Node* root, bool rewriteIDs = false, CreateMode mode = REPLICATED) const;
+    /// Reset the attributes of a hierarchy previously created with LoadInto() to the stored values without recreating it. Return false and leave the hierarchy unchanged if its nodes or components no longer match the stored structure.
+    bool Restore(Node* root) const;
+    /// Return the resources referenced by resource attributes, without duplicates.
+    void GetResourceRefs(Vector<ResourceRef>& dest) const;
+
+    /// Return whether the file is open.
+    bool IsOpen() const { return data_ != nullptr; }
+    /// Return the file data.
+    const unsigned char* GetData() const { return data_; }
+    /// Return the file data size.
+    unsigned GetSize() const { return size_; }
+    /// Return stored ID of the root node.
+    unsigned GetRootID() const;
+    /// Return number of stored nodes, including the root.
+    unsigned GetNumNodes() const { return numNodes_; }
+    /// Return number of stored components.
+    unsigned GetNumComponents() const { return numComponents_; }
+    /// Return number of attribute blocks.
+    unsigned GetNumBlocks() const { return blocks_.Size(); }
+    /// Return number of strings in the string table.
+    unsigned GetNumStrings() const { return strings_.Size(); }
+
+private:
+    /// Node record in the file.
+    struct NodeRecord
+    {
+        /// Stored node ID.
+        unsigned id_;
+        /// Parent node index, or M_MAX_UNSIGNED for the root.
+        unsigned parent_;
+        /// Attribute block index.
+        unsigned block_;
+        /// Row in the attribute block.
+        unsigned row_;
+        /// Index of the first component.
+        unsigned firstComponent_;
+        /// Number of components.
+        unsigned numComponents_;
+    };
+
+    /// Component record in the file, in node order.
+    struct ComponentRecord
+    {
+        /// Stored component ID.
+        unsigned id_;
+        /// Attribute block index.
+        unsigned block_;
+        /// Row in the attribute block.
+        unsigned row_;
+    };
+
+    /// Parsed attribute column.
+    struct Column
+    {
+        /// Attribute name hash.
+        StringHash name_;
+        /// Stored value type.
+        VariantType type_;
+        /// Value data.
+        const unsigned char* data_;
+        /// Value data size.
+        unsigned size_;
+        /// Element size for fixed-size values, or 0 if values are variable-size.
+        unsigned elementSize_;
+        /// Index of the matching attribute of the block type, or M_MAX_UNSIGNED if none.
+        unsigned attributeIndex_;
+    };
+
+    /// Parsed attribute block.
+    struct Block
+    {
+        /// Node or component type.
+        StringHash type_;
+        /// Whether the block holds nodes.
+        bool nodes_;
+        /// Number of rows.
+        unsigned numRows_;
+        /// Index of the first row in the flattened object list.
+        unsigned firstObject_;
+        /// Attribute columns.
+        PODVector<Column> columns_;
+    };
+
+    /// Parse and validate the tables of the current data. Return true if successful.
+    bool Parse();
+    /// Apply the attribute columns of node or component blocks to the objects in block row order. The nodes are in node table order.
+    void ApplyBlocks(bool nodeBlocks, Serializable* const* objects, Node* const* nodes) const;
+    /// Apply one attribute column to the objects of a block. Null objects are skipped.
+    void ApplyColumn(const Column& column, const AttributeInfo& attr, Serializable* const* rows, unsigned numRows,
+        Serializable* const* objects, Node* const* nodes) const;
+    /// Return the ID of the object that was created for a stored node ID, or the stored ID if not found.
+    unsigned RemapNodeID(unsigned id, Node* const* nodes) const;
+    /// Return the ID of the object that was created for a stored component ID, or the stored ID if not found.
+    unsigned RemapComponentID(unsigned id, Serializable* const* objects) const;
+
+    /// Context.
+    Context* context_;
+    /// Owned data when read from a stream, or when the opened memory was not sufficiently aligned.
+    PODVector<unsigned char> buffer_;
+    /// File data.
+    const unsigned char* data_;
+    /// File data size.
+    unsigned size_;
+    /// Node records.
+    const NodeRecord* nodes_;
+    /// Number of nodes.
+    unsigned numNodes_;
+    /// Component records.
+    const ComponentRecord* components_;
+    /// Number of components.
+    unsigned numComponents_;
+    /// Attribute blocks.
+    Vector<Block> blocks_;
+    /// String table.
+    Vector<String> strings_;
+    /// Total number of rows in all blocks.
+    unsigned numObjects_;
+    /// Node table indices by stored node ID. Only filled if there are ID attributes to remap.
+    HashMap<unsigned, unsigned> nodeIndices_;
+    /// Component table indices by stored component ID. Only filled if there are ID attributes to remap.
+    HashMap<unsigned, unsigned> componentIndices_;
+};
+
+}
@@ -226,7 +226,7 @@ void Component::CleanupConnection(Connection* connection)
 void Component::OnAttributeAnimationAdded()
 {
     if (attributeAnimationInfos_.Size() == 1)
-        SubscribeToEvent(GetScene(), E_ATTRIBUTEANIMATIONUPDATE, URHO3D_HANDLER(Component, HandleAttributeAnimationUpdate));
+        SubscribeToEvent(GetScene(), &Component::HandleAttributeAnimationUpdate);
 }
 
 void Component::OnAttributeAnimationRemoved()
@@ -280,11 +280,9 @@ void Component::GetComponents(PODVector<Component*>& dest, StringHash type) cons
         dest.Clear();
 }
 
-void Component::HandleAttributeAnimationUpdate(StringHash eventType, VariantMap& eventData)
+void Component::HandleAttributeAnimationUpdate(AttributeAnimationUpdateEventData& eventData)
 {
-    using namespace AttributeAnimationUpdate;
-
-    UpdateAttributeAnimations(eventData[P_TIMESTEP].GetFloat());
+    UpdateAttributeAnimations(eventData.timeStep_);
 }
 
 Component* Component::GetFixedUpdateSource()
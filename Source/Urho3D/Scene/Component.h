@@ -30,6 +30,7 @@ namespace Urho3D
 class DebugRenderer;
 class Node;
 class Scene;
+struct AttributeAnimationUpdateEventData;
 
 struct ComponentReplicationState;
 
@@ -126,7 +127,7 @@ protected:
     /// Set scene node. Called by Node when creating the component.
     void SetNode(Node* node);
     /// Handle scene attribute animation update event.
-    void HandleAttributeAnimationUpdate(StringHash eventType, VariantMap& eventData);
+    void HandleAttributeAnimationUpdate(AttributeAnimationUpdateEventData& eventData);
     /// Return a component from the scene root that sends out fixed update events (either PhysicsWorld or PhysicsWorld2D). Return null if neither exists.
     Component* GetFixedUpdateSource();
     /// Perform autoremove. Called by subclasses. Caller should keep a weak pointer to itself to check whether was actually removed, and return immediately without further member operations in that case.
@@ -27,6 +27,7 @@
 #include "../Physics/PhysicsEvents.h"
 #endif
 #include "../Scene/LogicComponent.h"
+#include "../Scene/LogicScheduler.h"
 #include "../Scene/Scene.h"
 #include "../Scene/SceneEvents.h"
 
@@ -37,11 +38,19 @@ LogicComponent::LogicComponent(Context* context) :
     Component(context),
     updateEventMask_(USE_UPDATE | USE_POSTUPDATE | USE_FIXEDUPDATE | USE_FIXEDPOSTUPDATE),
     currentEventMask_(0),
-    delayedStartCalled_(false)
+    delayedStartCalled_(false),
+    parallelUpdate_(false),
+    parallelRegionSize_(0.0f),
+    scheduler_(nullptr),
+    schedulerIndex_(0)
 {
 }
 
-LogicComponent::~LogicComponent() = default;
+LogicComponent::~LogicComponent()
+{
+    if (scheduler_)
+        scheduler_->RemoveComponent(this);
+}
 
 void LogicComponent::OnSetEnabled()
 {
@@ -73,6 +82,45 @@ void LogicComponent::SetUpdateEventMask(UpdateEventFlags mask)
     }
 }
 
+void LogicComponent::SetParallelUpdate(bool enable)
+{
+    if (parallelUpdate_ != enable)
+    {
+        parallelUpdate_ = enable;
+        UpdateEventSubscription();
+    }
+}
+
+void LogicComponent::DeclareComponentAccess(StringHash type, bool write)
+{
+    PODVector<StringHash>& access = write ? writeAccess_ : readAccess_;
+    if (!access.Contains(type))
+    {
+        access.Push(type);
+        if (scheduler_)
+            scheduler_->MarkDirty();
+    }
+}
+
+void LogicComponent::ClearComponentAccess()
+{
+    readAccess_.Clear();
+    writeAccess_.Clear();
+    if (scheduler_)
+        scheduler_->MarkDirty();
+}
+
+void LogicComponent::SetParallelRegionSize(float size)
+{
+    size = Max(size, 0.0f);
+    if (parallelRegionSize_ != size)
+    {
+        parallelRegionSize_ = size;
+        if (scheduler_)
+            scheduler_->MarkDirty();
+    }
+}
+
 void LogicComponent::OnNodeSet(Node* node)
 {
     if (node)
@@ -95,6 +143,8 @@ void LogicComponent::OnSceneSet(Scene* scene)
     {
         UnsubscribeFromEvent(E_SCENEUPDATE);
         UnsubscribeFromEvent(E_SCENEPOSTUPDATE);
+        if (scheduler_)
+            scheduler_->RemoveComponent(this);
 #if defined(URHO3D_PHYSICS) || defined(URHO3D_URHO2D)
         UnsubscribeFromEvent(E_PHYSICSPRESTEP);
         UnsubscribeFromEvent(E_PHYSICSPOSTSTEP);
@@ -111,10 +161,18 @@ void LogicComponent::UpdateEventSubscription()
 
     bool enabled = IsEnabledEffective();
 
-    bool needUpdate = enabled && ((updateEventMask_ & USE_UPDATE) || !delayedStartCalled_);
+    // Parallel components are updated by the logic scheduler instead of the update events
+    bool needScheduler = enabled && parallelUpdate_ && ((updateEventMask_ & (USE_UPDATE | USE_POSTUPDATE)) ||
+        !delayedStartCalled_);
+    if (needScheduler && !scheduler_)
+        scene->GetLogicScheduler()->AddComponent(this);
+    else if (!needScheduler && scheduler_)
+        scheduler_->RemoveComponent(this);
+
+    bool needUpdate = enabled && !parallelUpdate_ && ((updateEventMask_ & USE_UPDATE) || !delayedStartCalled_);
     if (needUpdate && !(currentEventMask_ & USE_UPDATE))
     {
-        SubscribeToEvent(scene, E_SCENEUPDATE, URHO3D_HANDLER(LogicComponent, HandleSceneUpdate));
+        SubscribeToEvent(scene, &LogicComponent::HandleSceneUpdate);
         currentEventMask_ |= USE_UPDATE;
     }
     else if (!needUpdate && (currentEventMask_ & USE_UPDATE))
@@ -123,10 +181,10 @@ void LogicComponent::UpdateEventSubscription()
         currentEventMask_ &= ~USE_UPDATE;
     }
 
-    bool needPostUpdate = enabled && (updateEventMask_ & USE_POSTUPDATE);
+    bool needPostUpdate = enabled && !parallelUpdate_ && (updateEventMask_ & USE_POSTUPDATE);
     if (needPostUpdate && !(currentEventMask_ & USE_POSTUPDATE))
     {
-        SubscribeToEvent(scene, E_SCENEPOSTUPDATE, URHO3D_HANDLER(LogicComponent, HandleScenePostUpdate));
+        SubscribeToEvent(scene, &LogicComponent::HandleScenePostUpdate);
         currentEventMask_ |= USE_POSTUPDATE;
     }
     else if (!needPostUpdate && (currentEventMask_ & USE_POSTUPDATE))
@@ -166,10 +224,8 @@ void LogicComponent::UpdateEventSubscription()
 #endif
 }
 
-void LogicComponent::HandleSceneUpdate(StringHash eventType, VariantMap& eventData)
+void LogicComponent::HandleSceneUpdate(SceneUpdateEventData& eventData)
 {
-    using namespace SceneUpdate;
-
     // Execute user-defined delayed start function before first update
     if (!delayedStartCalled_)
     {
@@ -186,15 +242,13 @@ void LogicComponent::HandleSceneUpdate(StringHash eventType, VariantMap& eventDa
     }
 
     // Then execute user-defined update function
-    Update(eventData[P_TIMESTEP].GetFloat());
+    Update(eventData.timeStep_);
 }
 
-void LogicComponent::HandleScenePostUpdate(StringHash eventType, VariantMap& eventData)
+void LogicComponent::HandleScenePostUpdate(ScenePostUpdateEventData& eventData)
 {
-    using namespace ScenePostUpdate;
-
     // Execute user-defined post-update function
-    PostUpdate(eventData[P_TIMESTEP].GetFloat());
+    PostUpdate(eventData.timeStep_);
 }
 
 #if defined(URHO3D_PHYSICS) || defined(URHO3D_URHO2D)
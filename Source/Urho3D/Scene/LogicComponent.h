@@ -28,6 +28,10 @@
 namespace Urho3D
 {
 
+class LogicScheduler;
+struct SceneUpdateEventData;
+struct ScenePostUpdateEventData;
+
 enum UpdateEvent : unsigned
 {
     /// Bitmask for not using any events.
@@ -47,6 +51,7 @@ URHO3D_FLAGSET(UpdateEvent, UpdateEventFlags);
 class URHO3D_API LogicComponent : public Component
 {
     URHO3D_OBJECT(LogicComponent, Component);
+    friend class LogicScheduler;
 
     /// Construct.
     explicit LogicComponent(Context* context);
@@ -77,9 +82,30 @@ class URHO3D_API LogicComponent : public Component
     /// Set what update events should be subscribed to. Use this for optimization: by default all are in use. Note that this is not an attribute and is not saved or network-serialized, therefore it should always be called eg. in the subclass constructor.
     void SetUpdateEventMask(UpdateEventFlags mask);
 
+    /// Set whether Update() and PostUpdate() run in worker threads, scheduled by the scene's logic scheduler instead of the scene update events. A parallel component may modify its own state and its own node, and must declare access to other components and nodes with DeclareComponentAccess(). Events and structural scene changes must be recorded into the scene command buffer, which is played back in the main thread after the update phase. The world transforms of the components' own nodes and their parents are up to date when the update begins, but a component must not read the nodes of other components of the same stage, as those may be moving. Moving a node that has a RigidBody is not supported; record the transform into the command buffer instead. DelayedStart() and the fixed updates are still called in the main thread.
+    void SetParallelUpdate(bool enable);
+    /// Declare that the parallel update reads or writes components of a type in other nodes. Use Node::GetTypeStatic() for access to other nodes.
+    void DeclareComponentAccess(StringHash type, bool write);
+    /// Clear the declared component access.
+    void ClearComponentAccess();
+    /// Set region size for the parallel update of components that write other components. Components in regions that are not adjacent are updated concurrently, which requires that all access is within half the region size on the XZ plane. Zero (default) updates such components sequentially.
+    void SetParallelRegionSize(float size);
+
     /// Return what update events are subscribed to.
     UpdateEventFlags GetUpdateEventMask() const { return updateEventMask_; }
 
+    /// Return whether the update runs in worker threads.
+    bool GetParallelUpdate() const { return parallelUpdate_; }
+
+    /// Return component types read by the parallel update.
+    const PODVector<StringHash>& GetReadAccess() const { return readAccess_; }
+
+    /// Return component types written by the parallel update.
+    const PODVector<StringHash>& GetWriteAccess() const { return writeAccess_; }
+
+    /// Return region size for the parallel update.
+    float GetParallelRegionSize() const { return parallelRegionSize_; }
+
     /// Return whether the DelayedStart() function has been called.
     bool IsDelayedStartCalled() const { return delayedStartCalled_; }
 
@@ -93,9 +119,9 @@ private:
     /// Subscribe/unsubscribe to update events based on current enabled state and update event mask.
     void UpdateEventSubscription();
     /// Handle scene update event.
-    void HandleSceneUpdate(StringHash eventType, VariantMap& eventData);
+    void HandleSceneUpdate(SceneUpdateEventData& eventData);
     /// Handle scene post-update event.
-    void HandleScenePostUpdate(StringHash eventType, VariantMap& eventData);
+    void HandleScenePostUpdate(ScenePostUpdateEventData& eventData);
 #if defined(URHO3D_PHYSICS) || defined(URHO3D_URHO2D)
     /// Handle physics pre-step event.
     void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
@@ -108,6 +134,18 @@ private:
     UpdateEventFlags currentEventMask_;
     /// Flag for delayed start.
     bool delayedStartCalled_;
+    /// Parallel update flag.
+    bool parallelUpdate_;
+    /// Component types read by the parallel update.
+    PODVector<StringHash> readAccess_;
+    /// Component types written by the parallel update.
+    PODVector<StringHash> writeAccess_;
+    /// Region size for the parallel update.
+    float parallelRegionSize_;
+    /// Logic scheduler the component is registered to.
+    LogicScheduler* scheduler_;
+    /// Index in the logic scheduler.
+    unsigned schedulerIndex_;
 };
 
 }
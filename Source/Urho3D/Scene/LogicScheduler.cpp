@@ -0,0 +1,385 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Container/Sort.h"
+#include "../Core/Profiler.h"
+#include "../Core/WorkQueue.h"
+#include "../Scene/LogicComponent.h"
+#include "../Scene/LogicScheduler.h"
+#include "../Scene/Scene.h"
+#include "../Scene/SceneCommandBuffer.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Number of passes needed to process the 2x2 colored regions.
+static const unsigned NUM_REGION_PASSES = 4;
+
+/// Component of a region group with its region coordinates.
+struct RegionEntry
+{
+    /// Region X coordinate.
+    int x_;
+    /// Region Z coordinate.
+    int z_;
+    /// Index in the group.
+    unsigned index_;
+    /// Region color, which is the pass it is processed in.
+    unsigned color_;
+};
+
+static inline bool CompareRegionEntries(const RegionEntry& lhs, const RegionEntry& rhs)
+{
+    if (lhs.x_ != rhs.x_)
+        return lhs.x_ < rhs.x_;
+    if (lhs.z_ != rhs.z_)
+        return lhs.z_ < rhs.z_;
+    return lhs.index_ < rhs.index_;
+}
+
+static bool Intersects(const PODVector<StringHash>& lhs, const PODVector<StringHash>& rhs)
+{
+    for (unsigned i = 0; i < lhs.Size(); ++i)
+    {
+        if (rhs.Contains(lhs[i]))
+            return true;
+    }
+    return false;
+}
+
+static PODVector<StringHash> SortedTypes(const PODVector<StringHash>& types)
+{
+    PODVector<StringHash> ret(types);
+    Sort(ret.Begin(), ret.End());
+    return ret;
+}
+
+LogicScheduler::LogicScheduler(Scene* scene) :
+    scene_(scene),
+    numStages_(0),
+    dirty_(false)
+{
+}
+
+LogicScheduler::~LogicScheduler()
+{
+    for (unsigned i = 0; i < components_.Size(); ++i)
+        components_[i]->scheduler_ = nullptr;
+}
+
+void LogicScheduler::AddComponent(LogicComponent* component)
+{
+    if (!component || component->scheduler_)
+        return;
+
+    component->scheduler_ = this;
+    component->schedulerIndex_ = components_.Size();
+    components_.Push(component);
+    dirty_ = true;
+}
+
+void LogicScheduler::RemoveComponent(LogicComponent* component)
+{
+    if (!component || component->scheduler_ != this)
+        return;
+
+    // Swap with the last component
+    unsigned index = component->schedulerIndex_;
+    components_[index] = components_.Back();
+    components_[index]->schedulerIndex_ = index;
+    components_.Pop();
+
+    component->scheduler_ = nullptr;
+    dirty_ = true;
+}
+
+void LogicScheduler::Update(float timeStep)
+{
+    // Execute the delayed starts in the main thread first, as they may change the scene structure
+    Vector<WeakPtr<LogicComponent> > starting;
+    for (unsigned i = 0; i < components_.Size(); ++i)
+    {
+        if (!components_[i]->IsDelayedStartCalled())
+            starting.Push(WeakPtr<LogicComponent>(components_[i]));
+    }
+    for (unsigned i = 0; i < starting.Size(); ++i)
+    {
+        LogicComponent* component = starting[i];
+        if (component && !component->delayedStartCalled_)
+        {
+            component->DelayedStart();
+            component->delayedStartCalled_ = true;
+            // Leave the scheduler if no update was needed after all
+            component->UpdateEventSubscription();
+        }
+    }
+
+    RunPhase(timeStep, false);
+}
+
+void LogicScheduler::PostUpdate(float timeStep)
+{
+    RunPhase(timeStep, true);
+}
+
+void LogicScheduler::Rebuild()
+{
+    URHO3D_PROFILE("RebuildLogicGroups");
+
+    groups_.Clear();
+
+    unsigned lastGroup = M_MAX_UNSIGNED;
+    for (unsigned i = 0; i < components_.Size(); ++i)
+    {
+        LogicComponent* component = components_[i];
+        StringHash type = component->GetType();
+        PODVector<StringHash> reads = SortedTypes(component->readAccess_);
+        PODVector<StringHash> writes = SortedTypes(component->writeAccess_);
+        float regionSize = component->parallelRegionSize_;
+
+        // Consecutive components are usually of the same group, so check the previous group first
+        unsigned groupIndex = M_MAX_UNSIGNED;
+        for (unsigned j = 0; j < groups_.Size(); ++j)
+        {
+            unsigned k = lastGroup < groups_.Size() ? (lastGroup + j) % groups_.Size() : j;
+            const Group& group = groups_[k];
+            if (group.type_ == type && group.regionSize_ == regionSize && group.reads_ == reads && group.writes_ == writes)
+            {
+                groupIndex = k;
+                break;
+            }
+        }
+
+        if (groupIndex == M_MAX_UNSIGNED)
+        {
+            groupIndex = groups_.Size();
+            groups_.Resize(groups_.Size() + 1);
+            Group& group = groups_.Back();
+            group.type_ = type;
+            group.reads_ = reads;
+            group.writes_ = writes;
+            group.regionSize_ = regionSize;
+
+            // Components always modify their own state and node. If they also read other components of the same type or
+            // other nodes, or write other components, they can not be processed concurrently without region partitioning
+            bool selfConflict = !writes.Empty() || reads.Contains(type) || reads.Contains(Node::GetTypeStatic());
+            if (!selfConflict)
+                group.mode_ = GROUP_INDEPENDENT;
+            else if (regionSize > 0.0f)
+                group.mode_ = GROUP_REGION;
+            else
+                group.mode_ = GROUP_SERIAL;
+        }
+
+        groups_[groupIndex].components_.Push(component);
+        lastGroup = groupIndex;
+    }
+
+    // Place each group in the first stage after the stages of the earlier groups it conflicts with
+    numStages_ = 0;
+    for (unsigned i = 0; i < groups_.Size(); ++i)
+    {
+        unsigned stage = 0;
+        for (unsigned j = 0; j < i; ++j)
+        {
+            if (groups_[j].stage_ >= stage && Conflicts(groups_[i], groups_[j]))
+                stage = groups_[j].stage_ + 1;
+        }
+        groups_[i].stage_ = stage;
+        numStages_ = Max(numStages_, stage + 1);
+    }
+
+    dirty_ = false;
+}
+
+void LogicScheduler::RunPhase(float timeStep, bool postUpdate)
+{
+    if (dirty_)
+        Rebuild();
+    if (groups_.Empty())
+        return;
+
+    URHO3D_PROFILE("UpdateParallelLogic");
+
+    auto* queue = scene_->GetSubsystem<WorkQueue>();
+    SceneCommandBuffer* commands = scene_->GetCommandBuffer();
+    const unsigned numThreads = queue->GetNumThreads();
+    const UpdateEvent updateFlag = postUpdate ? USE_POSTUPDATE : USE_UPDATE;
+
+    commands->BeginParallel(numThreads);
+
+    // Apply the pending transform changes of the main thread before the worker threads read world transforms
+    scene_->UpdateTransforms();
+    scene_->BeginThreadedUpdate();
+
+    // The processing order gives the command ordering keys, so that the playback order does not depend on the threads
+    order_.Clear();
+    for (unsigned stage = 0; stage < numStages_; ++stage)
+    {
+        for (unsigned pass = 0; pass < NUM_REGION_PASSES; ++pass)
+        {
+            units_.Clear();
+            for (unsigned i = 0; i < groups_.Size(); ++i)
+            {
+                if (groups_[i].stage_ == stage)
+                    AddUnits(groups_[i], pass, updateFlag);
+            }
+            if (units_.Empty())
+                continue;
+
+            // The earlier stages may have moved the parents of the nodes in this one
+            ResolveTransforms();
+
+            queue->ParallelFor(units_.Size(), 1, [&](unsigned begin, unsigned end, unsigned threadIndex)
+            {
+                for (unsigned i = begin; i < end; ++i)
+                {
+                    const Unit& unit = units_[i];
+                    for (unsigned j = unit.begin_; j < unit.end_; ++j)
+                    {
+                        commands->SetOrderKey(threadIndex, j);
+                        if (postUpdate)
+                            order_[j]->PostUpdate(timeStep);
+                        else
+                            order_[j]->Update(timeStep);
+                    }
+                }
+                // Release the thread's lock-free list, as the worker thread may run other jobs next
+                commands->SetOrderKey(threadIndex, M_MAX_UNSIGNED);
+            });
+        }
+    }
+
+    commands->EndParallel();
+
+    scene_->EndThreadedUpdate();
+
+    // Sync point: apply the deferred results in the main thread
+    commands->Playback();
+}
+
+void LogicScheduler::ResolveTransforms()
+{
+    for (unsigned i = 0; i < units_.Size(); ++i)
+    {
+        const Unit& unit = units_[i];
+        for (unsigned j = unit.begin_; j < unit.end_; ++j)
+        {
+            if (Node* node = order_[j]->GetNode())
+                node->GetWorldTransform();
+        }
+    }
+}
+
+void LogicScheduler::AddUnits(const Group& group, unsigned pass, UpdateEvent updateFlag)
+{
+    const PODVector<LogicComponent*>& components = group.components_;
+
+    switch (group.mode_)
+    {
+    case GROUP_INDEPENDENT:
+        if (pass == 0)
+        {
+            for (unsigned i = 0; i < components.Size(); ++i)
+            {
+                if (components[i]->updateEventMask_ & updateFlag)
+                {
+                    units_.Push(Unit{order_.Size(), order_.Size() + 1});
+                    order_.Push(components[i]);
+                }
+            }
+        }
+        break;
+
+    case GROUP_SERIAL:
+        if (pass == 0)
+        {
+            Unit unit{order_.Size(), order_.Size()};
+            for (unsigned i = 0; i < components.Size(); ++i)
+            {
+                if (components[i]->updateEventMask_ & updateFlag)
+                    order_.Push(components[i]);
+            }
+            unit.end_ = order_.Size();
+            if (unit.end_ > unit.begin_)
+                units_.Push(unit);
+        }
+        break;
+
+    case GROUP_REGION:
+        {
+            // Regions of the same color are at least one region apart, so components that access only within half the
+            // region size of themselves can not touch the same objects
+            PODVector<RegionEntry> entries;
+            const float invRegionSize = 1.0f / group.regionSize_;
+            for (unsigned i = 0; i < components.Size(); ++i)
+            {
+                LogicComponent* component = components[i];
+                if (!(component->updateEventMask_ & updateFlag))
+                    continue;
+
+                const Vector3 position = component->GetNode()->GetWorldPosition();
+                RegionEntry entry;
+                entry.x_ = FloorToInt(position.x_ * invRegionSize);
+                entry.z_ = FloorToInt(position.z_ * invRegionSize);
+                entry.index_ = i;
+                entry.color_ = (entry.x_ & 1u) | ((entry.z_ & 1u) << 1u);
+                if (entry.color_ == pass)
+                    entries.Push(entry);
+            }
+
+            Sort(entries.Begin(), entries.End(), CompareRegionEntries);
+
+            for (unsigned i = 0; i < entries.Size();)
+            {
+                Unit unit{order_.Size(), order_.Size()};
+                unsigned j = i;
+                for (; j < entries.Size() && entries[j].x_ == entries[i].x_ && entries[j].z_ == entries[i].z_; ++j)
+                    order_.Push(components[entries[j].index_]);
+                unit.end_ = order_.Size();
+                units_.Push(unit);
+                i = j;
+            }
+        }
+        break;
+    }
+}
+
+bool LogicScheduler::Conflicts(const Group& lhs, const Group& rhs)
+{
+    // Besides the declared writes, both groups write their own components and nodes
+    PODVector<StringHash> lhsWrites(lhs.writes_);
+    lhsWrites.Push(lhs.type_);
+    lhsWrites.Push(Node::GetTypeStatic());
+    PODVector<StringHash> rhsWrites(rhs.writes_);
+    rhsWrites.Push(rhs.type_);
+    rhsWrites.Push(Node::GetTypeStatic());
+
+    return Intersects(lhsWrites, rhs.reads_) || Intersects(rhsWrites, lhs.reads_) || Intersects(lhs.writes_, rhsWrites) ||
+        Intersects(rhs.writes_, lhsWrites);
+}
+
+}
@@ -0,0 +1,130 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Scene/LogicComponent.h"
+
+namespace Urho3D
+{
+
+class Scene;
+
+/// Scheduler for the logic components that have opted into parallel update. The components are grouped by their type and declared component access, and the groups are ordered into stages so that groups in the same stage do not conflict. Each stage is processed with the work queue, and the commands the components recorded into the scene command buffer are played back when the update phase is finished.
+class URHO3D_API LogicScheduler
+{
+public:
+    /// Construct for a scene.
+    explicit LogicScheduler(Scene* scene);
+    /// Destruct. Detach the remaining components.
+    ~LogicScheduler();
+    /// Prevent copy construction.
+    LogicScheduler(const LogicScheduler& rhs) = delete;
+    /// Prevent assignment.
+    LogicScheduler& operator =(const LogicScheduler& rhs) = delete;
+
+    /// Add a component. Called by the component.
+    void AddComponent(LogicComponent* component);
+    /// Remove a component. Called by the component.
+    void RemoveComponent(LogicComponent* component);
+    /// Mark the grouping dirty after a component's access declaration has changed.
+    void MarkDirty() { dirty_ = true; }
+    /// Run the delayed starts and the parallel update of the components. Called by the scene after the scene update event.
+    void Update(float timeStep);
+    /// Run the parallel post-update of the components. Called by the scene after the scene post-update event.
+    void PostUpdate(float timeStep);
+
+    /// Return number of components.
+    unsigned GetNumComponents() const { return components_.Size(); }
+    /// Return number of component groups.
+    unsigned GetNumGroups() const { return groups_.Size(); }
+    /// Return number of stages.
+    unsigned GetNumStages() const { return numStages_; }
+
+private:
+    /// Group processing mode.
+    enum GroupMode
+    {
+        /// Components do not access each other and are all processed concurrently.
+        GROUP_INDEPENDENT = 0,
+        /// Components access each other within a region and are processed concurrently in non-adjacent regions.
+        GROUP_REGION,
+        /// Components access each other and are processed sequentially.
+        GROUP_SERIAL
+    };
+
+    /// Components with the same type and access declaration.
+    struct Group
+    {
+        /// Component type.
+        StringHash type_;
+        /// Sorted read accessed component types.
+        PODVector<StringHash> reads_;
+        /// Sorted write accessed component types.
+        PODVector<StringHash> writes_;
+        /// Region size.
+        float regionSize_;
+        /// Processing mode.
+        GroupMode mode_;
+        /// Stage index.
+        unsigned stage_;
+        /// Components.
+        PODVector<LogicComponent*> components_;
+    };
+
+    /// Range of components that are processed sequentially by one thread.
+    struct Unit
+    {
+        /// Start index in the component order.
+        unsigned begin_;
+        /// End index in the component order.
+        unsigned end_;
+    };
+
+    /// Rebuild the groups and stages.
+    void Rebuild();
+    /// Run one update phase.
+    void RunPhase(float timeStep, bool postUpdate);
+    /// Append the processing units of a group for one pass.
+    void AddUnits(const Group& group, unsigned pass, UpdateEvent updateFlag);
+    /// Update the world transforms of the nodes of the current units and their parents in the main thread. Worker threads then only read them, instead of racing to update shared parents.
+    void ResolveTransforms();
+    /// Return whether two groups may not be processed concurrently.
+    static bool Conflicts(const Group& lhs, const Group& rhs);
+
+    /// Scene.
+    Scene* scene_;
+    /// Components.
+    PODVector<LogicComponent*> components_;
+    /// Component groups.
+    Vector<Group> groups_;
+    /// Component processing order of the current phase.
+    PODVector<LogicComponent*> order_;
+    /// Processing units of the current pass.
+    PODVector<Unit> units_;
+    /// Number of stages.
+    unsigned numStages_;
+    /// Grouping dirty flag.
+    bool dirty_;
+};
+
+}
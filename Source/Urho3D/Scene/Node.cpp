@@ -24,10 +24,12 @@
 
 #include "../Core/Context.h"
 #include "../Core/Profiler.h"
+#include "../Core/Thread.h"
 #include "../IO/Log.h"
 #include "../IO/MemoryBuffer.h"
 #include "../Resource/XMLFile.h"
 #include "../Resource/JSONFile.h"
+#include "../Scene/ColumnarSceneFile.h"
 #include "../Scene/Component.h"
 #include "../Scene/ObjectAnimation.h"
 #include "../Scene/ReplicationState.h"
@@ -54,6 +56,9 @@ Node::Node(Context* context) :
     networkUpdate_(false),
     parent_(nullptr),
     scene_(nullptr),
+    transformStore_(nullptr),
+    transformIndex_(M_MAX_UNSIGNED),
+    transformRevision_(M_MAX_UNSIGNED),
     id_(0),
     position_(Vector3::ZERO),
     rotation_(Quaternion::IDENTITY),
@@ -319,12 +324,16 @@ bool Node::SaveJSON(Serializer& dest, const String& indentation) const
     return json->Save(dest, indentation);
 }
 
+bool Node::SaveColumnar(Serializer& dest) const
+{
+    return ColumnarSceneFile::Save(this, dest);
+}
+
 void Node::SetName(const String& name)
 {
     if (name != impl_->name_)
     {
         impl_->name_ = name;
-        impl_->nameHash_ = name;
 
         MarkNetworkUpdate();
 
@@ -735,6 +744,16 @@ void Node::SetOwner(Connection* owner)
 
 void Node::MarkDirty()
 {
+    // With a transform store, child nodes and listeners are updated later in one batched pass. Changes from worker threads,
+    // for example animation during a threaded update, are still marked recursively. The store is told also when the node
+    // is already dirty, as world transforms read since the previous change are no longer up to date
+    if (transformStore_ && Thread::IsMainThread() && !scene_->IsThreadedUpdate())
+    {
+        dirty_ = true;
+        transformStore_->MarkDirty(this);
+        return;
+    }
+
     Node *cur = this;
     for (;;)
     {
@@ -750,21 +769,7 @@ void Node::MarkDirty()
         cur->dirty_ = true;
 
         // Notify listener components first, then mark child nodes
-        for (Vector<WeakPtr<Component> >::Iterator i = cur->listeners_.Begin(); i != cur->listeners_.End();)
-        {
-            Component *c = *i;
-            if (c)
-            {
-                c->OnMarkedDirty(cur);
-                ++i;
-            }
-            // If listener has expired, erase from list (swap with the last element to avoid O(n^2) behavior)
-            else
-            {
-                *i = cur->listeners_.Back();
-                cur->listeners_.Pop();
-            }
-        }
+        cur->NotifyListeners();
 
         // Tail call optimization: Don't recurse to mark the first child dirty, but
         // instead process it in the context of the current function. If there are more
@@ -836,6 +841,8 @@ void Node::AddChild(Node* node, unsigned index)
         scene_->NodeAdded(node);
 
     node->parent_ = this;
+    if (node->transformStore_)
+        node->transformStore_->MarkHierarchyDirty(node);
     node->MarkDirty();
     node->MarkNetworkUpdate();
     // If the child node has components, also mark network update on them to ensure they have a valid NetworkState
@@ -871,6 +878,56 @@ void Node::RemoveChild(Node* node)
     }
 }
 
+void Node::RemoveChildren(const PODVector<Node*>& nodes)
+{
+    // Keep shared pointers to the removed children until the child vector has been compacted
+    Vector<SharedPtr<Node> > removed;
+    removed.Reserve(nodes.Size());
+
+    for (unsigned i = 0; i < nodes.Size(); ++i)
+    {
+        Node* child = nodes[i];
+        if (!child || child->parent_ != this)
+            continue;
+        removed.Push(SharedPtr<Node>(child));
+
+        // Send change event. Do not send when this node is already being destroyed
+        if (Refs() > 0 && scene_)
+        {
+            using namespace NodeRemoved;
+
+            VariantMap& eventData = GetEventDataMap();
+            eventData[P_SCENE] = scene_;
+            eventData[P_PARENT] = this;
+            eventData[P_NODE] = child;
+
+            scene_->SendEvent(E_NODEREMOVED, eventData);
+        }
+
+        child->parent_ = nullptr;
+        child->MarkDirty();
+        child->MarkNetworkUpdate();
+        if (scene_)
+            scene_->NodeRemoved(child);
+    }
+
+    if (removed.Empty())
+        return;
+
+    // Event handlers may have removed other children meanwhile, so keep the children that still have this node as parent
+    unsigned numKept = 0;
+    for (unsigned i = 0; i < children_.Size(); ++i)
+    {
+        if (children_[i]->parent_ == this)
+        {
+            if (i != numKept)
+                children_[numKept] = children_[i];
+            ++numKept;
+        }
+    }
+    children_.Resize(numKept);
+}
+
 void Node::RemoveAllChildren()
 {
     RemoveChildren(true, true, true);
@@ -1174,7 +1231,7 @@ void Node::RemoveListener(Component* component)
 
 Vector3 Node::GetSignedWorldScale() const
 {
-    if (dirty_)
+    if (NeedsWorldTransformUpdate())
         UpdateWorldTransform();
 
     return worldTransform_.SignedScale(worldRotation_.RotationMatrix());
@@ -1899,7 +1956,7 @@ void Node::SetTransformSilent(const Matrix3x4& matrix)
 void Node::OnAttributeAnimationAdded()
 {
     if (attributeAnimationInfos_.Size() == 1)
-        SubscribeToEvent(GetScene(), E_ATTRIBUTEANIMATIONUPDATE, URHO3D_HANDLER(Node, HandleAttributeAnimationUpdate));
+        SubscribeToEvent(GetScene(), &Node::HandleAttributeAnimationUpdate);
 }
 
 void Node::OnAttributeAnimationRemoved()
@@ -2084,6 +2141,38 @@ Component* Node::SafeCreateComponent(const String& typeName, StringHash type, Cr
 
 void Node::UpdateWorldTransform() const
 {
+    // Pending changes of the transform store set the dirty flag only on the changed nodes, not on their child nodes. Instead
+    // of updating the whole store for one read, calculate through the topmost changed node on the path to the scene. The
+    // store recalculates the same transforms and notifies the listeners at its next update. The calculated nodes record the
+    // store revision, so that reading them again before the next change does not calculate again, and a read below them
+    // starts from them
+    if (transformStore_ && transformStore_->IsDirty())
+    {
+        const unsigned revision = transformStore_->GetRevision();
+        if (transformRevision_ == revision)
+            return;
+
+        const Node* top = nullptr;
+        const Node* calculated = nullptr;
+        bool calculatedBelowTop = false;
+        for (const Node* node = this; node; node = node->parent_)
+        {
+            if (!calculated && node->transformRevision_ == revision)
+                calculated = node;
+            if (node->dirty_)
+            {
+                top = node;
+                calculatedBelowTop = calculated != nullptr;
+            }
+        }
+
+        if (top)
+            CalculateWorldTransform(calculatedBelowTop ? calculated : top->parent_, revision);
+        else
+            transformRevision_ = revision;
+        return;
+    }
+
     Matrix3x4 transform = GetTransform();
 
     // Assume the root node (scene) has identity transform
@@ -2101,6 +2190,46 @@ void Node::UpdateWorldTransform() const
     dirty_ = false;
 }
 
+void Node::CalculateWorldTransform(const Node* upToDate, unsigned revision) const
+{
+    if (parent_ && parent_ != upToDate)
+        parent_->CalculateWorldTransform(upToDate, revision);
+
+    Matrix3x4 transform = GetTransform();
+
+    if (parent_ == scene_ || !parent_)
+    {
+        worldTransform_ = transform;
+        worldRotation_ = rotation_;
+    }
+    else
+    {
+        worldTransform_ = parent_->worldTransform_ * transform;
+        worldRotation_ = parent_->worldRotation_ * rotation_;
+    }
+
+    transformRevision_ = revision;
+}
+
+void Node::NotifyListeners()
+{
+    for (Vector<WeakPtr<Component> >::Iterator i = listeners_.Begin(); i != listeners_.End();)
+    {
+        Component *c = *i;
+        if (c)
+        {
+            c->OnMarkedDirty(this);
+            ++i;
+        }
+        // If listener has expired, erase from list (swap with the last element to avoid O(n^2) behavior)
+        else
+        {
+            *i = listeners_.Back();
+            listeners_.Pop();
+        }
+    }
+}
+
 void Node::RemoveChild(Vector<SharedPtr<Node> >::Iterator i)
 {
     // Keep a shared pointer to the child about to be removed, to make sure the erase from container completes first. Otherwise
@@ -2256,11 +2385,9 @@ void Node::RemoveComponent(Vector<SharedPtr<Component> >::Iterator i)
     components_.Erase(i);
 }
 
-void Node::HandleAttributeAnimationUpdate(StringHash eventType, VariantMap& eventData)
+void Node::HandleAttributeAnimationUpdate(AttributeAnimationUpdateEventData& eventData)
 {
-    using namespace AttributeAnimationUpdate;
-
-    UpdateAttributeAnimations(eventData[P_TIMESTEP].GetFloat());
+    UpdateAttributeAnimations(eventData.timeStep_);
 }
 
 }
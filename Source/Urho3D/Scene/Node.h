@@ -22,9 +22,11 @@
 
 #pragma once
 
+#include "../Container/ConstString.h"
 #include "../IO/VectorBuffer.h"
 #include "../Math/Matrix3x4.h"
 #include "../Scene/Animatable.h"
+#include "../Scene/TransformStore.h"
 
 namespace Urho3D
 {
@@ -34,6 +36,7 @@ class Connection;
 class Node;
 class Scene;
 class SceneResolver;
+struct AttributeAnimationUpdateEventData;
 
 struct NodeReplicationState;
 
@@ -59,12 +62,10 @@ struct URHO3D_API NodeImpl
     PODVector<Node*> dependencyNodes_;
     /// Network owner connection.
     Connection* owner_;
-    /// Name.
-    String name_;
+    /// Name. Interned, as many nodes typically share the same name.
+    ConstString name_;
     /// Tag strings.
     StringVector tags_;
-    /// Name hash.
-    StringHash nameHash_;
     /// Attribute buffer for network updates.
     mutable VectorBuffer attrBuffer_;
 };
@@ -75,6 +76,7 @@ class URHO3D_API Node : public Animatable
     URHO3D_OBJECT(Node, Animatable);
 
     friend class Connection;
+    friend class TransformStore;
 
 public:
     /// Construct.
@@ -111,6 +113,8 @@ public:
     bool SaveXML(Serializer& dest, const String& indentation = "\t") const;
     /// Save to a JSON file. Return true if successful.
     bool SaveJSON(Serializer& dest, const String& indentation = "\t") const;
+    /// Save to the columnar binary format, for example as a prefab. Return true if successful.
+    bool SaveColumnar(Serializer& dest) const;
     /// Set name of the scene node. Names are not required to be unique.
     void SetName(const String& name);
 
@@ -279,7 +283,7 @@ public:
     void SetEnabledRecursive(bool enable);
     /// Set owner connection for networking.
     void SetOwner(Connection* owner);
-    /// Mark node and child nodes to need world transform recalculation. Notify listener components.
+    /// Mark node and child nodes to need world transform recalculation. Notify listener components. With the transform store, a change from the main thread marks only this node, and the listener components of it and its child nodes are notified later by the transform store update.
     void MarkDirty();
     /// Create a child scene node (with specified ID if provided).
     Node* CreateChild(const String& name = String::EMPTY, CreateMode mode = REPLICATED, unsigned id = 0, bool temporary = false);
@@ -293,6 +297,8 @@ public:
     void RemoveAllChildren();
     /// Remove child scene nodes that match criteria.
     void RemoveChildren(bool removeReplicated, bool removeLocal, bool recursive);
+    /// Remove a set of child scene nodes. The child vector is compacted once, which is faster than removing many children one by one. Nodes that are not children of this node are ignored.
+    void RemoveChildren(const PODVector<Node*>& nodes);
     /// Create a component to this node (with specified ID if provided).
     Component* CreateComponent(StringHash type, CreateMode mode = REPLICATED, unsigned id = 0);
     /// Create a component to this node if it does not exist already.
@@ -340,10 +346,10 @@ public:
     bool IsReplicated() const;
 
     /// Return name.
-    const String& GetName() const { return impl_->name_; }
+    const String& GetName() const { return impl_->name_.GetString(); }
 
     /// Return name hash.
-    StringHash GetNameHash() const { return impl_->nameHash_; }
+    StringHash GetNameHash() const { return impl_->name_.GetHash(); }
 
     /// Return all tags.
     const StringVector& GetTags() const { return impl_->tags_; }
@@ -402,7 +408,7 @@ public:
     /// Return position in world space.
     Vector3 GetWorldPosition() const
     {
-        if (dirty_)
+        if (NeedsWorldTransformUpdate())
             UpdateWorldTransform();
 
         return worldTransform_.Translation();
@@ -418,7 +424,7 @@ public:
     /// Return rotation in world space.
     Quaternion GetWorldRotation() const
     {
-        if (dirty_)
+        if (NeedsWorldTransformUpdate())
             UpdateWorldTransform();
 
         return worldRotation_;
@@ -433,7 +439,7 @@ public:
     /// Return direction in world space.
     Vector3 GetWorldDirection() const
     {
-        if (dirty_)
+        if (NeedsWorldTransformUpdate())
             UpdateWorldTransform();
 
         return worldRotation_ * Vector3::FORWARD;
@@ -442,7 +448,7 @@ public:
     /// Return node's up vector in world space.
     Vector3 GetWorldUp() const
     {
-        if (dirty_)
+        if (NeedsWorldTransformUpdate())
             UpdateWorldTransform();
 
         return worldRotation_ * Vector3::UP;
@@ -451,7 +457,7 @@ public:
     /// Return node's right vector in world space.
     Vector3 GetWorldRight() const
     {
-        if (dirty_)
+        if (NeedsWorldTransformUpdate())
             UpdateWorldTransform();
 
         return worldRotation_ * Vector3::RIGHT;
@@ -460,7 +466,7 @@ public:
     /// Return scale in world space.
     Vector3 GetWorldScale() const
     {
-        if (dirty_)
+        if (NeedsWorldTransformUpdate())
             UpdateWorldTransform();
 
         return worldTransform_.Scale();
@@ -479,7 +485,7 @@ public:
     /// Return world space transform matrix.
     const Matrix3x4& GetWorldTransform() const
     {
-        if (dirty_)
+        if (NeedsWorldTransformUpdate())
             UpdateWorldTransform();
 
         return worldTransform_;
@@ -647,6 +653,12 @@ private:
     Component* SafeCreateComponent(const String& typeName, StringHash type, CreateMode mode, unsigned id);
     /// Recalculate the world transform.
     void UpdateWorldTransform() const;
+    /// Calculate the world transform through the parent nodes below a node whose world transform is up to date, leaving their dirty flags for the transform store. Record the transform store revision to the calculated nodes.
+    void CalculateWorldTransform(const Node* upToDate, unsigned revision) const;
+    /// Return whether the world transform must be recalculated before use. With a transform store, pending changes of parent nodes are not reflected in the dirty flag.
+    bool NeedsWorldTransformUpdate() const { return dirty_ || (transformStore_ && transformStore_->IsDirty()); }
+    /// Notify listener components that the node has been marked dirty.
+    void NotifyListeners();
     /// Remove child node by iterator.
     void RemoveChild(Vector<SharedPtr<Node> >::Iterator i);
     /// Return child nodes recursively.
@@ -662,7 +674,7 @@ private:
     /// Remove a component from this node with the specified iterator.
     void RemoveComponent(Vector<SharedPtr<Component> >::Iterator i);
     /// Handle attribute animation update event.
-    void HandleAttributeAnimationUpdate(StringHash eventType, VariantMap& eventData);
+    void HandleAttributeAnimationUpdate(AttributeAnimationUpdateEventData& eventData);
 
     /// World-space transform matrix.
     mutable Matrix3x4 worldTransform_;
@@ -682,6 +694,12 @@ private:
     Node* parent_;
     /// Scene (root node.)
     Scene* scene_;
+    /// Transform store of the scene, or null if not in use.
+    TransformStore* transformStore_;
+    /// Index in the transform store.
+    unsigned transformIndex_;
+    /// Transform store revision at which the world transform was last calculated through pending changes.
+    mutable unsigned transformRevision_;
     /// Unique ID within the scene.
     unsigned id_;
     /// Position.
@@ -0,0 +1,287 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Core/Context.h"
+#include "../Core/Profiler.h"
+#include "../IO/FileSystem.h"
+#include "../IO/Log.h"
+#include "../IO/MemoryBuffer.h"
+#include "../IO/VectorBuffer.h"
+#include "../Resource/JSONFile.h"
+#include "../Resource/ResourceCache.h"
+#include "../Resource/XMLFile.h"
+#include "../Scene/Prefab.h"
+#include "../Scene/Scene.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+Prefab::Prefab(Context* context) :
+    Resource(context),
+    template_(context)
+{
+}
+
+Prefab::~Prefab() = default;
+
+void Prefab::RegisterObject(Context* context)
+{
+    context->RegisterFactory<Prefab>();
+}
+
+bool Prefab::BeginLoad(Deserializer& source)
+{
+    template_.Close();
+    dependencies_.Clear();
+    loadXMLFile_.Reset();
+    loadJSONFile_.Reset();
+    loadBuffer_.Clear();
+
+    unsigned start = source.GetPosition();
+    String fileID = source.ReadFileID();
+    source.Seek(start);
+
+    bool success = false;
+    if (fileID == "UCSN")
+    {
+        success = template_.Read(source);
+
+        // If async loading, request the referenced resources to also be loaded
+        if (success && GetAsyncLoadState() == ASYNC_LOADING)
+        {
+            auto* cache = GetSubsystem<ResourceCache>();
+            Vector<ResourceRef> refs;
+            template_.GetResourceRefs(refs);
+            for (unsigned i = 0; i < refs.Size(); ++i)
+                cache->BackgroundLoadResource(refs[i].type_, refs[i].name_, true, this);
+        }
+    }
+    else
+    {
+        // Other formats are instantiated in the main thread and converted to the template in EndLoad()
+        String extension = GetExtension(source.GetName());
+        if (extension == ".xml")
+        {
+            loadXMLFile_ = new XMLFile(context_);
+            success = loadXMLFile_->Load(source);
+        }
+        else if (extension == ".json")
+        {
+            loadJSONFile_ = new JSONFile(context_);
+            success = loadJSONFile_->Load(source);
+        }
+        else
+        {
+            loadBuffer_.Resize(source.GetSize() - start);
+            success = source.Read(loadBuffer_.Buffer(), loadBuffer_.Size()) == loadBuffer_.Size();
+        }
+    }
+
+    if (!success)
+        URHO3D_LOGERROR("Could not load prefab " + GetName());
+    return success;
+}
+
+bool Prefab::EndLoad()
+{
+    bool success = template_.IsOpen() || CreateTemplate();
+    loadXMLFile_.Reset();
+    loadJSONFile_.Reset();
+    loadBuffer_.Clear();
+
+    if (!success)
+    {
+        URHO3D_LOGERROR("Could not create template of prefab " + GetName());
+        return false;
+    }
+
+    LoadDependencies();
+    return true;
+}
+
+bool Prefab::Save(Serializer& dest) const
+{
+    if (!template_.IsOpen())
+    {
+        URHO3D_LOGERROR("Can not save empty prefab");
+        return false;
+    }
+
+    return dest.Write(template_.GetData(), template_.GetSize()) == template_.GetSize();
+}
+
+bool Prefab::SetNode(const Node* node)
+{
+    VectorBuffer buffer;
+    if (!ColumnarSceneFile::Save(node, buffer))
+        return false;
+
+    MemoryBuffer source(buffer.GetData(), buffer.GetSize());
+    if (!template_.Read(source))
+        return false;
+
+    LoadDependencies();
+    return true;
+}
+
+Node* Prefab::Instantiate(Node* parent, const Vector3& position, const Quaternion& rotation, CreateMode mode) const
+{
+    if (!parent || !template_.IsOpen())
+        return nullptr;
+
+    URHO3D_PROFILE("InstantiatePrefab");
+
+    // Rewrite IDs when instantiating
+    Node* node = parent->CreateChild(0, mode);
+    if (template_.LoadInto(node, true, mode))
+    {
+        node->SetTransform(position, rotation);
+        node->ApplyAttributes();
+        return node;
+    }
+    else
+    {
+        node->Remove();
+        return nullptr;
+    }
+}
+
+bool Prefab::Restore(Node* instance, const Vector3& position, const Quaternion& rotation) const
+{
+    if (!instance || !template_.Restore(instance))
+        return false;
+
+    instance->SetTransform(position, rotation);
+    instance->ApplyAttributes();
+    return true;
+}
+
+bool Prefab::CreateTemplate()
+{
+    // Instantiate the source once into a scene of its own, then save it in the columnar format. The IDs of the
+    // temporary scene decide whether the instances will be replicated
+    SharedPtr<Scene> scene(new Scene(context_));
+    Node* node = nullptr;
+    if (loadXMLFile_)
+        node = scene->InstantiateXML(loadXMLFile_->GetRoot(), Vector3::ZERO, Quaternion::IDENTITY);
+    else if (loadJSONFile_)
+        node = scene->InstantiateJSON(loadJSONFile_->GetRoot(), Vector3::ZERO, Quaternion::IDENTITY);
+    else if (!loadBuffer_.Empty())
+    {
+        MemoryBuffer source(loadBuffer_);
+        node = scene->Instantiate(source, Vector3::ZERO, Quaternion::IDENTITY);
+    }
+
+    return node && SetNode(node);
+}
+
+void Prefab::LoadDependencies()
+{
+    dependencies_.Clear();
+
+    // Keep the referenced resources loaded, so that instantiation only needs to look them up from the cache
+    auto* cache = GetSubsystem<ResourceCache>();
+    if (cache)
+    {
+        Vector<ResourceRef> refs;
+        template_.GetResourceRefs(refs);
+        for (unsigned i = 0; i < refs.Size(); ++i)
+        {
+            Resource* resource = cache->GetResource(refs[i].type_, refs[i].name_);
+            if (resource)
+                dependencies_.Push(SharedPtr<Resource>(resource));
+        }
+    }
+
+    SetMemoryUse(sizeof(Prefab) + template_.GetSize());
+}
+
+PrefabPool::PrefabPool(Prefab* prefab, Node* parent, CreateMode mode) :
+    prefab_(prefab),
+    parent_(parent),
+    mode_(mode)
+{
+}
+
+PrefabPool::~PrefabPool()
+{
+    Clear();
+}
+
+Node* PrefabPool::Spawn(const Vector3& position, const Quaternion& rotation)
+{
+    if (!prefab_ || !parent_)
+        return nullptr;
+
+    while (!free_.Empty())
+    {
+        WeakPtr<Node> instance = free_.Back();
+        free_.Pop();
+
+        // Skip instances that were removed or moved elsewhere while released
+        if (!instance || instance->GetParent() != parent_)
+            continue;
+        // Restoring re-enables the nodes according to the template
+        if (prefab_->Restore(instance, position, rotation))
+            return instance;
+
+        // The instance structure was changed while in use, so replace it
+        instance->Remove();
+    }
+
+    return prefab_->Instantiate(parent_, position, rotation, mode_);
+}
+
+void PrefabPool::Release(Node* instance)
+{
+    if (!instance)
+        return;
+
+    instance->SetDeepEnabled(false);
+    free_.Push(WeakPtr<Node>(instance));
+}
+
+void PrefabPool::Reserve(unsigned count)
+{
+    if (!prefab_ || !parent_)
+        return;
+
+    for (unsigned i = 0; i < count; ++i)
+        Release(prefab_->Instantiate(parent_, Vector3::ZERO, Quaternion::IDENTITY, mode_));
+}
+
+void PrefabPool::Clear()
+{
+    for (unsigned i = 0; i < free_.Size(); ++i)
+    {
+        if (free_[i])
+            free_[i]->Remove();
+    }
+
+    free_.Clear();
+}
+
+}
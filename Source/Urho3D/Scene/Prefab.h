@@ -0,0 +1,124 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Resource/Resource.h"
+#include "../Scene/ColumnarSceneFile.h"
+
+namespace Urho3D
+{
+
+class JSONFile;
+class XMLFile;
+
+/// Prefab resource. The source, which can be a node saved in the XML, JSON, binary or columnar format, is parsed once into a columnar template. Instances are created from the template by copying the attribute values and remapping the node and component IDs, and the resources referenced by the template are kept loaded.
+class URHO3D_API Prefab : public Resource
+{
+    URHO3D_OBJECT(Prefab, Resource);
+
+public:
+    /// Construct.
+    explicit Prefab(Context* context);
+    /// Destruct.
+    ~Prefab() override;
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Load resource from stream. May be called from a worker thread. Return true if successful.
+    bool BeginLoad(Deserializer& source) override;
+    /// Finish resource loading. Always called from the main thread. Return true if successful.
+    bool EndLoad() override;
+    /// Save resource in the columnar format. Return true if successful.
+    bool Save(Serializer& dest) const override;
+
+    /// Set the template from a node hierarchy. Return true if successful.
+    bool SetNode(const Node* node);
+    /// Create an instance as a child of a node, typically the scene. Return the instance root node if successful.
+    Node* Instantiate(Node* parent, const Vector3& position, const Quaternion& rotation, CreateMode mode = REPLICATED) const;
+    /// Reset an instance created from this prefab to the template state and place it, without recreating its nodes and components. Return false if the instance structure has changed.
+    bool Restore(Node* instance, const Vector3& position, const Quaternion& rotation) const;
+
+    /// Return the template.
+    const ColumnarSceneFile& GetTemplate() const { return template_; }
+    /// Return number of resources kept loaded for the instances.
+    unsigned GetNumDependencies() const { return dependencies_.Size(); }
+
+private:
+    /// Create the template from a node loaded from the XML, JSON or binary source. Return true if successful.
+    bool CreateTemplate();
+    /// Load the resources referenced by the template and keep them.
+    void LoadDependencies();
+
+    /// Instantiation template.
+    ColumnarSceneFile template_;
+    /// Resources referenced by the template.
+    Vector<SharedPtr<Resource> > dependencies_;
+    /// XML file used while loading.
+    SharedPtr<XMLFile> loadXMLFile_;
+    /// JSON file used while loading.
+    SharedPtr<JSONFile> loadJSONFile_;
+    /// Binary node data used while loading.
+    PODVector<unsigned char> loadBuffer_;
+};
+
+/// Pool of prefab instances under a parent node. Released instances stay in the scene disabled, and are spawned again by restoring the template attribute values instead of creating new nodes and components.
+class URHO3D_API PrefabPool : public RefCounted
+{
+public:
+    /// Construct.
+    PrefabPool(Prefab* prefab, Node* parent, CreateMode mode = LOCAL);
+    /// Destruct. Remove the released instances.
+    ~PrefabPool() override;
+    /// Prevent copy construction.
+    PrefabPool(const PrefabPool& rhs) = delete;
+    /// Prevent assignment.
+    PrefabPool& operator =(const PrefabPool& rhs) = delete;
+
+    /// Spawn an instance, reusing a released one if available. Return the instance root node.
+    Node* Spawn(const Vector3& position, const Quaternion& rotation);
+    /// Release an instance to be reused. It is disabled, but not removed. An instance must not be released twice.
+    void Release(Node* instance);
+    /// Create released instances in advance.
+    void Reserve(unsigned count);
+    /// Remove the released instances.
+    void Clear();
+
+    /// Return the prefab.
+    Prefab* GetPrefab() const { return prefab_; }
+    /// Return the parent node of the instances.
+    Node* GetParent() const { return parent_; }
+    /// Return number of released instances.
+    unsigned GetNumFree() const { return free_.Size(); }
+
+private:
+    /// Prefab.
+    SharedPtr<Prefab> prefab_;
+    /// Parent node of the instances.
+    WeakPtr<Node> parent_;
+    /// Creation mode of the instances.
+    CreateMode mode_;
+    /// Released instances.
+    Vector<WeakPtr<Node> > free_;
+};
+
+}
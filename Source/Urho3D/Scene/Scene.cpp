@@ -34,10 +34,14 @@
 #include "../Resource/XMLFile.h"
 #include "../Resource/JSONFile.h"
 #include "../Scene/CameraViewport.h"
+#include "../Scene/ColumnarSceneFile.h"
 #include "../Scene/Component.h"
+#include "../Scene/LogicScheduler.h"
 #include "../Scene/ObjectAnimation.h"
+#include "../Scene/Prefab.h"
 #include "../Scene/ReplicationState.h"
 #include "../Scene/Scene.h"
+#include "../Scene/SceneCommandBuffer.h"
 #include "../Scene/SceneEvents.h"
 #include "../Scene/SceneManager.h"
 #include "../Scene/SceneMetadata.h"
@@ -72,25 +76,32 @@ Scene::Scene(Context* context) :
     snapThreshold_(DEFAULT_SNAP_THRESHOLD),
     updateEnabled_(true),
     asyncLoading_(false),
-    threadedUpdate_(false)
+    threadedUpdate_(false),
+    commandBuffer_(new SceneCommandBuffer(this))
 {
     // Assign an ID to self so that nodes can refer to this node as a parent
     SetID(GetFreeNodeID(REPLICATED));
     NodeAdded(this);
 
-    SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(Scene, HandleUpdate));
+    SubscribeToEvent(&Scene::HandleUpdate);
     SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, URHO3D_HANDLER(Scene, HandleResourceBackgroundLoaded));
 }
 
 Scene::~Scene()
 {
+    // Detach the nodes from the transform store, so that the removals below do not need to update it
+    transforms_.Reset();
+    // Detach the parallel logic components and discard the deferred commands
+    logicScheduler_.Reset();
+    commandBuffer_.Reset();
+
     // Remove root-level components first, so that scene subsystems such as the octree destroy themselves. This will speed up
     // the removal of child nodes' components
     RemoveAllComponents();
     RemoveAllChildren();
 
     // Remove scene reference and owner from all nodes that still exist
-    for (HashMap<unsigned, Node*>::Iterator i = replicatedNodes_.Begin(); i != replicatedNodes_.End(); ++i)
+    for (FlatHashMap<unsigned, Node*>::Iterator i = replicatedNodes_.Begin(); i != replicatedNodes_.End(); ++i)
         i->second_->ResetScene();
     for (HashMap<unsigned, Node*>::Iterator i = localNodes_.Begin(); i != localNodes_.End(); ++i)
         i->second_->ResetScene();
@@ -213,7 +224,7 @@ void Scene::AddReplicationState(NodeReplicationState* state)
     Node::AddReplicationState(state);
 
     // This is the first update for a new connection. Mark all replicated nodes dirty
-    for (HashMap<unsigned, Node*>::ConstIterator i = replicatedNodes_.Begin(); i != replicatedNodes_.End(); ++i)
+    for (FlatHashMap<unsigned, Node*>::ConstIterator i = replicatedNodes_.Begin(); i != replicatedNodes_.End(); ++i)
         state->sceneState_->dirtyNodes_.Insert(i->first_);
 }
 
@@ -309,6 +320,62 @@ bool Scene::SaveJSON(Serializer& dest, const String& indentation) const
         return false;
 }
 
+bool Scene::LoadColumnar(Deserializer& source)
+{
+    URHO3D_PROFILE("LoadSceneColumnar");
+
+    StopAsyncLoading();
+
+    ColumnarSceneFile file(context_);
+    if (!file.Read(source))
+    {
+        URHO3D_LOGERROR(source.GetName() + " is not a valid columnar scene file");
+        return false;
+    }
+
+    URHO3D_LOGINFO("Loading scene from " + source.GetName());
+
+    if (LoadColumnar(file))
+    {
+        FinishLoading(&source);
+        return true;
+    }
+    else
+        return false;
+}
+
+bool Scene::LoadColumnar(const ColumnarSceneFile& source)
+{
+    StopAsyncLoading();
+
+    Clear();
+
+    if (source.LoadInto(this))
+    {
+        ApplyAttributes();
+        return true;
+    }
+    else
+        return false;
+}
+
+bool Scene::SaveColumnar(Serializer& dest) const
+{
+    URHO3D_PROFILE("SaveSceneColumnar");
+
+    auto* ptr = dynamic_cast<Deserializer*>(&dest);
+    if (ptr)
+        URHO3D_LOGINFO("Saving scene to " + ptr->GetName());
+
+    if (ColumnarSceneFile::Save(this, dest))
+    {
+        FinishSaving(&dest);
+        return true;
+    }
+    else
+        return false;
+}
+
 bool Scene::LoadAsync(File* file, LoadMode mode)
 {
     if (!file)
@@ -615,6 +682,35 @@ Node* Scene::InstantiateJSON(Deserializer& source, const Vector3& position, cons
     return InstantiateJSON(json->GetRoot(), position, rotation, mode);
 }
 
+Node* Scene::InstantiateColumnar(Deserializer& source, const Vector3& position, const Quaternion& rotation, CreateMode mode)
+{
+    ColumnarSceneFile file(context_);
+    if (!file.Read(source))
+        return nullptr;
+
+    return InstantiateColumnar(file, position, rotation, mode);
+}
+
+Node* Scene::InstantiateColumnar(const ColumnarSceneFile& source, const Vector3& position, const Quaternion& rotation,
+    CreateMode mode)
+{
+    URHO3D_PROFILE("InstantiateColumnar");
+
+    // Rewrite IDs when instantiating
+    Node* node = CreateChild(0, mode);
+    if (source.LoadInto(node, true, mode))
+    {
+        node->SetTransform(position, rotation);
+        node->ApplyAttributes();
+        return node;
+    }
+    else
+    {
+        node->Remove();
+        return nullptr;
+    }
+}
+
 void Scene::Clear(bool clearReplicated, bool clearLocal)
 {
     StopAsyncLoading();
@@ -672,6 +768,34 @@ void Scene::SetAsyncLoadingMs(int ms)
     asyncLoadingMs_ = Max(ms, 1);
 }
 
+void Scene::SetTransformStoreEnabled(bool enable)
+{
+    if (enable == transforms_.NotNull())
+        return;
+
+    if (enable)
+        transforms_ = new TransformStore(this);
+    else
+    {
+        // Apply the pending changes before returning to recursive dirty marking
+        transforms_->Update();
+        transforms_.Reset();
+    }
+}
+
+LogicScheduler* Scene::GetLogicScheduler()
+{
+    if (!logicScheduler_)
+        logicScheduler_ = new LogicScheduler(this);
+    return logicScheduler_.Get();
+}
+
+void Scene::UpdateTransforms()
+{
+    if (transforms_)
+        transforms_->Update();
+}
+
 void Scene::SetElapsedTime(float time)
 {
     elapsedTime_ = time;
@@ -710,7 +834,7 @@ Node* Scene::GetNode(unsigned id) const
 {
     if (IsReplicatedID(id))
     {
-        HashMap<unsigned, Node*>::ConstIterator i = replicatedNodes_.Find(id);
+        FlatHashMap<unsigned, Node*>::ConstIterator i = replicatedNodes_.Find(id);
         return i != replicatedNodes_.End() ? i->second_ : nullptr;
     }
     else
@@ -774,20 +898,30 @@ void Scene::Update(float timeStep)
 
     timeStep *= timeScale_;
 
-    using namespace SceneUpdate;
-
-    VariantMap& eventData = GetEventDataMap();
-    eventData[P_SCENE] = this;
-    eventData[P_TIMESTEP] = timeStep;
-
     // Update variable timestep logic
-    SendEvent(E_SCENEUPDATE, eventData);
+    SceneUpdateEventData updateData;
+    updateData.scene_ = this;
+    updateData.timeStep_ = timeStep;
+    SendEvent(updateData);
+
+    // Update parallel logic components
+    if (logicScheduler_)
+        logicScheduler_->Update(timeStep);
 
     // Update scene attribute animation.
-    SendEvent(E_ATTRIBUTEANIMATIONUPDATE, eventData);
+    AttributeAnimationUpdateEventData animationUpdateData;
+    animationUpdateData.scene_ = this;
+    animationUpdateData.timeStep_ = timeStep;
+    SendEvent(animationUpdateData);
+
+    // Apply the transform changes of the logic update, so that the subsystems see them
+    UpdateTransforms();
 
     // Update scene subsystems. If a physics world is present, it will be updated, triggering fixed timestep logic updates
-    SendEvent(E_SCENESUBSYSTEMUPDATE, eventData);
+    SceneSubsystemUpdateEventData subsystemUpdateData;
+    subsystemUpdateData.scene_ = this;
+    subsystemUpdateData.timeStep_ = timeStep;
+    SendEvent(subsystemUpdateData);
 
     // Update transform smoothing
     {
@@ -804,7 +938,16 @@ void Scene::Update(float timeStep)
     }
 
     // Post-update variable timestep logic
-    SendEvent(E_SCENEPOSTUPDATE, eventData);
+    ScenePostUpdateEventData postUpdateData;
+    postUpdateData.scene_ = this;
+    postUpdateData.timeStep_ = timeStep;
+    SendEvent(postUpdateData);
+    if (logicScheduler_)
+        logicScheduler_->PostUpdate(timeStep);
+
+    // Apply the commands deferred outside the parallel logic update
+    commandBuffer_->Playback();
+    UpdateTransforms();
 
     // Note: using a float for elapsed time accumulation is inherently inaccurate. The purpose of this value is
     // primarily to update material animation effects, as it is available to shaders. It can be reset by calling
@@ -874,6 +1017,33 @@ unsigned Scene::GetFreeNodeID(CreateMode mode)
     }
 }
 
+template <class T> static void ReserveIDMap(HashMap<unsigned, T*>& map, unsigned size)
+{
+    unsigned numBuckets = Max(map.NumBuckets(), HashBase::MIN_BUCKETS);
+    while (numBuckets * HashBase::MAX_LOAD_FACTOR < size)
+        numBuckets <<= 1u;
+    if (numBuckets > map.NumBuckets())
+        map.Rehash(numBuckets);
+}
+
+void Scene::ReserveIDMaps(unsigned numNodes, unsigned numComponents, CreateMode mode)
+{
+    if (mode == REPLICATED)
+    {
+        if (numNodes)
+            replicatedNodes_.Reserve(replicatedNodes_.Size() + numNodes);
+        if (numComponents)
+            ReserveIDMap(replicatedComponents_, replicatedComponents_.Size() + numComponents);
+    }
+    else
+    {
+        if (numNodes)
+            ReserveIDMap(localNodes_, localNodes_.Size() + numNodes);
+        if (numComponents)
+            ReserveIDMap(localComponents_, localComponents_.Size() + numComponents);
+    }
+}
+
 unsigned Scene::GetFreeComponentID(CreateMode mode)
 {
     if (mode == REPLICATED)
@@ -917,6 +1087,8 @@ void Scene::NodeAdded(Node* node)
         oldScene->NodeRemoved(node);
 
     node->SetScene(this);
+    if (transforms_)
+        transforms_->AddNode(node);
 
     // If the new node has an ID of zero (default), assign a replicated ID now
     unsigned id = node->GetID();
@@ -929,7 +1101,7 @@ void Scene::NodeAdded(Node* node)
     // If node with same ID exists, remove the scene reference from it and overwrite with the new node
     if (IsReplicatedID(id))
     {
-        HashMap<unsigned, Node*>::Iterator i = replicatedNodes_.Find(id);
+        FlatHashMap<unsigned, Node*>::Iterator i = replicatedNodes_.Find(id);
         if (i != replicatedNodes_.End() && i->second_ != node)
         {
             URHO3D_LOGWARNING("Overwriting node with ID " + String(id));
@@ -994,6 +1166,8 @@ void Scene::NodeRemoved(Node* node)
         localNodes_.Erase(id);
 
     node->ResetScene();
+    if (transforms_)
+        transforms_->RemoveNode(node);
 
     // Remove node from tag cache
     if (!node->GetTags().Empty())
@@ -1115,7 +1289,7 @@ void Scene::CleanupConnection(Connection* connection)
 {
     Node::CleanupConnection(connection);
 
-    for (HashMap<unsigned, Node*>::Iterator i = replicatedNodes_.Begin(); i != replicatedNodes_.End(); ++i)
+    for (FlatHashMap<unsigned, Node*>::Iterator i = replicatedNodes_.Begin(); i != replicatedNodes_.End(); ++i)
         i->second_->CleanupConnection(connection);
 
     for (HashMap<unsigned, Component*>::Iterator i = replicatedComponents_.Begin(); i != replicatedComponents_.End(); ++i)
@@ -1164,13 +1338,12 @@ void Scene::MarkReplicationDirty(Node* node)
     }
 }
 
-void Scene::HandleUpdate(StringHash eventType, VariantMap& eventData)
+void Scene::HandleUpdate(UpdateEventData& eventData)
 {
     if (!updateEnabled_)
         return;
 
-    using namespace Update;
-    Update(eventData[P_TIMESTEP].GetFloat());
+    Update(eventData.timeStep_);
 }
 
 void Scene::HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData)
@@ -1530,10 +1703,29 @@ void Scene::PreloadResourcesJSON(const JSONValue& value)
 #endif
 }
 
+void SceneTimeStepEventData::ToVariantMap(VariantMap& eventData) const
+{
+    using namespace SceneUpdate;
+
+    eventData[P_SCENE] = scene_;
+    eventData[P_TIMESTEP] = timeStep_;
+}
+
+void SceneTimeStepEventData::FromVariantMap(const VariantMap& eventData)
+{
+    using namespace SceneUpdate;
+
+    const Variant* scene = eventData[P_SCENE];
+    const Variant* timeStep = eventData[P_TIMESTEP];
+    scene_ = scene ? static_cast<Scene*>(scene->GetPtr()) : nullptr;
+    timeStep_ = timeStep ? timeStep->GetFloat() : 0.0f;
+}
+
 void RegisterSceneLibrary(Context* context)
 {
     ValueAnimation::RegisterObject(context);
     ObjectAnimation::RegisterObject(context);
+    Prefab::RegisterObject(context);
     Node::RegisterObject(context);
     Scene::RegisterObject(context);
     SmoothedTransform::RegisterObject(context);
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include "../Container/FlatHashMap.h"
 #include "../Container/HashSet.h"
 #include "../Core/Mutex.h"
 #include "../Resource/XMLElement.h"
@@ -32,8 +33,12 @@
 namespace Urho3D
 {
 
+class ColumnarSceneFile;
 class File;
+class LogicScheduler;
 class PackageFile;
+class SceneCommandBuffer;
+struct UpdateEventData;
 
 static const unsigned FIRST_REPLICATED_ID = 0x1;
 static const unsigned LAST_REPLICATED_ID = 0xffffff;
@@ -119,6 +124,12 @@ public:
     bool SaveXML(Serializer& dest, const String& indentation = "\t") const;
     /// Save to a JSON file. Return true if successful.
     bool SaveJSON(Serializer& dest, const String& indentation = "\t") const;
+    /// Load from the columnar binary format. Removes all existing child nodes and components first. Return true if successful.
+    bool LoadColumnar(Deserializer& source);
+    /// Load from columnar binary data that has already been opened, for example from a memory-mapped file. Removes all existing child nodes and components first. Return true if successful.
+    bool LoadColumnar(const ColumnarSceneFile& source);
+    /// Save to the columnar binary format. Return true if successful.
+    bool SaveColumnar(Serializer& dest) const;
     /// Load from a binary file asynchronously. Return true if started successfully. The LOAD_RESOURCES_ONLY mode can also be used to preload resources from object prefab files.
     bool LoadAsync(File* file, LoadMode mode = LOAD_SCENE_AND_RESOURCES);
     /// Load from an XML file asynchronously. Return true if started successfully. The LOAD_RESOURCES_ONLY mode can also be used to preload resources from object prefab files.
@@ -139,6 +150,11 @@ public:
         (const JSONValue& source, const Vector3& position, const Quaternion& rotation, CreateMode mode = REPLICATED);
     /// Instantiate scene content from JSON data. Return root node if successful.
     Node* InstantiateJSON(Deserializer& source, const Vector3& position, const Quaternion& rotation, CreateMode mode = REPLICATED);
+    /// Instantiate scene content from columnar binary data. Return root node if successful.
+    Node* InstantiateColumnar(Deserializer& source, const Vector3& position, const Quaternion& rotation, CreateMode mode = REPLICATED);
+    /// Instantiate scene content from columnar binary data that has already been opened. The same data can be instantiated repeatedly without parsing it again. Return root node if successful.
+    Node* InstantiateColumnar
+        (const ColumnarSceneFile& source, const Vector3& position, const Quaternion& rotation, CreateMode mode = REPLICATED);
 
     /// Clear scene completely of either replicated, local or all nodes and components.
     void Clear(bool clearReplicated = true, bool clearLocal = true);
@@ -154,6 +170,10 @@ public:
     void SetSnapThreshold(float threshold);
     /// Set maximum milliseconds per frame to spend on async scene loading.
     void SetAsyncLoadingMs(int ms);
+    /// Enable or disable the transform store. When enabled, nodes changed from the main thread do not mark their child nodes dirty recursively. Instead the world transforms are recalculated parents first in one batched pass, which runs during the scene update and before rendering. Listener components, for example drawables, are notified of the changes only by that pass. A world transform read before it is calculated through the changed parent nodes. Disabled by default.
+    void SetTransformStoreEnabled(bool enable);
+    /// Recalculate the world transforms changed since the last update and notify their listeners. Does nothing if the transform store is disabled.
+    void UpdateTransforms();
     /// Add a required package file for networking. To be called on the server.
     void AddRequiredPackageFile(PackageFile* package);
     /// Clear required package files.
@@ -205,6 +225,18 @@ public:
     /// Return maximum milliseconds per frame to spend on async loading.
     int GetAsyncLoadingMs() const { return asyncLoadingMs_; }
 
+    /// Return whether the transform store is enabled.
+    bool IsTransformStoreEnabled() const { return transforms_.NotNull(); }
+
+    /// Return the transform store, or null if disabled.
+    TransformStore* GetTransformStore() const { return transforms_.Get(); }
+
+    /// Return the command buffer for deferring events and scene changes from worker threads. It is played back after the parallel logic update phases and at the end of the scene update.
+    SceneCommandBuffer* GetCommandBuffer() const { return commandBuffer_.Get(); }
+
+    /// Return the scheduler of the parallel logic components. Created on first use.
+    LogicScheduler* GetLogicScheduler();
+
     /// Return required package files.
     const Vector<SharedPtr<PackageFile> >& GetRequiredPackageFiles() const { return requiredPackageFiles_; }
 
@@ -227,6 +259,8 @@ public:
     unsigned GetFreeNodeID(CreateMode mode);
     /// Get free component ID, either non-local or local.
     unsigned GetFreeComponentID(CreateMode mode);
+    /// Reserve room in the ID maps for additional nodes and components, so that adding many at once does not rehash repeatedly.
+    void ReserveIDMaps(unsigned numNodes, unsigned numComponents, CreateMode mode);
     /// Return whether the specified id is a replicated id.
     static bool IsReplicatedID(unsigned id) { return id < FIRST_LOCAL_ID; }
 
@@ -260,7 +294,7 @@ public:
 
 private:
     /// Handle the logic update event to update the scene, if active.
-    void HandleUpdate(StringHash eventType, VariantMap& eventData);
+    void HandleUpdate(UpdateEventData& eventData);
     /// Handle a background loaded resource completing.
     void HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData);
     /// Update asynchronous loading.
@@ -279,7 +313,7 @@ private:
     void PreloadResourcesJSON(const JSONValue& value);
 
     /// Replicated scene nodes by ID.
-    HashMap<unsigned, Node*> replicatedNodes_;
+    FlatHashMap<unsigned, Node*> replicatedNodes_;
     /// Local scene nodes by ID.
     HashMap<unsigned, Node*> localNodes_;
     /// Replicated components by ID.
@@ -334,6 +368,12 @@ private:
     bool asyncLoading_;
     /// Threaded update flag.
     bool threadedUpdate_;
+    /// Transform store, or null if disabled.
+    UniquePtr<TransformStore> transforms_;
+    /// Deferred command buffer.
+    UniquePtr<SceneCommandBuffer> commandBuffer_;
+    /// Parallel logic component scheduler, or null if not used.
+    UniquePtr<LogicScheduler> logicScheduler_;
 };
 
 /// Register Scene library objects.
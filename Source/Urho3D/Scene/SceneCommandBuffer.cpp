@@ -0,0 +1,667 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Container/Sort.h"
+#include "../Core/Profiler.h"
+#include "../Core/Thread.h"
+#include "../Core/WorkQueue.h"
+#include "../IO/Log.h"
+#include "../Scene/Component.h"
+#include "../Scene/Scene.h"
+#include "../Scene/SceneCommandBuffer.h"
+#include "../Scene/SceneEvents.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Minimum number of IDs kept reserved in each pool.
+static const unsigned MIN_RESERVED_IDS = 64;
+
+/// Command buffer the calling work queue job records into without locking, or null if none.
+static thread_local const SceneCommandBuffer* lockFreeBuffer = nullptr;
+
+/// Reference to a command for sorting the playback order.
+struct CommandRef
+{
+    /// Ordering key.
+    unsigned key_;
+    /// Index in the recording list.
+    unsigned index_;
+    /// Recording list.
+    unsigned list_;
+};
+
+static inline bool CompareCommandRefs(const CommandRef& lhs, const CommandRef& rhs)
+{
+    if (lhs.key_ != rhs.key_)
+        return lhs.key_ < rhs.key_;
+    if (lhs.list_ != rhs.list_)
+        return lhs.list_ < rhs.list_;
+    return lhs.index_ < rhs.index_;
+}
+
+/// Count the nodes and components of a subtree by creation mode.
+static void CountSubtree(Node* node, unsigned* numNodes, unsigned* numComponents)
+{
+    ++numNodes[Scene::IsReplicatedID(node->GetID()) ? REPLICATED : LOCAL];
+
+    const Vector<SharedPtr<Component> >& components = node->GetComponents();
+    for (unsigned i = 0; i < components.Size(); ++i)
+        ++numComponents[Scene::IsReplicatedID(components[i]->GetID()) ? REPLICATED : LOCAL];
+
+    const Vector<SharedPtr<Node> >& children = node->GetChildren();
+    for (unsigned i = 0; i < children.Size(); ++i)
+        CountSubtree(children[i], numNodes, numComponents);
+}
+
+/// Collect the nodes below the root of a subtree and the components of the whole subtree in creation order, each component after its node.
+static void CollectAddedObjects(Node* node, bool root, Vector<WeakPtr<Node> >& nodes, Vector<WeakPtr<Component> >& components)
+{
+    if (!root)
+    {
+        nodes.Push(WeakPtr<Node>(node));
+        components.Push(WeakPtr<Component>());
+    }
+
+    const Vector<SharedPtr<Component> >& nodeComponents = node->GetComponents();
+    for (unsigned i = 0; i < nodeComponents.Size(); ++i)
+    {
+        nodes.Push(WeakPtr<Node>(node));
+        components.Push(WeakPtr<Component>(nodeComponents[i]));
+    }
+
+    const Vector<SharedPtr<Node> >& children = node->GetChildren();
+    for (unsigned i = 0; i < children.Size(); ++i)
+        CollectAddedObjects(children[i], false, nodes, components);
+}
+
+SceneCommandBuffer::SceneCommandBuffer(Scene* scene) :
+    scene_(scene),
+    parallel_(false)
+{
+    threadCommands_.Resize(1);
+    threadCommands_[0].key_ = M_MAX_UNSIGNED;
+    sharedCommands_.key_ = M_MAX_UNSIGNED;
+    for (unsigned i = 0; i < NUM_ID_POOLS; ++i)
+        numUsedIDs_[i] = 0;
+}
+
+SceneCommandBuffer::~SceneCommandBuffer() = default;
+
+void SceneCommandBuffer::SendEvent(Object* sender, StringHash eventType, const VariantMap& eventData)
+{
+    if (!sender)
+        return;
+
+    bool locked;
+    ThreadCommands& list = BeginRecord(locked);
+    list.commands_.Resize(list.commands_.Size() + 1);
+    Command& command = list.commands_.Back();
+    command.key_ = list.key_;
+    command.index_ = list.commands_.Size() - 1;
+    command.type_ = COMMAND_EVENT;
+    command.sender_ = sender;
+    command.hash_ = eventType;
+    command.eventData_ = eventData;
+    EndRecord(locked);
+}
+
+void SceneCommandBuffer::Call(const std::function<void()>& function)
+{
+    if (!function)
+        return;
+
+    bool locked;
+    ThreadCommands& list = BeginRecord(locked);
+    list.commands_.Resize(list.commands_.Size() + 1);
+    Command& command = list.commands_.Back();
+    command.key_ = list.key_;
+    command.index_ = list.commands_.Size() - 1;
+    command.type_ = COMMAND_CALL;
+    command.function_ = function;
+    EndRecord(locked);
+}
+
+unsigned SceneCommandBuffer::CreateNode(unsigned parentID, const String& name, CreateMode mode)
+{
+    unsigned id = ReserveID(mode == REPLICATED ? POOL_REPLICATED_NODES : POOL_LOCAL_NODES);
+    AddCommand(COMMAND_CREATENODE, id, parentID, mode, name);
+    return id;
+}
+
+unsigned SceneCommandBuffer::CreateComponent(unsigned nodeID, StringHash type, CreateMode mode)
+{
+    unsigned id = ReserveID(mode == REPLICATED ? POOL_REPLICATED_COMPONENTS : POOL_LOCAL_COMPONENTS);
+    AddCommand(COMMAND_CREATECOMPONENT, id, nodeID, mode, String::EMPTY, type);
+    return id;
+}
+
+void SceneCommandBuffer::SetTransform(unsigned nodeID, const Vector3& position, const Quaternion& rotation, const Vector3& scale)
+{
+    bool locked;
+    ThreadCommands& list = BeginRecord(locked);
+    list.commands_.Resize(list.commands_.Size() + 1);
+    Command& command = list.commands_.Back();
+    command.key_ = list.key_;
+    command.index_ = list.commands_.Size() - 1;
+    command.type_ = COMMAND_SETTRANSFORM;
+    command.id_ = nodeID;
+    command.position_ = position;
+    command.rotation_ = rotation;
+    command.scale_ = scale;
+    EndRecord(locked);
+}
+
+void SceneCommandBuffer::SetAttribute(unsigned componentID, const String& name, const Variant& value)
+{
+    bool locked;
+    ThreadCommands& list = BeginRecord(locked);
+    list.commands_.Resize(list.commands_.Size() + 1);
+    Command& command = list.commands_.Back();
+    command.key_ = list.key_;
+    command.index_ = list.commands_.Size() - 1;
+    command.type_ = COMMAND_SETATTRIBUTE;
+    command.id_ = componentID;
+    command.name_ = name;
+    command.value_ = value;
+    EndRecord(locked);
+}
+
+void SceneCommandBuffer::SetParent(unsigned nodeID, unsigned parentID)
+{
+    AddCommand(COMMAND_SETPARENT, nodeID, parentID, REPLICATED);
+}
+
+void SceneCommandBuffer::RemoveNode(unsigned nodeID)
+{
+    AddCommand(COMMAND_REMOVENODE, nodeID, 0, REPLICATED);
+}
+
+void SceneCommandBuffer::RemoveComponent(unsigned componentID)
+{
+    AddCommand(COMMAND_REMOVECOMPONENT, componentID, 0, REPLICATED);
+}
+
+void SceneCommandBuffer::ReserveIDs(unsigned numNodes, unsigned numComponents, CreateMode mode)
+{
+    if (!Thread::IsMainThread())
+    {
+        URHO3D_LOGERROR("Scene command buffer IDs can only be reserved from the main thread");
+        return;
+    }
+
+    MutexLock lock(idMutex_);
+    RefillIDs(mode == REPLICATED ? POOL_REPLICATED_NODES : POOL_LOCAL_NODES, numNodes);
+    RefillIDs(mode == REPLICATED ? POOL_REPLICATED_COMPONENTS : POOL_LOCAL_COMPONENTS, numComponents);
+}
+
+void SceneCommandBuffer::Playback()
+{
+    if (!Thread::IsMainThread())
+    {
+        URHO3D_LOGERROR("Scene command buffer can only be played back from the main thread");
+        return;
+    }
+
+    // Take the recorded lists out first, so that commands executed now may record new commands for the next playback
+    Vector<Vector<Command> > lists(threadCommands_.Size() + 1);
+    for (unsigned i = 0; i < threadCommands_.Size(); ++i)
+        lists[i].Swap(threadCommands_[i].commands_);
+    {
+        MutexLock lock(sharedMutex_);
+        lists.Back().Swap(sharedCommands_.commands_);
+    }
+
+    PODVector<CommandRef> order;
+    for (unsigned i = 0; i < lists.Size(); ++i)
+    {
+        for (unsigned j = 0; j < lists[i].Size(); ++j)
+        {
+            const Command& command = lists[i][j];
+            order.Push(CommandRef{command.key_, command.index_, i});
+        }
+    }
+    if (order.Empty())
+        return;
+
+    Sort(order.Begin(), order.End(), CompareCommandRefs);
+
+    // Keep the scene alive during playback, as the commands may remove it
+    SharedPtr<Scene> scene(scene_);
+    for (unsigned i = 0; i < order.Size(); ++i)
+    {
+        Command& command = lists[order[i].list_][order[i].index_];
+
+        // Consecutive creation commands build the new subtrees outside the scene, and consecutive removals are collected.
+        // Finish the current run when another kind of command follows
+        const bool creation = command.type_ == COMMAND_CREATENODE || command.type_ == COMMAND_CREATECOMPONENT ||
+            command.type_ == COMMAND_SETTRANSFORM || command.type_ == COMMAND_SETATTRIBUTE;
+        if (!creation)
+            AttachPending();
+        if (command.type_ != COMMAND_REMOVENODE)
+            RemovePending();
+
+        switch (command.type_)
+        {
+        case COMMAND_EVENT:
+            if (command.sender_)
+                command.sender_->SendEvent(command.hash_, command.eventData_);
+            break;
+
+        case COMMAND_CALL:
+            command.function_();
+            break;
+
+        case COMMAND_REMOVENODE:
+            if (Node* node = FindNode(command.id_))
+                pendingRemovals_.Push(WeakPtr<Node>(node));
+            break;
+
+        default:
+            ExecuteStructural(command);
+            break;
+        }
+    }
+    AttachPending();
+    RemovePending();
+
+    remappedNodeIDs_.Clear();
+    remappedComponentIDs_.Clear();
+
+    // Refill the ID pools for the next frame according to the use since the previous playback
+    MutexLock lock(idMutex_);
+    for (unsigned i = 0; i < NUM_ID_POOLS; ++i)
+    {
+        if (numUsedIDs_[i])
+        {
+            RefillIDs((IDPool)i, Max(MIN_RESERVED_IDS, numUsedIDs_[i] * 2));
+            numUsedIDs_[i] = 0;
+        }
+    }
+}
+
+void SceneCommandBuffer::BeginParallel(unsigned numThreads)
+{
+    if (!Thread::IsMainThread())
+    {
+        URHO3D_LOGERROR("Scene command buffer parallel phase can only be begun from the main thread");
+        return;
+    }
+
+    unsigned oldSize = threadCommands_.Size();
+    if (numThreads + 1 > oldSize)
+    {
+        threadCommands_.Resize(numThreads + 1);
+        for (unsigned i = oldSize; i < threadCommands_.Size(); ++i)
+            threadCommands_[i].key_ = M_MAX_UNSIGNED;
+    }
+    parallel_ = true;
+}
+
+void SceneCommandBuffer::EndParallel()
+{
+    if (!Thread::IsMainThread())
+    {
+        URHO3D_LOGERROR("Scene command buffer parallel phase can only be ended from the main thread");
+        return;
+    }
+
+    parallel_ = false;
+    for (unsigned i = 0; i < threadCommands_.Size(); ++i)
+        threadCommands_[i].key_ = M_MAX_UNSIGNED;
+}
+
+void SceneCommandBuffer::SetOrderKey(unsigned threadIndex, unsigned key)
+{
+    if (Thread::IsMainThread())
+        threadCommands_[0].key_ = key;
+    else if (parallel_ && threadIndex && threadIndex < threadCommands_.Size() && threadIndex == WorkQueue::GetThreadIndex())
+    {
+        threadCommands_[threadIndex].key_ = key;
+        lockFreeBuffer = key != M_MAX_UNSIGNED ? this : nullptr;
+    }
+    else
+    {
+        MutexLock lock(sharedMutex_);
+        sharedCommands_.key_ = key;
+    }
+}
+
+unsigned SceneCommandBuffer::GetNumCommands() const
+{
+    unsigned num = sharedCommands_.commands_.Size();
+    for (unsigned i = 0; i < threadCommands_.Size(); ++i)
+        num += threadCommands_[i].commands_.Size();
+    return num;
+}
+
+unsigned SceneCommandBuffer::GetNumReservedNodeIDs(CreateMode mode) const
+{
+    return reservedIDs_[mode == REPLICATED ? POOL_REPLICATED_NODES : POOL_LOCAL_NODES].Size();
+}
+
+unsigned SceneCommandBuffer::GetNumReservedComponentIDs(CreateMode mode) const
+{
+    return reservedIDs_[mode == REPLICATED ? POOL_REPLICATED_COMPONENTS : POOL_LOCAL_COMPONENTS].Size();
+}
+
+SceneCommandBuffer::ThreadCommands& SceneCommandBuffer::BeginRecord(bool& locked)
+{
+    if (Thread::IsMainThread())
+    {
+        locked = false;
+        return threadCommands_[0];
+    }
+
+    // Other work queue jobs, for example background tasks, may run in the worker threads also during playback, so only the
+    // jobs of a parallel phase that have claimed their thread's list record without locking
+    unsigned threadIndex = WorkQueue::GetThreadIndex();
+    if (parallel_ && lockFreeBuffer == this && threadIndex && threadIndex < threadCommands_.Size())
+    {
+        locked = false;
+        return threadCommands_[threadIndex];
+    }
+
+    sharedMutex_.Acquire();
+    locked = true;
+    return sharedCommands_;
+}
+
+void SceneCommandBuffer::EndRecord(bool locked)
+{
+    if (locked)
+        sharedMutex_.Release();
+}
+
+void SceneCommandBuffer::AddCommand(CommandType type, unsigned id, unsigned parentID, CreateMode mode, const String& name,
+    StringHash hash)
+{
+    bool locked;
+    ThreadCommands& list = BeginRecord(locked);
+    list.commands_.Resize(list.commands_.Size() + 1);
+    Command& command = list.commands_.Back();
+    command.key_ = list.key_;
+    command.index_ = list.commands_.Size() - 1;
+    command.type_ = type;
+    command.id_ = id;
+    command.parentID_ = parentID;
+    command.mode_ = mode;
+    command.name_ = name;
+    command.hash_ = hash;
+    EndRecord(locked);
+}
+
+unsigned SceneCommandBuffer::ReserveID(IDPool pool)
+{
+    MutexLock lock(idMutex_);
+
+    PODVector<unsigned>& ids = reservedIDs_[pool];
+    if (ids.Empty())
+    {
+        // The scene's ID allocation is only safe in the main thread
+        if (!Thread::IsMainThread())
+            return 0;
+        RefillIDs(pool, MIN_RESERVED_IDS);
+    }
+
+    ++numUsedIDs_[pool];
+    unsigned id = ids.Back();
+    ids.Pop();
+    return id;
+}
+
+void SceneCommandBuffer::RefillIDs(IDPool pool, unsigned size)
+{
+    PODVector<unsigned>& ids = reservedIDs_[pool];
+    if (ids.Size() >= size)
+        return;
+
+    // The IDs are taken from the end, so insert the new ones in descending order before the old ones
+    const CreateMode mode = (pool == POOL_REPLICATED_NODES || pool == POOL_REPLICATED_COMPONENTS) ? REPLICATED : LOCAL;
+    const bool nodes = pool == POOL_REPLICATED_NODES || pool == POOL_LOCAL_NODES;
+    PODVector<unsigned> newIDs(size - ids.Size());
+    for (unsigned i = newIDs.Size(); i > 0; --i)
+        newIDs[i - 1] = nodes ? scene_->GetFreeNodeID(mode) : scene_->GetFreeComponentID(mode);
+    newIDs.Push(ids);
+    ids.Swap(newIDs);
+}
+
+void SceneCommandBuffer::ExecuteStructural(Command& command)
+{
+    switch (command.type_)
+    {
+    case COMMAND_CREATENODE:
+        {
+            Node* parent = FindNode(command.parentID_);
+            if (!parent)
+            {
+                URHO3D_LOGWARNING("Parent node " + String(command.parentID_) + " not found for deferred node creation");
+                return;
+            }
+
+            // If the reserved ID has been taken in the meantime, for example by a node created with an explicit ID, assign another
+            unsigned id = command.id_;
+            if (!id || scene_->GetNode(id))
+            {
+                id = scene_->GetFreeNodeID(command.mode_);
+                if (command.id_)
+                    remappedNodeIDs_[command.id_] = id;
+            }
+
+            SharedPtr<Node> node(new Node(scene_->GetContext()));
+            node->SetID(id);
+            node->SetName(command.name_);
+            if (command.id_)
+                pendingNodes_[command.id_] = node;
+
+            // Children of new nodes are added directly, as no scene is involved yet
+            if (parent->GetScene())
+            {
+                PendingRoot root;
+                root.node_ = node;
+                root.parent_ = parent;
+                pendingRoots_.Push(root);
+            }
+            else
+                parent->AddChild(node);
+        }
+        break;
+
+    case COMMAND_CREATECOMPONENT:
+        {
+            Node* node = FindNode(command.parentID_);
+            if (!node)
+            {
+                URHO3D_LOGWARNING("Node " + String(command.parentID_) + " not found for deferred component creation");
+                return;
+            }
+
+            // Local nodes can not have replicated components
+            CreateMode mode = command.mode_;
+            if (mode == REPLICATED && !node->IsReplicated())
+                mode = LOCAL;
+            unsigned id = command.id_;
+            if (!id || mode != command.mode_ || scene_->GetComponent(id))
+                id = scene_->GetFreeComponentID(mode);
+
+            Component* component = node->CreateComponent(command.hash_, mode, id);
+            if (component && command.id_)
+            {
+                if (component->GetID() != command.id_)
+                    remappedComponentIDs_[command.id_] = component->GetID();
+                if (!node->GetScene())
+                    pendingComponents_[command.id_] = component;
+            }
+        }
+        break;
+
+    case COMMAND_SETTRANSFORM:
+        if (Node* node = FindNode(command.id_))
+            node->SetTransform(command.position_, command.rotation_, command.scale_);
+        break;
+
+    case COMMAND_SETATTRIBUTE:
+        if (Component* component = FindComponent(command.id_))
+            component->SetAttribute(command.name_, command.value_);
+        break;
+
+    case COMMAND_SETPARENT:
+        {
+            Node* node = FindNode(command.id_);
+            Node* parent = FindNode(command.parentID_);
+            if (node && parent)
+                node->SetParent(parent);
+        }
+        break;
+
+    case COMMAND_REMOVECOMPONENT:
+        if (Component* component = FindComponent(command.id_))
+            component->Remove();
+        break;
+
+    default:
+        break;
+    }
+}
+
+void SceneCommandBuffer::AttachPending()
+{
+    if (pendingRoots_.Empty())
+        return;
+
+    URHO3D_PROFILE("AttachDeferredNodes");
+
+    // Size the scene's ID maps once for the whole run instead of growing them node by node
+    unsigned numNodes[2] = { 0, 0 };
+    unsigned numComponents[2] = { 0, 0 };
+    for (unsigned i = 0; i < pendingRoots_.Size(); ++i)
+        CountSubtree(pendingRoots_[i].node_, numNodes, numComponents);
+    scene_->ReserveIDMaps(numNodes[REPLICATED], numComponents[REPLICATED], REPLICATED);
+    scene_->ReserveIDMaps(numNodes[LOCAL], numComponents[LOCAL], LOCAL);
+
+    // Clear the run first, as the node added events may record or play back more commands
+    Vector<PendingRoot> roots;
+    roots.Swap(pendingRoots_);
+    pendingNodes_.Clear();
+    pendingComponents_.Clear();
+
+    Vector<WeakPtr<Node> > nodes;
+    Vector<WeakPtr<Component> > components;
+    for (unsigned i = 0; i < roots.Size(); ++i)
+    {
+        if (!roots[i].parent_)
+            continue;
+
+        // Adding the root sends its E_NODEADDED event. Send the events of the other nodes and the components as if they
+        // had been created in the scene one by one, skipping those that the event handlers have removed meanwhile
+        Node* root = roots[i].node_;
+        nodes.Clear();
+        components.Clear();
+        CollectAddedObjects(root, true, nodes, components);
+        roots[i].parent_->AddChild(root);
+
+        for (unsigned j = 0; j < nodes.Size(); ++j)
+        {
+            Node* node = nodes[j];
+            if (!node || node->GetScene() != scene_)
+                continue;
+
+            VariantMap& eventData = scene_->GetEventDataMap();
+            if (components[j].NotNull())
+            {
+                Component* component = components[j];
+                if (!component || component->GetNode() != node)
+                    continue;
+
+                using namespace ComponentAdded;
+                eventData[P_SCENE] = scene_;
+                eventData[P_NODE] = node;
+                eventData[P_COMPONENT] = component;
+                scene_->SendEvent(E_COMPONENTADDED, eventData);
+            }
+            else
+            {
+                using namespace NodeAdded;
+                eventData[P_SCENE] = scene_;
+                eventData[P_PARENT] = node->GetParent();
+                eventData[P_NODE] = node;
+                scene_->SendEvent(E_NODEADDED, eventData);
+            }
+        }
+    }
+}
+
+void SceneCommandBuffer::RemovePending()
+{
+    if (pendingRemovals_.Empty())
+        return;
+
+    URHO3D_PROFILE("RemoveDeferredNodes");
+
+    Vector<WeakPtr<Node> > removals;
+    removals.Swap(pendingRemovals_);
+
+    // Remove the runs of nodes that have the same parent at once. Removing a run may destroy nodes of the later runs, so
+    // check them only when their run starts
+    PODVector<Node*> run;
+    for (unsigned i = 0; i < removals.Size();)
+    {
+        Node* parent = removals[i] ? removals[i]->GetParent() : nullptr;
+        run.Clear();
+        for (; i < removals.Size(); ++i)
+        {
+            Node* node = removals[i];
+            if (node && node->GetParent() != parent)
+                break;
+            if (node)
+                run.Push(node);
+        }
+        if (parent)
+            parent->RemoveChildren(run);
+    }
+}
+
+Node* SceneCommandBuffer::FindNode(unsigned id) const
+{
+    HashMap<unsigned, Node*>::ConstIterator i = pendingNodes_.Find(id);
+    if (i != pendingNodes_.End())
+        return i->second_;
+
+    HashMap<unsigned, unsigned>::ConstIterator j = remappedNodeIDs_.Find(id);
+    return scene_->GetNode(j != remappedNodeIDs_.End() ? j->second_ : id);
+}
+
+Component* SceneCommandBuffer::FindComponent(unsigned id) const
+{
+    HashMap<unsigned, Component*>::ConstIterator i = pendingComponents_.Find(id);
+    if (i != pendingComponents_.End())
+        return i->second_;
+
+    HashMap<unsigned, unsigned>::ConstIterator j = remappedComponentIDs_.Find(id);
+    return scene_->GetComponent(j != remappedComponentIDs_.End() ? j->second_ : id);
+}
+
+}
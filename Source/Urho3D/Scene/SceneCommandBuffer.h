@@ -0,0 +1,223 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Container/Ptr.h"
+#include "../Core/Mutex.h"
+#include "../Core/Variant.h"
+#include "../Scene/Node.h"
+
+#include <atomic>
+#include <functional>
+
+namespace Urho3D
+{
+
+class Component;
+class Object;
+class Scene;
+
+/// Thread-safe buffer of deferred scene operations. Code running in worker threads, for example parallel logic component updates, records events, function calls and structural scene changes that must run in the main thread, and the scene plays them back at its sync points. The main thread records without locking. During a parallel phase, the jobs that have set an ordering key record into the list of their work queue thread without locking; all other recording, including other work queue jobs, takes a lock.
+/** New nodes and components get IDs from pools reserved in the main thread, so that later commands can refer to them before they exist. During playback, nodes created under an existing node are assembled outside the scene first and added as one subtree, which inserts the IDs into the scene's maps in bulk. E_NODEADDED and E_COMPONENTADDED are then sent for each node and component of the subtree, as if they had been created in the scene. Consecutive node removals are applied per parent node with one compaction of its child vector.
+ */
+class URHO3D_API SceneCommandBuffer
+{
+public:
+    /// Construct for a scene.
+    explicit SceneCommandBuffer(Scene* scene);
+    /// Destruct. Discard commands that have not been played back.
+    ~SceneCommandBuffer();
+    /// Prevent copy construction.
+    SceneCommandBuffer(const SceneCommandBuffer& rhs) = delete;
+    /// Prevent assignment.
+    SceneCommandBuffer& operator =(const SceneCommandBuffer& rhs) = delete;
+
+    /// Record sending an event from an object. The event is skipped if the object has been destroyed before playback.
+    void SendEvent(Object* sender, StringHash eventType, const VariantMap& eventData = Variant::emptyVariantMap);
+    /// Record a function call.
+    void Call(const std::function<void()>& function);
+    /// Record creating a child node. Return the reserved ID of the new node for use in later commands, or 0 if the ID pool was exhausted in a worker thread, in which case the node is still created.
+    unsigned CreateNode(unsigned parentID, const String& name = String::EMPTY, CreateMode mode = REPLICATED);
+    /// Record creating a component to a node. Return the reserved ID of the new component, or 0 if the ID pool was exhausted in a worker thread.
+    unsigned CreateComponent(unsigned nodeID, StringHash type, CreateMode mode = REPLICATED);
+    /// Record setting the transform of a node in parent space.
+    void SetTransform(unsigned nodeID, const Vector3& position, const Quaternion& rotation = Quaternion::IDENTITY,
+        const Vector3& scale = Vector3::ONE);
+    /// Record setting an attribute of a component.
+    void SetAttribute(unsigned componentID, const String& name, const Variant& value);
+    /// Record moving a node to another parent, keeping its world transform.
+    void SetParent(unsigned nodeID, unsigned parentID);
+    /// Record removing a node and its child nodes from the scene.
+    void RemoveNode(unsigned nodeID);
+    /// Record removing a component from its node.
+    void RemoveComponent(unsigned componentID);
+    /// Reserve IDs so that at least this many nodes and components can be created from worker threads before the next playback. The pools are also refilled automatically at playback according to the use since the previous one. Called from the main thread.
+    void ReserveIDs(unsigned numNodes, unsigned numComponents, CreateMode mode = REPLICATED);
+    /// Execute the recorded commands in the main thread and clear the buffer. Commands recorded during the playback are kept for the next playback.
+    void Playback();
+
+    /// Begin a parallel phase and prepare lock-free recording lists for the work queue threads. Called from the main thread when no other thread is recording.
+    void BeginParallel(unsigned numThreads);
+    /// End the parallel phase and reset the ordering keys. Called from the main thread after the jobs of the phase have completed and before playback.
+    void EndParallel();
+    /// Set the ordering key of the commands recorded from the calling thread. Playback is in key order, and in recording order within a key. The parallel logic update sets the key per component, which makes the playback order independent of thread scheduling. During a parallel phase, a work queue job records into its thread's list without locking from setting a key until resetting it to M_MAX_UNSIGNED, which it must do before the job returns.
+    void SetOrderKey(unsigned threadIndex, unsigned key);
+    /// Return number of commands waiting for playback. Not thread-safe.
+    unsigned GetNumCommands() const;
+    /// Return number of reserved node IDs that are not used yet.
+    unsigned GetNumReservedNodeIDs(CreateMode mode = REPLICATED) const;
+    /// Return number of reserved component IDs that are not used yet.
+    unsigned GetNumReservedComponentIDs(CreateMode mode = REPLICATED) const;
+
+private:
+    /// Command type.
+    enum CommandType
+    {
+        COMMAND_EVENT = 0,
+        COMMAND_CALL,
+        COMMAND_CREATENODE,
+        COMMAND_CREATECOMPONENT,
+        COMMAND_SETTRANSFORM,
+        COMMAND_SETATTRIBUTE,
+        COMMAND_SETPARENT,
+        COMMAND_REMOVENODE,
+        COMMAND_REMOVECOMPONENT
+    };
+
+    /// ID pool index.
+    enum IDPool
+    {
+        POOL_REPLICATED_NODES = 0,
+        POOL_LOCAL_NODES,
+        POOL_REPLICATED_COMPONENTS,
+        POOL_LOCAL_COMPONENTS,
+        NUM_ID_POOLS
+    };
+
+    /// Recorded command.
+    struct Command
+    {
+        /// Ordering key.
+        unsigned key_;
+        /// Index in the recording list.
+        unsigned index_;
+        /// Command type.
+        CommandType type_;
+        /// Node or component ID the command creates or acts on.
+        unsigned id_;
+        /// Parent or owner node ID.
+        unsigned parentID_;
+        /// Creation mode.
+        CreateMode mode_;
+        /// Node name or attribute name.
+        String name_;
+        /// Event type or component type.
+        StringHash hash_;
+        /// Attribute value.
+        Variant value_;
+        /// Position.
+        Vector3 position_;
+        /// Rotation.
+        Quaternion rotation_;
+        /// Scale.
+        Vector3 scale_;
+        /// Event sender.
+        WeakPtr<Object> sender_;
+        /// Event parameters.
+        VariantMap eventData_;
+        /// Function to call.
+        std::function<void()> function_;
+    };
+
+    /// Node created during playback that is added to the scene at the end of the creation run.
+    struct PendingRoot
+    {
+        /// Root node of the created subtree.
+        SharedPtr<Node> node_;
+        /// Existing parent node.
+        WeakPtr<Node> parent_;
+    };
+
+    /// Commands and ordering key of one recording thread.
+    struct ThreadCommands
+    {
+        /// Commands.
+        Vector<Command> commands_;
+        /// Current ordering key.
+        unsigned key_;
+    };
+
+    /// Return the recording list of the calling thread and lock the mutex if it is shared.
+    ThreadCommands& BeginRecord(bool& locked);
+    /// Finish recording, unlocking the mutex if it was locked.
+    void EndRecord(bool locked);
+    /// Record a structural command.
+    void AddCommand(CommandType type, unsigned id, unsigned parentID, CreateMode mode, const String& name = String::EMPTY,
+        StringHash hash = StringHash::ZERO);
+    /// Take an ID from a pool. Refill the pool first if empty and called from the main thread. Return 0 if none available.
+    unsigned ReserveID(IDPool pool);
+    /// Refill an ID pool to the requested size. Called from the main thread.
+    void RefillIDs(IDPool pool, unsigned size);
+    /// Execute a structural command.
+    void ExecuteStructural(Command& command);
+    /// Add the nodes created during the current creation run to the scene and send their node and component added events.
+    void AttachPending();
+    /// Remove the nodes of the current removal run from the scene.
+    void RemovePending();
+    /// Return a node by recorded ID during playback, including nodes created but not yet added to the scene.
+    Node* FindNode(unsigned id) const;
+    /// Return a component by recorded ID during playback, including components created but not yet added to the scene.
+    Component* FindComponent(unsigned id) const;
+
+    /// Scene.
+    Scene* scene_;
+    /// Lock-free recording lists, indexed by work queue thread index. Index 0 is the main thread.
+    Vector<ThreadCommands> threadCommands_;
+    /// Parallel phase flag. The work queue threads use their lock-free lists only while it is set.
+    std::atomic<bool> parallel_;
+    /// Recording list of other threads.
+    ThreadCommands sharedCommands_;
+    /// Mutex for the shared recording list.
+    Mutex sharedMutex_;
+    /// Reserved IDs that are not used yet.
+    PODVector<unsigned> reservedIDs_[NUM_ID_POOLS];
+    /// Number of IDs taken from each pool since the previous playback.
+    unsigned numUsedIDs_[NUM_ID_POOLS];
+    /// Mutex for the ID pools.
+    Mutex idMutex_;
+    /// Nodes created during the current creation run, by recorded ID.
+    HashMap<unsigned, Node*> pendingNodes_;
+    /// Components created during the current creation run, by recorded ID.
+    HashMap<unsigned, Component*> pendingComponents_;
+    /// Root nodes of the current creation run.
+    Vector<PendingRoot> pendingRoots_;
+    /// Nodes of the current removal run.
+    Vector<WeakPtr<Node> > pendingRemovals_;
+    /// Node IDs that were already taken at playback, mapped to the IDs actually assigned.
+    HashMap<unsigned, unsigned> remappedNodeIDs_;
+    /// Component IDs that were already taken at playback, mapped to the IDs actually assigned.
+    HashMap<unsigned, unsigned> remappedComponentIDs_;
+};
+
+}
@@ -27,6 +27,8 @@
 namespace Urho3D
 {
 
+class Scene;
+
 /// Variable timestep scene update.
 URHO3D_EVENT(E_SCENEUPDATE, SceneUpdate)
 {
@@ -219,4 +221,42 @@ URHO3D_EVENT(E_SCENEACTIVATED, SceneActivated)
     URHO3D_PARAM(P_NEWSCENE, NewScene);            // Scene pointer
 }
 
+/// Typed parameters of the scene update events.
+struct URHO3D_API SceneTimeStepEventData
+{
+    /// Scene being updated.
+    Scene* scene_{};
+    /// Timestep in seconds.
+    float timeStep_{};
+
+    /// Convert to event parameters.
+    void ToVariantMap(VariantMap& eventData) const;
+    /// Convert from event parameters.
+    void FromVariantMap(const VariantMap& eventData);
+};
+
+/// Typed parameters of E_SCENEUPDATE.
+struct SceneUpdateEventData : public SceneTimeStepEventData
+{
+    URHO3D_EVENT_DATA(E_SCENEUPDATE)
+};
+
+/// Typed parameters of E_ATTRIBUTEANIMATIONUPDATE.
+struct AttributeAnimationUpdateEventData : public SceneTimeStepEventData
+{
+    URHO3D_EVENT_DATA(E_ATTRIBUTEANIMATIONUPDATE)
+};
+
+/// Typed parameters of E_SCENESUBSYSTEMUPDATE.
+struct SceneSubsystemUpdateEventData : public SceneTimeStepEventData
+{
+    URHO3D_EVENT_DATA(E_SCENESUBSYSTEMUPDATE)
+};
+
+/// Typed parameters of E_SCENEPOSTUPDATE.
+struct ScenePostUpdateEventData : public SceneTimeStepEventData
+{
+    URHO3D_EVENT_DATA(E_SCENEPOSTUPDATE)
+};
+
 }
@@ -178,6 +178,15 @@ void Serializable::OnSetAttribute(const AttributeInfo& attr, const Variant& src)
         MarkNetworkUpdate();
 }
 
+bool Serializable::OnSetAttributeDirect(const AttributeInfo& attr, const void* src)
+{
+    // Instance defaults are stored as Variants, so use the variant path while they are being recorded
+    if (!attr.accessor_ || setInstanceDefault_)
+        return false;
+
+    return attr.accessor_->SetDirect(this, src);
+}
+
 void Serializable::OnGetAttribute(const AttributeInfo& attr, Variant& dest) const
 {
     // Check for accessor function mode
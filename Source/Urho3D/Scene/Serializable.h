@@ -55,6 +55,8 @@ public:
     virtual void OnSetAttribute(const AttributeInfo& attr, const Variant& src);
     /// Handle attribute read access. Default implementation reads the variable at offset, or invokes the get accessor.
     virtual void OnGetAttribute(const AttributeInfo& attr, Variant& dest) const;
+    /// Handle attribute write access from a value of the C++ type that corresponds to the attribute's variant type. Return false if not supported, in which case OnSetAttribute() should be used instead. Subclasses that override OnSetAttribute() should override this to return false.
+    virtual bool OnSetAttributeDirect(const AttributeInfo& attr, const void* src);
     /// Return attribute descriptions, or null if none defined.
     virtual const Vector<AttributeInfo>* GetAttributes() const;
     /// Return network replication attribute descriptions, or null if none defined.
@@ -185,6 +187,46 @@ private:
     TSetFunction setFunction_;
 };
 
+/// Template implementation of the variant attribute accessor that can also be set without constructing a Variant.
+template <class TClassType, class TGetFunction, class TSetFunction, class TSetDirectFunction>
+class DirectAttributeAccessorImpl : public VariantAttributeAccessorImpl<TClassType, TGetFunction, TSetFunction>
+{
+public:
+    /// Construct.
+    DirectAttributeAccessorImpl(TGetFunction getFunction, TSetFunction setFunction, TSetDirectFunction setDirectFunction) :
+        VariantAttributeAccessorImpl<TClassType, TGetFunction, TSetFunction>(getFunction, setFunction),
+        setDirectFunction_(setDirectFunction)
+    {
+    }
+
+    /// Invoke direct setter function.
+    bool SetDirect(Serializable* ptr, const void* src) override
+    {
+        assert(ptr && src);
+        auto classPtr = static_cast<TClassType*>(ptr);
+        setDirectFunction_(*classPtr, src);
+        return true;
+    }
+
+private:
+    /// Direct set functor.
+    TSetDirectFunction setDirectFunction_;
+};
+
+/// Access a raw attribute value passed to AttributeAccessor::SetDirect(). The value is stored as the C++ type that corresponds to the variant type.
+template <class T> struct DirectAttributeValue
+{
+    /// Return the value.
+    static const T& Get(const void* src) { return *static_cast<const T*>(src); }
+};
+
+/// Access a raw string hash attribute value, which is stored as an integer.
+template <> struct DirectAttributeValue<StringHash>
+{
+    /// Return the value.
+    static StringHash Get(const void* src) { return StringHash(*static_cast<const unsigned*>(src)); }
+};
+
 /// Make variant attribute accessor implementation.
 /// \tparam TClassType Serializable class type.
 /// \tparam TGetFunction Functional object with call signature `void getFunction(const TClassType& self, Variant& value)`
@@ -195,35 +237,51 @@ SharedPtr<AttributeAccessor> MakeVariantAttributeAccessor(TGetFunction getFuncti
     return SharedPtr<AttributeAccessor>(new VariantAttributeAccessorImpl<TClassType, TGetFunction, TSetFunction>(getFunction, setFunction));
 }
 
+/// Make variant attribute accessor implementation with a direct setter.
+/// \tparam TSetDirectFunction Functional object with call signature `void setDirectFunction(TClassType& self, const void* value)`
+template <class TClassType, class TGetFunction, class TSetFunction, class TSetDirectFunction>
+SharedPtr<AttributeAccessor> MakeDirectAttributeAccessor(TGetFunction getFunction, TSetFunction setFunction,
+    TSetDirectFunction setDirectFunction)
+{
+    return SharedPtr<AttributeAccessor>(new DirectAttributeAccessorImpl<TClassType, TGetFunction, TSetFunction,
+        TSetDirectFunction>(getFunction, setFunction, setDirectFunction));
+}
+
 /// Make member attribute accessor.
-#define URHO3D_MAKE_MEMBER_ATTRIBUTE_ACCESSOR(typeName, variable) Urho3D::MakeVariantAttributeAccessor<ClassName>( \
+#define URHO3D_MAKE_MEMBER_ATTRIBUTE_ACCESSOR(typeName, variable) Urho3D::MakeDirectAttributeAccessor<ClassName>( \
     [](const ClassName& self, Urho3D::Variant& value) { value = self.variable; }, \
-    [](ClassName& self, const Urho3D::Variant& value) { self.variable = value.Get<typeName>(); })
+    [](ClassName& self, const Urho3D::Variant& value) { self.variable = value.Get<typeName>(); }, \
+    [](ClassName& self, const void* value) { self.variable = Urho3D::DirectAttributeValue<typeName>::Get(value); })
 
 /// Make member attribute accessor with custom post-set callback.
-#define URHO3D_MAKE_MEMBER_ATTRIBUTE_ACCESSOR_EX(typeName, variable, postSetCallback) Urho3D::MakeVariantAttributeAccessor<ClassName>( \
+#define URHO3D_MAKE_MEMBER_ATTRIBUTE_ACCESSOR_EX(typeName, variable, postSetCallback) Urho3D::MakeDirectAttributeAccessor<ClassName>( \
     [](const ClassName& self, Urho3D::Variant& value) { value = self.variable; }, \
-    [](ClassName& self, const Urho3D::Variant& value) { self.variable = value.Get<typeName>(); self.postSetCallback(); })
+    [](ClassName& self, const Urho3D::Variant& value) { self.variable = value.Get<typeName>(); self.postSetCallback(); }, \
+    [](ClassName& self, const void* value) { self.variable = Urho3D::DirectAttributeValue<typeName>::Get(value); self.postSetCallback(); })
 
 /// Make get/set attribute accessor.
-#define URHO3D_MAKE_GET_SET_ATTRIBUTE_ACCESSOR(getFunction, setFunction, typeName) Urho3D::MakeVariantAttributeAccessor<ClassName>( \
+#define URHO3D_MAKE_GET_SET_ATTRIBUTE_ACCESSOR(getFunction, setFunction, typeName) Urho3D::MakeDirectAttributeAccessor<ClassName>( \
     [](const ClassName& self, Urho3D::Variant& value) { value = self.getFunction(); }, \
-    [](ClassName& self, const Urho3D::Variant& value) { self.setFunction(value.Get<typeName>()); })
+    [](ClassName& self, const Urho3D::Variant& value) { self.setFunction(value.Get<typeName>()); }, \
+    [](ClassName& self, const void* value) { self.setFunction(Urho3D::DirectAttributeValue<typeName>::Get(value)); })
 
 /// Make member enum attribute accessor
-#define URHO3D_MAKE_MEMBER_ENUM_ATTRIBUTE_ACCESSOR(variable) Urho3D::MakeVariantAttributeAccessor<ClassName>( \
+#define URHO3D_MAKE_MEMBER_ENUM_ATTRIBUTE_ACCESSOR(variable) Urho3D::MakeDirectAttributeAccessor<ClassName>( \
     [](const ClassName& self, Urho3D::Variant& value) { value = static_cast<int>(self.variable); }, \
-    [](ClassName& self, const Urho3D::Variant& value) { self.variable = static_cast<decltype(self.variable)>(value.Get<int>()); })
+    [](ClassName& self, const Urho3D::Variant& value) { self.variable = static_cast<decltype(self.variable)>(value.Get<int>()); }, \
+    [](ClassName& self, const void* value) { self.variable = static_cast<decltype(self.variable)>(Urho3D::DirectAttributeValue<int>::Get(value)); })
 
 /// Make member enum attribute accessor with custom post-set callback.
-#define URHO3D_MAKE_MEMBER_ENUM_ATTRIBUTE_ACCESSOR_EX(variable, postSetCallback) Urho3D::MakeVariantAttributeAccessor<ClassName>( \
+#define URHO3D_MAKE_MEMBER_ENUM_ATTRIBUTE_ACCESSOR_EX(variable, postSetCallback) Urho3D::MakeDirectAttributeAccessor<ClassName>( \
     [](const ClassName& self, Urho3D::Variant& value) { value = static_cast<int>(self.variable); }, \
-    [](ClassName& self, const Urho3D::Variant& value) { self.variable = static_cast<decltype(self.variable)>(value.Get<int>()); self.postSetCallback(); })
+    [](ClassName& self, const Urho3D::Variant& value) { self.variable = static_cast<decltype(self.variable)>(value.Get<int>()); self.postSetCallback(); }, \
+    [](ClassName& self, const void* value) { self.variable = static_cast<decltype(self.variable)>(Urho3D::DirectAttributeValue<int>::Get(value)); self.postSetCallback(); })
 
 /// Make get/set enum attribute accessor.
-#define URHO3D_MAKE_GET_SET_ENUM_ATTRIBUTE_ACCESSOR(getFunction, setFunction, typeName) Urho3D::MakeVariantAttributeAccessor<ClassName>( \
+#define URHO3D_MAKE_GET_SET_ENUM_ATTRIBUTE_ACCESSOR(getFunction, setFunction, typeName) Urho3D::MakeDirectAttributeAccessor<ClassName>( \
     [](const ClassName& self, Urho3D::Variant& value) { value = static_cast<int>(self.getFunction()); }, \
-    [](ClassName& self, const Urho3D::Variant& value) { self.setFunction(static_cast<typeName>(value.Get<int>())); })
+    [](ClassName& self, const Urho3D::Variant& value) { self.setFunction(static_cast<typeName>(value.Get<int>())); }, \
+    [](ClassName& self, const void* value) { self.setFunction(static_cast<typeName>(Urho3D::DirectAttributeValue<int>::Get(value))); })
 
 /// Attribute metadata.
 namespace AttributeMetadata
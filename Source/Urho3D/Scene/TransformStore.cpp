@@ -0,0 +1,422 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Container/Sort.h"
+#include "../Core/Profiler.h"
+#include "../Core/WorkQueue.h"
+#include "../Scene/Scene.h"
+#include "../Scene/TransformStore.h"
+
+#include <cstring>
+
+#ifdef URHO3D_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Minimum number of changed subtrees per work batch.
+static const unsigned TRANSFORM_UPDATE_BATCH_SIZE = 16;
+/// Minimum number of nodes to update before using worker threads.
+static const unsigned MIN_THREADED_TRANSFORM_UPDATE = 4096;
+/// Number of nodes to prefetch ahead.
+static const unsigned TRANSFORM_PREFETCH_DISTANCE = 8;
+/// Maximum update rounds when listeners keep changing nodes during the notification. Remaining changes stay pending.
+static const unsigned MAX_TRANSFORM_UPDATE_ROUNDS = 4;
+
+/// Node has been marked dirty.
+static const unsigned char FLAG_MARKED = 1;
+/// Node has a marked parent.
+static const unsigned char FLAG_INHERITED = 2;
+
+TransformStore::TransformStore(Scene* scene) :
+    scene_(scene),
+    numUpdated_(0),
+    revision_(0),
+    dirty_(false),
+    hierarchyDirty_(true)
+{
+    Rebuild();
+    dirty_ = !dirtyNodes_.Empty();
+}
+
+/// Return the independent subtree holding a store index.
+static unsigned FindSubtree(const PODVector<unsigned>& offsets, unsigned index)
+{
+    return (unsigned)(UpperBound(offsets.Begin(), offsets.End(), index) - offsets.Begin()) - 1;
+}
+
+TransformStore::~TransformStore()
+{
+    // The node list may hold removed nodes until rebuilt, so detach by traversing the scene instead
+    PODVector<Node*> nodes;
+    nodes.Push(scene_);
+    while (!nodes.Empty())
+    {
+        Node* node = nodes.Back();
+        nodes.Pop();
+        node->transformStore_ = nullptr;
+        node->transformIndex_ = M_MAX_UNSIGNED;
+        for (Vector<SharedPtr<Node> >::ConstIterator i = node->children_.Begin(); i != node->children_.End(); ++i)
+            nodes.Push(*i);
+    }
+}
+
+void TransformStore::AddNode(Node* node)
+{
+    // A new node gets its index when its subtree is rebuilt. The parent marks the subtree once the node is attached
+    node->transformStore_ = this;
+    node->transformIndex_ = M_MAX_UNSIGNED;
+    node->transformRevision_ = M_MAX_UNSIGNED;
+    hierarchyDirty_ = true;
+}
+
+void TransformStore::RemoveNode(Node* node)
+{
+    MarkSubtreeDirty(node->transformIndex_);
+    node->transformStore_ = nullptr;
+    node->transformIndex_ = M_MAX_UNSIGNED;
+    hierarchyDirty_ = true;
+}
+
+void TransformStore::MarkHierarchyDirty(Node* node)
+{
+    // The old position, if the node was already stored
+    MarkSubtreeDirty(node->transformIndex_);
+
+    // The new position is under a child node of the scene. A child node that is not stored yet is traversed anyway
+    Node* root = node;
+    while (root->parent_ && root->parent_ != scene_)
+        root = root->parent_;
+    if (root->parent_ == scene_)
+        MarkSubtreeDirty(root->transformIndex_);
+
+    hierarchyDirty_ = true;
+}
+
+void TransformStore::MarkSubtreeDirty(unsigned index)
+{
+    if (index < nodes_.Size())
+        subtreeDirty_[FindSubtree(subtreeOffsets_, index)] = 1;
+}
+
+void TransformStore::MarkDirty(Node* node)
+{
+    // The indices stay valid until the rebuild, which moves the flags and the marked nodes along with their subtrees. Nodes
+    // without an index are new, and the rebuild picks up their own dirty flags instead
+    unsigned index = node->transformIndex_;
+    if (index < nodes_.Size() && !flags_[index])
+    {
+        flags_[index] = FLAG_MARKED;
+        dirtyNodes_.Push(index);
+    }
+
+    ++revision_;
+    dirty_ = true;
+}
+
+void TransformStore::Update()
+{
+    for (unsigned round = 0; dirty_ && round < MAX_TRANSFORM_UPDATE_ROUNDS; ++round)
+    {
+        URHO3D_PROFILE("UpdateTransforms");
+
+        // Clear the flag first, so that reading world transforms below does not recurse into the update
+        dirty_ = false;
+        if (hierarchyDirty_)
+            Rebuild();
+
+        numUpdated_ = 0;
+        if (dirtyNodes_.Empty())
+            continue;
+
+        // Merge the marked nodes into the ranges of their subtrees. A node inside the subtree of an earlier one is covered
+        Sort(dirtyNodes_.Begin(), dirtyNodes_.End());
+        dirtyRanges_.Clear();
+        unsigned numRangeNodes = 0;
+        unsigned rangeEnd = 0;
+        for (unsigned i = 0; i < dirtyNodes_.Size(); ++i)
+        {
+            unsigned index = dirtyNodes_[i];
+            if (index < rangeEnd)
+                continue;
+            rangeEnd = subtreeEnds_[index];
+            dirtyRanges_.Push(MakePair(index, rangeEnd));
+            numRangeNodes += rangeEnd - index;
+        }
+        dirtyNodes_.Clear();
+
+        // The ranges are independent of each other, except for reading the world transforms of their parents, so a large
+        // update updates those first and then splits the ranges into parallel batches
+        auto* queue = scene_->GetSubsystem<WorkQueue>();
+        if (queue && queue->GetNumThreads() && dirtyRanges_.Size() > 1 && numRangeNodes >= MIN_THREADED_TRANSFORM_UPDATE)
+        {
+            for (unsigned i = 0; i < dirtyRanges_.Size(); ++i)
+            {
+                unsigned parent = parents_[dirtyRanges_[i].first_];
+                if (parent != M_MAX_UNSIGNED)
+                    nodes_[parent]->GetWorldTransform();
+            }
+
+            queue->ParallelFor(dirtyRanges_.Size(), TRANSFORM_UPDATE_BATCH_SIZE, [&](unsigned begin, unsigned end, unsigned threadIndex)
+            {
+                for (unsigned i = begin; i < end; ++i)
+                    UpdateWorldTransforms(dirtyRanges_[i].first_, dirtyRanges_[i].second_);
+            });
+        }
+        else
+        {
+            for (unsigned i = 0; i < dirtyRanges_.Size(); ++i)
+                UpdateWorldTransforms(dirtyRanges_[i].first_, dirtyRanges_[i].second_);
+        }
+
+        unsigned char* flags = flags_.Buffer();
+        for (unsigned i = 0; i < dirtyRanges_.Size(); ++i)
+        {
+            for (unsigned j = dirtyRanges_[i].first_; j < dirtyRanges_[i].second_; ++j)
+            {
+                if (flags[j])
+                {
+                    flags[j] = 0;
+                    changedNodes_.Push(nodes_[j]);
+                }
+            }
+        }
+        numUpdated_ = changedNodes_.Size();
+
+        // Notify parents first. Listeners may change nodes again, which leads to another round, or read world transforms,
+        // which updates in a nested call. Therefore notify from a local list
+        PODVector<Node*> changedNodes;
+        changedNodes.Swap(changedNodes_);
+        for (unsigned i = 0; i < changedNodes.Size(); ++i)
+        {
+#ifdef URHO3D_SSE
+            // Fetch the listener vectors ahead in two steps, as the second depends on the first
+            if (i + TRANSFORM_PREFETCH_DISTANCE * 2 < changedNodes.Size())
+                _mm_prefetch((const char*)&changedNodes[i + TRANSFORM_PREFETCH_DISTANCE * 2]->listeners_, _MM_HINT_T0);
+            if (i + TRANSFORM_PREFETCH_DISTANCE < changedNodes.Size() && !changedNodes[i + TRANSFORM_PREFETCH_DISTANCE]->listeners_.Empty())
+                _mm_prefetch((const char*)changedNodes[i + TRANSFORM_PREFETCH_DISTANCE]->listeners_.Buffer(), _MM_HINT_T0);
+#endif
+            changedNodes[i]->NotifyListeners();
+        }
+        changedNodes.Clear();
+        if (changedNodes_.Empty())
+            changedNodes_.Swap(changedNodes);
+    }
+}
+
+void TransformStore::Rebuild()
+{
+    URHO3D_PROFILE("RebuildTransformStore");
+
+    // Keep the old order to copy the unchanged subtrees from
+    PODVector<Node*> oldNodes;
+    PODVector<unsigned> oldParents;
+    PODVector<unsigned> oldEnds;
+    PODVector<unsigned> oldOffsets;
+    PODVector<unsigned char> oldSubtreeDirty;
+    PODVector<unsigned char> oldFlags;
+    PODVector<unsigned> oldDirtyNodes;
+    oldNodes.Swap(nodes_);
+    oldParents.Swap(parents_);
+    oldEnds.Swap(subtreeEnds_);
+    oldOffsets.Swap(subtreeOffsets_);
+    oldSubtreeDirty.Swap(subtreeDirty_);
+    oldFlags.Swap(flags_);
+    oldDirtyNodes.Swap(dirtyNodes_);
+
+    // New start index of each old subtree that is copied, or M_MAX_UNSIGNED if it was traversed again or removed
+    unsigned numOldSubtrees = oldOffsets.Size() ? oldOffsets.Size() - 1 : 0;
+    PODVector<unsigned> newOffsets(numOldSubtrees, M_MAX_UNSIGNED);
+
+    // The scene itself forms the first subtree, and the children of the scene begin the others
+    subtreeOffsets_.Push(0);
+    scene_->transformStore_ = this;
+    scene_->transformIndex_ = 0;
+    nodes_.Push(scene_);
+    parents_.Push(M_MAX_UNSIGNED);
+    subtreeEnds_.Push(1);
+    if (numOldSubtrees)
+    {
+        flags_.Push(oldFlags[0]);
+        newOffsets[0] = 0;
+    }
+    else
+    {
+        flags_.Push(scene_->dirty_ ? FLAG_MARKED : 0);
+        if (flags_[0])
+            dirtyNodes_.Push(0);
+    }
+
+    PODVector<Pair<Node*, unsigned> > stack;
+    for (unsigned i = 0; i < scene_->children_.Size(); ++i)
+    {
+        Node* root = scene_->children_[i];
+        unsigned begin = nodes_.Size();
+        subtreeOffsets_.Push(begin);
+
+        // Traverse new and changed subtrees. The nodes of the changed ones may have been removed, so they are not accessed
+        unsigned oldBegin = root->transformIndex_;
+        unsigned subtree = oldBegin < oldNodes.Size() ? FindSubtree(oldOffsets, oldBegin) : M_MAX_UNSIGNED;
+        if (subtree == M_MAX_UNSIGNED || oldOffsets[subtree] != oldBegin || oldSubtreeDirty[subtree])
+        {
+            AddSubtree(root, stack);
+            continue;
+        }
+
+        // Copy an unchanged subtree, shifting its indices if it moved
+        unsigned oldEnd = oldOffsets[subtree + 1];
+        unsigned count = oldEnd - oldBegin;
+        unsigned end = begin + count;
+        newOffsets[subtree] = begin;
+        nodes_.Resize(end);
+        parents_.Resize(end);
+        subtreeEnds_.Resize(end);
+        flags_.Resize(end);
+        memcpy(nodes_.Buffer() + begin, oldNodes.Buffer() + oldBegin, count * sizeof(Node*));
+        memcpy(flags_.Buffer() + begin, oldFlags.Buffer() + oldBegin, count);
+        if (begin == oldBegin)
+        {
+            memcpy(parents_.Buffer() + begin, oldParents.Buffer() + oldBegin, count * sizeof(unsigned));
+            memcpy(subtreeEnds_.Buffer() + begin, oldEnds.Buffer() + oldBegin, count * sizeof(unsigned));
+            continue;
+        }
+
+        // The root's parent is the scene, every other parent is inside the subtree
+        Node** nodes = nodes_.Buffer() + begin;
+        unsigned* parents = parents_.Buffer() + begin;
+        unsigned* ends = subtreeEnds_.Buffer() + begin;
+        const unsigned* srcParents = oldParents.Buffer() + oldBegin;
+        const unsigned* srcEnds = oldEnds.Buffer() + oldBegin;
+        parents[0] = M_MAX_UNSIGNED;
+        for (unsigned k = 0; k < count; ++k)
+        {
+            if (k)
+                parents[k] = srcParents[k] - oldBegin + begin;
+            ends[k] = srcEnds[k] - oldBegin + begin;
+            nodes[k]->transformIndex_ = begin + k;
+        }
+    }
+    subtreeOffsets_.Push(nodes_.Size());
+    subtreeDirty_.Resize(subtreeOffsets_.Size() - 1);
+    for (unsigned i = 0; i < subtreeDirty_.Size(); ++i)
+        subtreeDirty_[i] = 0;
+
+    // Move the marked nodes of the copied subtrees along. The traversed subtrees took the nodes' own dirty flags instead
+    for (unsigned i = 0; i < oldDirtyNodes.Size(); ++i)
+    {
+        unsigned index = oldDirtyNodes[i];
+        unsigned subtree = FindSubtree(oldOffsets, index);
+        if (newOffsets[subtree] != M_MAX_UNSIGNED)
+            dirtyNodes_.Push(index - oldOffsets[subtree] + newOffsets[subtree]);
+    }
+
+    hierarchyDirty_ = false;
+}
+
+void TransformStore::AddSubtree(Node* root, PODVector<Pair<Node*, unsigned> >& stack)
+{
+    // Depth-first traversal in child order visits the nodes mostly in their allocation order
+    unsigned begin = nodes_.Size();
+    stack.Push(MakePair(root, M_MAX_UNSIGNED));
+    while (!stack.Empty())
+    {
+        Node* node = stack.Back().first_;
+        unsigned parent = stack.Back().second_;
+        stack.Pop();
+
+        unsigned index = nodes_.Size();
+        node->transformStore_ = this;
+        node->transformIndex_ = index;
+        nodes_.Push(node);
+        parents_.Push(parent);
+        subtreeEnds_.Push(index + 1);
+        flags_.Push(node->dirty_ ? FLAG_MARKED : 0);
+        if (node->dirty_)
+            dirtyNodes_.Push(index);
+        for (unsigned i = node->children_.Size() - 1; i < node->children_.Size(); --i)
+            stack.Push(MakePair(node->children_[i].Get(), index));
+    }
+
+    // Every node comes after its parent, so the subtree ends accumulate backwards
+    for (unsigned i = nodes_.Size() - 1; i > begin; --i)
+    {
+        unsigned parent = parents_[i];
+        subtreeEnds_[parent] = Max(subtreeEnds_[parent], subtreeEnds_[i]);
+    }
+}
+
+void TransformStore::UpdateWorldTransforms(unsigned begin, unsigned end)
+{
+    Node* const* nodes = nodes_.Buffer();
+    const unsigned* parents = parents_.Buffer();
+    unsigned char* flags = flags_.Buffer();
+
+    for (unsigned i = begin; i < end; ++i)
+    {
+#ifdef URHO3D_SSE
+        // The nodes are scattered in memory, so fetch the transform members of the nodes ahead
+        if (i + TRANSFORM_PREFETCH_DISTANCE < end)
+        {
+            const Node* ahead = nodes[i + TRANSFORM_PREFETCH_DISTANCE];
+            _mm_prefetch((const char*)&ahead->worldTransform_, _MM_HINT_T0);
+            _mm_prefetch((const char*)&ahead->position_, _MM_HINT_T0);
+            _mm_prefetch((const char*)&ahead->worldRotation_, _MM_HINT_T0);
+        }
+#endif
+
+        // Propagate the flags to child nodes. Parents come first, so their flags are final
+        unsigned parent = parents[i];
+        if (parent != M_MAX_UNSIGNED && flags[parent])
+            flags[i] |= FLAG_INHERITED;
+        if (!flags[i])
+            continue;
+
+        Node* node = nodes[i];
+        if (parent == M_MAX_UNSIGNED)
+        {
+            node->worldTransform_ = node->GetTransform();
+            node->worldRotation_ = node->rotation_;
+        }
+        else if (flags[i] & FLAG_INHERITED)
+        {
+            const Node* parentNode = nodes[parent];
+            node->worldTransform_ = parentNode->worldTransform_ * node->GetTransform();
+            node->worldRotation_ = parentNode->worldRotation_ * node->rotation_;
+        }
+        else
+        {
+            // The topmost changed nodes take the world transform of the parent node, which is up to date as it is not marked
+            const Node* parentNode = nodes[parent];
+            node->worldTransform_ = parentNode->GetWorldTransform() * node->GetTransform();
+            node->worldRotation_ = parentNode->GetWorldRotation() * node->rotation_;
+        }
+        node->dirty_ = false;
+    }
+}
+
+}
@@ -0,0 +1,109 @@
+//
+// Copyright (c) 2008-2018 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/Pair.h"
+#include "../Container/Vector.h"
+
+namespace Urho3D
+{
+
+class Node;
+class Scene;
+
+/// Contiguous store of a scene's node hierarchy in depth-first order. Nodes changed from the main thread are recorded instead of marking their child nodes dirty recursively, and the world transforms of their subtrees are recalculated in one batched pass, after which the listeners of the changed nodes are notified. Until then the listeners have not been notified of the changes; world transforms read in between are calculated through the changed parent nodes. Hierarchy changes re-traverse only the changed subtrees of the scene's child nodes.
+class URHO3D_API TransformStore
+{
+public:
+    /// Construct for a scene and take over its nodes.
+    explicit TransformStore(Scene* scene);
+    /// Destruct. Detach the nodes.
+    ~TransformStore();
+    /// Prevent copy construction.
+    TransformStore(const TransformStore& rhs) = delete;
+    /// Prevent assignment.
+    TransformStore& operator =(const TransformStore& rhs) = delete;
+
+    /// Add a node. Called by the scene when the node is added to it.
+    void AddNode(Node* node);
+    /// Remove a node. Called by the scene when the node is removed from it.
+    void RemoveNode(Node* node);
+    /// Mark the hierarchy changed around a node, for example when it moves to another parent. The subtrees of the scene's child nodes that held or now hold the node are rebuilt on the next update.
+    void MarkHierarchyDirty(Node* node);
+    /// Record a changed node. Called by the node after setting its own dirty flag, also when it was already set. The listeners of the node and its child nodes are not notified until the next update.
+    void MarkDirty(Node* node);
+    /// Recalculate the world transforms of the changed nodes and their children, then notify their listeners. Must be called from the main thread. Listeners must not remove nodes during the notification.
+    void Update();
+
+    /// Return whether there are changed nodes waiting for update.
+    bool IsDirty() const { return dirty_; }
+    /// Return revision, which changes whenever a node is marked. A world transform calculated through the changed nodes at the current revision is up to date.
+    unsigned GetRevision() const { return revision_; }
+    /// Return number of nodes in the store.
+    unsigned GetNumNodes() const { return nodes_.Size(); }
+    /// Return number of independent subtrees, which are the scene itself and each of its children.
+    unsigned GetNumSubtrees() const { return subtreeOffsets_.Size() ? subtreeOffsets_.Size() - 1 : 0; }
+    /// Return number of nodes whose world transform was recalculated by the last update.
+    unsigned GetNumUpdated() const { return numUpdated_; }
+
+private:
+    /// Rebuild the node order. The unchanged subtrees of the scene's child nodes are copied, and the changed ones traversed depth-first.
+    void Rebuild();
+    /// Append the subtree of a child node of the scene by traversing it depth-first.
+    void AddSubtree(Node* root, PODVector<Pair<Node*, unsigned> >& stack);
+    /// Mark the subtree of a scene's child node holding a store index for rebuild.
+    void MarkSubtreeDirty(unsigned index);
+    /// Propagate the change flags and recalculate the world transforms of the flagged nodes in an index range of whole subtrees.
+    void UpdateWorldTransforms(unsigned begin, unsigned end);
+
+    /// Scene.
+    Scene* scene_;
+    /// Nodes in depth-first order. Every node comes after its parent.
+    PODVector<Node*> nodes_;
+    /// Parent index of each node, or M_MAX_UNSIGNED if the parent is the scene, which is assumed to have identity transform.
+    PODVector<unsigned> parents_;
+    /// End index of the subtree of each node.
+    PODVector<unsigned> subtreeEnds_;
+    /// Start index of each independent subtree, followed by the node count.
+    PODVector<unsigned> subtreeOffsets_;
+    /// Rebuild flags of each independent subtree.
+    PODVector<unsigned char> subtreeDirty_;
+    /// Change flags of each node.
+    PODVector<unsigned char> flags_;
+    /// Indices of the nodes marked since the last update.
+    PODVector<unsigned> dirtyNodes_;
+    /// Index ranges of the subtrees to update.
+    PODVector<Pair<unsigned, unsigned> > dirtyRanges_;
+    /// Changed nodes to notify after an update.
+    PODVector<Node*> changedNodes_;
+    /// Number of nodes recalculated by the last update.
+    unsigned numUpdated_;
+    /// Revision of the node changes.
+    unsigned revision_;
+    /// Changed nodes waiting for update flag.
+    bool dirty_;
+    /// Node order needs rebuild flag.
+    bool hierarchyDirty_;
+};
+
+}
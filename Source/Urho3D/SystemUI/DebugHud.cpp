@@ -20,7 +20,9 @@
 // THE SOFTWARE.
 //
 
+#include "../Container/FrameAllocator.h"
 #include "../Core/CoreEvents.h"
+#include "../Core/PerformanceCounters.h"
 #include "../Core/Profiler.h"
 #include "../Engine/Engine.h"
 #include "../Graphics/Graphics.h"
@@ -191,10 +193,48 @@ void DebugHud::RenderUi(VariantMap& eventData)
             ui::Text("Shadowmaps %u", renderer->GetNumShadowMaps(true));
             ui::Text("Occluders %u", renderer->GetNumOccluders(true));
 
+            const FrameAllocatorStats& frameStats = FrameAllocator::GetLastFrameStats();
+            ui::Text("Frame memory %u KB in %u allocations", (frameStats.allocatedBytes_ + 1023) / 1024, frameStats.numAllocations_);
+
+            unsigned long long poolBytes = 0;
+            unsigned poolNodes = 0;
+            for (unsigned i = 0; i < PoolAllocator::GetNumAllocators(); ++i)
+            {
+                if (PoolAllocator* allocator = PoolAllocator::GetAllocator(i))
+                {
+                    PoolAllocatorStats poolStats = allocator->GetStats();
+                    poolBytes += poolStats.reservedBytes_;
+                    poolNodes += poolStats.liveNodes_;
+                }
+            }
+            ui::Text("Node pools %u KB, %u live nodes", (unsigned)((poolBytes + 1023) / 1024), poolNodes);
+
             for (HashMap<String, String>::ConstIterator i = appStats_.Begin(); i != appStats_.End(); ++i)
                 ui::Text("%s %s", i->first_.CString(), i->second_.CString());
         }
 
+        if (mode_ & DEBUGHUD_SHOW_COUNTERS)
+        {
+            if (auto* counters = GetSubsystem<PerformanceCounters>())
+            {
+                for (unsigned i = 0; i < counters->GetNumCounters(); ++i)
+                {
+                    PerformanceCounter* counter = counters->GetCounter(i);
+                    if (counter->GetType() == PCT_HISTOGRAM)
+                    {
+                        ui::Text("%s last %.2f mean %.2f p50 %.2f p95 %.2f p99 %.2f", counter->GetName().CString(),
+                            counter->GetLastValue(), counter->GetMean(), counter->GetPercentile(50.0f),
+                            counter->GetPercentile(95.0f), counter->GetPercentile(99.0f));
+                    }
+                    else
+                    {
+                        ui::Text("%s last %.0f mean %.2f max %.0f", counter->GetName().CString(), counter->GetLastValue(),
+                            counter->GetMean(), counter->GetMax());
+                    }
+                }
+            }
+        }
+
         if (mode_ & DEBUGHUD_SHOW_MODE)
         {
             auto& style = ui::GetStyle();
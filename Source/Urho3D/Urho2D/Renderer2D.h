@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include "../Container/FrameVector.h"
 #include "../Graphics/Drawable.h"
 #include "../Math/Frustum.h"
 
@@ -52,8 +53,8 @@ struct ViewBatchInfo2D
     SharedPtr<VertexBuffer> vertexBuffer_;
     /// Batch updated frame number.
     unsigned batchUpdatedFrameNumber_;
-    /// Source batches.
-    PODVector<const SourceBatch2D*> sourceBatches_;
+    /// Source batches. Allocated from the frame allocator.
+    FramePODVector<const SourceBatch2D*> sourceBatches_;
     /// Batch count;
     unsigned batchCount_;
     /// Distances.